@@ -0,0 +1,803 @@
+/* FNA3D - 3D Graphics Library for FNA
+ *
+ * Copyright (c) 2020-2024 Ethan Lee
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from
+ * the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ * claim that you wrote the original software. If you use this software in a
+ * product, an acknowledgment in the product documentation would be
+ * appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ * misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ * Ethan "flibitijibibo" Lee <flibitijibibo@flibitijibibo.com>
+ *
+ */
+
+/* Microbenchmarks for the public FNA3D API.
+ *
+ * Each workload imitates a pattern FNA games hit every frame and is timed on
+ * the CPU from the first call to the last SwapBuffers, so the numbers cover
+ * FNA3D.c, the driver and whatever the graphics API does before returning.
+ * The driver is chosen the usual way, through FNA3D_FORCE_DRIVER.
+ *
+ * Workloads that draw need shaders, so they are skipped unless an Effect
+ * binary is passed with -effect=, FNA's SpriteEffect.fxb works fine.
+ */
+
+#ifdef USE_SDL3
+#include <SDL3/SDL.h>
+#else
+#include <SDL.h>
+#define SDL_CreateWindow(a, b, c, d) \
+	SDL_CreateWindow(a, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, b, c, d)
+#endif
+#include <mojoshader.h>
+#include <FNA3D.h>
+#include "replay_json.h"
+
+#include <stdio.h>
+
+#define BACKBUFFER_WIDTH 1280
+#define BACKBUFFER_HEIGHT 720
+
+#define MAX_SPRITES 2048
+#define SPRITES_PER_BATCH 64
+#define BATCHES_PER_FRAME 32
+
+#define STREAM_TEXTURE_SIZE 1024
+#define STREAM_TILE_SIZE 256
+#define TARGET_SIZE 256
+
+typedef struct BenchVertex
+{
+	float x, y, z;
+	uint32_t color;
+	float u, v;
+} BenchVertex;
+
+typedef struct BenchContext
+{
+	FNA3D_Device *device;
+	void *window;
+	uint32_t scale;
+
+	/* Only set with -effect= */
+	FNA3D_Effect *effect;
+	MOJOSHADER_effect *effectData;
+	MOJOSHADER_effectStateChanges changes;
+
+	/* Shared sprite resources */
+	FNA3D_Buffer *vertexBuffer;
+	FNA3D_Buffer *indexBuffer;
+	FNA3D_Texture *spriteTexture;
+	FNA3D_VertexElement elements[3];
+	FNA3D_VertexBufferBinding binding;
+	BenchVertex *vertices;
+	int32_t spriteOffset;
+
+	/* Default render states */
+	FNA3D_BlendState blendState;
+	FNA3D_DepthStencilState depthStencilState;
+	FNA3D_RasterizerState rasterizerState;
+	FNA3D_SamplerState samplerState;
+} BenchContext;
+
+typedef struct BenchResult
+{
+	uint64_t ops;
+	uint64_t draws;
+	uint64_t bytes;
+	uint64_t ticks;
+} BenchResult;
+
+/* Helpers */
+
+static void SetDefaultStates(BenchContext *ctx)
+{
+	FNA3D_Viewport viewport;
+
+	viewport.x = 0;
+	viewport.y = 0;
+	viewport.w = BACKBUFFER_WIDTH;
+	viewport.h = BACKBUFFER_HEIGHT;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+
+	FNA3D_SetRenderTargets(
+		ctx->device,
+		NULL,
+		0,
+		NULL,
+		FNA3D_DEPTHFORMAT_NONE,
+		0
+	);
+	FNA3D_SetViewport(ctx->device, &viewport);
+	FNA3D_SetBlendState(ctx->device, &ctx->blendState);
+	FNA3D_SetDepthStencilState(ctx->device, &ctx->depthStencilState);
+	FNA3D_ApplyRasterizerState(ctx->device, &ctx->rasterizerState);
+}
+
+/* Writes one batch into the dynamic vertex buffer the way SpriteBatch does:
+ * NoOverwrite while there is room, Discard when it wraps around.
+ */
+static int32_t UploadSprites(BenchContext *ctx, int32_t frame)
+{
+	FNA3D_SetDataOptions options;
+	BenchVertex *v;
+	int32_t i, baseVertex;
+
+	if (ctx->spriteOffset + SPRITES_PER_BATCH > MAX_SPRITES)
+	{
+		ctx->spriteOffset = 0;
+		options = FNA3D_SETDATAOPTIONS_DISCARD;
+	}
+	else
+	{
+		options = FNA3D_SETDATAOPTIONS_NOOVERWRITE;
+	}
+
+	for (i = 0; i < SPRITES_PER_BATCH; i += 1)
+	{
+		v = &ctx->vertices[i * 4];
+		v[0].x = (float) ((i * 17 + frame) % BACKBUFFER_WIDTH);
+		v[0].y = (float) ((i * 31 + frame) % BACKBUFFER_HEIGHT);
+		v[0].z = 0.0f;
+		v[0].color = 0xFFFFFFFF;
+		v[0].u = 0.0f;
+		v[0].v = 0.0f;
+		v[1] = v[0];
+		v[1].x += 16.0f;
+		v[1].u = 1.0f;
+		v[2] = v[0];
+		v[2].y += 16.0f;
+		v[2].v = 1.0f;
+		v[3] = v[1];
+		v[3].y += 16.0f;
+		v[3].v = 1.0f;
+	}
+
+	baseVertex = ctx->spriteOffset * 4;
+	FNA3D_SetVertexBufferData(
+		ctx->device,
+		ctx->vertexBuffer,
+		baseVertex * sizeof(BenchVertex),
+		ctx->vertices,
+		SPRITES_PER_BATCH * 4,
+		sizeof(BenchVertex),
+		sizeof(BenchVertex),
+		options
+	);
+	ctx->spriteOffset += SPRITES_PER_BATCH;
+	return baseVertex;
+}
+
+static void DrawSprites(
+	BenchContext *ctx,
+	int32_t baseVertex,
+	uint8_t bindingsUpdated
+) {
+	FNA3D_ApplyVertexBufferBindings(
+		ctx->device,
+		&ctx->binding,
+		1,
+		bindingsUpdated,
+		baseVertex
+	);
+	FNA3D_DrawIndexedPrimitives(
+		ctx->device,
+		FNA3D_PRIMITIVETYPE_TRIANGLELIST,
+		baseVertex,
+		0,
+		SPRITES_PER_BATCH * 4,
+		0,
+		SPRITES_PER_BATCH * 2,
+		ctx->indexBuffer,
+		FNA3D_INDEXELEMENTSIZE_16BIT
+	);
+}
+
+static void Present(BenchContext *ctx)
+{
+	FNA3D_SwapBuffers(ctx->device, NULL, NULL, ctx->window);
+}
+
+/* Workloads */
+
+/* Thousands of small dynamic uploads, each followed by a draw */
+static void BenchSpriteBatch(BenchContext *ctx, BenchResult *result)
+{
+	int32_t frame, batch, baseVertex;
+	int32_t frames = 100 * ctx->scale;
+
+	for (frame = 0; frame < frames; frame += 1)
+	{
+		SetDefaultStates(ctx);
+		FNA3D_ApplyEffect(ctx->device, ctx->effect, 0, &ctx->changes);
+		FNA3D_VerifySampler(
+			ctx->device,
+			0,
+			ctx->spriteTexture,
+			&ctx->samplerState
+		);
+		for (batch = 0; batch < BATCHES_PER_FRAME; batch += 1)
+		{
+			baseVertex = UploadSprites(ctx, frame);
+			DrawSprites(ctx, baseVertex, batch == 0);
+		}
+		Present(ctx);
+	}
+
+	result->ops = frames * BATCHES_PER_FRAME;
+	result->draws = result->ops;
+	result->bytes = result->ops * SPRITES_PER_BATCH * 4 * sizeof(BenchVertex);
+}
+
+/* Blend and sampler churn between draws that reuse the same vertices */
+static void BenchStateThrash(BenchContext *ctx, BenchResult *result)
+{
+	FNA3D_BlendState blendStates[4];
+	FNA3D_SamplerState samplerStates[4];
+	int32_t frame, batch, baseVertex;
+	int32_t frames = 100 * ctx->scale;
+	int32_t i;
+
+	for (i = 0; i < 4; i += 1)
+	{
+		blendStates[i] = ctx->blendState;
+		samplerStates[i] = ctx->samplerState;
+	}
+	blendStates[1].colorSourceBlend = FNA3D_BLEND_SOURCEALPHA;
+	blendStates[1].alphaSourceBlend = FNA3D_BLEND_SOURCEALPHA;
+	blendStates[2].colorDestinationBlend = FNA3D_BLEND_ONE;
+	blendStates[2].alphaDestinationBlend = FNA3D_BLEND_ONE;
+	blendStates[3].colorSourceBlend = FNA3D_BLEND_ONE;
+	blendStates[3].colorDestinationBlend = FNA3D_BLEND_ZERO;
+	blendStates[3].alphaSourceBlend = FNA3D_BLEND_ONE;
+	blendStates[3].alphaDestinationBlend = FNA3D_BLEND_ZERO;
+	samplerStates[1].filter = FNA3D_TEXTUREFILTER_POINT;
+	samplerStates[2].addressU = FNA3D_TEXTUREADDRESSMODE_WRAP;
+	samplerStates[2].addressV = FNA3D_TEXTUREADDRESSMODE_WRAP;
+	samplerStates[3].filter = FNA3D_TEXTUREFILTER_POINT;
+	samplerStates[3].addressU = FNA3D_TEXTUREADDRESSMODE_WRAP;
+
+	for (frame = 0; frame < frames; frame += 1)
+	{
+		SetDefaultStates(ctx);
+		FNA3D_ApplyEffect(ctx->device, ctx->effect, 0, &ctx->changes);
+		baseVertex = UploadSprites(ctx, frame);
+		for (batch = 0; batch < BATCHES_PER_FRAME; batch += 1)
+		{
+			FNA3D_SetBlendState(
+				ctx->device,
+				&blendStates[batch % 4]
+			);
+			FNA3D_VerifySampler(
+				ctx->device,
+				0,
+				ctx->spriteTexture,
+				&samplerStates[(batch / 4) % 4]
+			);
+			DrawSprites(ctx, baseVertex, batch == 0);
+		}
+		Present(ctx);
+	}
+
+	result->ops = frames * BATCHES_PER_FRAME;
+	result->draws = result->ops;
+}
+
+/* Alternates between two render targets, clearing each as it is bound */
+static void BenchRenderTargets(BenchContext *ctx, BenchResult *result)
+{
+	FNA3D_Texture *textures[2];
+	FNA3D_RenderTargetBinding targets[2];
+	FNA3D_Vec4 color;
+	int32_t frame, pass, i;
+	int32_t frames = 100 * ctx->scale;
+	const int32_t passesPerFrame = 16;
+
+	for (i = 0; i < 2; i += 1)
+	{
+		textures[i] = FNA3D_CreateTexture2D(
+			ctx->device,
+			FNA3D_SURFACEFORMAT_COLOR,
+			TARGET_SIZE,
+			TARGET_SIZE,
+			1,
+			1
+		);
+		SDL_zero(targets[i]);
+		targets[i].type = FNA3D_RENDERTARGET_TYPE_2D;
+		targets[i].twod.width = TARGET_SIZE;
+		targets[i].twod.height = TARGET_SIZE;
+		targets[i].levelCount = 1;
+		targets[i].multiSampleCount = 0;
+		targets[i].texture = textures[i];
+	}
+
+	color.x = 0.0f;
+	color.y = 0.0f;
+	color.z = 0.0f;
+	color.w = 1.0f;
+
+	for (frame = 0; frame < frames; frame += 1)
+	{
+		for (pass = 0; pass < passesPerFrame; pass += 1)
+		{
+			FNA3D_SetRenderTargets(
+				ctx->device,
+				&targets[pass & 1],
+				1,
+				NULL,
+				FNA3D_DEPTHFORMAT_NONE,
+				0
+			);
+			color.x = (float) pass / passesPerFrame;
+			FNA3D_Clear(
+				ctx->device,
+				FNA3D_CLEAROPTIONS_TARGET,
+				&color,
+				1.0f,
+				0
+			);
+		}
+		SetDefaultStates(ctx);
+		Present(ctx);
+	}
+
+	for (i = 0; i < 2; i += 1)
+	{
+		FNA3D_AddDisposeTexture(ctx->device, textures[i]);
+	}
+
+	result->ops = frames * passesPerFrame;
+}
+
+/* Tile-sized uploads into one large texture, like a streaming atlas */
+static void BenchTextureStreaming(BenchContext *ctx, BenchResult *result)
+{
+	FNA3D_Texture *texture;
+	uint8_t *pixels;
+	int32_t frame, tile, x, y;
+	int32_t frames = 100 * ctx->scale;
+	const int32_t tilesPerFrame = 8;
+	const int32_t tilesPerRow = STREAM_TEXTURE_SIZE / STREAM_TILE_SIZE;
+	const int32_t tileBytes = STREAM_TILE_SIZE * STREAM_TILE_SIZE * 4;
+
+	texture = FNA3D_CreateTexture2D(
+		ctx->device,
+		FNA3D_SURFACEFORMAT_COLOR,
+		STREAM_TEXTURE_SIZE,
+		STREAM_TEXTURE_SIZE,
+		1,
+		0
+	);
+	pixels = (uint8_t*) SDL_malloc(tileBytes);
+	SDL_memset(pixels, 0x7F, tileBytes);
+
+	for (frame = 0; frame < frames; frame += 1)
+	{
+		for (tile = 0; tile < tilesPerFrame; tile += 1)
+		{
+			x = (frame * tilesPerFrame + tile) % tilesPerRow;
+			y = ((frame * tilesPerFrame + tile) / tilesPerRow) % tilesPerRow;
+			pixels[0] = (uint8_t) tile;
+			FNA3D_SetTextureData2D(
+				ctx->device,
+				texture,
+				x * STREAM_TILE_SIZE,
+				y * STREAM_TILE_SIZE,
+				STREAM_TILE_SIZE,
+				STREAM_TILE_SIZE,
+				0,
+				pixels,
+				tileBytes
+			);
+		}
+		Present(ctx);
+	}
+
+	SDL_free(pixels);
+	FNA3D_AddDisposeTexture(ctx->device, texture);
+
+	result->ops = frames * tilesPerFrame;
+	result->bytes = result->ops * tileBytes;
+}
+
+/* Rewrites every float parameter and commits it, as Effect.Apply does */
+static void BenchEffectParameters(BenchContext *ctx, BenchResult *result)
+{
+	MOJOSHADER_effectParam *param;
+	int32_t frame, apply, p;
+	uint32_t v;
+	int32_t frames = 100 * ctx->scale;
+	const int32_t appliesPerFrame = 64;
+	uint64_t bytes = 0;
+
+	for (frame = 0; frame < frames; frame += 1)
+	{
+		for (apply = 0; apply < appliesPerFrame; apply += 1)
+		{
+			for (p = 0; p < ctx->effectData->param_count; p += 1)
+			{
+				param = &ctx->effectData->params[p];
+				if (param->value.type.parameter_type != MOJOSHADER_SYMTYPE_FLOAT)
+				{
+					continue;
+				}
+				for (v = 0; v < param->value.value_count; v += 1)
+				{
+					param->value.valuesF[v] = (float) (apply + v);
+				}
+				bytes += param->value.value_count * sizeof(float);
+			}
+			FNA3D_ApplyEffect(
+				ctx->device,
+				ctx->effect,
+				0,
+				&ctx->changes
+			);
+		}
+		Present(ctx);
+	}
+
+	result->ops = frames * appliesPerFrame;
+	result->bytes = bytes;
+}
+
+/* Driver */
+
+typedef struct BenchWorkload
+{
+	const char *name;
+	void (*run)(BenchContext *ctx, BenchResult *result);
+	uint8_t needsEffect;
+} BenchWorkload;
+
+static const BenchWorkload workloads[] =
+{
+	{ "spritebatch",	BenchSpriteBatch,	1 },
+	{ "statethrash",	BenchStateThrash,	1 },
+	{ "rendertarget",	BenchRenderTargets,	0 },
+	{ "texturestream",	BenchTextureStreaming,	0 },
+	{ "effectparams",	BenchEffectParameters,	1 }
+};
+
+static void CreateResources(BenchContext *ctx)
+{
+	uint16_t *indices;
+	uint32_t *pixels;
+	int32_t i;
+
+	ctx->vertexBuffer = FNA3D_GenVertexBuffer(
+		ctx->device,
+		1,
+		FNA3D_BUFFERUSAGE_WRITEONLY,
+		MAX_SPRITES * 4 * sizeof(BenchVertex)
+	);
+	ctx->vertices = (BenchVertex*) SDL_malloc(
+		SPRITES_PER_BATCH * 4 * sizeof(BenchVertex)
+	);
+
+	indices = (uint16_t*) SDL_malloc(MAX_SPRITES * 6 * sizeof(uint16_t));
+	for (i = 0; i < MAX_SPRITES; i += 1)
+	{
+		indices[i * 6 + 0] = (uint16_t) (i * 4 + 0);
+		indices[i * 6 + 1] = (uint16_t) (i * 4 + 1);
+		indices[i * 6 + 2] = (uint16_t) (i * 4 + 2);
+		indices[i * 6 + 3] = (uint16_t) (i * 4 + 3);
+		indices[i * 6 + 4] = (uint16_t) (i * 4 + 2);
+		indices[i * 6 + 5] = (uint16_t) (i * 4 + 1);
+	}
+	ctx->indexBuffer = FNA3D_GenIndexBuffer(
+		ctx->device,
+		0,
+		FNA3D_BUFFERUSAGE_WRITEONLY,
+		MAX_SPRITES * 6 * sizeof(uint16_t)
+	);
+	FNA3D_SetIndexBufferData(
+		ctx->device,
+		ctx->indexBuffer,
+		0,
+		indices,
+		MAX_SPRITES * 6 * sizeof(uint16_t),
+		FNA3D_SETDATAOPTIONS_NONE
+	);
+	SDL_free(indices);
+
+	pixels = (uint32_t*) SDL_malloc(64 * 64 * sizeof(uint32_t));
+	for (i = 0; i < 64 * 64; i += 1)
+	{
+		pixels[i] = ((i / 8) & 1) ? 0xFFFFFFFF : 0xFF000000;
+	}
+	ctx->spriteTexture = FNA3D_CreateTexture2D(
+		ctx->device,
+		FNA3D_SURFACEFORMAT_COLOR,
+		64,
+		64,
+		1,
+		0
+	);
+	FNA3D_SetTextureData2D(
+		ctx->device,
+		ctx->spriteTexture,
+		0,
+		0,
+		64,
+		64,
+		0,
+		pixels,
+		64 * 64 * sizeof(uint32_t)
+	);
+	SDL_free(pixels);
+
+	/* VertexPositionColorTexture */
+	ctx->elements[0].offset = 0;
+	ctx->elements[0].vertexElementFormat = FNA3D_VERTEXELEMENTFORMAT_VECTOR3;
+	ctx->elements[0].vertexElementUsage = FNA3D_VERTEXELEMENTUSAGE_POSITION;
+	ctx->elements[0].usageIndex = 0;
+	ctx->elements[1].offset = 12;
+	ctx->elements[1].vertexElementFormat = FNA3D_VERTEXELEMENTFORMAT_COLOR;
+	ctx->elements[1].vertexElementUsage = FNA3D_VERTEXELEMENTUSAGE_COLOR;
+	ctx->elements[1].usageIndex = 0;
+	ctx->elements[2].offset = 16;
+	ctx->elements[2].vertexElementFormat = FNA3D_VERTEXELEMENTFORMAT_VECTOR2;
+	ctx->elements[2].vertexElementUsage = FNA3D_VERTEXELEMENTUSAGE_TEXTURECOORDINATE;
+	ctx->elements[2].usageIndex = 0;
+	ctx->binding.vertexBuffer = ctx->vertexBuffer;
+	ctx->binding.vertexDeclaration.vertexStride = sizeof(BenchVertex);
+	ctx->binding.vertexDeclaration.elementCount = 3;
+	ctx->binding.vertexDeclaration.elements = ctx->elements;
+	ctx->binding.vertexOffset = 0;
+	ctx->binding.instanceFrequency = 0;
+
+	/* BlendState.AlphaBlend */
+	ctx->blendState.colorSourceBlend = FNA3D_BLEND_ONE;
+	ctx->blendState.colorDestinationBlend = FNA3D_BLEND_INVERSESOURCEALPHA;
+	ctx->blendState.colorBlendFunction = FNA3D_BLENDFUNCTION_ADD;
+	ctx->blendState.alphaSourceBlend = FNA3D_BLEND_ONE;
+	ctx->blendState.alphaDestinationBlend = FNA3D_BLEND_INVERSESOURCEALPHA;
+	ctx->blendState.alphaBlendFunction = FNA3D_BLENDFUNCTION_ADD;
+	ctx->blendState.colorWriteEnable = FNA3D_COLORWRITECHANNELS_ALL;
+	ctx->blendState.colorWriteEnable1 = FNA3D_COLORWRITECHANNELS_ALL;
+	ctx->blendState.colorWriteEnable2 = FNA3D_COLORWRITECHANNELS_ALL;
+	ctx->blendState.colorWriteEnable3 = FNA3D_COLORWRITECHANNELS_ALL;
+	ctx->blendState.blendFactor.r = 0xFF;
+	ctx->blendState.blendFactor.g = 0xFF;
+	ctx->blendState.blendFactor.b = 0xFF;
+	ctx->blendState.blendFactor.a = 0xFF;
+	ctx->blendState.multiSampleMask = -1;
+
+	/* DepthStencilState.None */
+	SDL_zero(ctx->depthStencilState);
+	ctx->depthStencilState.depthBufferFunction = FNA3D_COMPAREFUNCTION_ALWAYS;
+	ctx->depthStencilState.stencilMask = -1;
+	ctx->depthStencilState.stencilWriteMask = -1;
+	ctx->depthStencilState.stencilFail = FNA3D_STENCILOPERATION_KEEP;
+	ctx->depthStencilState.stencilDepthBufferFail = FNA3D_STENCILOPERATION_KEEP;
+	ctx->depthStencilState.stencilPass = FNA3D_STENCILOPERATION_KEEP;
+	ctx->depthStencilState.stencilFunction = FNA3D_COMPAREFUNCTION_ALWAYS;
+	ctx->depthStencilState.ccwStencilFail = FNA3D_STENCILOPERATION_KEEP;
+	ctx->depthStencilState.ccwStencilDepthBufferFail = FNA3D_STENCILOPERATION_KEEP;
+	ctx->depthStencilState.ccwStencilPass = FNA3D_STENCILOPERATION_KEEP;
+	ctx->depthStencilState.ccwStencilFunction = FNA3D_COMPAREFUNCTION_ALWAYS;
+
+	/* RasterizerState.CullNone */
+	SDL_zero(ctx->rasterizerState);
+	ctx->rasterizerState.fillMode = FNA3D_FILLMODE_SOLID;
+	ctx->rasterizerState.cullMode = FNA3D_CULLMODE_NONE;
+
+	/* SamplerState.LinearClamp */
+	SDL_zero(ctx->samplerState);
+	ctx->samplerState.filter = FNA3D_TEXTUREFILTER_LINEAR;
+	ctx->samplerState.addressU = FNA3D_TEXTUREADDRESSMODE_CLAMP;
+	ctx->samplerState.addressV = FNA3D_TEXTUREADDRESSMODE_CLAMP;
+	ctx->samplerState.addressW = FNA3D_TEXTUREADDRESSMODE_CLAMP;
+	ctx->samplerState.maxAnisotropy = 4;
+}
+
+static void DestroyResources(BenchContext *ctx)
+{
+	FNA3D_AddDisposeTexture(ctx->device, ctx->spriteTexture);
+	FNA3D_AddDisposeIndexBuffer(ctx->device, ctx->indexBuffer);
+	FNA3D_AddDisposeVertexBuffer(ctx->device, ctx->vertexBuffer);
+	SDL_free(ctx->vertices);
+	if (ctx->effect != NULL)
+	{
+		FNA3D_AddDisposeEffect(ctx->device, ctx->effect);
+	}
+}
+
+static uint8_t LoadEffect(BenchContext *ctx, const char *path)
+{
+	void *code;
+	size_t len;
+
+	code = SDL_LoadFile(path, &len);
+	if (code == NULL)
+	{
+		SDL_Log("%s not found!", path);
+		return 0;
+	}
+	FNA3D_CreateEffect(
+		ctx->device,
+		(uint8_t*) code,
+		(uint32_t) len,
+		&ctx->effect,
+		&ctx->effectData
+	);
+	SDL_free(code);
+
+	if (ctx->effectData == NULL || ctx->effectData->technique_count == 0)
+	{
+		SDL_Log("%s is not a usable Effect!", path);
+		FNA3D_AddDisposeEffect(ctx->device, ctx->effect);
+		ctx->effect = NULL;
+		return 0;
+	}
+	FNA3D_SetEffectTechnique(
+		ctx->device,
+		ctx->effect,
+		&ctx->effectData->techniques[0]
+	);
+	SDL_zero(ctx->changes);
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	BenchContext ctx;
+	BenchResult result;
+	FNA3D_PresentationParameters presentationParameters;
+	const char *effectPath = NULL;
+	const char *only = NULL;
+	const char *driver;
+	uint8_t debugMode = 0;
+	uint8_t first;
+	double seconds;
+	size_t w;
+	int i;
+
+	SDL_Init(SDL_INIT_VIDEO);
+
+	/* Tracing would measure the trace writer instead */
+	SDL_SetHint("FNA3D_DISABLE_TRACING", "1");
+
+	SDL_zero(ctx);
+	ctx.scale = 1;
+	for (i = 1; i < argc; i += 1)
+	{
+		if (SDL_strcmp(argv[i], "-debug") == 0)
+		{
+			debugMode = 1;
+		}
+		else if (SDL_strstr(argv[i], "-effect=") == argv[i])
+		{
+			effectPath = argv[i] + SDL_strlen("-effect=");
+		}
+		else if (SDL_strstr(argv[i], "-scale=") == argv[i])
+		{
+			ctx.scale = SDL_max(1, SDL_atoi(argv[i] + SDL_strlen("-scale=")));
+		}
+		else if (SDL_strstr(argv[i], "-only=") == argv[i])
+		{
+			only = argv[i] + SDL_strlen("-only=");
+		}
+		else
+		{
+			SDL_Log(
+				"Usage: %s [-effect=file.fxb] [-scale=N] [-only=name] [-debug]",
+				argv[0]
+			);
+			SDL_Quit();
+			return 1;
+		}
+	}
+
+	/* Create a hidden window alongside the device, without vsync */
+	presentationParameters.backBufferWidth = BACKBUFFER_WIDTH;
+	presentationParameters.backBufferHeight = BACKBUFFER_HEIGHT;
+	presentationParameters.backBufferFormat = FNA3D_SURFACEFORMAT_COLOR;
+	presentationParameters.multiSampleCount = 0;
+	presentationParameters.isFullScreen = 0;
+	presentationParameters.depthStencilFormat = FNA3D_DEPTHFORMAT_NONE;
+	presentationParameters.presentationInterval = FNA3D_PRESENTINTERVAL_IMMEDIATE;
+	presentationParameters.displayOrientation = FNA3D_DISPLAYORIENTATION_DEFAULT;
+	presentationParameters.renderTargetUsage = FNA3D_RENDERTARGETUSAGE_DISCARDCONTENTS;
+	presentationParameters.deviceWindowHandle = SDL_CreateWindow(
+		"FNA3D Benchmark",
+		BACKBUFFER_WIDTH,
+		BACKBUFFER_HEIGHT,
+		FNA3D_PrepareWindowAttributes() | SDL_WINDOW_HIDDEN
+	);
+	ctx.window = presentationParameters.deviceWindowHandle;
+	ctx.device = FNA3D_CreateDevice(&presentationParameters, debugMode);
+	if (ctx.device == NULL)
+	{
+		SDL_Log("Could not create the FNA3D device!");
+		SDL_DestroyWindow((SDL_Window*) ctx.window);
+		SDL_Quit();
+		return 1;
+	}
+
+	CreateResources(&ctx);
+	if (effectPath != NULL)
+	{
+		LoadEffect(&ctx, effectPath);
+	}
+
+	driver = SDL_GetHint("FNA3D_FORCE_DRIVER");
+	if (driver == NULL)
+	{
+		driver = SDL_getenv("FNA3D_FORCE_DRIVER");
+	}
+
+	/* Results go to stdout as JSON, FNA3D's own logging goes to stderr */
+	printf("{\n");
+	printf("\t\"driver\": ");
+	PrintJSONString(driver != NULL ? driver : "default");
+	printf(",\n");
+	printf("\t\"scale\": %u,\n", ctx.scale);
+	printf("\t\"workloads\": [");
+	first = 1;
+	for (w = 0; w < SDL_arraysize(workloads); w += 1)
+	{
+		if (only != NULL && SDL_strcmp(only, workloads[w].name) != 0)
+		{
+			continue;
+		}
+		printf("%s\n\t\t{ \"name\": \"%s\", ", first ? "" : ",", workloads[w].name);
+		first = 0;
+
+		if (workloads[w].needsEffect && ctx.effect == NULL)
+		{
+			printf("\"skipped\": \"needs -effect\" }");
+			continue;
+		}
+
+		SDL_zero(result);
+		ctx.spriteOffset = MAX_SPRITES; /* Start on a Discard */
+		result.ticks = SDL_GetPerformanceCounter();
+		workloads[w].run(&ctx, &result);
+		result.ticks = SDL_GetPerformanceCounter() - result.ticks;
+
+		/* A workload that did nothing would print nan, which isn't JSON */
+		if (result.ops == 0 || result.ticks == 0)
+		{
+			printf("\"ops\": 0 }");
+			fflush(stdout);
+			continue;
+		}
+
+		seconds = (double) result.ticks / (double) SDL_GetPerformanceFrequency();
+		printf(
+			"\"ops\": %llu, \"ns_per_op\": %.1f, "
+			"\"draws_per_sec\": %.1f, \"mib_per_sec\": %.2f }",
+			(unsigned long long) result.ops,
+			seconds * 1e9 / (double) result.ops,
+			(double) result.draws / seconds,
+			(double) result.bytes / seconds / (1024.0 * 1024.0)
+		);
+		fflush(stdout);
+	}
+	printf("\n\t]\n}\n");
+
+	DestroyResources(&ctx);
+	FNA3D_DestroyDevice(ctx.device);
+	SDL_DestroyWindow((SDL_Window*) ctx.window);
+	SDL_Quit();
+	return 0;
+}
+
+/* vim: set noexpandtab shiftwidth=8 tabstop=8: */
@@ -0,0 +1,144 @@
+/* FNA3D - 3D Graphics Library for FNA
+ *
+ * Copyright (c) 2020-2024 Ethan Lee
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from
+ * the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ * claim that you wrote the original software. If you use this software in a
+ * product, an acknowledgment in the product documentation would be
+ * appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ * misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ * Ethan "flibitijibibo" Lee <flibitijibibo@flibitijibibo.com>
+ *
+ */
+
+/* Microbenchmark for the PackedState caches in FNA3D_PipelineCache.c.
+ *
+ * For a growing number of cached sampler states, this measures the average
+ * cost of a fetch hit against both the hash table the drivers now use and
+ * the linear-scan array they used before.
+ */
+
+#include "FNA3D_PipelineCache.h"
+
+#ifdef USE_SDL3
+#include <SDL3/SDL.h>
+#else
+#include <SDL.h>
+#endif
+
+#include <stdio.h>
+
+#define NUM_FETCHES (1 << 22)
+
+/* The pre-hash-table cache, kept here as the baseline */
+
+static void* LinearFetch(PackedStateMap *elements, int32_t count, PackedState key)
+{
+	int32_t i;
+	for (i = 0; i < count; i += 1)
+	{
+		if (	key.a == elements[i].key.a &&
+			key.b == elements[i].key.b	)
+		{
+			return elements[i].value;
+		}
+	}
+	return NULL;
+}
+
+static FNA3D_SamplerState MakeSampler(int32_t i)
+{
+	FNA3D_SamplerState state;
+	state.filter = (FNA3D_TextureFilter) (i % 9);
+	state.addressU = (FNA3D_TextureAddressMode) ((i / 9) % 3);
+	state.addressV = (FNA3D_TextureAddressMode) ((i / 27) % 3);
+	state.addressW = FNA3D_TEXTUREADDRESSMODE_WRAP;
+	state.mipMapLevelOfDetailBias = (float) (i / 81) * 0.25f;
+	state.maxAnisotropy = 4;
+	state.maxMipLevel = 0;
+	return state;
+}
+
+static double ElapsedNS(uint64_t start, uint64_t end)
+{
+	return (double) (end - start) * 1e9 / (double) SDL_GetPerformanceFrequency();
+}
+
+int main(int argc, char **argv)
+{
+	const int32_t sizes[] = { 4, 16, 64, 128, 256, 512, 1024, 4096 };
+	PackedStateHashTable table;
+	PackedStateMap *linear;
+	PackedState *keys;
+	int32_t s, i, k, count;
+	uint64_t start, end;
+	uintptr_t sink = 0;
+	double hashNS, linearNS;
+
+	printf("entries,hashtable_ns_per_fetch,linear_ns_per_fetch\n");
+	for (s = 0; s < (int32_t) SDL_arraysize(sizes); s += 1)
+	{
+		count = sizes[s];
+		SDL_zero(table);
+		linear = (PackedStateMap*) SDL_malloc(sizeof(PackedStateMap) * count);
+		keys = (PackedState*) SDL_malloc(sizeof(PackedState) * count);
+
+		for (i = 0; i < count; i += 1)
+		{
+			keys[i] = GetPackedSamplerState(MakeSampler(i));
+			linear[i].key = keys[i];
+			linear[i].value = (void*) (uintptr_t) (i + 1);
+			PackedStateHashTable_Insert(&table, keys[i], linear[i].value);
+		}
+
+		/* Stride through the keys so every entry is hit equally */
+		start = SDL_GetPerformanceCounter();
+		for (i = 0, k = 0; i < NUM_FETCHES; i += 1)
+		{
+			sink += (uintptr_t) PackedStateHashTable_Fetch(
+				&table,
+				keys[k]
+			);
+			k = (k + 7919) % count;
+		}
+		end = SDL_GetPerformanceCounter();
+		hashNS = ElapsedNS(start, end) / NUM_FETCHES;
+
+		start = SDL_GetPerformanceCounter();
+		for (i = 0, k = 0; i < NUM_FETCHES; i += 1)
+		{
+			sink += (uintptr_t) LinearFetch(
+				linear,
+				count,
+				keys[k]
+			);
+			k = (k + 7919) % count;
+		}
+		end = SDL_GetPerformanceCounter();
+		linearNS = ElapsedNS(start, end) / NUM_FETCHES;
+
+		printf("%d,%.2f,%.2f\n", count, hashNS, linearNS);
+
+		SDL_free(table.elements);
+		SDL_free(linear);
+		SDL_free(keys);
+	}
+
+	/* Keep the fetches from being optimized out */
+	return (sink == 0) ? 1 : 0;
+}
+
+/* vim: set noexpandtab shiftwidth=8 tabstop=8: */
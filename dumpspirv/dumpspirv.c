@@ -28,14 +28,22 @@
 #define __MOJOSHADER_INTERNAL__ 1
 #include <mojoshader_internal.h>
 #include <FNA3D.h>
+#include "FNA3D_PipelineManifest.h"
+#include "FNA3D_TraceStream.h"
 
 static uint8_t compileFromFXB(const char *filename, const char *folder, SDL_IOStream *ops);
-static uint8_t compileFromTrace(const char *filename, const char *folder, SDL_IOStream *ops);
+static uint8_t compileFromTrace(
+	const char *filename,
+	const char *folder,
+	const char *pipelinesPath,
+	SDL_IOStream *ops
+);
 
 int main(int argc, char** argv)
 {
 	int arg;
 	char *folder;
+	uint8_t pipelines = 0;
 	unsigned char buf[4];
 	SDL_IOStream *ops;
 
@@ -48,13 +56,19 @@ int main(int argc, char** argv)
 			SDL_Log("FNA3D_Trace.bin not found");
 			return 1;
 		}
-		compileFromTrace(folder, SDL_GetPrefPath("FNA3D", "DumpSPIRV"), ops);
+		compileFromTrace(folder, SDL_GetPrefPath("FNA3D", "DumpSPIRV"), NULL, ops);
 		SDL_CloseIO(ops);
 		return 0;
 	}
 
 	for (arg = 1; arg < argc; arg += 1)
 	{
+		if (SDL_strcmp(argv[arg], "--pipelines") == 0)
+		{
+			pipelines = 1;
+			continue;
+		}
+
 		ops = SDL_IOFromFile(argv[arg], "rb");
 		if (ops == NULL)
 		{
@@ -69,6 +83,23 @@ int main(int argc, char** argv)
 		}
 		SDL_SeekIO(ops, 0, SDL_IO_SEEK_SET);
 
+		if (pipelines)
+		{
+			if (	((buf[0] == 0x01) && (buf[1] == 0x09) && (buf[2] == 0xFF) && (buf[3] == 0xFE)) ||
+				((buf[0] == 0xCF) && (buf[1] == 0x0B) && (buf[2] == 0xF0) && (buf[3] == 0xBC))	)
+			{
+				SDL_Log("%s is an effect, pipelines need a trace, ignoring", argv[arg]);
+			}
+			else
+			{
+				SDL_asprintf(&folder, "%s.pipelines", argv[arg]);
+				compileFromTrace(argv[arg], NULL, folder, ops);
+				SDL_free(folder);
+			}
+			SDL_CloseIO(ops);
+			continue;
+		}
+
 		SDL_asprintf(&folder, "%s.spirv", argv[arg]);
 		SDL_CreateDirectory(folder);
 
@@ -79,7 +110,7 @@ int main(int argc, char** argv)
 		}
 		else
 		{
-			compileFromTrace(argv[arg], folder, ops);
+			compileFromTrace(argv[arg], folder, NULL, ops);
 		}
 
 		SDL_free(folder);
@@ -316,40 +347,158 @@ static uint8_t compileFromFXB(const char *filename, const char *folder, SDL_IOSt
  * FNA3D Trace Compiler
  */
 
-/* This is ripped from FNA3D_Driver.h */
-static inline MOJOSHADER_usage VertexAttribUsage(
-	FNA3D_VertexElementUsage usage
+/* Pipeline Manifest Recorder, see FNA3D_PipelineManifest.h */
+
+typedef struct RecordedPipeline
+{
+	uint32_t offset;
+	uint32_t length;
+	uint32_t crc;
+} RecordedPipeline;
+
+typedef struct PipelineRecorder
+{
+	uint8_t *entries;
+	uint32_t length;
+	uint32_t capacity;
+	uint8_t *scratch;
+	uint32_t scratchLength;
+	uint32_t scratchCapacity;
+	RecordedPipeline *pipelines;
+	uint32_t count;
+} PipelineRecorder;
+
+static uint16_t findShaderObject(
+	MOJOSHADER_effect *effect,
+	TraceShader *shader,
+	MOJOSHADER_symbolType type
 ) {
-	switch (usage)
+	int i;
+	for (i = 0; i < effect->object_count; i += 1)
 	{
-		case FNA3D_VERTEXELEMENTUSAGE_POSITION:
-			return MOJOSHADER_USAGE_POSITION;
-		case FNA3D_VERTEXELEMENTUSAGE_COLOR:
-			return MOJOSHADER_USAGE_COLOR;
-		case FNA3D_VERTEXELEMENTUSAGE_TEXTURECOORDINATE:
-			return MOJOSHADER_USAGE_TEXCOORD;
-		case FNA3D_VERTEXELEMENTUSAGE_NORMAL:
-			return MOJOSHADER_USAGE_NORMAL;
-		case FNA3D_VERTEXELEMENTUSAGE_BINORMAL:
-			return MOJOSHADER_USAGE_BINORMAL;
-		case FNA3D_VERTEXELEMENTUSAGE_TANGENT:
-			return MOJOSHADER_USAGE_TANGENT;
-		case FNA3D_VERTEXELEMENTUSAGE_BLENDINDICES:
-			return MOJOSHADER_USAGE_BLENDINDICES;
-		case FNA3D_VERTEXELEMENTUSAGE_BLENDWEIGHT:
-			return MOJOSHADER_USAGE_BLENDWEIGHT;
-		case FNA3D_VERTEXELEMENTUSAGE_FOG:
-			return MOJOSHADER_USAGE_FOG;
-		case FNA3D_VERTEXELEMENTUSAGE_POINTSIZE:
-			return MOJOSHADER_USAGE_POINTSIZE;
-		case FNA3D_VERTEXELEMENTUSAGE_SAMPLE:
-			return MOJOSHADER_USAGE_SAMPLE;
-		case FNA3D_VERTEXELEMENTUSAGE_TESSELATEFACTOR:
-			return MOJOSHADER_USAGE_TESSFACTOR;
-		default:
-			SDL_assert(!"Unrecognized VertexElementUsage!");
-			return (MOJOSHADER_usage) 0;
+		if (	effect->objects[i].type == type &&
+			!effect->objects[i].shader.is_preshader &&
+			effect->objects[i].shader.shader == shader	)
+		{
+			return (uint16_t) i;
+		}
 	}
+	return 0xFFFF;
+}
+
+static void recordPipeline(
+	PipelineRecorder *recorder,
+	FNA3D_PipelineManifestEntry *entry,
+	MOJOSHADER_effect *effect,
+	TraceContext *traceCtx,
+	FNA3D_PresentationParameters *backbuffer
+) {
+	RecordedPipeline *pipeline;
+	uint32_t crc, i;
+
+	if (	effect == NULL ||
+		traceCtx->vertex == NULL ||
+		traceCtx->fragment == NULL ||
+		entry->bindings == NULL	)
+	{
+		return;
+	}
+	entry->vertexShaderObject = findShaderObject(
+		effect,
+		traceCtx->vertex,
+		MOJOSHADER_SYMTYPE_VERTEXSHADER
+	);
+	entry->pixelShaderObject = findShaderObject(
+		effect,
+		traceCtx->fragment,
+		MOJOSHADER_SYMTYPE_PIXELSHADER
+	);
+	if (	entry->vertexShaderObject == 0xFFFF ||
+		entry->pixelShaderObject == 0xFFFF	)
+	{
+		return;
+	}
+
+	if (backbuffer != NULL)
+	{
+		entry->colorFormatCount = 1;
+		entry->colorFormats[0] = backbuffer->backBufferFormat;
+		entry->depthFormat = backbuffer->depthStencilFormat;
+		entry->multiSampleCount = backbuffer->multiSampleCount;
+	}
+
+	/* Most draws repeat a pipeline we already have */
+	recorder->scratchLength = 0;
+	FNA3D_PipelineManifest_WriteEntry(
+		entry,
+		&recorder->scratch,
+		&recorder->scratchLength,
+		&recorder->scratchCapacity
+	);
+	crc = SDL_crc32(0, recorder->scratch, recorder->scratchLength);
+	for (i = 0; i < recorder->count; i += 1)
+	{
+		pipeline = &recorder->pipelines[i];
+		if (	pipeline->crc == crc &&
+			pipeline->length == recorder->scratchLength &&
+			SDL_memcmp(
+				recorder->entries + pipeline->offset,
+				recorder->scratch,
+				recorder->scratchLength
+			) == 0	)
+		{
+			return;
+		}
+	}
+
+	recorder->pipelines = (RecordedPipeline*) SDL_realloc(
+		recorder->pipelines,
+		sizeof(RecordedPipeline) * (recorder->count + 1)
+	);
+	pipeline = &recorder->pipelines[recorder->count];
+	pipeline->offset = recorder->length;
+	pipeline->length = recorder->scratchLength;
+	pipeline->crc = crc;
+	recorder->count += 1;
+	FNA3D_PipelineManifest_WriteEntry(
+		entry,
+		&recorder->entries,
+		&recorder->length,
+		&recorder->capacity
+	);
+	SDL_Log("New pipeline, effect crc %x\n", entry->effectHash);
+}
+
+static void writePipelines(PipelineRecorder *recorder, const char *path)
+{
+	SDL_IOStream *manifestFile;
+	uint32_t header[3] =
+	{
+		FNA3D_PIPELINEMANIFEST_MAGIC,
+		FNA3D_PIPELINEMANIFEST_VERSION,
+		recorder->count
+	};
+
+	manifestFile = SDL_IOFromFile(path, "wb");
+	if (manifestFile == NULL)
+	{
+		SDL_Log("Could not write %s", path);
+		return;
+	}
+	SDL_WriteIO(manifestFile, header, sizeof(header));
+	SDL_WriteIO(manifestFile, recorder->entries, recorder->length);
+	SDL_CloseIO(manifestFile);
+	SDL_Log("Wrote %u pipelines to %s", recorder->count, path);
+}
+
+static void freeBindings(FNA3D_VertexBufferBinding *bindings, int32_t numBindings)
+{
+	int32_t i;
+	for (i = 0; i < numBindings; i += 1)
+	{
+		SDL_free(bindings[i].vertexDeclaration.elements);
+	}
+	SDL_free(bindings);
 }
 
 /* Everything below is a horrible ripoff of FNA3D_Replay!
@@ -415,11 +564,23 @@ static inline MOJOSHADER_usage VertexAttribUsage(
 #define MARK_QUERYPIXELCOUNT			55
 #define MARK_SETSTRINGMARKER			56
 
-static uint8_t compileFromTrace(const char *filename, const char *folder, SDL_IOStream *ops)
+static size_t ReadTrace(void *io, void *dst, size_t length)
 {
-	#define READ(val) SDL_ReadIO(ops, &val, sizeof(val))
+	return SDL_ReadIO((SDL_IOStream*) io, dst, length);
+}
+
+/* With pipelinesPath set, a pipeline manifest is written instead of SPIR-V */
+static uint8_t compileFromTrace(
+	const char *filename,
+	const char *folder,
+	const char *pipelinesPath,
+	SDL_IOStream *ops
+) {
+	#define READ(val) FNA3D_TraceReader_Read(&reader, &val, sizeof(val))
+	#define READMEM(ptr, len) FNA3D_TraceReader_ReadBlob(&reader, ptr, len)
 
 	TraceContext traceCtx;
+	FNA3D_TraceReader reader;
 	const MOJOSHADER_effectShaderContext ctx =
 	{
 		compileShader,
@@ -597,11 +758,37 @@ static uint8_t compileFromTrace(const char *filename, const char *folder, SDL_IO
 	uint32_t numPasses;
 	MOJOSHADER_effectStateChanges stateChanges;
 
+	/* Pipeline manifest objects, entry holds the current draw state */
+	PipelineRecorder recorder;
+	FNA3D_PipelineManifestEntry entry;
+	FNA3D_VertexBufferBinding *drawBindings = NULL;
+	int32_t drawNumBindings = 0;
+	uint32_t *traceEffectHash = NULL;
+	FNA3D_SurfaceFormat *traceTextureFormat = NULL;
+	MOJOSHADER_effect *boundEffect = NULL;
+	MOJOSHADER_effect *restoreEffect = NULL;
+	uint32_t restoreEffectHash = 0;
+	uint32_t effectHash;
+	uint8_t onBackbuffer = 1;
+
+	SDL_zero(traceCtx);
+	SDL_zero(recorder);
+	SDL_zero(entry);
+	entry.multiSampleMask = -1;
+
 	/* Beginning of the file should be a CreateDevice call */
-	READ(mark);
+	if (FNA3D_TraceReader_Init(&reader, ReadTrace, ops))
+	{
+		READ(mark);
+	}
+	else
+	{
+		mark = MARK_DESTROYDEVICE;
+	}
 	if (mark != MARK_CREATEDEVICE)
 	{
 		SDL_Log("%s is a bad trace!", filename);
+		FNA3D_TraceReader_Destroy(&reader);
 		return 0;
 	}
 	READ(presentationParameters.backBufferWidth);
@@ -658,6 +845,17 @@ static uint8_t compileFromTrace(const char *filename, const char *folder, SDL_IO
 			READ(primitiveCount);
 			READ(i);
 			READ(indexElementSize);
+			if (pipelinesPath != NULL)
+			{
+				entry.primitiveType = primitiveType;
+				recordPipeline(
+					&recorder,
+					&entry,
+					boundEffect,
+					&traceCtx,
+					onBackbuffer ? &presentationParameters : NULL
+				);
+			}
 			break;
 		case MARK_DRAWINSTANCEDPRIMITIVES:
 			READ(primitiveType);
@@ -669,11 +867,33 @@ static uint8_t compileFromTrace(const char *filename, const char *folder, SDL_IO
 			READ(instanceCount);
 			READ(i);
 			READ(indexElementSize);
+			if (pipelinesPath != NULL)
+			{
+				entry.primitiveType = primitiveType;
+				recordPipeline(
+					&recorder,
+					&entry,
+					boundEffect,
+					&traceCtx,
+					onBackbuffer ? &presentationParameters : NULL
+				);
+			}
 			break;
 		case MARK_DRAWPRIMITIVES:
 			READ(primitiveType);
 			READ(vertexStart);
 			READ(primitiveCount);
+			if (pipelinesPath != NULL)
+			{
+				entry.primitiveType = primitiveType;
+				recordPipeline(
+					&recorder,
+					&entry,
+					boundEffect,
+					&traceCtx,
+					onBackbuffer ? &presentationParameters : NULL
+				);
+			}
 			break;
 		case MARK_SETVIEWPORT:
 			READ(viewport.x);
@@ -697,6 +917,7 @@ static uint8_t compileFromTrace(const char *filename, const char *folder, SDL_IO
 			break;
 		case MARK_SETMULTISAMPLEMASK:
 			READ(mask);
+			entry.multiSampleMask = mask;
 			break;
 		case MARK_SETREFERENCESTENCIL:
 			READ(ref);
@@ -717,6 +938,8 @@ static uint8_t compileFromTrace(const char *filename, const char *folder, SDL_IO
 			READ(blendState.blendFactor.b);
 			READ(blendState.blendFactor.a);
 			READ(blendState.multiSampleMask);
+			entry.blendState = blendState;
+			entry.multiSampleMask = blendState.multiSampleMask;
 			break;
 		case MARK_SETDEPTHSTENCILSTATE:
 			READ(depthStencilState.depthBufferEnable);
@@ -735,6 +958,7 @@ static uint8_t compileFromTrace(const char *filename, const char *folder, SDL_IO
 			READ(depthStencilState.ccwStencilPass);
 			READ(depthStencilState.ccwStencilFunction);
 			READ(depthStencilState.referenceStencil);
+			entry.depthStencilState = depthStencilState;
 			break;
 		case MARK_APPLYRASTERIZERSTATE:
 			READ(rasterizerState.fillMode);
@@ -743,6 +967,7 @@ static uint8_t compileFromTrace(const char *filename, const char *folder, SDL_IO
 			READ(rasterizerState.slopeScaleDepthBias);
 			READ(rasterizerState.scissorTestEnable);
 			READ(rasterizerState.multiSampleAntiAlias);
+			entry.rasterizerState = rasterizerState;
 			break;
 		case MARK_VERIFYSAMPLER:
 			READ(index);
@@ -799,6 +1024,17 @@ static uint8_t compileFromTrace(const char *filename, const char *folder, SDL_IO
 			READ(bindingsUpdated);
 			READ(baseVertex);
 
+			/* Pipelines are recorded at draw time, keep these until then */
+			if (pipelinesPath != NULL)
+			{
+				freeBindings(drawBindings, drawNumBindings);
+				drawBindings = bindings;
+				drawNumBindings = numBindings;
+				entry.bindings = drawBindings;
+				entry.numBindings = drawNumBindings;
+				break;
+			}
+
 			vtxDecl = (MOJOSHADER_vertexAttribute*) SDL_malloc(
 				sizeof(MOJOSHADER_vertexAttribute) * numElements
 			);
@@ -864,12 +1100,7 @@ static uint8_t compileFromTrace(const char *filename, const char *folder, SDL_IO
 			}
 			SDL_free(shaderPath);
 
-			for (vi = 0; vi < numBindings; vi += 1)
-			{
-				binding = &bindings[vi];
-				SDL_free(binding->vertexDeclaration.elements);
-			}
-			SDL_free(bindings);
+			freeBindings(bindings, numBindings);
 			break;
 		case MARK_SETRENDERTARGETS:
 			READ(numRenderTargets);
@@ -907,10 +1138,12 @@ static uint8_t compileFromTrace(const char *filename, const char *folder, SDL_IO
 					{
 						READ(i);
 						target->texture = traceTexture[i];
+						entry.colorFormats[ri] = traceTextureFormat[i];
 					}
 					else
 					{
 						target->texture = NULL;
+						entry.colorFormats[ri] = FNA3D_SURFACEFORMAT_COLOR;
 					}
 
 					READ(nonNull);
@@ -924,7 +1157,14 @@ static uint8_t compileFromTrace(const char *filename, const char *folder, SDL_IO
 						target->colorBuffer = NULL;
 					}
 				}
+
+				/* Only multisampled targets get a color buffer */
+				entry.multiSampleCount = (renderTargets[0].colorBuffer != NULL) ?
+					renderTargets[0].multiSampleCount :
+					0;
 			}
+			entry.colorFormatCount = numRenderTargets;
+			onBackbuffer = (numRenderTargets == 0);
 
 			READ(nonNull);
 			if (nonNull)
@@ -939,6 +1179,9 @@ static uint8_t compileFromTrace(const char *filename, const char *folder, SDL_IO
 
 			READ(depthFormat);
 			READ(preserveTargetContents);
+			entry.depthFormat = (depthStencilBuffer != NULL) ?
+				depthFormat :
+				FNA3D_DEPTHFORMAT_NONE;
 
 			SDL_free(renderTargets);
 			break;
@@ -1008,6 +1251,11 @@ static uint8_t compileFromTrace(const char *filename, const char *folder, SDL_IO
 			READ(isRenderTarget);
 			texture = (FNA3D_Texture*) 0xDEADBEEF;
 			REGISTER_OBJECT(Texture, Texture, texture)
+			traceTextureFormat = (FNA3D_SurfaceFormat*) SDL_realloc(
+				traceTextureFormat,
+				sizeof(FNA3D_SurfaceFormat) * traceTextureCount
+			);
+			traceTextureFormat[i] = format;
 			break;
 		case MARK_CREATETEXTURE3D:
 			READ(format);
@@ -1017,6 +1265,11 @@ static uint8_t compileFromTrace(const char *filename, const char *folder, SDL_IO
 			READ(levelCount);
 			texture = (FNA3D_Texture*) 0xDEADBEEF;
 			REGISTER_OBJECT(Texture, Texture, texture)
+			traceTextureFormat = (FNA3D_SurfaceFormat*) SDL_realloc(
+				traceTextureFormat,
+				sizeof(FNA3D_SurfaceFormat) * traceTextureCount
+			);
+			traceTextureFormat[i] = format;
 			break;
 		case MARK_CREATETEXTURECUBE:
 			READ(format);
@@ -1025,6 +1278,11 @@ static uint8_t compileFromTrace(const char *filename, const char *folder, SDL_IO
 			READ(isRenderTarget);
 			texture = (FNA3D_Texture*) 0xDEADBEEF;
 			REGISTER_OBJECT(Texture, Texture, texture)
+			traceTextureFormat = (FNA3D_SurfaceFormat*) SDL_realloc(
+				traceTextureFormat,
+				sizeof(FNA3D_SurfaceFormat) * traceTextureCount
+			);
+			traceTextureFormat[i] = format;
 			break;
 		case MARK_ADDDISPOSETEXTURE:
 			READ(i);
@@ -1038,7 +1296,7 @@ static uint8_t compileFromTrace(const char *filename, const char *folder, SDL_IO
 			READ(h);
 			READ(level);
 			READ(dataLength);
-			SDL_SeekIO(ops, dataLength, SDL_IO_SEEK_CUR);
+			READMEM(NULL, dataLength);
 			break;
 		case MARK_SETTEXTUREDATA3D:
 			READ(i);
@@ -1050,7 +1308,7 @@ static uint8_t compileFromTrace(const char *filename, const char *folder, SDL_IO
 			READ(d);
 			READ(level);
 			READ(dataLength);
-			SDL_SeekIO(ops, dataLength, SDL_IO_SEEK_CUR);
+			READMEM(NULL, dataLength);
 			break;
 		case MARK_SETTEXTUREDATACUBE:
 			READ(i);
@@ -1061,7 +1319,7 @@ static uint8_t compileFromTrace(const char *filename, const char *folder, SDL_IO
 			READ(cubeMapFace);
 			READ(level);
 			READ(dataLength);
-			SDL_SeekIO(ops, dataLength, SDL_IO_SEEK_CUR);
+			READMEM(NULL, dataLength);
 			break;
 		case MARK_SETTEXTUREDATAYUV:
 			READ(i);
@@ -1072,7 +1330,7 @@ static uint8_t compileFromTrace(const char *filename, const char *folder, SDL_IO
 			READ(w);
 			READ(h);
 			READ(dataLength);
-			SDL_SeekIO(ops, dataLength, SDL_IO_SEEK_CUR);
+			READMEM(NULL, dataLength);
 			break;
 		case MARK_GETTEXTUREDATA2D:
 			READ(i);
@@ -1152,7 +1410,7 @@ static uint8_t compileFromTrace(const char *filename, const char *folder, SDL_IO
 			READ(elementSizeInBytes);
 			READ(vertexStride);
 			READ(dataOptions);
-			SDL_SeekIO(ops, vertexStride * elementCount, SDL_IO_SEEK_CUR);
+			READMEM(NULL, vertexStride * elementCount);
 			break;
 		case MARK_GETVERTEXBUFFERDATA:
 			READ(i);
@@ -1177,7 +1435,7 @@ static uint8_t compileFromTrace(const char *filename, const char *folder, SDL_IO
 			READ(offsetInBytes);
 			READ(dataLength);
 			READ(dataOptions);
-			SDL_SeekIO(ops, dataLength, SDL_IO_SEEK_CUR);
+			READMEM(NULL, dataLength);
 			break;
 		case MARK_GETINDEXBUFFERDATA:
 			READ(i);
@@ -1187,7 +1445,7 @@ static uint8_t compileFromTrace(const char *filename, const char *folder, SDL_IO
 		case MARK_CREATEEFFECT:
 			READ(dataLength);
 			miscBuffer = SDL_malloc(dataLength);
-			SDL_ReadIO(ops, miscBuffer, dataLength);
+			READMEM(miscBuffer, dataLength);
 			effect = (FNA3D_Effect*) 0xDEADBEEF;
 			effectData = MOJOSHADER_compileEffect(
 				(const unsigned char*) miscBuffer,
@@ -1198,6 +1456,7 @@ static uint8_t compileFromTrace(const char *filename, const char *folder, SDL_IO
 				0,
 				&ctx
 			);
+			effectHash = SDL_crc32(0, miscBuffer, dataLength);
 			SDL_free(miscBuffer);
 			for (i = 0; i < traceEffectCount; i += 1)
 			{
@@ -1222,11 +1481,17 @@ static uint8_t compileFromTrace(const char *filename, const char *folder, SDL_IO
 				traceEffect[i] = effect;
 				traceEffectData[i] = effectData;
 			}
+			traceEffectHash = (uint32_t*) SDL_realloc(
+				traceEffectHash,
+				sizeof(uint32_t) * traceEffectCount
+			);
+			traceEffectHash[i] = effectHash;
 			break;
 		case MARK_CLONEEFFECT:
 			READ(i);
 			effect = (FNA3D_Effect*) 0xDEADBEEF;
 			effectData = MOJOSHADER_cloneEffect(traceEffectData[i]);
+			effectHash = traceEffectHash[i]; /* Clones share shaders */
 			for (i = 0; i < traceEffectCount; i += 1)
 			{
 				if (traceEffect[i] == NULL)
@@ -1250,9 +1515,22 @@ static uint8_t compileFromTrace(const char *filename, const char *folder, SDL_IO
 				traceEffect[i] = effect;
 				traceEffectData[i] = effectData;
 			}
+			traceEffectHash = (uint32_t*) SDL_realloc(
+				traceEffectHash,
+				sizeof(uint32_t) * traceEffectCount
+			);
+			traceEffectHash[i] = effectHash;
 			break;
 		case MARK_ADDDISPOSEEFFECT:
 			READ(i);
+			if (boundEffect == traceEffectData[i])
+			{
+				boundEffect = NULL;
+			}
+			if (restoreEffect == traceEffectData[i])
+			{
+				restoreEffect = NULL;
+			}
 			MOJOSHADER_deleteEffect(traceEffectData[i]);
 			traceEffect[i] = NULL;
 			traceEffectData[i] = NULL;
@@ -1270,10 +1548,11 @@ static uint8_t compileFromTrace(const char *filename, const char *folder, SDL_IO
 			READ(i);
 			READ(pass);
 			effectData = traceEffectData[i];
+			boundEffect = effectData;
+			entry.effectHash = traceEffectHash[i];
 			for (vi = 0; vi < effectData->param_count; vi += 1)
 			{
-				SDL_ReadIO(
-					ops,
+				READMEM(
 					effectData->params[vi].value.values,
 					effectData->params[vi].value.value_count * 4
 				);
@@ -1319,6 +1598,10 @@ static uint8_t compileFromTrace(const char *filename, const char *folder, SDL_IO
 		case MARK_BEGINPASSRESTORE:
 			READ(i);
 			effectData = traceEffectData[i];
+			restoreEffect = boundEffect;
+			restoreEffectHash = entry.effectHash;
+			boundEffect = effectData;
+			entry.effectHash = traceEffectHash[i];
 			MOJOSHADER_effectBegin(
 				effectData,
 				&numPasses,
@@ -1332,6 +1615,8 @@ static uint8_t compileFromTrace(const char *filename, const char *folder, SDL_IO
 			effectData = traceEffectData[i];
 			MOJOSHADER_effectEndPass(effectData);
 			MOJOSHADER_effectEnd(effectData);
+			boundEffect = restoreEffect;
+			entry.effectHash = restoreEffectHash;
 			break;
 		case MARK_CREATEQUERY:
 			query = (FNA3D_Query*) 0xDEADBEEF;
@@ -1352,7 +1637,7 @@ static uint8_t compileFromTrace(const char *filename, const char *folder, SDL_IO
 			break;
 		case MARK_SETSTRINGMARKER:
 			READ(dataLength);
-			SDL_SeekIO(ops, dataLength, SDL_IO_SEEK_CUR);
+			READMEM(NULL, dataLength);
 			break;
 		case MARK_CREATEDEVICE:
 		case MARK_DESTROYDEVICE:
@@ -1362,10 +1647,26 @@ static uint8_t compileFromTrace(const char *filename, const char *folder, SDL_IO
 			SDL_assert(0 && "Unrecognized mark!");
 			break;
 		}
-		READ(mark);
+		if (READ(mark) < sizeof(mark))
+		{
+			/* Truncated trace, the game probably crashed */
+			mark = MARK_DESTROYDEVICE;
+		}
+	}
+
+	if (pipelinesPath != NULL)
+	{
+		writePipelines(&recorder, pipelinesPath);
 	}
 
 	/* Clean up. We out. */
+	FNA3D_TraceReader_Destroy(&reader);
+	freeBindings(drawBindings, drawNumBindings);
+	SDL_free(recorder.entries);
+	SDL_free(recorder.scratch);
+	SDL_free(recorder.pipelines);
+	SDL_free(traceEffectHash);
+	SDL_free(traceTextureFormat);
 	#define FREE_TRACES(type) \
 		if (trace##type##Count > 0) \
 		{ \
@@ -1383,5 +1684,6 @@ static uint8_t compileFromTrace(const char *filename, const char *folder, SDL_IO
 	return !run;
 
 	#undef REGISTER_OBJECT
+	#undef READMEM
 	#undef READ
 }
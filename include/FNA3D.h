@@ -64,6 +64,7 @@ typedef struct FNA3D_Buffer FNA3D_Buffer;
 typedef struct FNA3D_Renderbuffer FNA3D_Renderbuffer;
 typedef struct FNA3D_Effect FNA3D_Effect;
 typedef struct FNA3D_Query FNA3D_Query;
+typedef struct FNA3D_Readback FNA3D_Readback;
 
 /* Enumerations, should match XNA 4.0 */
 
@@ -1134,6 +1135,54 @@ FNA3DAPI void FNA3D_GetTextureDataCube(
 	int32_t dataLength
 );
 
+/* Starts copying image data from a 2D texture, or from the backbuffer, without
+ * waiting for the GPU to catch up. The data usually arrives a frame or two
+ * later; call FNA3D_PollReadback once per frame until it does. Renderers that
+ * can't read asynchronously (or formats they can't read that way) read right
+ * away instead, in which case the first poll succeeds.
+ *
+ * Both this and FNA3D_PollReadback should be called from the same thread
+ * that presents, and every readback must be polled to completion or canceled
+ * before the device is destroyed.
+ *
+ * texture:	The texture object being read, or NULL for the backbuffer.
+ * x:		The x offset of the subregion being read.
+ * y:		The y offset of the subregion being read.
+ * w:		The width of the subregion being read.
+ * h:		The height of the subregion being read.
+ * level:	The mipmap level being read, ignored for the backbuffer.
+ * dataLength:	The size of the image data in bytes.
+ *
+ * Returns a readback to poll, or NULL on failure.
+ */
+FNA3DAPI FNA3D_Readback* FNA3D_RequestTextureDataAsync(
+	FNA3D_Device *device,
+	FNA3D_Texture *texture,
+	int32_t x,
+	int32_t y,
+	int32_t w,
+	int32_t h,
+	int32_t level,
+	int32_t dataLength
+);
+
+/* Checks whether a readback has finished, and if so copies out its data and
+ * frees it. The readback may not be used again once this returns 1.
+ *
+ * readback:	A readback from FNA3D_RequestTextureDataAsync.
+ * data:	The pointer being filled with the image data. Pass NULL to
+ *		cancel the readback, which always returns 1.
+ * dataLength:	The size of data in bytes.
+ *
+ * Returns 1 if the readback is finished (or canceled), 0 if it is pending.
+ */
+FNA3DAPI uint8_t FNA3D_PollReadback(
+	FNA3D_Device *device,
+	FNA3D_Readback *readback,
+	void* data,
+	int32_t dataLength
+);
+
 /* Renderbuffers */
 
 /* Creates a color buffer to be used by SetRenderTargets/ResolveTarget.
@@ -1266,6 +1315,44 @@ FNA3DAPI void FNA3D_GetVertexBufferData(
 	int32_t vertexStride
 );
 
+/* Maps a region of the vertex buffer for writing, so that vertices can be
+ * built in place rather than copied in with SetVertexBufferData. Where the
+ * renderer allows it, the pointer goes straight into upload memory (the
+ * transfer buffer for SDL_GPU, the persistent or mapped range for OpenGL, the
+ * mapped buffer for D3D11 and dynamic Vulkan buffers); otherwise it points to
+ * staging memory that is written with SetVertexBufferData on unmap.
+ *
+ * The mapped memory is write-only and its initial contents are undefined.
+ * Only one range may be mapped at a time, and it must be unmapped before any
+ * other call is made to the device.
+ *
+ * buffer:		The vertex buffer to be updated.
+ * offsetInBytes:	The starting offset of the buffer to write into.
+ * lengthInBytes:	The size of the region to write.
+ * options:		Same as SetVertexBufferData; DISCARD gives up the rest
+ *			of the buffer's contents, NOOVERWRITE promises that
+ *			pending draws do not use this region.
+ *
+ * Returns a pointer to lengthInBytes of writable memory, or NULL on failure.
+ */
+FNA3DAPI void* FNA3D_MapVertexBufferRange(
+	FNA3D_Device *device,
+	FNA3D_Buffer *buffer,
+	int32_t offsetInBytes,
+	int32_t lengthInBytes,
+	FNA3D_SetDataOptions options
+);
+
+/* Finishes a write started with MapVertexBufferRange. The pointer it returned
+ * may not be used after this call.
+ *
+ * buffer: The vertex buffer that was mapped.
+ */
+FNA3DAPI void FNA3D_UnmapVertexBufferRange(
+	FNA3D_Device *device,
+	FNA3D_Buffer *buffer
+);
+
 /* Index Buffers */
 
 /* Creates an index buffer to be used by Draw*Primitives.
@@ -1366,6 +1453,30 @@ FNA3DAPI void FNA3D_CloneEffect(
 	MOJOSHADER_effect **effectData
 );
 
+/* Loads a pipeline manifest written by `fna3d_dumpspirv --pipelines`, so that
+ * every pipeline recorded in it is compiled on a background thread as soon as
+ * the effect it belongs to is created, rather than on the first draw.
+ *
+ * Call this once, before loading content: effects created before the call are
+ * not prewarmed. Only the SDL_GPU and Vulkan renderers make use of manifests;
+ * the others accept and ignore them. This call is not traced.
+ *
+ * Pipelines missing from the manifest are still created on the draw that needs
+ * them. With the SDL_GPU renderer, setting the FNA3D_ASYNC_PIPELINES
+ * environment variable to "1" sends those to the background thread as well,
+ * skipping the draws that need them until they are ready.
+ *
+ * manifest:		The manifest file contents, copied by the renderer.
+ * manifestLength:	The size (in bytes) of the manifest.
+ *
+ * Returns 1 if the manifest was accepted, 0 if it is invalid.
+ */
+FNA3DAPI uint8_t FNA3D_PrewarmPipelines(
+	FNA3D_Device *device,
+	uint8_t *manifest,
+	uint32_t manifestLength
+);
+
 /* Sends an Effect to be destroyed by the renderer. Note that we call it
  * "AddDispose" because it may not be immediately destroyed by the renderer if
  * this is not called from the main thread (for example, if a garbage collector
@@ -1521,6 +1632,110 @@ FNA3DAPI int32_t FNA3D_GetMaxMultiSampleCount(
 	int32_t multiSampleCount
 );
 
+/* Performance Counters */
+
+#define FNA3D_PERFCOUNTERS_VERSION 4
+
+/* Frame pacing error is bucketed by how late each frame was released:
+ * <50us, <100us, <250us, <500us, <1ms, <2ms, <4ms, and everything else.
+ */
+#define FNA3D_PACE_HISTOGRAM_BUCKETS 8
+
+/* One set of counters, either for a sampling window or since device creation.
+ * Map writes cover any upload that avoided a driver-side copy (mapped ranges,
+ * persistent rings, transfer buffers); SubData writes cover everything else.
+ * Pipeline misses are draws whose pipeline was not ready yet; async hits are
+ * the misses served by the background compiler instead, and the stall time is
+ * how long draws waited on pipeline creation either way.
+ * Transfer pool hits and misses count uploads too big for the regular upload
+ * space, by whether a pooled transfer buffer could be reused for them; the
+ * peak is the most pooled transfer memory alive at once, not a sum. Forced
+ * upload flushes are mid-frame submits made only to free up upload space.
+ * Stream ring stalls are discards that found the next slice of a persistent
+ * buffer ring still in use by the GPU.
+ */
+typedef struct FNA3D_PerfCounterSet
+{
+	uint64_t frameCount;
+	uint64_t drawCalls;
+	uint64_t drawIndexedCalls;
+	uint64_t drawInstancedCalls;
+	uint64_t drawPrimitiveCalls;
+	uint64_t clearCalls;
+	uint64_t setRenderTargetCalls;
+	uint64_t applyEffectCalls;
+	uint64_t mapWrites;
+	uint64_t mapBytes;
+	uint64_t subDataWrites;
+	uint64_t subDataBytes;
+	uint64_t vertexUploadCalls;
+	uint64_t vertexUploadBytes;
+	uint64_t indexUploadCalls;
+	uint64_t indexUploadBytes;
+	uint64_t swapWaitNs;
+	uint64_t sleepNs;
+	uint64_t pipelineMisses;
+	uint64_t pipelineAsyncHits;
+	uint64_t pipelineStallNs;
+	uint64_t transferPoolHits;
+	uint64_t transferPoolMisses;
+	uint64_t transferPoolPeakBytes;
+	uint64_t forcedUploadFlushes;
+	uint64_t streamRingStalls;
+	uint64_t paceError[FNA3D_PACE_HISTOGRAM_BUCKETS];
+} FNA3D_PerfCounterSet;
+
+typedef struct FNA3D_PerfCounters
+{
+	/* Set this to FNA3D_PERFCOUNTERS_VERSION before calling */
+	uint32_t version;
+
+	/* 0 if the counters are disabled, see FNA3D_PERF_COUNTERS */
+	uint8_t enabled;
+
+	/* Length of the last completed window, in nanoseconds */
+	uint64_t windowNs;
+
+	/* Counters for the last completed window (about 250ms) */
+	FNA3D_PerfCounterSet window;
+
+	/* Counters since device creation, as of the end of the window */
+	FNA3D_PerfCounterSet total;
+} FNA3D_PerfCounters;
+
+/* Copies the most recent renderer performance counters.
+ *
+ * Counting is opt-in: set the FNA3D_PERF_COUNTERS environment variable to "1"
+ * before creating the device. When disabled, `enabled` is 0 and everything
+ * else is zeroed.
+ *
+ * The snapshot is updated by SwapBuffers, so this should be called from the
+ * same thread that presents.
+ *
+ * counters:	Filled with the latest snapshot. `version` must be set first.
+ */
+FNA3DAPI void FNA3D_GetPerfCounters(
+	FNA3D_Device *device,
+	FNA3D_PerfCounters *counters
+);
+
+/* Writes the most recent frames of the CPU timeline as a Chrome trace_event
+ * JSON file, viewable in chrome://tracing or Perfetto.
+ *
+ * Capture is opt-in: set the FNA3D_TIMELINE environment variable to "1"
+ * before creating the device. FNA3D_TIMELINE_FRAMES sets how many frames are
+ * kept (default 8), and FNA3D_TIMELINE_BUDGET_MS will automatically dump any
+ * frame that takes longer than the given time.
+ *
+ * This should be called from the same thread that presents.
+ *
+ * filename:	The output path, or NULL for FNA3D_TIMELINE_PATH + ".json".
+ *
+ * Returns 1 if the file was written, 0 if capture is disabled or the file
+ * could not be opened.
+ */
+FNA3DAPI uint8_t FNA3D_DumpTimeline(const char *filename);
+
 /* Debugging */
 
 /* Sets an arbitrary string constant to be stored in a rendering API trace,
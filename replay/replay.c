@@ -32,7 +32,8 @@
 #define SDL_Mutex SDL_mutex
 #define SDL_IOStream SDL_RWops
 #define SDL_IOFromFile SDL_RWFromFile
-#define SDL_ReadIO(a, b, c) SDL_RWread(a, b, c, 1)
+#define SDL_IOFromConstMem SDL_RWFromConstMem
+#define SDL_ReadIO(a, b, c) SDL_RWread(a, b, 1, c)
 #define SDL_CloseIO SDL_RWclose
 #define SDL_CreateWindow(a, b, c, d) \
 	SDL_CreateWindow(a, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, b, c, d)
@@ -40,6 +41,10 @@
 #endif
 #include <mojoshader.h>
 #include <FNA3D.h>
+#include "FNA3D_TraceStream.h"
+#include "replay_json.h"
+
+#include <stdio.h>
 
 #define MARK_CREATEDEVICE			0
 #define MARK_DESTROYDEVICE			1
@@ -99,6 +104,69 @@
 #define MARK_QUERYPIXELCOUNT			55
 #define MARK_SETSTRINGMARKER			56
 #define MARK_SETTEXTURENAME			57
+#define MARK_COUNT				58
+
+static const char *markNames[MARK_COUNT] =
+{
+	"CreateDevice",
+	"DestroyDevice",
+	"SwapBuffers",
+	"Clear",
+	"DrawIndexedPrimitives",
+	"DrawInstancedPrimitives",
+	"DrawPrimitives",
+	"SetViewport",
+	"SetScissorRect",
+	"SetBlendFactor",
+	"SetMultiSampleMask",
+	"SetReferenceStencil",
+	"SetBlendState",
+	"SetDepthStencilState",
+	"ApplyRasterizerState",
+	"VerifySampler",
+	"VerifyVertexSampler",
+	"ApplyVertexBufferBindings",
+	"SetRenderTargets",
+	"ResolveTarget",
+	"ResetBackbuffer",
+	"ReadBackbuffer",
+	"CreateTexture2D",
+	"CreateTexture3D",
+	"CreateTextureCube",
+	"AddDisposeTexture",
+	"SetTextureData2D",
+	"SetTextureData3D",
+	"SetTextureDataCube",
+	"SetTextureDataYUV",
+	"GetTextureData2D",
+	"GetTextureData3D",
+	"GetTextureDataCube",
+	"GenColorRenderbuffer",
+	"GenDepthStencilRenderbuffer",
+	"AddDisposeRenderbuffer",
+	"GenVertexBuffer",
+	"AddDisposeVertexBuffer",
+	"SetVertexBufferData",
+	"GetVertexBufferData",
+	"GenIndexBuffer",
+	"AddDisposeIndexBuffer",
+	"SetIndexBufferData",
+	"GetIndexBufferData",
+	"CreateEffect",
+	"CloneEffect",
+	"AddDisposeEffect",
+	"SetEffectTechnique",
+	"ApplyEffect",
+	"BeginPassRestore",
+	"EndPassRestore",
+	"CreateQuery",
+	"AddDisposeQuery",
+	"QueryBegin",
+	"QueryEnd",
+	"QueryPixelCount",
+	"SetStringMarker",
+	"SetTextureName"
+};
 
 typedef enum
 {
@@ -107,6 +175,19 @@ typedef enum
 	VSYNC_FORCE_OFF
 } VSyncMode;
 
+/* Benchmark mode: every frame is timed from the end of the previous
+ * SwapBuffers to the end of its own, and every call is timed and counted by
+ * mark. Times are in performance counter ticks until the report.
+ */
+typedef struct BenchmarkStats
+{
+	uint64_t *frameTicks;
+	size_t frameCount;
+	size_t frameCapacity;
+	uint64_t markCalls[MARK_COUNT];
+	uint64_t markTicks[MARK_COUNT];
+} BenchmarkStats;
+
 /* #define TOO_MUCH_RAM */
 #ifdef TOO_MUCH_RAM
 typedef struct FAKEIO
@@ -149,6 +230,7 @@ static size_t FAKE_ReadIO(FAKEIO *io, void *ptr, size_t size)
 	/* Size checks? Where we're going we don't need size checks */
 	SDL_memcpy(ptr, io->current, size);
 	io->current += size;
+	return size;
 }
 
 #define SDL_IOStream FAKEIO
@@ -157,22 +239,34 @@ static size_t FAKE_ReadIO(FAKEIO *io, void *ptr, size_t size)
 #define SDL_ReadIO FAKE_ReadIO
 #endif /* TOO_MUCH_RAM */
 
+static size_t ReadTrace(void *io, void *dst, size_t length)
+{
+	return SDL_ReadIO((SDL_IOStream*) io, dst, length);
+}
+
 static uint8_t replay(
 	const char *filename,
+	const void *preload,
+	size_t preloadLength,
 	uint8_t forceDebugMode,
 	VSyncMode vsync,
 	uint8_t fullscreen,
-	uint32_t delayMS
+	uint32_t delayMS,
+	uint8_t present,
+	BenchmarkStats *stats
 ) {
-	#define READ(val) SDL_ReadIO(ops, &val, sizeof(val))
+	#define READ(val) FNA3D_TraceReader_Read(&reader, &val, sizeof(val))
+	#define READMEM(ptr, len) FNA3D_TraceReader_ReadBlob(&reader, ptr, len)
 
 #ifdef USE_SDL3
 	const SDL_DisplayMode *mode;
 #endif
 	SDL_WindowFlags flags;
 	SDL_IOStream *ops;
+	FNA3D_TraceReader reader;
 	SDL_Event evt;
 	uint8_t mark, run;
+	uint64_t callStart, frameStart, now;
 
 	/* CreateDevice, ResetBackbuffer */
 	FNA3D_Device *device;
@@ -318,7 +412,16 @@ static uint8_t replay(
 		}
 
 	/* Check for the trace file */
-	ops = SDL_IOFromFile(filename, "rb");
+#ifndef TOO_MUCH_RAM
+	if (preload != NULL)
+	{
+		ops = SDL_IOFromConstMem(preload, preloadLength);
+	}
+	else
+#endif /* TOO_MUCH_RAM */
+	{
+		ops = SDL_IOFromFile(filename, "rb");
+	}
 	if (ops == NULL)
 	{
 		SDL_Log("%s not found!", filename);
@@ -326,10 +429,18 @@ static uint8_t replay(
 	}
 
 	/* Beginning of the file should be a CreateDevice call */
-	READ(mark);
+	if (FNA3D_TraceReader_Init(&reader, ReadTrace, ops))
+	{
+		READ(mark);
+	}
+	else
+	{
+		mark = MARK_DESTROYDEVICE;
+	}
 	if (mark != MARK_CREATEDEVICE)
 	{
 		SDL_Log("%s is a bad trace!", filename);
+		FNA3D_TraceReader_Destroy(&reader);
 		SDL_CloseIO(ops);
 		return 0;
 	}
@@ -355,12 +466,25 @@ static uint8_t replay(
 
 	presentationParameters.isFullScreen |= fullscreen;
 
+	/* Without presentation the frames still have to be swapped, so that
+	 * drivers submit and recycle their resources, but nobody sees them
+	 */
+	if (!present)
+	{
+		presentationParameters.presentationInterval = FNA3D_PRESENTINTERVAL_IMMEDIATE;
+		presentationParameters.isFullScreen = 0;
+	}
+
 	/* Create a window alongside the device */
 	flags = FNA3D_PrepareWindowAttributes();
 	if (presentationParameters.isFullScreen)
 	{
 		flags |= SDL_WINDOW_FULLSCREEN_DESKTOP;
 	}
+	if (!present)
+	{
+		flags |= SDL_WINDOW_HIDDEN;
+	}
 #ifdef USE_SDL3
 	flags |= SDL_WINDOW_HIGH_PIXEL_DENSITY;
 	mode = SDL_GetDesktopDisplayMode(SDL_GetPrimaryDisplay());
@@ -381,9 +505,15 @@ static uint8_t replay(
 
 	/* Go through all the calls, let vsync do the timing if applicable */
 	run = 1;
+	frameStart = SDL_GetPerformanceCounter();
+	callStart = 0;
 	READ(mark);
 	while (run && mark != MARK_DESTROYDEVICE)
 	{
+		if (stats != NULL)
+		{
+			callStart = SDL_GetPerformanceCounter();
+		}
 		switch (mark)
 		{
 		case MARK_SWAPBUFFERS:
@@ -877,7 +1007,7 @@ static uint8_t replay(
 			READ(level);
 			READ(dataLength);
 			miscBuffer = SDL_malloc(dataLength);
-			SDL_ReadIO(ops, miscBuffer, dataLength);
+			READMEM(miscBuffer, dataLength);
 			FNA3D_SetTextureData2D(
 				device,
 				traceTexture[i],
@@ -902,7 +1032,7 @@ static uint8_t replay(
 			READ(level);
 			READ(dataLength);
 			miscBuffer = SDL_malloc(dataLength);
-			SDL_ReadIO(ops, miscBuffer, dataLength);
+			READMEM(miscBuffer, dataLength);
 			FNA3D_SetTextureData3D(
 				device,
 				traceTexture[i],
@@ -928,7 +1058,7 @@ static uint8_t replay(
 			READ(level);
 			READ(dataLength);
 			miscBuffer = SDL_malloc(dataLength);
-			SDL_ReadIO(ops, miscBuffer, dataLength);
+			READMEM(miscBuffer, dataLength);
 			FNA3D_SetTextureDataCube(
 				device,
 				traceTexture[i],
@@ -953,7 +1083,7 @@ static uint8_t replay(
 			READ(h);
 			READ(dataLength);
 			miscBuffer = SDL_malloc(dataLength);
-			SDL_ReadIO(ops, miscBuffer, dataLength);
+			READMEM(miscBuffer, dataLength);
 			FNA3D_SetTextureDataYUV(
 				device,
 				traceTexture[i],
@@ -1115,7 +1245,7 @@ static uint8_t replay(
 			READ(vertexStride);
 			READ(dataOptions);
 			miscBuffer = SDL_malloc(vertexStride * elementCount);
-			SDL_ReadIO(ops, miscBuffer, vertexStride * elementCount);
+			READMEM(miscBuffer, vertexStride * elementCount);
 			FNA3D_SetVertexBufferData(
 				device,
 				traceVertexBuffer[i],
@@ -1172,7 +1302,7 @@ static uint8_t replay(
 			READ(dataLength);
 			READ(dataOptions);
 			miscBuffer = SDL_malloc(dataLength);
-			SDL_ReadIO(ops, miscBuffer, dataLength);
+			READMEM(miscBuffer, dataLength);
 			FNA3D_SetIndexBufferData(
 				device,
 				traceIndexBuffer[i],
@@ -1200,7 +1330,7 @@ static uint8_t replay(
 		case MARK_CREATEEFFECT:
 			READ(dataLength);
 			miscBuffer = SDL_malloc(dataLength);
-			SDL_ReadIO(ops, miscBuffer, dataLength);
+			READMEM(miscBuffer, dataLength);
 			FNA3D_CreateEffect(
 				device,
 				(uint8_t*) miscBuffer,
@@ -1286,8 +1416,7 @@ static uint8_t replay(
 			effectData = traceEffectData[i];
 			for (vi = 0; vi < effectData->param_count; vi += 1)
 			{
-				SDL_ReadIO(
-					ops,
+				READMEM(
 					effectData->params[vi].value.values,
 					effectData->params[vi].value.value_count * 4
 				);
@@ -1339,7 +1468,7 @@ static uint8_t replay(
 		case MARK_SETSTRINGMARKER:
 			READ(dataLength);
 			miscBuffer = SDL_malloc(dataLength);
-			SDL_ReadIO(ops, miscBuffer, dataLength);
+			READMEM(miscBuffer, dataLength);
 			FNA3D_SetStringMarker(device, (char*) miscBuffer);
 			SDL_free(miscBuffer);
 			break;
@@ -1354,10 +1483,38 @@ static uint8_t replay(
 			SDL_assert(0 && "Unrecognized mark!");
 			break;
 		}
-		READ(mark);
+		if (stats != NULL && mark < MARK_COUNT)
+		{
+			now = SDL_GetPerformanceCounter();
+			stats->markCalls[mark] += 1;
+			stats->markTicks[mark] += now - callStart;
+			if (mark == MARK_SWAPBUFFERS)
+			{
+				if (stats->frameCount == stats->frameCapacity)
+				{
+					stats->frameCapacity = SDL_max(
+						1024,
+						stats->frameCapacity * 2
+					);
+					stats->frameTicks = (uint64_t*) SDL_realloc(
+						stats->frameTicks,
+						sizeof(uint64_t) * stats->frameCapacity
+					);
+				}
+				stats->frameTicks[stats->frameCount] = now - frameStart;
+				stats->frameCount += 1;
+				frameStart = now;
+			}
+		}
+		if (READ(mark) < sizeof(mark))
+		{
+			/* Truncated trace, the game probably crashed */
+			mark = MARK_DESTROYDEVICE;
+		}
 	}
 
 	/* Clean up. We out. */
+	FNA3D_TraceReader_Destroy(&reader);
 	SDL_CloseIO(ops);
 	#define FREE_TRACES(type) \
 		if (trace##type##Count > 0) \
@@ -1393,9 +1550,103 @@ static uint8_t replay(
 	return !run;
 
 	#undef REGISTER_OBJECT
+	#undef READMEM
 	#undef READ
 }
 
+static int CompareTicks(const void *a, const void *b)
+{
+	uint64_t x = *((const uint64_t*) a);
+	uint64_t y = *((const uint64_t*) b);
+	return (x > y) - (x < y);
+}
+
+static double TicksToMS(uint64_t ticks)
+{
+	return (double) ticks * 1000.0 / (double) SDL_GetPerformanceFrequency();
+}
+
+static void PrintBenchmarkReport(
+	BenchmarkStats *stats,
+	char **traces,
+	int traceCount,
+	uint32_t loops,
+	uint8_t present
+) {
+	uint64_t total = 0;
+	size_t i;
+	int t;
+	uint8_t first;
+
+	printf("{\n");
+	printf("\t\"traces\": [");
+	for (t = 0; t < traceCount; t += 1)
+	{
+		if (t > 0)
+		{
+			printf(", ");
+		}
+		PrintJSONString(traces[t]);
+	}
+	printf("],\n");
+	printf("\t\"loops\": %u,\n", loops);
+	printf("\t\"present\": %s,\n", present ? "true" : "false");
+	printf("\t\"frames\": %llu,\n", (unsigned long long) stats->frameCount);
+
+	/* Nearest-rank percentiles over every frame of every loop */
+	if (stats->frameCount > 0)
+	{
+		SDL_qsort(
+			stats->frameTicks,
+			stats->frameCount,
+			sizeof(uint64_t),
+			CompareTicks
+		);
+		for (i = 0; i < stats->frameCount; i += 1)
+		{
+			total += stats->frameTicks[i];
+		}
+		/* ceil(p * n / 100) - 1, never past the last frame */
+		#define PERCENTILE(p) TicksToMS(stats->frameTicks[ \
+			SDL_min( \
+				(stats->frameCount * (p) + 99) / 100, \
+				stats->frameCount \
+			) - 1 \
+		])
+		printf(
+			"\t\"frame_ms\": { \"min\": %.3f, \"avg\": %.3f, "
+			"\"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f, "
+			"\"max\": %.3f },\n",
+			TicksToMS(stats->frameTicks[0]),
+			TicksToMS(total) / (double) stats->frameCount,
+			PERCENTILE(50),
+			PERCENTILE(95),
+			PERCENTILE(99),
+			TicksToMS(stats->frameTicks[stats->frameCount - 1])
+		);
+		#undef PERCENTILE
+	}
+
+	printf("\t\"marks\": {");
+	first = 1;
+	for (i = 0; i < MARK_COUNT; i += 1)
+	{
+		if (stats->markCalls[i] == 0)
+		{
+			continue;
+		}
+		printf(
+			"%s\n\t\t\"%s\": { \"calls\": %llu, \"total_ms\": %.3f }",
+			first ? "" : ",",
+			markNames[i],
+			(unsigned long long) stats->markCalls[i],
+			TicksToMS(stats->markTicks[i])
+		);
+		first = 0;
+	}
+	printf("\n\t}\n}\n");
+}
+
 int main(int argc, char **argv)
 {
 	int i;
@@ -1403,6 +1654,15 @@ int main(int argc, char **argv)
 	uint8_t forceFullscreen = 0;
 	VSyncMode vsync = VSYNC_DEFAULT;
 	uint32_t delayMS = 0;
+	uint8_t benchmark = 0;
+	uint8_t present = 1;
+	uint32_t loops = 1, loop;
+	BenchmarkStats stats;
+	char *defaultPath = NULL;
+	char **traces;
+	int traceCount;
+	void *preload;
+	size_t preloadLength;
 
 	SDL_Init(SDL_INIT_VIDEO);
 
@@ -1431,6 +1691,18 @@ int main(int argc, char **argv)
 		{
 			delayMS = SDL_atoi(argv[i] + SDL_strlen("-delayms="));
 		}
+		else if (SDL_strcmp(argv[i], "-benchmark") == 0)
+		{
+			benchmark = 1;
+		}
+		else if (SDL_strstr(argv[i], "-loops=") == argv[i])
+		{
+			loops = SDL_max(1, SDL_atoi(argv[i] + SDL_strlen("-loops=")));
+		}
+		else if (SDL_strcmp(argv[i], "-nopresent") == 0)
+		{
+			present = 0;
+		}
 		else
 		{
 			/* Unrecognized, assume we're looking at traces now */
@@ -1443,25 +1715,85 @@ int main(int argc, char **argv)
 		const char *defaultName = "FNA3D_Trace.bin";
 		const char *rootPath = SDL_GetBasePath();
 		size_t pathLen = SDL_strlen(rootPath) + SDL_strlen(defaultName) + 1;
-		char *path = (char*) SDL_malloc(pathLen);
-		SDL_snprintf(path, pathLen, "%s%s", rootPath, defaultName);
+		defaultPath = (char*) SDL_malloc(pathLen);
+		SDL_snprintf(defaultPath, pathLen, "%s%s", rootPath, defaultName);
 #ifndef USE_SDL3
 		SDL_free(rootPath);
 #endif
-		replay(path, forceDebugMode, vsync, forceFullscreen, delayMS);
-		SDL_free(path);
+		traces = &defaultPath;
+		traceCount = 1;
 	}
 	else
 	{
-		for (; i < argc; i += 1)
+		traces = &argv[i];
+		traceCount = argc - i;
+	}
+
+	if (!benchmark)
+	{
+		for (i = 0; i < traceCount; i += 1)
 		{
-			if (replay(argv[i], forceDebugMode, vsync, forceFullscreen, delayMS))
+			if (replay(
+				traces[i],
+				NULL,
+				0,
+				forceDebugMode,
+				vsync,
+				forceFullscreen,
+				delayMS,
+				present,
+				NULL
+			)) {
+				break;
+			}
+		}
+	}
+	else
+	{
+		/* Load each trace up front so disk reads stay out of the timings */
+		SDL_zero(stats);
+		for (i = 0; i < traceCount; i += 1)
+		{
+			preload = SDL_LoadFile(traces[i], &preloadLength);
+			if (preload == NULL)
+			{
+				SDL_Log("%s not found!", traces[i]);
+				continue;
+			}
+			for (loop = 0; loop < loops; loop += 1)
+			{
+				if (replay(
+					traces[i],
+					preload,
+					preloadLength,
+					forceDebugMode,
+					vsync,
+					forceFullscreen,
+					0,
+					present,
+					&stats
+				)) {
+					break;
+				}
+			}
+			SDL_free(preload);
+			if (loop < loops)
 			{
+				/* The window was closed */
 				break;
 			}
 		}
+		PrintBenchmarkReport(
+			&stats,
+			traces,
+			traceCount,
+			loops,
+			present
+		);
+		SDL_free(stats.frameTicks);
 	}
 
+	SDL_free(defaultPath);
 	SDL_Quit();
 	return 0;
 }
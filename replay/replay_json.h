@@ -0,0 +1,58 @@
+/* FNA3D - 3D Graphics Library for FNA
+ *
+ * Copyright (c) 2020-2024 Ethan Lee
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from
+ * the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ * claim that you wrote the original software. If you use this software in a
+ * product, an acknowledgment in the product documentation would be
+ * appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ * misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ * Ethan "flibitijibibo" Lee <flibitijibibo@flibitijibibo.com>
+ *
+ */
+
+/* Shared by the replay and bench tools, both print their reports as JSON */
+
+#ifndef REPLAY_JSON_H
+#define REPLAY_JSON_H
+
+#include <stdio.h>
+
+/* Prints str as a quoted JSON string */
+static void PrintJSONString(const char *str)
+{
+	putchar('"');
+	for (; *str != '\0'; str += 1)
+	{
+		if (*str == '"' || *str == '\\')
+		{
+			printf("\\%c", *str);
+		}
+		else if ((unsigned char) *str < 0x20)
+		{
+			printf("\\u%04x", (unsigned char) *str);
+		}
+		else
+		{
+			putchar(*str);
+		}
+	}
+	putchar('"');
+}
+
+#endif /* REPLAY_JSON_H */
+
+/* vim: set noexpandtab shiftwidth=8 tabstop=8: */
@@ -26,6 +26,8 @@
 
 #include "FNA3D_Driver.h"
 #include "FNA3D_Tracing.h"
+#include "FNA3D_Timeline.h"
+#include "FNA3D_PipelineManifest.h"
 
 #ifdef USE_SDL3
 #include <SDL3/SDL.h>
@@ -51,6 +53,9 @@ static const FNA3D_Driver *drivers[] = {
 #endif
 #if FNA3D_DRIVER_OPENGL
 	&OpenGLDriver,
+#endif
+#if FNA3D_DRIVER_NULL
+	&NullDriver, /* Only when forced, see NULLDRV_PrepareWindowAttributes */
 #endif
 	NULL
 };
@@ -132,6 +137,378 @@ void FNA3D_HookLogFunctions(
 	FNA3D_LogErrorFunc = error;
 }
 
+/* Performance Counters */
+
+void FNA3D_PerfState_Init(FNA3D_PerfState *state)
+{
+	const char *hint = SDL_getenv("FNA3D_PERF_COUNTERS");
+	SDL_zerop(state);
+	state->enabled = (hint != NULL && SDL_strcmp(hint, "1") == 0);
+	state->published.version = FNA3D_PERFCOUNTERS_VERSION;
+	state->published.enabled = state->enabled;
+}
+
+void FNA3D_PerfState_EndFrame(FNA3D_PerfState *state)
+{
+	uint64_t now, frequency, elapsed;
+
+	if (!state->enabled)
+	{
+		return;
+	}
+
+	state->window.frameCount += 1;
+	state->total.frameCount += 1;
+
+	now = SDL_GetPerformanceCounter();
+	if (state->windowStart == 0)
+	{
+		state->windowStart = now;
+		return;
+	}
+
+	/* Roll the window about every 250ms, the snapshot is all anyone sees */
+	frequency = SDL_GetPerformanceFrequency();
+	elapsed = now - state->windowStart;
+	if (elapsed < (frequency / 4))
+	{
+		return;
+	}
+
+	state->published.windowNs = (uint64_t) (
+		((double) elapsed * 1000000000.0) / (double) frequency
+	);
+	state->published.window = state->window;
+	state->published.total = state->total;
+	SDL_zero(state->window);
+	state->windowStart = now;
+}
+
+void FNA3D_PerfState_Get(
+	FNA3D_PerfState *state,
+	FNA3D_PerfCounters *counters
+) {
+	*counters = state->published;
+}
+
+/* Frame Pacing */
+
+static float FNA3D_INTERNAL_GetRefreshRate(void *window)
+{
+#ifdef USE_SDL3
+	const SDL_DisplayMode *mode;
+
+	if (window != NULL)
+	{
+		mode = SDL_GetCurrentDisplayMode(
+			SDL_GetDisplayForWindow((SDL_Window*) window)
+		);
+		if (mode != NULL)
+		{
+			return mode->refresh_rate;
+		}
+	}
+#else
+	SDL_DisplayMode mode;
+
+	if (	window != NULL &&
+		SDL_GetCurrentDisplayMode(
+			SDL_GetWindowDisplayIndex((SDL_Window*) window),
+			&mode
+		) == 0	)
+	{
+		return (float) mode.refresh_rate;
+	}
+#endif
+	return 0.0f;
+}
+
+static const uint64_t paceBucketLimits[FNA3D_PACE_HISTOGRAM_BUCKETS - 1] =
+{
+	50, 100, 250, 500, 1000, 2000, 4000
+};
+
+static uint64_t FNA3D_INTERNAL_PaceDeadline(FNA3D_FramePacer *pacer)
+{
+	/* Every rateNum frames is exactly rateDen seconds, keeps this small */
+	while (pacer->frame >= pacer->rateNum)
+	{
+		pacer->epoch += pacer->frequency * pacer->rateDen;
+		pacer->frame -= pacer->rateNum;
+	}
+	return pacer->epoch + (
+		(pacer->frame * pacer->frequency * pacer->rateDen) /
+		pacer->rateNum
+	);
+}
+
+static void FNA3D_INTERNAL_PaceStride(FNA3D_FramePacer *pacer, uint64_t cost)
+{
+	pacer->smoothedCost += ((double) cost - pacer->smoothedCost) / 8.0;
+
+	/* Holding a slower, even cadence looks better than alternating, so
+	 * only step back down once there's clearly room for it.
+	 */
+	if (pacer->smoothedCost > (double) (pacer->stride * pacer->interval))
+	{
+		pacer->stride = SDL_min(
+			(uint64_t) (pacer->smoothedCost / (double) pacer->interval) + 1,
+			4
+		);
+	}
+	else if (	pacer->stride > 1 &&
+			pacer->smoothedCost < 0.85 * (double) (
+				(pacer->stride - 1) * pacer->interval
+			)	)
+	{
+		pacer->stride -= 1;
+	}
+}
+
+void FNA3D_FramePacer_Init(FNA3D_FramePacer *pacer, void *window)
+{
+	const char *hint;
+	int32_t fps = 0;
+	float refresh;
+
+	SDL_zerop(pacer);
+	pacer->frequency = SDL_GetPerformanceFrequency();
+	pacer->stride = 1;
+
+	hint = SDL_getenv("FNA3D_TARGET_FPS");
+	if (hint != NULL)
+	{
+		fps = SDL_max(SDL_atoi(hint), 0);
+	}
+
+	hint = SDL_getenv("FNA3D_FRAME_PACING");
+	if (hint == NULL || SDL_strcasecmp(hint, "fixed") == 0)
+	{
+		pacer->mode = (fps > 0) ? FNA3D_PACE_FIXED : FNA3D_PACE_OFF;
+	}
+	else if (SDL_strcasecmp(hint, "half") == 0)
+	{
+		pacer->mode = FNA3D_PACE_HALFREFRESH;
+	}
+	else if (SDL_strcasecmp(hint, "smooth") == 0)
+	{
+		pacer->mode = FNA3D_PACE_SMOOTH;
+	}
+	else
+	{
+		if (SDL_strcasecmp(hint, "off") != 0)
+		{
+			FNA3D_LogWarn("Unrecognized FNA3D_FRAME_PACING: %s", hint);
+		}
+		pacer->mode = FNA3D_PACE_OFF;
+	}
+
+	if (pacer->mode == FNA3D_PACE_OFF)
+	{
+		return;
+	}
+
+	if (pacer->mode == FNA3D_PACE_HALFREFRESH || fps == 0)
+	{
+		refresh = FNA3D_INTERNAL_GetRefreshRate(window);
+		if (refresh <= 0.0f)
+		{
+			FNA3D_LogWarn("Display refresh rate unknown, assuming 60Hz");
+			refresh = 60.0f;
+		}
+
+		/* Millihertz keeps 59.94 and friends exact enough */
+		pacer->rateNum = (uint64_t) (refresh * 1000.0f + 0.5f);
+		pacer->rateDen = (pacer->mode == FNA3D_PACE_HALFREFRESH) ?
+			2000 :
+			1000;
+	}
+	else
+	{
+		pacer->rateNum = (uint64_t) fps;
+		pacer->rateDen = 1;
+	}
+	pacer->interval = (pacer->frequency * pacer->rateDen) / pacer->rateNum;
+
+	/* SDL_DelayPrecise already handles the scheduler slop, so spinning is
+	 * opt-in there. SDL_Delay only has millisecond precision, so SDL2 spins
+	 * out a small tail by default.
+	 */
+	hint = SDL_getenv("FNA3D_FRAME_PACING_SPIN_US");
+	pacer->spin = (pacer->frequency * (
+		(hint != NULL) ? (uint64_t) SDL_max(SDL_atoi(hint), 0) :
+#ifdef USE_SDL3
+		0
+#else
+		500
+#endif
+	)) / 1000000;
+
+	FNA3D_LogInfo(
+		"Frame pacing: %s, %.3f ms/frame",
+		(pacer->mode == FNA3D_PACE_FIXED) ? "Fixed" :
+		(pacer->mode == FNA3D_PACE_HALFREFRESH) ? "Half Refresh" :
+		"Smooth",
+		((double) pacer->rateDen * 1000.0) / (double) pacer->rateNum
+	);
+}
+
+void FNA3D_FramePacer_Wait(FNA3D_FramePacer *pacer, FNA3D_PerfState *perf)
+{
+	uint64_t start, now, deadline, error;
+
+	if (pacer->mode == FNA3D_PACE_OFF)
+	{
+		return;
+	}
+
+	start = SDL_GetPerformanceCounter();
+	if (pacer->epoch == 0)
+	{
+		pacer->epoch = start;
+		pacer->frame = 0;
+		pacer->release = start;
+		return;
+	}
+
+	if (pacer->mode == FNA3D_PACE_SMOOTH)
+	{
+		FNA3D_INTERNAL_PaceStride(pacer, start - pacer->release);
+	}
+
+	pacer->frame += pacer->stride;
+	deadline = FNA3D_INTERNAL_PaceDeadline(pacer);
+	if (start >= deadline)
+	{
+		now = start;
+		error = start - deadline;
+
+		/* Don't burst to catch up, just restart the schedule here */
+		if (error > pacer->interval)
+		{
+			pacer->epoch = start;
+			pacer->frame = 0;
+		}
+	}
+	else
+	{
+		/* Sleep most of the way, then spin out whatever is left */
+		if ((deadline - start) > pacer->spin)
+		{
+#ifdef USE_SDL3
+			SDL_DelayPrecise(
+				((deadline - start - pacer->spin) * 1000000000ULL) /
+				pacer->frequency
+			);
+#else
+			SDL_Delay((uint32_t) (
+				((deadline - start - pacer->spin) * 1000ULL) /
+				pacer->frequency
+			));
+#endif
+		}
+		do
+		{
+			now = SDL_GetPerformanceCounter();
+		} while (now < deadline);
+		error = now - deadline;
+	}
+	pacer->release = now;
+
+	pacer->lastSleep = now - start;
+	pacer->lastError = error;
+	pacer->pending = 1;
+	if (perf != NULL)
+	{
+		FNA3D_FramePacer_Record(pacer, perf);
+	}
+}
+
+void FNA3D_FramePacer_Record(FNA3D_FramePacer *pacer, FNA3D_PerfState *perf)
+{
+	uint64_t errorUs;
+	uint32_t bucket;
+
+	if (!pacer->pending)
+	{
+		return;
+	}
+	pacer->pending = 0;
+
+	if (perf->enabled)
+	{
+		FNA3D_PERF_ADD(
+			*perf,
+			sleepNs,
+			(pacer->lastSleep * 1000000000ULL) / pacer->frequency
+		);
+		errorUs = (pacer->lastError * 1000000ULL) / pacer->frequency;
+		bucket = 0;
+		while (	bucket < (FNA3D_PACE_HISTOGRAM_BUCKETS - 1) &&
+			errorUs >= paceBucketLimits[bucket]	)
+		{
+			bucket += 1;
+		}
+		FNA3D_PERF_ADD(*perf, paceError[bucket], 1);
+	}
+}
+
+/* Mapped Vertex Ranges */
+
+uint8_t FNA3D_MappedRange_Begin(
+	FNA3D_MappedRange *range,
+	FNA3D_Buffer *buffer,
+	int32_t offsetInBytes,
+	int32_t lengthInBytes,
+	FNA3D_SetDataOptions options
+) {
+	if (range->buffer != NULL)
+	{
+		FNA3D_LogError("A vertex buffer range is already mapped!");
+		return 0;
+	}
+	range->buffer = buffer;
+	range->offsetInBytes = offsetInBytes;
+	range->lengthInBytes = lengthInBytes;
+	range->options = options;
+	range->usingScratch = 0;
+	return 1;
+}
+
+void* FNA3D_MappedRange_GetScratch(FNA3D_MappedRange *range)
+{
+	if (range->lengthInBytes > range->scratchCapacity)
+	{
+		range->scratchCapacity = range->lengthInBytes;
+		range->scratch = (uint8_t*) SDL_realloc(
+			range->scratch,
+			range->scratchCapacity
+		);
+	}
+	range->usingScratch = 1;
+	return range->scratch;
+}
+
+uint8_t FNA3D_MappedRange_End(
+	FNA3D_MappedRange *range,
+	FNA3D_Buffer *buffer
+) {
+	if (range->buffer == NULL || range->buffer != buffer)
+	{
+		FNA3D_LogError("Vertex buffer range was not mapped!");
+		return 0;
+	}
+	range->buffer = NULL;
+	return 1;
+}
+
+void FNA3D_MappedRange_Destroy(FNA3D_MappedRange *range)
+{
+	SDL_free(range->scratch);
+	range->scratch = NULL;
+	range->scratchCapacity = 0;
+}
+
 /* Version API */
 
 uint32_t FNA3D_LinkedVersion(void)
@@ -240,6 +617,8 @@ FNA3D_Device* FNA3D_CreateDevice(
 	FNA3D_PresentationParameters *presentationParameters,
 	uint8_t debugMode
 ) {
+	FNA3D_Device *result;
+
 	TRACE_CREATEDEVICE
 	if (selectedDriver < 0)
 	{
@@ -247,10 +626,16 @@ FNA3D_Device* FNA3D_CreateDevice(
 		return NULL;
 	}
 
-	return drivers[selectedDriver]->CreateDevice(
+	FNA3D_Timeline_Init();
+	result = drivers[selectedDriver]->CreateDevice(
 		presentationParameters,
 		debugMode
 	);
+	if (result == NULL)
+	{
+		FNA3D_Timeline_Quit();
+	}
+	return result;
 }
 
 void FNA3D_DestroyDevice(FNA3D_Device *device)
@@ -262,6 +647,7 @@ void FNA3D_DestroyDevice(FNA3D_Device *device)
 	}
 
 	device->DestroyDevice(device);
+	FNA3D_Timeline_Quit();
 }
 
 /* Presentation */
@@ -277,12 +663,18 @@ void FNA3D_SwapBuffers(
 	{
 		return;
 	}
+	TIMELINE_BEGIN("SwapBuffers")
 	device->SwapBuffers(
 		device->driverData,
 		sourceRectangle,
 		destinationRectangle,
 		overrideWindowHandle
 	);
+	TIMELINE_END("SwapBuffers")
+	if (FNA3D_TimelineActive)
+	{
+		FNA3D_Timeline_EndFrame();
+	}
 }
 
 /* Drawing */
@@ -318,6 +710,7 @@ void FNA3D_DrawIndexedPrimitives(
 	{
 		return;
 	}
+	TIMELINE_BEGIN("DrawIndexedPrimitives")
 	device->DrawIndexedPrimitives(
 		device->driverData,
 		primitiveType,
@@ -329,6 +722,7 @@ void FNA3D_DrawIndexedPrimitives(
 		indices,
 		indexElementSize
 	);
+	TIMELINE_END("DrawIndexedPrimitives")
 }
 
 void FNA3D_DrawInstancedPrimitives(
@@ -348,6 +742,7 @@ void FNA3D_DrawInstancedPrimitives(
 	{
 		return;
 	}
+	TIMELINE_BEGIN("DrawInstancedPrimitives")
 	device->DrawInstancedPrimitives(
 		device->driverData,
 		primitiveType,
@@ -360,6 +755,7 @@ void FNA3D_DrawInstancedPrimitives(
 		indices,
 		indexElementSize
 	);
+	TIMELINE_END("DrawInstancedPrimitives")
 }
 
 void FNA3D_DrawPrimitives(
@@ -373,12 +769,14 @@ void FNA3D_DrawPrimitives(
 	{
 		return;
 	}
+	TIMELINE_BEGIN("DrawPrimitives")
 	device->DrawPrimitives(
 		device->driverData,
 		primitiveType,
 		vertexStart,
 		primitiveCount
 	);
+	TIMELINE_END("DrawPrimitives")
 }
 
 /* Mutable Render States */
@@ -569,6 +967,7 @@ void FNA3D_SetRenderTargets(
 	{
 		return;
 	}
+	TIMELINE_BEGIN("SetRenderTargets")
 	device->SetRenderTargets(
 		device->driverData,
 		renderTargets,
@@ -577,6 +976,7 @@ void FNA3D_SetRenderTargets(
 		depthFormat,
 		preserveTargetContents
 	);
+	TIMELINE_END("SetRenderTargets")
 }
 
 void FNA3D_ResolveTarget(
@@ -787,6 +1187,7 @@ void FNA3D_SetTextureData2D(
 	{
 		return;
 	}
+	TIMELINE_BEGIN("SetTextureData2D")
 	device->SetTextureData2D(
 		device->driverData,
 		texture,
@@ -798,6 +1199,7 @@ void FNA3D_SetTextureData2D(
 		data,
 		dataLength
 	);
+	TIMELINE_END("SetTextureData2D")
 }
 
 void FNA3D_SetTextureData3D(
@@ -818,6 +1220,7 @@ void FNA3D_SetTextureData3D(
 	{
 		return;
 	}
+	TIMELINE_BEGIN("SetTextureData3D")
 	device->SetTextureData3D(
 		device->driverData,
 		texture,
@@ -831,6 +1234,7 @@ void FNA3D_SetTextureData3D(
 		data,
 		dataLength
 	);
+	TIMELINE_END("SetTextureData3D")
 }
 
 void FNA3D_SetTextureDataCube(
@@ -850,6 +1254,7 @@ void FNA3D_SetTextureDataCube(
 	{
 		return;
 	}
+	TIMELINE_BEGIN("SetTextureDataCube")
 	device->SetTextureDataCube(
 		device->driverData,
 		texture,
@@ -862,6 +1267,7 @@ void FNA3D_SetTextureDataCube(
 		data,
 		dataLength
 	);
+	TIMELINE_END("SetTextureDataCube")
 }
 
 void FNA3D_SetTextureDataYUV(
@@ -881,6 +1287,7 @@ void FNA3D_SetTextureDataYUV(
 	{
 		return;
 	}
+	TIMELINE_BEGIN("SetTextureDataYUV")
 	device->SetTextureDataYUV(
 		device->driverData,
 		y,
@@ -893,6 +1300,7 @@ void FNA3D_SetTextureDataYUV(
 		data,
 		dataLength
 	);
+	TIMELINE_END("SetTextureDataYUV")
 }
 
 void FNA3D_GetTextureData2D(
@@ -988,6 +1396,114 @@ void FNA3D_GetTextureDataCube(
 	);
 }
 
+FNA3D_Readback* FNA3D_RequestTextureDataAsync(
+	FNA3D_Device *device,
+	FNA3D_Texture *texture,
+	int32_t x,
+	int32_t y,
+	int32_t w,
+	int32_t h,
+	int32_t level,
+	int32_t dataLength
+) {
+	FNA3D_Readback *result;
+
+	/* Replays read these back synchronously, which is close enough */
+	if (texture == NULL)
+	{
+		TRACE_READBACKBUFFER
+	}
+	else
+	{
+		TRACE_GETTEXTUREDATA2D
+	}
+	if (device == NULL || dataLength <= 0)
+	{
+		return NULL;
+	}
+
+	result = device->RequestTextureDataAsync(
+		device->driverData,
+		texture,
+		x,
+		y,
+		w,
+		h,
+		level,
+		dataLength
+	);
+	if (result != NULL)
+	{
+		return result;
+	}
+
+	/* The driver can't do this one without stalling, so just stall now */
+	result = (FNA3D_Readback*) SDL_malloc(
+		sizeof(FNA3D_Readback) + dataLength
+	);
+	result->dataLength = dataLength;
+	result->data = (uint8_t*) (result + 1);
+	if (texture == NULL)
+	{
+		device->ReadBackbuffer(
+			device->driverData,
+			x,
+			y,
+			w,
+			h,
+			result->data,
+			dataLength
+		);
+	}
+	else
+	{
+		device->GetTextureData2D(
+			device->driverData,
+			texture,
+			x,
+			y,
+			w,
+			h,
+			level,
+			result->data,
+			dataLength
+		);
+	}
+	return result;
+}
+
+uint8_t FNA3D_PollReadback(
+	FNA3D_Device *device,
+	FNA3D_Readback *readback,
+	void* data,
+	int32_t dataLength
+) {
+	/* Not traced! */
+	if (device == NULL || readback == NULL)
+	{
+		return 0;
+	}
+	if (readback->data == NULL)
+	{
+		return device->PollReadback(
+			device->driverData,
+			readback,
+			data,
+			dataLength
+		);
+	}
+	if (data != NULL)
+	{
+		SDL_memcpy(
+			data,
+			readback->data,
+			SDL_min(dataLength, readback->dataLength)
+		);
+	}
+	SDL_free(readback);
+	return 1;
+}
+
 /* Renderbuffers */
 
 FNA3D_Renderbuffer* FNA3D_GenColorRenderbuffer(
@@ -1112,6 +1628,7 @@ void FNA3D_SetVertexBufferData(
 	{
 		return;
 	}
+	TIMELINE_BEGIN("SetVertexBufferData")
 	device->SetVertexBufferData(
 		device->driverData,
 		buffer,
@@ -1122,6 +1639,47 @@ void FNA3D_SetVertexBufferData(
 		vertexStride,
 		options
 	);
+	TIMELINE_END("SetVertexBufferData")
+}
+
+void* FNA3D_MapVertexBufferRange(
+	FNA3D_Device *device,
+	FNA3D_Buffer *buffer,
+	int32_t offsetInBytes,
+	int32_t lengthInBytes,
+	FNA3D_SetDataOptions options
+) {
+	void *result;
+	if (device == NULL || offsetInBytes < 0 || lengthInBytes <= 0)
+	{
+		return NULL;
+	}
+	TIMELINE_BEGIN("MapVertexBufferRange")
+	result = device->MapVertexBufferRange(
+		device->driverData,
+		buffer,
+		offsetInBytes,
+		lengthInBytes,
+		options
+	);
+	TIMELINE_END("MapVertexBufferRange")
+	TRACE_MAPVERTEXBUFFERRANGE
+	return result;
+}
+
+void FNA3D_UnmapVertexBufferRange(
+	FNA3D_Device *device,
+	FNA3D_Buffer *buffer
+) {
+	/* Traced as SetVertexBufferData, while the mapping is still valid */
+	TRACE_UNMAPVERTEXBUFFERRANGE
+	if (device == NULL)
+	{
+		return;
+	}
+	TIMELINE_BEGIN("UnmapVertexBufferRange")
+	device->UnmapVertexBufferRange(device->driverData, buffer);
+	TIMELINE_END("UnmapVertexBufferRange")
 }
 
 void FNA3D_GetVertexBufferData(
@@ -1200,6 +1758,7 @@ void FNA3D_SetIndexBufferData(
 	{
 		return;
 	}
+	TIMELINE_BEGIN("SetIndexBufferData")
 	device->SetIndexBufferData(
 		device->driverData,
 		buffer,
@@ -1208,6 +1767,7 @@ void FNA3D_SetIndexBufferData(
 		dataLength,
 		options
 	);
+	TIMELINE_END("SetIndexBufferData")
 }
 
 void FNA3D_GetIndexBufferData(
@@ -1283,6 +1843,30 @@ void FNA3D_CloneEffect(
 	TRACE_CLONEEFFECT
 }
 
+uint8_t FNA3D_PrewarmPipelines(
+	FNA3D_Device *device,
+	uint8_t *manifest,
+	uint32_t manifestLength
+) {
+	FNA3D_PipelineManifest *parsed;
+
+	/* Not traced! */
+	if (device == NULL)
+	{
+		return 0;
+	}
+	parsed = FNA3D_PipelineManifest_Parse(manifest, manifestLength);
+	if (parsed == NULL)
+	{
+		FNA3D_LogWarn("Pipeline manifest is invalid, ignoring");
+		return 0;
+	}
+
+	/* The renderer owns the manifest from here on */
+	device->PrewarmPipelines(device->driverData, parsed);
+	return 1;
+}
+
 void FNA3D_AddDisposeEffect(
 	FNA3D_Device *device,
 	FNA3D_Effect *effect
@@ -1319,12 +1903,14 @@ void FNA3D_ApplyEffect(
 	{
 		return;
 	}
+	TIMELINE_BEGIN("ApplyEffect")
 	device->ApplyEffect(
 		device->driverData,
 		effect,
 		pass,
 		stateChanges
 	);
+	TIMELINE_END("ApplyEffect")
 }
 
 void FNA3D_BeginPassRestore(
@@ -1522,6 +2108,22 @@ int32_t FNA3D_GetMaxMultiSampleCount(
 	);
 }
 
+/* Performance Counters */
+
+void FNA3D_GetPerfCounters(
+	FNA3D_Device *device,
+	FNA3D_PerfCounters *counters
+) {
+	/* Not traced! */
+	if (	device == NULL ||
+		counters == NULL ||
+		counters->version != FNA3D_PERFCOUNTERS_VERSION	)
+	{
+		return;
+	}
+	device->GetPerfCounters(device->driverData, counters);
+}
+
 /* Debugging */
 
 void FNA3D_SetStringMarker(FNA3D_Device *device, const char *text)
@@ -48,6 +48,135 @@ FNA3D_SHAREDINTERNAL void FNA3D_LogInfo(const char *fmt, ...);
 FNA3D_SHAREDINTERNAL void FNA3D_LogWarn(const char *fmt, ...);
 FNA3D_SHAREDINTERNAL void FNA3D_LogError(const char *fmt, ...);
 
+/* Performance Counters */
+
+typedef struct FNA3D_PerfState
+{
+	uint8_t enabled;
+	uint64_t windowStart;
+	FNA3D_PerfCounterSet window;
+	FNA3D_PerfCounterSet total;
+	FNA3D_PerfCounters published;
+} FNA3D_PerfState;
+
+/* Callers check state.enabled first, this keeps the hot path to two adds */
+#define FNA3D_PERF_ADD(state, counter, amount) \
+	do \
+	{ \
+		(state).window.counter += (amount); \
+		(state).total.counter += (amount); \
+	} while (0)
+
+/* Same, for high-water marks rather than running totals */
+#define FNA3D_PERF_MAX(state, counter, value) \
+	do \
+	{ \
+		(state).window.counter = SDL_max((state).window.counter, (value)); \
+		(state).total.counter = SDL_max((state).total.counter, (value)); \
+	} while (0)
+
+FNA3D_SHAREDINTERNAL void FNA3D_PerfState_Init(FNA3D_PerfState *state);
+FNA3D_SHAREDINTERNAL void FNA3D_PerfState_EndFrame(FNA3D_PerfState *state);
+FNA3D_SHAREDINTERNAL void FNA3D_PerfState_Get(
+	FNA3D_PerfState *state,
+	FNA3D_PerfCounters *counters
+);
+
+/* Frame Pacing */
+
+typedef enum FNA3D_PaceMode
+{
+	FNA3D_PACE_OFF,
+	FNA3D_PACE_FIXED,	/* FNA3D_TARGET_FPS */
+	FNA3D_PACE_HALFREFRESH,	/* Half the display refresh rate */
+	FNA3D_PACE_SMOOTH	/* Whole multiples of the target interval */
+} FNA3D_PaceMode;
+
+/* Deadlines are computed from the epoch as frame * rateDen / rateNum
+ * seconds, so they never accumulate rounding error.
+ */
+typedef struct FNA3D_FramePacer
+{
+	FNA3D_PaceMode mode;
+	uint64_t frequency;
+	uint64_t rateNum;
+	uint64_t rateDen;
+	uint64_t interval;	/* Approximate, in ticks */
+	uint64_t spin;		/* Ticks before the deadline spent spinning */
+	uint64_t epoch;		/* 0 before the first frame */
+	uint64_t frame;
+	uint64_t stride;	/* Intervals per frame, only SMOOTH changes this */
+	uint64_t release;	/* When the last wait returned */
+	double smoothedCost;
+	uint64_t lastSleep;	/* Ticks, not yet added to FNA3D_PerfState */
+	uint64_t lastError;	/* Ticks, not yet added to FNA3D_PerfState */
+	uint8_t pending;
+} FNA3D_FramePacer;
+
+FNA3D_SHAREDINTERNAL void FNA3D_FramePacer_Init(
+	FNA3D_FramePacer *pacer,
+	void *window
+);
+FNA3D_SHAREDINTERNAL void FNA3D_FramePacer_Wait(
+	FNA3D_FramePacer *pacer,
+	FNA3D_PerfState *perf
+);
+
+/* Drivers that pace with their context lock released pass NULL to Wait and
+ * call this once the lock is held again, so the counters aren't raced.
+ */
+FNA3D_SHAREDINTERNAL void FNA3D_FramePacer_Record(
+	FNA3D_FramePacer *pacer,
+	FNA3D_PerfState *perf
+);
+
+/* Mapped Vertex Ranges */
+
+/* The range mapped by FNA3D_MapVertexBufferRange. Drivers that can't point
+ * into the buffer or its upload memory hand out the scratch block instead,
+ * then write it with their own SetVertexBufferData on unmap.
+ */
+typedef struct FNA3D_MappedRange
+{
+	FNA3D_Buffer *buffer; /* NULL if nothing is mapped */
+	int32_t offsetInBytes;
+	int32_t lengthInBytes;
+	FNA3D_SetDataOptions options;
+	uint8_t usingScratch;
+	uint8_t *scratch;
+	int32_t scratchCapacity;
+} FNA3D_MappedRange;
+
+/* Returns 0 if another range is still mapped */
+FNA3D_SHAREDINTERNAL uint8_t FNA3D_MappedRange_Begin(
+	FNA3D_MappedRange *range,
+	FNA3D_Buffer *buffer,
+	int32_t offsetInBytes,
+	int32_t lengthInBytes,
+	FNA3D_SetDataOptions options
+);
+FNA3D_SHAREDINTERNAL void* FNA3D_MappedRange_GetScratch(
+	FNA3D_MappedRange *range
+);
+/* Returns 0 if the buffer is not the one mapped */
+FNA3D_SHAREDINTERNAL uint8_t FNA3D_MappedRange_End(
+	FNA3D_MappedRange *range,
+	FNA3D_Buffer *buffer
+);
+FNA3D_SHAREDINTERNAL void FNA3D_MappedRange_Destroy(FNA3D_MappedRange *range);
+
+/* Readbacks */
+
+/* Drivers embed this as the first member of their own readback struct. When
+ * a driver returns NULL from RequestTextureDataAsync, FNA3D.c reads the data
+ * synchronously into `data` instead and the driver never sees that readback.
+ */
+struct FNA3D_Readback
+{
+	int32_t dataLength;
+	uint8_t *data; /* NULL for readbacks owned by the driver */
+};
+
 /* Internal Helper Utilities */
 
 #define LinkedList_Add(start, toAdd, curr) \
@@ -560,6 +689,22 @@ struct FNA3D_Device
 		void* data,
 		int32_t dataLength
 	);
+	FNA3D_Readback* (*RequestTextureDataAsync)(
+		FNA3D_Renderer *driverData,
+		FNA3D_Texture *texture,
+		int32_t x,
+		int32_t y,
+		int32_t w,
+		int32_t h,
+		int32_t level,
+		int32_t dataLength
+	);
+	uint8_t (*PollReadback)(
+		FNA3D_Renderer *driverData,
+		FNA3D_Readback *readback,
+		void* data,
+		int32_t dataLength
+	);
 
 	/* Renderbuffers */
 
@@ -605,6 +750,17 @@ struct FNA3D_Device
 		int32_t vertexStride,
 		FNA3D_SetDataOptions options
 	);
+	void* (*MapVertexBufferRange)(
+		FNA3D_Renderer *driverData,
+		FNA3D_Buffer *buffer,
+		int32_t offsetInBytes,
+		int32_t lengthInBytes,
+		FNA3D_SetDataOptions options
+	);
+	void (*UnmapVertexBufferRange)(
+		FNA3D_Renderer *driverData,
+		FNA3D_Buffer *buffer
+	);
 	void (*GetVertexBufferData)(
 		FNA3D_Renderer *driverData,
 		FNA3D_Buffer *buffer,
@@ -658,6 +814,10 @@ struct FNA3D_Device
 		FNA3D_Effect **effect,
 		MOJOSHADER_effect **result
 	);
+	void (*PrewarmPipelines)(
+		FNA3D_Renderer *driverData,
+		struct FNA3D_PipelineManifest *manifest
+	);
 	void (*AddDisposeEffect)(
 		FNA3D_Renderer *driverData,
 		FNA3D_Effect *effect
@@ -715,6 +875,13 @@ struct FNA3D_Device
 		int32_t multiSampleCount
 	);
 
+	/* Performance Counters */
+
+	void (*GetPerfCounters)(
+		FNA3D_Renderer *driverData,
+		FNA3D_PerfCounters *counters
+	);
+
 	/* Debugging */
 
 	void (*SetStringMarker)(FNA3D_Renderer *driverData, const char *text);
@@ -778,6 +945,8 @@ struct FNA3D_Device
 	ASSIGN_DRIVER_FUNC(GetTextureData2D, name) \
 	ASSIGN_DRIVER_FUNC(GetTextureData3D, name) \
 	ASSIGN_DRIVER_FUNC(GetTextureDataCube, name) \
+	ASSIGN_DRIVER_FUNC(RequestTextureDataAsync, name) \
+	ASSIGN_DRIVER_FUNC(PollReadback, name) \
 	ASSIGN_DRIVER_FUNC(GenColorRenderbuffer, name) \
 	ASSIGN_DRIVER_FUNC(GenDepthStencilRenderbuffer, name) \
 	ASSIGN_DRIVER_FUNC(AddDisposeRenderbuffer, name) \
@@ -785,12 +954,15 @@ struct FNA3D_Device
 	ASSIGN_DRIVER_FUNC(GenIndexBuffer, name) \
 	ASSIGN_DRIVER_FUNC(AddDisposeVertexBuffer, name) \
 	ASSIGN_DRIVER_FUNC(SetVertexBufferData, name) \
+	ASSIGN_DRIVER_FUNC(MapVertexBufferRange, name) \
+	ASSIGN_DRIVER_FUNC(UnmapVertexBufferRange, name) \
 	ASSIGN_DRIVER_FUNC(GetVertexBufferData, name) \
 	ASSIGN_DRIVER_FUNC(AddDisposeIndexBuffer, name) \
 	ASSIGN_DRIVER_FUNC(SetIndexBufferData, name) \
 	ASSIGN_DRIVER_FUNC(GetIndexBufferData, name) \
 	ASSIGN_DRIVER_FUNC(CreateEffect, name) \
 	ASSIGN_DRIVER_FUNC(CloneEffect, name) \
+	ASSIGN_DRIVER_FUNC(PrewarmPipelines, name) \
 	ASSIGN_DRIVER_FUNC(AddDisposeEffect, name) \
 	ASSIGN_DRIVER_FUNC(SetEffectTechnique, name) \
 	ASSIGN_DRIVER_FUNC(ApplyEffect, name) \
@@ -810,6 +982,7 @@ struct FNA3D_Device
 	ASSIGN_DRIVER_FUNC(SupportsSRGBRenderTargets, name) \
 	ASSIGN_DRIVER_FUNC(GetMaxTextureSlots, name) \
 	ASSIGN_DRIVER_FUNC(GetMaxMultiSampleCount, name) \
+	ASSIGN_DRIVER_FUNC(GetPerfCounters, name) \
 	ASSIGN_DRIVER_FUNC(SetStringMarker, name) \
 	ASSIGN_DRIVER_FUNC(SetTextureName, name) \
 	ASSIGN_DRIVER_FUNC(GetSysRenderer, name) \
@@ -826,6 +999,7 @@ typedef struct FNA3D_Driver
 } FNA3D_Driver;
 
 FNA3D_SHAREDINTERNAL FNA3D_Driver D3D11Driver;
+FNA3D_SHAREDINTERNAL FNA3D_Driver NullDriver;
 FNA3D_SHAREDINTERNAL FNA3D_Driver OpenGLDriver;
 FNA3D_SHAREDINTERNAL FNA3D_Driver SDLGPUDriver;
 FNA3D_SHAREDINTERNAL FNA3D_Driver VulkanDriver;
@@ -28,6 +28,7 @@
 
 #include "FNA3D_Driver.h"
 #include "FNA3D_PipelineCache.h"
+#include "FNA3D_PipelineManifest.h"
 #include "FNA3D_Driver_D3D11.h"
 #include "FNA3D_Driver_D3D11_shaders.h"
 
@@ -70,6 +71,10 @@
 #define DXGI_PRESENT_ALLOW_TEARING 0x00000200UL
 #endif /* DXGI_PRESENT_ALLOW_TEARING */
 
+#ifndef DXGI_ERROR_WAS_STILL_DRAWING
+#define DXGI_ERROR_WAS_STILL_DRAWING ((HRESULT) 0x887A000AL)
+#endif /* DXGI_ERROR_WAS_STILL_DRAWING */
+
 #define ERROR_CHECK(msg) \
 	if (FAILED(res)) \
 	{ \
@@ -181,6 +186,14 @@ typedef struct D3D11Query /* Cast FNA3D_Query* to this! */
 	ID3D11Query *handle;
 } D3D11Query;
 
+typedef struct D3D11Readback /* Cast FNA3D_Readback* to this! */
+{
+	FNA3D_Readback base;
+	ID3D11Resource *staging; /* Just the requested region */
+	int32_t pitch;
+	int32_t rows;
+} D3D11Readback;
+
 typedef struct D3D11Backbuffer
 {
 	#define BACKBUFFER_TYPE_NULL 0
@@ -289,10 +302,10 @@ typedef struct D3D11Renderer /* Cast FNA3D_Renderer* to this! */
 	FNA3D_IndexElementSize indexElementSize;
 
 	/* Resource Caches */
-	PackedStateArray blendStateCache;
-	PackedStateArray depthStencilStateCache;
-	PackedStateArray rasterizerStateCache;
-	PackedStateArray samplerStateCache;
+	PackedStateHashTable blendStateCache;
+	PackedStateHashTable depthStencilStateCache;
+	PackedStateHashTable rasterizerStateCache;
+	PackedStateHashTable samplerStateCache;
 	PackedVertexBufferBindingsArray inputLayoutCache;
 
 	/* Render Targets */
@@ -307,6 +320,15 @@ typedef struct D3D11Renderer /* Cast FNA3D_Renderer* to this! */
 	const MOJOSHADER_effectTechnique *currentTechnique;
 	uint32_t currentPass;
 	uint8_t effectApplied;
+
+	/* Performance counters, see FNA3D_GetPerfCounters */
+	FNA3D_PerfState perf;
+
+	/* Frame rate limiting, see FNA3D_FramePacer_Init */
+	FNA3D_FramePacer pacer;
+
+	/* See FNA3D_MapVertexBufferRange */
+	FNA3D_MappedRange mappedRange;
 } D3D11Renderer;
 
 /* XNA->D3D11 Translation Arrays */
@@ -595,8 +617,8 @@ static ID3D11BlendState* D3D11_INTERNAL_FetchBlendState(
 
 	/* Can we just reuse an existing state? */
 	packedState = GetPackedBlendState(*state);
-	result = (ID3D11BlendState*) PackedStateArray_Fetch(
-		renderer->blendStateCache,
+	result = (ID3D11BlendState*) PackedStateHashTable_Fetch(
+		&renderer->blendStateCache,
 		packedState
 	);
 	if (result != NULL)
@@ -662,7 +684,7 @@ static ID3D11BlendState* D3D11_INTERNAL_FetchBlendState(
 		&result
 	);
 	ERROR_CHECK_RETURN("Blend state creation failed", NULL)
-	PackedStateArray_Insert(
+	PackedStateHashTable_Insert(
 		&renderer->blendStateCache,
 		packedState,
 		result
@@ -684,8 +706,8 @@ static ID3D11DepthStencilState* D3D11_INTERNAL_FetchDepthStencilState(
 
 	/* Can we just reuse an existing state? */
 	packedState = GetPackedDepthStencilState(*state);
-	result = (ID3D11DepthStencilState*) PackedStateArray_Fetch(
-		renderer->depthStencilStateCache,
+	result = (ID3D11DepthStencilState*) PackedStateHashTable_Fetch(
+		&renderer->depthStencilStateCache,
 		packedState
 	);
 	if (result != NULL)
@@ -748,7 +770,7 @@ static ID3D11DepthStencilState* D3D11_INTERNAL_FetchDepthStencilState(
 		&result
 	);
 	ERROR_CHECK_RETURN("Depth-stencil state creation failed", NULL)
-	PackedStateArray_Insert(
+	PackedStateHashTable_Insert(
 		&renderer->depthStencilStateCache,
 		packedState,
 		result
@@ -774,8 +796,8 @@ static ID3D11RasterizerState* D3D11_INTERNAL_FetchRasterizerState(
 
 	/* Can we just reuse an existing state? */
 	packedState = GetPackedRasterizerState(*state, depthBias);
-	result = (ID3D11RasterizerState*) PackedStateArray_Fetch(
-		renderer->rasterizerStateCache,
+	result = (ID3D11RasterizerState*) PackedStateHashTable_Fetch(
+		&renderer->rasterizerStateCache,
 		packedState
 	);
 	if (result != NULL)
@@ -803,7 +825,7 @@ static ID3D11RasterizerState* D3D11_INTERNAL_FetchRasterizerState(
 		&result
 	);
 	ERROR_CHECK_RETURN("Rasterizer state creation failed", NULL)
-	PackedStateArray_Insert(
+	PackedStateHashTable_Insert(
 		&renderer->rasterizerStateCache,
 		packedState,
 		result
@@ -824,8 +846,8 @@ static ID3D11SamplerState* D3D11_INTERNAL_FetchSamplerState(
 
 	/* Can we just reuse an existing state? */
 	packedState = GetPackedSamplerState(*state);
-	result = (ID3D11SamplerState*) PackedStateArray_Fetch(
-		renderer->samplerStateCache,
+	result = (ID3D11SamplerState*) PackedStateHashTable_Fetch(
+		&renderer->samplerStateCache,
 		packedState
 	);
 	if (result != NULL)
@@ -856,7 +878,7 @@ static ID3D11SamplerState* D3D11_INTERNAL_FetchSamplerState(
 		&result
 	);
 	ERROR_CHECK_RETURN("Sampler state creation failed", NULL)
-	PackedStateArray_Insert(
+	PackedStateHashTable_Insert(
 		&renderer->samplerStateCache,
 		packedState,
 		result
@@ -888,7 +910,7 @@ static ID3D11InputLayout* D3D11_INTERNAL_FetchBindingsInputLayout(
 
 	/* Can we just reuse an existing input layout? */
 	result = (ID3D11InputLayout*) PackedVertexBufferBindingsArray_Fetch(
-		renderer->inputLayoutCache,
+		&renderer->inputLayoutCache,
 		bindings,
 		numBindings,
 		vertexShader,
@@ -1008,6 +1030,7 @@ static ID3D11InputLayout* D3D11_INTERNAL_FetchBindingsInputLayout(
 		bindings,
 		numBindings,
 		vertexShader,
+		*hash,
 		result
 	);
 	return result;
@@ -1028,7 +1051,7 @@ static void D3D11_INTERNAL_UpdateSwapchainRT(
 	DXGI_FORMAT format
 );
 
-static void D3D11_SetRenderTargets(
+static void D3D11_INTERNAL_SetRenderTargets(
 	FNA3D_Renderer *driverData,
 	FNA3D_RenderTargetBinding *renderTargets,
 	int32_t numRenderTargets,
@@ -1099,38 +1122,50 @@ static void D3D11_DestroyDevice(FNA3D_Device *device)
 	SDL_free(renderer->swapchainDatas);
 
 	/* Release blend states */
-	for (i = 0; i < renderer->blendStateCache.count; i += 1)
+	for (i = 0; i < renderer->blendStateCache.capacity; i += 1)
 	{
-		ID3D11BlendState_Release(
-			(ID3D11BlendState*) renderer->blendStateCache.elements[i].value
-		);
+		if (renderer->blendStateCache.elements[i].value != NULL)
+		{
+			ID3D11BlendState_Release(
+				(ID3D11BlendState*) renderer->blendStateCache.elements[i].value
+			);
+		}
 	}
 	SDL_free(renderer->blendStateCache.elements);
 
 	/* Release depth stencil states */
-	for (i = 0; i < renderer->depthStencilStateCache.count; i += 1)
+	for (i = 0; i < renderer->depthStencilStateCache.capacity; i += 1)
 	{
-		ID3D11DepthStencilState_Release(
-			(ID3D11DepthStencilState*) renderer->depthStencilStateCache.elements[i].value
-		);
+		if (renderer->depthStencilStateCache.elements[i].value != NULL)
+		{
+			ID3D11DepthStencilState_Release(
+				(ID3D11DepthStencilState*) renderer->depthStencilStateCache.elements[i].value
+			);
+		}
 	}
 	SDL_free(renderer->depthStencilStateCache.elements);
 
 	/* Release rasterizer states */
-	for (i = 0; i < renderer->rasterizerStateCache.count; i += 1)
+	for (i = 0; i < renderer->rasterizerStateCache.capacity; i += 1)
 	{
-		ID3D11RasterizerState_Release(
-			(ID3D11RasterizerState*) renderer->rasterizerStateCache.elements[i].value
-		);
+		if (renderer->rasterizerStateCache.elements[i].value != NULL)
+		{
+			ID3D11RasterizerState_Release(
+				(ID3D11RasterizerState*) renderer->rasterizerStateCache.elements[i].value
+			);
+		}
 	}
 	SDL_free(renderer->rasterizerStateCache.elements);
 
 	/* Release sampler states */
-	for (i = 0; i < renderer->samplerStateCache.count; i += 1)
+	for (i = 0; i < renderer->samplerStateCache.capacity; i += 1)
 	{
-		ID3D11SamplerState_Release(
-			(ID3D11SamplerState*) renderer->samplerStateCache.elements[i].value
-		);
+		if (renderer->samplerStateCache.elements[i].value != NULL)
+		{
+			ID3D11SamplerState_Release(
+				(ID3D11SamplerState*) renderer->samplerStateCache.elements[i].value
+			);
+		}
 	}
 	SDL_free(renderer->samplerStateCache.elements);
 
@@ -1141,7 +1176,7 @@ static void D3D11_DestroyDevice(FNA3D_Device *device)
 			(ID3D11InputLayout*) renderer->inputLayoutCache.elements[i].value
 		);
 	}
-	SDL_free(renderer->inputLayoutCache.elements);
+	PackedVertexBufferBindingsArray_Destroy(&renderer->inputLayoutCache);
 
 	/* Release the annotation/iconv, if applicable */
 	if (renderer->annotation != NULL)
@@ -1167,6 +1202,7 @@ static void D3D11_DestroyDevice(FNA3D_Device *device)
 	SDL_UnloadObject(renderer->d3d11_dll);
 	SDL_UnloadObject(renderer->dxgi_dll);
 
+	FNA3D_MappedRange_Destroy(&renderer->mappedRange);
 	SDL_DestroyMutex(renderer->ctxLock);
 	SDL_free(renderer);
 	SDL_free(device);
@@ -1628,14 +1664,32 @@ static void D3D11_SwapBuffers(
 	{
 		presentFlags = 0;
 	}
-	IDXGISwapChain_Present(
-		swapchainData->swapchain,
-		renderer->syncInterval,
-		presentFlags
-	);
+	if (renderer->perf.enabled)
+	{
+		uint64_t presentStart = SDL_GetPerformanceCounter();
+		IDXGISwapChain_Present(
+			swapchainData->swapchain,
+			renderer->syncInterval,
+			presentFlags
+		);
+		FNA3D_PERF_ADD(
+			renderer->perf,
+			swapWaitNs,
+			((SDL_GetPerformanceCounter() - presentStart) * 1000000000ULL) /
+				SDL_GetPerformanceFrequency()
+		);
+	}
+	else
+	{
+		IDXGISwapChain_Present(
+			swapchainData->swapchain,
+			renderer->syncInterval,
+			presentFlags
+		);
+	}
 
 	/* Bind the faux-backbuffer now, in case DXGI unsets target state */
-	D3D11_SetRenderTargets(
+	D3D11_INTERNAL_SetRenderTargets(
 		(FNA3D_Renderer*) renderer,
 		NULL,
 		0,
@@ -1648,6 +1702,14 @@ static void D3D11_SwapBuffers(
 	 * unlock _after_ we present so the device context is safe in that time
 	 */
 	SDL_UnlockMutex(renderer->ctxLock);
+
+	/* Don't stall loading threads while we sleep off the frame */
+	FNA3D_FramePacer_Wait(&renderer->pacer, NULL);
+
+	SDL_LockMutex(renderer->ctxLock);
+	FNA3D_FramePacer_Record(&renderer->pacer, &renderer->perf);
+	FNA3D_PerfState_EndFrame(&renderer->perf);
+	SDL_UnlockMutex(renderer->ctxLock);
 }
 
 /* Drawing */
@@ -1666,6 +1728,11 @@ static void D3D11_Clear(
 
 	SDL_LockMutex(renderer->ctxLock);
 
+	if (renderer->perf.enabled)
+	{
+		FNA3D_PERF_ADD(renderer->perf, clearCalls, 1);
+	}
+
 	/* Clear color? */
 	if (options & FNA3D_CLEAROPTIONS_TARGET)
 	{
@@ -1752,6 +1819,11 @@ static void D3D11_DrawIndexedPrimitives(
 		(uint32_t) startIndex,
 		baseVertex
 	);
+	if (renderer->perf.enabled)
+	{
+		FNA3D_PERF_ADD(renderer->perf, drawCalls, 1);
+		FNA3D_PERF_ADD(renderer->perf, drawIndexedCalls, 1);
+	}
 
 	SDL_UnlockMutex(renderer->ctxLock);
 }
@@ -1806,6 +1878,11 @@ static void D3D11_DrawInstancedPrimitives(
 		baseVertex,
 		0
 	);
+	if (renderer->perf.enabled)
+	{
+		FNA3D_PERF_ADD(renderer->perf, drawCalls, 1);
+		FNA3D_PERF_ADD(renderer->perf, drawInstancedCalls, 1);
+	}
 
 	SDL_UnlockMutex(renderer->ctxLock);
 }
@@ -1836,6 +1913,11 @@ static void D3D11_DrawPrimitives(
 		(uint32_t) PrimitiveVerts(primitiveType, primitiveCount),
 		(uint32_t) vertexStart
 	);
+	if (renderer->perf.enabled)
+	{
+		FNA3D_PERF_ADD(renderer->perf, drawCalls, 1);
+		FNA3D_PERF_ADD(renderer->perf, drawPrimitiveCalls, 1);
+	}
 
 	SDL_UnlockMutex(renderer->ctxLock);
 }
@@ -2415,7 +2497,7 @@ static void D3D11_INTERNAL_RestoreTargetTextures(D3D11Renderer *renderer)
 	}
 }
 
-static void D3D11_SetRenderTargets(
+static void D3D11_INTERNAL_SetRenderTargets(
 	FNA3D_Renderer *driverData,
 	FNA3D_RenderTargetBinding *renderTargets,
 	int32_t numRenderTargets,
@@ -2522,6 +2604,31 @@ static void D3D11_SetRenderTargets(
 	renderer->numRenderTargets = numRenderTargets;
 }
 
+static void D3D11_SetRenderTargets(
+	FNA3D_Renderer *driverData,
+	FNA3D_RenderTargetBinding *renderTargets,
+	int32_t numRenderTargets,
+	FNA3D_Renderbuffer *depthStencilBuffer,
+	FNA3D_DepthFormat depthFormat,
+	uint8_t preserveTargetContents
+) {
+	D3D11Renderer *renderer = (D3D11Renderer*) driverData;
+
+	/* Only the application's calls count, not the backbuffer rebinds */
+	if (renderer->perf.enabled)
+	{
+		FNA3D_PERF_ADD(renderer->perf, setRenderTargetCalls, 1);
+	}
+	D3D11_INTERNAL_SetRenderTargets(
+		driverData,
+		renderTargets,
+		numRenderTargets,
+		depthStencilBuffer,
+		depthFormat,
+		preserveTargetContents
+	);
+}
+
 static void D3D11_ResolveTarget(
 	FNA3D_Renderer *driverData,
 	FNA3D_RenderTargetBinding *target
@@ -3130,7 +3237,7 @@ static void D3D11_INTERNAL_CreateBackbuffer(
 	}
 
 	/* This is the default render target */
-	D3D11_SetRenderTargets(
+	D3D11_INTERNAL_SetRenderTargets(
 		(FNA3D_Renderer*) renderer,
 		NULL,
 		0,
@@ -4101,6 +4208,216 @@ static void D3D11_GetTextureDataCube(
 	}
 }
 
+static FNA3D_Readback* D3D11_RequestTextureDataAsync(
+	FNA3D_Renderer *driverData,
+	FNA3D_Texture *texture,
+	int32_t x,
+	int32_t y,
+	int32_t w,
+	int32_t h,
+	int32_t level,
+	int32_t dataLength
+) {
+	D3D11Renderer *renderer = (D3D11Renderer*) driverData;
+	D3D11Texture *tex = (D3D11Texture*) texture;
+	D3D11Readback *readback;
+	D3D11_TEXTURE2D_DESC stagingDesc;
+	ID3D11Resource *stagingTexture;
+	ID3D11Resource *source;
+	ID3D11Texture2D *swapchainBuffer = NULL;
+	FNA3D_SurfaceFormat format;
+	uint32_t subresourceIndex;
+	D3D11_BOX srcBox = {x, y, 0, x + w, y + h, 1};
+	HRESULT res;
+
+	if (tex == NULL)
+	{
+		if (renderer->backbuffer->type == BACKBUFFER_TYPE_D3D11)
+		{
+			source = (
+				renderer->backbuffer->multiSampleCount > 1 ?
+					(ID3D11Resource*) renderer->backbuffer->d3d11.resolveBuffer :
+					(ID3D11Resource*) renderer->backbuffer->d3d11.colorBuffer
+			);
+			format = renderer->backbuffer->d3d11.surfaceFormat;
+		}
+		else
+		{
+			/* This is only possible with a single window/swapchain, 0 should be safe */
+			res = IDXGISwapChain_GetBuffer(
+				renderer->swapchainDatas[0]->swapchain,
+				0,
+				&D3D_IID_ID3D11Texture2D,
+				(void**) &swapchainBuffer
+			);
+			ERROR_CHECK_RETURN("Could not get buffer from swapchain", NULL)
+			source = (ID3D11Resource*) swapchainBuffer;
+			format = renderer->swapchainDatas[0]->format;
+		}
+		subresourceIndex = 0;
+	}
+	else
+	{
+		source = tex->handle;
+		format = tex->format;
+		subresourceIndex = D3D11_INTERNAL_CalcSubresource(
+			level,
+			0,
+			tex->levelCount
+		);
+	}
+
+	/* FNA3D.c takes the synchronous path, which logs the error */
+	if (Texture_GetBlockSize(format) != 1)
+	{
+		if (swapchainBuffer != NULL)
+		{
+			ID3D11Texture2D_Release(swapchainBuffer);
+		}
+		return NULL;
+	}
+
+	/* Only the region being read, so the copy is as small as it gets */
+	stagingDesc.Width = w;
+	stagingDesc.Height = h;
+	stagingDesc.MipLevels = 1;
+	stagingDesc.ArraySize = 1;
+	stagingDesc.Format = XNAToD3D_TextureFormat[format];
+	stagingDesc.SampleDesc.Count = 1;
+	stagingDesc.SampleDesc.Quality = 0;
+	stagingDesc.Usage = D3D11_USAGE_STAGING;
+	stagingDesc.BindFlags = 0;
+	stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	stagingDesc.MiscFlags = 0;
+
+	res = ID3D11Device_CreateTexture2D(
+		renderer->device,
+		&stagingDesc,
+		NULL,
+		(ID3D11Texture2D**) &stagingTexture
+	);
+	if (FAILED(res))
+	{
+		D3D11_INTERNAL_LogError(
+			renderer->device,
+			"Readback staging texture creation failed",
+			res
+		);
+		if (swapchainBuffer != NULL)
+		{
+			ID3D11Texture2D_Release(swapchainBuffer);
+		}
+		return NULL;
+	}
+
+	SDL_LockMutex(renderer->ctxLock);
+	if (tex == NULL && renderer->backbuffer->multiSampleCount > 1)
+	{
+		/* We have to resolve the backbuffer first. */
+		ID3D11DeviceContext_ResolveSubresource(
+			renderer->context,
+			(ID3D11Resource*) renderer->backbuffer->d3d11.resolveBuffer,
+			0,
+			(ID3D11Resource*) renderer->backbuffer->d3d11.colorBuffer,
+			0,
+			XNAToD3D_TextureFormat[renderer->backbuffer->d3d11.surfaceFormat]
+		);
+	}
+
+	/* Queued like any other command, PollReadback maps it once it's done */
+	ID3D11DeviceContext_CopySubresourceRegion(
+		renderer->context,
+		stagingTexture,
+		0,
+		0,
+		0,
+		0,
+		source,
+		subresourceIndex,
+		&srcBox
+	);
+	SDL_UnlockMutex(renderer->ctxLock);
+
+	if (swapchainBuffer != NULL)
+	{
+		/* Cleanup is required for any GetBuffer call! */
+		ID3D11Texture2D_Release(swapchainBuffer);
+	}
+
+	readback = (D3D11Readback*) SDL_malloc(sizeof(D3D11Readback));
+	readback->base.dataLength = dataLength;
+	readback->base.data = NULL;
+	readback->staging = stagingTexture;
+	readback->pitch = w * Texture_GetFormatSize(format);
+	readback->rows = h;
+	return &readback->base;
+}
+
+static uint8_t D3D11_PollReadback(
+	FNA3D_Renderer *driverData,
+	FNA3D_Readback *readback,
+	void* data,
+	int32_t dataLength
+) {
+	D3D11Renderer *renderer = (D3D11Renderer*) driverData;
+	D3D11Readback *d3dReadback = (D3D11Readback*) readback;
+	D3D11_MAPPED_SUBRESOURCE subresource;
+	uint8_t *dataPtr = (uint8_t*) data;
+	int32_t row, rows;
+	HRESULT res;
+
+	if (data != NULL)
+	{
+		SDL_LockMutex(renderer->ctxLock);
+		res = ID3D11DeviceContext_Map(
+			renderer->context,
+			d3dReadback->staging,
+			0,
+			D3D11_MAP_READ,
+			D3D11_MAP_FLAG_DO_NOT_WAIT,
+			&subresource
+		);
+		if (res == DXGI_ERROR_WAS_STILL_DRAWING)
+		{
+			SDL_UnlockMutex(renderer->ctxLock);
+			return 0;
+		}
+		if (SUCCEEDED(res))
+		{
+			rows = SDL_min(
+				d3dReadback->rows,
+				SDL_min(dataLength, readback->dataLength) / d3dReadback->pitch
+			);
+			for (row = 0; row < rows; row += 1)
+			{
+				SDL_memcpy(
+					dataPtr + (row * d3dReadback->pitch),
+					(uint8_t*) subresource.pData + (row * subresource.RowPitch),
+					d3dReadback->pitch
+				);
+			}
+			ID3D11DeviceContext_Unmap(
+				renderer->context,
+				d3dReadback->staging,
+				0
+			);
+		}
+		else
+		{
+			D3D11_INTERNAL_LogError(
+				renderer->device,
+				"Could not map readback for reading",
+				res
+			);
+		}
+		SDL_UnlockMutex(renderer->ctxLock);
+	}
+
+	ID3D11Resource_Release(d3dReadback->staging);
+	SDL_free(d3dReadback);
+	return 1;
+}
+
 /* Renderbuffers */
 
 static FNA3D_Renderbuffer* D3D11_GenColorRenderbuffer(
@@ -4364,6 +4681,11 @@ static void D3D11_SetVertexBufferData(
 			(ID3D11Resource*) d3dBuffer->handle,
 			0
 		);
+		if (renderer->perf.enabled)
+		{
+			FNA3D_PERF_ADD(renderer->perf, mapWrites, 1);
+			FNA3D_PERF_ADD(renderer->perf, mapBytes, dataLen);
+		}
 	}
 	else
 	{
@@ -4376,6 +4698,107 @@ static void D3D11_SetVertexBufferData(
 			dataLen,
 			dataLen
 		);
+		if (renderer->perf.enabled)
+		{
+			FNA3D_PERF_ADD(renderer->perf, subDataWrites, 1);
+			FNA3D_PERF_ADD(renderer->perf, subDataBytes, dataLen);
+		}
+	}
+	if (renderer->perf.enabled)
+	{
+		FNA3D_PERF_ADD(renderer->perf, vertexUploadCalls, 1);
+		FNA3D_PERF_ADD(renderer->perf, vertexUploadBytes, dataLen);
+	}
+	SDL_UnlockMutex(renderer->ctxLock);
+}
+
+static void* D3D11_MapVertexBufferRange(
+	FNA3D_Renderer *driverData,
+	FNA3D_Buffer *buffer,
+	int32_t offsetInBytes,
+	int32_t lengthInBytes,
+	FNA3D_SetDataOptions options
+) {
+	D3D11Renderer *renderer = (D3D11Renderer*) driverData;
+	D3D11Buffer *d3dBuffer = (D3D11Buffer*) buffer;
+	D3D11_MAPPED_SUBRESOURCE subres = {0, 0, 0};
+	HRESULT res;
+
+	if (!FNA3D_MappedRange_Begin(
+		&renderer->mappedRange,
+		buffer,
+		offsetInBytes,
+		lengthInBytes,
+		options
+	)) {
+		return NULL;
+	}
+
+	/* Default buffers can only be written with UpdateSubresource */
+	if (!d3dBuffer->dynamic)
+	{
+		return FNA3D_MappedRange_GetScratch(&renderer->mappedRange);
+	}
+
+	/* Same as SetVertexBufferData, the context stays locked until unmap */
+	SDL_LockMutex(renderer->ctxLock);
+	res = ID3D11DeviceContext_Map(
+		renderer->context,
+		(ID3D11Resource*) d3dBuffer->handle,
+		0,
+		options == FNA3D_SETDATAOPTIONS_NOOVERWRITE ?
+			D3D11_MAP_WRITE_NO_OVERWRITE :
+			D3D11_MAP_WRITE_DISCARD,
+		0,
+		&subres
+	);
+	if (FAILED(res))
+	{
+		renderer->mappedRange.buffer = NULL;
+	}
+	ERROR_CHECK_UNLOCK_RETURN("Could not map vertex buffer for writing", NULL)
+	return (uint8_t*) subres.pData + offsetInBytes;
+}
+
+static void D3D11_UnmapVertexBufferRange(
+	FNA3D_Renderer *driverData,
+	FNA3D_Buffer *buffer
+) {
+	D3D11Renderer *renderer = (D3D11Renderer*) driverData;
+	D3D11Buffer *d3dBuffer = (D3D11Buffer*) buffer;
+	FNA3D_MappedRange *range = &renderer->mappedRange;
+
+	if (!FNA3D_MappedRange_End(range, buffer))
+	{
+		return;
+	}
+
+	if (range->usingScratch)
+	{
+		D3D11_SetVertexBufferData(
+			driverData,
+			buffer,
+			range->offsetInBytes,
+			range->scratch,
+			range->lengthInBytes,
+			1,
+			1,
+			range->options
+		);
+		return;
+	}
+
+	ID3D11DeviceContext_Unmap(
+		renderer->context,
+		(ID3D11Resource*) d3dBuffer->handle,
+		0
+	);
+	if (renderer->perf.enabled)
+	{
+		FNA3D_PERF_ADD(renderer->perf, mapWrites, 1);
+		FNA3D_PERF_ADD(renderer->perf, mapBytes, range->lengthInBytes);
+		FNA3D_PERF_ADD(renderer->perf, vertexUploadCalls, 1);
+		FNA3D_PERF_ADD(renderer->perf, vertexUploadBytes, range->lengthInBytes);
 	}
 	SDL_UnlockMutex(renderer->ctxLock);
 }
@@ -4577,6 +5000,11 @@ static void D3D11_SetIndexBufferData(
 			(ID3D11Resource*) d3dBuffer->handle,
 			0
 		);
+		if (renderer->perf.enabled)
+		{
+			FNA3D_PERF_ADD(renderer->perf, mapWrites, 1);
+			FNA3D_PERF_ADD(renderer->perf, mapBytes, dataLength);
+		}
 	}
 	else
 	{
@@ -4589,6 +5017,16 @@ static void D3D11_SetIndexBufferData(
 			dataLength,
 			dataLength
 		);
+		if (renderer->perf.enabled)
+		{
+			FNA3D_PERF_ADD(renderer->perf, subDataWrites, 1);
+			FNA3D_PERF_ADD(renderer->perf, subDataBytes, dataLength);
+		}
+	}
+	if (renderer->perf.enabled)
+	{
+		FNA3D_PERF_ADD(renderer->perf, indexUploadCalls, 1);
+		FNA3D_PERF_ADD(renderer->perf, indexUploadBytes, dataLength);
 	}
 	SDL_UnlockMutex(renderer->ctxLock);
 }
@@ -4678,10 +5116,8 @@ static void D3D11_INTERNAL_DeleteShader(const void *ctx, void* shader)
 	renderer = (D3D11Renderer*) pd->malloc_data;
 	arr = &renderer->inputLayoutCache;
 
-	/* Run through input layout cache in reverse order, to minimize the
-	 * damage of doing memmove a bunch of times
-	 */
-	for (i = arr->count - 1; i >= 0; i -= 1)
+	/* Release the input layouts, then drop their entries in one pass */
+	for (i = 0; i < arr->count; i += 1)
 	{
 		const PackedVertexBufferBindingsMap *elem = &arr->elements[i];
 		if (elem->key.vertexShader == shader)
@@ -4689,14 +5125,9 @@ static void D3D11_INTERNAL_DeleteShader(const void *ctx, void* shader)
 			ID3D11InputLayout_Release(
 				(ID3D11InputLayout*) elem->value
 			);
-			SDL_memmove(
-				arr->elements + i,
-				arr->elements + i + 1,
-				sizeof(PackedVertexBufferBindingsMap) * (arr->count - i - 1)
-			);
-			arr->count -= 1;
 		}
 	}
+	PackedVertexBufferBindingsArray_RemoveShader(arr, shader);
 
 	MOJOSHADER_d3d11DeleteShader(renderer->shaderContext, d3dShader);
 }
@@ -4773,6 +5204,14 @@ static void D3D11_CloneEffect(
 	*effect = (FNA3D_Effect*) result;
 }
 
+static void D3D11_PrewarmPipelines(
+	FNA3D_Renderer *driverData,
+	FNA3D_PipelineManifest *manifest
+) {
+	/* No pipeline objects to prewarm, shaders are linked as they're used */
+	FNA3D_PipelineManifest_Destroy(manifest);
+}
+
 static void D3D11_AddDisposeEffect(
 	FNA3D_Renderer *driverData,
 	FNA3D_Effect *effect
@@ -4818,6 +5257,10 @@ static void D3D11_ApplyEffect(
 
 	SDL_LockMutex(renderer->ctxLock);
 	renderer->effectApplied = 1;
+	if (renderer->perf.enabled)
+	{
+		FNA3D_PERF_ADD(renderer->perf, applyEffectCalls, 1);
+	}
 	if (effectData == renderer->currentEffect)
 	{
 		if (	technique == renderer->currentTechnique &&
@@ -5101,6 +5544,18 @@ static int32_t D3D11_GetMaxMultiSampleCount(
 	return multiSampleCount;
 }
 
+/* Performance Counters */
+
+static void D3D11_GetPerfCounters(
+	FNA3D_Renderer *driverData,
+	FNA3D_PerfCounters *counters
+) {
+	D3D11Renderer *renderer = (D3D11Renderer*) driverData;
+	SDL_LockMutex(renderer->ctxLock);
+	FNA3D_PerfState_Get(&renderer->perf, counters);
+	SDL_UnlockMutex(renderer->ctxLock);
+}
+
 /* Debugging */
 
 static void D3D11_SetStringMarker(FNA3D_Renderer *driverData, const char *text)
@@ -5571,6 +6026,11 @@ static FNA3D_Device* D3D11_CreateDevice(
 	/* Allocate and zero out the renderer */
 	renderer = (D3D11Renderer*) SDL_malloc(sizeof(D3D11Renderer));
 	SDL_memset(renderer, '\0', sizeof(D3D11Renderer));
+	FNA3D_PerfState_Init(&renderer->perf);
+	FNA3D_FramePacer_Init(
+		&renderer->pacer,
+		presentationParameters->deviceWindowHandle
+	);
 
 	/* Load DXGI... */
 #ifdef __ANDROID__
@@ -0,0 +1,1612 @@
+/* FNA3D - 3D Graphics Library for FNA
+ *
+ * Copyright (c) 2020-2024 Ethan Lee
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from
+ * the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ * claim that you wrote the original software. If you use this software in a
+ * product, an acknowledgment in the product documentation would be
+ * appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ * misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ * Ethan "flibitijibibo" Lee <flibitijibibo@flibitijibibo.com>
+ *
+ */
+
+#if FNA3D_DRIVER_NULL
+
+#include "FNA3D_Driver.h"
+#include "FNA3D_PipelineCache.h"
+#include "FNA3D_PipelineManifest.h"
+
+#ifdef USE_SDL3
+#include <SDL3/SDL.h>
+#else
+#include <SDL.h>
+#endif
+
+/* The Null driver has no graphics API underneath it. Everything the other
+ * drivers do on the CPU still happens here: effects are parsed by MojoShader,
+ * uniforms are committed, render states are packed and looked up in the same
+ * caches, and vertex layouts are matched against the bound vertex shader.
+ * Only the API calls are missing, so traces and benchmarks run with this
+ * driver measure FNA3D's own overhead.
+ *
+ * It is never picked automatically, set FNA3D_FORCE_DRIVER=Null to use it.
+ */
+
+/* Same sizes as the MojoShader GL/SDL contexts use */
+#define MAX_REG_FILE_F 8192
+#define MAX_REG_FILE_I 2047
+#define MAX_REG_FILE_B 2047
+
+static const float NullDepthBiasScale[] =
+{
+	0.0f,				/* FNA3D_DEPTHFORMAT_NONE */
+	(float) ((1 << 16) - 1),	/* FNA3D_DEPTHFORMAT_D16 */
+	(float) ((1 << 24) - 1),	/* FNA3D_DEPTHFORMAT_D24 */
+	(float) ((1 << 24) - 1)		/* FNA3D_DEPTHFORMAT_D24S8 */
+};
+
+/* Internal Structures */
+
+typedef struct NullTexture /* Cast from FNA3D_Texture* */
+{
+	FNA3D_SurfaceFormat format;
+	int32_t width;
+	int32_t height;
+	int32_t depth;
+	int32_t levelCount;
+	uint8_t isRenderTarget;
+} NullTexture;
+
+typedef struct NullRenderbuffer /* Cast from FNA3D_Renderbuffer* */
+{
+	int32_t width;
+	int32_t height;
+	int32_t multiSampleCount;
+} NullRenderbuffer;
+
+typedef struct NullBuffer /* Cast from FNA3D_Buffer* */
+{
+	uint8_t *data;
+	int32_t size;
+} NullBuffer;
+
+typedef struct NullEffect /* Cast from FNA3D_Effect* */
+{
+	MOJOSHADER_effect *effect;
+} NullEffect;
+
+typedef struct NullQuery /* Cast from FNA3D_Query* */
+{
+	uint8_t active;
+} NullQuery;
+
+typedef struct NullShader
+{
+	const MOJOSHADER_parseData *parseData;
+	uint32_t refcount;
+} NullShader;
+
+/* Stands in for an input layout, one bit per vertex shader attribute */
+typedef struct NullVertexLayout
+{
+	uint32_t attributeMask;
+} NullVertexLayout;
+
+typedef struct NullRenderer /* Cast from FNA3D_Renderer* */
+{
+	/* Faux-Backbuffer */
+	int32_t backbufferWidth;
+	int32_t backbufferHeight;
+	FNA3D_SurfaceFormat backbufferFormat;
+	FNA3D_DepthFormat backbufferDepthFormat;
+	int32_t backbufferMultiSampleCount;
+
+	/* Render Targets */
+	int32_t numRenderTargets;
+	FNA3D_DepthFormat currentDepthFormat;
+
+	/* Mutable Render States */
+	FNA3D_Viewport viewport;
+	FNA3D_Rect scissorRect;
+	FNA3D_Color blendFactor;
+	int32_t multiSampleMask;
+	int32_t stencilRef;
+
+	/* Bound State Objects, owned by the caches below */
+	FNA3D_BlendState *blendState;
+	FNA3D_DepthStencilState *depthStencilState;
+	FNA3D_RasterizerState *rasterizerState;
+	FNA3D_SamplerState *samplers[MAX_TOTAL_SAMPLERS];
+	NullTexture *textures[MAX_TOTAL_SAMPLERS];
+	NullVertexLayout *vertexLayout;
+
+	/* State Caches */
+	PackedStateHashTable blendStateCache;
+	PackedStateHashTable depthStencilStateCache;
+	PackedStateHashTable rasterizerStateCache;
+	PackedStateHashTable samplerStateCache;
+	PackedVertexBufferBindingsArray vertexLayoutCache;
+
+	/* Mapped Vertex Ranges */
+	FNA3D_MappedRange mappedRange;
+
+	/* Effect Handling */
+	MOJOSHADER_effect *currentEffect;
+	const MOJOSHADER_effectTechnique *currentTechnique;
+	uint32_t currentPass;
+	uint8_t effectApplied;
+	NullShader *vertexShader;
+	NullShader *pixelShader;
+	char shaderError[1024];
+
+	/* Uniform register files, filled by MOJOSHADER_effectCommitChanges */
+	float vsRegisterFileF[MAX_REG_FILE_F * 4];
+	int32_t vsRegisterFileI[MAX_REG_FILE_I * 4];
+	uint8_t vsRegisterFileB[MAX_REG_FILE_B];
+	float psRegisterFileF[MAX_REG_FILE_F * 4];
+	int32_t psRegisterFileI[MAX_REG_FILE_I * 4];
+	uint8_t psRegisterFileB[MAX_REG_FILE_B];
+
+	/* Performance Counters */
+	FNA3D_PerfState perf;
+} NullRenderer;
+
+/* State Caches */
+
+static void* NULLDRV_INTERNAL_FetchState(
+	PackedStateHashTable *table,
+	PackedState packedState,
+	const void *state,
+	size_t stateSize
+) {
+	void *result;
+
+	/* Can we just reuse an existing state? */
+	result = PackedStateHashTable_Fetch(table, packedState);
+	if (result != NULL)
+	{
+		/* The state is already cached! */
+		return result;
+	}
+
+	/* We have to make a new state object... */
+	result = SDL_malloc(stateSize);
+	SDL_memcpy(result, state, stateSize);
+	PackedStateHashTable_Insert(table, packedState, result);
+	return result;
+}
+
+static void NULLDRV_INTERNAL_DestroyStateCache(PackedStateHashTable *table)
+{
+	int32_t i;
+
+	for (i = 0; i < table->capacity; i += 1)
+	{
+		if (table->elements[i].value != NULL)
+		{
+			SDL_free(table->elements[i].value);
+		}
+	}
+	SDL_free(table->elements);
+}
+
+static NullVertexLayout* NULLDRV_INTERNAL_FetchVertexLayout(
+	NullRenderer *renderer,
+	FNA3D_VertexBufferBinding *bindings,
+	int32_t numBindings
+) {
+	const MOJOSHADER_parseData *pd;
+	const FNA3D_VertexElement *element;
+	NullVertexLayout *result;
+	MOJOSHADER_usage usage;
+	int32_t bindingsIndex, i, j, k;
+	uint32_t hash;
+
+	/* We need the vertex shader... */
+	if (renderer->vertexShader == NULL)
+	{
+		return NULL;
+	}
+
+	/* Can we just reuse an existing layout? */
+	result = (NullVertexLayout*) PackedVertexBufferBindingsArray_Fetch(
+		&renderer->vertexLayoutCache,
+		bindings,
+		numBindings,
+		renderer->vertexShader,
+		&bindingsIndex,
+		&hash
+	);
+	if (result != NULL)
+	{
+		/* This layout has already been cached! */
+		return result;
+	}
+
+	/* Match each element to the attribute the shader reads it as */
+	pd = renderer->vertexShader->parseData;
+	result = (NullVertexLayout*) SDL_malloc(sizeof(NullVertexLayout));
+	result->attributeMask = 0;
+	for (i = 0; i < numBindings; i += 1)
+	{
+		for (j = 0; j < bindings[i].vertexDeclaration.elementCount; j += 1)
+		{
+			element = &bindings[i].vertexDeclaration.elements[j];
+			usage = VertexAttribUsage(element->vertexElementUsage);
+			for (k = 0; k < pd->attribute_count && k < 32; k += 1)
+			{
+				if (	pd->attributes[k].usage == usage &&
+					pd->attributes[k].index == element->usageIndex	)
+				{
+					result->attributeMask |= (1u << k);
+					break;
+				}
+			}
+		}
+	}
+
+	PackedVertexBufferBindingsArray_Insert(
+		&renderer->vertexLayoutCache,
+		bindings,
+		numBindings,
+		renderer->vertexShader,
+		hash,
+		result
+	);
+	return result;
+}
+
+/* Quit */
+
+static void NULLDRV_DestroyDevice(FNA3D_Device *device)
+{
+	NullRenderer *renderer = (NullRenderer*) device->driverData;
+	int32_t i;
+
+	NULLDRV_INTERNAL_DestroyStateCache(&renderer->blendStateCache);
+	NULLDRV_INTERNAL_DestroyStateCache(&renderer->depthStencilStateCache);
+	NULLDRV_INTERNAL_DestroyStateCache(&renderer->rasterizerStateCache);
+	NULLDRV_INTERNAL_DestroyStateCache(&renderer->samplerStateCache);
+
+	for (i = 0; i < renderer->vertexLayoutCache.count; i += 1)
+	{
+		SDL_free(renderer->vertexLayoutCache.elements[i].value);
+	}
+	PackedVertexBufferBindingsArray_Destroy(&renderer->vertexLayoutCache);
+
+	FNA3D_MappedRange_Destroy(&renderer->mappedRange);
+
+	SDL_free(renderer);
+	SDL_free(device);
+}
+
+/* Presentation */
+
+static void NULLDRV_SwapBuffers(
+	FNA3D_Renderer *driverData,
+	FNA3D_Rect *sourceRectangle,
+	FNA3D_Rect *destinationRectangle,
+	void* overrideWindowHandle
+) {
+	NullRenderer *renderer = (NullRenderer*) driverData;
+	FNA3D_PerfState_EndFrame(&renderer->perf);
+}
+
+/* Drawing */
+
+static void NULLDRV_Clear(
+	FNA3D_Renderer *driverData,
+	FNA3D_ClearOptions options,
+	FNA3D_Vec4 *color,
+	float depth,
+	int32_t stencil
+) {
+	NullRenderer *renderer = (NullRenderer*) driverData;
+	if (renderer->perf.enabled)
+	{
+		FNA3D_PERF_ADD(renderer->perf, clearCalls, 1);
+	}
+}
+
+static void NULLDRV_DrawInstancedPrimitives(
+	FNA3D_Renderer *driverData,
+	FNA3D_PrimitiveType primitiveType,
+	int32_t baseVertex,
+	int32_t minVertexIndex,
+	int32_t numVertices,
+	int32_t startIndex,
+	int32_t primitiveCount,
+	int32_t instanceCount,
+	FNA3D_Buffer *indices,
+	FNA3D_IndexElementSize indexElementSize
+) {
+	NullRenderer *renderer = (NullRenderer*) driverData;
+	if (renderer->perf.enabled)
+	{
+		FNA3D_PERF_ADD(renderer->perf, drawCalls, 1);
+		if (instanceCount > 1)
+		{
+			FNA3D_PERF_ADD(renderer->perf, drawInstancedCalls, 1);
+		}
+		else
+		{
+			FNA3D_PERF_ADD(renderer->perf, drawIndexedCalls, 1);
+		}
+	}
+}
+
+static void NULLDRV_DrawIndexedPrimitives(
+	FNA3D_Renderer *driverData,
+	FNA3D_PrimitiveType primitiveType,
+	int32_t baseVertex,
+	int32_t minVertexIndex,
+	int32_t numVertices,
+	int32_t startIndex,
+	int32_t primitiveCount,
+	FNA3D_Buffer *indices,
+	FNA3D_IndexElementSize indexElementSize
+) {
+	NULLDRV_DrawInstancedPrimitives(
+		driverData,
+		primitiveType,
+		baseVertex,
+		minVertexIndex,
+		numVertices,
+		startIndex,
+		primitiveCount,
+		1,
+		indices,
+		indexElementSize
+	);
+}
+
+static void NULLDRV_DrawPrimitives(
+	FNA3D_Renderer *driverData,
+	FNA3D_PrimitiveType primitiveType,
+	int32_t vertexStart,
+	int32_t primitiveCount
+) {
+	NullRenderer *renderer = (NullRenderer*) driverData;
+	if (renderer->perf.enabled)
+	{
+		FNA3D_PERF_ADD(renderer->perf, drawCalls, 1);
+		FNA3D_PERF_ADD(renderer->perf, drawPrimitiveCalls, 1);
+	}
+}
+
+/* Mutable Render States */
+
+static void NULLDRV_SetViewport(
+	FNA3D_Renderer *driverData,
+	FNA3D_Viewport *viewport
+) {
+	NullRenderer *renderer = (NullRenderer*) driverData;
+	renderer->viewport = *viewport;
+}
+
+static void NULLDRV_SetScissorRect(
+	FNA3D_Renderer *driverData,
+	FNA3D_Rect *scissor
+) {
+	NullRenderer *renderer = (NullRenderer*) driverData;
+	renderer->scissorRect = *scissor;
+}
+
+static void NULLDRV_GetBlendFactor(
+	FNA3D_Renderer *driverData,
+	FNA3D_Color *blendFactor
+) {
+	NullRenderer *renderer = (NullRenderer*) driverData;
+	*blendFactor = renderer->blendFactor;
+}
+
+static void NULLDRV_SetBlendFactor(
+	FNA3D_Renderer *driverData,
+	FNA3D_Color *blendFactor
+) {
+	NullRenderer *renderer = (NullRenderer*) driverData;
+	renderer->blendFactor = *blendFactor;
+}
+
+static int32_t NULLDRV_GetMultiSampleMask(FNA3D_Renderer *driverData)
+{
+	NullRenderer *renderer = (NullRenderer*) driverData;
+	return renderer->multiSampleMask;
+}
+
+static void NULLDRV_SetMultiSampleMask(FNA3D_Renderer *driverData, int32_t mask)
+{
+	NullRenderer *renderer = (NullRenderer*) driverData;
+	renderer->multiSampleMask = mask;
+}
+
+static int32_t NULLDRV_GetReferenceStencil(FNA3D_Renderer *driverData)
+{
+	NullRenderer *renderer = (NullRenderer*) driverData;
+	return renderer->stencilRef;
+}
+
+static void NULLDRV_SetReferenceStencil(FNA3D_Renderer *driverData, int32_t ref)
+{
+	NullRenderer *renderer = (NullRenderer*) driverData;
+	renderer->stencilRef = ref;
+}
+
+/* Immutable Render States */
+
+static void NULLDRV_SetBlendState(
+	FNA3D_Renderer *driverData,
+	FNA3D_BlendState *blendState
+) {
+	NullRenderer *renderer = (NullRenderer*) driverData;
+
+	renderer->blendState = (FNA3D_BlendState*) NULLDRV_INTERNAL_FetchState(
+		&renderer->blendStateCache,
+		GetPackedBlendState(*blendState),
+		blendState,
+		sizeof(FNA3D_BlendState)
+	);
+	renderer->blendFactor = blendState->blendFactor;
+	renderer->multiSampleMask = blendState->multiSampleMask;
+}
+
+static void NULLDRV_SetDepthStencilState(
+	FNA3D_Renderer *driverData,
+	FNA3D_DepthStencilState *depthStencilState
+) {
+	NullRenderer *renderer = (NullRenderer*) driverData;
+
+	renderer->depthStencilState = (FNA3D_DepthStencilState*) NULLDRV_INTERNAL_FetchState(
+		&renderer->depthStencilStateCache,
+		GetPackedDepthStencilState(*depthStencilState),
+		depthStencilState,
+		sizeof(FNA3D_DepthStencilState)
+	);
+	renderer->stencilRef = depthStencilState->referenceStencil;
+}
+
+static void NULLDRV_ApplyRasterizerState(
+	FNA3D_Renderer *driverData,
+	FNA3D_RasterizerState *rasterizerState
+) {
+	NullRenderer *renderer = (NullRenderer*) driverData;
+	float depthBias;
+
+	depthBias = rasterizerState->depthBias * NullDepthBiasScale[
+		renderer->currentDepthFormat
+	];
+	renderer->rasterizerState = (FNA3D_RasterizerState*) NULLDRV_INTERNAL_FetchState(
+		&renderer->rasterizerStateCache,
+		GetPackedRasterizerState(*rasterizerState, depthBias),
+		rasterizerState,
+		sizeof(FNA3D_RasterizerState)
+	);
+}
+
+static void NULLDRV_VerifySampler(
+	FNA3D_Renderer *driverData,
+	int32_t index,
+	FNA3D_Texture *texture,
+	FNA3D_SamplerState *sampler
+) {
+	NullRenderer *renderer = (NullRenderer*) driverData;
+
+	renderer->textures[index] = (NullTexture*) texture;
+	if (texture == NULL)
+	{
+		renderer->samplers[index] = NULL;
+		return;
+	}
+
+	renderer->samplers[index] = (FNA3D_SamplerState*) NULLDRV_INTERNAL_FetchState(
+		&renderer->samplerStateCache,
+		GetPackedSamplerState(*sampler),
+		sampler,
+		sizeof(FNA3D_SamplerState)
+	);
+}
+
+static void NULLDRV_VerifyVertexSampler(
+	FNA3D_Renderer *driverData,
+	int32_t index,
+	FNA3D_Texture *texture,
+	FNA3D_SamplerState *sampler
+) {
+	NULLDRV_VerifySampler(
+		driverData,
+		MAX_TEXTURE_SAMPLERS + index,
+		texture,
+		sampler
+	);
+}
+
+static void NULLDRV_ApplyVertexBufferBindings(
+	FNA3D_Renderer *driverData,
+	FNA3D_VertexBufferBinding *bindings,
+	int32_t numBindings,
+	uint8_t bindingsUpdated,
+	int32_t baseVertex
+) {
+	NullRenderer *renderer = (NullRenderer*) driverData;
+
+	if (!bindingsUpdated && !renderer->effectApplied)
+	{
+		return;
+	}
+
+	renderer->vertexLayout = NULLDRV_INTERNAL_FetchVertexLayout(
+		renderer,
+		bindings,
+		numBindings
+	);
+	renderer->effectApplied = 0;
+}
+
+/* Render Targets */
+
+static void NULLDRV_SetRenderTargets(
+	FNA3D_Renderer *driverData,
+	FNA3D_RenderTargetBinding *renderTargets,
+	int32_t numRenderTargets,
+	FNA3D_Renderbuffer *depthStencilBuffer,
+	FNA3D_DepthFormat depthFormat,
+	uint8_t preserveTargetContents
+) {
+	NullRenderer *renderer = (NullRenderer*) driverData;
+
+	if (renderer->perf.enabled)
+	{
+		FNA3D_PERF_ADD(renderer->perf, setRenderTargetCalls, 1);
+	}
+
+	if (renderTargets == NULL)
+	{
+		renderer->numRenderTargets = 0;
+		renderer->currentDepthFormat = renderer->backbufferDepthFormat;
+		return;
+	}
+	renderer->numRenderTargets = numRenderTargets;
+	renderer->currentDepthFormat = depthFormat;
+}
+
+static void NULLDRV_ResolveTarget(
+	FNA3D_Renderer *driverData,
+	FNA3D_RenderTargetBinding *target
+) {
+	/* Nothing to resolve */
+}
+
+/* Backbuffer Functions */
+
+static void NULLDRV_ResetBackbuffer(
+	FNA3D_Renderer *driverData,
+	FNA3D_PresentationParameters *presentationParameters
+) {
+	NullRenderer *renderer = (NullRenderer*) driverData;
+
+	renderer->backbufferWidth = presentationParameters->backBufferWidth;
+	renderer->backbufferHeight = presentationParameters->backBufferHeight;
+	renderer->backbufferFormat = presentationParameters->backBufferFormat;
+	renderer->backbufferDepthFormat = presentationParameters->depthStencilFormat;
+	renderer->backbufferMultiSampleCount = presentationParameters->multiSampleCount;
+	if (renderer->numRenderTargets == 0)
+	{
+		renderer->currentDepthFormat = renderer->backbufferDepthFormat;
+	}
+}
+
+static void NULLDRV_ReadBackbuffer(
+	FNA3D_Renderer *driverData,
+	int32_t x,
+	int32_t y,
+	int32_t w,
+	int32_t h,
+	void* data,
+	int32_t dataLength
+) {
+	SDL_memset(data, '\0', dataLength);
+}
+
+static void NULLDRV_GetBackbufferSize(
+	FNA3D_Renderer *driverData,
+	int32_t *w,
+	int32_t *h
+) {
+	NullRenderer *renderer = (NullRenderer*) driverData;
+	*w = renderer->backbufferWidth;
+	*h = renderer->backbufferHeight;
+}
+
+static FNA3D_SurfaceFormat NULLDRV_GetBackbufferSurfaceFormat(
+	FNA3D_Renderer *driverData
+) {
+	NullRenderer *renderer = (NullRenderer*) driverData;
+	return renderer->backbufferFormat;
+}
+
+static FNA3D_DepthFormat NULLDRV_GetBackbufferDepthFormat(
+	FNA3D_Renderer *driverData
+) {
+	NullRenderer *renderer = (NullRenderer*) driverData;
+	return renderer->backbufferDepthFormat;
+}
+
+static int32_t NULLDRV_GetBackbufferMultiSampleCount(
+	FNA3D_Renderer *driverData
+) {
+	NullRenderer *renderer = (NullRenderer*) driverData;
+	return renderer->backbufferMultiSampleCount;
+}
+
+/* Textures */
+
+static NullTexture* NULLDRV_INTERNAL_CreateTexture(
+	FNA3D_SurfaceFormat format,
+	int32_t width,
+	int32_t height,
+	int32_t depth,
+	int32_t levelCount,
+	uint8_t isRenderTarget
+) {
+	NullTexture *result = (NullTexture*) SDL_malloc(sizeof(NullTexture));
+	result->format = format;
+	result->width = width;
+	result->height = height;
+	result->depth = depth;
+	result->levelCount = levelCount;
+	result->isRenderTarget = isRenderTarget;
+	return result;
+}
+
+static FNA3D_Texture* NULLDRV_CreateTexture2D(
+	FNA3D_Renderer *driverData,
+	FNA3D_SurfaceFormat format,
+	int32_t width,
+	int32_t height,
+	int32_t levelCount,
+	uint8_t isRenderTarget
+) {
+	return (FNA3D_Texture*) NULLDRV_INTERNAL_CreateTexture(
+		format,
+		width,
+		height,
+		1,
+		levelCount,
+		isRenderTarget
+	);
+}
+
+static FNA3D_Texture* NULLDRV_CreateTexture3D(
+	FNA3D_Renderer *driverData,
+	FNA3D_SurfaceFormat format,
+	int32_t width,
+	int32_t height,
+	int32_t depth,
+	int32_t levelCount
+) {
+	return (FNA3D_Texture*) NULLDRV_INTERNAL_CreateTexture(
+		format,
+		width,
+		height,
+		depth,
+		levelCount,
+		0
+	);
+}
+
+static FNA3D_Texture* NULLDRV_CreateTextureCube(
+	FNA3D_Renderer *driverData,
+	FNA3D_SurfaceFormat format,
+	int32_t size,
+	int32_t levelCount,
+	uint8_t isRenderTarget
+) {
+	return (FNA3D_Texture*) NULLDRV_INTERNAL_CreateTexture(
+		format,
+		size,
+		size,
+		6,
+		levelCount,
+		isRenderTarget
+	);
+}
+
+static void NULLDRV_AddDisposeTexture(
+	FNA3D_Renderer *driverData,
+	FNA3D_Texture *texture
+) {
+	NullRenderer *renderer = (NullRenderer*) driverData;
+	int32_t i;
+
+	for (i = 0; i < MAX_TOTAL_SAMPLERS; i += 1)
+	{
+		if (renderer->textures[i] == (NullTexture*) texture)
+		{
+			renderer->textures[i] = NULL;
+			renderer->samplers[i] = NULL;
+		}
+	}
+	SDL_free(texture);
+}
+
+static void NULLDRV_SetTextureData2D(
+	FNA3D_Renderer *driverData,
+	FNA3D_Texture *texture,
+	int32_t x,
+	int32_t y,
+	int32_t w,
+	int32_t h,
+	int32_t level,
+	void* data,
+	int32_t dataLength
+) {
+	/* Texture contents are not kept */
+}
+
+static void NULLDRV_SetTextureData3D(
+	FNA3D_Renderer *driverData,
+	FNA3D_Texture *texture,
+	int32_t x,
+	int32_t y,
+	int32_t z,
+	int32_t w,
+	int32_t h,
+	int32_t d,
+	int32_t level,
+	void* data,
+	int32_t dataLength
+) {
+	/* Texture contents are not kept */
+}
+
+static void NULLDRV_SetTextureDataCube(
+	FNA3D_Renderer *driverData,
+	FNA3D_Texture *texture,
+	int32_t x,
+	int32_t y,
+	int32_t w,
+	int32_t h,
+	FNA3D_CubeMapFace cubeMapFace,
+	int32_t level,
+	void* data,
+	int32_t dataLength
+) {
+	/* Texture contents are not kept */
+}
+
+static void NULLDRV_SetTextureDataYUV(
+	FNA3D_Renderer *driverData,
+	FNA3D_Texture *y,
+	FNA3D_Texture *u,
+	FNA3D_Texture *v,
+	int32_t yWidth,
+	int32_t yHeight,
+	int32_t uvWidth,
+	int32_t uvHeight,
+	void* data,
+	int32_t dataLength
+) {
+	/* Texture contents are not kept */
+}
+
+static void NULLDRV_GetTextureData2D(
+	FNA3D_Renderer *driverData,
+	FNA3D_Texture *texture,
+	int32_t x,
+	int32_t y,
+	int32_t w,
+	int32_t h,
+	int32_t level,
+	void* data,
+	int32_t dataLength
+) {
+	SDL_memset(data, '\0', dataLength);
+}
+
+static void NULLDRV_GetTextureData3D(
+	FNA3D_Renderer *driverData,
+	FNA3D_Texture *texture,
+	int32_t x,
+	int32_t y,
+	int32_t z,
+	int32_t w,
+	int32_t h,
+	int32_t d,
+	int32_t level,
+	void* data,
+	int32_t dataLength
+) {
+	SDL_memset(data, '\0', dataLength);
+}
+
+static void NULLDRV_GetTextureDataCube(
+	FNA3D_Renderer *driverData,
+	FNA3D_Texture *texture,
+	int32_t x,
+	int32_t y,
+	int32_t w,
+	int32_t h,
+	FNA3D_CubeMapFace cubeMapFace,
+	int32_t level,
+	void* data,
+	int32_t dataLength
+) {
+	SDL_memset(data, '\0', dataLength);
+}
+
+static FNA3D_Readback* NULLDRV_RequestTextureDataAsync(
+	FNA3D_Renderer *driverData,
+	FNA3D_Texture *texture,
+	int32_t x,
+	int32_t y,
+	int32_t w,
+	int32_t h,
+	int32_t level,
+	int32_t dataLength
+) {
+	/* The synchronous path is already free */
+	return NULL;
+}
+
+static uint8_t NULLDRV_PollReadback(
+	FNA3D_Renderer *driverData,
+	FNA3D_Readback *readback,
+	void* data,
+	int32_t dataLength
+) {
+	SDL_assert(0 && "RequestTextureDataAsync never returns a readback!");
+	return 1;
+}
+
+/* Renderbuffers */
+
+static FNA3D_Renderbuffer* NULLDRV_GenColorRenderbuffer(
+	FNA3D_Renderer *driverData,
+	int32_t width,
+	int32_t height,
+	FNA3D_SurfaceFormat format,
+	int32_t multiSampleCount,
+	FNA3D_Texture *texture
+) {
+	NullRenderbuffer *result = (NullRenderbuffer*) SDL_malloc(
+		sizeof(NullRenderbuffer)
+	);
+	result->width = width;
+	result->height = height;
+	result->multiSampleCount = multiSampleCount;
+	return (FNA3D_Renderbuffer*) result;
+}
+
+static FNA3D_Renderbuffer* NULLDRV_GenDepthStencilRenderbuffer(
+	FNA3D_Renderer *driverData,
+	int32_t width,
+	int32_t height,
+	FNA3D_DepthFormat format,
+	int32_t multiSampleCount
+) {
+	NullRenderbuffer *result = (NullRenderbuffer*) SDL_malloc(
+		sizeof(NullRenderbuffer)
+	);
+	result->width = width;
+	result->height = height;
+	result->multiSampleCount = multiSampleCount;
+	return (FNA3D_Renderbuffer*) result;
+}
+
+static void NULLDRV_AddDisposeRenderbuffer(
+	FNA3D_Renderer *driverData,
+	FNA3D_Renderbuffer *renderbuffer
+) {
+	SDL_free(renderbuffer);
+}
+
+/* Vertex Buffers */
+
+/* Buffers keep their contents, GetData and MapVertexBufferRange need them */
+static FNA3D_Buffer* NULLDRV_INTERNAL_CreateBuffer(int32_t sizeInBytes)
+{
+	NullBuffer *result = (NullBuffer*) SDL_malloc(sizeof(NullBuffer));
+	result->data = (uint8_t*) SDL_calloc(1, sizeInBytes);
+	result->size = sizeInBytes;
+	return (FNA3D_Buffer*) result;
+}
+
+static void NULLDRV_INTERNAL_DestroyBuffer(FNA3D_Buffer *buffer)
+{
+	NullBuffer *nullBuffer = (NullBuffer*) buffer;
+	SDL_free(nullBuffer->data);
+	SDL_free(nullBuffer);
+}
+
+static FNA3D_Buffer* NULLDRV_GenVertexBuffer(
+	FNA3D_Renderer *driverData,
+	uint8_t dynamic,
+	FNA3D_BufferUsage usage,
+	int32_t sizeInBytes
+) {
+	return NULLDRV_INTERNAL_CreateBuffer(sizeInBytes);
+}
+
+static void NULLDRV_AddDisposeVertexBuffer(
+	FNA3D_Renderer *driverData,
+	FNA3D_Buffer *buffer
+) {
+	NULLDRV_INTERNAL_DestroyBuffer(buffer);
+}
+
+static void NULLDRV_SetVertexBufferData(
+	FNA3D_Renderer *driverData,
+	FNA3D_Buffer *buffer,
+	int32_t offsetInBytes,
+	void* data,
+	int32_t elementCount,
+	int32_t elementSizeInBytes,
+	int32_t vertexStride,
+	FNA3D_SetDataOptions options
+) {
+	NullRenderer *renderer = (NullRenderer*) driverData;
+	NullBuffer *nullBuffer = (NullBuffer*) buffer;
+	int32_t dataLen = elementCount * vertexStride;
+
+	SDL_memcpy(nullBuffer->data + offsetInBytes, data, dataLen);
+
+	if (renderer->perf.enabled)
+	{
+		FNA3D_PERF_ADD(renderer->perf, vertexUploadCalls, 1);
+		FNA3D_PERF_ADD(renderer->perf, vertexUploadBytes, dataLen);
+	}
+}
+
+static void* NULLDRV_MapVertexBufferRange(
+	FNA3D_Renderer *driverData,
+	FNA3D_Buffer *buffer,
+	int32_t offsetInBytes,
+	int32_t lengthInBytes,
+	FNA3D_SetDataOptions options
+) {
+	NullRenderer *renderer = (NullRenderer*) driverData;
+
+	if (!FNA3D_MappedRange_Begin(
+		&renderer->mappedRange,
+		buffer,
+		offsetInBytes,
+		lengthInBytes,
+		options
+	)) {
+		return NULL;
+	}
+
+	/* The client writes straight into the buffer */
+	return ((NullBuffer*) buffer)->data + offsetInBytes;
+}
+
+static void NULLDRV_UnmapVertexBufferRange(
+	FNA3D_Renderer *driverData,
+	FNA3D_Buffer *buffer
+) {
+	NullRenderer *renderer = (NullRenderer*) driverData;
+
+	if (!FNA3D_MappedRange_End(&renderer->mappedRange, buffer))
+	{
+		return;
+	}
+
+	if (renderer->perf.enabled)
+	{
+		FNA3D_PERF_ADD(renderer->perf, mapWrites, 1);
+		FNA3D_PERF_ADD(
+			renderer->perf,
+			mapBytes,
+			renderer->mappedRange.lengthInBytes
+		);
+	}
+}
+
+static void NULLDRV_GetVertexBufferData(
+	FNA3D_Renderer *driverData,
+	FNA3D_Buffer *buffer,
+	int32_t offsetInBytes,
+	void* data,
+	int32_t elementCount,
+	int32_t elementSizeInBytes,
+	int32_t vertexStride
+) {
+	NullBuffer *nullBuffer = (NullBuffer*) buffer;
+	SDL_memcpy(
+		data,
+		nullBuffer->data + offsetInBytes,
+		elementCount * vertexStride
+	);
+}
+
+/* Index Buffers */
+
+static FNA3D_Buffer* NULLDRV_GenIndexBuffer(
+	FNA3D_Renderer *driverData,
+	uint8_t dynamic,
+	FNA3D_BufferUsage usage,
+	int32_t sizeInBytes
+) {
+	return NULLDRV_INTERNAL_CreateBuffer(sizeInBytes);
+}
+
+static void NULLDRV_AddDisposeIndexBuffer(
+	FNA3D_Renderer *driverData,
+	FNA3D_Buffer *buffer
+) {
+	NULLDRV_INTERNAL_DestroyBuffer(buffer);
+}
+
+static void NULLDRV_SetIndexBufferData(
+	FNA3D_Renderer *driverData,
+	FNA3D_Buffer *buffer,
+	int32_t offsetInBytes,
+	void* data,
+	int32_t dataLength,
+	FNA3D_SetDataOptions options
+) {
+	NullRenderer *renderer = (NullRenderer*) driverData;
+	NullBuffer *nullBuffer = (NullBuffer*) buffer;
+
+	SDL_memcpy(nullBuffer->data + offsetInBytes, data, dataLength);
+
+	if (renderer->perf.enabled)
+	{
+		FNA3D_PERF_ADD(renderer->perf, indexUploadCalls, 1);
+		FNA3D_PERF_ADD(renderer->perf, indexUploadBytes, dataLength);
+	}
+}
+
+static void NULLDRV_GetIndexBufferData(
+	FNA3D_Renderer *driverData,
+	FNA3D_Buffer *buffer,
+	int32_t offsetInBytes,
+	void* data,
+	int32_t dataLength
+) {
+	NullBuffer *nullBuffer = (NullBuffer*) buffer;
+	SDL_memcpy(data, nullBuffer->data + offsetInBytes, dataLength);
+}
+
+/* Effects */
+
+/* MojoShader still parses every shader in the effect, but nothing is used
+ * past the parse data. GLSL 1.20 is in every build that enables this driver.
+ */
+static void* NULLDRV_INTERNAL_CompileShader(
+	const void *ctx,
+	const char *mainfn,
+	const unsigned char *tokenbuf,
+	const unsigned int bufsize,
+	const MOJOSHADER_swizzle *swiz,
+	const unsigned int swizcount,
+	const MOJOSHADER_samplerMap *smap,
+	const unsigned int smapcount
+) {
+	NullRenderer *renderer = (NullRenderer*) ctx;
+	const MOJOSHADER_parseData *pd;
+	NullShader *result;
+
+	pd = MOJOSHADER_parse(
+		MOJOSHADER_PROFILE_GLSL120,
+		mainfn,
+		tokenbuf,
+		bufsize,
+		swiz,
+		swizcount,
+		smap,
+		smapcount,
+		NULL,
+		NULL,
+		NULL
+	);
+	if (pd->error_count > 0)
+	{
+		SDL_strlcpy(
+			renderer->shaderError,
+			pd->errors[0].error,
+			sizeof(renderer->shaderError)
+		);
+		MOJOSHADER_freeParseData(pd);
+		return NULL;
+	}
+
+	result = (NullShader*) SDL_malloc(sizeof(NullShader));
+	result->parseData = pd;
+	result->refcount = 1;
+	return result;
+}
+
+static void NULLDRV_INTERNAL_ShaderAddRef(void* shader)
+{
+	((NullShader*) shader)->refcount += 1;
+}
+
+static void NULLDRV_INTERNAL_DeleteShader(const void *ctx, void* shader)
+{
+	NullRenderer *renderer = (NullRenderer*) ctx;
+	NullShader *nullShader = (NullShader*) shader;
+	PackedVertexBufferBindingsArray *arr = &renderer->vertexLayoutCache;
+	int32_t i;
+
+	nullShader->refcount -= 1;
+	if (nullShader->refcount > 0)
+	{
+		return;
+	}
+
+	/* Free the layouts, then drop their entries in one pass */
+	for (i = 0; i < arr->count; i += 1)
+	{
+		const PackedVertexBufferBindingsMap *elem = &arr->elements[i];
+		if (elem->key.vertexShader == shader)
+		{
+			if (elem->value == renderer->vertexLayout)
+			{
+				renderer->vertexLayout = NULL;
+			}
+			SDL_free(elem->value);
+		}
+	}
+	PackedVertexBufferBindingsArray_RemoveShader(arr, shader);
+
+	if (renderer->vertexShader == nullShader)
+	{
+		renderer->vertexShader = NULL;
+	}
+	if (renderer->pixelShader == nullShader)
+	{
+		renderer->pixelShader = NULL;
+	}
+
+	MOJOSHADER_freeParseData(nullShader->parseData);
+	SDL_free(nullShader);
+}
+
+static const MOJOSHADER_parseData* NULLDRV_INTERNAL_GetParseData(void *shader)
+{
+	return ((NullShader*) shader)->parseData;
+}
+
+static void NULLDRV_INTERNAL_BindShaders(
+	const void *ctx,
+	void *vshader,
+	void *pshader
+) {
+	NullRenderer *renderer = (NullRenderer*) ctx;
+
+	/* NULL leaves the current shader bound, as in MOJOSHADER_sdlBindShaders */
+	if (vshader != NULL)
+	{
+		renderer->vertexShader = (NullShader*) vshader;
+	}
+	if (pshader != NULL)
+	{
+		renderer->pixelShader = (NullShader*) pshader;
+	}
+}
+
+static void NULLDRV_INTERNAL_GetBoundShaders(
+	const void *ctx,
+	void **vshader,
+	void **pshader
+) {
+	NullRenderer *renderer = (NullRenderer*) ctx;
+	*vshader = renderer->vertexShader;
+	*pshader = renderer->pixelShader;
+}
+
+static void NULLDRV_INTERNAL_MapUniformBufferMemory(
+	const void *ctx,
+	float **vsf, int **vsi, unsigned char **vsb,
+	float **psf, int **psi, unsigned char **psb
+) {
+	NullRenderer *renderer = (NullRenderer*) ctx;
+	*vsf = renderer->vsRegisterFileF;
+	*vsi = renderer->vsRegisterFileI;
+	*vsb = renderer->vsRegisterFileB;
+	*psf = renderer->psRegisterFileF;
+	*psi = renderer->psRegisterFileI;
+	*psb = renderer->psRegisterFileB;
+}
+
+static void NULLDRV_INTERNAL_UnmapUniformBufferMemory(const void *ctx)
+{
+	/* The register files are the uniform buffers */
+}
+
+static const char* NULLDRV_INTERNAL_GetError(const void *ctx)
+{
+	return ((NullRenderer*) ctx)->shaderError;
+}
+
+static void NULLDRV_CreateEffect(
+	FNA3D_Renderer *driverData,
+	uint8_t *effectCode,
+	uint32_t effectCodeLength,
+	FNA3D_Effect **effect,
+	MOJOSHADER_effect **effectData
+) {
+	int32_t i;
+	MOJOSHADER_effectShaderContext shaderBackend;
+	NullEffect *result;
+
+	shaderBackend.shaderContext = driverData;
+	shaderBackend.compileShader = (MOJOSHADER_compileShaderFunc) NULLDRV_INTERNAL_CompileShader;
+	shaderBackend.shaderAddRef = (MOJOSHADER_shaderAddRefFunc) NULLDRV_INTERNAL_ShaderAddRef;
+	shaderBackend.deleteShader = NULLDRV_INTERNAL_DeleteShader;
+	shaderBackend.getParseData = (MOJOSHADER_getParseDataFunc) NULLDRV_INTERNAL_GetParseData;
+	shaderBackend.bindShaders = (MOJOSHADER_bindShadersFunc) NULLDRV_INTERNAL_BindShaders;
+	shaderBackend.getBoundShaders = (MOJOSHADER_getBoundShadersFunc) NULLDRV_INTERNAL_GetBoundShaders;
+	shaderBackend.mapUniformBufferMemory = (MOJOSHADER_mapUniformBufferMemoryFunc) NULLDRV_INTERNAL_MapUniformBufferMemory;
+	shaderBackend.unmapUniformBufferMemory = (MOJOSHADER_unmapUniformBufferMemoryFunc) NULLDRV_INTERNAL_UnmapUniformBufferMemory;
+	shaderBackend.getError = (MOJOSHADER_getErrorFunc) NULLDRV_INTERNAL_GetError;
+	shaderBackend.m = NULL;
+	shaderBackend.f = NULL;
+	shaderBackend.malloc_data = driverData;
+
+	*effectData = MOJOSHADER_compileEffect(
+		effectCode,
+		effectCodeLength,
+		NULL,
+		0,
+		NULL,
+		0,
+		&shaderBackend
+	);
+
+	for (i = 0; i < (*effectData)->error_count; i += 1)
+	{
+		FNA3D_LogError(
+			"MOJOSHADER_compileEffect Error: %s",
+			(*effectData)->errors[i].error
+		);
+	}
+
+	result = (NullEffect*) SDL_malloc(sizeof(NullEffect));
+	result->effect = *effectData;
+	*effect = (FNA3D_Effect*) result;
+}
+
+static void NULLDRV_CloneEffect(
+	FNA3D_Renderer *driverData,
+	FNA3D_Effect *cloneSource,
+	FNA3D_Effect **effect,
+	MOJOSHADER_effect **effectData
+) {
+	NullRenderer *renderer = (NullRenderer*) driverData;
+	NullEffect *nullCloneSource = (NullEffect*) cloneSource;
+	NullEffect *result;
+
+	*effectData = MOJOSHADER_cloneEffect(nullCloneSource->effect);
+	if (*effectData == NULL)
+	{
+		FNA3D_LogError("%s", renderer->shaderError);
+	}
+
+	result = (NullEffect*) SDL_malloc(sizeof(NullEffect));
+	result->effect = *effectData;
+	*effect = (FNA3D_Effect*) result;
+}
+
+static void NULLDRV_PrewarmPipelines(
+	FNA3D_Renderer *driverData,
+	FNA3D_PipelineManifest *manifest
+) {
+	/* No pipeline objects to prewarm */
+	FNA3D_PipelineManifest_Destroy(manifest);
+}
+
+static void NULLDRV_AddDisposeEffect(
+	FNA3D_Renderer *driverData,
+	FNA3D_Effect *effect
+) {
+	NullRenderer *renderer = (NullRenderer*) driverData;
+	MOJOSHADER_effect *effectData = ((NullEffect*) effect)->effect;
+
+	if (effectData == renderer->currentEffect)
+	{
+		MOJOSHADER_effectEndPass(renderer->currentEffect);
+		MOJOSHADER_effectEnd(renderer->currentEffect);
+		renderer->currentEffect = NULL;
+		renderer->currentTechnique = NULL;
+		renderer->currentPass = 0;
+		renderer->effectApplied = 1;
+	}
+	MOJOSHADER_deleteEffect(effectData);
+	SDL_free(effect);
+}
+
+static void NULLDRV_SetEffectTechnique(
+	FNA3D_Renderer *driverData,
+	FNA3D_Effect *effect,
+	MOJOSHADER_effectTechnique *technique
+) {
+	NullEffect *nullEffect = (NullEffect*) effect;
+	MOJOSHADER_effectSetTechnique(nullEffect->effect, technique);
+}
+
+static void NULLDRV_ApplyEffect(
+	FNA3D_Renderer *driverData,
+	FNA3D_Effect *effect,
+	uint32_t pass,
+	MOJOSHADER_effectStateChanges *stateChanges
+) {
+	NullRenderer *renderer = (NullRenderer*) driverData;
+	MOJOSHADER_effect *effectData = ((NullEffect*) effect)->effect;
+	const MOJOSHADER_effectTechnique *technique = effectData->current_technique;
+	uint32_t whatever;
+
+	renderer->effectApplied = 1;
+	if (renderer->perf.enabled)
+	{
+		FNA3D_PERF_ADD(renderer->perf, applyEffectCalls, 1);
+	}
+	if (effectData == renderer->currentEffect)
+	{
+		if (	technique == renderer->currentTechnique &&
+			pass == renderer->currentPass		)
+		{
+			MOJOSHADER_effectCommitChanges(
+				renderer->currentEffect
+			);
+			return;
+		}
+		MOJOSHADER_effectEndPass(renderer->currentEffect);
+		MOJOSHADER_effectBeginPass(renderer->currentEffect, pass);
+		renderer->currentTechnique = technique;
+		renderer->currentPass = pass;
+		return;
+	}
+	else if (renderer->currentEffect != NULL)
+	{
+		MOJOSHADER_effectEndPass(renderer->currentEffect);
+		MOJOSHADER_effectEnd(renderer->currentEffect);
+	}
+	MOJOSHADER_effectBegin(
+		effectData,
+		&whatever,
+		0,
+		stateChanges
+	);
+	MOJOSHADER_effectBeginPass(effectData, pass);
+	renderer->currentEffect = effectData;
+	renderer->currentTechnique = technique;
+	renderer->currentPass = pass;
+}
+
+static void NULLDRV_BeginPassRestore(
+	FNA3D_Renderer *driverData,
+	FNA3D_Effect *effect,
+	MOJOSHADER_effectStateChanges *stateChanges
+) {
+	NullRenderer *renderer = (NullRenderer*) driverData;
+	MOJOSHADER_effect *effectData = ((NullEffect*) effect)->effect;
+	uint32_t whatever;
+
+	MOJOSHADER_effectBegin(
+		effectData,
+		&whatever,
+		1,
+		stateChanges
+	);
+	MOJOSHADER_effectBeginPass(effectData, 0);
+	renderer->effectApplied = 1;
+}
+
+static void NULLDRV_EndPassRestore(
+	FNA3D_Renderer *driverData,
+	FNA3D_Effect *effect
+) {
+	NullRenderer *renderer = (NullRenderer*) driverData;
+	MOJOSHADER_effect *effectData = ((NullEffect*) effect)->effect;
+
+	MOJOSHADER_effectEndPass(effectData);
+	MOJOSHADER_effectEnd(effectData);
+	renderer->effectApplied = 1;
+}
+
+/* Queries */
+
+static FNA3D_Query* NULLDRV_CreateQuery(FNA3D_Renderer *driverData)
+{
+	NullQuery *result = (NullQuery*) SDL_malloc(sizeof(NullQuery));
+	result->active = 0;
+	return (FNA3D_Query*) result;
+}
+
+static void NULLDRV_AddDisposeQuery(
+	FNA3D_Renderer *driverData,
+	FNA3D_Query *query
+) {
+	SDL_free(query);
+}
+
+static void NULLDRV_QueryBegin(FNA3D_Renderer *driverData, FNA3D_Query *query)
+{
+	((NullQuery*) query)->active = 1;
+}
+
+static void NULLDRV_QueryEnd(FNA3D_Renderer *driverData, FNA3D_Query *query)
+{
+	((NullQuery*) query)->active = 0;
+}
+
+static uint8_t NULLDRV_QueryComplete(
+	FNA3D_Renderer *driverData,
+	FNA3D_Query *query
+) {
+	return 1;
+}
+
+static int32_t NULLDRV_QueryPixelCount(
+	FNA3D_Renderer *driverData,
+	FNA3D_Query *query
+) {
+	/* Nothing was ever drawn */
+	return 0;
+}
+
+/* Feature Queries */
+
+static uint8_t NULLDRV_SupportsDXT1(FNA3D_Renderer *driverData)
+{
+	return 1;
+}
+
+static uint8_t NULLDRV_SupportsS3TC(FNA3D_Renderer *driverData)
+{
+	return 1;
+}
+
+static uint8_t NULLDRV_SupportsBC7(FNA3D_Renderer *driverData)
+{
+	return 1;
+}
+
+static uint8_t NULLDRV_SupportsHardwareInstancing(FNA3D_Renderer *driverData)
+{
+	return 1;
+}
+
+static uint8_t NULLDRV_SupportsNoOverwrite(FNA3D_Renderer *driverData)
+{
+	return 1;
+}
+
+static uint8_t NULLDRV_SupportsSRGBRenderTargets(FNA3D_Renderer *driverData)
+{
+	return 1;
+}
+
+static void NULLDRV_GetMaxTextureSlots(
+	FNA3D_Renderer *driverData,
+	int32_t *textures,
+	int32_t *vertexTextures
+) {
+	*textures = MAX_TEXTURE_SAMPLERS;
+	*vertexTextures = MAX_VERTEXTEXTURE_SAMPLERS;
+}
+
+static int32_t NULLDRV_GetMaxMultiSampleCount(
+	FNA3D_Renderer *driverData,
+	FNA3D_SurfaceFormat format,
+	int32_t multiSampleCount
+) {
+	return SDL_min(multiSampleCount, 8);
+}
+
+/* Performance Counters */
+
+static void NULLDRV_GetPerfCounters(
+	FNA3D_Renderer *driverData,
+	FNA3D_PerfCounters *counters
+) {
+	NullRenderer *renderer = (NullRenderer*) driverData;
+	FNA3D_PerfState_Get(&renderer->perf, counters);
+}
+
+/* Debugging */
+
+static void NULLDRV_SetStringMarker(FNA3D_Renderer *driverData, const char *text)
+{
+	/* No-op */
+}
+
+static void NULLDRV_SetTextureName(
+	FNA3D_Renderer *driverData,
+	FNA3D_Texture *texture,
+	const char *text
+) {
+	/* No-op */
+}
+
+/* External Interop */
+
+static void NULLDRV_GetSysRenderer(
+	FNA3D_Renderer *driverData,
+	FNA3D_SysRendererEXT *sysrenderer
+) {
+	SDL_memset(sysrenderer, '\0', sizeof(FNA3D_SysRendererEXT));
+	sysrenderer->rendererType = FNA3D_RENDERER_TYPE_NULL_EXT;
+}
+
+static FNA3D_Texture* NULLDRV_CreateSysTexture(
+	FNA3D_Renderer *driverData,
+	FNA3D_SysTextureEXT *systexture
+) {
+	/* There is no native texture to wrap */
+	return NULL;
+}
+
+/* Driver */
+
+static uint8_t NULLDRV_PrepareWindowAttributes(uint32_t *flags)
+{
+	const char *hint = SDL_GetHint("FNA3D_FORCE_DRIVER");
+	if (hint == NULL)
+	{
+		hint = SDL_getenv("FNA3D_FORCE_DRIVER");
+	}
+
+	/* Never fall back to this, it would look like a black screen! */
+	return (hint != NULL && SDL_strcasecmp(hint, "Null") == 0);
+}
+
+static FNA3D_Device* NULLDRV_CreateDevice(
+	FNA3D_PresentationParameters *presentationParameters,
+	uint8_t debugMode
+) {
+	NullRenderer *renderer;
+	FNA3D_Device *result;
+
+	result = (FNA3D_Device*) SDL_malloc(sizeof(FNA3D_Device));
+	ASSIGN_DRIVER(NULLDRV)
+
+	renderer = (NullRenderer*) SDL_malloc(sizeof(NullRenderer));
+	SDL_memset(renderer, '\0', sizeof(NullRenderer));
+	result->driverData = (FNA3D_Renderer*) renderer;
+
+	FNA3D_PerfState_Init(&renderer->perf);
+
+	renderer->multiSampleMask = -1;
+	renderer->blendFactor.r = 0xFF;
+	renderer->blendFactor.g = 0xFF;
+	renderer->blendFactor.b = 0xFF;
+	renderer->blendFactor.a = 0xFF;
+	NULLDRV_ResetBackbuffer(
+		(FNA3D_Renderer*) renderer,
+		presentationParameters
+	);
+
+	FNA3D_LogInfo("FNA3D Driver: Null");
+	return result;
+}
+
+FNA3D_Driver NullDriver = {
+	"Null",
+	NULLDRV_PrepareWindowAttributes,
+	NULLDRV_CreateDevice
+};
+
+#else
+
+extern int this_tu_is_empty;
+
+#endif /* FNA3D_DRIVER_NULL */
+
+/* vim: set noexpandtab shiftwidth=8 tabstop=8: */
@@ -28,6 +28,8 @@
 
 #include "FNA3D_Driver.h"
 #include "FNA3D_Driver_OpenGL.h"
+#include "FNA3D_PipelineManifest.h"
+#include "FNA3D_Timeline.h"
 
 #ifdef USE_SDL3
 #include <SDL3/SDL.h>
@@ -42,6 +44,20 @@ static inline SDL_threadID SDL_GetCurrentThreadID()
 #define SDL_Semaphore SDL_sem
 #define SDL_SignalSemaphore SDL_SemPost
 #define SDL_WaitSemaphore SDL_SemWait
+#define SDL_GetAtomicPointer SDL_AtomicGetPtr
+#define SDL_SetAtomicPointer SDL_AtomicSetPtr
+#define SDL_CompareAndSwapAtomicPointer SDL_AtomicCASPtr
+#define SDL_LockSpinlock SDL_AtomicLock
+#define SDL_UnlockSpinlock SDL_AtomicUnlock
+#define SDL_AtomicInt SDL_atomic_t
+#define SDL_GetAtomicInt SDL_AtomicGet
+#define SDL_SetAtomicInt SDL_AtomicSet
+#define SDL_CompareAndSwapAtomicInt SDL_AtomicCAS
+#define SDL_Condition SDL_cond
+#define SDL_CreateCondition SDL_CreateCond
+#define SDL_DestroyCondition SDL_DestroyCond
+#define SDL_WaitCondition SDL_CondWait
+#define SDL_BroadcastCondition SDL_CondBroadcast
 #endif
 
 /* We only use this to detect UIKit, for backbuffer creation */
@@ -52,6 +68,7 @@ static inline SDL_threadID SDL_GetCurrentThreadID()
 /* Internal Structures */
 
 typedef struct FNA3D_Command FNA3D_Command; /* See Threading Support section */
+typedef struct OpenGLStagingBlock OpenGLStagingBlock;
 
 typedef struct OpenGLTexture OpenGLTexture;
 typedef struct OpenGLRenderbuffer OpenGLRenderbuffer;
@@ -86,6 +103,8 @@ struct OpenGLTexture /* Cast from FNA3D_Texture* */
 	};
 	OpenGLTexture *next; /* linked list */
 	uint8_t external;
+	SDL_AtomicInt uploadSerial; /* See WaitForUpload */
+	int32_t syncedSerial; /* Main thread only, see WaitForTexture */
 };
 
 static OpenGLTexture NullTexture =
@@ -107,11 +126,31 @@ static OpenGLTexture NullTexture =
 	NULL
 };
 
+/* Number of pixel unpack buffers cycled through by the upload thread */
+#define UPLOAD_PBO_COUNT 4
+
+/* Dynamic buffers backed by ARB_buffer_storage are allocated as a ring of
+ * slices, each large enough for the size the application asked for. Discards
+ * move to the next slice instead of orphaning, and each slice is fenced when
+ * it is retired so the CPU never writes over data the GPU may still be using.
+ * If the next slice is still busy the CPU waits a little for it, and only if
+ * the GPU is further behind than that is the whole storage orphaned instead.
+ */
+#define MAX_STREAM_SLICES 8
+#define DEFAULT_STREAM_SLICES 4
+#define STREAM_FENCE_TIMEOUT_NS 1000000
+
 struct OpenGLBuffer /* Cast from FNA3D_Buffer* */
 {
 	GLuint handle;
 	intptr_t size;
 	GLenum dynamic;
+	uint8_t *streamMapping; /* Persistent mapping, NULL if not streaming */
+	intptr_t streamOffset; /* Base of the active slice */
+	int32_t streamSlice;
+	GLsync streamFences[MAX_STREAM_SLICES];
+	SDL_AtomicInt uploadSerial; /* See WaitForUpload */
+	int32_t syncedSerial; /* Main thread only, see WaitForBuffer */
 	OpenGLBuffer *next; /* linked list */
 };
 
@@ -134,6 +173,15 @@ struct OpenGLQuery /* Cast from FNA3D_Query* */
 	OpenGLQuery *next; /* linked list */
 };
 
+typedef struct OpenGLReadback /* Cast from FNA3D_Readback* */
+{
+	FNA3D_Readback base;
+	GLuint buffer;
+	GLsync fence;
+	int32_t pitch; /* Backbuffer rows are flipped on the way out, 0 if not */
+	int32_t rows;
+} OpenGLReadback;
+
 typedef struct OpenGLBackbuffer
 {
 	#define BACKBUFFER_TYPE_NULL 0
@@ -143,6 +191,10 @@ typedef struct OpenGLBackbuffer
 	uint8_t isSrgb;
 	int32_t width;
 	int32_t height;
+	int32_t storageWidth;	/* Allocated at FNA3D_RENDER_SCALE */
+	int32_t storageHeight;
+	int32_t renderWidth;	/* Drawn region, <= storage when scaling */
+	int32_t renderHeight;
 	FNA3D_DepthFormat depthFormat;
 	int32_t multiSampleCount;
 	struct
@@ -194,6 +246,8 @@ typedef struct OpenGLRenderer /* Cast from FNA3D_Renderer* */
 	uint8_t supports_anisotropic_filtering;
 	uint8_t supports_srgb_rendertarget;
 	uint8_t supports_bc7;
+	uint8_t usePersistentStreaming;
+	int32_t streamSliceCount;
 	int32_t maxMultiSampleCount;
 	int32_t maxMultiSampleCountFormat[21];
 	int32_t windowSampleCount;
@@ -254,6 +308,8 @@ typedef struct OpenGLRenderer /* Cast from FNA3D_Renderer* */
 	/* Buffer Binding Cache */
 	GLuint currentVertexBuffer;
 	GLuint currentIndexBuffer;
+	GLuint restoreVertexBuffer; /* See ExecuteCommandsMidFrame */
+	GLuint restoreIndexBuffer;
 
 	/* ld, or LastDrawn, vertex attributes */
 	int32_t ldBaseVertex;
@@ -295,14 +351,41 @@ typedef struct OpenGLRenderer /* Cast from FNA3D_Renderer* */
 	uint32_t currentPass;
 	uint8_t renderTargetBound;
 	uint8_t effectApplied;
+	uint8_t streamSliceChanged;
 
 	/* Point Sprite Toggle */
 	uint8_t togglePointSprite;
 
 	/* Threading */
 	SDL_ThreadID threadID;
-	FNA3D_Command *commands;
-	SDL_Mutex *commandsLock;
+	FNA3D_Command *commands; /* Lock-free LIFO, see ExecuteCommands */
+	SDL_SpinLock commandWaitLock;
+	SDL_Semaphore **commandWaitPool;
+	int32_t commandWaitPoolCount;
+	int32_t commandWaitPoolCapacity;
+	SDL_SpinLock stagingLock;
+	OpenGLStagingBlock *stagingCurrent;
+	OpenGLStagingBlock *stagingFree;
+
+	/* Upload Thread */
+	SDL_Window *uploadWindow;
+	SDL_GLContext uploadContext;
+	SDL_Thread *uploadThread;
+	SDL_Semaphore *uploadSignal;
+	SDL_Semaphore *uploadStartup;
+	SDL_AtomicInt uploadRunning;
+	FNA3D_Command *uploadCommands;
+	SDL_SpinLock uploadSubmitLock;
+	int32_t uploadSubmitSerial;
+	void *uploadDependency; /* GLsync, owned by whoever swaps it out */
+	SDL_AtomicInt uploadDependencyPending; /* See FlushUploadDependency */
+	SDL_Mutex *uploadLock;
+	SDL_Condition *uploadDone;
+	GLsync uploadFence; /* Covers every upload up to uploadFenceSerial */
+	int32_t uploadFenceSerial;
+	int32_t uploadRetiredSerial; /* Main thread only */
+	GLuint uploadPBOs[UPLOAD_PBO_COUNT]; /* Upload thread only */
+	int32_t uploadPBOIndex;
 	OpenGLTexture *disposeTextures;
 	SDL_Mutex *disposeTexturesLock;
 	OpenGLRenderbuffer *disposeRenderbuffers;
@@ -322,48 +405,32 @@ typedef struct OpenGLRenderer /* Cast from FNA3D_Renderer* */
 	float qualityRenderScale;    /* FNA3D_RENDER_SCALE: render resolution scale (0.5-1.0) */
 	uint8_t qualityLowPrecision; /* FNA3D_SHADER_LOW_PRECISION: use low precision shaders */
 
-	/* Frame Rate Limiting */
-	int32_t targetFps;           /* FNA3D_TARGET_FPS: target frame rate (0 = unlimited) */
-	uint64_t frameStartTime;     /* Start time of current frame */
-	uint64_t targetFrameTime;    /* Target time per frame in nanoseconds */
-
-	/* Runtime GL performance diagnostics */
-	uint8_t perfDiagnosticsEnabled; /* RAL_GL_DIAGNOSTICS: 1 = enabled */
-	uint64_t perfPublishTimestamp;
-	uint64_t perfMapWrites;
-	uint64_t perfMapBytes;
-	uint64_t perfSubDataWrites;
-	uint64_t perfSubDataBytes;
-	uint64_t perfDrawCalls;
-	uint64_t perfFrameCount;
-	uint64_t perfSwapWaitNs;
-	uint64_t perfSleepNs;
-	uint64_t perfDrawIndexedCalls;
-	uint64_t perfDrawInstancedCalls;
-	uint64_t perfDrawPrimitiveCalls;
-	uint64_t perfClearCalls;
-	uint64_t perfSetRenderTargetCalls;
-	uint64_t perfApplyEffectCalls;
-	uint64_t perfVertexUploadCalls;
-	uint64_t perfIndexUploadCalls;
-	uint64_t perfVertexUploadBytes;
-	uint64_t perfIndexUploadBytes;
-	uint64_t perfTotalMapWrites;
-	uint64_t perfTotalMapBytes;
-	uint64_t perfTotalSubDataWrites;
-	uint64_t perfTotalSubDataBytes;
-	uint64_t perfTotalDrawCalls;
-	uint64_t perfTotalFrameCount;
-	uint64_t perfTotalDrawIndexedCalls;
-	uint64_t perfTotalDrawInstancedCalls;
-	uint64_t perfTotalDrawPrimitiveCalls;
-	uint64_t perfTotalClearCalls;
-	uint64_t perfTotalSetRenderTargetCalls;
-	uint64_t perfTotalApplyEffectCalls;
-	uint64_t perfTotalVertexUploadCalls;
-	uint64_t perfTotalIndexUploadCalls;
-	uint64_t perfTotalVertexUploadBytes;
-	uint64_t perfTotalIndexUploadBytes;
+	/* Render Scaling, see OPENGL_INTERNAL_UpdateRenderScale */
+	float renderScale;
+	uint8_t renderScaleDynamic;
+	float renderScaleMin;
+	uint64_t renderScaleBudget;
+	uint64_t renderScaleFrameStart;
+	uint64_t renderScaleCpuTime;
+	double renderScaleCost;
+	int32_t renderScaleCooldown;
+	uint8_t supportsTimerQuery;
+	#define RENDER_SCALE_QUERY_COUNT 3
+	GLuint renderScaleQueries[RENDER_SCALE_QUERY_COUNT];
+	uint8_t renderScaleQueryPending[RENDER_SCALE_QUERY_COUNT];
+	int32_t renderScaleQueryIndex;
+	FNA3D_Viewport backbufferViewport;	/* Unscaled, reapplied on change */
+	FNA3D_Rect backbufferScissor;
+
+	/* Frame Rate Limiting, see FNA3D_FramePacer_Init */
+	FNA3D_FramePacer pacer;
+
+	/* Performance counters, see FNA3D_GetPerfCounters */
+	FNA3D_PerfState perf;
+
+	/* See FNA3D_MapVertexBufferRange */
+	FNA3D_MappedRange mappedRange;
+	uint8_t mappedWithGL; /* glMapBufferRange, needs glUnmapBuffer */
 
 	/* GL entry points */
 	glfntype_glGetString glGetString; /* Loaded early! */
@@ -678,6 +745,9 @@ struct FNA3D_Command
 	#define FNA3D_COMMAND_GETTEXTUREDATACUBE 16
 	#define FNA3D_COMMAND_GENCOLORRENDERBUFFER 17
 	#define FNA3D_COMMAND_GENDEPTHRENDERBUFFER 18
+	#define FNA3D_COMMAND_UPLOADTEXTURE 19 /* Upload thread only */
+	#define FNA3D_COMMAND_UPLOADBUFFER 20 /* Upload thread only */
+	#define FNA3D_COMMAND_PUBLISHUPLOADS 21 /* See QueueTextureUpload */
 	uint8_t type;
 	FNA3DNAMELESS union
 	{
@@ -875,11 +945,61 @@ struct FNA3D_Command
 			int32_t multiSampleCount;
 			FNA3D_Renderbuffer *retval;
 		} genDepthStencilRenderbuffer;
+
+		/* The upload thread never touches the resource structs,
+		 * the disposal lists may free them at any time.
+		 */
+		struct
+		{
+			GLuint handle;
+			GLenum bindTarget;
+			GLenum imageTarget;
+			FNA3D_SurfaceFormat format;
+			int32_t x;
+			int32_t y;
+			int32_t z;
+			int32_t w;
+			int32_t h;
+			int32_t d;
+			int32_t level;
+			void* data;
+			int32_t dataLength;
+			int32_t serial;
+		} uploadTexture;
+
+		struct
+		{
+			GLuint handle;
+			intptr_t size;
+			GLenum dynamic;
+			int32_t offsetInBytes;
+			FNA3D_SetDataOptions options;
+			void* data;
+			int32_t dataLength;
+			int32_t serial;
+		} uploadBuffer;
 	};
-	SDL_Semaphore *semaphore;
+	SDL_Semaphore *semaphore; /* NULL for deferred commands */
+	OpenGLStagingBlock *stagingBlock; /* Owner of deferred commands */
 	FNA3D_Command *next;
 };
 
+/* Deferred commands and their data are bump-allocated from shared blocks.
+ * A block is recycled once every command allocated from it has executed.
+ */
+#define STAGING_BLOCK_SIZE (4 * 1024 * 1024)
+#define STAGING_MAX_FREE_BLOCKS 2
+#define STAGING_ALIGN(x) (((x) + 15) & ~((size_t) 15))
+
+struct OpenGLStagingBlock
+{
+	uint8_t *data;
+	size_t size;
+	size_t used;
+	int32_t refcount;
+	OpenGLStagingBlock *next; /* free list */
+};
+
 static void FNA3D_ExecuteCommand(
 	FNA3D_Device *device,
 	FNA3D_Command *cmd
@@ -1093,6 +1213,9 @@ static void FNA3D_ExecuteCommand(
 				cmd->genDepthStencilRenderbuffer.multiSampleCount
 			);
 			break;
+		case FNA3D_COMMAND_PUBLISHUPLOADS:
+			/* ExecuteCommands publishes before waking the caller */
+			break;
 		default:
 			FNA3D_LogError(
 				"Cannot execute unknown command (value = %d)",
@@ -1200,386 +1323,871 @@ static inline void ApplySRGBFlag(OpenGLRenderer *renderer, uint8_t state)
 	ToggleGLState(renderer, GL_FRAMEBUFFER_SRGB_EXT, state);
 }
 
-static inline void ForceToMainThread(
-	OpenGLRenderer *renderer,
+static inline void PushCommand(
+	FNA3D_Command **queue,
 	FNA3D_Command *command
 ) {
-	FNA3D_Command *curr;
-	command->semaphore = SDL_CreateSemaphore(0);
+	FNA3D_Command *head;
 
-	SDL_LockMutex(renderer->commandsLock);
-	LinkedList_Add(renderer->commands, command, curr);
-	SDL_UnlockMutex(renderer->commandsLock);
-
-	SDL_WaitSemaphore(command->semaphore);
-	SDL_DestroySemaphore(command->semaphore);
+	/* Multiple producers, one consumer that always takes the whole list,
+	 * so there's no ABA to worry about here.
+	 */
+	do
+	{
+		head = (FNA3D_Command*) SDL_GetAtomicPointer((void**) queue);
+		command->next = head;
+	} while (!SDL_CompareAndSwapAtomicPointer(
+		(void**) queue,
+		head,
+		command
+	));
 }
 
-/* Forward Declarations for Internal Functions */
-
-static void OPENGL_INTERNAL_CreateBackbuffer(
-	OpenGLRenderer *renderer,
-	FNA3D_PresentationParameters *parameters
-);
-static void OPENGL_INTERNAL_DisposeBackbuffer(OpenGLRenderer *renderer);
-static void OPENGL_INTERNAL_DestroyTexture(
-	OpenGLRenderer *renderer,
-	OpenGLTexture *texture
-);
-static void OPENGL_INTERNAL_DestroyRenderbuffer(
-	OpenGLRenderer *renderer,
-	OpenGLRenderbuffer *renderbuffer
-);
-static void OPENGL_INTERNAL_DestroyVertexBuffer(
-	OpenGLRenderer *renderer,
-	OpenGLBuffer *buffer
-);
-static void OPENGL_INTERNAL_DestroyIndexBuffer(
-	OpenGLRenderer *renderer,
-	OpenGLBuffer *buffer
-);
-static void OPENGL_INTERNAL_DestroyEffect(
-	OpenGLRenderer *renderer,
-	OpenGLEffect *effect
-);
-static void OPENGL_INTERNAL_DestroyQuery(
-	OpenGLRenderer *renderer,
-	OpenGLQuery *query
-);
-static void OPENGL_GetBackbufferSize(
-	FNA3D_Renderer *driverData,
-	int32_t *w,
-	int32_t *h
-);
-
-/* Renderer Implementation */
-
-/* Quit */
-
-static void OPENGL_DestroyDevice(FNA3D_Device *device)
+static inline FNA3D_Command* TakeCommands(FNA3D_Command **queue)
 {
-	OpenGLRenderer *renderer = (OpenGLRenderer*) device->driverData;
+	FNA3D_Command *cmd, *next, *prev;
 
-	if (renderer->useCoreProfile)
-	{
-		renderer->glBindVertexArray(0);
-		renderer->glDeleteVertexArrays(1, &renderer->vao);
-	}
-
-	renderer->glDeleteFramebuffers(1, &renderer->resolveFramebufferRead);
-	renderer->resolveFramebufferRead = 0;
-	renderer->glDeleteFramebuffers(1, &renderer->resolveFramebufferDraw);
-	renderer->resolveFramebufferDraw = 0;
-	renderer->glDeleteFramebuffers(1, &renderer->targetFramebuffer);
-	renderer->targetFramebuffer = 0;
-
-	if (renderer->backbuffer->type == BACKBUFFER_TYPE_OPENGL)
+	if (SDL_GetAtomicPointer((void**) queue) == NULL)
 	{
-		OPENGL_INTERNAL_DisposeBackbuffer(renderer);
+		return NULL;
 	}
-	SDL_free(renderer->backbuffer);
-	renderer->backbuffer = NULL;
-
-	MOJOSHADER_glMakeContextCurrent(NULL);
-	MOJOSHADER_glDestroyContext(renderer->shaderContext);
-
-	SDL_DestroyMutex(renderer->commandsLock);
-	SDL_DestroyMutex(renderer->disposeTexturesLock);
-	SDL_DestroyMutex(renderer->disposeRenderbuffersLock);
-	SDL_DestroyMutex(renderer->disposeVertexBuffersLock);
-	SDL_DestroyMutex(renderer->disposeIndexBuffersLock);
-	SDL_DestroyMutex(renderer->disposeEffectsLock);
-	SDL_DestroyMutex(renderer->disposeQueriesLock);
-
-#ifdef USE_SDL3
-	SDL_GL_DestroyContext(renderer->context);
-#else
-	SDL_GL_DeleteContext(renderer->context);
-#endif
-
-	SDL_free(renderer);
-	SDL_free(device);
-}
-
-/* Presentation */
 
-static inline void ExecuteCommands(OpenGLRenderer *renderer)
-{
-	FNA3D_Command *cmd, *next;
-
-	SDL_LockMutex(renderer->commandsLock);
-	cmd = renderer->commands;
+	/* Take everything at once, then restore submission order */
+	cmd = (FNA3D_Command*) SDL_SetAtomicPointer((void**) queue, NULL);
+	prev = NULL;
 	while (cmd != NULL)
 	{
-		FNA3D_ExecuteCommand(
-			renderer->parentDevice,
-			cmd
-		);
 		next = cmd->next;
-		SDL_SignalSemaphore(cmd->semaphore);
+		cmd->next = prev;
+		prev = cmd;
 		cmd = next;
 	}
-	renderer->commands = NULL; /* No heap memory to free! -caleb */
-	SDL_UnlockMutex(renderer->commandsLock);
+	return prev;
 }
 
-static inline void DisposeResources(OpenGLRenderer *renderer)
+static inline SDL_Semaphore* AcquireCommandWait(OpenGLRenderer *renderer)
 {
-	OpenGLTexture *tex, *texNext;
-	OpenGLEffect *eff, *effNext;
-	OpenGLBuffer *buf, *bufNext;
-	OpenGLRenderbuffer *ren, *renNext;
-	OpenGLQuery *qry, *qryNext;
-
-	/* All heap allocations are freed by func! -caleb */
-	#define DISPOSE(prefix, list, func) \
-		SDL_LockMutex(list##Lock); \
-		prefix = list; \
-		while (prefix != NULL) \
-		{ \
-			prefix##Next = prefix->next; \
-			OPENGL_INTERNAL_##func(renderer, prefix); \
-			prefix = prefix##Next; \
-		} \
-		list = NULL; \
-		SDL_UnlockMutex(list##Lock);
-
-	DISPOSE(tex, renderer->disposeTextures, DestroyTexture)
-	DISPOSE(ren, renderer->disposeRenderbuffers, DestroyRenderbuffer)
-	DISPOSE(buf, renderer->disposeVertexBuffers, DestroyVertexBuffer)
-	DISPOSE(buf, renderer->disposeIndexBuffers, DestroyIndexBuffer)
-	DISPOSE(eff, renderer->disposeEffects, DestroyEffect)
-	DISPOSE(qry, renderer->disposeQueries, DestroyQuery)
-
-	#undef DISPOSE
-}
+	SDL_Semaphore *result = NULL;
 
-static void OPENGL_PublishPerfDiagnostics(OpenGLRenderer *renderer)
-{
-	uint64_t now;
-	uint64_t frequency;
-	uint64_t elapsedTicks;
-	uint64_t totalWrites;
-	uint64_t frameCount;
-	double vertexUploadMbWindow;
-	double indexUploadMbWindow;
-	double vertexUploadMbTotal;
-	double indexUploadMbTotal;
-	double elapsedSeconds;
-	double mapWritesPerSecond;
-	double subDataWritesPerSecond;
-	double drawCallsPerSecond;
-	double drawCallsPerFrame;
-	double totalUploadMbPerSecond;
-	double avgFrameMs;
-	double avgSwapMs;
-	double avgSleepMs;
-	double mapRatio;
-	const char *uploadPath;
-	char buffer[128];
-
-	if (!renderer->perfDiagnosticsEnabled)
+	SDL_LockSpinlock(&renderer->commandWaitLock);
+	if (renderer->commandWaitPoolCount > 0)
 	{
-		return;
+		renderer->commandWaitPoolCount -= 1;
+		result = renderer->commandWaitPool[renderer->commandWaitPoolCount];
 	}
+	SDL_UnlockSpinlock(&renderer->commandWaitLock);
 
-	now = SDL_GetPerformanceCounter();
-	if (renderer->perfPublishTimestamp == 0)
+	if (result == NULL)
 	{
-		renderer->perfPublishTimestamp = now;
-		return;
+		result = SDL_CreateSemaphore(0);
 	}
+	return result;
+}
 
-	frequency = SDL_GetPerformanceFrequency();
-	elapsedTicks = now - renderer->perfPublishTimestamp;
-	if (elapsedTicks < (frequency / 4))
-	{
-		/* Update about every 250ms to keep overhead tiny. */
-		return;
-	}
+static inline void ReleaseCommandWait(
+	OpenGLRenderer *renderer,
+	SDL_Semaphore *semaphore
+) {
+	SDL_Semaphore **pool = NULL;
 
-	elapsedSeconds = (double) elapsedTicks / (double) frequency;
-	if (elapsedSeconds <= 0.0)
+	SDL_LockSpinlock(&renderer->commandWaitLock);
+	if (renderer->commandWaitPoolCount == renderer->commandWaitPoolCapacity)
 	{
-		return;
+		/* Don't call the allocator while holding the spinlock */
+		SDL_UnlockSpinlock(&renderer->commandWaitLock);
+		pool = (SDL_Semaphore**) SDL_malloc(
+			sizeof(SDL_Semaphore*) *
+			(renderer->commandWaitPoolCapacity + 8)
+		);
+		SDL_LockSpinlock(&renderer->commandWaitLock);
+		if (renderer->commandWaitPoolCount == renderer->commandWaitPoolCapacity)
+		{
+			if (renderer->commandWaitPool != NULL)
+			{
+				SDL_memcpy(
+					pool,
+					renderer->commandWaitPool,
+					sizeof(SDL_Semaphore*) * renderer->commandWaitPoolCount
+				);
+				SDL_free(renderer->commandWaitPool);
+			}
+			renderer->commandWaitPool = pool;
+			renderer->commandWaitPoolCapacity += 8;
+			pool = NULL;
+		}
 	}
+	renderer->commandWaitPool[renderer->commandWaitPoolCount] = semaphore;
+	renderer->commandWaitPoolCount += 1;
+	SDL_UnlockSpinlock(&renderer->commandWaitLock);
+
+	/* Someone else grew the pool first */
+	SDL_free(pool);
+}
+
+static inline void ForceToMainThread(
+	OpenGLRenderer *renderer,
+	FNA3D_Command *command
+) {
+	command->semaphore = AcquireCommandWait(renderer);
+	command->stagingBlock = NULL;
+	PushCommand(&renderer->commands, command);
+
+	SDL_WaitSemaphore(command->semaphore);
+	ReleaseCommandWait(renderer, command->semaphore);
+}
+
+static FNA3D_Command* AllocDeferredCommand(
+	OpenGLRenderer *renderer,
+	void* data,
+	size_t dataLength,
+	void **dataCopy
+) {
+	const size_t cmdSize = STAGING_ALIGN(sizeof(FNA3D_Command));
+	const size_t size = cmdSize + STAGING_ALIGN(dataLength);
+	OpenGLStagingBlock *block;
+	FNA3D_Command *result;
 
-	mapWritesPerSecond = (double) renderer->perfMapWrites / elapsedSeconds;
-	subDataWritesPerSecond = (double) renderer->perfSubDataWrites / elapsedSeconds;
-	drawCallsPerSecond = (double) renderer->perfDrawCalls / elapsedSeconds;
-	totalUploadMbPerSecond =
-		((double) (renderer->perfMapBytes + renderer->perfSubDataBytes) / (1024.0 * 1024.0)) /
-		elapsedSeconds;
-	frameCount = renderer->perfFrameCount;
-	if (frameCount > 0)
+	if (size > STAGING_BLOCK_SIZE)
 	{
-		drawCallsPerFrame = (double) renderer->perfDrawCalls / (double) frameCount;
-		avgFrameMs = (elapsedSeconds * 1000.0) / (double) frameCount;
-		avgSwapMs = ((double) renderer->perfSwapWaitNs / 1000000.0) / (double) frameCount;
-		avgSleepMs = ((double) renderer->perfSleepNs / 1000000.0) / (double) frameCount;
+		/* Too big to share, so it never becomes the current block and
+		 * ReleaseDeferredCommand frees it as soon as the command runs.
+		 */
+		block = (OpenGLStagingBlock*) SDL_malloc(
+			sizeof(OpenGLStagingBlock)
+		);
+		block->size = size;
+		block->data = (uint8_t*) SDL_malloc(block->size);
+		block->used = size;
+		block->refcount = 1;
+		block->next = NULL;
+		result = (FNA3D_Command*) block->data;
 	}
 	else
 	{
-		drawCallsPerFrame = 0.0;
-		avgFrameMs = 0.0;
-		avgSwapMs = 0.0;
-		avgSleepMs = 0.0;
+		SDL_LockSpinlock(&renderer->stagingLock);
+		block = renderer->stagingCurrent;
+		if (block != NULL && block->used + size > block->size)
+		{
+			if (block->refcount == 0)
+			{
+				/* Everything in here already ran, start over */
+				block->used = 0;
+			}
+			else
+			{
+				/* Retire it, the last release will recycle it */
+				block = NULL;
+			}
+		}
+		if (block == NULL)
+		{
+			if (renderer->stagingFree != NULL)
+			{
+				block = renderer->stagingFree;
+				renderer->stagingFree = block->next;
+				block->used = 0;
+			}
+			else
+			{
+				block = (OpenGLStagingBlock*) SDL_malloc(
+					sizeof(OpenGLStagingBlock)
+				);
+				block->size = STAGING_BLOCK_SIZE;
+				block->data = (uint8_t*) SDL_malloc(block->size);
+				block->used = 0;
+				block->refcount = 0;
+			}
+			block->next = NULL;
+			renderer->stagingCurrent = block;
+		}
+		result = (FNA3D_Command*) (block->data + block->used);
+		block->used += size;
+		block->refcount += 1;
+		SDL_UnlockSpinlock(&renderer->stagingLock);
 	}
-	vertexUploadMbWindow = (double) renderer->perfVertexUploadBytes / (1024.0 * 1024.0);
-	indexUploadMbWindow = (double) renderer->perfIndexUploadBytes / (1024.0 * 1024.0);
-	vertexUploadMbTotal = (double) renderer->perfTotalVertexUploadBytes / (1024.0 * 1024.0);
-	indexUploadMbTotal = (double) renderer->perfTotalIndexUploadBytes / (1024.0 * 1024.0);
 
-	totalWrites = renderer->perfMapWrites + renderer->perfSubDataWrites;
-	if (totalWrites == 0)
+	result->semaphore = NULL;
+	result->stagingBlock = block;
+	*dataCopy = ((uint8_t*) result) + cmdSize;
+	SDL_memcpy(*dataCopy, data, dataLength);
+	return result;
+}
+
+static void ReleaseDeferredCommand(
+	OpenGLRenderer *renderer,
+	FNA3D_Command *command
+) {
+	OpenGLStagingBlock *block = command->stagingBlock;
+	OpenGLStagingBlock *curr;
+	int32_t numFree;
+
+	SDL_LockSpinlock(&renderer->stagingLock);
+	block->refcount -= 1;
+	if (block->refcount > 0 || block == renderer->stagingCurrent)
 	{
-		uploadPath = renderer->supports_ARB_map_buffer_range ? "MapBufferRange (idle)" : "BufferSubData (idle)";
-		mapRatio = renderer->supports_ARB_map_buffer_range ? 100.0 : 0.0;
+		SDL_UnlockSpinlock(&renderer->stagingLock);
+		return;
 	}
-	else if (renderer->perfMapWrites == 0)
+
+	numFree = 0;
+	for (curr = renderer->stagingFree; curr != NULL; curr = curr->next)
 	{
-		uploadPath = "BufferSubData";
-		mapRatio = 0.0;
+		numFree += 1;
 	}
-	else if (renderer->perfSubDataWrites == 0)
+	if (block->size == STAGING_BLOCK_SIZE && numFree < STAGING_MAX_FREE_BLOCKS)
 	{
-		uploadPath = "MapBufferRange";
-		mapRatio = 100.0;
+		block->next = renderer->stagingFree;
+		renderer->stagingFree = block;
+		block = NULL;
 	}
-	else
+	SDL_UnlockSpinlock(&renderer->stagingLock);
+
+	/* Oversized or surplus blocks go back to the system */
+	if (block != NULL)
 	{
-		uploadPath = "Mixed";
-		mapRatio = ((double) renderer->perfMapWrites * 100.0) / (double) totalWrites;
+		SDL_free(block->data);
+		SDL_free(block);
 	}
+}
 
-	SDL_setenv("RAL_GL_MAP_ENABLED", renderer->supports_ARB_map_buffer_range ? "1" : "0", 1);
-	SDL_setenv("RAL_GL_UPLOAD_PATH", uploadPath, 1);
-
-	SDL_snprintf(buffer, sizeof(buffer), "%.1f", mapWritesPerSecond);
-	SDL_setenv("RAL_GL_MAP_WRITES_S", buffer, 1);
-
-	SDL_snprintf(buffer, sizeof(buffer), "%.1f", subDataWritesPerSecond);
-	SDL_setenv("RAL_GL_SUBDATA_WRITES_S", buffer, 1);
-
-	SDL_snprintf(buffer, sizeof(buffer), "%.1f", drawCallsPerSecond);
-	SDL_setenv("RAL_GL_DRAW_S", buffer, 1);
+static inline void DeferToMainThread(
+	OpenGLRenderer *renderer,
+	FNA3D_Command *command
+) {
+	/* Fire and forget, the data was copied by AllocDeferredCommand */
+	PushCommand(&renderer->commands, command);
+}
 
-	SDL_snprintf(buffer, sizeof(buffer), "%.2f", totalUploadMbPerSecond);
-	SDL_setenv("RAL_GL_UPLOAD_MB_S", buffer, 1);
+static inline void SubmitUpload(
+	OpenGLRenderer *renderer,
+	FNA3D_Command *command,
+	int32_t *commandSerial,
+	SDL_AtomicInt *resourceSerial
+) {
+	int32_t serial, old;
 
-	SDL_snprintf(buffer, sizeof(buffer), "%.1f", drawCallsPerFrame);
-	SDL_setenv("RAL_GL_DRAWS_FRAME", buffer, 1);
+	/* Serials are handed out in queue order, so the upload thread can
+	 * publish the last serial of each batch as "everything up to here".
+	 * The resource is marked before the command becomes visible, that way
+	 * the main thread can never bind it without seeing the wait.
+	 */
+	SDL_LockSpinlock(&renderer->uploadSubmitLock);
+	renderer->uploadSubmitSerial += 1;
+	serial = renderer->uploadSubmitSerial;
+	*commandSerial = serial;
+	do
+	{
+		old = SDL_GetAtomicInt(resourceSerial);
+	} while (old < serial && !SDL_CompareAndSwapAtomicInt(
+		resourceSerial,
+		old,
+		serial
+	));
+	PushCommand(&renderer->uploadCommands, command);
+	SDL_UnlockSpinlock(&renderer->uploadSubmitLock);
+
+	SDL_SignalSemaphore(renderer->uploadSignal);
+}
 
-	SDL_snprintf(buffer, sizeof(buffer), "%.2f", avgFrameMs);
-	SDL_setenv("RAL_GL_FRAME_MS", buffer, 1);
+static inline void AwaitUploadDependency(OpenGLRenderer *renderer)
+{
+	FNA3D_Command cmd;
 
-	SDL_snprintf(buffer, sizeof(buffer), "%.2f", avgSwapMs);
-	SDL_setenv("RAL_GL_SWAP_MS", buffer, 1);
+	/* The main thread only fences its creations when it drains commands,
+	 * and this upload may be for one it made since. Ask it for the fence.
+	 */
+	if (SDL_GetAtomicInt(&renderer->uploadDependencyPending))
+	{
+		cmd.type = FNA3D_COMMAND_PUBLISHUPLOADS;
+		ForceToMainThread(renderer, &cmd);
+	}
+}
 
-	SDL_snprintf(buffer, sizeof(buffer), "%.2f", avgSleepMs);
-	SDL_setenv("RAL_GL_SLEEP_MS", buffer, 1);
+static void QueueTextureUpload(
+	OpenGLRenderer *renderer,
+	OpenGLTexture *texture,
+	GLenum imageTarget,
+	int32_t x,
+	int32_t y,
+	int32_t z,
+	int32_t w,
+	int32_t h,
+	int32_t d,
+	int32_t level,
+	void* data,
+	int32_t dataLength
+) {
+	FNA3D_Command *cmd;
+	void *dataCopy;
 
-	SDL_snprintf(buffer, sizeof(buffer), "%.1f", mapRatio);
-	SDL_setenv("RAL_GL_MAP_RATIO", buffer, 1);
+	AwaitUploadDependency(renderer);
 
-	SDL_snprintf(
-		buffer,
-		sizeof(buffer),
-		"Draw %.0f/s (%.0f/f) Upload %.2fMB/s",
-		drawCallsPerSecond,
-		drawCallsPerFrame,
-		totalUploadMbPerSecond
+	cmd = AllocDeferredCommand(
+		renderer,
+		data,
+		dataLength,
+		&dataCopy
 	);
-	SDL_setenv("RAL_GL_DIAG", buffer, 1);
-
-	SDL_snprintf(
-		buffer,
-		sizeof(buffer),
-		"Frame %.1fms Swap %.1fms Sleep %.1fms",
-		avgFrameMs,
-		avgSwapMs,
-		avgSleepMs
+	cmd->type = FNA3D_COMMAND_UPLOADTEXTURE;
+	cmd->uploadTexture.handle = texture->handle;
+	cmd->uploadTexture.bindTarget = texture->target;
+	cmd->uploadTexture.imageTarget = imageTarget;
+	cmd->uploadTexture.format = texture->format;
+	cmd->uploadTexture.x = x;
+	cmd->uploadTexture.y = y;
+	cmd->uploadTexture.z = z;
+	cmd->uploadTexture.w = w;
+	cmd->uploadTexture.h = h;
+	cmd->uploadTexture.d = d;
+	cmd->uploadTexture.level = level;
+	cmd->uploadTexture.data = dataCopy;
+	cmd->uploadTexture.dataLength = dataLength;
+	SubmitUpload(
+		renderer,
+		cmd,
+		&cmd->uploadTexture.serial,
+		&texture->uploadSerial
 	);
-	SDL_setenv("RAL_GL_TIMING", buffer, 1);
+}
 
-	SDL_snprintf(
-		buffer,
-		sizeof(buffer),
-		"Path %s (Map %.0f%%)",
-		uploadPath,
-		mapRatio
-	);
-	SDL_setenv("RAL_GL_PATH", buffer, 1);
+static void QueueBufferUpload(
+	OpenGLRenderer *renderer,
+	OpenGLBuffer *buffer,
+	int32_t offsetInBytes,
+	void* data,
+	int32_t dataLength,
+	FNA3D_SetDataOptions options
+) {
+	FNA3D_Command *cmd;
+	void *dataCopy;
 
-	SDL_snprintf(
-		buffer,
-		sizeof(buffer),
-		"W DI %llu IS %llu AR %llu CL %llu RT %llu FX %llu",
-		(unsigned long long) renderer->perfDrawIndexedCalls,
-		(unsigned long long) renderer->perfDrawInstancedCalls,
-		(unsigned long long) renderer->perfDrawPrimitiveCalls,
-		(unsigned long long) renderer->perfClearCalls,
-		(unsigned long long) renderer->perfSetRenderTargetCalls,
-		(unsigned long long) renderer->perfApplyEffectCalls
+	AwaitUploadDependency(renderer);
+
+	cmd = AllocDeferredCommand(
+		renderer,
+		data,
+		dataLength,
+		&dataCopy
 	);
-	SDL_setenv("RAL_GL_COUNT_W", buffer, 1);
+	cmd->type = FNA3D_COMMAND_UPLOADBUFFER;
+	cmd->uploadBuffer.handle = buffer->handle;
+	cmd->uploadBuffer.size = buffer->size;
+	cmd->uploadBuffer.dynamic = buffer->dynamic;
+	cmd->uploadBuffer.offsetInBytes = offsetInBytes;
+	cmd->uploadBuffer.options = options;
+	cmd->uploadBuffer.data = dataCopy;
+	cmd->uploadBuffer.dataLength = dataLength;
+	SubmitUpload(
+		renderer,
+		cmd,
+		&cmd->uploadBuffer.serial,
+		&buffer->uploadSerial
+	);
+}
 
-	SDL_snprintf(
-		buffer,
-		sizeof(buffer),
-		"W MAP %llu SUB %llu VB %llu/%.2fMB IB %llu/%.2fMB",
-		(unsigned long long) renderer->perfMapWrites,
-		(unsigned long long) renderer->perfSubDataWrites,
-		(unsigned long long) renderer->perfVertexUploadCalls,
-		vertexUploadMbWindow,
-		(unsigned long long) renderer->perfIndexUploadCalls,
-		indexUploadMbWindow
+static void WaitForUploadFence(OpenGLRenderer *renderer, int32_t serial)
+{
+	GLenum result;
+
+	SDL_LockMutex(renderer->uploadLock);
+
+	/* The upload thread hasn't gotten to it yet, nothing to do but wait */
+	while (renderer->uploadFenceSerial < serial)
+	{
+		SDL_WaitCondition(renderer->uploadDone, renderer->uploadLock);
+	}
+
+	do
+	{
+		result = renderer->glClientWaitSync(
+			renderer->uploadFence,
+			0,
+			1000000000 /* 1 second */
+		);
+	} while (result == GL_TIMEOUT_EXPIRED);
+	renderer->uploadRetiredSerial = renderer->uploadFenceSerial;
+
+	SDL_UnlockMutex(renderer->uploadLock);
+}
+
+static inline void WaitForUpload(OpenGLRenderer *renderer, int32_t serial)
+{
+	/* Resources that never went through the upload thread have serial 0 */
+	if (serial > renderer->uploadRetiredSerial)
+	{
+		WaitForUploadFence(renderer, serial);
+	}
+}
+
+/* Storage written by the upload context is only guaranteed to be visible
+ * here once the object has been bound again, so anything still sitting in
+ * the binding cache gets a real bind after its upload retires.
+ */
+static void WaitForTexture(OpenGLRenderer *renderer, OpenGLTexture *texture)
+{
+	int32_t serial = SDL_GetAtomicInt(&texture->uploadSerial);
+	int32_t i;
+
+	WaitForUpload(renderer, serial);
+	if (serial == texture->syncedSerial)
+	{
+		return;
+	}
+	texture->syncedSerial = serial;
+
+	for (i = 0; i < renderer->numTextureSlots + renderer->numVertexTextureSlots; i += 1)
+	{
+		if (renderer->textures[i] == texture)
+		{
+			if (i != 0)
+			{
+				renderer->glActiveTexture(GL_TEXTURE0 + i);
+			}
+			renderer->glBindTexture(texture->target, texture->handle);
+			if (i != 0)
+			{
+				/* Keep this state sane. -flibit */
+				renderer->glActiveTexture(GL_TEXTURE0);
+			}
+		}
+	}
+}
+
+static void WaitForBuffer(
+	OpenGLRenderer *renderer,
+	OpenGLBuffer *buffer,
+	GLenum target
+) {
+	int32_t serial = SDL_GetAtomicInt(&buffer->uploadSerial);
+
+	WaitForUpload(renderer, serial);
+	if (serial == buffer->syncedSerial)
+	{
+		return;
+	}
+	buffer->syncedSerial = serial;
+
+	/* Attribute pointers may still reference this, bind it regardless */
+	renderer->glBindBuffer(target, buffer->handle);
+	if (target == GL_ARRAY_BUFFER)
+	{
+		renderer->currentVertexBuffer = buffer->handle;
+	}
+	else
+	{
+		renderer->currentIndexBuffer = buffer->handle;
+	}
+}
+
+static inline void MarkUploadDependency(OpenGLRenderer *renderer)
+{
+	/* The caller may hand this straight to the upload thread */
+	if (renderer->uploadThread != NULL)
+	{
+		SDL_SetAtomicInt(&renderer->uploadDependencyPending, 1);
+	}
+}
+
+static void FlushUploadDependency(OpenGLRenderer *renderer)
+{
+	GLsync fence, old;
+
+	if (!SDL_GetAtomicInt(&renderer->uploadDependencyPending))
+	{
+		return;
+	}
+
+	/* Objects created on this context must be complete before the upload
+	 * context writes to them, so hand it a fence to wait on. Creations are
+	 * only marked, one fence covers everything made since the last one.
+	 */
+	fence = renderer->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	renderer->glFlush();
+	old = (GLsync) SDL_SetAtomicPointer(
+		&renderer->uploadDependency,
+		(void*) fence
 	);
-	SDL_setenv("RAL_GL_UPLOAD_W", buffer, 1);
+	if (old != NULL)
+	{
+		renderer->glDeleteSync(old);
+	}
+	SDL_SetAtomicInt(&renderer->uploadDependencyPending, 0);
+}
 
-	SDL_snprintf(
-		buffer,
-		sizeof(buffer),
-		"T D %llu CL %llu RT %llu FX %llu",
-		(unsigned long long) renderer->perfTotalDrawCalls,
-		(unsigned long long) renderer->perfTotalClearCalls,
-		(unsigned long long) renderer->perfTotalSetRenderTargetCalls,
-		(unsigned long long) renderer->perfTotalApplyEffectCalls
+static inline void ApplyRenderScale(OpenGLRenderer *renderer)
+{
+	OpenGLBackbuffer *bb = renderer->backbuffer;
+
+	if (bb->type == BACKBUFFER_TYPE_NULL)
+	{
+		bb->renderWidth = bb->width;
+		bb->renderHeight = bb->height;
+		return;
+	}
+
+	/* Storage is sized for the largest scale, so this never reallocates */
+	bb->renderWidth = SDL_clamp(
+		(int32_t) (bb->width * renderer->renderScale + 0.5f),
+		1,
+		bb->storageWidth
+	);
+	bb->renderHeight = SDL_clamp(
+		(int32_t) (bb->height * renderer->renderScale + 0.5f),
+		1,
+		bb->storageHeight
 	);
-	SDL_setenv("RAL_GL_COUNT_T", buffer, 1);
+}
 
-	SDL_snprintf(
-		buffer,
-		sizeof(buffer),
-		"T MAP %llu SUB %llu VB %llu/%.1fMB IB %llu/%.1fMB",
-		(unsigned long long) renderer->perfTotalMapWrites,
-		(unsigned long long) renderer->perfTotalSubDataWrites,
-		(unsigned long long) renderer->perfTotalVertexUploadCalls,
-		vertexUploadMbTotal,
-		(unsigned long long) renderer->perfTotalIndexUploadCalls,
-		indexUploadMbTotal
+/* Maps a flipped backbuffer rectangle into the scaled render region */
+static inline void ScaleBackbufferRect(
+	OpenGLRenderer *renderer,
+	int32_t *x,
+	int32_t *y,
+	int32_t *w,
+	int32_t *h
+) {
+	OpenGLBackbuffer *bb = renderer->backbuffer;
+	int32_t x1, y1;
+
+	if (bb->renderWidth == bb->width && bb->renderHeight == bb->height)
+	{
+		return;
+	}
+
+	/* Scale the edges, not the size, so neighboring rects still meet */
+	x1 = ((*x + *w) * bb->renderWidth) / bb->width;
+	y1 = ((*y + *h) * bb->renderHeight) / bb->height;
+	*x = (*x * bb->renderWidth) / bb->width;
+	*y = (*y * bb->renderHeight) / bb->height;
+	*w = x1 - *x;
+	*h = y1 - *y;
+}
+
+/* Forward Declarations for Internal Functions */
+
+static void OPENGL_INTERNAL_CreateBackbuffer(
+	OpenGLRenderer *renderer,
+	FNA3D_PresentationParameters *parameters
+);
+static void OPENGL_INTERNAL_DisposeBackbuffer(OpenGLRenderer *renderer);
+static void OPENGL_INTERNAL_DestroyTexture(
+	OpenGLRenderer *renderer,
+	OpenGLTexture *texture
+);
+static void OPENGL_INTERNAL_DestroyRenderbuffer(
+	OpenGLRenderer *renderer,
+	OpenGLRenderbuffer *renderbuffer
+);
+static void OPENGL_INTERNAL_DestroyVertexBuffer(
+	OpenGLRenderer *renderer,
+	OpenGLBuffer *buffer
+);
+static void OPENGL_INTERNAL_DestroyIndexBuffer(
+	OpenGLRenderer *renderer,
+	OpenGLBuffer *buffer
+);
+static void OPENGL_INTERNAL_DestroyEffect(
+	OpenGLRenderer *renderer,
+	OpenGLEffect *effect
+);
+static void OPENGL_INTERNAL_DestroyQuery(
+	OpenGLRenderer *renderer,
+	OpenGLQuery *query
+);
+static void OPENGL_GetBackbufferSize(
+	FNA3D_Renderer *driverData,
+	int32_t *w,
+	int32_t *h
+);
+static void OPENGL_INTERNAL_StopUploadThread(OpenGLRenderer *renderer);
+static void OPENGL_SetViewport(
+	FNA3D_Renderer *driverData,
+	FNA3D_Viewport *viewport
+);
+static void OPENGL_SetScissorRect(
+	FNA3D_Renderer *driverData,
+	FNA3D_Rect *scissor
+);
+
+/* Renderer Implementation */
+
+/* Quit */
+
+static void OPENGL_DestroyDevice(FNA3D_Device *device)
+{
+	OpenGLRenderer *renderer = (OpenGLRenderer*) device->driverData;
+	OpenGLStagingBlock *block;
+	int32_t i;
+
+	if (renderer->useCoreProfile)
+	{
+		renderer->glBindVertexArray(0);
+		renderer->glDeleteVertexArrays(1, &renderer->vao);
+	}
+
+	renderer->glDeleteFramebuffers(1, &renderer->resolveFramebufferRead);
+	renderer->resolveFramebufferRead = 0;
+	renderer->glDeleteFramebuffers(1, &renderer->resolveFramebufferDraw);
+	renderer->resolveFramebufferDraw = 0;
+	renderer->glDeleteFramebuffers(1, &renderer->targetFramebuffer);
+	renderer->targetFramebuffer = 0;
+
+	if (renderer->supportsTimerQuery)
+	{
+		renderer->glEndQuery(GL_TIME_ELAPSED);
+		renderer->glDeleteQueries(
+			RENDER_SCALE_QUERY_COUNT,
+			renderer->renderScaleQueries
+		);
+	}
+
+	if (renderer->backbuffer->type == BACKBUFFER_TYPE_OPENGL)
+	{
+		OPENGL_INTERNAL_DisposeBackbuffer(renderer);
+	}
+	SDL_free(renderer->backbuffer);
+	renderer->backbuffer = NULL;
+
+	OPENGL_INTERNAL_StopUploadThread(renderer);
+
+	MOJOSHADER_glMakeContextCurrent(NULL);
+	MOJOSHADER_glDestroyContext(renderer->shaderContext);
+
+	for (i = 0; i < renderer->commandWaitPoolCount; i += 1)
+	{
+		SDL_DestroySemaphore(renderer->commandWaitPool[i]);
+	}
+	SDL_free(renderer->commandWaitPool);
+	if (renderer->stagingCurrent != NULL)
+	{
+		SDL_free(renderer->stagingCurrent->data);
+		SDL_free(renderer->stagingCurrent);
+	}
+	while (renderer->stagingFree != NULL)
+	{
+		block = renderer->stagingFree;
+		renderer->stagingFree = block->next;
+		SDL_free(block->data);
+		SDL_free(block);
+	}
+	SDL_DestroyMutex(renderer->disposeTexturesLock);
+	SDL_DestroyMutex(renderer->disposeRenderbuffersLock);
+	SDL_DestroyMutex(renderer->disposeVertexBuffersLock);
+	SDL_DestroyMutex(renderer->disposeIndexBuffersLock);
+	SDL_DestroyMutex(renderer->disposeEffectsLock);
+	SDL_DestroyMutex(renderer->disposeQueriesLock);
+
+	FNA3D_MappedRange_Destroy(&renderer->mappedRange);
+
+#ifdef USE_SDL3
+	SDL_GL_DestroyContext(renderer->context);
+#else
+	SDL_GL_DeleteContext(renderer->context);
+#endif
+
+	SDL_free(renderer);
+	SDL_free(device);
+}
+
+/* Presentation */
+
+static inline void ExecuteCommands(OpenGLRenderer *renderer)
+{
+	FNA3D_Command *cmd, *next;
+	FNA3D_Command *waiting = NULL;
+
+	cmd = TakeCommands(&renderer->commands);
+	if (cmd == NULL)
+	{
+		return;
+	}
+
+	TIMELINE_BEGIN("ExecuteCommands")
+	while (cmd != NULL)
+	{
+		FNA3D_ExecuteCommand(
+			renderer->parentDevice,
+			cmd
+		);
+		next = cmd->next;
+		if (cmd->semaphore != NULL)
+		{
+			/* Held until the resources it made are published */
+			cmd->next = waiting;
+			waiting = cmd;
+		}
+		else
+		{
+			ReleaseDeferredCommand(renderer, cmd);
+		}
+		cmd = next;
+	}
+
+	/* One fence for everything this batch created */
+	FlushUploadDependency(renderer);
+
+	while (waiting != NULL)
+	{
+		/* Blocking commands live on the caller's stack */
+		next = waiting->next;
+		SDL_SignalSemaphore(waiting->semaphore);
+		waiting = next;
+	}
+	TIMELINE_END("ExecuteCommands")
+}
+
+static inline void ExecuteCommandsMidFrame(OpenGLRenderer *renderer)
+{
+	OpenGLTexture *tex0;
+
+	if (SDL_GetAtomicPointer((void**) &renderer->commands) == NULL)
+	{
+		return;
+	}
+
+	/* Resource commands bind to texture unit 0, but the application
+	 * won't reverify samplers it thinks are unchanged. Put it back.
+	 * Every path leaves GL_TEXTURE0 active when it returns, so selecting
+	 * it again here keeps that true even if a command didn't.
+	 * The buffer bindings go back too, orphaning a stream buffer renames
+	 * the one it replaces (see OPENGL_INTERNAL_OrphanStreamStorage).
+	 */
+	tex0 = renderer->textures[0];
+	renderer->restoreVertexBuffer = renderer->currentVertexBuffer;
+	renderer->restoreIndexBuffer = renderer->currentIndexBuffer;
+	ExecuteCommands(renderer);
+	renderer->glActiveTexture(GL_TEXTURE0);
+	if (renderer->textures[0] != tex0)
+	{
+		BindTexture(renderer, tex0);
+	}
+	BindVertexBuffer(renderer, renderer->restoreVertexBuffer);
+	BindIndexBuffer(renderer, renderer->restoreIndexBuffer);
+	renderer->restoreVertexBuffer = 0;
+	renderer->restoreIndexBuffer = 0;
+}
+
+static inline void DisposeResources(OpenGLRenderer *renderer)
+{
+	OpenGLTexture *tex, *texNext;
+	OpenGLEffect *eff, *effNext;
+	OpenGLBuffer *buf, *bufNext;
+	OpenGLRenderbuffer *ren, *renNext;
+	OpenGLQuery *qry, *qryNext;
+
+	TIMELINE_BEGIN("DisposeResources")
+
+	/* All heap allocations are freed by func! -caleb */
+	#define DISPOSE(prefix, list, func) \
+		SDL_LockMutex(list##Lock); \
+		prefix = list; \
+		while (prefix != NULL) \
+		{ \
+			prefix##Next = prefix->next; \
+			OPENGL_INTERNAL_##func(renderer, prefix); \
+			prefix = prefix##Next; \
+		} \
+		list = NULL; \
+		SDL_UnlockMutex(list##Lock);
+
+	DISPOSE(tex, renderer->disposeTextures, DestroyTexture)
+	DISPOSE(ren, renderer->disposeRenderbuffers, DestroyRenderbuffer)
+	DISPOSE(buf, renderer->disposeVertexBuffers, DestroyVertexBuffer)
+	DISPOSE(buf, renderer->disposeIndexBuffers, DestroyIndexBuffer)
+	DISPOSE(eff, renderer->disposeEffects, DestroyEffect)
+	DISPOSE(qry, renderer->disposeQueries, DestroyQuery)
+
+	#undef DISPOSE
+	TIMELINE_END("DisposeResources")
+}
+
+static void OPENGL_INTERNAL_UpdateRenderScale(OpenGLRenderer *renderer)
+{
+	uint64_t cost, frequency;
+	GLuint available, elapsedNs;
+	int32_t query, oldWidth, oldHeight;
+	double ratio;
+	float scale;
+
+	frequency = SDL_GetPerformanceFrequency();
+	cost = renderer->renderScaleCpuTime;
+
+	/* CPU time alone can't see fill rate, so take the GPU time too when
+	 * the oldest query has landed. Never stall waiting for it!
+	 */
+	query = renderer->renderScaleQueryIndex;
+	if (renderer->renderScaleQueryPending[query])
+	{
+		renderer->glGetQueryObjectuiv(
+			renderer->renderScaleQueries[query],
+			GL_QUERY_RESULT_AVAILABLE,
+			&available
+		);
+		if (available)
+		{
+			renderer->glGetQueryObjectuiv(
+				renderer->renderScaleQueries[query],
+				GL_QUERY_RESULT,
+				&elapsedNs
+			);
+			renderer->renderScaleQueryPending[query] = 0;
+			cost = SDL_max(
+				cost,
+				((uint64_t) elapsedNs * frequency) / 1000000000ULL
+			);
+		}
+	}
+
+	renderer->renderScaleCost += ((double) cost - renderer->renderScaleCost) / 8.0;
+	if (renderer->renderScaleCooldown > 0)
+	{
+		renderer->renderScaleCooldown -= 1;
+		return;
+	}
+
+	/* Only move when we're clearly over budget or clearly idle */
+	ratio = (double) renderer->renderScaleBudget / renderer->renderScaleCost;
+	if (ratio > 0.95 && ratio < 1.15)
+	{
+		return;
+	}
+
+	/* Cost follows the pixel count, which is the square of the scale */
+	scale = renderer->renderScale * (float) SDL_sqrt(ratio);
+	scale = SDL_clamp(
+		scale,
+		renderer->renderScale - 0.1f,
+		renderer->renderScale + 0.1f
 	);
-	SDL_setenv("RAL_GL_UPLOAD_T", buffer, 1);
-
-	renderer->perfMapWrites = 0;
-	renderer->perfMapBytes = 0;
-	renderer->perfSubDataWrites = 0;
-	renderer->perfSubDataBytes = 0;
-	renderer->perfDrawCalls = 0;
-	renderer->perfFrameCount = 0;
-	renderer->perfSwapWaitNs = 0;
-	renderer->perfSleepNs = 0;
-	renderer->perfDrawIndexedCalls = 0;
-	renderer->perfDrawInstancedCalls = 0;
-	renderer->perfDrawPrimitiveCalls = 0;
-	renderer->perfClearCalls = 0;
-	renderer->perfSetRenderTargetCalls = 0;
-	renderer->perfApplyEffectCalls = 0;
-	renderer->perfVertexUploadCalls = 0;
-	renderer->perfIndexUploadCalls = 0;
-	renderer->perfVertexUploadBytes = 0;
-	renderer->perfIndexUploadBytes = 0;
-	renderer->perfPublishTimestamp = now;
+	scale = SDL_clamp(
+		scale,
+		renderer->renderScaleMin,
+		renderer->qualityRenderScale
+	);
+	if (SDL_fabs(scale - renderer->renderScale) < 0.01f)
+	{
+		return;
+	}
+
+	renderer->renderScale = scale;
+	renderer->renderScaleCooldown = 8;
+
+	oldWidth = renderer->backbuffer->renderWidth;
+	oldHeight = renderer->backbuffer->renderHeight;
+	ApplyRenderScale(renderer);
+	if (	!renderer->renderTargetBound &&
+		(	renderer->backbuffer->renderWidth != oldWidth ||
+			renderer->backbuffer->renderHeight != oldHeight	)	)
+	{
+		OPENGL_SetViewport(
+			(FNA3D_Renderer*) renderer,
+			&renderer->backbufferViewport
+		);
+		OPENGL_SetScissorRect(
+			(FNA3D_Renderer*) renderer,
+			&renderer->backbufferScissor
+		);
+	}
 }
 
 static void OPENGL_SwapBuffers(
@@ -1595,7 +2203,26 @@ static void OPENGL_SwapBuffers(
 	uint64_t swapEnd;
 	OpenGLRenderer *renderer = (OpenGLRenderer*) driverData;
 
-	perfFrequency = renderer->perfDiagnosticsEnabled ? SDL_GetPerformanceFrequency() : 0;
+	perfFrequency = renderer->perf.enabled ? SDL_GetPerformanceFrequency() : 0;
+
+	if (renderer->renderScaleDynamic)
+	{
+		renderer->renderScaleCpuTime = (
+			SDL_GetPerformanceCounter() -
+			renderer->renderScaleFrameStart
+		);
+		if (renderer->supportsTimerQuery)
+		{
+			renderer->glEndQuery(GL_TIME_ELAPSED);
+			renderer->renderScaleQueryPending[
+				renderer->renderScaleQueryIndex
+			] = 1;
+			renderer->renderScaleQueryIndex = (
+				(renderer->renderScaleQueryIndex + 1) %
+				RENDER_SCALE_QUERY_COUNT
+			);
+		}
+	}
 
 	/* Only the faux-backbuffer supports presenting
 	 * specific regions given to Present().
@@ -1617,6 +2244,7 @@ static void OPENGL_SwapBuffers(
 			srcW = renderer->backbuffer->width;
 			srcH = renderer->backbuffer->height;
 		}
+		ScaleBackbufferRect(renderer, &srcX, &srcY, &srcW, &srcH);
 		if (destinationRectangle != NULL)
 		{
 			dstX = destinationRectangle->x;
@@ -1656,8 +2284,8 @@ static void OPENGL_SwapBuffers(
 					GL_TEXTURE_2D,
 					0,
 					GL_RGBA,
-					renderer->backbuffer->width,
-					renderer->backbuffer->height,
+					renderer->backbuffer->storageWidth,
+					renderer->backbuffer->storageHeight,
 					0,
 					GL_RGBA,
 					GL_UNSIGNED_BYTE,
@@ -1678,8 +2306,8 @@ static void OPENGL_SwapBuffers(
 			);
 			BindReadFramebuffer(renderer, renderer->backbuffer->opengl.handle);
 			renderer->glBlitFramebuffer(
-				0, 0, renderer->backbuffer->width, renderer->backbuffer->height,
-				0, 0, renderer->backbuffer->width, renderer->backbuffer->height,
+				0, 0, renderer->backbuffer->renderWidth, renderer->backbuffer->renderHeight,
+				0, 0, renderer->backbuffer->renderWidth, renderer->backbuffer->renderHeight,
 				GL_COLOR_BUFFER_BIT,
 				GL_LINEAR
 			);
@@ -1723,13 +2351,16 @@ static void OPENGL_SwapBuffers(
 			renderer->glEnable(GL_SCISSOR_TEST);
 		}
 
-		if (renderer->perfDiagnosticsEnabled)
+		if (renderer->perf.enabled)
 		{
 			swapStart = SDL_GetPerformanceCounter();
 			SDL_GL_SwapWindow((SDL_Window*) overrideWindowHandle);
 			swapEnd = SDL_GetPerformanceCounter();
-			renderer->perfSwapWaitNs +=
-				((swapEnd - swapStart) * 1000000000ULL) / perfFrequency;
+			FNA3D_PERF_ADD(
+				renderer->perf,
+				swapWaitNs,
+				((swapEnd - swapStart) * 1000000000ULL) / perfFrequency
+			);
 		}
 		else
 		{
@@ -1741,13 +2372,16 @@ static void OPENGL_SwapBuffers(
 	else
 	{
 		/* Nothing left to do, just swap! */
-		if (renderer->perfDiagnosticsEnabled)
+		if (renderer->perf.enabled)
 		{
 			swapStart = SDL_GetPerformanceCounter();
 			SDL_GL_SwapWindow((SDL_Window*) overrideWindowHandle);
 			swapEnd = SDL_GetPerformanceCounter();
-			renderer->perfSwapWaitNs +=
-				((swapEnd - swapStart) * 1000000000ULL) / perfFrequency;
+			FNA3D_PERF_ADD(
+				renderer->perf,
+				swapWaitNs,
+				((swapEnd - swapStart) * 1000000000ULL) / perfFrequency
+			);
 		}
 		else
 		{
@@ -1755,49 +2389,36 @@ static void OPENGL_SwapBuffers(
 		}
 	}
 
-	if (renderer->perfDiagnosticsEnabled)
+	if (renderer->renderScaleDynamic)
 	{
-		renderer->perfFrameCount += 1;
-		renderer->perfTotalFrameCount += 1;
+		OPENGL_INTERNAL_UpdateRenderScale(renderer);
 	}
 
 	/* Frame rate limiting */
-	if (renderer->targetFps > 0 && renderer->targetFrameTime > 0)
-	{
-		uint64_t currentTime = SDL_GetPerformanceCounter();
-		uint64_t frequency = SDL_GetPerformanceFrequency();
-		
-		if (renderer->frameStartTime > 0)
-		{
-			/* Calculate elapsed time in nanoseconds */
-			uint64_t elapsedTicks = currentTime - renderer->frameStartTime;
-			uint64_t elapsedNs = (elapsedTicks * 1000000000ULL) / frequency;
-			
-			/* Sleep if we're ahead of schedule */
-			if (elapsedNs < renderer->targetFrameTime)
-			{
-				uint64_t sleepNs = renderer->targetFrameTime - elapsedNs;
-				uint32_t sleepMs = (uint32_t)(sleepNs / 1000000ULL);
-				if (sleepMs > 0)
-				{
-					SDL_Delay(sleepMs);
-				}
-				if (renderer->perfDiagnosticsEnabled)
-				{
-					renderer->perfSleepNs += sleepNs;
-				}
-			}
+	FNA3D_FramePacer_Wait(&renderer->pacer, &renderer->perf);
+
+	if (renderer->renderScaleDynamic)
+	{
+		renderer->renderScaleFrameStart = SDL_GetPerformanceCounter();
+		if (renderer->supportsTimerQuery)
+		{
+			renderer->glBeginQuery(
+				GL_TIME_ELAPSED,
+				renderer->renderScaleQueries[
+					renderer->renderScaleQueryIndex
+				]
+			);
 		}
-		
-		/* Record frame start time for next frame */
-		renderer->frameStartTime = SDL_GetPerformanceCounter();
 	}
 
-	OPENGL_PublishPerfDiagnostics(renderer);
+	FNA3D_PerfState_EndFrame(&renderer->perf);
 
 	/* Run any threaded commands */
 	ExecuteCommands(renderer);
 
+	/* Resources made on this thread may be uploaded from others */
+	FlushUploadDependency(renderer);
+
 	/* Destroy any disposed resources */
 	DisposeResources(renderer);
 }
@@ -1815,10 +2436,9 @@ static void OPENGL_Clear(
 	uint8_t clearTarget, clearDepth, clearStencil;
 	GLenum clearMask;
 
-	if (renderer->perfDiagnosticsEnabled)
+	if (renderer->perf.enabled)
 	{
-		renderer->perfClearCalls += 1;
-		renderer->perfTotalClearCalls += 1;
+		FNA3D_PERF_ADD(renderer->perf, clearCalls, 1);
 	}
 
 	/* glClear depends on the scissor rectangle! */
@@ -1936,6 +2556,7 @@ static void OPENGL_DrawIndexedPrimitives(
 	OpenGLRenderer *renderer = (OpenGLRenderer*) driverData;
 	OpenGLBuffer *buffer = (OpenGLBuffer*) indices;
 
+	WaitForBuffer(renderer, buffer, GL_ELEMENT_ARRAY_BUFFER);
 	BindIndexBuffer(renderer, buffer->handle);
 
 	tps = (	renderer->togglePointSprite &&
@@ -1955,7 +2576,10 @@ static void OPENGL_DrawIndexedPrimitives(
 			minVertexIndex + numVertices - 1,
 			PrimitiveVerts(primitiveType, primitiveCount),
 			XNAToGL_IndexType[indexElementSize],
-			(void*) (size_t) (startIndex * IndexSize(indexElementSize)),
+			(void*) (size_t) (
+				buffer->streamOffset +
+				startIndex * IndexSize(indexElementSize)
+			),
 			baseVertex
 		);
 	}
@@ -1967,7 +2591,10 @@ static void OPENGL_DrawIndexedPrimitives(
 			minVertexIndex + numVertices - 1,
 			PrimitiveVerts(primitiveType, primitiveCount),
 			XNAToGL_IndexType[indexElementSize],
-			(void*) (size_t) (startIndex * IndexSize(indexElementSize))
+			(void*) (size_t) (
+				buffer->streamOffset +
+				startIndex * IndexSize(indexElementSize)
+			)
 		);
 	}
 
@@ -1977,12 +2604,10 @@ static void OPENGL_DrawIndexedPrimitives(
 		renderer->glDisable(GL_POINT_SPRITE);
 	}
 
-	if (renderer->perfDiagnosticsEnabled)
+	if (renderer->perf.enabled)
 	{
-		renderer->perfDrawCalls += 1;
-		renderer->perfTotalDrawCalls += 1;
-		renderer->perfDrawIndexedCalls += 1;
-		renderer->perfTotalDrawIndexedCalls += 1;
+		FNA3D_PERF_ADD(renderer->perf, drawCalls, 1);
+		FNA3D_PERF_ADD(renderer->perf, drawIndexedCalls, 1);
 	}
 }
 
@@ -2006,6 +2631,7 @@ static void OPENGL_DrawInstancedPrimitives(
 
 	SDL_assert(renderer->supports_ARB_draw_instanced);
 
+	WaitForBuffer(renderer, buffer, GL_ELEMENT_ARRAY_BUFFER);
 	BindIndexBuffer(renderer, buffer->handle);
 
 	tps = (	renderer->togglePointSprite &&
@@ -2023,7 +2649,10 @@ static void OPENGL_DrawInstancedPrimitives(
 			XNAToGL_Primitive[primitiveType],
 			PrimitiveVerts(primitiveType, primitiveCount),
 			XNAToGL_IndexType[indexElementSize],
-			(void*) (size_t) (startIndex * IndexSize(indexElementSize)),
+			(void*) (size_t) (
+				buffer->streamOffset +
+				startIndex * IndexSize(indexElementSize)
+			),
 			instanceCount,
 			baseVertex
 		);
@@ -2034,7 +2663,10 @@ static void OPENGL_DrawInstancedPrimitives(
 			XNAToGL_Primitive[primitiveType],
 			PrimitiveVerts(primitiveType, primitiveCount),
 			XNAToGL_IndexType[indexElementSize],
-			(void*) (size_t) (startIndex * IndexSize(indexElementSize)),
+			(void*) (size_t) (
+				buffer->streamOffset +
+				startIndex * IndexSize(indexElementSize)
+			),
 			instanceCount
 		);
 	}
@@ -2045,12 +2677,10 @@ static void OPENGL_DrawInstancedPrimitives(
 		renderer->glDisable(GL_POINT_SPRITE);
 	}
 
-	if (renderer->perfDiagnosticsEnabled)
+	if (renderer->perf.enabled)
 	{
-		renderer->perfDrawCalls += 1;
-		renderer->perfTotalDrawCalls += 1;
-		renderer->perfDrawInstancedCalls += 1;
-		renderer->perfTotalDrawInstancedCalls += 1;
+		FNA3D_PERF_ADD(renderer->perf, drawCalls, 1);
+		FNA3D_PERF_ADD(renderer->perf, drawInstancedCalls, 1);
 	}
 }
 
@@ -2084,12 +2714,10 @@ static void OPENGL_DrawPrimitives(
 		renderer->glDisable(GL_POINT_SPRITE);
 	}
 
-	if (renderer->perfDiagnosticsEnabled)
+	if (renderer->perf.enabled)
 	{
-		renderer->perfDrawCalls += 1;
-		renderer->perfTotalDrawCalls += 1;
-		renderer->perfDrawPrimitiveCalls += 1;
-		renderer->perfTotalDrawPrimitiveCalls += 1;
+		FNA3D_PERF_ADD(renderer->perf, drawCalls, 1);
+		FNA3D_PERF_ADD(renderer->perf, drawPrimitiveCalls, 1);
 	}
 }
 
@@ -2104,8 +2732,10 @@ static void OPENGL_SetViewport(FNA3D_Renderer *driverData, FNA3D_Viewport *viewp
 	/* Flip viewport when target is not bound */
 	if (!renderer->renderTargetBound)
 	{
+		renderer->backbufferViewport = *viewport;
 		OPENGL_GetBackbufferSize(driverData, &bbw, &bbh);
 		vp.y = bbh - viewport->y - viewport->h;
+		ScaleBackbufferRect(renderer, &vp.x, &vp.y, &vp.w, &vp.h);
 	}
 
 	if (	vp.x != renderer->viewport.x ||
@@ -2154,8 +2784,10 @@ static void OPENGL_SetScissorRect(FNA3D_Renderer *driverData, FNA3D_Rect *scisso
 	/* Flip rectangle when target is not bound */
 	if (!renderer->renderTargetBound)
 	{
+		renderer->backbufferScissor = *scissor;
 		OPENGL_GetBackbufferSize(driverData, &bbw, &bbh);
 		sr.y = bbh - scissor->y - scissor->h;
+		ScaleBackbufferRect(renderer, &sr.x, &sr.y, &sr.w, &sr.h);
 	}
 
 	if (	sr.x != renderer->scissorRect.x ||
@@ -2659,6 +3291,8 @@ static void OPENGL_VerifySampler(
 		return;
 	}
 
+	WaitForTexture(renderer, tex);
+
 	if (	tex == renderer->textures[index] &&
 		sampler->addressU == tex->wrapS &&
 		sampler->addressV == tex->wrapT &&
@@ -2844,6 +3478,15 @@ static void OPENGL_ApplyVertexBufferBindings(
 	OpenGLBuffer *buffer;
 	OpenGLRenderer *renderer = (OpenGLRenderer*) driverData;
 
+	/* Don't make loading threads wait for the end of the frame */
+	ExecuteCommandsMidFrame(renderer);
+
+	for (i = 0; i < numBindings; i += 1)
+	{
+		buffer = (OpenGLBuffer*) bindings[i].vertexBuffer;
+		WaitForBuffer(renderer, buffer, GL_ARRAY_BUFFER);
+	}
+
 	if (renderer->supports_ARB_draw_elements_base_vertex)
 	{
 		baseVertex = 0;
@@ -2851,7 +3494,8 @@ static void OPENGL_ApplyVertexBufferBindings(
 
 	if (	bindingsUpdated ||
 		baseVertex != renderer->ldBaseVertex ||
-		renderer->effectApplied	)
+		renderer->effectApplied ||
+		renderer->streamSliceChanged	)
 	{
 		/* There's this weird case where you can have overlapping
 		 * vertex usage/index combinations. It seems like the first
@@ -2867,6 +3511,7 @@ static void OPENGL_ApplyVertexBufferBindings(
 			BindVertexBuffer(renderer, buffer->handle);
 			vertexDeclaration = &bindings[i].vertexDeclaration;
 			basePtr = (uint8_t*) (size_t) (
+				buffer->streamOffset +
 				vertexDeclaration->vertexStride *
 				(bindings[i].vertexOffset + baseVertex)
 			);
@@ -2937,12 +3582,13 @@ static void OPENGL_ApplyVertexBufferBindings(
 
 		renderer->ldBaseVertex = baseVertex;
 		renderer->effectApplied = 0;
+		renderer->streamSliceChanged = 0;
 	}
 
 	MOJOSHADER_glProgramReady();
 	MOJOSHADER_glProgramViewportInfo(
 		renderer->viewport.w, renderer->viewport.h,
-		renderer->backbuffer->width, renderer->backbuffer->height,
+		renderer->backbuffer->renderWidth, renderer->backbuffer->renderHeight,
 		renderer->renderTargetBound
 	);
 }
@@ -2964,10 +3610,9 @@ static void OPENGL_SetRenderTargets(
 	int32_t i;
 	GLuint handle;
 
-	if (renderer->perfDiagnosticsEnabled)
+	if (renderer->perf.enabled)
 	{
-		renderer->perfSetRenderTargetCalls += 1;
-		renderer->perfTotalSetRenderTargetCalls += 1;
+		FNA3D_PERF_ADD(renderer->perf, setRenderTargetCalls, 1);
 	}
 
 	/* Bind the right framebuffer, if needed */
@@ -3264,6 +3909,9 @@ static void OPENGL_INTERNAL_CreateBackbuffer(
 				drawY != parameters->backBufferHeight	);
 	useFauxBackbuffer = (	useFauxBackbuffer ||
 				(parameters->multiSampleCount > 0)	);
+	useFauxBackbuffer = (	useFauxBackbuffer ||
+				renderer->qualityRenderScale < 1.0f ||
+				renderer->renderScaleDynamic	);
 
 	if (useFauxBackbuffer)
 	{
@@ -3289,6 +3937,15 @@ static void OPENGL_INTERNAL_CreateBackbuffer(
 
 			renderer->backbuffer->width = parameters->backBufferWidth;
 			renderer->backbuffer->height = parameters->backBufferHeight;
+			renderer->backbuffer->storageWidth = SDL_max(
+				(int32_t) (parameters->backBufferWidth * renderer->qualityRenderScale + 0.5f),
+				1
+			);
+			renderer->backbuffer->storageHeight = SDL_max(
+				(int32_t) (parameters->backBufferHeight * renderer->qualityRenderScale + 0.5f),
+				1
+			);
+			ApplyRenderScale(renderer);
 			renderer->backbuffer->depthFormat = parameters->depthStencilFormat;
 			renderer->backbuffer->isSrgb = parameters->backBufferFormat == FNA3D_SURFACEFORMAT_COLORSRGB_EXT;
 			renderer->backbuffer->multiSampleCount = parameters->multiSampleCount;
@@ -3319,8 +3976,8 @@ static void OPENGL_INTERNAL_CreateBackbuffer(
 					GL_RENDERBUFFER,
 					renderer->backbuffer->multiSampleCount,
 					GL_RGBA8,
-					renderer->backbuffer->width,
-					renderer->backbuffer->height
+					renderer->backbuffer->storageWidth,
+					renderer->backbuffer->storageHeight
 				);
 			}
 			else
@@ -3328,8 +3985,8 @@ static void OPENGL_INTERNAL_CreateBackbuffer(
 				renderer->glRenderbufferStorage(
 					GL_RENDERBUFFER,
 					GL_RGBA8,
-					renderer->backbuffer->width,
-					renderer->backbuffer->height
+					renderer->backbuffer->storageWidth,
+					renderer->backbuffer->storageHeight
 				);
 			}
 			renderer->glFramebufferRenderbuffer(
@@ -3369,8 +4026,8 @@ static void OPENGL_INTERNAL_CreateBackbuffer(
 					XNAToGL_DepthStorage[
 						renderer->backbuffer->depthFormat
 					],
-					renderer->backbuffer->width,
-					renderer->backbuffer->height
+					renderer->backbuffer->storageWidth,
+					renderer->backbuffer->storageHeight
 				);
 			}
 			else
@@ -3380,8 +4037,8 @@ static void OPENGL_INTERNAL_CreateBackbuffer(
 					XNAToGL_DepthStorage[
 						renderer->backbuffer->depthFormat
 					],
-					renderer->backbuffer->width,
-					renderer->backbuffer->height
+					renderer->backbuffer->storageWidth,
+					renderer->backbuffer->storageHeight
 				);
 			}
 			renderer->glFramebufferRenderbuffer(
@@ -3410,6 +4067,15 @@ static void OPENGL_INTERNAL_CreateBackbuffer(
 		{
 			renderer->backbuffer->width = parameters->backBufferWidth;
 			renderer->backbuffer->height = parameters->backBufferHeight;
+			renderer->backbuffer->storageWidth = SDL_max(
+				(int32_t) (parameters->backBufferWidth * renderer->qualityRenderScale + 0.5f),
+				1
+			);
+			renderer->backbuffer->storageHeight = SDL_max(
+				(int32_t) (parameters->backBufferHeight * renderer->qualityRenderScale + 0.5f),
+				1
+			);
+			ApplyRenderScale(renderer);
 			renderer->backbuffer->isSrgb = parameters->backBufferFormat == FNA3D_SURFACEFORMAT_COLORSRGB_EXT;
 			renderer->backbuffer->multiSampleCount = parameters->multiSampleCount;
 			if (renderer->backbuffer->opengl.texture != 0)
@@ -3468,8 +4134,8 @@ static void OPENGL_INTERNAL_CreateBackbuffer(
 					GL_RENDERBUFFER,
 					renderer->backbuffer->multiSampleCount,
 					GL_RGBA8,
-					renderer->backbuffer->width,
-					renderer->backbuffer->height
+					renderer->backbuffer->storageWidth,
+					renderer->backbuffer->storageHeight
 				);
 			}
 			else
@@ -3477,8 +4143,8 @@ static void OPENGL_INTERNAL_CreateBackbuffer(
 				renderer->glRenderbufferStorage(
 					GL_RENDERBUFFER,
 					GL_RGBA8,
-					renderer->backbuffer->width,
-					renderer->backbuffer->height
+					renderer->backbuffer->storageWidth,
+					renderer->backbuffer->storageHeight
 				);
 			}
 			renderer->glFramebufferRenderbuffer(
@@ -3522,8 +4188,8 @@ static void OPENGL_INTERNAL_CreateBackbuffer(
 						GL_RENDERBUFFER,
 						renderer->backbuffer->multiSampleCount,
 						XNAToGL_DepthStorage[renderer->backbuffer->depthFormat],
-						renderer->backbuffer->width,
-						renderer->backbuffer->height
+						renderer->backbuffer->storageWidth,
+						renderer->backbuffer->storageHeight
 					);
 				}
 				else
@@ -3531,8 +4197,8 @@ static void OPENGL_INTERNAL_CreateBackbuffer(
 					renderer->glRenderbufferStorage(
 						GL_RENDERBUFFER,
 						XNAToGL_DepthStorage[renderer->backbuffer->depthFormat],
-						renderer->backbuffer->width,
-						renderer->backbuffer->height
+						renderer->backbuffer->storageWidth,
+						renderer->backbuffer->storageHeight
 					);
 				}
 				renderer->glFramebufferRenderbuffer(
@@ -3584,6 +4250,9 @@ static void OPENGL_INTERNAL_CreateBackbuffer(
 		}
 		renderer->backbuffer->width = parameters->backBufferWidth;
 		renderer->backbuffer->height = parameters->backBufferHeight;
+		renderer->backbuffer->storageWidth = parameters->backBufferWidth;
+		renderer->backbuffer->storageHeight = parameters->backBufferHeight;
+		ApplyRenderScale(renderer);
 		renderer->backbuffer->depthFormat = renderer->windowDepthFormat;
 		renderer->backbuffer->isSrgb = parameters->backBufferFormat == FNA3D_SURFACEFORMAT_COLORSRGB_EXT;
 		renderer->backbuffer->multiSampleCount = 0;
@@ -3754,22 +4423,13 @@ static void OPENGL_ResetBackbuffer(
 	);
 }
 
-static void OPENGL_ReadBackbuffer(
-	FNA3D_Renderer *driverData,
-	int32_t x,
-	int32_t y,
-	int32_t w,
-	int32_t h,
-	void* data,
-	int32_t dataLength
+/* Binds the backbuffer (resolved, if multisampled) as the read framebuffer.
+ * The draw framebuffer is left as it was.
+ */
+static void OPENGL_INTERNAL_BindBackbufferForReading(
+	OpenGLRenderer *renderer
 ) {
-	GLuint prevReadBuffer, prevDrawBuffer;
-	int32_t pitch, row;
-	uint8_t *temp;
-	OpenGLRenderer *renderer = (OpenGLRenderer*) driverData;
-	uint8_t *dataPtr = (uint8_t*) data;
-
-	prevReadBuffer = renderer->currentReadFramebuffer;
+	GLuint prevDrawBuffer;
 
 	if (renderer->backbuffer->multiSampleCount > 0)
 	{
@@ -3790,8 +4450,8 @@ static void OPENGL_ReadBackbuffer(
 				GL_TEXTURE_2D,
 				0,
 				GL_RGBA,
-				renderer->backbuffer->width,
-				renderer->backbuffer->height,
+				renderer->backbuffer->storageWidth,
+				renderer->backbuffer->storageHeight,
 				0,
 				GL_RGBA,
 				GL_UNSIGNED_BYTE,
@@ -3812,8 +4472,8 @@ static void OPENGL_ReadBackbuffer(
 		);
 		BindReadFramebuffer(renderer, renderer->backbuffer->opengl.handle);
 		renderer->glBlitFramebuffer(
-			0, 0, renderer->backbuffer->width, renderer->backbuffer->height,
-			0, 0, renderer->backbuffer->width, renderer->backbuffer->height,
+			0, 0, renderer->backbuffer->renderWidth, renderer->backbuffer->renderHeight,
+			0, 0, renderer->backbuffer->renderWidth, renderer->backbuffer->renderHeight,
 			GL_COLOR_BUFFER_BIT,
 			GL_LINEAR
 		);
@@ -3830,16 +4490,72 @@ static void OPENGL_ReadBackbuffer(
 				0
 		);
 	}
+}
 
-	renderer->glReadPixels(
-		x,
-		y,
-		w,
-		h,
-		GL_RGBA,
-		GL_UNSIGNED_BYTE,
-		data
-	);
+static void OPENGL_ReadBackbuffer(
+	FNA3D_Renderer *driverData,
+	int32_t x,
+	int32_t y,
+	int32_t w,
+	int32_t h,
+	void* data,
+	int32_t dataLength
+) {
+	GLuint prevReadBuffer;
+	int32_t pitch, row, col;
+	int32_t sx, sy, sw, sh;
+	uint8_t *temp;
+	uint32_t *scaled;
+	OpenGLRenderer *renderer = (OpenGLRenderer*) driverData;
+	uint8_t *dataPtr = (uint8_t*) data;
+
+	prevReadBuffer = renderer->currentReadFramebuffer;
+	OPENGL_INTERNAL_BindBackbufferForReading(renderer);
+
+	if (	renderer->backbuffer->renderWidth == renderer->backbuffer->width &&
+		renderer->backbuffer->renderHeight == renderer->backbuffer->height	)
+	{
+		renderer->glReadPixels(
+			x,
+			y,
+			w,
+			h,
+			GL_RGBA,
+			GL_UNSIGNED_BYTE,
+			data
+		);
+	}
+	else
+	{
+		/* Read the scaled region, then point-sample it back up */
+		sx = x;
+		sy = y;
+		sw = w;
+		sh = h;
+		ScaleBackbufferRect(renderer, &sx, &sy, &sw, &sh);
+		sw = SDL_max(sw, 1);
+		sh = SDL_max(sh, 1);
+		scaled = (uint32_t*) SDL_malloc(sw * sh * 4);
+		renderer->glReadPixels(
+			sx,
+			sy,
+			sw,
+			sh,
+			GL_RGBA,
+			GL_UNSIGNED_BYTE,
+			scaled
+		);
+		for (row = 0; row < h; row += 1)
+		{
+			for (col = 0; col < w; col += 1)
+			{
+				((uint32_t*) dataPtr)[(row * w) + col] = scaled[
+					(((row * sh) / h) * sw) + ((col * sw) / w)
+				];
+			}
+		}
+		SDL_free(scaled);
+	}
 
 	BindReadFramebuffer(renderer, prevReadBuffer);
 
@@ -3910,6 +4626,8 @@ static inline OpenGLTexture* OPENGL_INTERNAL_CreateTexture(
 	result->format = format;
 	result->next = NULL;
 	result->external = 0;
+	SDL_SetAtomicInt(&result->uploadSerial, 0);
+	result->syncedSerial = 0;
 
 	BindTexture(renderer, result);
 	renderer->glTexParameteri(
@@ -4060,6 +4778,8 @@ static FNA3D_Texture* OPENGL_CreateTexture2D(
 		}
 	}
 
+	MarkUploadDependency(renderer);
+
 	return (FNA3D_Texture*) result;
 }
 
@@ -4116,6 +4836,9 @@ static FNA3D_Texture* OPENGL_CreateTexture3D(
 			NULL
 		);
 	}
+
+	MarkUploadDependency(renderer);
+
 	return (FNA3D_Texture*) result;
 }
 
@@ -4204,6 +4927,8 @@ static FNA3D_Texture* OPENGL_CreateTextureCube(
 		}
 	}
 
+	MarkUploadDependency(renderer);
+
 	return (FNA3D_Texture*) result;
 }
 
@@ -4212,6 +4937,10 @@ static void OPENGL_INTERNAL_DestroyTexture(
 	OpenGLTexture *texture
 ) {
 	int32_t i;
+
+	/* Don't let the name get recycled under a pending upload */
+	WaitForUpload(renderer, SDL_GetAtomicInt(&texture->uploadSerial));
+
 	for (i = 0; i < renderer->numAttachments; i += 1)
 	{
 		if (texture->handle == renderer->currentAttachments[i])
@@ -4270,23 +4999,50 @@ static void OPENGL_SetTextureData2D(
 	OpenGLTexture *glTexture = (OpenGLTexture*) texture;
 	GLenum glFormat;
 	int32_t packSize;
-	FNA3D_Command cmd;
+	FNA3D_Command *cmd;
+	void *dataCopy;
 
 	if (renderer->threadID != SDL_GetCurrentThreadID())
 	{
-		cmd.type = FNA3D_COMMAND_SETTEXTUREDATA2D;
-		cmd.setTextureData2D.texture = texture;
-		cmd.setTextureData2D.x = x;
-		cmd.setTextureData2D.y = y;
-		cmd.setTextureData2D.w = w;
-		cmd.setTextureData2D.h = h;
-		cmd.setTextureData2D.level = level;
-		cmd.setTextureData2D.data = data;
-		cmd.setTextureData2D.dataLength = dataLength;
-		ForceToMainThread(renderer, &cmd);
+		if (renderer->uploadThread != NULL)
+		{
+			QueueTextureUpload(
+				renderer,
+				glTexture,
+				GL_TEXTURE_2D,
+				x,
+				y,
+				0,
+				w,
+				h,
+				1,
+				level,
+				data,
+				dataLength
+			);
+			return;
+		}
+
+		cmd = AllocDeferredCommand(
+			renderer,
+			data,
+			dataLength,
+			&dataCopy
+		);
+		cmd->type = FNA3D_COMMAND_SETTEXTUREDATA2D;
+		cmd->setTextureData2D.texture = texture;
+		cmd->setTextureData2D.x = x;
+		cmd->setTextureData2D.y = y;
+		cmd->setTextureData2D.w = w;
+		cmd->setTextureData2D.h = h;
+		cmd->setTextureData2D.level = level;
+		cmd->setTextureData2D.data = dataCopy;
+		cmd->setTextureData2D.dataLength = dataLength;
+		DeferToMainThread(renderer, cmd);
 		return;
 	}
 
+	WaitForTexture(renderer, glTexture);
 	BindTexture(renderer, glTexture);
 
 	glFormat = XNAToGL_TextureFormat[glTexture->format];
@@ -4360,27 +5116,54 @@ static void OPENGL_SetTextureData3D(
 ) {
 	OpenGLRenderer *renderer = (OpenGLRenderer*) driverData;
 	OpenGLTexture *glTexture = (OpenGLTexture*) texture;
-	FNA3D_Command cmd;
+	FNA3D_Command *cmd;
+	void *dataCopy;
 
 	SDL_assert(renderer->supports_3DTexture);
 
 	if (renderer->threadID != SDL_GetCurrentThreadID())
 	{
-		cmd.type = FNA3D_COMMAND_SETTEXTUREDATA3D;
-		cmd.setTextureData3D.texture = texture;
-		cmd.setTextureData3D.x = x;
-		cmd.setTextureData3D.y = y;
-		cmd.setTextureData3D.z = z;
-		cmd.setTextureData3D.w = w;
-		cmd.setTextureData3D.h = h;
-		cmd.setTextureData3D.d = d;
-		cmd.setTextureData3D.level = level;
-		cmd.setTextureData3D.data = data;
-		cmd.setTextureData3D.dataLength = dataLength;
-		ForceToMainThread(renderer, &cmd);
+		if (renderer->uploadThread != NULL)
+		{
+			QueueTextureUpload(
+				renderer,
+				glTexture,
+				GL_TEXTURE_3D,
+				x,
+				y,
+				z,
+				w,
+				h,
+				d,
+				level,
+				data,
+				dataLength
+			);
+			return;
+		}
+
+		cmd = AllocDeferredCommand(
+			renderer,
+			data,
+			dataLength,
+			&dataCopy
+		);
+		cmd->type = FNA3D_COMMAND_SETTEXTUREDATA3D;
+		cmd->setTextureData3D.texture = texture;
+		cmd->setTextureData3D.x = x;
+		cmd->setTextureData3D.y = y;
+		cmd->setTextureData3D.z = z;
+		cmd->setTextureData3D.w = w;
+		cmd->setTextureData3D.h = h;
+		cmd->setTextureData3D.d = d;
+		cmd->setTextureData3D.level = level;
+		cmd->setTextureData3D.data = dataCopy;
+		cmd->setTextureData3D.dataLength = dataLength;
+		DeferToMainThread(renderer, cmd);
 		return;
 	}
 
+	WaitForTexture(renderer, glTexture);
 	BindTexture(renderer, glTexture);
 
 	renderer->glTexSubImage3D(
@@ -4413,24 +5196,51 @@ static void OPENGL_SetTextureDataCube(
 	OpenGLRenderer *renderer = (OpenGLRenderer*) driverData;
 	OpenGLTexture *glTexture = (OpenGLTexture*) texture;
 	GLenum glFormat;
-	FNA3D_Command cmd;
+	FNA3D_Command *cmd;
+	void *dataCopy;
+
+	if (renderer->threadID != SDL_GetCurrentThreadID())
+	{
+		if (renderer->uploadThread != NULL)
+		{
+			QueueTextureUpload(
+				renderer,
+				glTexture,
+				GL_TEXTURE_CUBE_MAP_POSITIVE_X + cubeMapFace,
+				x,
+				y,
+				0,
+				w,
+				h,
+				1,
+				level,
+				data,
+				dataLength
+			);
+			return;
+		}
 
-	if (renderer->threadID != SDL_GetCurrentThreadID())
-	{
-		cmd.type = FNA3D_COMMAND_SETTEXTUREDATACUBE;
-		cmd.setTextureDataCube.texture = texture;
-		cmd.setTextureDataCube.x = x;
-		cmd.setTextureDataCube.y = y;
-		cmd.setTextureDataCube.w = w;
-		cmd.setTextureDataCube.h = h;
-		cmd.setTextureDataCube.cubeMapFace = cubeMapFace;
-		cmd.setTextureDataCube.level = level;
-		cmd.setTextureDataCube.data = data;
-		cmd.setTextureDataCube.dataLength = dataLength;
-		ForceToMainThread(renderer, &cmd);
+		cmd = AllocDeferredCommand(
+			renderer,
+			data,
+			dataLength,
+			&dataCopy
+		);
+		cmd->type = FNA3D_COMMAND_SETTEXTUREDATACUBE;
+		cmd->setTextureDataCube.texture = texture;
+		cmd->setTextureDataCube.x = x;
+		cmd->setTextureDataCube.y = y;
+		cmd->setTextureDataCube.w = w;
+		cmd->setTextureDataCube.h = h;
+		cmd->setTextureDataCube.cubeMapFace = cubeMapFace;
+		cmd->setTextureDataCube.level = level;
+		cmd->setTextureDataCube.data = dataCopy;
+		cmd->setTextureDataCube.dataLength = dataLength;
+		DeferToMainThread(renderer, cmd);
 		return;
 	}
 
+	WaitForTexture(renderer, glTexture);
 	BindTexture(renderer, glTexture);
 
 	glFormat = XNAToGL_TextureFormat[glTexture->format];
@@ -4565,6 +5375,8 @@ static void OPENGL_GetTextureData2D(
 		return;
 	}
 
+	WaitForTexture(renderer, (OpenGLTexture*) texture);
+
 	if (level == 0 && OPENGL_INTERNAL_ReadTargetIfApplicable(
 		driverData,
 		texture,
@@ -4699,6 +5511,7 @@ static void OPENGL_GetTextureDataCube(
 	}
 
 	glTexture = (OpenGLTexture*) texture;
+	WaitForTexture(renderer, glTexture);
 	textureSize = glTexture->cube.size >> level;
 	BindTexture(renderer, glTexture);
 	glFormat = XNAToGL_TextureFormat[glTexture->format];
@@ -4756,6 +5569,166 @@ static void OPENGL_GetTextureDataCube(
 	}
 }
 
+static FNA3D_Readback* OPENGL_RequestTextureDataAsync(
+	FNA3D_Renderer *driverData,
+	FNA3D_Texture *texture,
+	int32_t x,
+	int32_t y,
+	int32_t w,
+	int32_t h,
+	int32_t level,
+	int32_t dataLength
+) {
+	OpenGLRenderer *renderer = (OpenGLRenderer*) driverData;
+	OpenGLTexture *glTexture = (OpenGLTexture*) texture;
+	OpenGLReadback *readback;
+	GLuint prevReadBuffer, prevDrawBuffer;
+
+	/* Anything a PBO can't take is read synchronously by FNA3D.c */
+	if (	renderer->threadID != SDL_GetCurrentThreadID() ||
+		!renderer->supports_ARB_sync ||
+		!renderer->supports_ARB_map_buffer_range ||
+		dataLength < (w * h * 4)	)
+	{
+		return NULL;
+	}
+	if (texture == NULL)
+	{
+		/* Scaled backbuffers need the point-sampling in ReadBackbuffer */
+		if (	renderer->backbuffer->renderWidth != renderer->backbuffer->width ||
+			renderer->backbuffer->renderHeight != renderer->backbuffer->height	)
+		{
+			return NULL;
+		}
+	}
+	else if (glTexture->format != FNA3D_SURFACEFORMAT_COLOR)
+	{
+		return NULL;
+	}
+
+	readback = (OpenGLReadback*) SDL_malloc(sizeof(OpenGLReadback));
+	readback->base.dataLength = dataLength;
+	readback->base.data = NULL;
+	readback->pitch = (texture == NULL) ? (w * 4) : 0;
+	readback->rows = h;
+
+	prevReadBuffer = renderer->currentReadFramebuffer;
+	prevDrawBuffer = renderer->currentDrawFramebuffer;
+	if (texture == NULL)
+	{
+		OPENGL_INTERNAL_BindBackbufferForReading(renderer);
+	}
+	else
+	{
+		WaitForTexture(renderer, glTexture);
+		BindFramebuffer(renderer, renderer->resolveFramebufferRead);
+		renderer->glFramebufferTexture2D(
+			GL_FRAMEBUFFER,
+			GL_COLOR_ATTACHMENT0,
+			GL_TEXTURE_2D,
+			glTexture->handle,
+			level
+		);
+	}
+
+	/* With a pack buffer bound, glReadPixels just queues the copy */
+	renderer->glGenBuffers(1, &readback->buffer);
+	renderer->glBindBuffer(GL_PIXEL_PACK_BUFFER, readback->buffer);
+	renderer->glBufferData(
+		GL_PIXEL_PACK_BUFFER,
+		dataLength,
+		NULL,
+		GL_STREAM_READ
+	);
+	renderer->glReadPixels(
+		x,
+		y,
+		w,
+		h,
+		GL_RGBA,
+		GL_UNSIGNED_BYTE,
+		NULL
+	);
+	renderer->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	readback->fence = renderer->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	if (prevReadBuffer == prevDrawBuffer)
+	{
+		BindFramebuffer(renderer, prevReadBuffer);
+	}
+	else
+	{
+		BindReadFramebuffer(renderer, prevReadBuffer);
+		BindDrawFramebuffer(renderer, prevDrawBuffer);
+	}
+
+	return &readback->base;
+}
+
+static uint8_t OPENGL_PollReadback(
+	FNA3D_Renderer *driverData,
+	FNA3D_Readback *readback,
+	void* data,
+	int32_t dataLength
+) {
+	OpenGLRenderer *renderer = (OpenGLRenderer*) driverData;
+	OpenGLReadback *glReadback = (OpenGLReadback*) readback;
+	uint8_t *dataPtr = (uint8_t*) data;
+	uint8_t *src;
+	int32_t row, rows;
+
+	if (data != NULL)
+	{
+		/* Zero timeout, the flush bit makes sure the fence gets there */
+		if (renderer->glClientWaitSync(
+			glReadback->fence,
+			GL_SYNC_FLUSH_COMMANDS_BIT,
+			0
+		) == GL_TIMEOUT_EXPIRED) {
+			return 0;
+		}
+
+		renderer->glBindBuffer(GL_PIXEL_PACK_BUFFER, glReadback->buffer);
+		src = (uint8_t*) renderer->glMapBufferRange(
+			GL_PIXEL_PACK_BUFFER,
+			0,
+			readback->dataLength,
+			GL_MAP_READ_BIT
+		);
+		if (src != NULL)
+		{
+			dataLength = SDL_min(dataLength, readback->dataLength);
+			if (glReadback->pitch == 0)
+			{
+				SDL_memcpy(dataPtr, src, dataLength);
+			}
+			else
+			{
+				/* Still a software flip, but at least it's a free one */
+				rows = SDL_min(
+					glReadback->rows,
+					dataLength / glReadback->pitch
+				);
+				for (row = 0; row < rows; row += 1)
+				{
+					SDL_memcpy(
+						dataPtr + (row * glReadback->pitch),
+						src + ((glReadback->rows - row - 1) * glReadback->pitch),
+						glReadback->pitch
+					);
+				}
+			}
+			renderer->glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		renderer->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+
+	renderer->glDeleteSync(glReadback->fence);
+	renderer->glDeleteBuffers(1, &glReadback->buffer);
+	SDL_free(glReadback);
+	return 1;
+}
+
 /* Renderbuffers */
 
 static FNA3D_Renderbuffer* OPENGL_GenColorRenderbuffer(
@@ -4809,109 +5782,373 @@ static FNA3D_Renderbuffer* OPENGL_GenColorRenderbuffer(
 			height
 		);
 	}
-	renderer->glBindRenderbuffer(GL_RENDERBUFFER, renderer->realBackbufferRBO);
-
-	return (FNA3D_Renderbuffer*) renderbuffer;
+	renderer->glBindRenderbuffer(GL_RENDERBUFFER, renderer->realBackbufferRBO);
+
+	return (FNA3D_Renderbuffer*) renderbuffer;
+}
+
+static FNA3D_Renderbuffer* OPENGL_GenDepthStencilRenderbuffer(
+	FNA3D_Renderer *driverData,
+	int32_t width,
+	int32_t height,
+	FNA3D_DepthFormat format,
+	int32_t multiSampleCount
+) {
+	OpenGLRenderer *renderer = (OpenGLRenderer*) driverData;
+	OpenGLRenderbuffer *renderbuffer;
+	FNA3D_Command cmd;
+
+	if (renderer->threadID != SDL_GetCurrentThreadID())
+	{
+		cmd.type = FNA3D_COMMAND_GENDEPTHRENDERBUFFER;
+		cmd.genDepthStencilRenderbuffer.width = width;
+		cmd.genDepthStencilRenderbuffer.height = height;
+		cmd.genDepthStencilRenderbuffer.format = format;
+		cmd.genDepthStencilRenderbuffer.multiSampleCount = multiSampleCount;
+		ForceToMainThread(renderer, &cmd);
+		return cmd.genDepthStencilRenderbuffer.retval;
+	}
+
+	renderbuffer = (OpenGLRenderbuffer*) SDL_malloc(
+		sizeof(OpenGLRenderbuffer)
+	);
+	renderbuffer->next = NULL;
+
+	renderer->glGenRenderbuffers(1, &renderbuffer->handle);
+	renderer->glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer->handle);
+	if (multiSampleCount > 0)
+	{
+		renderer->glRenderbufferStorageMultisample(
+			GL_RENDERBUFFER,
+			multiSampleCount,
+			XNAToGL_DepthStorage[format],
+			width,
+			height
+		);
+	}
+	else
+	{
+		renderer->glRenderbufferStorage(
+			GL_RENDERBUFFER,
+			XNAToGL_DepthStorage[format],
+			width,
+			height
+		);
+	}
+	renderer->glBindRenderbuffer(GL_RENDERBUFFER, renderer->realBackbufferRBO);
+
+	return (FNA3D_Renderbuffer*) renderbuffer;
+}
+
+static void OPENGL_INTERNAL_DestroyRenderbuffer(
+	OpenGLRenderer *renderer,
+	OpenGLRenderbuffer *renderbuffer
+) {
+	/* Check color attachments */
+	int32_t i;
+	for (i = 0; i < renderer->numAttachments; i += 1)
+	{
+		if (renderbuffer->handle == renderer->currentAttachments[i])
+		{
+			/* Force an attachment update, this no longer exists! */
+			renderer->currentAttachments[i] = UINT32_MAX;
+		}
+	}
+
+	/* Check depth/stencil attachment */
+	if (renderbuffer->handle == renderer->currentRenderbuffer)
+	{
+		/* Force a renderbuffer update, this no longer exists! */
+		renderer->currentRenderbuffer = UINT32_MAX;
+	}
+
+	/* Finally. */
+	renderer->glDeleteRenderbuffers(1, &renderbuffer->handle);
+	SDL_free(renderbuffer);
+}
+
+static void OPENGL_AddDisposeRenderbuffer(
+	FNA3D_Renderer *driverData,
+	FNA3D_Renderbuffer *renderbuffer
+) {
+	OpenGLRenderer *renderer = (OpenGLRenderer*) driverData;
+	OpenGLRenderbuffer *buffer = (OpenGLRenderbuffer*) renderbuffer;
+	OpenGLRenderbuffer *curr;
+
+	if (renderer->threadID == SDL_GetCurrentThreadID())
+	{
+		OPENGL_INTERNAL_DestroyRenderbuffer(renderer, buffer);
+	}
+	else
+	{
+		SDL_LockMutex(renderer->disposeRenderbuffersLock);
+		LinkedList_Add(renderer->disposeRenderbuffers, buffer, curr);
+		SDL_UnlockMutex(renderer->disposeRenderbuffersLock);
+	}
+}
+
+/* Persistent Streaming */
+
+static inline intptr_t StreamSliceSize(OpenGLBuffer *buffer)
+{
+	/* Keep every slice base nicely aligned for attribute fetches */
+	return (buffer->size + 255) & ~((intptr_t) 255);
+}
+
+static void OPENGL_INTERNAL_CreateStreamStorage(
+	OpenGLRenderer *renderer,
+	OpenGLBuffer *buffer,
+	GLenum target
+) {
+	const GLbitfield flags = (
+		GL_MAP_WRITE_BIT |
+		GL_MAP_PERSISTENT_BIT |
+		GL_MAP_COHERENT_BIT
+	);
+	const GLsizeiptr totalSize = (
+		StreamSliceSize(buffer) * renderer->streamSliceCount
+	);
+
+	/* DYNAMIC_STORAGE lets SETDATAOPTIONS_NONE keep using glBufferSubData */
+	renderer->glBufferStorage(
+		target,
+		totalSize,
+		NULL,
+		flags | GL_DYNAMIC_STORAGE_BIT
+	);
+	buffer->streamMapping = (uint8_t*) renderer->glMapBufferRange(
+		target,
+		0,
+		totalSize,
+		flags
+	);
+	if (buffer->streamMapping != NULL)
+	{
+		return;
+	}
+
+	/* The storage is immutable now, so start over with a fresh handle */
+	FNA3D_LogWarn("Persistent buffer mapping failed, falling back to glBufferData");
+	renderer->glDeleteBuffers(1, &buffer->handle);
+	renderer->glGenBuffers(1, &buffer->handle);
+	renderer->glBindBuffer(target, buffer->handle);
+	if (target == GL_ARRAY_BUFFER)
+	{
+		renderer->currentVertexBuffer = buffer->handle;
+	}
+	else
+	{
+		renderer->currentIndexBuffer = buffer->handle;
+	}
+}
+
+/* Returns 0 if the GPU is still using the slice after timeout nanoseconds */
+static uint8_t OPENGL_INTERNAL_PollStreamFence(
+	OpenGLRenderer *renderer,
+	GLsync *fence,
+	GLuint64 timeout
+) {
+	GLenum result;
+
+	if (*fence == NULL)
+	{
+		return 1;
+	}
+
+	result = renderer->glClientWaitSync(
+		*fence,
+		GL_SYNC_FLUSH_COMMANDS_BIT,
+		timeout
+	);
+	if (result == GL_TIMEOUT_EXPIRED)
+	{
+		return 0;
+	}
+	if (result == GL_WAIT_FAILED)
+	{
+		FNA3D_LogWarn("glClientWaitSync failed on a stream slice!");
+	}
+
+	renderer->glDeleteSync(*fence);
+	*fence = NULL;
+	return 1;
+}
+
+static void OPENGL_INTERNAL_DestroyStreamFences(
+	OpenGLRenderer *renderer,
+	OpenGLBuffer *buffer
+) {
+	int32_t i;
+
+	/* glDeleteBuffers takes care of the persistent mapping */
+	for (i = 0; i < MAX_STREAM_SLICES; i += 1)
+	{
+		if (buffer->streamFences[i] != NULL)
+		{
+			renderer->glDeleteSync(buffer->streamFences[i]);
+			buffer->streamFences[i] = NULL;
+		}
+	}
 }
 
-static FNA3D_Renderbuffer* OPENGL_GenDepthStencilRenderbuffer(
-	FNA3D_Renderer *driverData,
-	int32_t width,
-	int32_t height,
-	FNA3D_DepthFormat format,
-	int32_t multiSampleCount
+static void OPENGL_INTERNAL_OrphanStreamStorage(
+	OpenGLRenderer *renderer,
+	OpenGLBuffer *buffer,
+	GLenum target
 ) {
-	OpenGLRenderer *renderer = (OpenGLRenderer*) driverData;
-	OpenGLRenderbuffer *renderbuffer;
-	FNA3D_Command cmd;
+	GLuint handle;
+	int32_t i;
 
-	if (renderer->threadID != SDL_GetCurrentThreadID())
+	/* Storage is immutable, so this is what glBufferData(NULL) would do:
+	 * the GPU keeps the old storage until it's done, we get a fresh one.
+	 * The new name is made first so the old one can't be recycled into it.
+	 */
+	renderer->glGenBuffers(1, &handle);
+	OPENGL_INTERNAL_DestroyStreamFences(renderer, buffer);
+	renderer->glDeleteBuffers(1, &buffer->handle);
+	if (target == GL_ARRAY_BUFFER)
 	{
-		cmd.type = FNA3D_COMMAND_GENDEPTHRENDERBUFFER;
-		cmd.genDepthStencilRenderbuffer.width = width;
-		cmd.genDepthStencilRenderbuffer.height = height;
-		cmd.genDepthStencilRenderbuffer.format = format;
-		cmd.genDepthStencilRenderbuffer.multiSampleCount = multiSampleCount;
-		ForceToMainThread(renderer, &cmd);
-		return cmd.genDepthStencilRenderbuffer.retval;
+		for (i = 0; i < renderer->numVertexAttributes; i += 1)
+		{
+			if (buffer->handle == renderer->attributes[i].currentBuffer)
+			{
+				/* Force the next vertex attrib update! */
+				renderer->attributes[i].currentBuffer = UINT32_MAX;
+			}
+		}
 	}
 
-	renderbuffer = (OpenGLRenderbuffer*) SDL_malloc(
-		sizeof(OpenGLRenderbuffer)
-	);
-	renderbuffer->next = NULL;
+	if (renderer->restoreVertexBuffer == buffer->handle)
+	{
+		renderer->restoreVertexBuffer = handle;
+	}
+	if (renderer->restoreIndexBuffer == buffer->handle)
+	{
+		renderer->restoreIndexBuffer = handle;
+	}
 
-	renderer->glGenRenderbuffers(1, &renderbuffer->handle);
-	renderer->glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer->handle);
-	if (multiSampleCount > 0)
+	buffer->handle = handle;
+	buffer->streamMapping = NULL;
+	buffer->streamSlice = 0;
+	buffer->streamOffset = 0;
+	renderer->glBindBuffer(target, handle);
+	if (target == GL_ARRAY_BUFFER)
 	{
-		renderer->glRenderbufferStorageMultisample(
-			GL_RENDERBUFFER,
-			multiSampleCount,
-			XNAToGL_DepthStorage[format],
-			width,
-			height
-		);
+		renderer->currentVertexBuffer = handle;
 	}
 	else
 	{
-		renderer->glRenderbufferStorage(
-			GL_RENDERBUFFER,
-			XNAToGL_DepthStorage[format],
-			width,
-			height
+		renderer->currentIndexBuffer = handle;
+	}
+	OPENGL_INTERNAL_CreateStreamStorage(renderer, buffer, target);
+	if (buffer->streamMapping == NULL)
+	{
+		renderer->glBufferData(
+			target,
+			buffer->size,
+			NULL,
+			buffer->dynamic
 		);
 	}
-	renderer->glBindRenderbuffer(GL_RENDERBUFFER, renderer->realBackbufferRBO);
 
-	return (FNA3D_Renderbuffer*) renderbuffer;
+	MarkUploadDependency(renderer);
 }
 
-static void OPENGL_INTERNAL_DestroyRenderbuffer(
+/* Returns where to write in the persistent mapping, or NULL if the write has
+ * to go through glBufferSubData instead
+ */
+static uint8_t* OPENGL_INTERNAL_StreamBufferRange(
 	OpenGLRenderer *renderer,
-	OpenGLRenderbuffer *renderbuffer
+	OpenGLBuffer *buffer,
+	GLenum target,
+	int32_t offsetInBytes,
+	FNA3D_SetDataOptions options
 ) {
-	/* Check color attachments */
-	int32_t i;
-	for (i = 0; i < renderer->numAttachments; i += 1)
+	int32_t next;
+
+	if (options == FNA3D_SETDATAOPTIONS_NONE)
 	{
-		if (renderbuffer->handle == renderer->currentAttachments[i])
-		{
-			/* Force an attachment update, this no longer exists! */
-			renderer->currentAttachments[i] = UINT32_MAX;
-		}
+		/* The GPU may still be reading this slice, let the driver
+		 * synchronize the write instead of stalling on a fence.
+		 */
+		return NULL;
 	}
 
-	/* Check depth/stencil attachment */
-	if (renderbuffer->handle == renderer->currentRenderbuffer)
+	if (options == FNA3D_SETDATAOPTIONS_DISCARD)
 	{
-		/* Force a renderbuffer update, this no longer exists! */
-		renderer->currentRenderbuffer = UINT32_MAX;
+		/* Retire the active slice and move on to the oldest one */
+		buffer->streamFences[buffer->streamSlice] = renderer->glFenceSync(
+			GL_SYNC_GPU_COMMANDS_COMPLETE,
+			0
+		);
+		next = (buffer->streamSlice + 1) % renderer->streamSliceCount;
+		if (!OPENGL_INTERNAL_PollStreamFence(
+			renderer,
+			&buffer->streamFences[next],
+			0
+		)) {
+			/* The GPU is a whole ring behind, usually only just */
+			if (renderer->perf.enabled)
+			{
+				FNA3D_PERF_ADD(renderer->perf, streamRingStalls, 1);
+			}
+			if (!OPENGL_INTERNAL_PollStreamFence(
+				renderer,
+				&buffer->streamFences[next],
+				STREAM_FENCE_TIMEOUT_NS
+			)) {
+				/* Too far behind to wait on, take fresh storage */
+				OPENGL_INTERNAL_OrphanStreamStorage(
+					renderer,
+					buffer,
+					target
+				);
+				next = -1;
+			}
+		}
+		if (next >= 0)
+		{
+			buffer->streamSlice = next;
+			buffer->streamOffset = next * StreamSliceSize(buffer);
+		}
+
+		/* Attribute pointers include the slice base, reapply them */
+		renderer->streamSliceChanged = 1;
+
+		if (buffer->streamMapping == NULL)
+		{
+			/* Mapping the new storage failed, it's a plain buffer now */
+			return NULL;
+		}
 	}
 
-	/* Finally. */
-	renderer->glDeleteRenderbuffers(1, &renderbuffer->handle);
-	SDL_free(renderbuffer);
+	/* NoOverwrite writes straight into the active slice */
+	return buffer->streamMapping + buffer->streamOffset + offsetInBytes;
 }
 
-static void OPENGL_AddDisposeRenderbuffer(
-	FNA3D_Renderer *driverData,
-	FNA3D_Renderbuffer *renderbuffer
+/* Returns 0 if the write has to go through glBufferSubData instead */
+static uint8_t OPENGL_INTERNAL_StreamBufferData(
+	OpenGLRenderer *renderer,
+	OpenGLBuffer *buffer,
+	GLenum target,
+	int32_t offsetInBytes,
+	void* data,
+	GLsizeiptr dataLength,
+	FNA3D_SetDataOptions options
 ) {
-	OpenGLRenderer *renderer = (OpenGLRenderer*) driverData;
-	OpenGLRenderbuffer *buffer = (OpenGLRenderbuffer*) renderbuffer;
-	OpenGLRenderbuffer *curr;
-
-	if (renderer->threadID == SDL_GetCurrentThreadID())
-	{
-		OPENGL_INTERNAL_DestroyRenderbuffer(renderer, buffer);
-	}
-	else
+	uint8_t *dst = OPENGL_INTERNAL_StreamBufferRange(
+		renderer,
+		buffer,
+		target,
+		offsetInBytes,
+		options
+	);
+	if (dst == NULL)
 	{
-		SDL_LockMutex(renderer->disposeRenderbuffersLock);
-		LinkedList_Add(renderer->disposeRenderbuffers, buffer, curr);
-		SDL_UnlockMutex(renderer->disposeRenderbuffersLock);
+		return 0;
 	}
+	SDL_memcpy(dst, data, dataLength);
+	return 1;
 }
 
 /* Vertex Buffers */
@@ -4943,15 +6180,34 @@ static FNA3D_Buffer* OPENGL_GenVertexBuffer(
 	result->handle = handle;
 	result->size = (intptr_t) sizeInBytes;
 	result->dynamic = (dynamic ? GL_STREAM_DRAW : GL_STATIC_DRAW);
+	result->streamMapping = NULL;
+	result->streamOffset = 0;
+	result->streamSlice = 0;
+	SDL_memset(result->streamFences, '\0', sizeof(result->streamFences));
+	SDL_SetAtomicInt(&result->uploadSerial, 0);
+	result->syncedSerial = 0;
 	result->next = NULL;
 
 	BindVertexBuffer(renderer, handle);
-	renderer->glBufferData(
-		GL_ARRAY_BUFFER,
-		result->size,
-		NULL,
-		result->dynamic
-	);
+	if (dynamic && renderer->usePersistentStreaming)
+	{
+		OPENGL_INTERNAL_CreateStreamStorage(
+			renderer,
+			result,
+			GL_ARRAY_BUFFER
+		);
+	}
+	if (result->streamMapping == NULL)
+	{
+		renderer->glBufferData(
+			GL_ARRAY_BUFFER,
+			result->size,
+			NULL,
+			result->dynamic
+		);
+	}
+
+	MarkUploadDependency(renderer);
 
 	return (FNA3D_Buffer*) result;
 }
@@ -4962,6 +6218,9 @@ static void OPENGL_INTERNAL_DestroyVertexBuffer(
 ) {
 	int32_t i;
 
+	/* Don't let the name get recycled under a pending upload */
+	WaitForUpload(renderer, SDL_GetAtomicInt(&buffer->uploadSerial));
+
 	if (buffer->handle == renderer->currentVertexBuffer)
 	{
 		renderer->glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -4975,6 +6234,10 @@ static void OPENGL_INTERNAL_DestroyVertexBuffer(
 			renderer->attributes[i].currentBuffer = UINT32_MAX;
 		}
 	}
+	if (buffer->streamMapping != NULL)
+	{
+		OPENGL_INTERNAL_DestroyStreamFences(renderer, buffer);
+	}
 	renderer->glDeleteBuffers(1, &buffer->handle);
 
 	SDL_free(buffer);
@@ -5012,29 +6275,73 @@ static void OPENGL_SetVertexBufferData(
 ) {
 	OpenGLRenderer *renderer = (OpenGLRenderer*) driverData;
 	OpenGLBuffer *glBuffer = (OpenGLBuffer*) buffer;
-	FNA3D_Command cmd;
+	FNA3D_Command *cmd;
+	void *dataCopy;
 
 	if (renderer->threadID != SDL_GetCurrentThreadID())
 	{
-		cmd.type = FNA3D_COMMAND_SETVERTEXBUFFERDATA;
-		cmd.setVertexBufferData.buffer = buffer;
-		cmd.setVertexBufferData.offsetInBytes = offsetInBytes;
-		cmd.setVertexBufferData.data = data;
-		cmd.setVertexBufferData.elementCount = elementCount;
-		cmd.setVertexBufferData.elementSizeInBytes = elementSizeInBytes;
-		cmd.setVertexBufferData.vertexStride = vertexStride;
-		cmd.setVertexBufferData.options = options;
-		ForceToMainThread(renderer, &cmd);
+		/* The streaming ring is only ever touched on this thread */
+		if (	renderer->uploadThread != NULL &&
+			glBuffer->streamMapping == NULL	)
+		{
+			QueueBufferUpload(
+				renderer,
+				glBuffer,
+				offsetInBytes,
+				data,
+				elementCount * vertexStride,
+				options
+			);
+			return;
+		}
+
+		cmd = AllocDeferredCommand(
+			renderer,
+			data,
+			elementCount * vertexStride,
+			&dataCopy
+		);
+		cmd->type = FNA3D_COMMAND_SETVERTEXBUFFERDATA;
+		cmd->setVertexBufferData.buffer = buffer;
+		cmd->setVertexBufferData.offsetInBytes = offsetInBytes;
+		cmd->setVertexBufferData.data = dataCopy;
+		cmd->setVertexBufferData.elementCount = elementCount;
+		cmd->setVertexBufferData.elementSizeInBytes = elementSizeInBytes;
+		cmd->setVertexBufferData.vertexStride = vertexStride;
+		cmd->setVertexBufferData.options = options;
+		DeferToMainThread(renderer, cmd);
 		return;
 	}
 
+	WaitForBuffer(renderer, glBuffer, GL_ARRAY_BUFFER);
 	BindVertexBuffer(renderer, glBuffer->handle);
 
 	/* FIXME: Staging buffer for elementSizeInBytes < vertexStride! */
 
 	const GLsizeiptr dataLength = elementCount * vertexStride;
 
-	if (renderer->supports_ARB_map_buffer_range)
+	if (glBuffer->streamMapping != NULL)
+	{
+		if (OPENGL_INTERNAL_StreamBufferData(
+			renderer,
+			glBuffer,
+			GL_ARRAY_BUFFER,
+			offsetInBytes,
+			data,
+			dataLength,
+			options
+		)) {
+			if (renderer->perf.enabled)
+			{
+				FNA3D_PERF_ADD(renderer->perf, mapWrites, 1);
+				FNA3D_PERF_ADD(renderer->perf, mapBytes, dataLength);
+				FNA3D_PERF_ADD(renderer->perf, vertexUploadCalls, 1);
+				FNA3D_PERF_ADD(renderer->perf, vertexUploadBytes, dataLength);
+			}
+			return;
+		}
+	}
+	else if (renderer->supports_ARB_map_buffer_range)
 	{
 		GLbitfield mapFlags = GL_MAP_WRITE_BIT;
 
@@ -5060,16 +6367,12 @@ static void OPENGL_SetVertexBufferData(
 		{
 			SDL_memcpy(ptr, data, dataLength);
 			renderer->glUnmapBuffer(GL_ARRAY_BUFFER);
-            if (renderer->perfDiagnosticsEnabled)
+            if (renderer->perf.enabled)
             {
-                renderer->perfMapWrites += 1;
-                renderer->perfMapBytes += dataLength;
-                renderer->perfTotalMapWrites += 1;
-                renderer->perfTotalMapBytes += dataLength;
-                renderer->perfVertexUploadCalls += 1;
-                renderer->perfVertexUploadBytes += dataLength;
-                renderer->perfTotalVertexUploadCalls += 1;
-                renderer->perfTotalVertexUploadBytes += dataLength;
+                FNA3D_PERF_ADD(renderer->perf, mapWrites, 1);
+                FNA3D_PERF_ADD(renderer->perf, mapBytes, dataLength);
+                FNA3D_PERF_ADD(renderer->perf, vertexUploadCalls, 1);
+                FNA3D_PERF_ADD(renderer->perf, vertexUploadBytes, dataLength);
             }
 			return;
 		}
@@ -5089,20 +6392,133 @@ static void OPENGL_SetVertexBufferData(
 
 	renderer->glBufferSubData(
             GL_ARRAY_BUFFER,
-            (GLintptr) offsetInBytes,
+            glBuffer->streamOffset + (GLintptr) offsetInBytes,
             dataLength,
             data
 	);
-	if (renderer->perfDiagnosticsEnabled)
+	if (renderer->perf.enabled)
+	{
+		FNA3D_PERF_ADD(renderer->perf, subDataWrites, 1);
+		FNA3D_PERF_ADD(renderer->perf, subDataBytes, dataLength);
+		FNA3D_PERF_ADD(renderer->perf, vertexUploadCalls, 1);
+		FNA3D_PERF_ADD(renderer->perf, vertexUploadBytes, dataLength);
+	}
+}
+
+static void* OPENGL_MapVertexBufferRange(
+	FNA3D_Renderer *driverData,
+	FNA3D_Buffer *buffer,
+	int32_t offsetInBytes,
+	int32_t lengthInBytes,
+	FNA3D_SetDataOptions options
+) {
+	OpenGLRenderer *renderer = (OpenGLRenderer*) driverData;
+	OpenGLBuffer *glBuffer = (OpenGLBuffer*) buffer;
+	GLbitfield mapFlags = GL_MAP_WRITE_BIT;
+	uint8_t *result;
+
+	if (!FNA3D_MappedRange_Begin(
+		&renderer->mappedRange,
+		buffer,
+		offsetInBytes,
+		lengthInBytes,
+		options
+	)) {
+		return NULL;
+	}
+	renderer->mappedWithGL = 0;
+
+	/* Off-thread writes are deferred by SetVertexBufferData on unmap */
+	if (renderer->threadID != SDL_GetCurrentThreadID())
+	{
+		return FNA3D_MappedRange_GetScratch(&renderer->mappedRange);
+	}
+
+	WaitForBuffer(renderer, glBuffer, GL_ARRAY_BUFFER);
+
+	if (glBuffer->streamMapping != NULL)
+	{
+		/* Coherent, so there is nothing to do on unmap */
+		result = OPENGL_INTERNAL_StreamBufferRange(
+			renderer,
+			glBuffer,
+			GL_ARRAY_BUFFER,
+			offsetInBytes,
+			options
+		);
+		if (result != NULL)
+		{
+			return result;
+		}
+	}
+	else if (renderer->supports_ARB_map_buffer_range)
+	{
+		/* Same flags as SetVertexBufferData */
+		if (options == FNA3D_SETDATAOPTIONS_DISCARD)
+		{
+			mapFlags |= GL_MAP_INVALIDATE_BUFFER_BIT;
+		}
+		else if (options == FNA3D_SETDATAOPTIONS_NOOVERWRITE)
+		{
+			mapFlags |= GL_MAP_UNSYNCHRONIZED_BIT;
+		}
+
+		BindVertexBuffer(renderer, glBuffer->handle);
+		result = (uint8_t*) renderer->glMapBufferRange(
+			GL_ARRAY_BUFFER,
+			(GLintptr) offsetInBytes,
+			(GLsizeiptr) lengthInBytes,
+			mapFlags
+		);
+		if (result != NULL)
+		{
+			renderer->mappedWithGL = 1;
+			return result;
+		}
+	}
+
+	return FNA3D_MappedRange_GetScratch(&renderer->mappedRange);
+}
+
+static void OPENGL_UnmapVertexBufferRange(
+	FNA3D_Renderer *driverData,
+	FNA3D_Buffer *buffer
+) {
+	OpenGLRenderer *renderer = (OpenGLRenderer*) driverData;
+	OpenGLBuffer *glBuffer = (OpenGLBuffer*) buffer;
+	FNA3D_MappedRange *range = &renderer->mappedRange;
+
+	if (!FNA3D_MappedRange_End(range, buffer))
+	{
+		return;
+	}
+
+	if (range->usingScratch)
+	{
+		OPENGL_SetVertexBufferData(
+			driverData,
+			buffer,
+			range->offsetInBytes,
+			range->scratch,
+			range->lengthInBytes,
+			1,
+			1,
+			range->options
+		);
+		return;
+	}
+
+	if (renderer->mappedWithGL)
+	{
+		BindVertexBuffer(renderer, glBuffer->handle);
+		renderer->glUnmapBuffer(GL_ARRAY_BUFFER);
+	}
+	if (renderer->perf.enabled)
 	{
-		renderer->perfSubDataWrites += 1;
-		renderer->perfSubDataBytes += dataLength;
-		renderer->perfTotalSubDataWrites += 1;
-		renderer->perfTotalSubDataBytes += dataLength;
-		renderer->perfVertexUploadCalls += 1;
-		renderer->perfVertexUploadBytes += dataLength;
-		renderer->perfTotalVertexUploadCalls += 1;
-		renderer->perfTotalVertexUploadBytes += dataLength;
+		FNA3D_PERF_ADD(renderer->perf, mapWrites, 1);
+		FNA3D_PERF_ADD(renderer->perf, mapBytes, range->lengthInBytes);
+		FNA3D_PERF_ADD(renderer->perf, vertexUploadCalls, 1);
+		FNA3D_PERF_ADD(renderer->perf, vertexUploadBytes, range->lengthInBytes);
 	}
 }
 
@@ -5137,6 +6553,8 @@ static void OPENGL_GetVertexBufferData(
 		return;
 	}
 
+	WaitForBuffer(renderer, glBuffer, GL_ARRAY_BUFFER);
+
 	dataBytes = (uint8_t*) data;
 	useStagingBuffer = elementSizeInBytes < vertexStride;
 	if (useStagingBuffer)
@@ -5152,7 +6570,7 @@ static void OPENGL_GetVertexBufferData(
 
 	renderer->glGetBufferSubData(
 		GL_ARRAY_BUFFER,
-		(GLintptr) offsetInBytes,
+		glBuffer->streamOffset + (GLintptr) offsetInBytes,
 		(GLsizeiptr) (elementCount * vertexStride),
 		cpy
 	);
@@ -5200,15 +6618,34 @@ static FNA3D_Buffer* OPENGL_GenIndexBuffer(
 	result->handle = handle;
 	result->size = (intptr_t) sizeInBytes;
 	result->dynamic = (dynamic ? GL_STREAM_DRAW : GL_STATIC_DRAW);
+	result->streamMapping = NULL;
+	result->streamOffset = 0;
+	result->streamSlice = 0;
+	SDL_memset(result->streamFences, '\0', sizeof(result->streamFences));
+	SDL_SetAtomicInt(&result->uploadSerial, 0);
+	result->syncedSerial = 0;
 	result->next = NULL;
 
 	BindIndexBuffer(renderer, handle);
-	renderer->glBufferData(
-		GL_ELEMENT_ARRAY_BUFFER,
-		result->size,
-		NULL,
-		result->dynamic
-	);
+	if (dynamic && renderer->usePersistentStreaming)
+	{
+		OPENGL_INTERNAL_CreateStreamStorage(
+			renderer,
+			result,
+			GL_ELEMENT_ARRAY_BUFFER
+		);
+	}
+	if (result->streamMapping == NULL)
+	{
+		renderer->glBufferData(
+			GL_ELEMENT_ARRAY_BUFFER,
+			result->size,
+			NULL,
+			result->dynamic
+		);
+	}
+
+	MarkUploadDependency(renderer);
 
 	return (FNA3D_Buffer*) result;
 }
@@ -5217,11 +6654,18 @@ static void OPENGL_INTERNAL_DestroyIndexBuffer(
 	OpenGLRenderer *renderer,
 	OpenGLBuffer *buffer
 ) {
+	/* Don't let the name get recycled under a pending upload */
+	WaitForUpload(renderer, SDL_GetAtomicInt(&buffer->uploadSerial));
+
 	if (buffer->handle == renderer->currentIndexBuffer)
 	{
 		renderer->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 		renderer->currentIndexBuffer = 0;
 	}
+	if (buffer->streamMapping != NULL)
+	{
+		OPENGL_INTERNAL_DestroyStreamFences(renderer, buffer);
+	}
 	renderer->glDeleteBuffers(1, &buffer->handle);
 	SDL_free(buffer);
 }
@@ -5256,23 +6700,67 @@ static void OPENGL_SetIndexBufferData(
 ) {
 	OpenGLRenderer *renderer = (OpenGLRenderer*) driverData;
 	OpenGLBuffer *glBuffer = (OpenGLBuffer*) buffer;
-	FNA3D_Command cmd;
+	FNA3D_Command *cmd;
+	void *dataCopy;
 
 	if (renderer->threadID != SDL_GetCurrentThreadID())
 	{
-		cmd.type = FNA3D_COMMAND_SETINDEXBUFFERDATA;
-		cmd.setIndexBufferData.buffer = buffer;
-		cmd.setIndexBufferData.offsetInBytes = offsetInBytes;
-		cmd.setIndexBufferData.data = data;
-		cmd.setIndexBufferData.dataLength = dataLength;
-		cmd.setIndexBufferData.options = options;
-		ForceToMainThread(renderer, &cmd);
+		/* The streaming ring is only ever touched on this thread */
+		if (	renderer->uploadThread != NULL &&
+			glBuffer->streamMapping == NULL	)
+		{
+			QueueBufferUpload(
+				renderer,
+				glBuffer,
+				offsetInBytes,
+				data,
+				dataLength,
+				options
+			);
+			return;
+		}
+
+		cmd = AllocDeferredCommand(
+			renderer,
+			data,
+			dataLength,
+			&dataCopy
+		);
+		cmd->type = FNA3D_COMMAND_SETINDEXBUFFERDATA;
+		cmd->setIndexBufferData.buffer = buffer;
+		cmd->setIndexBufferData.offsetInBytes = offsetInBytes;
+		cmd->setIndexBufferData.data = dataCopy;
+		cmd->setIndexBufferData.dataLength = dataLength;
+		cmd->setIndexBufferData.options = options;
+		DeferToMainThread(renderer, cmd);
 		return;
 	}
 
+	WaitForBuffer(renderer, glBuffer, GL_ELEMENT_ARRAY_BUFFER);
 	BindIndexBuffer(renderer, glBuffer->handle);
 
-	if (renderer->supports_ARB_map_buffer_range)
+	if (glBuffer->streamMapping != NULL)
+	{
+		if (OPENGL_INTERNAL_StreamBufferData(
+			renderer,
+			glBuffer,
+			GL_ELEMENT_ARRAY_BUFFER,
+			offsetInBytes,
+			data,
+			(GLsizeiptr) dataLength,
+			options
+		)) {
+			if (renderer->perf.enabled)
+			{
+				FNA3D_PERF_ADD(renderer->perf, mapWrites, 1);
+				FNA3D_PERF_ADD(renderer->perf, mapBytes, dataLength);
+				FNA3D_PERF_ADD(renderer->perf, indexUploadCalls, 1);
+				FNA3D_PERF_ADD(renderer->perf, indexUploadBytes, dataLength);
+			}
+			return;
+		}
+	}
+	else if (renderer->supports_ARB_map_buffer_range)
 	{
 		GLbitfield mapFlags = GL_MAP_WRITE_BIT;
 
@@ -5298,16 +6786,12 @@ static void OPENGL_SetIndexBufferData(
 		{
 			SDL_memcpy(ptr, data, dataLength);
 			renderer->glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
-            if (renderer->perfDiagnosticsEnabled)
+            if (renderer->perf.enabled)
             {
-                renderer->perfMapWrites += 1;
-                renderer->perfMapBytes += dataLength;
-                renderer->perfTotalMapWrites += 1;
-                renderer->perfTotalMapBytes += dataLength;
-                renderer->perfIndexUploadCalls += 1;
-                renderer->perfIndexUploadBytes += dataLength;
-                renderer->perfTotalIndexUploadCalls += 1;
-                renderer->perfTotalIndexUploadBytes += dataLength;
+                FNA3D_PERF_ADD(renderer->perf, mapWrites, 1);
+                FNA3D_PERF_ADD(renderer->perf, mapBytes, dataLength);
+                FNA3D_PERF_ADD(renderer->perf, indexUploadCalls, 1);
+                FNA3D_PERF_ADD(renderer->perf, indexUploadBytes, dataLength);
             }
 			return;
 		}
@@ -5327,20 +6811,16 @@ static void OPENGL_SetIndexBufferData(
 
 	renderer->glBufferSubData(
 		GL_ELEMENT_ARRAY_BUFFER,
-		(GLintptr) offsetInBytes,
+		glBuffer->streamOffset + (GLintptr) offsetInBytes,
 		(GLsizeiptr) dataLength,
 		data
 	);
-	if (renderer->perfDiagnosticsEnabled)
+	if (renderer->perf.enabled)
 	{
-		renderer->perfSubDataWrites += 1;
-		renderer->perfSubDataBytes += dataLength;
-		renderer->perfTotalSubDataWrites += 1;
-		renderer->perfTotalSubDataBytes += dataLength;
-		renderer->perfIndexUploadCalls += 1;
-		renderer->perfIndexUploadBytes += dataLength;
-		renderer->perfTotalIndexUploadCalls += 1;
-		renderer->perfTotalIndexUploadBytes += dataLength;
+		FNA3D_PERF_ADD(renderer->perf, subDataWrites, 1);
+		FNA3D_PERF_ADD(renderer->perf, subDataBytes, dataLength);
+		FNA3D_PERF_ADD(renderer->perf, indexUploadCalls, 1);
+		FNA3D_PERF_ADD(renderer->perf, indexUploadBytes, dataLength);
 	}
 }
 
@@ -5368,11 +6848,13 @@ static void OPENGL_GetIndexBufferData(
 		return;
 	}
 
+	WaitForBuffer(renderer, glBuffer, GL_ELEMENT_ARRAY_BUFFER);
+
 	BindIndexBuffer(renderer, glBuffer->handle);
 
 	renderer->glGetBufferSubData(
 		GL_ELEMENT_ARRAY_BUFFER,
-		(GLintptr) offsetInBytes,
+		glBuffer->streamOffset + (GLintptr) offsetInBytes,
 		(GLsizeiptr) dataLength,
 		data
 	);
@@ -5563,6 +7045,14 @@ static void OPENGL_INTERNAL_DestroyEffect(
 	SDL_free(effect);
 }
 
+static void OPENGL_PrewarmPipelines(
+	FNA3D_Renderer *driverData,
+	FNA3D_PipelineManifest *manifest
+) {
+	/* No pipeline objects to prewarm, shaders are linked as they're used */
+	FNA3D_PipelineManifest_Destroy(manifest);
+}
+
 static void OPENGL_AddDisposeEffect(
 	FNA3D_Renderer *driverData,
 	FNA3D_Effect *effect
@@ -5605,10 +7095,9 @@ static void OPENGL_ApplyEffect(
 	const MOJOSHADER_effectTechnique *technique = fnaEffect->effect->current_technique;
 	uint32_t whatever;
 
-	if (renderer->perfDiagnosticsEnabled)
+	if (renderer->perf.enabled)
 	{
-		renderer->perfApplyEffectCalls += 1;
-		renderer->perfTotalApplyEffectCalls += 1;
+		FNA3D_PERF_ADD(renderer->perf, applyEffectCalls, 1);
 	}
 
 	renderer->effectApplied = 1;
@@ -5862,6 +7351,16 @@ static int32_t OPENGL_GetMaxMultiSampleCount(
 	return SDL_min(maxSamples, multiSampleCount);
 }
 
+/* Performance Counters */
+
+static void OPENGL_GetPerfCounters(
+	FNA3D_Renderer *driverData,
+	FNA3D_PerfCounters *counters
+) {
+	OpenGLRenderer *renderer = (OpenGLRenderer*) driverData;
+	FNA3D_PerfState_Get(&renderer->perf, counters);
+}
+
 /* Debugging */
 
 static void OPENGL_SetStringMarker(FNA3D_Renderer *driverData, const char *text)
@@ -5976,6 +7475,368 @@ static FNA3D_Texture* OPENGL_CreateSysTexture(
 	return (FNA3D_Texture*) result;
 }
 
+/* Upload Thread */
+
+static void OPENGL_INTERNAL_UploadTexture(
+	OpenGLRenderer *renderer,
+	FNA3D_Command *cmd
+) {
+	GLenum glFormat;
+	int32_t packSize;
+
+	renderer->glBindTexture(
+		cmd->uploadTexture.bindTarget,
+		cmd->uploadTexture.handle
+	);
+
+	/* Hand the data to the driver so it can DMA from the PBO while we
+	 * move on to the next upload, rather than stalling on the copy.
+	 */
+	renderer->glBindBuffer(
+		GL_PIXEL_UNPACK_BUFFER,
+		renderer->uploadPBOs[renderer->uploadPBOIndex]
+	);
+	renderer->uploadPBOIndex = (
+		(renderer->uploadPBOIndex + 1) % UPLOAD_PBO_COUNT
+	);
+	renderer->glBufferData(
+		GL_PIXEL_UNPACK_BUFFER,
+		cmd->uploadTexture.dataLength,
+		cmd->uploadTexture.data,
+		GL_STREAM_DRAW
+	);
+
+	glFormat = XNAToGL_TextureFormat[cmd->uploadTexture.format];
+	if (cmd->uploadTexture.bindTarget == GL_TEXTURE_3D)
+	{
+		renderer->glTexSubImage3D(
+			GL_TEXTURE_3D,
+			cmd->uploadTexture.level,
+			cmd->uploadTexture.x,
+			cmd->uploadTexture.y,
+			cmd->uploadTexture.z,
+			cmd->uploadTexture.w,
+			cmd->uploadTexture.h,
+			cmd->uploadTexture.d,
+			glFormat,
+			XNAToGL_TextureDataType[cmd->uploadTexture.format],
+			NULL
+		);
+	}
+	else if (glFormat == GL_COMPRESSED_TEXTURE_FORMATS)
+	{
+		renderer->glCompressedTexSubImage2D(
+			cmd->uploadTexture.imageTarget,
+			cmd->uploadTexture.level,
+			cmd->uploadTexture.x,
+			cmd->uploadTexture.y,
+			cmd->uploadTexture.w,
+			cmd->uploadTexture.h,
+			XNAToGL_TextureInternalFormat[cmd->uploadTexture.format],
+			cmd->uploadTexture.dataLength,
+			NULL
+		);
+	}
+	else
+	{
+		/* Set pixel alignment to match texel size in bytes. */
+		packSize = OPENGL_INTERNAL_Texture_GetPixelStoreAlignment(
+			cmd->uploadTexture.format
+		);
+		if (packSize != 4)
+		{
+			renderer->glPixelStorei(
+				GL_UNPACK_ALIGNMENT,
+				packSize
+			);
+		}
+
+		renderer->glTexSubImage2D(
+			cmd->uploadTexture.imageTarget,
+			cmd->uploadTexture.level,
+			cmd->uploadTexture.x,
+			cmd->uploadTexture.y,
+			cmd->uploadTexture.w,
+			cmd->uploadTexture.h,
+			glFormat,
+			XNAToGL_TextureDataType[cmd->uploadTexture.format],
+			NULL
+		);
+
+		if (packSize != 4)
+		{
+			renderer->glPixelStorei(
+				GL_UNPACK_ALIGNMENT,
+				4
+			);
+		}
+	}
+}
+
+static void OPENGL_INTERNAL_UploadBuffer(
+	OpenGLRenderer *renderer,
+	FNA3D_Command *cmd
+) {
+	renderer->glBindBuffer(GL_ARRAY_BUFFER, cmd->uploadBuffer.handle);
+	if (cmd->uploadBuffer.options == FNA3D_SETDATAOPTIONS_DISCARD)
+	{
+		renderer->glBufferData(
+			GL_ARRAY_BUFFER,
+			cmd->uploadBuffer.size,
+			NULL,
+			cmd->uploadBuffer.dynamic
+		);
+	}
+	renderer->glBufferSubData(
+		GL_ARRAY_BUFFER,
+		(GLintptr) cmd->uploadBuffer.offsetInBytes,
+		(GLsizeiptr) cmd->uploadBuffer.dataLength,
+		cmd->uploadBuffer.data
+	);
+}
+
+static void OPENGL_INTERNAL_RunUploads(OpenGLRenderer *renderer)
+{
+	FNA3D_Command *cmd, *next;
+	GLsync dependency, fence, old;
+	int32_t serial = 0;
+
+	cmd = TakeCommands(&renderer->uploadCommands);
+	if (cmd == NULL)
+	{
+		return;
+	}
+
+	TIMELINE_BEGIN("RunUploads")
+
+	/* Taken after the commands, so it covers every resource they use */
+	dependency = (GLsync) SDL_SetAtomicPointer(
+		&renderer->uploadDependency,
+		NULL
+	);
+	if (dependency != NULL)
+	{
+		renderer->glWaitSync(dependency, 0, GL_TIMEOUT_IGNORED);
+		renderer->glDeleteSync(dependency);
+	}
+
+	while (cmd != NULL)
+	{
+		if (cmd->type == FNA3D_COMMAND_UPLOADTEXTURE)
+		{
+			OPENGL_INTERNAL_UploadTexture(renderer, cmd);
+			serial = cmd->uploadTexture.serial;
+		}
+		else
+		{
+			OPENGL_INTERNAL_UploadBuffer(renderer, cmd);
+			serial = cmd->uploadBuffer.serial;
+		}
+		next = cmd->next;
+		ReleaseDeferredCommand(renderer, cmd);
+		cmd = next;
+	}
+	renderer->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	/* One fence per batch, serials are in submission order */
+	fence = renderer->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	renderer->glFlush();
+
+	SDL_LockMutex(renderer->uploadLock);
+	old = renderer->uploadFence;
+	renderer->uploadFence = fence;
+	renderer->uploadFenceSerial = serial;
+	SDL_BroadcastCondition(renderer->uploadDone);
+	SDL_UnlockMutex(renderer->uploadLock);
+
+	if (old != NULL)
+	{
+		renderer->glDeleteSync(old);
+	}
+	TIMELINE_END("RunUploads")
+}
+
+static int SDLCALL OPENGL_INTERNAL_UploadThread(void *data)
+{
+	OpenGLRenderer *renderer = (OpenGLRenderer*) data;
+	int32_t running;
+
+#ifdef USE_SDL3
+	if (!SDL_GL_MakeCurrent(renderer->uploadWindow, renderer->uploadContext))
+#else
+	if (SDL_GL_MakeCurrent(renderer->uploadWindow, renderer->uploadContext) < 0)
+#endif
+	{
+		FNA3D_LogWarn(
+			"Could not make upload context current: %s",
+			SDL_GetError()
+		);
+		SDL_SignalSemaphore(renderer->uploadStartup);
+		return 0;
+	}
+	renderer->glGenBuffers(UPLOAD_PBO_COUNT, renderer->uploadPBOs);
+
+	SDL_SetAtomicInt(&renderer->uploadRunning, 1);
+	SDL_SignalSemaphore(renderer->uploadStartup);
+
+	do
+	{
+		SDL_WaitSemaphore(renderer->uploadSignal);
+
+		/* Read this first so the last batch still gets flushed */
+		running = SDL_GetAtomicInt(&renderer->uploadRunning);
+		OPENGL_INTERNAL_RunUploads(renderer);
+	} while (running);
+
+	renderer->glDeleteBuffers(UPLOAD_PBO_COUNT, renderer->uploadPBOs);
+	renderer->glFinish();
+	SDL_GL_MakeCurrent(renderer->uploadWindow, NULL);
+	return 0;
+}
+
+static void OPENGL_INTERNAL_DestroyUploadObjects(OpenGLRenderer *renderer)
+{
+	if (renderer->uploadContext != NULL)
+	{
+#ifdef USE_SDL3
+		SDL_GL_DestroyContext(renderer->uploadContext);
+#else
+		SDL_GL_DeleteContext(renderer->uploadContext);
+#endif
+		renderer->uploadContext = NULL;
+	}
+	if (renderer->uploadWindow != NULL)
+	{
+		SDL_DestroyWindow(renderer->uploadWindow);
+		renderer->uploadWindow = NULL;
+	}
+	if (renderer->uploadSignal != NULL)
+	{
+		SDL_DestroySemaphore(renderer->uploadSignal);
+		renderer->uploadSignal = NULL;
+	}
+	if (renderer->uploadStartup != NULL)
+	{
+		SDL_DestroySemaphore(renderer->uploadStartup);
+		renderer->uploadStartup = NULL;
+	}
+	if (renderer->uploadLock != NULL)
+	{
+		SDL_DestroyMutex(renderer->uploadLock);
+		renderer->uploadLock = NULL;
+	}
+	if (renderer->uploadDone != NULL)
+	{
+		SDL_DestroyCondition(renderer->uploadDone);
+		renderer->uploadDone = NULL;
+	}
+}
+
+static void OPENGL_INTERNAL_StartUploadThread(
+	OpenGLRenderer *renderer,
+	SDL_Window *window
+) {
+	/* EGL won't let one surface be current on two threads, so the upload
+	 * context gets a hidden window of its own. Creating it with the
+	 * current attributes keeps the pixel format compatible for sharing.
+	 */
+#ifdef USE_SDL3
+	renderer->uploadWindow = SDL_CreateWindow(
+		"FNA3D Upload",
+		1,
+		1,
+		SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN
+	);
+#else
+	renderer->uploadWindow = SDL_CreateWindow(
+		"FNA3D Upload",
+		SDL_WINDOWPOS_UNDEFINED,
+		SDL_WINDOWPOS_UNDEFINED,
+		1,
+		1,
+		SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN
+	);
+#endif
+	if (renderer->uploadWindow != NULL)
+	{
+		SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+		renderer->uploadContext = SDL_GL_CreateContext(
+			renderer->uploadWindow
+		);
+		SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 0);
+
+		/* SDL makes the new context current, put ours back */
+		SDL_GL_MakeCurrent(window, renderer->context);
+	}
+	if (renderer->uploadContext == NULL)
+	{
+		FNA3D_LogWarn(
+			"Could not create upload context: %s",
+			SDL_GetError()
+		);
+		OPENGL_INTERNAL_DestroyUploadObjects(renderer);
+		return;
+	}
+
+	renderer->uploadSignal = SDL_CreateSemaphore(0);
+	renderer->uploadStartup = SDL_CreateSemaphore(0);
+	renderer->uploadLock = SDL_CreateMutex();
+	renderer->uploadDone = SDL_CreateCondition();
+	renderer->uploadThread = SDL_CreateThread(
+		OPENGL_INTERNAL_UploadThread,
+		"FNA3D_GLUpload",
+		renderer
+	);
+	if (renderer->uploadThread != NULL)
+	{
+		SDL_WaitSemaphore(renderer->uploadStartup);
+		if (!SDL_GetAtomicInt(&renderer->uploadRunning))
+		{
+			SDL_WaitThread(renderer->uploadThread, NULL);
+			renderer->uploadThread = NULL;
+		}
+	}
+	SDL_DestroySemaphore(renderer->uploadStartup);
+	renderer->uploadStartup = NULL;
+
+	if (renderer->uploadThread == NULL)
+	{
+		OPENGL_INTERNAL_DestroyUploadObjects(renderer);
+		return;
+	}
+	FNA3D_LogInfo("OpenGL upload thread enabled");
+}
+
+static void OPENGL_INTERNAL_StopUploadThread(OpenGLRenderer *renderer)
+{
+	GLsync dependency;
+
+	if (renderer->uploadThread == NULL)
+	{
+		return;
+	}
+
+	SDL_SetAtomicInt(&renderer->uploadRunning, 0);
+	SDL_SignalSemaphore(renderer->uploadSignal);
+	SDL_WaitThread(renderer->uploadThread, NULL);
+	renderer->uploadThread = NULL;
+
+	if (renderer->uploadFence != NULL)
+	{
+		renderer->glDeleteSync(renderer->uploadFence);
+		renderer->uploadFence = NULL;
+	}
+	dependency = (GLsync) SDL_SetAtomicPointer(
+		&renderer->uploadDependency,
+		NULL
+	);
+	if (dependency != NULL)
+	{
+		renderer->glDeleteSync(dependency);
+	}
+	OPENGL_INTERNAL_DestroyUploadObjects(renderer);
+}
+
 /* Load GL Entry Points */
 
 static inline void LoadEntryPoints(
@@ -6520,74 +8381,53 @@ FNA3D_Device* OPENGL_CreateDevice(
 		FNA3D_LogInfo("glMapBufferRange optimization disabled via FNA3D_OPENGL_USE_MAP_BUFFER_RANGE=0");
 	}
 
-	/* Runtime diagnostics for FPS overlay */
+	/* Persistent streaming needs immutable storage, fences and a
+	 * working glMapBufferRange. Some loaders hand out entry points for
+	 * anything, so check the extension string too.
+	 */
+	renderer->usePersistentStreaming = (
+		renderer->supports_ARB_map_buffer_range &&
+		renderer->supports_ARB_buffer_storage &&
+		renderer->supports_ARB_sync &&
+		(	SDL_GL_ExtensionSupported("GL_ARB_buffer_storage") ||
+			SDL_GL_ExtensionSupported("GL_EXT_buffer_storage")	)
+	);
+	if (renderer->usePersistentStreaming)
+	{
+		const char *persistentStreaming = SDL_getenv("FNA3D_OPENGL_USE_PERSISTENT_STREAMING");
+		const char *streamSlices = SDL_getenv("FNA3D_OPENGL_STREAM_SLICES");
+		if (persistentStreaming != NULL && SDL_strcmp(persistentStreaming, "0") == 0)
+		{
+			renderer->usePersistentStreaming = 0;
+			FNA3D_LogInfo("Persistent buffer streaming disabled via FNA3D_OPENGL_USE_PERSISTENT_STREAMING=0");
+		}
+		renderer->streamSliceCount = DEFAULT_STREAM_SLICES;
+		if (streamSlices != NULL)
+		{
+			renderer->streamSliceCount = SDL_max(
+				2,
+				SDL_min(SDL_atoi(streamSlices), MAX_STREAM_SLICES)
+			);
+		}
+	}
+	FNA3D_LogInfo(
+		"Dynamic buffer streaming: %s",
+		renderer->usePersistentStreaming ?
+			"Persistent ring (ARB_buffer_storage)" :
+			"Map/SubData"
+	);
+
+	/* Performance counters, RAL_GL_DIAGNOSTICS is the old spelling */
+	FNA3D_PerfState_Init(&renderer->perf);
 	{
 		const char *perfDiagnosticsStr = SDL_getenv("RAL_GL_DIAGNOSTICS");
-		renderer->perfDiagnosticsEnabled =
-			(perfDiagnosticsStr != NULL && SDL_strcmp(perfDiagnosticsStr, "1") == 0);
-		renderer->perfPublishTimestamp = 0;
-		renderer->perfMapWrites = 0;
-		renderer->perfMapBytes = 0;
-		renderer->perfSubDataWrites = 0;
-		renderer->perfSubDataBytes = 0;
-		renderer->perfDrawCalls = 0;
-		renderer->perfFrameCount = 0;
-		renderer->perfSwapWaitNs = 0;
-		renderer->perfSleepNs = 0;
-		renderer->perfDrawIndexedCalls = 0;
-		renderer->perfDrawInstancedCalls = 0;
-		renderer->perfDrawPrimitiveCalls = 0;
-		renderer->perfClearCalls = 0;
-		renderer->perfSetRenderTargetCalls = 0;
-		renderer->perfApplyEffectCalls = 0;
-		renderer->perfVertexUploadCalls = 0;
-		renderer->perfIndexUploadCalls = 0;
-		renderer->perfVertexUploadBytes = 0;
-		renderer->perfIndexUploadBytes = 0;
-		renderer->perfTotalMapWrites = 0;
-		renderer->perfTotalMapBytes = 0;
-		renderer->perfTotalSubDataWrites = 0;
-		renderer->perfTotalSubDataBytes = 0;
-		renderer->perfTotalDrawCalls = 0;
-		renderer->perfTotalFrameCount = 0;
-		renderer->perfTotalDrawIndexedCalls = 0;
-		renderer->perfTotalDrawInstancedCalls = 0;
-		renderer->perfTotalDrawPrimitiveCalls = 0;
-		renderer->perfTotalClearCalls = 0;
-		renderer->perfTotalSetRenderTargetCalls = 0;
-		renderer->perfTotalApplyEffectCalls = 0;
-		renderer->perfTotalVertexUploadCalls = 0;
-		renderer->perfTotalIndexUploadCalls = 0;
-		renderer->perfTotalVertexUploadBytes = 0;
-		renderer->perfTotalIndexUploadBytes = 0;
-
-		if (renderer->perfDiagnosticsEnabled)
-		{
-			SDL_setenv("RAL_GL_MAP_ENABLED", renderer->supports_ARB_map_buffer_range ? "1" : "0", 1);
-			SDL_setenv("RAL_GL_UPLOAD_PATH", renderer->supports_ARB_map_buffer_range ? "MapBufferRange" : "BufferSubData", 1);
-			SDL_setenv("RAL_GL_MAP_WRITES_S", "0", 1);
-			SDL_setenv("RAL_GL_SUBDATA_WRITES_S", "0", 1);
-			SDL_setenv("RAL_GL_DRAW_S", "0", 1);
-			SDL_setenv("RAL_GL_UPLOAD_MB_S", "0", 1);
-			SDL_setenv("RAL_GL_DRAWS_FRAME", "0", 1);
-			SDL_setenv("RAL_GL_FRAME_MS", "0", 1);
-			SDL_setenv("RAL_GL_SWAP_MS", "0", 1);
-			SDL_setenv("RAL_GL_SLEEP_MS", "0", 1);
-			SDL_setenv("RAL_GL_MAP_RATIO", renderer->supports_ARB_map_buffer_range ? "100" : "0", 1);
-			SDL_setenv("RAL_GL_DIAG", "Collecting...", 1);
-			SDL_setenv("RAL_GL_TIMING", "Collecting frame timing...", 1);
-			SDL_setenv("RAL_GL_COUNT_W", "Collecting window counts...", 1);
-			SDL_setenv("RAL_GL_UPLOAD_W", "Collecting window uploads...", 1);
-			SDL_setenv("RAL_GL_COUNT_T", "T D 0 CL 0 RT 0 FX 0", 1);
-			SDL_setenv("RAL_GL_UPLOAD_T", "T MAP 0 SUB 0 VB 0/0.0MB IB 0/0.0MB", 1);
-			SDL_setenv("RAL_GL_PATH", renderer->supports_ARB_map_buffer_range ?
-				"Path MapBufferRange (warming up)" :
-				"Path BufferSubData (warming up)", 1);
-			FNA3D_LogInfo("Runtime GL diagnostics enabled (RAL_GL_DIAGNOSTICS=1)");
-		}
-	}
-
-	/* Quality Settings - Read from environment variables */
+		if (perfDiagnosticsStr != NULL && SDL_strcmp(perfDiagnosticsStr, "1") == 0)
+		{
+			renderer->perf.enabled = 1;
+			renderer->perf.published.enabled = 1;
+		}
+	}
+
 	/* FNA3D_TEXTURE_LOD_BIAS: Additional LOD bias for textures (reduces texture quality, improves performance) */
 	const char *lodBiasStr = SDL_getenv("FNA3D_TEXTURE_LOD_BIAS");
 	if (lodBiasStr != NULL)
@@ -6643,29 +8483,81 @@ FNA3D_Device* OPENGL_CreateDevice(
 	}
 
 	/* FNA3D_TARGET_FPS: Frame rate limiting (0 = unlimited, 30, 45, 60, etc.) */
-	const char *targetFpsStr = SDL_getenv("FNA3D_TARGET_FPS");
-	if (targetFpsStr != NULL)
-	{
-		renderer->targetFps = SDL_atoi(targetFpsStr);
-		if (renderer->targetFps > 0)
-		{
-			renderer->targetFrameTime = 1000000000ULL / (uint64_t) renderer->targetFps;
-			FNA3D_LogInfo("Frame Rate Limit: %d FPS (%.2f ms/frame)", 
-				renderer->targetFps, 1000.0f / renderer->targetFps);
-		}
-		else
+	FNA3D_FramePacer_Init(
+		&renderer->pacer,
+		presentationParameters->deviceWindowHandle
+	);
+
+	/* FNA3D_RENDER_SCALE_DYNAMIC: Move the scale toward a frame budget,
+	 * with FNA3D_RENDER_SCALE as the ceiling
+	 */
+	renderer->renderScale = renderer->qualityRenderScale;
+	{
+		const char *dynamicStr = SDL_getenv("FNA3D_RENDER_SCALE_DYNAMIC");
+		const char *minStr = SDL_getenv("FNA3D_RENDER_SCALE_MIN");
+		const char *budgetStr = SDL_getenv("FNA3D_RENDER_SCALE_BUDGET_MS");
+		renderer->renderScaleDynamic = (
+			dynamicStr != NULL &&
+			SDL_strcmp(dynamicStr, "1") == 0 &&
+			renderer->supports_EXT_framebuffer_blit
+		);
+		if (renderer->renderScaleDynamic)
 		{
-			renderer->targetFps = 0;
-			renderer->targetFrameTime = 0;
-			FNA3D_LogInfo("Frame Rate Limit: Unlimited");
+			renderer->renderScaleMin = (minStr != NULL) ?
+				(float) SDL_atof(minStr) :
+				0.5f;
+			renderer->renderScaleMin = SDL_clamp(
+				renderer->renderScaleMin,
+				0.25f,
+				renderer->qualityRenderScale
+			);
+			if (budgetStr != NULL && SDL_atof(budgetStr) > 0.0)
+			{
+				renderer->renderScaleBudget = (uint64_t) (
+					SDL_atof(budgetStr) *
+					(double) SDL_GetPerformanceFrequency() /
+					1000.0
+				);
+			}
+			else if (renderer->pacer.mode != FNA3D_PACE_OFF)
+			{
+				renderer->renderScaleBudget = renderer->pacer.interval;
+			}
+			else
+			{
+				renderer->renderScaleBudget = SDL_GetPerformanceFrequency() / 60;
+			}
+			renderer->renderScaleCost = (double) renderer->renderScaleBudget;
+
+			/* GL_TIME_ELAPSED shares the occlusion query entry points */
+			renderer->supportsTimerQuery = (
+				!renderer->useES3 &&
+				renderer->supports_ARB_occlusion_query &&
+				SDL_GL_ExtensionSupported("GL_ARB_timer_query")
+			);
+			if (renderer->supportsTimerQuery)
+			{
+				renderer->glGenQueries(
+					RENDER_SCALE_QUERY_COUNT,
+					renderer->renderScaleQueries
+				);
+				renderer->glBeginQuery(
+					GL_TIME_ELAPSED,
+					renderer->renderScaleQueries[0]
+				);
+			}
+			renderer->renderScaleFrameStart = SDL_GetPerformanceCounter();
+
+			FNA3D_LogInfo(
+				"Dynamic Render Scale: %.2f-%.2f, %.2f ms budget, %s timing",
+				renderer->renderScaleMin,
+				renderer->qualityRenderScale,
+				(double) renderer->renderScaleBudget * 1000.0 /
+					(double) SDL_GetPerformanceFrequency(),
+				renderer->supportsTimerQuery ? "GPU" : "CPU"
+			);
 		}
 	}
-	else
-	{
-		renderer->targetFps = 0;
-		renderer->targetFrameTime = 0;
-	}
-	renderer->frameStartTime = 0;
 
 	/* Initialize shader context */
 	renderer->shaderProfile = SDL_GetHint("FNA3D_MOJOSHADER_PROFILE");
@@ -6869,7 +8761,6 @@ FNA3D_Device* OPENGL_CreateDevice(
 
 	/* The creation thread will be the "main" thread */
 	renderer->threadID = SDL_GetCurrentThreadID();
-	renderer->commandsLock = SDL_CreateMutex();
 	renderer->disposeTexturesLock = SDL_CreateMutex();
 	renderer->disposeRenderbuffersLock = SDL_CreateMutex();
 	renderer->disposeVertexBuffersLock = SDL_CreateMutex();
@@ -6877,6 +8768,26 @@ FNA3D_Device* OPENGL_CreateDevice(
 	renderer->disposeEffectsLock = SDL_CreateMutex();
 	renderer->disposeQueriesLock = SDL_CreateMutex();
 
+	/* Optional shared context for off-thread texture/buffer uploads */
+	{
+		const char *uploadThread = SDL_getenv("FNA3D_OPENGL_UPLOAD_THREAD");
+		if (	uploadThread != NULL &&
+			SDL_strcmp(uploadThread, "1") == 0	)
+		{
+			if (renderer->supports_ARB_sync)
+			{
+				OPENGL_INTERNAL_StartUploadThread(
+					renderer,
+					(SDL_Window*) presentationParameters->deviceWindowHandle
+				);
+			}
+			else
+			{
+				FNA3D_LogWarn("Upload thread requires ARB_sync, ignoring FNA3D_OPENGL_UPLOAD_THREAD");
+			}
+		}
+	}
+
 	/* Return the FNA3D_Device */
 	return result;
 }
@@ -42,6 +42,8 @@ typedef char		GLchar;
 typedef uintptr_t	GLsizeiptr;
 typedef intptr_t	GLintptr;
 typedef unsigned char	GLboolean;
+typedef uint64_t	GLuint64;
+typedef struct __GLsync	*GLsync;
 
 /* Hint */
 #define GL_DONT_CARE					0x1100
@@ -240,6 +242,25 @@ typedef unsigned char	GLboolean;
 #define GL_MAP_FLUSH_EXPLICIT_BIT			0x0010
 #define GL_MAP_UNSYNCHRONIZED_BIT			0x0020
 
+/* Persistent Streaming */
+#define GL_MAP_PERSISTENT_BIT				0x0040
+#define GL_MAP_COHERENT_BIT				0x0080
+#define GL_DYNAMIC_STORAGE_BIT				0x0100
+#define GL_SYNC_GPU_COMMANDS_COMPLETE			0x9117
+#define GL_SYNC_FLUSH_COMMANDS_BIT			0x00000001
+#define GL_ALREADY_SIGNALED				0x911A
+#define GL_TIMEOUT_EXPIRED				0x911B
+#define GL_CONDITION_SATISFIED				0x911C
+#define GL_WAIT_FAILED					0x911D
+#define GL_TIMEOUT_IGNORED				0xFFFFFFFFFFFFFFFFull
+
+/* Upload thread */
+#define GL_PIXEL_UNPACK_BUFFER				0x88EC
+
+/* Asynchronous readback */
+#define GL_PIXEL_PACK_BUFFER				0x88EB
+#define GL_STREAM_READ					0x88E1
+
 /* Render targets */
 #define GL_FRAMEBUFFER  				0x8D40
 #define GL_READ_FRAMEBUFFER				0x8CA8
@@ -258,6 +279,7 @@ typedef unsigned char	GLboolean;
 #define GL_QUERY_RESULT 				0x8866
 #define GL_QUERY_RESULT_AVAILABLE			0x8867
 #define GL_SAMPLES_PASSED				0x8914
+#define GL_TIME_ELAPSED					0x88BF
 
 /* Multisampling */
 #define GL_MULTISAMPLE  				0x809D
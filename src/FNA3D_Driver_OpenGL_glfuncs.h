@@ -39,6 +39,8 @@ GL_EXT(EXT_framebuffer_multisample)
 GL_EXT(ARB_internalformat_query)
 GL_EXT(ARB_invalidate_subdata)
 GL_EXT(ARB_map_buffer_range)
+GL_EXT(ARB_buffer_storage)
+GL_EXT(ARB_sync)
 GL_EXT(ARB_draw_instanced)
 GL_EXT(ARB_instanced_arrays)
 GL_EXT(ARB_draw_elements_base_vertex)
@@ -72,6 +74,8 @@ GL_PROC(BaseGL, void, glDrawBuffers, (GLsizei a, const GLenum *b))
 GL_PROC(BaseGL, void, glDrawRangeElements, (GLenum a, GLuint b, GLuint c, GLsizei d, GLenum e, const GLvoid *f))
 GL_PROC(BaseGL, void, glEnable, (GLenum a))
 GL_PROC(BaseGL, void, glEnableVertexAttribArray, (GLint a))
+GL_PROC(BaseGL, void, glFinish, (void))
+GL_PROC(BaseGL, void, glFlush, (void))
 GL_PROC(BaseGL, void, glFrontFace, (GLenum a))
 GL_PROC(BaseGL, void, glGenBuffers, (GLint a, GLuint *b))
 GL_PROC(BaseGL, void, glGenTextures, (GLsizei a, GLuint *b))
@@ -172,6 +176,13 @@ GL_PROC(ARB_texture_multisample, void, glSampleMaski, (GLuint a, GLuint b))
 /* Technically UnmapBuffer is core, but useless without MapBufferRange */
 GL_PROC_EXT(ARB_map_buffer_range, EXT, GLvoid*, glMapBufferRange, (GLenum a, GLintptr b, GLsizeiptr c, GLbitfield d))
 
+/* Persistent mappings let dynamic buffers stream without map/unmap churn */
+GL_PROC_EXT(ARB_buffer_storage, EXT, void, glBufferStorage, (GLenum a, GLsizeiptr b, const GLvoid *c, GLbitfield d))
+GL_PROC(ARB_sync, GLsync, glFenceSync, (GLenum a, GLbitfield b))
+GL_PROC(ARB_sync, GLenum, glClientWaitSync, (GLsync a, GLbitfield b, GLuint64 c))
+GL_PROC(ARB_sync, void, glDeleteSync, (GLsync a))
+GL_PROC(ARB_sync, void, glWaitSync, (GLsync a, GLbitfield b, GLuint64 c))
+
 /* "NOTE: when implemented in an OpenGL ES context, all entry points defined
  * by this extension must have a "KHR" suffix. When implemented in an
  * OpenGL context, all entry points must have NO suffix, as shown below."
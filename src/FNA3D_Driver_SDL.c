@@ -30,6 +30,7 @@
 
 #include "FNA3D_Driver.h"
 #include "FNA3D_PipelineCache.h"
+#include "FNA3D_PipelineManifest.h"
 
 #define MAX_FRAMES_IN_FLIGHT 3
 #define MAX_UPLOAD_CYCLE_COUNT 4
@@ -43,6 +44,9 @@
 #define TRANSFER_BUFFER_SIZE 16777216 /* 16 MiB */
 #endif
 
+/* Idle pooled transfer buffers are released once the pool is bigger than this */
+#define TRANSFER_POOL_BUDGET (TRANSFER_BUFFER_SIZE * 8)
+
 static inline SDL_GPUSampleCount XNAToSDL_SampleCount(int32_t sampleCount)
 {
 	if (sampleCount <= 1)
@@ -352,71 +356,30 @@ typedef struct SDLGPU_BufferHandle /* Cast from FNA3D_Buffer* */
 	uint32_t size;
 } SDLGPU_BufferHandle;
 
-typedef struct SamplerStateHashMap
-{
-	PackedState key;
-	SDL_GPUSampler *value;
-} SamplerStateHashMap;
-
-typedef struct SamplerStateHashArray
-{
-	SamplerStateHashMap *elements;
-	int32_t count;
-	int32_t capacity;
-} SamplerStateHashArray;
-
-static inline SDL_GPUSampler* SamplerStateHashArray_Fetch(
-	SamplerStateHashArray *arr,
-	PackedState key
-) {
-	int32_t i;
-
-	for (i = 0; i < arr->count; i += 1)
-	{
-		if (	key.a == arr->elements[i].key.a &&
-			key.b == arr->elements[i].key.b		)
-		{
-			return arr->elements[i].value;
-		}
-	}
-
-	return NULL;
-}
-
-static inline void SamplerStateHashArray_Insert(
-	SamplerStateHashArray *arr,
-	PackedState key,
-	SDL_GPUSampler *value
-) {
-	SamplerStateHashMap map;
-	map.key.a = key.a;
-	map.key.b = key.b;
-	map.value = value;
-
-	EXPAND_ARRAY_IF_NEEDED(arr, 4, SamplerStateHashMap)
-
-	arr->elements[arr->count] = map;
-	arr->count += 1;
-}
-
-/* FIXME: This could be packed better */
+/* Compared with memcmp and hashed as 64-bit words, so there must be no padding:
+ * widest fields first, and the byte fields fill out the last word exactly.
+ */
 typedef struct GraphicsPipelineHash
 {
 	PackedState blendState;
 	PackedState rasterizerState;
 	PackedState depthStencilState;
-	uint32_t vertexBufferBindingsIndex;
-	FNA3D_PrimitiveType primitiveType;
-	SDL_GPUSampleCount sampleCount;
-	uint32_t sampleMask;
 	SDL_GPUShader *vertShader;
 	SDL_GPUShader *fragShader;
-	SDL_GPUTextureFormat colorFormats[MAX_RENDERTARGET_BINDINGS];
-	uint32_t colorFormatCount;
-	bool hasDepthStencilAttachment;
-	SDL_GPUTextureFormat depthStencilFormat;
+	uint32_t vertexBufferBindingsIndex;
+	uint32_t sampleMask;
+	uint8_t colorFormats[MAX_RENDERTARGET_BINDINGS]; /* SDL_GPUTextureFormat */
+	uint8_t depthStencilFormat; /* SDL_GPU_TEXTUREFORMAT_INVALID if none */
+	uint8_t primitiveType; /* FNA3D_PrimitiveType */
+	uint8_t sampleCount; /* SDL_GPUSampleCount */
+	uint8_t colorFormatCount;
 } GraphicsPipelineHash;
 
+SDL_COMPILE_TIME_ASSERT(
+	GraphicsPipelineHashPadding,
+	(sizeof(GraphicsPipelineHash) % sizeof(uint64_t)) == 0
+);
+
 typedef struct GraphicsPipelineHashMap
 {
 	GraphicsPipelineHash key;
@@ -435,69 +398,67 @@ typedef struct GraphicsPipelineHashArray
 typedef struct GraphicsPipelineHashTable
 {
 	GraphicsPipelineHashArray buckets[NUM_PIPELINE_HASH_BUCKETS];
+
+	/* Consecutive draws almost always reuse the last pipeline */
+	GraphicsPipelineHash lastKey;
+	SDL_GPUGraphicsPipeline *lastValue;
 } GraphicsPipelineHashTable;
 
-static inline uint64_t GraphicsPipelineHashTable_GetHashCode(GraphicsPipelineHash hash)
-{
-	/* The algorithm for this hashing function
-	 * is taken from Josh Bloch's "Effective Java".
-	 * (https://stackoverflow.com/a/113600/12492383)
+static inline uint8_t GraphicsPipelineHash_Equals(
+	const GraphicsPipelineHash *a,
+	const GraphicsPipelineHash *b
+) {
+	return SDL_memcmp(a, b, sizeof(GraphicsPipelineHash)) == 0;
+}
+
+static inline uint64_t GraphicsPipelineHashTable_GetHashCode(
+	const GraphicsPipelineHash *hash
+) {
+	/* One xxHash64 round per word, then the 64-bit finalizer from
+	 * MurmurHash3, same as PackedState_Hash.
 	 */
-	const uint64_t HASH_FACTOR = 97;
-	uint32_t i;
-	uint64_t result = 1;
-	result = result * HASH_FACTOR + hash.blendState.a;
-	result = result * HASH_FACTOR + hash.blendState.b;
-	result = result * HASH_FACTOR + hash.rasterizerState.a;
-	result = result * HASH_FACTOR + hash.rasterizerState.b;
-	result = result * HASH_FACTOR + hash.depthStencilState.a;
-	result = result * HASH_FACTOR + hash.depthStencilState.b;
-	result = result * HASH_FACTOR + hash.vertexBufferBindingsIndex;
-	result = result * HASH_FACTOR + hash.primitiveType;
-	result = result * HASH_FACTOR + hash.sampleCount;
-	result = result * HASH_FACTOR + hash.sampleMask;
-	result = result * HASH_FACTOR + (uint64_t) (size_t) hash.vertShader;
-	result = result * HASH_FACTOR + (uint64_t) (size_t) hash.fragShader;
-	result = result * HASH_FACTOR + hash.colorFormatCount;
-	for (i = 0; i < MAX_RENDERTARGET_BINDINGS; i += 1)
-	{
-		result = result * HASH_FACTOR + hash.colorFormats[i];
-	}
-	result = result * HASH_FACTOR + hash.hasDepthStencilAttachment;
-	result = result * HASH_FACTOR + hash.depthStencilFormat;
+	const uint8_t *bytes = (const uint8_t*) hash;
+	uint64_t result = 0x27D4EB2F165667C5ULL + sizeof(GraphicsPipelineHash);
+	uint64_t word;
+	size_t i;
+	for (i = 0; i < sizeof(GraphicsPipelineHash); i += sizeof(uint64_t))
+	{
+		SDL_memcpy(&word, bytes + i, sizeof(uint64_t));
+		result ^= word * 0xC2B2AE3D27D4EB4FULL;
+		result = (result << 31) | (result >> 33);
+		result *= 0x9E3779B97F4A7C15ULL;
+	}
+	result ^= result >> 33;
+	result *= 0xFF51AFD7ED558CCDULL;
+	result ^= result >> 33;
+	result *= 0xC4CEB9FE1A85EC53ULL;
+	result ^= result >> 33;
 	return result;
 }
 
 static inline SDL_GPUGraphicsPipeline *GraphicsPipelineHashTable_Fetch(
 	GraphicsPipelineHashTable *table,
-	GraphicsPipelineHash key
+	const GraphicsPipelineHash *key
 ) {
 	int32_t i;
-	uint64_t hashcode = GraphicsPipelineHashTable_GetHashCode(key);
-	GraphicsPipelineHashArray *arr = &table->buckets[hashcode % NUM_PIPELINE_HASH_BUCKETS];
+	uint64_t hashcode;
+	GraphicsPipelineHashArray *arr;
+
+	if (	table->lastValue != NULL &&
+		GraphicsPipelineHash_Equals(key, &table->lastKey)	)
+	{
+		return table->lastValue;
+	}
+
+	hashcode = GraphicsPipelineHashTable_GetHashCode(key);
+	arr = &table->buckets[hashcode % NUM_PIPELINE_HASH_BUCKETS];
 
 	for (i = 0; i < arr->count; i += 1)
 	{
-		const GraphicsPipelineHash *e = &arr->elements[i].key;
-		if (	key.blendState.a == e->blendState.a &&
-			key.blendState.b == e->blendState.b &&
-			key.rasterizerState.a == e->rasterizerState.a &&
-			key.rasterizerState.b == e->rasterizerState.b &&
-			key.depthStencilState.a == e->depthStencilState.a &&
-			key.depthStencilState.b == e->depthStencilState.b &&
-			key.vertexBufferBindingsIndex == e->vertexBufferBindingsIndex &&
-			key.primitiveType == e->primitiveType &&
-			key.sampleMask == e->sampleMask &&
-			key.vertShader == e->vertShader &&
-			key.fragShader == e->fragShader &&
-			key.colorFormatCount == e->colorFormatCount &&
-			key.colorFormats[0] == e->colorFormats[0] &&
-			key.colorFormats[1] == e->colorFormats[1] &&
-			key.colorFormats[2] == e->colorFormats[2] &&
-			key.colorFormats[3] == e->colorFormats[3] &&
-			key.hasDepthStencilAttachment == e->hasDepthStencilAttachment &&
-			key.depthStencilFormat == e->depthStencilFormat )
+		if (GraphicsPipelineHash_Equals(key, &arr->elements[i].key))
 		{
+			table->lastKey = *key;
+			table->lastValue = arr->elements[i].value;
 			return arr->elements[i].value;
 		}
 	}
@@ -507,13 +468,13 @@ static inline SDL_GPUGraphicsPipeline *GraphicsPipelineHashTable_Fetch(
 
 static inline void GraphicsPipelineHashTable_Insert(
 	GraphicsPipelineHashTable *table,
-	GraphicsPipelineHash key,
+	const GraphicsPipelineHash *key,
 	SDL_GPUGraphicsPipeline *value
 ) {
 	uint64_t hashcode = GraphicsPipelineHashTable_GetHashCode(key);
 	GraphicsPipelineHashArray *arr = &table->buckets[hashcode % NUM_PIPELINE_HASH_BUCKETS];
 	GraphicsPipelineHashMap map;
-	map.key = key;
+	map.key = *key;
 	map.value = value;
 
 	EXPAND_ARRAY_IF_NEEDED(arr, 2, GraphicsPipelineHashMap)
@@ -522,6 +483,51 @@ static inline void GraphicsPipelineHashTable_Insert(
 	arr->count += 1;
 }
 
+/* Buffer upload space reserved by BeginBufferUpload */
+typedef struct SDLGPU_BufferUpload
+{
+	SDL_GPUTransferBuffer *transferBuffer;
+	uint32_t transferOffset;
+	uint32_t dataLength;
+	bool pooled;
+} SDLGPU_BufferUpload;
+
+/* Uploads too big for the upload rings get a transfer buffer of their own.
+ * These are pooled by size tier (the ring size times a power of two) and
+ * reused once the upload command buffer that last read them has finished.
+ */
+typedef enum SDLGPU_PooledTransferState
+{
+	POOLED_TRANSFER_IDLE,
+	POOLED_TRANSFER_PENDING,	/* Read by the current upload command buffer */
+	POOLED_TRANSFER_SUBMITTED	/* Waiting on fence, or on a stall if NULL */
+} SDLGPU_PooledTransferState;
+
+typedef struct SDLGPU_PooledTransferBuffer
+{
+	SDL_GPUTransferBuffer *transferBuffer;
+	uint32_t size;
+	SDLGPU_PooledTransferState state;
+	SDL_GPUFence *fence;
+} SDLGPU_PooledTransferBuffer;
+
+/* See FNA3D_RequestTextureDataAsync */
+typedef struct SDLGPU_Readback
+{
+	FNA3D_Readback base;
+	SDL_GPUTransferBuffer *transferBuffer;
+	SDL_GPUFence *fence;
+} SDLGPU_Readback;
+
+typedef struct SDLGPU_TransferPool
+{
+	SDLGPU_PooledTransferBuffer *elements;
+	int32_t count;
+	int32_t capacity;
+	int32_t pendingCount;
+	uint64_t liveBytes;
+} SDLGPU_TransferPool;
+
 typedef struct SDLGPU_Renderer
 {
 	SDL_GPUDevice *device;
@@ -617,6 +623,12 @@ typedef struct SDLGPU_Renderer
 	uint32_t bufferUploadBufferOffset;
 	uint32_t bufferUploadCycleCount;
 
+	SDLGPU_TransferPool transferPool;
+
+	/* See FNA3D_MapVertexBufferRange */
+	FNA3D_MappedRange mappedRange;
+	SDLGPU_BufferUpload mappedUpload;
+
 	/* RT tracking to reduce unnecessary cycling */
 
 	SDLGPU_TextureHandle **boundRenderTargets;
@@ -626,7 +638,16 @@ typedef struct SDLGPU_Renderer
 	/* Hashing */
 
 	GraphicsPipelineHashTable graphicsPipelineHashTable;
-	SamplerStateHashArray samplerStateArray;
+	PackedStateHashTable samplerStateTable;
+
+	/* Background pipeline compilation, see FNA3D_PrewarmPipelines */
+
+	FNA3D_PipelineManifest *pipelineManifest;
+	FNA3D_PipelineCompiler *pipelineCompiler; /* Created on first use */
+	struct SDLGPU_PipelineJob **pipelineJobs; /* Submitted, not yet published */
+	int32_t pipelineJobsInFlight;
+	int32_t pipelineJobsCapacity;
+	uint8_t asyncPipelines; /* Misses skip the draw rather than stall */
 
 	/* MOJOSHADER */
 
@@ -659,6 +680,13 @@ typedef struct SDLGPU_Renderer
 	uint8_t supportsD24;
 	uint8_t supportsD24S8;
 
+	/* Performance counters, see FNA3D_GetPerfCounters */
+
+	FNA3D_PerfState perf;
+
+	/* Frame rate limiting, see FNA3D_FramePacer_Init */
+	FNA3D_FramePacer pacer;
+
 } SDLGPU_Renderer;
 
 /* Format Conversion */
@@ -685,6 +713,191 @@ static inline SDL_GPUTextureFormat XNAToSDL_DepthFormat(
 	}
 }
 
+/* Background Pipeline Compilation */
+
+/* Everything needed to build one graphics pipeline. Draws fill one of these on
+ * the stack, prewarming and async misses hand them to the background compiler.
+ */
+typedef struct SDLGPU_PipelineJob
+{
+	FNA3D_PipelineCompileJob job; /* Must be first! */
+
+	/* Filled by the caller, along with everything in hash but the packed
+	 * states and shaders. The depth bias is already scaled.
+	 */
+	FNA3D_BlendState blendState;
+	FNA3D_DepthStencilState depthStencilState;
+	FNA3D_RasterizerState rasterizerState;
+	GraphicsPipelineHash hash;
+
+	SDL_GPUGraphicsPipelineCreateInfo createInfo;
+	SDL_GPUColorTargetDescription colorAttachmentDescriptions[MAX_RENDERTARGET_BINDINGS];
+	SDL_GPUVertexBufferDescription vertexBindings[MAX_BOUND_VERTEX_BUFFERS];
+	SDL_GPUVertexAttribute vertexAttributes[MAX_BOUND_VERTEX_BUFFERS * MAX_VERTEX_ATTRIBUTES];
+
+	/* Background only, the shader references are held until the job is drained */
+	MOJOSHADER_sdlShaderData *vertShaderData;
+	MOJOSHADER_sdlShaderData *fragShaderData;
+	SDL_GPUGraphicsPipeline *pipeline;
+	int32_t inFlightIndex; /* Into renderer->pipelineJobs */
+} SDLGPU_PipelineJob;
+
+static void SDLGPU_INTERNAL_CompilePipelineJob(
+	void *userdata,
+	FNA3D_PipelineCompileJob *compileJob
+) {
+	SDLGPU_Renderer *renderer = (SDLGPU_Renderer*) userdata;
+	SDLGPU_PipelineJob *job = (SDLGPU_PipelineJob*) compileJob;
+
+	job->pipeline = SDL_CreateGPUGraphicsPipeline(
+		renderer->device,
+		&job->createInfo
+	);
+}
+
+static FNA3D_PipelineCompiler* SDLGPU_INTERNAL_GetPipelineCompiler(
+	SDLGPU_Renderer *renderer
+) {
+	if (renderer->pipelineCompiler == NULL)
+	{
+		renderer->pipelineCompiler = FNA3D_PipelineCompiler_Create(
+			SDLGPU_INTERNAL_CompilePipelineJob,
+			renderer
+		);
+	}
+	return renderer->pipelineCompiler;
+}
+
+/* The job must be filled, with both shader references taken */
+static void SDLGPU_INTERNAL_SubmitPipelineJob(
+	SDLGPU_Renderer *renderer,
+	SDLGPU_PipelineJob *job,
+	uint8_t urgent
+) {
+	if (renderer->pipelineJobsInFlight == renderer->pipelineJobsCapacity)
+	{
+		renderer->pipelineJobsCapacity = SDL_max(
+			16,
+			renderer->pipelineJobsCapacity * 2
+		);
+		renderer->pipelineJobs = SDL_realloc(
+			renderer->pipelineJobs,
+			sizeof(SDLGPU_PipelineJob*) * renderer->pipelineJobsCapacity
+		);
+	}
+	job->pipeline = NULL;
+	job->inFlightIndex = renderer->pipelineJobsInFlight;
+	renderer->pipelineJobs[renderer->pipelineJobsInFlight] = job;
+	renderer->pipelineJobsInFlight += 1;
+
+	FNA3D_PipelineCompiler_Submit(
+		renderer->pipelineCompiler,
+		&job->job,
+		urgent
+	);
+}
+
+static SDLGPU_PipelineJob* SDLGPU_INTERNAL_FindPipelineJob(
+	SDLGPU_Renderer *renderer,
+	const GraphicsPipelineHash *hash
+) {
+	int32_t i;
+	for (i = 0; i < renderer->pipelineJobsInFlight; i += 1)
+	{
+		if (GraphicsPipelineHash_Equals(hash, &renderer->pipelineJobs[i]->hash))
+		{
+			return renderer->pipelineJobs[i];
+		}
+	}
+	return NULL;
+}
+
+static void SDLGPU_INTERNAL_PublishPipelineJobs(
+	SDLGPU_Renderer *renderer,
+	FNA3D_PipelineCompileJob *finished
+) {
+	SDLGPU_PipelineJob *job, *last;
+
+	while (finished != NULL)
+	{
+		job = (SDLGPU_PipelineJob*) finished;
+		finished = finished->next;
+
+		if (job->pipeline == NULL)
+		{
+			FNA3D_LogWarn("Failed to create graphics pipeline in the background!");
+		}
+		else if (GraphicsPipelineHashTable_Fetch(
+			&renderer->graphicsPipelineHashTable,
+			&job->hash
+		) != NULL) {
+			/* A draw needed it before we were done */
+			SDL_ReleaseGPUGraphicsPipeline(
+				renderer->device,
+				job->pipeline
+			);
+		}
+		else
+		{
+			GraphicsPipelineHashTable_Insert(
+				&renderer->graphicsPipelineHashTable,
+				&job->hash,
+				job->pipeline
+			);
+		}
+
+		MOJOSHADER_sdlDeleteShader(
+			renderer->mojoshaderContext,
+			job->vertShaderData
+		);
+		MOJOSHADER_sdlDeleteShader(
+			renderer->mojoshaderContext,
+			job->fragShaderData
+		);
+
+		/* Swap the last job in flight into this one's slot */
+		last = renderer->pipelineJobs[renderer->pipelineJobsInFlight - 1];
+		last->inFlightIndex = job->inFlightIndex;
+		renderer->pipelineJobs[job->inFlightIndex] = last;
+		renderer->pipelineJobsInFlight -= 1;
+		SDL_free(job);
+	}
+}
+
+static inline void SDLGPU_INTERNAL_DrainPipelineJobs(
+	SDLGPU_Renderer *renderer
+) {
+	if (renderer->pipelineJobsInFlight > 0)
+	{
+		SDLGPU_INTERNAL_PublishPipelineJobs(
+			renderer,
+			FNA3D_PipelineCompiler_Drain(renderer->pipelineCompiler)
+		);
+	}
+}
+
+/* Blocks until the job is published, returns its pipeline (NULL on failure) */
+static SDL_GPUGraphicsPipeline* SDLGPU_INTERNAL_WaitForPipelineJob(
+	SDLGPU_Renderer *renderer,
+	SDLGPU_PipelineJob *job
+) {
+	GraphicsPipelineHash hash = job->hash; /* job is freed when published */
+
+	FNA3D_PipelineCompiler_Prioritize(renderer->pipelineCompiler, &job->job);
+	do
+	{
+		SDLGPU_INTERNAL_PublishPipelineJobs(
+			renderer,
+			FNA3D_PipelineCompiler_Wait(renderer->pipelineCompiler)
+		);
+	} while (SDLGPU_INTERNAL_FindPipelineJob(renderer, &hash) != NULL);
+
+	return GraphicsPipelineHashTable_Fetch(
+		&renderer->graphicsPipelineHashTable,
+		&hash
+	);
+}
+
 /* Submission / Presentation */
 
 static void SDLGPU_INTERNAL_BeginCopyPass(
@@ -944,6 +1157,195 @@ static void SDLGPU_INTERNAL_BeginRenderPass(
 	renderer->needNewGraphicsPipeline = 1;
 }
 
+/* Transfer Buffer Pool, callers hold copyPassMutex */
+
+static void SDLGPU_INTERNAL_RetireTransferFence(
+	SDLGPU_Renderer *renderer,
+	SDL_GPUFence *fence
+) {
+	SDLGPU_TransferPool *pool = &renderer->transferPool;
+	int32_t i;
+
+	/* Every buffer submitted with this fence is free to reuse */
+	for (i = 0; i < pool->count; i += 1)
+	{
+		if (	pool->elements[i].state == POOLED_TRANSFER_SUBMITTED &&
+			pool->elements[i].fence == fence	)
+		{
+			pool->elements[i].state = POOLED_TRANSFER_IDLE;
+			pool->elements[i].fence = NULL;
+		}
+	}
+
+	if (fence != NULL)
+	{
+		SDL_ReleaseGPUFence(renderer->device, fence);
+	}
+}
+
+static void SDLGPU_INTERNAL_RecycleTransferBuffers(
+	SDLGPU_Renderer *renderer
+) {
+	SDLGPU_TransferPool *pool = &renderer->transferPool;
+	SDLGPU_PooledTransferBuffer *entry;
+	int32_t i;
+
+	for (i = 0; i < pool->count; i += 1)
+	{
+		entry = &pool->elements[i];
+		if (	entry->state == POOLED_TRANSFER_SUBMITTED &&
+			entry->fence != NULL &&
+			SDL_QueryGPUFence(renderer->device, entry->fence)	)
+		{
+			SDLGPU_INTERNAL_RetireTransferFence(renderer, entry->fence);
+		}
+	}
+
+	/* Give idle buffers back until we're under budget again */
+	for (i = pool->count - 1; i >= 0; i -= 1)
+	{
+		if (pool->liveBytes <= TRANSFER_POOL_BUDGET)
+		{
+			break;
+		}
+		entry = &pool->elements[i];
+		if (entry->state != POOLED_TRANSFER_IDLE)
+		{
+			continue;
+		}
+		SDL_ReleaseGPUTransferBuffer(renderer->device, entry->transferBuffer);
+		pool->liveBytes -= entry->size;
+		pool->count -= 1;
+		*entry = pool->elements[pool->count];
+	}
+}
+
+static SDL_GPUTransferBuffer* SDLGPU_INTERNAL_AcquirePooledTransferBuffer(
+	SDLGPU_Renderer *renderer,
+	uint32_t dataLength
+) {
+	SDLGPU_TransferPool *pool = &renderer->transferPool;
+	SDLGPU_PooledTransferBuffer *entry;
+	SDL_GPUTransferBufferCreateInfo transferBufferCreateInfo;
+	SDL_GPUTransferBuffer *transferBuffer;
+	uint32_t size = TRANSFER_BUFFER_SIZE;
+	int32_t i;
+
+	while (size < dataLength && size <= (SDL_MAX_UINT32 / 2))
+	{
+		size *= 2;
+	}
+	if (size < dataLength)
+	{
+		/* Larger than the biggest tier, never shared with anything else */
+		size = dataLength;
+	}
+
+	SDLGPU_INTERNAL_RecycleTransferBuffers(renderer);
+
+	for (i = 0; i < pool->count; i += 1)
+	{
+		entry = &pool->elements[i];
+		if (entry->state == POOLED_TRANSFER_IDLE && entry->size == size)
+		{
+			entry->state = POOLED_TRANSFER_PENDING;
+			pool->pendingCount += 1;
+			if (renderer->perf.enabled)
+			{
+				FNA3D_PERF_ADD(renderer->perf, transferPoolHits, 1);
+				FNA3D_PERF_MAX(renderer->perf, transferPoolPeakBytes, pool->liveBytes);
+			}
+			return entry->transferBuffer;
+		}
+	}
+
+	transferBufferCreateInfo.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD;
+	transferBufferCreateInfo.size = size;
+	transferBufferCreateInfo.props = 0;
+	transferBuffer = SDL_CreateGPUTransferBuffer(
+		renderer->device,
+		&transferBufferCreateInfo
+	);
+	if (transferBuffer == NULL)
+	{
+		FNA3D_LogError(
+			"Failed to create pooled transfer buffer: %s",
+			SDL_GetError()
+		);
+		return NULL;
+	}
+
+	EXPAND_ARRAY_IF_NEEDED(pool, 4, SDLGPU_PooledTransferBuffer)
+	entry = &pool->elements[pool->count];
+	entry->transferBuffer = transferBuffer;
+	entry->size = size;
+	entry->state = POOLED_TRANSFER_PENDING;
+	entry->fence = NULL;
+	pool->count += 1;
+	pool->pendingCount += 1;
+	pool->liveBytes += size;
+
+	if (renderer->perf.enabled)
+	{
+		FNA3D_PERF_ADD(renderer->perf, transferPoolMisses, 1);
+		FNA3D_PERF_MAX(renderer->perf, transferPoolPeakBytes, pool->liveBytes);
+	}
+	return transferBuffer;
+}
+
+static void SDLGPU_INTERNAL_SubmitPooledTransferBuffers(
+	SDLGPU_Renderer *renderer,
+	SDL_GPUFence *fence
+) {
+	SDLGPU_TransferPool *pool = &renderer->transferPool;
+	int32_t i;
+
+	for (i = 0; i < pool->count; i += 1)
+	{
+		if (pool->elements[i].state == POOLED_TRANSFER_PENDING)
+		{
+			pool->elements[i].state = POOLED_TRANSFER_SUBMITTED;
+			pool->elements[i].fence = fence;
+		}
+	}
+	pool->pendingCount = 0;
+}
+
+/* For after a stall on the upload fence, which nobody else can query */
+static void SDLGPU_INTERNAL_CompleteStalledTransferBuffers(
+	SDLGPU_Renderer *renderer
+) {
+	SDL_LockMutex(renderer->copyPassMutex);
+	SDLGPU_INTERNAL_RetireTransferFence(renderer, NULL);
+	SDLGPU_INTERNAL_RecycleTransferBuffers(renderer);
+	SDL_UnlockMutex(renderer->copyPassMutex);
+}
+
+static void SDLGPU_INTERNAL_DestroyTransferPool(
+	SDLGPU_Renderer *renderer
+) {
+	SDLGPU_TransferPool *pool = &renderer->transferPool;
+	int32_t i;
+
+	/* The GPU is idle, but shared fences still only get released once */
+	for (i = 0; i < pool->count; i += 1)
+	{
+		if (pool->elements[i].state == POOLED_TRANSFER_SUBMITTED)
+		{
+			SDLGPU_INTERNAL_RetireTransferFence(
+				renderer,
+				pool->elements[i].fence
+			);
+		}
+		SDL_ReleaseGPUTransferBuffer(
+			renderer->device,
+			pool->elements[i].transferBuffer
+		);
+	}
+	SDL_free(pool->elements);
+	SDL_zerop(pool);
+}
+
 static void SDLGPU_INTERNAL_ResetUploadCommandBufferState(
 	SDLGPU_Renderer *renderer
 ) {
@@ -994,6 +1396,9 @@ static void SDLGPU_INTERNAL_FlushUploadCommandsAndAcquireFence(
 		FNA3D_LogError("SDL_SubmitGPUCommandBufferAndAcquireFence failed: %s", error);
 	}
 
+	/* The caller owns this fence, see CompleteStalledTransferBuffers */
+	SDLGPU_INTERNAL_SubmitPooledTransferBuffers(renderer, NULL);
+
 	SDLGPU_INTERNAL_ResetUploadCommandBufferState(renderer);
 
 	SDL_UnlockMutex(renderer->copyPassMutex);
@@ -1021,7 +1426,20 @@ static void SDLGPU_INTERNAL_FlushUploadCommands(
 	SDL_LockMutex(renderer->copyPassMutex);
 
 	SDLGPU_INTERNAL_EndCopyPass(renderer);
-	SDL_SubmitGPUCommandBuffer(renderer->uploadCommandBuffer);
+	if (renderer->transferPool.pendingCount > 0)
+	{
+		/* Pooled transfer buffers are recycled when this signals */
+		SDLGPU_INTERNAL_SubmitPooledTransferBuffers(
+			renderer,
+			SDL_SubmitGPUCommandBufferAndAcquireFence(
+				renderer->uploadCommandBuffer
+			)
+		);
+	}
+	else
+	{
+		SDL_SubmitGPUCommandBuffer(renderer->uploadCommandBuffer);
+	}
 	SDLGPU_INTERNAL_ResetUploadCommandBufferState(renderer);
 
 	SDL_UnlockMutex(renderer->copyPassMutex);
@@ -1054,6 +1472,7 @@ static void SDLGPU_INTERNAL_FlushCommandsAndStall(
 		fences,
 		2
 	);
+	SDLGPU_INTERNAL_CompleteStalledTransferBuffers(renderer);
 
 	SDL_ReleaseGPUFence(
 		renderer->device,
@@ -1083,6 +1502,7 @@ static void SDLGPU_INTERNAL_FlushUploadCommandsAndStall(
 		fences,
 		1
 	);
+	SDLGPU_INTERNAL_CompleteStalledTransferBuffers(renderer);
 
 	SDL_ReleaseGPUFence(
 		renderer->device,
@@ -1129,6 +1549,8 @@ static void SDLGPU_SwapBuffers(
 	SDL_GPUBlitInfo blitInfo;
 	uint32_t width, height;
 	uint32_t i;
+	uint64_t swapStart = 0;
+	bool acquired;
 
 	SDL_LockMutex(renderer->copyPassMutex);
 	SDLGPU_INTERNAL_EndCopyPass(renderer);
@@ -1142,13 +1564,24 @@ static void SDLGPU_SwapBuffers(
 		return;
 	}
 
-	if (SDL_WaitAndAcquireGPUSwapchainTexture(
+	/* Acquiring the swapchain is where we wait on the GPU/compositor */
+	if (renderer->perf.enabled)
+	{
+		swapStart = SDL_GetTicksNS();
+	}
+	acquired = SDL_WaitAndAcquireGPUSwapchainTexture(
 		renderer->renderCommandBuffer,
 		overrideWindowHandle,
 		&swapchainTexture,
 		&width,
 		&height
-	) && swapchainTexture != NULL) {
+	);
+	if (renderer->perf.enabled)
+	{
+		FNA3D_PERF_ADD(renderer->perf, swapWaitNs, SDL_GetTicksNS() - swapStart);
+	}
+
+	if (acquired && swapchainTexture != NULL) {
 		blitInfo.source.texture = renderer->fauxBackbufferColorTexture->texture;
 		blitInfo.source.mip_level = 0;
 		blitInfo.source.layer_or_depth_plane = 0;
@@ -1218,6 +1651,17 @@ static void SDLGPU_SwapBuffers(
 	}
 	renderer->boundRenderTargetCount = 0;
 
+	/* Publish prewarmed pipelines even if nothing has missed on them yet */
+	SDLGPU_INTERNAL_DrainPipelineJobs(renderer);
+
+	SDL_UnlockMutex(renderer->copyPassMutex);
+
+	/* Don't stall loading threads while we sleep off the frame */
+	FNA3D_FramePacer_Wait(&renderer->pacer, NULL);
+
+	SDL_LockMutex(renderer->copyPassMutex);
+	FNA3D_FramePacer_Record(&renderer->pacer, &renderer->perf);
+	FNA3D_PerfState_EndFrame(&renderer->perf);
 	SDL_UnlockMutex(renderer->copyPassMutex);
 }
 
@@ -1309,6 +1753,11 @@ static void SDLGPU_Clear(
 	uint8_t clearDepth = (options & FNA3D_CLEAROPTIONS_DEPTHBUFFER) == FNA3D_CLEAROPTIONS_DEPTHBUFFER;
 	uint8_t clearStencil = (options & FNA3D_CLEAROPTIONS_STENCIL) == FNA3D_CLEAROPTIONS_STENCIL;
 
+	if (renderer->perf.enabled)
+	{
+		FNA3D_PERF_ADD(renderer->perf, clearCalls, 1);
+	}
+
 	SDLGPU_INTERNAL_PrepareRenderPassClear(
 		renderer,
 		color,
@@ -1331,6 +1780,11 @@ static void SDLGPU_SetRenderTargets(
 	SDLGPU_Renderer *renderer = (SDLGPU_Renderer*) driverData;
 	int32_t i;
 
+	if (renderer->perf.enabled)
+	{
+		FNA3D_PERF_ADD(renderer->perf, setRenderTargetCalls, 1);
+	}
+
 	if (
 		renderer->shouldClearColorOnBeginPass ||
 		renderer->shouldClearDepthOnBeginPass ||
@@ -1421,6 +1875,8 @@ static void SDLGPU_ResolveTarget(
 
 static void SDLGPU_INTERNAL_GenerateVertexInputInfo(
 	SDLGPU_Renderer *renderer,
+	FNA3D_VertexBufferBinding *vertexBindings,
+	int32_t numVertexBindings,
 	SDL_GPUVertexBufferDescription *bindings,
 	SDL_GPUVertexAttribute *attributes,
 	uint32_t *attributeCount
@@ -1438,10 +1894,10 @@ static void SDLGPU_INTERNAL_GenerateVertexInputInfo(
 	MOJOSHADER_sdlGetBoundShaderData(renderer->mojoshaderContext, &vertexShader, &blah);
 
 	SDL_memset(attrUse, '\0', sizeof(attrUse));
-	for (i = 0; i < (int32_t) renderer->numVertexBindings; i += 1)
+	for (i = 0; i < numVertexBindings; i += 1)
 	{
 		vertexDeclaration =
-			renderer->vertexBindings[i].vertexDeclaration;
+			vertexBindings[i].vertexDeclaration;
 
 		for (j = 0; j < vertexDeclaration.elementCount; j += 1)
 		{
@@ -1499,9 +1955,9 @@ static void SDLGPU_INTERNAL_GenerateVertexInputInfo(
 		bindings[i].slot = i;
 		bindings[i].pitch = vertexDeclaration.vertexStride;
 
-		if (renderer->vertexBindings[i].instanceFrequency > 0)
+		if (vertexBindings[i].instanceFrequency > 0)
 		{
-			if (renderer->vertexBindings[i].instanceFrequency > 1)
+			if (vertexBindings[i].instanceFrequency > 1)
 			{
 				FNA3D_LogError("Vertex instanceFrequency must be either 0 or 1!");
 			}
@@ -1526,155 +1982,111 @@ static void SDLGPU_INTERNAL_GenerateVertexInputInfo(
 	);
 }
 
-static SDL_GPUGraphicsPipeline* SDLGPU_INTERNAL_FetchGraphicsPipeline(
-	SDLGPU_Renderer *renderer
+/* Links the bound shaders for the given vertex layout, then finishes the hash */
+static void SDLGPU_INTERNAL_LinkGraphicsPipeline(
+	SDLGPU_Renderer *renderer,
+	SDLGPU_PipelineJob *job,
+	FNA3D_VertexBufferBinding *vertexBindings,
+	int32_t numVertexBindings
 ) {
-	MOJOSHADER_sdlShaderData *vertShader, *fragShader;
-	GraphicsPipelineHash hash;
-	SDL_GPUGraphicsPipeline *pipeline;
-	SDL_GPUGraphicsPipelineCreateInfo createInfo;
-	SDL_GPUColorTargetDescription colorAttachmentDescriptions[MAX_RENDERTARGET_BINDINGS];
-	SDL_GPUVertexBufferDescription *vertexBindings;
-	SDL_GPUVertexAttribute *vertexAttributes;
-	int32_t i;
-
-	vertexBindings = SDL_malloc(
-		renderer->numVertexBindings *
-		sizeof(SDL_GPUVertexBufferDescription)
-	);
-	vertexAttributes = SDL_malloc(
-		renderer->numVertexBindings *
-		MAX_VERTEX_ATTRIBUTES *
-		sizeof(SDL_GPUVertexAttribute)
-	);
-
 	/* We have to do this to link the vertex attribute modified shader program */
 	SDLGPU_INTERNAL_GenerateVertexInputInfo(
 		renderer,
 		vertexBindings,
-		vertexAttributes,
-		&createInfo.vertex_input_state.num_vertex_attributes
+		numVertexBindings,
+		job->vertexBindings,
+		job->vertexAttributes,
+		&job->createInfo.vertex_input_state.num_vertex_attributes
 	);
+	job->createInfo.vertex_input_state.num_vertex_buffers = numVertexBindings;
 
 	/* Shaders */
 	MOJOSHADER_sdlGetShaders(
 		renderer->mojoshaderContext,
-		&createInfo.vertex_shader,
-		&createInfo.fragment_shader
+		&job->createInfo.vertex_shader,
+		&job->createInfo.fragment_shader
 	);
+	job->hash.vertShader = job->createInfo.vertex_shader;
+	job->hash.fragShader = job->createInfo.fragment_shader;
 
-	hash.blendState = GetPackedBlendState(renderer->fnaBlendState);
-
-	hash.depthStencilState = GetPackedDepthStencilState(
-		renderer->fnaDepthStencilState
-	);
-
-	hash.vertexBufferBindingsIndex = renderer->currentVertexBufferBindingsIndex;
-	hash.primitiveType = renderer->fnaPrimitiveType;
-	hash.sampleCount = renderer->nextRenderPassMultisampleCount;
-	hash.sampleMask = renderer->multisampleMask;
-	MOJOSHADER_sdlGetBoundShaderData(renderer->mojoshaderContext, &vertShader, &fragShader);
-	hash.vertShader = createInfo.vertex_shader;
-	hash.fragShader = createInfo.fragment_shader;
-
-	hash.colorFormatCount = renderer->nextRenderPassColorAttachmentCount;
-	hash.colorFormats[0] = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM;
-	hash.colorFormats[1] = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM;
-	hash.colorFormats[2] = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM;
-	hash.colorFormats[3] = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM;
-
-	for (i = 0; i < (int32_t) renderer->nextRenderPassColorAttachmentCount; i += 1)
-	{
-		hash.colorFormats[i] = renderer->nextRenderPassColorAttachments[i]->createInfo.format;
-	}
-
-	hash.depthStencilFormat = SDL_GPU_TEXTUREFORMAT_D16_UNORM;
-	hash.hasDepthStencilAttachment = renderer->nextRenderPassDepthStencilAttachment != NULL;
-
-	if (hash.hasDepthStencilAttachment)
-	{
-		hash.depthStencilFormat = renderer->nextRenderPassDepthStencilAttachment->createInfo.format;
-	}
-
-	hash.rasterizerState = GetPackedRasterizerState(
-		renderer->fnaRasterizerState,
-		renderer->fnaRasterizerState.depthBias
+	job->hash.blendState = GetPackedBlendState(job->blendState);
+	job->hash.depthStencilState = GetPackedDepthStencilState(
+		job->depthStencilState
 	);
-
-	pipeline = GraphicsPipelineHashTable_Fetch(
-		&renderer->graphicsPipelineHashTable,
-		hash
+	job->hash.rasterizerState = GetPackedRasterizerState(
+		job->rasterizerState,
+		job->rasterizerState.depthBias
 	);
+}
 
-	if (pipeline != NULL)
-	{
-		SDL_free(vertexBindings);
-		SDL_free(vertexAttributes);
-		return pipeline;
-	}
+/* Touches nothing but the job, so this is safe to call from any thread */
+static void SDLGPU_INTERNAL_FillGraphicsPipelineCreateInfo(
+	SDLGPU_PipelineJob *job
+) {
+	SDL_GPUGraphicsPipelineCreateInfo *createInfo = &job->createInfo;
+	SDL_GPUColorTargetDescription *colorAttachmentDescriptions = job->colorAttachmentDescriptions;
 
-	createInfo.primitive_type = XNAToSDL_PrimitiveType[renderer->fnaPrimitiveType];
+	createInfo->primitive_type = XNAToSDL_PrimitiveType[job->hash.primitiveType];
 
 	/* Vertex Input State */
 
-	createInfo.vertex_input_state.vertex_buffer_descriptions = vertexBindings;
-	createInfo.vertex_input_state.num_vertex_buffers = renderer->numVertexBindings;
-	createInfo.vertex_input_state.vertex_attributes = vertexAttributes;
+	createInfo->vertex_input_state.vertex_buffer_descriptions = job->vertexBindings;
+	createInfo->vertex_input_state.vertex_attributes = job->vertexAttributes;
 
 	/* Rasterizer */
 
-	createInfo.rasterizer_state.cull_mode = XNAToSDL_CullMode[renderer->fnaRasterizerState.cullMode];
-	createInfo.rasterizer_state.depth_bias_clamp = 0.0f;
-	createInfo.rasterizer_state.depth_bias_constant_factor = renderer->fnaRasterizerState.depthBias;
-	createInfo.rasterizer_state.enable_depth_bias = 1;
-	createInfo.rasterizer_state.enable_depth_clip = 1;
-	createInfo.rasterizer_state.depth_bias_slope_factor = renderer->fnaRasterizerState.slopeScaleDepthBias;
-	createInfo.rasterizer_state.fill_mode = XNAToSDL_FillMode[renderer->fnaRasterizerState.fillMode];
-	createInfo.rasterizer_state.front_face = SDL_GPU_FRONTFACE_CLOCKWISE;
+	createInfo->rasterizer_state.cull_mode = XNAToSDL_CullMode[job->rasterizerState.cullMode];
+	createInfo->rasterizer_state.depth_bias_clamp = 0.0f;
+	createInfo->rasterizer_state.depth_bias_constant_factor = job->rasterizerState.depthBias;
+	createInfo->rasterizer_state.enable_depth_bias = 1;
+	createInfo->rasterizer_state.enable_depth_clip = 1;
+	createInfo->rasterizer_state.depth_bias_slope_factor = job->rasterizerState.slopeScaleDepthBias;
+	createInfo->rasterizer_state.fill_mode = XNAToSDL_FillMode[job->rasterizerState.fillMode];
+	createInfo->rasterizer_state.front_face = SDL_GPU_FRONTFACE_CLOCKWISE;
 
 	/* Multisample */
 
-	SDL_zero(createInfo.multisample_state);
-	createInfo.multisample_state.sample_count = renderer->nextRenderPassMultisampleCount;
-	if (renderer->multisampleMask != 0xFFFFFFFF)
+	SDL_zero(createInfo->multisample_state);
+	createInfo->multisample_state.sample_count = (SDL_GPUSampleCount) job->hash.sampleCount;
+	if (job->hash.sampleMask != 0xFFFFFFFF)
 	{
-		createInfo.multisample_state.enable_mask = true;
-		createInfo.multisample_state.sample_mask = renderer->multisampleMask;
+		createInfo->multisample_state.enable_mask = true;
+		createInfo->multisample_state.sample_mask = job->hash.sampleMask;
 	}
 	else
 	{
-		createInfo.multisample_state.enable_mask = false;
-		createInfo.multisample_state.sample_mask = 0;
+		createInfo->multisample_state.enable_mask = false;
+		createInfo->multisample_state.sample_mask = 0;
 	}
 
 	/* Blend State */
 
 	colorAttachmentDescriptions[0].blend_state.enable_blend = !(
-		renderer->fnaBlendState.colorSourceBlend == FNA3D_BLEND_ONE &&
-		renderer->fnaBlendState.colorDestinationBlend == FNA3D_BLEND_ZERO &&
-		renderer->fnaBlendState.alphaSourceBlend == FNA3D_BLEND_ONE &&
-		renderer->fnaBlendState.alphaDestinationBlend == FNA3D_BLEND_ZERO
+		job->blendState.colorSourceBlend == FNA3D_BLEND_ONE &&
+		job->blendState.colorDestinationBlend == FNA3D_BLEND_ZERO &&
+		job->blendState.alphaSourceBlend == FNA3D_BLEND_ONE &&
+		job->blendState.alphaDestinationBlend == FNA3D_BLEND_ZERO
 	);
 	if (colorAttachmentDescriptions[0].blend_state.enable_blend)
 	{
 		colorAttachmentDescriptions[0].blend_state.src_color_blendfactor = XNAToSDL_BlendFactor[
-			renderer->fnaBlendState.colorSourceBlend
+			job->blendState.colorSourceBlend
 		];
 		colorAttachmentDescriptions[0].blend_state.src_alpha_blendfactor = XNAToSDL_BlendFactor[
-			renderer->fnaBlendState.alphaSourceBlend
+			job->blendState.alphaSourceBlend
 		];
 		colorAttachmentDescriptions[0].blend_state.dst_color_blendfactor = XNAToSDL_BlendFactor[
-			renderer->fnaBlendState.colorDestinationBlend
+			job->blendState.colorDestinationBlend
 		];
 		colorAttachmentDescriptions[0].blend_state.dst_alpha_blendfactor = XNAToSDL_BlendFactor[
-			renderer->fnaBlendState.alphaDestinationBlend
+			job->blendState.alphaDestinationBlend
 		];
 
 		colorAttachmentDescriptions[0].blend_state.color_blend_op = XNAToSDL_BlendOp[
-			renderer->fnaBlendState.colorBlendFunction
+			job->blendState.colorBlendFunction
 		];
 		colorAttachmentDescriptions[0].blend_state.alpha_blend_op = XNAToSDL_BlendOp[
-			renderer->fnaBlendState.alphaBlendFunction
+			job->blendState.alphaBlendFunction
 		];
 	}
 	else
@@ -1692,13 +2104,13 @@ static SDL_GPUGraphicsPipeline* SDLGPU_INTERNAL_FetchGraphicsPipeline(
 	colorAttachmentDescriptions[3].blend_state = colorAttachmentDescriptions[0].blend_state;
 
 	colorAttachmentDescriptions[0].blend_state.color_write_mask =
-		renderer->fnaBlendState.colorWriteEnable;
+		job->blendState.colorWriteEnable;
 	colorAttachmentDescriptions[1].blend_state.color_write_mask =
-		renderer->fnaBlendState.colorWriteEnable1;
+		job->blendState.colorWriteEnable1;
 	colorAttachmentDescriptions[2].blend_state.color_write_mask =
-		renderer->fnaBlendState.colorWriteEnable2;
+		job->blendState.colorWriteEnable2;
 	colorAttachmentDescriptions[3].blend_state.color_write_mask =
-		renderer->fnaBlendState.colorWriteEnable3;
+		job->blendState.colorWriteEnable3;
 
 	/* FIXME: Can this be disabled when mask is R|G|B|A? -flibit */
 	colorAttachmentDescriptions[0].blend_state.enable_color_write_mask = true;
@@ -1706,78 +2118,199 @@ static SDL_GPUGraphicsPipeline* SDLGPU_INTERNAL_FetchGraphicsPipeline(
 	colorAttachmentDescriptions[2].blend_state.enable_color_write_mask = true;
 	colorAttachmentDescriptions[3].blend_state.enable_color_write_mask = true;
 
-	colorAttachmentDescriptions[0].format = hash.colorFormats[0];
-	colorAttachmentDescriptions[1].format = hash.colorFormats[1];
-	colorAttachmentDescriptions[2].format = hash.colorFormats[2];
-	colorAttachmentDescriptions[3].format = hash.colorFormats[3];
+	colorAttachmentDescriptions[0].format = (SDL_GPUTextureFormat) job->hash.colorFormats[0];
+	colorAttachmentDescriptions[1].format = (SDL_GPUTextureFormat) job->hash.colorFormats[1];
+	colorAttachmentDescriptions[2].format = (SDL_GPUTextureFormat) job->hash.colorFormats[2];
+	colorAttachmentDescriptions[3].format = (SDL_GPUTextureFormat) job->hash.colorFormats[3];
 
-	createInfo.target_info.num_color_targets = renderer->nextRenderPassColorAttachmentCount;
-	createInfo.target_info.color_target_descriptions = colorAttachmentDescriptions;
-	createInfo.target_info.has_depth_stencil_target = hash.hasDepthStencilAttachment;
-	createInfo.target_info.depth_stencil_format = hash.depthStencilFormat;
+	createInfo->target_info.num_color_targets = job->hash.colorFormatCount;
+	createInfo->target_info.color_target_descriptions = colorAttachmentDescriptions;
+	createInfo->target_info.has_depth_stencil_target =
+		job->hash.depthStencilFormat != SDL_GPU_TEXTUREFORMAT_INVALID;
+	createInfo->target_info.depth_stencil_format = (SDL_GPUTextureFormat) job->hash.depthStencilFormat;
 
 	/* Depth Stencil */
 
-	createInfo.depth_stencil_state.enable_depth_test =
-		renderer->fnaDepthStencilState.depthBufferEnable;
-	createInfo.depth_stencil_state.enable_depth_write =
-		renderer->fnaDepthStencilState.depthBufferWriteEnable;
-	createInfo.depth_stencil_state.compare_op = XNAToSDL_CompareOp[
-		renderer->fnaDepthStencilState.depthBufferFunction
+	createInfo->depth_stencil_state.enable_depth_test =
+		job->depthStencilState.depthBufferEnable;
+	createInfo->depth_stencil_state.enable_depth_write =
+		job->depthStencilState.depthBufferWriteEnable;
+	createInfo->depth_stencil_state.compare_op = XNAToSDL_CompareOp[
+		job->depthStencilState.depthBufferFunction
 	];
-	createInfo.depth_stencil_state.enable_stencil_test =
-		renderer->fnaDepthStencilState.stencilEnable;
+	createInfo->depth_stencil_state.enable_stencil_test =
+		job->depthStencilState.stencilEnable;
 
-	createInfo.depth_stencil_state.front_stencil_state.compare_op = XNAToSDL_CompareOp[
-		renderer->fnaDepthStencilState.stencilFunction
+	createInfo->depth_stencil_state.front_stencil_state.compare_op = XNAToSDL_CompareOp[
+		job->depthStencilState.stencilFunction
 	];
-	createInfo.depth_stencil_state.front_stencil_state.depth_fail_op = XNAToSDL_StencilOp[
-		renderer->fnaDepthStencilState.stencilDepthBufferFail
+	createInfo->depth_stencil_state.front_stencil_state.depth_fail_op = XNAToSDL_StencilOp[
+		job->depthStencilState.stencilDepthBufferFail
 	];
-	createInfo.depth_stencil_state.front_stencil_state.fail_op = XNAToSDL_StencilOp[
-		renderer->fnaDepthStencilState.stencilFail
+	createInfo->depth_stencil_state.front_stencil_state.fail_op = XNAToSDL_StencilOp[
+		job->depthStencilState.stencilFail
 	];
-	createInfo.depth_stencil_state.front_stencil_state.pass_op = XNAToSDL_StencilOp[
-		renderer->fnaDepthStencilState.stencilPass
+	createInfo->depth_stencil_state.front_stencil_state.pass_op = XNAToSDL_StencilOp[
+		job->depthStencilState.stencilPass
 	];
 
-	if (renderer->fnaDepthStencilState.twoSidedStencilMode)
+	if (job->depthStencilState.twoSidedStencilMode)
 	{
-		createInfo.depth_stencil_state.back_stencil_state.compare_op = XNAToSDL_CompareOp[
-			renderer->fnaDepthStencilState.ccwStencilFunction
+		createInfo->depth_stencil_state.back_stencil_state.compare_op = XNAToSDL_CompareOp[
+			job->depthStencilState.ccwStencilFunction
 		];
-		createInfo.depth_stencil_state.back_stencil_state.depth_fail_op = XNAToSDL_StencilOp[
-			renderer->fnaDepthStencilState.ccwStencilDepthBufferFail
+		createInfo->depth_stencil_state.back_stencil_state.depth_fail_op = XNAToSDL_StencilOp[
+			job->depthStencilState.ccwStencilDepthBufferFail
 		];
-		createInfo.depth_stencil_state.back_stencil_state.fail_op = XNAToSDL_StencilOp[
-			renderer->fnaDepthStencilState.ccwStencilFail
+		createInfo->depth_stencil_state.back_stencil_state.fail_op = XNAToSDL_StencilOp[
+			job->depthStencilState.ccwStencilFail
 		];
-		createInfo.depth_stencil_state.back_stencil_state.pass_op = XNAToSDL_StencilOp[
-			renderer->fnaDepthStencilState.ccwStencilPass
+		createInfo->depth_stencil_state.back_stencil_state.pass_op = XNAToSDL_StencilOp[
+			job->depthStencilState.ccwStencilPass
 		];
 	}
 	else
 	{
-		createInfo.depth_stencil_state.back_stencil_state = createInfo.depth_stencil_state.front_stencil_state;
+		createInfo->depth_stencil_state.back_stencil_state = createInfo->depth_stencil_state.front_stencil_state;
+	}
+
+	createInfo->depth_stencil_state.compare_mask =
+		job->depthStencilState.stencilMask;
+	createInfo->depth_stencil_state.write_mask =
+		job->depthStencilState.stencilWriteMask;
+
+	createInfo->props = 0;
+}
+
+/* Returns NULL if the pipeline is still being compiled in the background */
+static SDL_GPUGraphicsPipeline* SDLGPU_INTERNAL_FetchGraphicsPipeline(
+	SDLGPU_Renderer *renderer
+) {
+	SDLGPU_PipelineJob job;
+	SDLGPU_PipelineJob *pending;
+	SDL_GPUGraphicsPipeline *pipeline;
+	uint64_t stallStart = 0;
+	int32_t i;
+
+	job.blendState = renderer->fnaBlendState;
+	job.depthStencilState = renderer->fnaDepthStencilState;
+	job.rasterizerState = renderer->fnaRasterizerState;
+
+	job.hash.vertexBufferBindingsIndex = renderer->currentVertexBufferBindingsIndex;
+	job.hash.primitiveType = (uint8_t) renderer->fnaPrimitiveType;
+	job.hash.sampleCount = (uint8_t) renderer->nextRenderPassMultisampleCount;
+	job.hash.sampleMask = renderer->multisampleMask;
+
+	job.hash.colorFormatCount = (uint8_t) renderer->nextRenderPassColorAttachmentCount;
+	job.hash.colorFormats[0] = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM;
+	job.hash.colorFormats[1] = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM;
+	job.hash.colorFormats[2] = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM;
+	job.hash.colorFormats[3] = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM;
+
+	for (i = 0; i < (int32_t) renderer->nextRenderPassColorAttachmentCount; i += 1)
+	{
+		job.hash.colorFormats[i] = (uint8_t) renderer->nextRenderPassColorAttachments[i]->createInfo.format;
+	}
+
+	job.hash.depthStencilFormat = SDL_GPU_TEXTUREFORMAT_INVALID;
+
+	if (renderer->nextRenderPassDepthStencilAttachment != NULL)
+	{
+		job.hash.depthStencilFormat = (uint8_t) renderer->nextRenderPassDepthStencilAttachment->createInfo.format;
+	}
+
+	SDLGPU_INTERNAL_LinkGraphicsPipeline(
+		renderer,
+		&job,
+		renderer->vertexBindings,
+		(int32_t) renderer->numVertexBindings
+	);
+
+	pipeline = GraphicsPipelineHashTable_Fetch(
+		&renderer->graphicsPipelineHashTable,
+		&job.hash
+	);
+
+	if (pipeline != NULL)
+	{
+		return pipeline;
+	}
+
+	if (renderer->perf.enabled)
+	{
+		FNA3D_PERF_ADD(renderer->perf, pipelineMisses, 1);
+		stallStart = SDL_GetTicksNS();
+	}
+
+	if (renderer->pipelineJobsInFlight > 0)
+	{
+		/* It may have finished in the background since the last drain */
+		SDLGPU_INTERNAL_DrainPipelineJobs(renderer);
+		pipeline = GraphicsPipelineHashTable_Fetch(
+			&renderer->graphicsPipelineHashTable,
+			&job.hash
+		);
+
+		/* Never compile the same pipeline twice, use the one in flight */
+		pending = NULL;
+		if (pipeline == NULL)
+		{
+			pending = SDLGPU_INTERNAL_FindPipelineJob(renderer, &job.hash);
+		}
+		if (pending != NULL)
+		{
+			if (renderer->asyncPipelines)
+			{
+				return NULL;
+			}
+			pipeline = SDLGPU_INTERNAL_WaitForPipelineJob(renderer, pending);
+		}
+
+		if (pipeline != NULL)
+		{
+			if (renderer->perf.enabled)
+			{
+				FNA3D_PERF_ADD(renderer->perf, pipelineAsyncHits, 1);
+				FNA3D_PERF_ADD(
+					renderer->perf,
+					pipelineStallNs,
+					SDL_GetTicksNS() - stallStart
+				);
+			}
+			return pipeline;
+		}
+	}
+
+	if (
+		renderer->asyncPipelines &&
+		SDLGPU_INTERNAL_GetPipelineCompiler(renderer) != NULL
+	) {
+		/* Skip this draw, the pipeline is published by a later drain */
+		pending = (SDLGPU_PipelineJob*) SDL_malloc(sizeof(SDLGPU_PipelineJob));
+		SDL_memcpy(pending, &job, sizeof(SDLGPU_PipelineJob));
+		SDLGPU_INTERNAL_FillGraphicsPipelineCreateInfo(pending);
+
+		MOJOSHADER_sdlGetBoundShaderData(
+			renderer->mojoshaderContext,
+			&pending->vertShaderData,
+			&pending->fragShaderData
+		);
+		MOJOSHADER_sdlShaderAddRef(pending->vertShaderData);
+		MOJOSHADER_sdlShaderAddRef(pending->fragShaderData);
+
+		SDLGPU_INTERNAL_SubmitPipelineJob(renderer, pending, 1);
+		return NULL;
 	}
 
-	createInfo.depth_stencil_state.compare_mask =
-		renderer->fnaDepthStencilState.stencilMask;
-	createInfo.depth_stencil_state.write_mask =
-		renderer->fnaDepthStencilState.stencilWriteMask;
+	SDLGPU_INTERNAL_FillGraphicsPipelineCreateInfo(&job);
 
 	/* Finally, after 1000 years, create the pipeline! */
 
-	createInfo.props = 0;
 	pipeline = SDL_CreateGPUGraphicsPipeline(
 		renderer->device,
-		&createInfo
+		&job.createInfo
 	);
 
-	SDL_free(vertexBindings);
-	SDL_free(vertexAttributes);
-	SDL_stack_free(resourceSetLayoutInfos);
-
 	if (pipeline == NULL)
 	{
 		FNA3D_LogError("Failed to create graphics pipeline!");
@@ -1785,14 +2318,24 @@ static SDL_GPUGraphicsPipeline* SDLGPU_INTERNAL_FetchGraphicsPipeline(
 
 	GraphicsPipelineHashTable_Insert(
 		&renderer->graphicsPipelineHashTable,
-		hash,
+		&job.hash,
 		pipeline
 	);
 
+	if (renderer->perf.enabled)
+	{
+		FNA3D_PERF_ADD(
+			renderer->perf,
+			pipelineStallNs,
+			SDL_GetTicksNS() - stallStart
+		);
+	}
+
 	return pipeline;
 }
 
-static void SDLGPU_INTERNAL_BindGraphicsPipeline(
+/* Returns 0 if the draw has to be skipped, see FNA3D_ASYNC_PIPELINES */
+static uint8_t SDLGPU_INTERNAL_BindGraphicsPipeline(
 	SDLGPU_Renderer *renderer
 ) {
 	SDL_GPUGraphicsPipeline *pipeline;
@@ -1809,11 +2352,17 @@ static void SDLGPU_INTERNAL_BindGraphicsPipeline(
 		renderer->currentVertexShader == vertShaderData &&
 		renderer->currentFragmentShader == fragShaderData
 	) {
-		return;
+		return 1;
 	}
 
 	pipeline = SDLGPU_INTERNAL_FetchGraphicsPipeline(renderer);
 
+	if (pipeline == NULL && renderer->asyncPipelines)
+	{
+		/* Still compiling, try again on the next draw */
+		return 0;
+	}
+
 	if (pipeline != renderer->currentGraphicsPipeline)
 	{
 		SDL_BindGPUGraphicsPipeline(
@@ -1838,6 +2387,7 @@ static void SDLGPU_INTERNAL_BindGraphicsPipeline(
 	renderer->needVertexSamplerBind = 1;
 	renderer->needVertexBufferBind = 1;
 	renderer->indexBufferBinding.buffer = NULL;
+	return 1;
 }
 
 static SDL_GPUSampler* SDLGPU_INTERNAL_FetchSamplerState(
@@ -1848,8 +2398,8 @@ static SDL_GPUSampler* SDLGPU_INTERNAL_FetchSamplerState(
 	SDL_GPUSampler *sampler;
 
 	PackedState hash = GetPackedSamplerState(*samplerState);
-	sampler = SamplerStateHashArray_Fetch(
-		&renderer->samplerStateArray,
+	sampler = (SDL_GPUSampler*) PackedStateHashTable_Fetch(
+		&renderer->samplerStateTable,
 		hash
 	);
 	if (sampler != NULL)
@@ -1890,8 +2440,8 @@ static SDL_GPUSampler* SDLGPU_INTERNAL_FetchSamplerState(
 		return NULL;
 	}
 
-	SamplerStateHashArray_Insert(
-		&renderer->samplerStateArray,
+	PackedStateHashTable_Insert(
+		&renderer->samplerStateTable,
 		hash,
 		sampler
 	);
@@ -2061,7 +2611,7 @@ static void SDLGPU_ApplyVertexBufferBindings(
 	MOJOSHADER_sdlGetBoundShaderData(renderer->mojoshaderContext, &vertexShader, &blah);
 
 	bindingsResult = PackedVertexBufferBindingsArray_Fetch(
-		renderer->vertexBufferBindingsCache,
+		&renderer->vertexBufferBindingsCache,
 		bindings,
 		numBindings,
 		vertexShader,
@@ -2076,6 +2626,7 @@ static void SDLGPU_ApplyVertexBufferBindings(
 			bindings,
 			numBindings,
 			vertexShader,
+			hash,
 			(void*) 69420
 		);
 	}
@@ -2391,8 +2942,8 @@ static void SDLGPU_INTERNAL_BindFragmentSamplers(
 	);
 }
 
-/* Actually bind all deferred state before drawing! */
-static void SDLGPU_INTERNAL_BindDeferredState(
+/* Actually bind all deferred state before drawing! Returns 0 to skip the draw */
+static uint8_t SDLGPU_INTERNAL_BindDeferredState(
 	SDLGPU_Renderer *renderer,
 	FNA3D_PrimitiveType primitiveType,
 	SDL_GPUBuffer *indexBuffer, /* can be NULL */
@@ -2406,7 +2957,10 @@ static void SDLGPU_INTERNAL_BindDeferredState(
 
 	SDLGPU_INTERNAL_BeginRenderPass(renderer);
 
-	SDLGPU_INTERNAL_BindGraphicsPipeline(renderer);
+	if (!SDLGPU_INTERNAL_BindGraphicsPipeline(renderer))
+	{
+		return 0;
+	}
 
 	if (	renderer->currentBlendConstants.r != renderer->blendConstants[0] ||
 		renderer->currentBlendConstants.g != renderer->blendConstants[1] ||
@@ -2461,6 +3015,8 @@ static void SDLGPU_INTERNAL_BindDeferredState(
 			renderer->numVertexBindings
 		);
 	}
+
+	return 1;
 }
 
 static void SDLGPU_DrawInstancedPrimitives(
@@ -2484,12 +3040,14 @@ static void SDLGPU_DrawInstancedPrimitives(
 		baseVertex = 0;
 	}
 
-	SDLGPU_INTERNAL_BindDeferredState(
+	if (!SDLGPU_INTERNAL_BindDeferredState(
 		renderer,
 		primitiveType,
 		((SDLGPU_BufferHandle*) indices)->buffer,
 		XNAToSDL_IndexElementSize[indexElementSize]
-	);
+	)) {
+		return;
+	}
 
 	SDL_DrawGPUIndexedPrimitives(
 		renderer->renderPass,
@@ -2499,6 +3057,19 @@ static void SDLGPU_DrawInstancedPrimitives(
 		baseVertex,
 		0
 	);
+
+	if (renderer->perf.enabled)
+	{
+		FNA3D_PERF_ADD(renderer->perf, drawCalls, 1);
+		if (instanceCount > 1)
+		{
+			FNA3D_PERF_ADD(renderer->perf, drawInstancedCalls, 1);
+		}
+		else
+		{
+			FNA3D_PERF_ADD(renderer->perf, drawIndexedCalls, 1);
+		}
+	}
 }
 
 static void SDLGPU_DrawIndexedPrimitives(
@@ -2534,12 +3105,14 @@ static void SDLGPU_DrawPrimitives(
 ) {
 	SDLGPU_Renderer *renderer = (SDLGPU_Renderer*) driverData;
 
-	SDLGPU_INTERNAL_BindDeferredState(
+	if (!SDLGPU_INTERNAL_BindDeferredState(
 		renderer,
 		primitiveType,
 		NULL,
 		SDL_GPU_INDEXELEMENTSIZE_16BIT
-	);
+	)) {
+		return;
+	}
 
 	SDL_DrawGPUPrimitives(
 		renderer->renderPass,
@@ -2548,6 +3121,12 @@ static void SDLGPU_DrawPrimitives(
 		vertexStart,
 		0
 	);
+
+	if (renderer->perf.enabled)
+	{
+		FNA3D_PERF_ADD(renderer->perf, drawCalls, 1);
+		FNA3D_PERF_ADD(renderer->perf, drawPrimitiveCalls, 1);
+	}
 }
 
 /* Backbuffer Functions */
@@ -3022,11 +3601,10 @@ static void SDLGPU_INTERNAL_SetTextureData(
 
 	SDL_GPUTextureRegion textureRegion;
 	SDL_GPUTextureTransferInfo textureCopyParams;
-	SDL_GPUTransferBufferCreateInfo transferBufferCreateInfo;
 	SDL_GPUTransferBuffer *transferBuffer = renderer->textureUploadBuffer;
 	uint32_t transferOffset;
 	bool cycle = renderer->textureUploadBufferOffset == 0;
-	bool usingTemporaryTransferBuffer = false;
+	bool usingPooledTransferBuffer = false;
 	uint8_t *dst;
 
 	renderer->textureUploadBufferOffset = SDLGPU_INTERNAL_RoundToAlignment(
@@ -3037,15 +3615,12 @@ static void SDLGPU_INTERNAL_SetTextureData(
 
 	if (dataLength >= TRANSFER_BUFFER_SIZE)
 	{
-		/* Upload is too big, create a temporary transfer buffer */
-		transferBufferCreateInfo.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD;
-		transferBufferCreateInfo.size = dataLength;
-		transferBufferCreateInfo.props = 0;
-		transferBuffer = SDL_CreateGPUTransferBuffer(
-			renderer->device,
-			&transferBufferCreateInfo
+		/* Upload is too big, grab a whole transfer buffer from the pool */
+		transferBuffer = SDLGPU_INTERNAL_AcquirePooledTransferBuffer(
+			renderer,
+			dataLength
 		);
-		usingTemporaryTransferBuffer = true;
+		usingPooledTransferBuffer = true;
 		cycle = false;
 		transferOffset = 0;
 	}
@@ -3066,6 +3641,10 @@ static void SDLGPU_INTERNAL_SetTextureData(
 			SDLGPU_INTERNAL_FlushUploadCommands(renderer);
 			cycle = true;
 			transferOffset = 0;
+			if (renderer->perf.enabled)
+			{
+				FNA3D_PERF_ADD(renderer->perf, forcedUploadFlushes, 1);
+			}
 		}
 	}
 
@@ -3095,11 +3674,7 @@ static void SDLGPU_INTERNAL_SetTextureData(
 		cycleTexture
 	);
 
-	if (usingTemporaryTransferBuffer)
-	{
-		SDL_ReleaseGPUTransferBuffer(renderer->device, transferBuffer);
-	}
-	else
+	if (!usingPooledTransferBuffer)
 	{
 		renderer->textureUploadBufferOffset += dataLength;
 	}
@@ -3359,38 +3934,35 @@ static void SDLGPU_AddDisposeIndexBuffer(
 	SDL_free(bufferHandle);
 }
 
-static void SDLGPU_INTERNAL_SetBufferData(
+/* Reserves dataLength bytes of upload space and maps them. The copy pass
+ * stays locked until the matching EndBufferUpload!
+ */
+static uint8_t* SDLGPU_INTERNAL_BeginBufferUpload(
 	SDLGPU_Renderer *renderer,
-	SDL_GPUBuffer *buffer,
-	uint32_t dstOffset,
-	void *data,
 	uint32_t dataLength,
-	bool cycle
+	SDLGPU_BufferUpload *upload
 ) {
+	bool transferCycle;
+	uint8_t *dst;
+
 	SDL_LockMutex(renderer->copyPassMutex);
 
-	SDL_GPUTransferBufferCreateInfo transferBufferCreateInfo;
-	SDL_GPUTransferBufferLocation transferLocation;
-	SDL_GPUBufferRegion bufferRegion;
-	SDL_GPUTransferBuffer *transferBuffer = renderer->bufferUploadBuffer;
-	uint32_t transferOffset = renderer->bufferUploadBufferOffset;
-	bool transferCycle = renderer->bufferUploadBufferOffset == 0;
-	bool usingTemporaryTransferBuffer = false;
-	uint8_t *dst;
+	upload->transferBuffer = renderer->bufferUploadBuffer;
+	upload->transferOffset = renderer->bufferUploadBufferOffset;
+	upload->dataLength = dataLength;
+	upload->pooled = false;
+	transferCycle = renderer->bufferUploadBufferOffset == 0;
 
 	if (dataLength >= TRANSFER_BUFFER_SIZE)
 	{
-		/* Upload is too big, create a temporary transfer buffer */
-		transferBufferCreateInfo.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD;
-		transferBufferCreateInfo.size = dataLength;
-		transferBufferCreateInfo.props = 0;
-		transferBuffer = SDL_CreateGPUTransferBuffer(
-			renderer->device,
-			&transferBufferCreateInfo
+		/* Upload is too big, grab a whole transfer buffer from the pool */
+		upload->transferBuffer = SDLGPU_INTERNAL_AcquirePooledTransferBuffer(
+			renderer,
+			dataLength
 		);
-		usingTemporaryTransferBuffer = true;
+		upload->pooled = true;
+		upload->transferOffset = 0;
 		transferCycle = false;
-		transferOffset = 0;
 	}
 	else if (
 		renderer->bufferUploadBufferOffset + dataLength >= TRANSFER_BUFFER_SIZE
@@ -3401,27 +3973,48 @@ static void SDLGPU_INTERNAL_SetBufferData(
 			transferCycle = true;
 			renderer->bufferUploadCycleCount += 1;
 			renderer->bufferUploadBufferOffset = 0;
-			transferOffset = 0;
+			upload->transferOffset = 0;
 		}
 		else
 		{
 			/* We cycled transfers a lot, send the upload commands to reduce further transfer memory usage */
 			SDLGPU_INTERNAL_FlushUploadCommands(renderer);
 			transferCycle = true;
-			transferOffset = 0;
+			upload->transferOffset = 0;
+			if (renderer->perf.enabled)
+			{
+				FNA3D_PERF_ADD(renderer->perf, forcedUploadFlushes, 1);
+			}
 		}
 	}
 
-	dst = (uint8_t*) SDL_MapGPUTransferBuffer(renderer->device, transferBuffer, transferCycle);
-	SDL_memcpy(dst + transferOffset, data, dataLength);
-	SDL_UnmapGPUTransferBuffer(renderer->device, transferBuffer);
+	dst = (uint8_t*) SDL_MapGPUTransferBuffer(
+		renderer->device,
+		upload->transferBuffer,
+		transferCycle
+	);
+	return dst + upload->transferOffset;
+}
 
-	transferLocation.transfer_buffer = transferBuffer;
-	transferLocation.offset = transferOffset;
+static void SDLGPU_INTERNAL_EndBufferUpload(
+	SDLGPU_Renderer *renderer,
+	SDLGPU_BufferUpload *upload,
+	SDL_GPUBuffer *buffer,
+	uint32_t dstOffset,
+	bool cycle,
+	uint8_t isIndexBuffer
+) {
+	SDL_GPUTransferBufferLocation transferLocation;
+	SDL_GPUBufferRegion bufferRegion;
+
+	SDL_UnmapGPUTransferBuffer(renderer->device, upload->transferBuffer);
+
+	transferLocation.transfer_buffer = upload->transferBuffer;
+	transferLocation.offset = upload->transferOffset;
 
 	bufferRegion.buffer = buffer;
 	bufferRegion.offset = dstOffset;
-	bufferRegion.size = dataLength;
+	bufferRegion.size = upload->dataLength;
 
 	SDL_UploadToGPUBuffer(
 		renderer->copyPass,
@@ -3430,16 +4023,72 @@ static void SDLGPU_INTERNAL_SetBufferData(
 		cycle
 	);
 
-	if (usingTemporaryTransferBuffer)
+	if (!upload->pooled)
+	{
+		renderer->bufferUploadBufferOffset += upload->dataLength;
+	}
+
+	/* Every buffer upload goes through a mapped transfer buffer */
+	if (renderer->perf.enabled)
+	{
+		FNA3D_PERF_ADD(renderer->perf, mapWrites, 1);
+		FNA3D_PERF_ADD(renderer->perf, mapBytes, upload->dataLength);
+		if (isIndexBuffer)
+		{
+			FNA3D_PERF_ADD(renderer->perf, indexUploadCalls, 1);
+			FNA3D_PERF_ADD(renderer->perf, indexUploadBytes, upload->dataLength);
+		}
+		else
+		{
+			FNA3D_PERF_ADD(renderer->perf, vertexUploadCalls, 1);
+			FNA3D_PERF_ADD(renderer->perf, vertexUploadBytes, upload->dataLength);
+		}
+	}
+
+	SDL_UnlockMutex(renderer->copyPassMutex);
+}
+
+static void SDLGPU_INTERNAL_SetBufferData(
+	SDLGPU_Renderer *renderer,
+	SDL_GPUBuffer *buffer,
+	uint32_t dstOffset,
+	void *data,
+	uint32_t dataLength,
+	bool cycle,
+	uint8_t isIndexBuffer
+) {
+	SDLGPU_BufferUpload upload;
+	uint8_t *dst = SDLGPU_INTERNAL_BeginBufferUpload(
+		renderer,
+		dataLength,
+		&upload
+	);
+	SDL_memcpy(dst, data, dataLength);
+	SDLGPU_INTERNAL_EndBufferUpload(
+		renderer,
+		&upload,
+		buffer,
+		dstOffset,
+		cycle,
+		isIndexBuffer
+	);
+}
+
+static inline bool SDLGPU_INTERNAL_ShouldCycle(
+	SDLGPU_BufferHandle *bufferHandle,
+	uint32_t dataLength,
+	FNA3D_SetDataOptions options
+) {
+	if (options == FNA3D_SETDATAOPTIONS_DISCARD)
 	{
-		SDL_ReleaseGPUTransferBuffer(renderer->device, transferBuffer);
+		return true;
 	}
-	else
+	else if (options == FNA3D_SETDATAOPTIONS_NONE && dataLength == bufferHandle->size)
 	{
-		renderer->bufferUploadBufferOffset += dataLength;
+		/* full buffer update can cycle for efficiency */
+		return true;
 	}
-
-	SDL_UnlockMutex(renderer->copyPassMutex);
+	return false;
 }
 
 static void SDLGPU_SetVertexBufferData(
@@ -3453,66 +4102,90 @@ static void SDLGPU_SetVertexBufferData(
 	FNA3D_SetDataOptions options
 ) {
 	SDLGPU_BufferHandle *bufferHandle = (SDLGPU_BufferHandle*) buffer;
-
-	bool cycle;
 	uint32_t dataLen = (uint32_t) elementCount * (uint32_t) vertexStride;
 
-	if (options == FNA3D_SETDATAOPTIONS_DISCARD)
-	{
-		cycle = true;
-	}
-	else if (options == FNA3D_SETDATAOPTIONS_NONE && dataLen == bufferHandle->size)
-	{
-		/* full buffer update can cycle for efficiency */
-		cycle = true;
-	}
-	else
-	{
-		cycle = false;
-	}
-
 	SDLGPU_INTERNAL_SetBufferData(
 		(SDLGPU_Renderer*) driverData,
 		bufferHandle->buffer,
 		(uint32_t) offsetInBytes,
 		data,
-		elementCount * vertexStride,
-		cycle
+		dataLen,
+		SDLGPU_INTERNAL_ShouldCycle(bufferHandle, dataLen, options),
+		0
 	);
 }
 
-static void SDLGPU_SetIndexBufferData(
+static void* SDLGPU_MapVertexBufferRange(
 	FNA3D_Renderer *driverData,
 	FNA3D_Buffer *buffer,
 	int32_t offsetInBytes,
-	void* data,
-	int32_t dataLength,
+	int32_t lengthInBytes,
 	FNA3D_SetDataOptions options
 ) {
-	SDLGPU_BufferHandle *bufferHandle = (SDLGPU_BufferHandle*) buffer;
+	SDLGPU_Renderer *renderer = (SDLGPU_Renderer*) driverData;
 
-	bool cycle;
-	if (options == FNA3D_SETDATAOPTIONS_DISCARD)
-	{
-		cycle = true;
-	}
-	else if (options == FNA3D_SETDATAOPTIONS_NONE && dataLength == bufferHandle->size)
-	{
-		/* full buffer update can cycle for efficiency */
-		cycle = true;
+	if (!FNA3D_MappedRange_Begin(
+		&renderer->mappedRange,
+		buffer,
+		offsetInBytes,
+		lengthInBytes,
+		options
+	)) {
+		return NULL;
 	}
-	else
+
+	/* The client writes straight into the transfer buffer */
+	return SDLGPU_INTERNAL_BeginBufferUpload(
+		renderer,
+		(uint32_t) lengthInBytes,
+		&renderer->mappedUpload
+	);
+}
+
+static void SDLGPU_UnmapVertexBufferRange(
+	FNA3D_Renderer *driverData,
+	FNA3D_Buffer *buffer
+) {
+	SDLGPU_Renderer *renderer = (SDLGPU_Renderer*) driverData;
+	SDLGPU_BufferHandle *bufferHandle = (SDLGPU_BufferHandle*) buffer;
+
+	if (!FNA3D_MappedRange_End(&renderer->mappedRange, buffer))
 	{
-		cycle = false;
+		return;
 	}
 
+	SDLGPU_INTERNAL_EndBufferUpload(
+		renderer,
+		&renderer->mappedUpload,
+		bufferHandle->buffer,
+		(uint32_t) renderer->mappedRange.offsetInBytes,
+		SDLGPU_INTERNAL_ShouldCycle(
+			bufferHandle,
+			(uint32_t) renderer->mappedRange.lengthInBytes,
+			renderer->mappedRange.options
+		),
+		0
+	);
+}
+
+static void SDLGPU_SetIndexBufferData(
+	FNA3D_Renderer *driverData,
+	FNA3D_Buffer *buffer,
+	int32_t offsetInBytes,
+	void* data,
+	int32_t dataLength,
+	FNA3D_SetDataOptions options
+) {
+	SDLGPU_BufferHandle *bufferHandle = (SDLGPU_BufferHandle*) buffer;
+
 	SDLGPU_INTERNAL_SetBufferData(
 		(SDLGPU_Renderer*) driverData,
 		bufferHandle->buffer,
 		(uint32_t) offsetInBytes,
 		data,
 		dataLength,
-		cycle
+		SDLGPU_INTERNAL_ShouldCycle(bufferHandle, (uint32_t) dataLength, options),
+		1
 	);
 }
 
@@ -3818,8 +4491,305 @@ static void SDLGPU_ReadBackbuffer(
 	);
 }
 
+static FNA3D_Readback* SDLGPU_RequestTextureDataAsync(
+	FNA3D_Renderer *driverData,
+	FNA3D_Texture *texture,
+	int32_t x,
+	int32_t y,
+	int32_t w,
+	int32_t h,
+	int32_t level,
+	int32_t dataLength
+) {
+	SDLGPU_Renderer *renderer = (SDLGPU_Renderer*) driverData;
+	SDLGPU_Readback *readback;
+	SDL_GPUTransferBufferCreateInfo transferBufferCreateInfo;
+	SDL_GPUTextureRegion region;
+	SDL_GPUTextureTransferInfo textureCopyParams;
+
+	readback = (SDLGPU_Readback*) SDL_malloc(sizeof(SDLGPU_Readback));
+	readback->base.dataLength = dataLength;
+	readback->base.data = NULL;
+
+	transferBufferCreateInfo.usage = SDL_GPU_TRANSFERBUFFERUSAGE_DOWNLOAD;
+	transferBufferCreateInfo.size = (uint32_t) dataLength;
+	transferBufferCreateInfo.props = 0;
+	readback->transferBuffer = SDL_CreateGPUTransferBuffer(
+		renderer->device,
+		&transferBufferCreateInfo
+	);
+	if (readback->transferBuffer == NULL)
+	{
+		FNA3D_LogError(
+			"Failed to create readback transfer buffer: %s",
+			SDL_GetError()
+		);
+		SDL_free(readback);
+		return NULL;
+	}
+
+	if (texture == NULL)
+	{
+		region.texture = renderer->fauxBackbufferColorTexture->texture;
+		region.mip_level = 0;
+	}
+	else
+	{
+		region.texture = ((SDLGPU_TextureHandle*) texture)->texture;
+		region.mip_level = (uint32_t) level;
+	}
+	region.layer = 0;
+	region.x = (uint32_t) x;
+	region.y = (uint32_t) y;
+	region.z = 0;
+	region.w = (uint32_t) w;
+	region.h = (uint32_t) h;
+	region.d = 1;
+
+	/* All zeroes, assume tight packing */
+	textureCopyParams.transfer_buffer = readback->transferBuffer;
+	textureCopyParams.offset = 0;
+	textureCopyParams.pixels_per_row = 0;
+	textureCopyParams.rows_per_layer = 0;
+
+	SDL_LockMutex(renderer->copyPassMutex);
+
+	/* Same as GetTextureData, except that nobody waits on the result */
+	SDLGPU_INTERNAL_FlushCommands(renderer);
+
+	SDL_DownloadFromGPUTexture(
+		renderer->copyPass,
+		&region,
+		&textureCopyParams
+	);
+
+	/* The flush sent every pooled upload, so this fence is ours alone */
+	SDLGPU_INTERNAL_EndCopyPass(renderer);
+	readback->fence = SDL_SubmitGPUCommandBufferAndAcquireFence(
+		renderer->uploadCommandBuffer
+	);
+	SDLGPU_INTERNAL_ResetUploadCommandBufferState(renderer);
+
+	SDL_UnlockMutex(renderer->copyPassMutex);
+
+	if (readback->fence == NULL)
+	{
+		FNA3D_LogError(
+			"SDL_SubmitGPUCommandBufferAndAcquireFence failed: %s",
+			SDL_GetError()
+		);
+		SDL_ReleaseGPUTransferBuffer(
+			renderer->device,
+			readback->transferBuffer
+		);
+		SDL_free(readback);
+		return NULL;
+	}
+	return &readback->base;
+}
+
+static uint8_t SDLGPU_PollReadback(
+	FNA3D_Renderer *driverData,
+	FNA3D_Readback *readback,
+	void* data,
+	int32_t dataLength
+) {
+	SDLGPU_Renderer *renderer = (SDLGPU_Renderer*) driverData;
+	SDLGPU_Readback *sdlReadback = (SDLGPU_Readback*) readback;
+	uint8_t *src;
+
+	if (data != NULL)
+	{
+		if (!SDL_QueryGPUFence(renderer->device, sdlReadback->fence))
+		{
+			return 0;
+		}
+
+		src = (uint8_t*) SDL_MapGPUTransferBuffer(
+			renderer->device,
+			sdlReadback->transferBuffer,
+			false
+		);
+		SDL_memcpy(data, src, SDL_min(dataLength, readback->dataLength));
+		SDL_UnmapGPUTransferBuffer(
+			renderer->device,
+			sdlReadback->transferBuffer
+		);
+	}
+
+	/* Releases are deferred by SDL, so canceling early is fine too */
+	SDL_ReleaseGPUFence(renderer->device, sdlReadback->fence);
+	SDL_ReleaseGPUTransferBuffer(
+		renderer->device,
+		sdlReadback->transferBuffer
+	);
+	SDL_free(sdlReadback);
+	return 1;
+}
+
 /* Effects */
 
+static MOJOSHADER_sdlShaderData* SDLGPU_INTERNAL_GetEffectShader(
+	MOJOSHADER_effect *effect,
+	uint16_t object,
+	MOJOSHADER_symbolType type
+) {
+	if (	object >= effect->object_count ||
+		effect->objects[object].type != type ||
+		effect->objects[object].shader.is_preshader	)
+	{
+		return NULL;
+	}
+	return (MOJOSHADER_sdlShaderData*) effect->objects[object].shader.shader;
+}
+
+static void SDLGPU_INTERNAL_PrewarmEffect(
+	SDLGPU_Renderer *renderer,
+	uint8_t *effectCode,
+	uint32_t effectCodeLength,
+	MOJOSHADER_effect *effect
+) {
+	FNA3D_PipelineManifestEntry *entries, *entry;
+	MOJOSHADER_sdlShaderData *prevVertShader, *prevFragShader;
+	MOJOSHADER_sdlShaderData *vertShader, *fragShader;
+	SDLGPU_PipelineJob *job;
+	SDL_GPUTextureFormat depthFormat;
+	void* bindingsResult;
+	uint32_t bindingsHash;
+	int32_t count, i, j, bindingsIndex;
+
+	count = FNA3D_PipelineManifest_FindEffect(
+		renderer->pipelineManifest,
+		effectCode,
+		effectCodeLength,
+		&entries
+	);
+	if (count == 0 || effect->error_count > 0)
+	{
+		return;
+	}
+
+	if (SDLGPU_INTERNAL_GetPipelineCompiler(renderer) == NULL)
+	{
+		return;
+	}
+
+	/* Linking goes through the bound shaders, so put them back after */
+	MOJOSHADER_sdlGetBoundShaderData(
+		renderer->mojoshaderContext,
+		&prevVertShader,
+		&prevFragShader
+	);
+
+	for (i = 0; i < count; i += 1)
+	{
+		entry = &entries[i];
+		vertShader = SDLGPU_INTERNAL_GetEffectShader(
+			effect,
+			entry->vertexShaderObject,
+			MOJOSHADER_SYMTYPE_VERTEXSHADER
+		);
+		fragShader = SDLGPU_INTERNAL_GetEffectShader(
+			effect,
+			entry->pixelShaderObject,
+			MOJOSHADER_SYMTYPE_PIXELSHADER
+		);
+		if (vertShader == NULL || fragShader == NULL)
+		{
+			FNA3D_LogWarn("Pipeline manifest does not match effect, skipping");
+			continue;
+		}
+		MOJOSHADER_sdlBindShaders(
+			renderer->mojoshaderContext,
+			vertShader,
+			fragShader
+		);
+
+		/* Same as ApplyVertexBufferBindings, so the hash will match */
+		bindingsResult = PackedVertexBufferBindingsArray_Fetch(
+			&renderer->vertexBufferBindingsCache,
+			entry->bindings,
+			entry->numBindings,
+			vertShader,
+			&bindingsIndex,
+			&bindingsHash
+		);
+		if (bindingsResult == NULL)
+		{
+			PackedVertexBufferBindingsArray_Insert(
+				&renderer->vertexBufferBindingsCache,
+				entry->bindings,
+				entry->numBindings,
+				vertShader,
+				bindingsHash,
+				(void*) 69420
+			);
+		}
+
+		job = (SDLGPU_PipelineJob*) SDL_malloc(sizeof(SDLGPU_PipelineJob));
+		job->blendState = entry->blendState;
+		job->depthStencilState = entry->depthStencilState;
+		job->rasterizerState = entry->rasterizerState;
+
+		job->hash.vertexBufferBindingsIndex = bindingsIndex;
+		job->hash.primitiveType = (uint8_t) entry->primitiveType;
+		job->hash.sampleCount = (uint8_t) XNAToSDL_SampleCount(entry->multiSampleCount);
+		job->hash.sampleMask = (uint32_t) entry->multiSampleMask;
+
+		job->hash.colorFormatCount = (uint8_t) entry->colorFormatCount;
+		for (j = 0; j < MAX_RENDERTARGET_BINDINGS; j += 1)
+		{
+			job->hash.colorFormats[j] = (uint8_t) ((j < entry->colorFormatCount) ?
+				XNAToSDL_SurfaceFormat[entry->colorFormats[j]] :
+				SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM);
+		}
+
+		/* ApplyRasterizerState scales for D16 when there is no depth target */
+		depthFormat = (entry->depthFormat != FNA3D_DEPTHFORMAT_NONE) ?
+			XNAToSDL_DepthFormat(renderer, entry->depthFormat) :
+			SDL_GPU_TEXTUREFORMAT_INVALID;
+		job->hash.depthStencilFormat = (uint8_t) depthFormat;
+		job->rasterizerState.depthBias *= XNAToSDL_DepthBiasScale(
+			(depthFormat != SDL_GPU_TEXTUREFORMAT_INVALID) ?
+				depthFormat :
+				SDL_GPU_TEXTUREFORMAT_D16_UNORM
+		);
+
+		SDLGPU_INTERNAL_LinkGraphicsPipeline(
+			renderer,
+			job,
+			entry->bindings,
+			entry->numBindings
+		);
+		if (
+			GraphicsPipelineHashTable_Fetch(
+				&renderer->graphicsPipelineHashTable,
+				&job->hash
+			) != NULL ||
+			SDLGPU_INTERNAL_FindPipelineJob(renderer, &job->hash) != NULL
+		) {
+			SDL_free(job);
+			continue;
+		}
+		SDLGPU_INTERNAL_FillGraphicsPipelineCreateInfo(job);
+
+		/* The linked program's shaders have to outlive the job */
+		MOJOSHADER_sdlShaderAddRef(vertShader);
+		MOJOSHADER_sdlShaderAddRef(fragShader);
+		job->vertShaderData = vertShader;
+		job->fragShaderData = fragShader;
+
+		SDLGPU_INTERNAL_SubmitPipelineJob(renderer, job, 0);
+	}
+
+	MOJOSHADER_sdlBindShaders(
+		renderer->mojoshaderContext,
+		prevVertShader,
+		prevFragShader
+	);
+	renderer->needNewGraphicsPipeline = 1;
+}
+
 static void SDLGPU_CreateEffect(
 	FNA3D_Renderer *driverData,
 	uint8_t *effectCode,
@@ -3867,6 +4837,16 @@ static void SDLGPU_CreateEffect(
 	result = (SDLGPU_Effect*) SDL_malloc(sizeof(SDLGPU_Effect));
 	result->effect = *effectData;
 	*effect = (FNA3D_Effect*) result;
+
+	if (renderer->pipelineManifest != NULL)
+	{
+		SDLGPU_INTERNAL_PrewarmEffect(
+			renderer,
+			effectCode,
+			effectCodeLength,
+			*effectData
+		);
+	}
 }
 
 static void SDLGPU_CloneEffect(
@@ -3890,6 +4870,17 @@ static void SDLGPU_CloneEffect(
 	*effect = (FNA3D_Effect*) result;
 }
 
+static void SDLGPU_PrewarmPipelines(
+	FNA3D_Renderer *driverData,
+	FNA3D_PipelineManifest *manifest
+) {
+	SDLGPU_Renderer *renderer = (SDLGPU_Renderer*) driverData;
+
+	/* Effects are prewarmed as they're created, see CreateEffect */
+	FNA3D_PipelineManifest_Destroy(renderer->pipelineManifest);
+	renderer->pipelineManifest = manifest;
+}
+
 /* TODO: check if we need to defer this */
 static void SDLGPU_AddDisposeEffect(
 	FNA3D_Renderer *driverData,
@@ -3932,6 +4923,11 @@ static void SDLGPU_ApplyEffect(
 	const MOJOSHADER_effectTechnique *technique = gpuEffect->effect->current_technique;
 	uint32_t numPasses;
 
+	if (renderer->perf.enabled)
+	{
+		FNA3D_PERF_ADD(renderer->perf, applyEffectCalls, 1);
+	}
+
 	renderer->needFragmentSamplerBind = 1;
 	renderer->needVertexSamplerBind = 1;
 	renderer->needNewGraphicsPipeline = 1;
@@ -4108,6 +5104,16 @@ static int32_t SDLGPU_GetMaxMultiSampleCount(
 	return 1;
 }
 
+/* Performance Counters */
+
+static void SDLGPU_GetPerfCounters(
+	FNA3D_Renderer *driverData,
+	FNA3D_PerfCounters *counters
+) {
+	SDLGPU_Renderer *renderer = (SDLGPU_Renderer*) driverData;
+	FNA3D_PerfState_Get(&renderer->perf, counters);
+}
+
 /* Debugging */
 
 static void SDLGPU_SetStringMarker(
@@ -4196,9 +5202,20 @@ static void SDLGPU_DestroyDevice(FNA3D_Device *device)
 
 	SDL_ReleaseGPUTransferBuffer(renderer->device, renderer->textureUploadBuffer);
 	SDL_ReleaseGPUTransferBuffer(renderer->device, renderer->bufferUploadBuffer);
+	SDLGPU_INTERNAL_DestroyTransferPool(renderer);
 
 	SDLGPU_INTERNAL_DestroyFauxBackbuffer(renderer);
 
+	if (renderer->pipelineCompiler != NULL)
+	{
+		SDLGPU_INTERNAL_PublishPipelineJobs(
+			renderer,
+			FNA3D_PipelineCompiler_Destroy(renderer->pipelineCompiler)
+		);
+	}
+	SDL_free(renderer->pipelineJobs);
+	FNA3D_PipelineManifest_Destroy(renderer->pipelineManifest);
+
 	for (i = 0; i < NUM_PIPELINE_HASH_BUCKETS; i += 1)
 	{
 		for (j = 0; j < renderer->graphicsPipelineHashTable.buckets[i].count; j += 1)
@@ -4210,13 +5227,19 @@ static void SDLGPU_DestroyDevice(FNA3D_Device *device)
 		}
 	}
 
-	for (i = 0; i < renderer->samplerStateArray.count; i += 1)
+	for (i = 0; i < renderer->samplerStateTable.capacity; i += 1)
 	{
-		SDL_ReleaseGPUSampler(
-			renderer->device,
-			renderer->samplerStateArray.elements[i].value
-		);
+		if (renderer->samplerStateTable.elements[i].value != NULL)
+		{
+			SDL_ReleaseGPUSampler(
+				renderer->device,
+				(SDL_GPUSampler*) renderer->samplerStateTable.elements[i].value
+			);
+		}
 	}
+	SDL_free(renderer->samplerStateTable.elements);
+
+	PackedVertexBufferBindingsArray_Destroy(&renderer->vertexBufferBindingsCache);
 
 	SDL_ReleaseGPUTexture(
 		renderer->device,
@@ -4331,9 +5354,16 @@ static FNA3D_Device* SDLGPU_CreateDevice(
 
 	renderer->device = device;
 	renderer->copyPassMutex = SDL_CreateMutex();
+	FNA3D_PerfState_Init(&renderer->perf);
+	FNA3D_FramePacer_Init(
+		&renderer->pacer,
+		presentationParameters->deviceWindowHandle
+	);
 
 	result->driverData = (FNA3D_Renderer*) renderer;
 
+	renderer->asyncPipelines = SDL_GetHintBoolean("FNA3D_ASYNC_PIPELINES", false);
+
 	swapchainComposition = SDL_GPU_SWAPCHAINCOMPOSITION_SDR;
 
 	if (SDL_GetHintBoolean("FNA3D_ENABLE_HDR_COLORSPACE", false))
@@ -34,15 +34,15 @@
 /* Format Conversion Tables */
 static const VkFormat FNA3DToVkFormat[] = {
 	VK_FORMAT_R8G8B8A8_UNORM,          /* FNA3D_SURFACEFORMAT_COLOR */
-	VK_FORMAT_B5G6R5_UNORM_PACK16,     /* FNA3D_SURFACEFORMAT_BGR565 */
-	VK_FORMAT_B5G5R5A1_UNORM_PACK16,   /* FNA3D_SURFACEFORMAT_BGRA5551 */
+	VK_FORMAT_R5G6B5_UNORM_PACK16,     /* FNA3D_SURFACEFORMAT_BGR565 */
+	VK_FORMAT_A1R5G5B5_UNORM_PACK16,   /* FNA3D_SURFACEFORMAT_BGRA5551 */
 	VK_FORMAT_B4G4R4A4_UNORM_PACK16,   /* FNA3D_SURFACEFORMAT_BGRA4444 */
 	VK_FORMAT_BC1_RGBA_UNORM_BLOCK,    /* FNA3D_SURFACEFORMAT_DXT1 */
 	VK_FORMAT_BC2_UNORM_BLOCK,         /* FNA3D_SURFACEFORMAT_DXT3 */
 	VK_FORMAT_BC3_UNORM_BLOCK,         /* FNA3D_SURFACEFORMAT_DXT5 */
 	VK_FORMAT_R8G8_SNORM,              /* FNA3D_SURFACEFORMAT_NORMALIZEDBYTE2 */
 	VK_FORMAT_R8G8B8A8_SNORM,          /* FNA3D_SURFACEFORMAT_NORMALIZEDBYTE4 */
-	VK_FORMAT_A2R10G10B10_UNORM_PACK32,/* FNA3D_SURFACEFORMAT_RGBA1010102 */
+	VK_FORMAT_A2B10G10R10_UNORM_PACK32,/* FNA3D_SURFACEFORMAT_RGBA1010102 */
 	VK_FORMAT_R16G16_UNORM,            /* FNA3D_SURFACEFORMAT_RG32 */
 	VK_FORMAT_R16G16B16A16_UNORM,      /* FNA3D_SURFACEFORMAT_RGBA64 */
 	VK_FORMAT_R8_UNORM,                /* FNA3D_SURFACEFORMAT_ALPHA8 */
@@ -53,8 +53,11 @@ static const VkFormat FNA3DToVkFormat[] = {
 	VK_FORMAT_R16G16_SFLOAT,           /* FNA3D_SURFACEFORMAT_HALFVECTOR2 */
 	VK_FORMAT_R16G16B16A16_SFLOAT,     /* FNA3D_SURFACEFORMAT_HALFVECTOR4 */
 	VK_FORMAT_R16G16B16A16_SFLOAT,     /* FNA3D_SURFACEFORMAT_HDRBLENDABLE */
-	VK_FORMAT_R8G8B8A8_SRGB,           /* FNA3D_SURFACEFORMAT_COLORBGRA_EXT */
-	VK_FORMAT_BC7_UNORM_BLOCK,         /* FNA3D_SURFACEFORMAT_COLORSRGB_EXT */
+	VK_FORMAT_B8G8R8A8_UNORM,          /* FNA3D_SURFACEFORMAT_COLORBGRA_EXT */
+	VK_FORMAT_R8G8B8A8_SRGB,           /* FNA3D_SURFACEFORMAT_COLORSRGB_EXT */
+	VK_FORMAT_BC3_SRGB_BLOCK,          /* FNA3D_SURFACEFORMAT_DXT5SRGB_EXT */
+	VK_FORMAT_BC7_UNORM_BLOCK,         /* FNA3D_SURFACEFORMAT_BC7_EXT */
+	VK_FORMAT_BC7_SRGB_BLOCK,          /* FNA3D_SURFACEFORMAT_BC7SRGB_EXT */
 };
 
 static const VkFormat FNA3DToVkDepthFormat[] = {
@@ -74,6 +77,175 @@ VkFormat VULKAN_INTERNAL_GetVkDepthFormat(FNA3D_DepthFormat format)
 	return FNA3DToVkDepthFormat[format];
 }
 
+/* Formats that have no exact Vulkan equivalent are stored in a compatible
+ * format and fixed up with the image view swizzle.
+ */
+static VkComponentMapping VULKAN_INTERNAL_GetSwizzle(FNA3D_SurfaceFormat format)
+{
+	VkComponentMapping swizzle = {
+		VK_COMPONENT_SWIZZLE_IDENTITY,
+		VK_COMPONENT_SWIZZLE_IDENTITY,
+		VK_COMPONENT_SWIZZLE_IDENTITY,
+		VK_COMPONENT_SWIZZLE_IDENTITY
+	};
+	if (format == FNA3D_SURFACEFORMAT_ALPHA8) {
+		swizzle.r = VK_COMPONENT_SWIZZLE_ZERO;
+		swizzle.g = VK_COMPONENT_SWIZZLE_ZERO;
+		swizzle.b = VK_COMPONENT_SWIZZLE_ZERO;
+		swizzle.a = VK_COMPONENT_SWIZZLE_R;
+	} else if (format == FNA3D_SURFACEFORMAT_BGRA4444) {
+		/* Bgra4444 is A4R4G4B4 in memory, read back as B4G4R4A4 */
+		swizzle.r = VK_COMPONENT_SWIZZLE_G;
+		swizzle.g = VK_COMPONENT_SWIZZLE_R;
+		swizzle.b = VK_COMPONENT_SWIZZLE_A;
+		swizzle.a = VK_COMPONENT_SWIZZLE_B;
+	}
+	return swizzle;
+}
+
+static const VkPrimitiveTopology XNAToVK_Topology[] = {
+	VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,   /* FNA3D_PRIMITIVETYPE_TRIANGLELIST */
+	VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP,  /* FNA3D_PRIMITIVETYPE_TRIANGLESTRIP */
+	VK_PRIMITIVE_TOPOLOGY_LINE_LIST,       /* FNA3D_PRIMITIVETYPE_LINELIST */
+	VK_PRIMITIVE_TOPOLOGY_LINE_STRIP,      /* FNA3D_PRIMITIVETYPE_LINESTRIP */
+	VK_PRIMITIVE_TOPOLOGY_POINT_LIST,      /* FNA3D_PRIMITIVETYPE_POINTLIST_EXT */
+};
+
+static const VkIndexType XNAToVK_IndexType[] = {
+	VK_INDEX_TYPE_UINT16,                  /* FNA3D_INDEXELEMENTSIZE_16BIT */
+	VK_INDEX_TYPE_UINT32,                  /* FNA3D_INDEXELEMENTSIZE_32BIT */
+};
+
+static const VkBlendFactor XNAToVK_BlendFactor[] = {
+	VK_BLEND_FACTOR_ONE,                      /* FNA3D_BLEND_ONE */
+	VK_BLEND_FACTOR_ZERO,                     /* FNA3D_BLEND_ZERO */
+	VK_BLEND_FACTOR_SRC_COLOR,                /* FNA3D_BLEND_SOURCECOLOR */
+	VK_BLEND_FACTOR_ONE_MINUS_SRC_COLOR,      /* FNA3D_BLEND_INVERSESOURCECOLOR */
+	VK_BLEND_FACTOR_SRC_ALPHA,                /* FNA3D_BLEND_SOURCEALPHA */
+	VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,      /* FNA3D_BLEND_INVERSESOURCEALPHA */
+	VK_BLEND_FACTOR_DST_COLOR,                /* FNA3D_BLEND_DESTINATIONCOLOR */
+	VK_BLEND_FACTOR_ONE_MINUS_DST_COLOR,      /* FNA3D_BLEND_INVERSEDESTINATIONCOLOR */
+	VK_BLEND_FACTOR_DST_ALPHA,                /* FNA3D_BLEND_DESTINATIONALPHA */
+	VK_BLEND_FACTOR_ONE_MINUS_DST_ALPHA,      /* FNA3D_BLEND_INVERSEDESTINATIONALPHA */
+	VK_BLEND_FACTOR_CONSTANT_COLOR,           /* FNA3D_BLEND_BLENDFACTOR */
+	VK_BLEND_FACTOR_ONE_MINUS_CONSTANT_COLOR, /* FNA3D_BLEND_INVERSEBLENDFACTOR */
+	VK_BLEND_FACTOR_SRC_ALPHA_SATURATE,       /* FNA3D_BLEND_SOURCEALPHASATURATION */
+};
+
+static const VkBlendOp XNAToVK_BlendOp[] = {
+	VK_BLEND_OP_ADD,                       /* FNA3D_BLENDFUNCTION_ADD */
+	VK_BLEND_OP_SUBTRACT,                  /* FNA3D_BLENDFUNCTION_SUBTRACT */
+	VK_BLEND_OP_REVERSE_SUBTRACT,          /* FNA3D_BLENDFUNCTION_REVERSESUBTRACT */
+	VK_BLEND_OP_MAX,                       /* FNA3D_BLENDFUNCTION_MAX */
+	VK_BLEND_OP_MIN,                       /* FNA3D_BLENDFUNCTION_MIN */
+};
+
+static const VkCompareOp XNAToVK_CompareOp[] = {
+	VK_COMPARE_OP_ALWAYS,                  /* FNA3D_COMPAREFUNCTION_ALWAYS */
+	VK_COMPARE_OP_NEVER,                   /* FNA3D_COMPAREFUNCTION_NEVER */
+	VK_COMPARE_OP_LESS,                    /* FNA3D_COMPAREFUNCTION_LESS */
+	VK_COMPARE_OP_LESS_OR_EQUAL,           /* FNA3D_COMPAREFUNCTION_LESSEQUAL */
+	VK_COMPARE_OP_EQUAL,                   /* FNA3D_COMPAREFUNCTION_EQUAL */
+	VK_COMPARE_OP_GREATER_OR_EQUAL,        /* FNA3D_COMPAREFUNCTION_GREATEREQUAL */
+	VK_COMPARE_OP_GREATER,                 /* FNA3D_COMPAREFUNCTION_GREATER */
+	VK_COMPARE_OP_NOT_EQUAL,               /* FNA3D_COMPAREFUNCTION_NOTEQUAL */
+};
+
+static const VkStencilOp XNAToVK_StencilOp[] = {
+	VK_STENCIL_OP_KEEP,                    /* FNA3D_STENCILOPERATION_KEEP */
+	VK_STENCIL_OP_ZERO,                    /* FNA3D_STENCILOPERATION_ZERO */
+	VK_STENCIL_OP_REPLACE,                 /* FNA3D_STENCILOPERATION_REPLACE */
+	VK_STENCIL_OP_INCREMENT_AND_WRAP,      /* FNA3D_STENCILOPERATION_INCREMENT */
+	VK_STENCIL_OP_DECREMENT_AND_WRAP,      /* FNA3D_STENCILOPERATION_DECREMENT */
+	VK_STENCIL_OP_INCREMENT_AND_CLAMP,     /* FNA3D_STENCILOPERATION_INCREMENTSATURATION */
+	VK_STENCIL_OP_DECREMENT_AND_CLAMP,     /* FNA3D_STENCILOPERATION_DECREMENTSATURATION */
+	VK_STENCIL_OP_INVERT,                  /* FNA3D_STENCILOPERATION_INVERT */
+};
+
+static const VkPolygonMode XNAToVK_PolygonMode[] = {
+	VK_POLYGON_MODE_FILL,                  /* FNA3D_FILLMODE_SOLID */
+	VK_POLYGON_MODE_LINE,                  /* FNA3D_FILLMODE_WIREFRAME */
+};
+
+static const VkCullModeFlags XNAToVK_CullMode[] = {
+	VK_CULL_MODE_NONE,                     /* FNA3D_CULLMODE_NONE */
+	VK_CULL_MODE_FRONT_BIT,                /* FNA3D_CULLMODE_CULLCLOCKWISEFACE */
+	VK_CULL_MODE_BACK_BIT,                 /* FNA3D_CULLMODE_CULLCOUNTERCLOCKWISEFACE */
+};
+
+static const VkFilter XNAToVK_MagFilter[] = {
+	VK_FILTER_LINEAR,                      /* FNA3D_TEXTUREFILTER_LINEAR */
+	VK_FILTER_NEAREST,                     /* FNA3D_TEXTUREFILTER_POINT */
+	VK_FILTER_LINEAR,                      /* FNA3D_TEXTUREFILTER_ANISOTROPIC */
+	VK_FILTER_LINEAR,                      /* FNA3D_TEXTUREFILTER_LINEAR_MIPPOINT */
+	VK_FILTER_NEAREST,                     /* FNA3D_TEXTUREFILTER_POINT_MIPLINEAR */
+	VK_FILTER_NEAREST,                     /* FNA3D_TEXTUREFILTER_MINLINEAR_MAGPOINT_MIPLINEAR */
+	VK_FILTER_NEAREST,                     /* FNA3D_TEXTUREFILTER_MINLINEAR_MAGPOINT_MIPPOINT */
+	VK_FILTER_LINEAR,                      /* FNA3D_TEXTUREFILTER_MINPOINT_MAGLINEAR_MIPLINEAR */
+	VK_FILTER_LINEAR,                      /* FNA3D_TEXTUREFILTER_MINPOINT_MAGLINEAR_MIPPOINT */
+};
+
+static const VkFilter XNAToVK_MinFilter[] = {
+	VK_FILTER_LINEAR,                      /* FNA3D_TEXTUREFILTER_LINEAR */
+	VK_FILTER_NEAREST,                     /* FNA3D_TEXTUREFILTER_POINT */
+	VK_FILTER_LINEAR,                      /* FNA3D_TEXTUREFILTER_ANISOTROPIC */
+	VK_FILTER_LINEAR,                      /* FNA3D_TEXTUREFILTER_LINEAR_MIPPOINT */
+	VK_FILTER_NEAREST,                     /* FNA3D_TEXTUREFILTER_POINT_MIPLINEAR */
+	VK_FILTER_LINEAR,                      /* FNA3D_TEXTUREFILTER_MINLINEAR_MAGPOINT_MIPLINEAR */
+	VK_FILTER_LINEAR,                      /* FNA3D_TEXTUREFILTER_MINLINEAR_MAGPOINT_MIPPOINT */
+	VK_FILTER_NEAREST,                     /* FNA3D_TEXTUREFILTER_MINPOINT_MAGLINEAR_MIPLINEAR */
+	VK_FILTER_NEAREST,                     /* FNA3D_TEXTUREFILTER_MINPOINT_MAGLINEAR_MIPPOINT */
+};
+
+static const VkSamplerMipmapMode XNAToVK_MipFilter[] = {
+	VK_SAMPLER_MIPMAP_MODE_LINEAR,         /* FNA3D_TEXTUREFILTER_LINEAR */
+	VK_SAMPLER_MIPMAP_MODE_NEAREST,        /* FNA3D_TEXTUREFILTER_POINT */
+	VK_SAMPLER_MIPMAP_MODE_LINEAR,         /* FNA3D_TEXTUREFILTER_ANISOTROPIC */
+	VK_SAMPLER_MIPMAP_MODE_NEAREST,        /* FNA3D_TEXTUREFILTER_LINEAR_MIPPOINT */
+	VK_SAMPLER_MIPMAP_MODE_LINEAR,         /* FNA3D_TEXTUREFILTER_POINT_MIPLINEAR */
+	VK_SAMPLER_MIPMAP_MODE_LINEAR,         /* FNA3D_TEXTUREFILTER_MINLINEAR_MAGPOINT_MIPLINEAR */
+	VK_SAMPLER_MIPMAP_MODE_NEAREST,        /* FNA3D_TEXTUREFILTER_MINLINEAR_MAGPOINT_MIPPOINT */
+	VK_SAMPLER_MIPMAP_MODE_LINEAR,         /* FNA3D_TEXTUREFILTER_MINPOINT_MAGLINEAR_MIPLINEAR */
+	VK_SAMPLER_MIPMAP_MODE_NEAREST,        /* FNA3D_TEXTUREFILTER_MINPOINT_MAGLINEAR_MIPPOINT */
+};
+
+static const VkSamplerAddressMode XNAToVK_SamplerAddressMode[] = {
+	VK_SAMPLER_ADDRESS_MODE_REPEAT,          /* FNA3D_TEXTUREADDRESSMODE_WRAP */
+	VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,   /* FNA3D_TEXTUREADDRESSMODE_CLAMP */
+	VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT, /* FNA3D_TEXTUREADDRESSMODE_MIRROR */
+};
+
+/* Scaled formats keep the float inputs MojoShader declares for every usage */
+static const VkFormat XNAToVK_VertexAttribType[] = {
+	VK_FORMAT_R32_SFLOAT,                  /* FNA3D_VERTEXELEMENTFORMAT_SINGLE */
+	VK_FORMAT_R32G32_SFLOAT,               /* FNA3D_VERTEXELEMENTFORMAT_VECTOR2 */
+	VK_FORMAT_R32G32B32_SFLOAT,            /* FNA3D_VERTEXELEMENTFORMAT_VECTOR3 */
+	VK_FORMAT_R32G32B32A32_SFLOAT,         /* FNA3D_VERTEXELEMENTFORMAT_VECTOR4 */
+	VK_FORMAT_R8G8B8A8_UNORM,              /* FNA3D_VERTEXELEMENTFORMAT_COLOR */
+	VK_FORMAT_R8G8B8A8_USCALED,            /* FNA3D_VERTEXELEMENTFORMAT_BYTE4 */
+	VK_FORMAT_R16G16_SSCALED,              /* FNA3D_VERTEXELEMENTFORMAT_SHORT2 */
+	VK_FORMAT_R16G16B16A16_SSCALED,        /* FNA3D_VERTEXELEMENTFORMAT_SHORT4 */
+	VK_FORMAT_R16G16_SNORM,                /* FNA3D_VERTEXELEMENTFORMAT_NORMALIZEDSHORT2 */
+	VK_FORMAT_R16G16B16A16_SNORM,          /* FNA3D_VERTEXELEMENTFORMAT_NORMALIZEDSHORT4 */
+	VK_FORMAT_R16G16_SFLOAT,               /* FNA3D_VERTEXELEMENTFORMAT_HALFVECTOR2 */
+	VK_FORMAT_R16G16B16A16_SFLOAT,         /* FNA3D_VERTEXELEMENTFORMAT_HALFVECTOR4 */
+};
+
+static inline float XNAToVK_DepthBiasScale(VkFormat format)
+{
+	switch (format) {
+	case VK_FORMAT_D16_UNORM:
+		return (float) ((1 << 16) - 1);
+	case VK_FORMAT_D32_SFLOAT:
+	case VK_FORMAT_D32_SFLOAT_S8_UINT:
+		return (float) ((1 << 23) - 1);
+	case VK_FORMAT_D24_UNORM_S8_UINT:
+		return (float) ((1 << 24) - 1);
+	default:
+		return 0.0f;
+	}
+}
+
 /* Memory Type Helper */
 uint32_t VULKAN_INTERNAL_FindMemoryType(
 	VulkanRenderer *renderer,
@@ -106,6 +278,7 @@ static uint8_t VULKAN_LoadFunctions(VulkanRenderer *renderer)
 	LOAD_INSTANCE_FUNC(vkGetPhysicalDeviceFeatures)
 	LOAD_INSTANCE_FUNC(vkGetPhysicalDeviceMemoryProperties)
 	LOAD_INSTANCE_FUNC(vkGetPhysicalDeviceQueueFamilyProperties)
+	LOAD_INSTANCE_FUNC(vkGetPhysicalDeviceFormatProperties)
 	LOAD_INSTANCE_FUNC(vkCreateDevice)
 	LOAD_INSTANCE_FUNC(vkGetPhysicalDeviceSurfaceSupportKHR)
 	LOAD_INSTANCE_FUNC(vkGetPhysicalDeviceSurfaceCapabilitiesKHR)
@@ -157,10 +330,12 @@ static uint8_t VULKAN_LoadFunctions(VulkanRenderer *renderer)
 	LOAD_DEVICE_FUNC(vkDestroyPipeline)
 	LOAD_DEVICE_FUNC(vkCreatePipelineCache)
 	LOAD_DEVICE_FUNC(vkDestroyPipelineCache)
+	LOAD_DEVICE_FUNC(vkGetPipelineCacheData)
 	LOAD_DEVICE_FUNC(vkCreateDescriptorSetLayout)
 	LOAD_DEVICE_FUNC(vkDestroyDescriptorSetLayout)
 	LOAD_DEVICE_FUNC(vkCreateDescriptorPool)
 	LOAD_DEVICE_FUNC(vkDestroyDescriptorPool)
+	LOAD_DEVICE_FUNC(vkResetDescriptorPool)
 	LOAD_DEVICE_FUNC(vkAllocateDescriptorSets)
 	LOAD_DEVICE_FUNC(vkUpdateDescriptorSets)
 	LOAD_DEVICE_FUNC(vkCreateRenderPass)
@@ -205,6 +380,7 @@ static uint8_t VULKAN_LoadFunctions(VulkanRenderer *renderer)
 	LOAD_DEVICE_FUNC(vkDestroyFence)
 	LOAD_DEVICE_FUNC(vkWaitForFences)
 	LOAD_DEVICE_FUNC(vkResetFences)
+	LOAD_DEVICE_FUNC(vkGetFenceStatus)
 	LOAD_DEVICE_FUNC(vkCreateSemaphore)
 	LOAD_DEVICE_FUNC(vkDestroySemaphore)
 	LOAD_DEVICE_FUNC(vkCreateSwapchainKHR)
@@ -392,10 +568,12 @@ static uint8_t VULKAN_INTERNAL_CreateDevice(VulkanRenderer *renderer)
 		queueCreateInfoCount = 2;
 	}
 	
+	/* Only ask for what the device has, the draw path checks these again */
 	VkPhysicalDeviceFeatures deviceFeatures = {0};
-	deviceFeatures.samplerAnisotropy = VK_TRUE;
-	deviceFeatures.fillModeNonSolid = VK_TRUE;
-	deviceFeatures.depthClamp = VK_TRUE;
+	deviceFeatures.samplerAnisotropy = renderer->deviceFeatures.samplerAnisotropy;
+	deviceFeatures.fillModeNonSolid = renderer->deviceFeatures.fillModeNonSolid;
+	deviceFeatures.textureCompressionBC = renderer->deviceFeatures.textureCompressionBC;
+	deviceFeatures.occlusionQueryPrecise = renderer->deviceFeatures.occlusionQueryPrecise;
 	
 	VkDeviceCreateInfo createInfo = {0};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -426,6 +604,7 @@ static uint8_t VULKAN_CreateSwapchain(VulkanRenderer *renderer, uint32_t width,
 	uint32_t formatCount, presentModeCount, imageCount, i;
 	VkSurfaceFormatKHR surfaceFormat = { VK_FORMAT_B8G8R8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR };
 	VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+	VulkanSwapchain oldSwapchain = renderer->swapchain;
 	
 	renderer->vkGetPhysicalDeviceSurfaceCapabilitiesKHR(
 		renderer->physicalDevice, renderer->surface, &caps);
@@ -500,6 +679,16 @@ static uint8_t VULKAN_CreateSwapchain(VulkanRenderer *renderer, uint32_t width,
 		return 0;
 	}
 	
+	/* The caller has waited for the device, so the old chain can go now */
+	if (oldSwapchain.swapchain) {
+		for (i = 0; i < oldSwapchain.imageCount; i++) {
+			renderer->vkDestroyImageView(renderer->device, oldSwapchain.imageViews[i], NULL);
+		}
+		SDL_free(oldSwapchain.imageViews);
+		SDL_free(oldSwapchain.images);
+		renderer->vkDestroySwapchainKHR(renderer->device, oldSwapchain.swapchain, NULL);
+	}
+	
 	renderer->swapchain.format = surfaceFormat.format;
 	renderer->swapchain.colorSpace = surfaceFormat.colorSpace;
 	renderer->swapchain.extent = extent;
@@ -580,6 +769,10 @@ static uint8_t VULKAN_CreateFrameResources(VulkanRenderer *renderer)
 			renderer->device, &allocInfo, &frame->commandBuffer);
 		VK_CHECK_RET(result, 0);
 		
+		result = renderer->vkAllocateCommandBuffers(
+			renderer->device, &allocInfo, &frame->uploadCommandBuffer);
+		VK_CHECK_RET(result, 0);
+		
 		/* Fence */
 		result = renderer->vkCreateFence(
 			renderer->device, &fenceInfo, NULL, &frame->fence);
@@ -641,10 +834,16 @@ static FNA3D_Device* VULKAN_CreateDevice(
 	SDL_memset(renderer, 0, sizeof(VulkanRenderer));
 	
 	renderer->debugMode = debugMode;
+	renderer->threadID = SDL_ThreadID();
+	renderer->disposeLock = SDL_CreateMutex();
+	FNA3D_PerfState_Init(&renderer->perf);
 	renderer->backbufferWidth = presentationParameters->backBufferWidth;
 	renderer->backbufferHeight = presentationParameters->backBufferHeight;
 	renderer->window = (SDL_Window*)presentationParameters->deviceWindowHandle;
 	
+	/* FNA3D_TARGET_FPS: Frame rate limiting (0 = unlimited, 30, 45, 60, etc.) */
+	FNA3D_FramePacer_Init(&renderer->pacer, renderer->window);
+	
 	/* Load vkGetInstanceProcAddr */
 	renderer->vkGetInstanceProcAddr = (PFN_vkGetInstanceProcAddr)
 		SDL_Vulkan_GetVkGetInstanceProcAddr();
@@ -724,10 +923,13 @@ static FNA3D_Device* VULKAN_CreateDevice(
 		goto cleanup;
 	}
 	
-	/* Create pipeline cache */
-	VkPipelineCacheCreateInfo cacheInfo = {0};
-	cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-	renderer->vkCreatePipelineCache(renderer->device, &cacheInfo, NULL, &renderer->pipelineCache);
+	/* Create pipeline cache, seeded from the last run if possible */
+	VULKAN_INTERNAL_CreatePipelineCache(renderer);
+	
+	/* Descriptor layouts, the first frame, the backbuffer and default resources */
+	if (!VULKAN_INTERNAL_CreateRenderState(renderer, presentationParameters)) {
+		goto cleanup;
+	}
 	
 	/* Assign function pointers - defined in FNA3D_Driver_Vulkan_Impl.h */
 	device->driverData = (FNA3D_Renderer*)renderer;
@@ -746,6 +948,8 @@ cleanup:
 	if (renderer->instance) {
 		renderer->vkDestroyInstance(renderer->instance, NULL);
 	}
+	SDL_DestroyMutex(renderer->disposeLock);
+	SDL_free(renderer->pipelineCachePath);
 	SDL_Vulkan_UnloadLibrary();
 	SDL_free(renderer);
 	SDL_free(device);
@@ -13,6 +13,8 @@
 #if FNA3D_DRIVER_VULKAN
 
 #include "FNA3D_Driver.h"
+#include "FNA3D_PipelineCache.h"
+#include "FNA3D_PipelineManifest.h"
 #include <vulkan/vulkan.h>
 #include <SDL.h>
 
@@ -20,27 +22,134 @@
 #define VULKAN_MAX_FRAMES_IN_FLIGHT 3
 #define VULKAN_MAX_VERTEX_ATTRIBUTES 16
 #define VULKAN_MAX_TEXTURE_SAMPLERS 16
-#define VULKAN_MAX_RENDER_TARGETS 8
+#define VULKAN_MAX_VERTEX_TEXTURE_SAMPLERS 4
+#define VULKAN_MAX_RENDER_TARGETS 4
 #define VULKAN_STAGING_BUFFER_SIZE (8 * 1024 * 1024)
+#define VULKAN_UNIFORM_BUFFER_SIZE (1024 * 1024)
+#define VULKAN_DESCRIPTOR_POOL_SETS 512
+#define VULKAN_PIPELINE_HASH_BUCKETS 1031
+#define VULKAN_MAX_QUERIES 4096
 
-/* Memory Allocation Pool */
+/* The pipeline cache is written back at device destroy and, while new
+ * pipelines keep showing up, about once a minute at 60Hz.
+ */
+#define VULKAN_PIPELINE_CACHE_SAVE_INTERVAL 3600
+
+/* Large enough for the biggest block MojoShader emits:
+ * 256 float4 + 16 int4 + 16 bool registers, each padded to 16 bytes.
+ */
+#define VULKAN_UNIFORM_RANGE 8192
+
+/* Descriptor set numbers used by MojoShader's SPIR-V profile. This is the
+ * same layout SDL_GPU expects, with combined image samplers bound by sampler
+ * register and a single uniform block per stage.
+ */
+#define VULKAN_SET_VERTEX_SAMPLERS 0
+#define VULKAN_SET_VERTEX_UNIFORMS 1
+#define VULKAN_SET_FRAGMENT_SAMPLERS 2
+#define VULKAN_SET_FRAGMENT_UNIFORMS 3
+#define VULKAN_SET_COUNT 4
+
+/* MojoShader register files, sized like the other MojoShader backends */
+#define VULKAN_FLOAT_REGISTERS (8192 * 4)
+#define VULKAN_INT_REGISTERS (2047 * 4)
+#define VULKAN_BOOL_REGISTERS 2047
+
+/* Device memory is sub-allocated from large blocks:
+ * - Requests up to the largest size class come from slabs of fixed-size slots
+ * - Anything else up to VULKAN_MEMORY_DEDICATED_SIZE is placed first-fit in a
+ *   general block
+ * - Bigger requests, and render targets past VULKAN_MEMORY_DEDICATED_TARGET_SIZE,
+ *   get a dedicated allocation
+ * Buffers and images never share a block, which keeps bufferImageGranularity
+ * out of the picture.
+ */
+#define VULKAN_MEMORY_BLOCK_SIZE (64 * 1024 * 1024)
+#define VULKAN_MEMORY_SLAB_SIZE (4 * 1024 * 1024)
+#define VULKAN_MEMORY_MIN_CLASS_SHIFT 8 /* 256 bytes */
+#define VULKAN_MEMORY_SIZE_CLASSES 11 /* 256 bytes to 256 KiB */
+#define VULKAN_MEMORY_DEDICATED_SIZE (16 * 1024 * 1024)
+#define VULKAN_MEMORY_DEDICATED_TARGET_SIZE (4 * 1024 * 1024)
+
+typedef enum VulkanMemoryPoolKind {
+	VULKAN_MEMORY_POOL_GENERAL,
+	VULKAN_MEMORY_POOL_SLAB,
+	VULKAN_MEMORY_POOL_DEDICATED
+} VulkanMemoryPoolKind;
+
+/* Free range in a general block, kept sorted by offset */
+typedef struct VulkanMemoryRegion {
+	VkDeviceSize offset;
+	VkDeviceSize size;
+	struct VulkanMemoryRegion *next;
+} VulkanMemoryRegion;
+
+/* Memory Allocation Pool (one vkAllocateMemory) */
 typedef struct VulkanMemoryPool {
 	VkDeviceMemory memory;
 	VkDeviceSize size;
 	VkDeviceSize used;
 	uint32_t memoryTypeIndex;
-	uint8_t *mappedPointer;
+	uint8_t *mappedPointer; /* Whole block, NULL if not host-visible */
+	uint8_t isImage;
+	VulkanMemoryPoolKind kind;
+	uint32_t allocationCount;
+
+	/* VULKAN_MEMORY_POOL_SLAB: stack of free slot indices */
+	uint32_t sizeClass;
+	uint32_t *freeSlots;
+	uint32_t freeSlotCount;
+
+	/* VULKAN_MEMORY_POOL_GENERAL */
+	VulkanMemoryRegion *freeRegions;
+
 	struct VulkanMemoryPool *next;
 } VulkanMemoryPool;
 
+typedef struct VulkanMemoryAllocation {
+	VulkanMemoryPool *pool;
+	VkDeviceSize offset;
+	VkDeviceSize size; /* Includes slab rounding */
+} VulkanMemoryAllocation;
+
+typedef struct VulkanMemoryStats {
+	uint32_t deviceAllocations; /* Live vkAllocateMemory calls */
+	uint32_t generalBlocks;
+	uint32_t slabs;
+	uint32_t dedicatedAllocations;
+	uint32_t resourceAllocations;
+	uint64_t bytesReserved;
+	uint64_t bytesUsed;
+	uint64_t peakBytesReserved;
+} VulkanMemoryStats;
+
+/* On-disk pipeline cache. The driver validates its own blob too, but a cache
+ * from another driver version is discarded before it ever reaches Vulkan.
+ */
+#define VULKAN_PIPELINE_CACHE_MAGIC 0x43505646 /* "FVPC" */
+#define VULKAN_PIPELINE_CACHE_VERSION 1
+
+typedef struct VulkanPipelineCacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vendorID;
+	uint32_t deviceID;
+	uint32_t driverVersion;
+	uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+	uint64_t dataSize;
+	uint64_t checksum; /* FNV-1a of the data that follows */
+} VulkanPipelineCacheHeader;
+
 /* Buffer */
 typedef struct VulkanBuffer {
 	VkBuffer buffer;
-	VkDeviceMemory memory;
-	VkDeviceSize offset;
+	VulkanMemoryAllocation allocation;
 	VkDeviceSize size;
+	VkBufferUsageFlags usage;
 	uint8_t *mappedPointer;
 	uint8_t isDynamic;
+	uint64_t usedFrame; /* Last frame that recorded a read, 0 if never */
+	uint64_t uploadFrame; /* Last frame with a batched upload */
 	struct VulkanBuffer *next;
 } VulkanBuffer;
 
@@ -48,8 +157,10 @@ typedef struct VulkanBuffer {
 typedef struct VulkanTexture {
 	VkImage image;
 	VkImageView view;
-	VkDeviceMemory memory;
+	VkImageView rtViews[6]; /* Level 0 of each layer, render targets only */
+	VulkanMemoryAllocation allocation;
 	VkFormat format;
+	FNA3D_SurfaceFormat surfaceFormat;
 	uint32_t width;
 	uint32_t height;
 	uint32_t depth;
@@ -59,6 +170,8 @@ typedef struct VulkanTexture {
 	uint8_t isRenderTarget;
 	uint8_t is3D;
 	uint8_t isCube;
+	uint64_t usedFrame; /* Last frame that recorded a command using it */
+	uint8_t uploadPending; /* In the frame's upload batch */
 	struct VulkanTexture *next;
 } VulkanTexture;
 
@@ -72,55 +185,178 @@ typedef struct VulkanSampler {
 typedef struct VulkanRenderbuffer {
 	VkImage image;
 	VkImageView view;
-	VkDeviceMemory memory;
+	VulkanMemoryAllocation allocation;
 	VkFormat format;
+	VkImageAspectFlags aspect;
+	VkImageLayout layout;
 	uint32_t width;
 	uint32_t height;
 	uint32_t sampleCount;
+	uint8_t isDepth;
 	struct VulkanRenderbuffer *next;
 } VulkanRenderbuffer;
 
 /* Render Pass */
 typedef struct VulkanRenderPass {
 	VkRenderPass renderPass;
+	VkFormat colorFormats[VULKAN_MAX_RENDER_TARGETS];
 	uint32_t colorAttachmentCount;
+	VkFormat depthFormat; /* VK_FORMAT_UNDEFINED if none */
+	VkSampleCountFlagBits sampleCount;
 	uint8_t hasDepthStencil;
+	uint8_t clearColor;
+	uint8_t clearDepth;
+	uint8_t clearStencil;
+	struct VulkanRenderPass *next;
 } VulkanRenderPass;
 
 /* Framebuffer */
+#define VULKAN_MAX_FRAMEBUFFER_ATTACHMENTS ((VULKAN_MAX_RENDER_TARGETS * 2) + 1)
 typedef struct VulkanFramebuffer {
 	VkFramebuffer framebuffer;
 	VulkanRenderPass *renderPass;
+	VkImageView attachments[VULKAN_MAX_FRAMEBUFFER_ATTACHMENTS];
+	uint32_t attachmentCount;
 	uint32_t width;
 	uint32_t height;
 	struct VulkanFramebuffer *next;
 } VulkanFramebuffer;
 
-/* Pipeline */
-typedef struct VulkanPipeline {
-	VkPipeline pipeline;
-	VkPipelineLayout layout;
-	struct VulkanPipeline *next;
-} VulkanPipeline;
+/* Shader, created by MojoShader's effect framework */
+typedef struct VulkanShader {
+	const MOJOSHADER_parseData *parseData;
+	uint32_t refcount;
+	uint32_t samplerSlots; /* Highest sampler register + 1 */
+	uint32_t uniformBlockSize;
+} VulkanShader;
+
+/* Linked vertex/pixel pair. The SPIR-V is patched for the pair at link time,
+ * so the modules can only be used together.
+ */
+typedef struct VulkanShaderProgram {
+	VulkanShader *vertexShader;
+	VulkanShader *pixelShader;
+	VkShaderModule vertexModule;
+	VkShaderModule fragmentModule;
+	struct VulkanShaderProgram *next;
+} VulkanShaderProgram;
 
-/* Effect (Shader) */
+/* Effect */
 typedef struct VulkanEffect {
 	MOJOSHADER_effect *effect;
-	VkShaderModule vertexShader;
-	VkShaderModule fragmentShader;
-	VkDescriptorSetLayout descriptorSetLayout;
-	VkPipelineLayout pipelineLayout;
-	struct VulkanEffect *next;
 } VulkanEffect;
 
-/* Query */
+/* AddDispose* calls made off the rendering thread, see DisposeResources */
+typedef enum VulkanDisposeType {
+	VULKAN_DISPOSE_BUFFER,
+	VULKAN_DISPOSE_TEXTURE,
+	VULKAN_DISPOSE_RENDERBUFFER,
+	VULKAN_DISPOSE_EFFECT,
+	VULKAN_DISPOSE_QUERY
+} VulkanDisposeType;
+
+typedef struct VulkanPendingDispose {
+	VulkanDisposeType type;
+	void *resource;
+} VulkanPendingDispose;
+
+/* Vertex input layout, the value of the vertex buffer bindings cache */
+typedef struct VulkanVertexLayout {
+	VkVertexInputBindingDescription bindings[VULKAN_MAX_VERTEX_ATTRIBUTES];
+	VkVertexInputAttributeDescription attributes[VULKAN_MAX_VERTEX_ATTRIBUTES];
+	uint32_t bindingCount;
+	uint32_t attributeCount;
+} VulkanVertexLayout;
+
+/* Pipeline */
+typedef struct VulkanPipelineHash {
+	PackedState blendState;
+	PackedState rasterizerState;
+	PackedState depthStencilState;
+	VulkanVertexLayout *vertexLayout;
+	VulkanShaderProgram *program;
+	VkRenderPass renderPass; /* Load-op variant, compatible with all others */
+	FNA3D_PrimitiveType primitiveType;
+	uint32_t sampleMask;
+} VulkanPipelineHash;
+
+typedef struct VulkanPipelineHashMap {
+	VulkanPipelineHash key;
+	VkPipeline value;
+} VulkanPipelineHashMap;
+
+typedef struct VulkanPipelineHashArray {
+	VulkanPipelineHashMap *elements;
+	int32_t count;
+	int32_t capacity;
+} VulkanPipelineHashArray;
+
+typedef struct VulkanPipelineHashTable {
+	VulkanPipelineHashArray buckets[VULKAN_PIPELINE_HASH_BUCKETS];
+} VulkanPipelineHashTable;
+
+/* Everything vkCreateGraphicsPipelines reads, so a pipeline can be built on
+ * the stack at draw time or off the render thread by the prewarm compiler.
+ */
+typedef struct VulkanPipelineJob {
+	FNA3D_PipelineCompileJob job; /* Must be first! */
+
+	/* Inputs */
+	FNA3D_BlendState blendState;
+	FNA3D_DepthStencilState depthStencilState;
+	FNA3D_RasterizerState rasterizerState;
+	VulkanShaderProgram *program;
+	VulkanVertexLayout *vertexLayout;
+	VulkanRenderPass *renderPass;
+	FNA3D_PrimitiveType primitiveType;
+	int32_t multiSampleMask;
+	VulkanPipelineHash hash;
+
+	/* Create info, filled from the inputs */
+	VkPipelineShaderStageCreateInfo stages[2];
+	VkPipelineVertexInputStateCreateInfo vertexInput;
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly;
+	VkPipelineViewportStateCreateInfo viewportState;
+	VkPipelineRasterizationStateCreateInfo rasterizer;
+	VkSampleMask sampleMask;
+	VkPipelineMultisampleStateCreateInfo multisample;
+	VkPipelineDepthStencilStateCreateInfo depthStencil;
+	VkPipelineColorBlendAttachmentState blendAttachments[VULKAN_MAX_RENDER_TARGETS];
+	VkPipelineColorBlendStateCreateInfo colorBlend;
+	VkDynamicState dynamicStates[4];
+	VkPipelineDynamicStateCreateInfo dynamicState;
+	VkGraphicsPipelineCreateInfo pipelineInfo;
+
+	/* Prewarm jobs hold a reference to both shaders until published */
+	VulkanShader *vertexShader;
+	VulkanShader *pixelShader;
+
+	/* Outputs */
+	VkPipeline pipeline;
+	VkResult result;
+} VulkanPipelineJob;
+
+/* Query, one slot of the renderer's occlusion query pool. Slots are reset
+ * on the GPU, so the host can only trust a result once the submission that
+ * ended the query has finished.
+ */
 typedef struct VulkanQuery {
-	VkQueryPool queryPool;
 	uint32_t index;
 	uint8_t active;
-	struct VulkanQuery *next;
+	uint32_t frame; /* Frame slot it was last recorded in */
+	uint64_t submission; /* renderer->submitCount of that submit, 0 if never ended */
 } VulkanQuery;
 
+/* Readback, a host-visible copy that PollReadback hands out once the
+ * submission that recorded it has finished
+ */
+typedef struct VulkanReadback {
+	FNA3D_Readback base; /* Must be first! */
+	VulkanBuffer *buffer;
+	uint32_t frame;
+	uint64_t submission;
+} VulkanReadback;
+
 /* Frame Data (per-frame resources) */
 typedef struct VulkanFrameData {
 	VkCommandPool commandPool;
@@ -129,13 +365,45 @@ typedef struct VulkanFrameData {
 	VkSemaphore imageAvailable;
 	VkSemaphore renderFinished;
 	uint8_t submitted;
+	uint64_t submission; /* renderer->submitCount when last submitted */
 	
-	/* Staging buffer for this frame */
+	/* Linear staging ring for this frame's uploads */
 	VulkanBuffer *stagingBuffer;
 	VkDeviceSize stagingOffset;
 	
-	/* Descriptor pool for this frame */
+	/* Uploads to resources this frame hasn't used yet are batched here and
+	 * submitted ahead of commandBuffer, so they don't break render passes
+	 */
+	VkCommandBuffer uploadCommandBuffer;
+	uint8_t uploadActive;
+	VulkanTexture **uploadTextures;
+	uint32_t uploadTextureCount;
+	uint32_t uploadTextureCapacity;
+	
+	/* Resources released while this frame was recorded, destroyed once its
+	 * fence has signaled
+	 */
+	VulkanBuffer *retiredBuffers;
+	VulkanTexture *retiredTextures;
+	VulkanRenderbuffer *retiredRenderbuffers;
+	VulkanShaderProgram *retiredPrograms;
+	VkPipeline *retiredPipelines;
+	uint32_t retiredPipelineCount;
+	uint32_t retiredPipelineCapacity;
+	
+	/* Uniform blocks for this frame, bound with dynamic offsets */
+	VulkanBuffer *uniformBuffer;
+	VkDeviceSize uniformOffset;
+	VkDescriptorSet uniformDescriptorSet;
+	
+	/* Descriptor pools for this frame. descriptorPool is the one being
+	 * allocated from; more are created when it runs dry and all of them
+	 * are reset when the frame is reused.
+	 */
 	VkDescriptorPool descriptorPool;
+	VkDescriptorPool *descriptorPools;
+	uint32_t descriptorPoolCount;
+	uint32_t descriptorPoolIndex;
 } VulkanFrameData;
 
 /* Swapchain */
@@ -147,8 +415,6 @@ typedef struct VulkanSwapchain {
 	uint32_t imageCount;
 	VkImage *images;
 	VkImageView *imageViews;
-	VkFramebuffer *framebuffers;
-	VulkanRenderPass *renderPass;
 	uint32_t currentImageIndex;
 } VulkanSwapchain;
 
@@ -175,27 +441,45 @@ typedef struct VulkanRenderer {
 	/* Frame Management */
 	VulkanFrameData frames[VULKAN_MAX_FRAMES_IN_FLIGHT];
 	uint32_t currentFrame;
-	uint32_t frameCount;
+	uint64_t frameCount; /* Starts at 1, advanced on every present */
+	uint64_t submitCount; /* Every vkQueueSubmit, including FlushAndWait */
+	uint64_t completedSubmit; /* Newest submission known to have finished */
 	
 	/* Current State */
 	VkCommandBuffer currentCommandBuffer;
 	VulkanRenderPass *currentRenderPass;
-	VkFramebuffer currentFramebuffer;
+	VulkanFramebuffer *currentFramebuffer;
 	uint8_t renderPassActive;
+	uint32_t renderTargetWidth;
+	uint32_t renderTargetHeight;
+	
+	/* Clears requested while no render pass was active, applied as load
+	 * ops when the next one begins
+	 */
+	uint8_t pendingClearColor;
+	uint8_t pendingClearDepth;
+	uint8_t pendingClearStencil;
+	VkClearColorValue clearColorValue;
+	VkClearDepthStencilValue clearDepthStencilValue;
 	
 	/* Backbuffer */
 	VulkanTexture *backbufferColor;
+	VulkanRenderbuffer *backbufferMultisample;
 	VulkanRenderbuffer *backbufferDepthStencil;
 	uint32_t backbufferWidth;
 	uint32_t backbufferHeight;
 	FNA3D_SurfaceFormat backbufferSurfaceFormat;
 	FNA3D_DepthFormat backbufferDepthFormat;
 	int32_t backbufferMultiSampleCount;
+	VkFormat d24Format; /* D24S8, or D32S8 where D24 is unsupported */
 	
 	/* Render Target State */
 	VulkanTexture *colorAttachments[VULKAN_MAX_RENDER_TARGETS];
+	VulkanRenderbuffer *colorMultisampleAttachments[VULKAN_MAX_RENDER_TARGETS];
+	uint32_t colorAttachmentLayers[VULKAN_MAX_RENDER_TARGETS];
 	uint32_t colorAttachmentCount;
 	VulkanRenderbuffer *depthStencilAttachment;
+	FNA3D_DepthFormat depthStencilFormat;
 	
 	/* Pipeline State */
 	FNA3D_BlendState blendState;
@@ -206,46 +490,103 @@ typedef struct VulkanRenderer {
 	FNA3D_Color blendFactor;
 	int32_t multiSampleMask;
 	int32_t referenceStencil;
+	FNA3D_PrimitiveType currentPrimitiveType;
+	VkPipeline currentPipeline;
+	VulkanPipelineHashTable pipelineTable;
 	uint8_t pipelineDirty;
+	uint8_t viewportDirty;
+	uint8_t scissorDirty;
+	uint8_t blendFactorDirty;
+	uint8_t stencilReferenceDirty;
 	
 	/* Vertex State */
 	VulkanBuffer *vertexBuffers[VULKAN_MAX_VERTEX_ATTRIBUTES];
-	uint32_t vertexBufferOffsets[VULKAN_MAX_VERTEX_ATTRIBUTES];
+	VkDeviceSize vertexBufferOffsets[VULKAN_MAX_VERTEX_ATTRIBUTES];
 	uint32_t vertexBufferCount;
-	FNA3D_VertexDeclaration vertexDeclaration;
-	uint8_t vertexBuffersDirty;
+	VkBuffer boundVertexBuffers[VULKAN_MAX_VERTEX_ATTRIBUTES];
+	VkDeviceSize boundVertexOffsets[VULKAN_MAX_VERTEX_ATTRIBUTES];
+	uint32_t boundVertexBufferCount;
+	VkBuffer boundIndexBuffer;
+	VkIndexType boundIndexType;
+	VulkanVertexLayout *currentVertexLayout;
+	PackedVertexBufferBindingsArray vertexLayoutCache;
 	
 	/* Texture State */
 	VulkanTexture *textures[VULKAN_MAX_TEXTURE_SAMPLERS];
 	VulkanSampler *samplers[VULKAN_MAX_TEXTURE_SAMPLERS];
-	VulkanTexture *vertexTextures[4];
-	VulkanSampler *vertexSamplers[4];
-	
-	/* Current Effect */
-	VulkanEffect *currentEffect;
-	MOJOSHADER_effectTechnique *currentTechnique;
+	VulkanTexture *vertexTextures[VULKAN_MAX_VERTEX_TEXTURE_SAMPLERS];
+	VulkanSampler *vertexSamplers[VULKAN_MAX_VERTEX_TEXTURE_SAMPLERS];
+	PackedStateHashTable samplerTable;
+	uint8_t fragmentSamplersDirty;
+	uint8_t vertexSamplersDirty;
+	
+	/* Descriptor State */
+	VkDescriptorSetLayout vertexSamplerLayout;
+	VkDescriptorSetLayout fragmentSamplerLayout;
+	VkDescriptorSetLayout uniformLayout;
+	VkPipelineLayout pipelineLayout;
+	VkDescriptorSet descriptorSets[VULKAN_SET_COUNT];
+	uint32_t vertexUniformOffset;
+	uint32_t fragmentUniformOffset;
+	uint8_t uniformsDirty;
+	uint8_t descriptorSetsDirty;
+	
+	/* Shader State */
+	MOJOSHADER_effect *currentEffect;
+	const MOJOSHADER_effectTechnique *currentTechnique;
 	uint32_t currentPass;
+	VulkanShader *currentVertexShader;
+	VulkanShader *currentPixelShader;
+	VulkanShaderProgram *currentProgram;
+	VulkanShaderProgram *programList;
+	char shaderError[1024];
+	float vsRegFileF[VULKAN_FLOAT_REGISTERS];
+	int32_t vsRegFileI[VULKAN_INT_REGISTERS];
+	uint8_t vsRegFileB[VULKAN_BOOL_REGISTERS];
+	float psRegFileF[VULKAN_FLOAT_REGISTERS];
+	int32_t psRegFileI[VULKAN_INT_REGISTERS];
+	uint8_t psRegFileB[VULKAN_BOOL_REGISTERS];
 	
 	/* Default Resources */
 	VulkanSampler *defaultSampler;
-	VulkanTexture *defaultTexture;
-	VulkanRenderPass *defaultRenderPass;
+	VulkanTexture *dummyTexture2D;
+	VulkanTexture *dummyTexture3D;
+	VulkanTexture *dummyTextureCube;
 	
 	/* Query Pool */
 	VkQueryPool occlusionQueryPool;
-	uint32_t queryCount;
-	uint32_t maxQueries;
+	uint32_t queryCount; /* Slots handed out so far */
+	uint32_t *freeQueries;
+	uint32_t freeQueryCount;
+	VulkanQuery *activeQuery;
 	
 	/* Resource Lists */
 	VulkanBuffer *bufferList;
 	VulkanTexture *textureList;
 	VulkanSampler *samplerList;
 	VulkanRenderbuffer *renderbufferList;
+	VulkanRenderPass *renderPassList;
 	VulkanFramebuffer *framebufferList;
-	VulkanPipeline *pipelineList;
-	VulkanEffect *effectList;
-	VulkanQuery *queryList;
 	VulkanMemoryPool *memoryPoolList;
+	VulkanMemoryStats memoryStats;
+
+	/* See FNA3D_MapVertexBufferRange, static buffers map staging memory */
+	FNA3D_MappedRange mappedRange;
+	VkBuffer mappedStagingBuffer;
+	VkDeviceSize mappedStagingOffset;
+	
+	/* Disposals from other threads, retired on the next present */
+	SDL_threadID threadID;
+	SDL_mutex *disposeLock;
+	VulkanPendingDispose *pendingDisposals;
+	uint32_t pendingDisposalCount;
+	uint32_t pendingDisposalCapacity;
+	
+	/* Performance counters, see FNA3D_GetPerfCounters */
+	FNA3D_PerfState perf;
+	
+	/* Frame rate limiting, see FNA3D_TARGET_FPS */
+	FNA3D_FramePacer pacer;
 	
 	/* Window Reference */
 	SDL_Window *window;
@@ -262,6 +603,7 @@ typedef struct VulkanRenderer {
 	PFN_vkGetPhysicalDeviceFeatures vkGetPhysicalDeviceFeatures;
 	PFN_vkGetPhysicalDeviceMemoryProperties vkGetPhysicalDeviceMemoryProperties;
 	PFN_vkGetPhysicalDeviceQueueFamilyProperties vkGetPhysicalDeviceQueueFamilyProperties;
+	PFN_vkGetPhysicalDeviceFormatProperties vkGetPhysicalDeviceFormatProperties;
 	PFN_vkCreateDevice vkCreateDevice;
 	PFN_vkGetPhysicalDeviceSurfaceSupportKHR vkGetPhysicalDeviceSurfaceSupportKHR;
 	PFN_vkGetPhysicalDeviceSurfaceCapabilitiesKHR vkGetPhysicalDeviceSurfaceCapabilitiesKHR;
@@ -312,13 +654,23 @@ typedef struct VulkanRenderer {
 	PFN_vkDestroyPipeline vkDestroyPipeline;
 	PFN_vkCreatePipelineCache vkCreatePipelineCache;
 	PFN_vkDestroyPipelineCache vkDestroyPipelineCache;
+	PFN_vkGetPipelineCacheData vkGetPipelineCacheData;
 	VkPipelineCache pipelineCache;
+	char *pipelineCachePath; /* NULL when persistence is disabled */
+	uint8_t pipelineCacheDirty;
+	uint64_t pipelineCacheSaveFrame;
+
+	/* Pipeline prewarming, see FNA3D_PrewarmPipelines */
+	FNA3D_PipelineManifest *pipelineManifest;
+	FNA3D_PipelineCompiler *pipelineCompiler; /* Created on first use */
+	int32_t pipelineJobsInFlight;
 	
 	/* Descriptor */
 	PFN_vkCreateDescriptorSetLayout vkCreateDescriptorSetLayout;
 	PFN_vkDestroyDescriptorSetLayout vkDestroyDescriptorSetLayout;
 	PFN_vkCreateDescriptorPool vkCreateDescriptorPool;
 	PFN_vkDestroyDescriptorPool vkDestroyDescriptorPool;
+	PFN_vkResetDescriptorPool vkResetDescriptorPool;
 	PFN_vkAllocateDescriptorSets vkAllocateDescriptorSets;
 	PFN_vkUpdateDescriptorSets vkUpdateDescriptorSets;
 	
@@ -374,6 +726,7 @@ typedef struct VulkanRenderer {
 	PFN_vkDestroyFence vkDestroyFence;
 	PFN_vkWaitForFences vkWaitForFences;
 	PFN_vkResetFences vkResetFences;
+	PFN_vkGetFenceStatus vkGetFenceStatus;
 	PFN_vkCreateSemaphore vkCreateSemaphore;
 	PFN_vkDestroySemaphore vkDestroySemaphore;
 	
@@ -3,132 +3,3853 @@
 #ifndef FNA3D_DRIVER_VULKAN_IMPL_H
 #define FNA3D_DRIVER_VULKAN_IMPL_H
 
-/* Helper: Begin Frame */
-static void VULKAN_BeginFrame(VulkanRenderer *renderer)
+/* Lives in MojoShader's internal header; patches the SPIR-V of a vertex/pixel
+ * pair so the vertex outputs line up with the pixel inputs.
+ */
+extern void MOJOSHADER_spirv_link_attributes(
+	const MOJOSHADER_parseData *vertex,
+	const MOJOSHADER_parseData *pixel,
+	int is_glspirv
+);
+
+static void VULKAN_INTERNAL_EndRenderPass(VulkanRenderer *renderer);
+static void VULKAN_INTERNAL_DestroyTexture(VulkanRenderer *renderer, VulkanTexture *texture);
+static void VULKAN_INTERNAL_DestroyRenderbuffer(VulkanRenderer *renderer, VulkanRenderbuffer *renderbuffer);
+
+/* Memory */
+
+static VulkanMemoryPool* VULKAN_INTERNAL_CreateMemoryPool(
+	VulkanRenderer *renderer,
+	uint32_t memoryTypeIndex,
+	VkDeviceSize size,
+	uint8_t hostVisible,
+	uint8_t isImage,
+	VulkanMemoryPoolKind kind,
+	uint32_t sizeClass
+) {
+	VulkanMemoryPool *pool;
+	VkResult result;
+	uint32_t i;
+
+	pool = (VulkanMemoryPool*) SDL_malloc(sizeof(VulkanMemoryPool));
+	SDL_memset(pool, 0, sizeof(VulkanMemoryPool));
+	pool->size = size;
+	pool->memoryTypeIndex = memoryTypeIndex;
+	pool->isImage = isImage;
+	pool->kind = kind;
+	pool->sizeClass = sizeClass;
+
+	VkMemoryAllocateInfo allocInfo = {0};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+	result = renderer->vkAllocateMemory(renderer->device, &allocInfo, NULL, &pool->memory);
+	if (result != VK_SUCCESS) {
+		VK_LOG_ERROR("vkAllocateMemory of %llu bytes failed: %d", (unsigned long long) size, result);
+		SDL_free(pool);
+		return NULL;
+	}
+
+	if (hostVisible) {
+		/* Persistently mapped, suballocations just offset into it */
+		result = renderer->vkMapMemory(
+			renderer->device, pool->memory, 0, VK_WHOLE_SIZE, 0,
+			(void**) &pool->mappedPointer);
+		if (result != VK_SUCCESS) {
+			VK_LOG_ERROR("vkMapMemory failed: %d", result);
+			renderer->vkFreeMemory(renderer->device, pool->memory, NULL);
+			SDL_free(pool);
+			return NULL;
+		}
+	}
+
+	if (kind == VULKAN_MEMORY_POOL_SLAB) {
+		pool->freeSlotCount = (uint32_t) (size >> (sizeClass + VULKAN_MEMORY_MIN_CLASS_SHIFT));
+		pool->freeSlots = (uint32_t*) SDL_malloc(sizeof(uint32_t) * pool->freeSlotCount);
+		for (i = 0; i < pool->freeSlotCount; i++) {
+			/* Popped from the back, so low offsets go out first */
+			pool->freeSlots[i] = pool->freeSlotCount - 1 - i;
+		}
+		renderer->memoryStats.slabs += 1;
+	} else if (kind == VULKAN_MEMORY_POOL_GENERAL) {
+		pool->freeRegions = (VulkanMemoryRegion*) SDL_malloc(sizeof(VulkanMemoryRegion));
+		pool->freeRegions->offset = 0;
+		pool->freeRegions->size = size;
+		pool->freeRegions->next = NULL;
+		renderer->memoryStats.generalBlocks += 1;
+	} else {
+		renderer->memoryStats.dedicatedAllocations += 1;
+	}
+
+	renderer->memoryStats.deviceAllocations += 1;
+	renderer->memoryStats.bytesReserved += size;
+	renderer->memoryStats.peakBytesReserved = SDL_max(
+		renderer->memoryStats.peakBytesReserved,
+		renderer->memoryStats.bytesReserved);
+
+	pool->next = renderer->memoryPoolList;
+	renderer->memoryPoolList = pool;
+	return pool;
+}
+
+static void VULKAN_INTERNAL_DestroyMemoryPool(
+	VulkanRenderer *renderer,
+	VulkanMemoryPool *pool
+) {
+	VulkanMemoryPool **prev;
+	VulkanMemoryRegion *region, *nextRegion;
+
+	for (prev = &renderer->memoryPoolList; *prev != NULL; prev = &(*prev)->next) {
+		if (*prev == pool) {
+			*prev = pool->next;
+			break;
+		}
+	}
+
+	if (pool->kind == VULKAN_MEMORY_POOL_SLAB) {
+		renderer->memoryStats.slabs -= 1;
+	} else if (pool->kind == VULKAN_MEMORY_POOL_GENERAL) {
+		renderer->memoryStats.generalBlocks -= 1;
+	} else {
+		renderer->memoryStats.dedicatedAllocations -= 1;
+	}
+	renderer->memoryStats.deviceAllocations -= 1;
+	renderer->memoryStats.bytesReserved -= pool->size;
+
+	if (pool->mappedPointer != NULL) {
+		renderer->vkUnmapMemory(renderer->device, pool->memory);
+	}
+	renderer->vkFreeMemory(renderer->device, pool->memory, NULL);
+
+	for (region = pool->freeRegions; region != NULL; region = nextRegion) {
+		nextRegion = region->next;
+		SDL_free(region);
+	}
+	SDL_free(pool->freeSlots);
+	SDL_free(pool);
+}
+
+/* Fragmentation is the share of free block memory that is not part of its
+ * block's largest free region, 0 when each block's free space is contiguous.
+ */
+static void VULKAN_INTERNAL_LogMemoryStats(VulkanRenderer *renderer)
+{
+	VulkanMemoryStats *stats = &renderer->memoryStats;
+	VulkanMemoryPool *pool;
+	VulkanMemoryRegion *region;
+	VkDeviceSize freeBytes = 0, largestFree = 0, blockLargest, slabSlack = 0;
+
+	for (pool = renderer->memoryPoolList; pool != NULL; pool = pool->next) {
+		if (pool->kind == VULKAN_MEMORY_POOL_GENERAL) {
+			blockLargest = 0;
+			for (region = pool->freeRegions; region != NULL; region = region->next) {
+				freeBytes += region->size;
+				blockLargest = SDL_max(blockLargest, region->size);
+			}
+			largestFree += blockLargest;
+		} else if (pool->kind == VULKAN_MEMORY_POOL_SLAB) {
+			slabSlack += pool->size - pool->used;
+		}
+	}
+
+	VK_LOG_INFO(
+		"Memory: %u device allocations (%u blocks, %u slabs, %u dedicated), %u resources",
+		stats->deviceAllocations,
+		stats->generalBlocks,
+		stats->slabs,
+		stats->dedicatedAllocations,
+		stats->resourceAllocations);
+	VK_LOG_INFO(
+		"Memory: %llu KiB used of %llu KiB reserved, peak %llu KiB",
+		(unsigned long long) (stats->bytesUsed / 1024),
+		(unsigned long long) (stats->bytesReserved / 1024),
+		(unsigned long long) (stats->peakBytesReserved / 1024));
+	VK_LOG_INFO(
+		"Memory: %llu KiB free in blocks, %.1f%% fragmented, %llu KiB free in slabs",
+		(unsigned long long) (freeBytes / 1024),
+		(freeBytes > 0) ? (100.0 * (double) (freeBytes - largestFree) / (double) freeBytes) : 0.0,
+		(unsigned long long) (slabSlack / 1024));
+}
+
+/* First fit, the leading alignment padding stays on the free list */
+static uint8_t VULKAN_INTERNAL_CarveRegion(
+	VulkanMemoryPool *pool,
+	VkDeviceSize size,
+	VkDeviceSize alignment,
+	VkDeviceSize *offset
+) {
+	VulkanMemoryRegion **prev, *region, *tail;
+	VkDeviceSize aligned, end;
+
+	for (prev = &pool->freeRegions; *prev != NULL; prev = &(*prev)->next) {
+		region = *prev;
+		aligned = (region->offset + alignment - 1) & ~(alignment - 1);
+		end = region->offset + region->size;
+		if (aligned + size > end) {
+			continue;
+		}
+
+		if (aligned + size < end) {
+			tail = (VulkanMemoryRegion*) SDL_malloc(sizeof(VulkanMemoryRegion));
+			tail->offset = aligned + size;
+			tail->size = end - tail->offset;
+			tail->next = region->next;
+			region->next = tail;
+		}
+		if (aligned > region->offset) {
+			region->size = aligned - region->offset;
+		} else {
+			*prev = region->next;
+			SDL_free(region);
+		}
+
+		*offset = aligned;
+		return 1;
+	}
+	return 0;
+}
+
+static void VULKAN_INTERNAL_ReleaseRegion(
+	VulkanMemoryPool *pool,
+	VkDeviceSize offset,
+	VkDeviceSize size
+) {
+	VulkanMemoryRegion *before = NULL, *after = pool->freeRegions, *region;
+
+	while (after != NULL && after->offset < offset) {
+		before = after;
+		after = after->next;
+	}
+
+	if (before != NULL && before->offset + before->size == offset) {
+		before->size += size;
+		if (after != NULL && before->offset + before->size == after->offset) {
+			before->size += after->size;
+			before->next = after->next;
+			SDL_free(after);
+		}
+		return;
+	}
+	if (after != NULL && offset + size == after->offset) {
+		after->offset = offset;
+		after->size += size;
+		return;
+	}
+
+	region = (VulkanMemoryRegion*) SDL_malloc(sizeof(VulkanMemoryRegion));
+	region->offset = offset;
+	region->size = size;
+	region->next = after;
+	if (before != NULL) {
+		before->next = region;
+	} else {
+		pool->freeRegions = region;
+	}
+}
+
+static inline uint8_t VULKAN_INTERNAL_PoolMatches(
+	VulkanMemoryPool *pool,
+	uint32_t memoryTypeIndex,
+	uint8_t hostVisible,
+	uint8_t isImage,
+	VulkanMemoryPoolKind kind,
+	uint32_t sizeClass
+) {
+	return (	pool->kind == kind &&
+			pool->memoryTypeIndex == memoryTypeIndex &&
+			pool->isImage == isImage &&
+			(pool->mappedPointer != NULL) == hostVisible &&
+			(kind != VULKAN_MEMORY_POOL_SLAB || pool->sizeClass == sizeClass)	);
+}
+
+/* Every allocation goes through here. Host-visible memory is always mapped,
+ * and isImage must be set for optimal-tiling images.
+ */
+static uint8_t VULKAN_INTERNAL_AllocateMemory(
+	VulkanRenderer *renderer,
+	VkMemoryRequirements *requirements,
+	uint8_t hostVisible,
+	uint8_t isImage,
+	uint8_t isRenderTarget,
+	VulkanMemoryAllocation *allocation
+) {
+	VkMemoryPropertyFlags properties;
+	VulkanMemoryPool *pool;
+	VkDeviceSize size = requirements->size;
+	VkDeviceSize alignment = SDL_max(requirements->alignment, 1);
+	VkDeviceSize offset = 0;
+	uint32_t memoryTypeIndex, sizeClass = 0;
+	VulkanMemoryPoolKind kind;
+
+	if (hostVisible) {
+		properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	} else {
+		properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	}
+
+	memoryTypeIndex = VULKAN_INTERNAL_FindMemoryType(
+		renderer, requirements->memoryTypeBits, properties);
+	if (memoryTypeIndex == UINT32_MAX && !hostVisible) {
+		/* No device-local heap, take anything that fits */
+		memoryTypeIndex = VULKAN_INTERNAL_FindMemoryType(
+			renderer, requirements->memoryTypeBits, 0);
+	}
+	if (memoryTypeIndex == UINT32_MAX) {
+		VK_LOG_ERROR("No suitable memory type");
+		return 0;
+	}
+
+	if (	size >= VULKAN_MEMORY_DEDICATED_SIZE ||
+		(isRenderTarget && size >= VULKAN_MEMORY_DEDICATED_TARGET_SIZE)	) {
+		kind = VULKAN_MEMORY_POOL_DEDICATED;
+	} else if (SDL_max(size, alignment) <= ((VkDeviceSize) 1 << (VULKAN_MEMORY_MIN_CLASS_SHIFT + VULKAN_MEMORY_SIZE_CLASSES - 1))) {
+		/* Slots are power-of-two sized, so they are also aligned to it */
+		kind = VULKAN_MEMORY_POOL_SLAB;
+		while (((VkDeviceSize) 1 << (sizeClass + VULKAN_MEMORY_MIN_CLASS_SHIFT)) < SDL_max(size, alignment)) {
+			sizeClass += 1;
+		}
+		size = (VkDeviceSize) 1 << (sizeClass + VULKAN_MEMORY_MIN_CLASS_SHIFT);
+	} else {
+		kind = VULKAN_MEMORY_POOL_GENERAL;
+	}
+
+	pool = NULL;
+	if (kind != VULKAN_MEMORY_POOL_DEDICATED) {
+		for (pool = renderer->memoryPoolList; pool != NULL; pool = pool->next) {
+			if (!VULKAN_INTERNAL_PoolMatches(pool, memoryTypeIndex, hostVisible, isImage, kind, sizeClass)) {
+				continue;
+			}
+			if (kind == VULKAN_MEMORY_POOL_SLAB) {
+				if (pool->freeSlotCount > 0) {
+					break;
+				}
+			} else if (VULKAN_INTERNAL_CarveRegion(pool, size, alignment, &offset)) {
+				break;
+			}
+		}
+	}
+
+	if (pool == NULL) {
+		pool = VULKAN_INTERNAL_CreateMemoryPool(
+			renderer,
+			memoryTypeIndex,
+			(kind == VULKAN_MEMORY_POOL_DEDICATED) ? size :
+				(kind == VULKAN_MEMORY_POOL_SLAB) ? VULKAN_MEMORY_SLAB_SIZE :
+				VULKAN_MEMORY_BLOCK_SIZE,
+			hostVisible,
+			isImage,
+			kind,
+			sizeClass);
+		if (pool == NULL) {
+			VULKAN_INTERNAL_LogMemoryStats(renderer);
+			return 0;
+		}
+		if (kind == VULKAN_MEMORY_POOL_GENERAL) {
+			VULKAN_INTERNAL_CarveRegion(pool, size, alignment, &offset);
+		}
+	}
+
+	if (kind == VULKAN_MEMORY_POOL_SLAB) {
+		pool->freeSlotCount -= 1;
+		offset = (VkDeviceSize) pool->freeSlots[pool->freeSlotCount] * size;
+	}
+
+	pool->used += size;
+	pool->allocationCount += 1;
+	renderer->memoryStats.resourceAllocations += 1;
+	renderer->memoryStats.bytesUsed += size;
+
+	allocation->pool = pool;
+	allocation->offset = offset;
+	allocation->size = size;
+	return 1;
+}
+
+static void VULKAN_INTERNAL_FreeMemory(
+	VulkanRenderer *renderer,
+	VulkanMemoryAllocation *allocation
+) {
+	VulkanMemoryPool *pool = allocation->pool, *other;
+
+	if (pool == NULL) {
+		return;
+	}
+	allocation->pool = NULL;
+
+	pool->used -= allocation->size;
+	pool->allocationCount -= 1;
+	renderer->memoryStats.resourceAllocations -= 1;
+	renderer->memoryStats.bytesUsed -= allocation->size;
+
+	if (pool->kind == VULKAN_MEMORY_POOL_SLAB) {
+		pool->freeSlots[pool->freeSlotCount] = (uint32_t) (allocation->offset / allocation->size);
+		pool->freeSlotCount += 1;
+	} else if (pool->kind == VULKAN_MEMORY_POOL_GENERAL) {
+		VULKAN_INTERNAL_ReleaseRegion(pool, allocation->offset, allocation->size);
+	}
+
+	if (pool->allocationCount > 0) {
+		return;
+	}
+
+	/* Keep one empty block of each kind around so that a resource being
+	 * created and freed every frame doesn't hit vkAllocateMemory each time
+	 */
+	if (pool->kind != VULKAN_MEMORY_POOL_DEDICATED) {
+		for (other = renderer->memoryPoolList; other != NULL; other = other->next) {
+			if (	other != pool &&
+				other->allocationCount == 0 &&
+				VULKAN_INTERNAL_PoolMatches(
+					other,
+					pool->memoryTypeIndex,
+					pool->mappedPointer != NULL,
+					pool->isImage,
+					pool->kind,
+					pool->sizeClass
+				)	) {
+				break;
+			}
+		}
+		if (other == NULL) {
+			return;
+		}
+	}
+	VULKAN_INTERNAL_DestroyMemoryPool(renderer, pool);
+}
+
+static inline VkDeviceMemory VULKAN_INTERNAL_AllocationMemory(VulkanMemoryAllocation *allocation)
+{
+	return allocation->pool->memory;
+}
+
+static inline uint8_t* VULKAN_INTERNAL_AllocationPointer(VulkanMemoryAllocation *allocation)
+{
+	if (allocation->pool->mappedPointer == NULL) {
+		return NULL;
+	}
+	return allocation->pool->mappedPointer + allocation->offset;
+}
+
+/* Buffers */
+
+static VulkanBuffer* VULKAN_INTERNAL_CreateBuffer(
+	VulkanRenderer *renderer,
+	VkDeviceSize size,
+	VkBufferUsageFlags usage,
+	uint8_t hostVisible
+) {
+	VulkanBuffer *buffer;
+	VkMemoryRequirements memReqs;
+	VkResult result;
+
+	buffer = (VulkanBuffer*) SDL_malloc(sizeof(VulkanBuffer));
+	SDL_memset(buffer, 0, sizeof(VulkanBuffer));
+	buffer->size = size;
+	buffer->usage = usage;
+	buffer->isDynamic = hostVisible;
+
+	VkBufferCreateInfo bufferInfo = {0};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	result = renderer->vkCreateBuffer(renderer->device, &bufferInfo, NULL, &buffer->buffer);
+	if (result != VK_SUCCESS) {
+		VK_LOG_ERROR("vkCreateBuffer failed: %d", result);
+		SDL_free(buffer);
+		return NULL;
+	}
+
+	renderer->vkGetBufferMemoryRequirements(renderer->device, buffer->buffer, &memReqs);
+	if (!VULKAN_INTERNAL_AllocateMemory(
+		renderer, &memReqs, hostVisible, 0, 0, &buffer->allocation
+	)) {
+		renderer->vkDestroyBuffer(renderer->device, buffer->buffer, NULL);
+		SDL_free(buffer);
+		return NULL;
+	}
+	buffer->mappedPointer = VULKAN_INTERNAL_AllocationPointer(&buffer->allocation);
+
+	renderer->vkBindBufferMemory(
+		renderer->device, buffer->buffer,
+		VULKAN_INTERNAL_AllocationMemory(&buffer->allocation),
+		buffer->allocation.offset);
+	return buffer;
+}
+
+static void VULKAN_INTERNAL_DestroyBuffer(VulkanRenderer *renderer, VulkanBuffer *buffer)
+{
+	renderer->vkDestroyBuffer(renderer->device, buffer->buffer, NULL);
+	VULKAN_INTERNAL_FreeMemory(renderer, &buffer->allocation);
+	SDL_free(buffer);
+}
+
+/* The buffer may still be read by the frame being recorded, so it is only
+ * destroyed once this frame slot's fence has signaled.
+ */
+static void VULKAN_INTERNAL_RetireBuffer(VulkanRenderer *renderer, VulkanBuffer *buffer)
+{
+	VulkanFrameData *frame = &renderer->frames[renderer->currentFrame];
+	buffer->next = frame->retiredBuffers;
+	frame->retiredBuffers = buffer;
+}
+
+/* Same as RetireBuffer; both must already be off the renderer's lists */
+static void VULKAN_INTERNAL_RetireTexture(VulkanRenderer *renderer, VulkanTexture *texture)
+{
+	VulkanFrameData *frame = &renderer->frames[renderer->currentFrame];
+	texture->next = frame->retiredTextures;
+	frame->retiredTextures = texture;
+}
+
+static void VULKAN_INTERNAL_RetireRenderbuffer(VulkanRenderer *renderer, VulkanRenderbuffer *renderbuffer)
+{
+	VulkanFrameData *frame = &renderer->frames[renderer->currentFrame];
+	renderbuffer->next = frame->retiredRenderbuffers;
+	frame->retiredRenderbuffers = renderbuffer;
+}
+
+static void VULKAN_INTERNAL_RetireProgram(VulkanRenderer *renderer, VulkanShaderProgram *program)
+{
+	VulkanFrameData *frame = &renderer->frames[renderer->currentFrame];
+	program->next = frame->retiredPrograms;
+	frame->retiredPrograms = program;
+}
+
+static void VULKAN_INTERNAL_RetirePipeline(VulkanRenderer *renderer, VkPipeline pipeline)
+{
+	VulkanFrameData *frame = &renderer->frames[renderer->currentFrame];
+	if (frame->retiredPipelineCount == frame->retiredPipelineCapacity) {
+		frame->retiredPipelineCapacity = SDL_max(16, frame->retiredPipelineCapacity * 2);
+		frame->retiredPipelines = (VkPipeline*) SDL_realloc(
+			frame->retiredPipelines,
+			sizeof(VkPipeline) * frame->retiredPipelineCapacity);
+	}
+	frame->retiredPipelines[frame->retiredPipelineCount] = pipeline;
+	frame->retiredPipelineCount += 1;
+}
+
+/* The frame's fence must have signaled before this is called */
+static void VULKAN_INTERNAL_DestroyRetiredResources(VulkanRenderer *renderer, VulkanFrameData *frame)
+{
+	VulkanBuffer *buffer, *nextBuffer;
+	VulkanTexture *texture, *nextTexture;
+	VulkanRenderbuffer *renderbuffer, *nextRenderbuffer;
+	VulkanShaderProgram *program, *nextProgram;
+	uint32_t i;
+
+	for (buffer = frame->retiredBuffers; buffer != NULL; buffer = nextBuffer) {
+		nextBuffer = buffer->next;
+		VULKAN_INTERNAL_DestroyBuffer(renderer, buffer);
+	}
+	frame->retiredBuffers = NULL;
+
+	for (texture = frame->retiredTextures; texture != NULL; texture = nextTexture) {
+		nextTexture = texture->next;
+		VULKAN_INTERNAL_DestroyTexture(renderer, texture);
+	}
+	frame->retiredTextures = NULL;
+
+	for (renderbuffer = frame->retiredRenderbuffers; renderbuffer != NULL; renderbuffer = nextRenderbuffer) {
+		nextRenderbuffer = renderbuffer->next;
+		VULKAN_INTERNAL_DestroyRenderbuffer(renderer, renderbuffer);
+	}
+	frame->retiredRenderbuffers = NULL;
+
+	for (i = 0; i < frame->retiredPipelineCount; i++) {
+		renderer->vkDestroyPipeline(renderer->device, frame->retiredPipelines[i], NULL);
+	}
+	frame->retiredPipelineCount = 0;
+
+	for (program = frame->retiredPrograms; program != NULL; program = nextProgram) {
+		nextProgram = program->next;
+		renderer->vkDestroyShaderModule(renderer->device, program->vertexModule, NULL);
+		renderer->vkDestroyShaderModule(renderer->device, program->fragmentModule, NULL);
+		SDL_free(program);
+	}
+	frame->retiredPrograms = NULL;
+}
+
+static inline uint8_t VULKAN_INTERNAL_BufferInFlight(VulkanRenderer *renderer, VulkanBuffer *buffer)
+{
+	return (	buffer->usedFrame != 0 &&
+			buffer->usedFrame + VULKAN_MAX_FRAMES_IN_FLIGHT > renderer->frameCount	);
+}
+
+/* Barriers */
+
+static VkAccessFlags VULKAN_INTERNAL_LayoutAccess(VkImageLayout layout)
+{
+	switch (layout) {
+	case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+		return VK_ACCESS_TRANSFER_READ_BIT;
+	case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+		return VK_ACCESS_TRANSFER_WRITE_BIT;
+	case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+		return VK_ACCESS_SHADER_READ_BIT;
+	case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+		return VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+		return VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
+		return VK_ACCESS_MEMORY_READ_BIT;
+	default:
+		return 0;
+	}
+}
+
+static void VULKAN_INTERNAL_FillImageBarrier(
+	VkImageMemoryBarrier *barrier,
+	VkImage image,
+	VkImageAspectFlags aspect,
+	uint32_t baseLevel,
+	uint32_t levelCount,
+	uint32_t layerCount,
+	VkImageLayout oldLayout,
+	VkImageLayout newLayout
+) {
+	SDL_zerop(barrier);
+	barrier->sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier->srcAccessMask = VULKAN_INTERNAL_LayoutAccess(oldLayout);
+	barrier->dstAccessMask = VULKAN_INTERNAL_LayoutAccess(newLayout);
+	barrier->oldLayout = oldLayout;
+	barrier->newLayout = newLayout;
+	barrier->srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier->dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier->image = image;
+	barrier->subresourceRange.aspectMask = aspect;
+	barrier->subresourceRange.baseMipLevel = baseLevel;
+	barrier->subresourceRange.levelCount = levelCount;
+	barrier->subresourceRange.baseArrayLayer = 0;
+	barrier->subresourceRange.layerCount = layerCount;
+}
+
+static void VULKAN_INTERNAL_ImageBarrier(
+	VulkanRenderer *renderer,
+	VkImage image,
+	VkImageAspectFlags aspect,
+	uint32_t baseLevel,
+	uint32_t levelCount,
+	uint32_t layerCount,
+	VkImageLayout oldLayout,
+	VkImageLayout newLayout
+) {
+	VkImageMemoryBarrier barrier;
+	VULKAN_INTERNAL_FillImageBarrier(
+		&barrier, image, aspect,
+		baseLevel, levelCount, layerCount,
+		oldLayout, newLayout);
+
+	renderer->vkCmdPipelineBarrier(
+		renderer->currentCommandBuffer,
+		(oldLayout == VK_IMAGE_LAYOUT_UNDEFINED) ?
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT :
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+		VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+		0, 0, NULL, 0, NULL, 1, &barrier);
+}
+
+static void VULKAN_INTERNAL_MemoryBarrier(
+	VulkanRenderer *renderer,
+	VkPipelineStageFlags srcStage,
+	VkAccessFlags srcAccess,
+	VkPipelineStageFlags dstStage,
+	VkAccessFlags dstAccess
+) {
+	VkMemoryBarrier barrier = {0};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = srcAccess;
+	barrier.dstAccessMask = dstAccess;
+	renderer->vkCmdPipelineBarrier(
+		renderer->currentCommandBuffer,
+		srcStage, dstStage, 0, 1, &barrier, 0, NULL, 0, NULL);
+}
+
+/* Texture layouts are tracked for the whole image. Must be called outside of
+ * a render pass.
+ */
+static void VULKAN_INTERNAL_TransitionTexture(
+	VulkanRenderer *renderer,
+	VulkanTexture *texture,
+	VkImageLayout newLayout
+) {
+	texture->usedFrame = renderer->frameCount;
+	if (texture->layout == newLayout) {
+		return;
+	}
+	VULKAN_INTERNAL_ImageBarrier(
+		renderer, texture->image, VK_IMAGE_ASPECT_COLOR_BIT,
+		0, texture->levelCount, texture->layerCount,
+		texture->layout, newLayout);
+	texture->layout = newLayout;
+}
+
+static void VULKAN_INTERNAL_TransitionRenderbuffer(
+	VulkanRenderer *renderer,
+	VulkanRenderbuffer *renderbuffer,
+	VkImageLayout newLayout
+) {
+	if (renderbuffer->layout == newLayout) {
+		return;
+	}
+	VULKAN_INTERNAL_ImageBarrier(
+		renderer, renderbuffer->image, renderbuffer->aspect,
+		0, 1, 1, renderbuffer->layout, newLayout);
+	renderbuffer->layout = newLayout;
+}
+
+/* Uploads */
+
+/* Space for an upload in this frame's staging ring. Anything the ring can't
+ * fit gets its own staging buffer, retired with the frame.
+ */
+static uint8_t* VULKAN_INTERNAL_AllocateStaging(
+	VulkanRenderer *renderer,
+	VkDeviceSize size,
+	VkBuffer *buffer,
+	VkDeviceSize *offset
+) {
+	VulkanFrameData *frame = &renderer->frames[renderer->currentFrame];
+	VulkanBuffer *dedicated;
+	VkDeviceSize alignment = SDL_max(
+		16, renderer->deviceProperties.limits.optimalBufferCopyOffsetAlignment);
+	VkDeviceSize start;
+
+	if (frame->stagingBuffer == NULL && size <= VULKAN_STAGING_BUFFER_SIZE) {
+		frame->stagingBuffer = VULKAN_INTERNAL_CreateBuffer(
+			renderer, VULKAN_STAGING_BUFFER_SIZE,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 1);
+	}
+	if (frame->stagingBuffer != NULL) {
+		start = (frame->stagingOffset + alignment - 1) & ~(alignment - 1);
+		if (start + size <= frame->stagingBuffer->size) {
+			frame->stagingOffset = start + size;
+			*buffer = frame->stagingBuffer->buffer;
+			*offset = start;
+			return frame->stagingBuffer->mappedPointer + start;
+		}
+	}
+
+	dedicated = VULKAN_INTERNAL_CreateBuffer(
+		renderer, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 1);
+	if (dedicated == NULL) {
+		return NULL;
+	}
+	VULKAN_INTERNAL_RetireBuffer(renderer, dedicated);
+	*buffer = dedicated->buffer;
+	*offset = 0;
+	return dedicated->mappedPointer;
+}
+
+/* Starts the frame's upload batch if needed. It runs before everything in
+ * commandBuffer, so only resources this frame hasn't touched yet may be
+ * written here.
+ */
+static VkCommandBuffer VULKAN_INTERNAL_BeginUploads(VulkanRenderer *renderer)
+{
+	VulkanFrameData *frame = &renderer->frames[renderer->currentFrame];
+
+	if (!frame->uploadActive) {
+		VkCommandBufferBeginInfo beginInfo = {0};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		renderer->vkBeginCommandBuffer(frame->uploadCommandBuffer, &beginInfo);
+
+		/* Earlier submissions may still read or write what we overwrite */
+		VkMemoryBarrier barrier = {0};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		renderer->vkCmdPipelineBarrier(
+			frame->uploadCommandBuffer,
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 1, &barrier, 0, NULL, 0, NULL);
+
+		frame->uploadActive = 1;
+	}
+	return frame->uploadCommandBuffer;
+}
+
+/* Gets the texture ready for a copy in the upload batch. Its tracked layout
+ * becomes SHADER_READ_ONLY right away, since that's where the batch leaves
+ * it before commandBuffer runs.
+ */
+static void VULKAN_INTERNAL_BatchTextureUpload(
+	VulkanRenderer *renderer,
+	VkCommandBuffer commandBuffer,
+	VulkanTexture *texture
+) {
+	VulkanFrameData *frame = &renderer->frames[renderer->currentFrame];
+	VkImageMemoryBarrier imageBarrier;
+
+	if (texture->uploadPending) {
+		/* Copies to the same image may overlap */
+		VkMemoryBarrier barrier = {0};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		renderer->vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 1, &barrier, 0, NULL, 0, NULL);
+		return;
+	}
+
+	VULKAN_INTERNAL_FillImageBarrier(
+		&imageBarrier, texture->image, VK_IMAGE_ASPECT_COLOR_BIT,
+		0, texture->levelCount, texture->layerCount,
+		texture->layout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	renderer->vkCmdPipelineBarrier(
+		commandBuffer,
+		(texture->layout == VK_IMAGE_LAYOUT_UNDEFINED) ?
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT :
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0, 0, NULL, 0, NULL, 1, &imageBarrier);
+
+	if (frame->uploadTextureCount == frame->uploadTextureCapacity) {
+		frame->uploadTextureCapacity = SDL_max(16, frame->uploadTextureCapacity * 2);
+		frame->uploadTextures = (VulkanTexture**) SDL_realloc(
+			frame->uploadTextures,
+			sizeof(VulkanTexture*) * frame->uploadTextureCapacity);
+	}
+	frame->uploadTextures[frame->uploadTextureCount] = texture;
+	frame->uploadTextureCount += 1;
+	texture->uploadPending = 1;
+	texture->layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+}
+
+/* Ends the frame's command buffers. Returns how many were written to
+ * commandBuffers, the upload batch (if any) first. The caller must submit
+ * them with the frame's fence right away.
+ */
+static uint32_t VULKAN_INTERNAL_EndCommandBuffers(
+	VulkanRenderer *renderer,
+	VkCommandBuffer *commandBuffers
+) {
+	VulkanFrameData *frame = &renderer->frames[renderer->currentFrame];
+	VkImageMemoryBarrier *imageBarriers;
+	VulkanTexture *texture;
+	uint32_t i, count = 0;
+
+	/* A query can't span command buffers, so one still running only
+	 * counts what was drawn before this submit
+	 */
+	if (renderer->activeQuery != NULL) {
+		renderer->vkCmdEndQuery(
+			frame->commandBuffer, renderer->occlusionQueryPool,
+			renderer->activeQuery->index);
+		renderer->activeQuery->active = 0;
+		renderer->activeQuery = NULL;
+	}
+	renderer->submitCount++;
+	frame->submission = renderer->submitCount;
+
+	if (frame->uploadActive) {
+		/* One barrier for the whole batch */
+		imageBarriers = (VkImageMemoryBarrier*) SDL_malloc(
+			sizeof(VkImageMemoryBarrier) * SDL_max(frame->uploadTextureCount, 1));
+		for (i = 0; i < frame->uploadTextureCount; i++) {
+			texture = frame->uploadTextures[i];
+			VULKAN_INTERNAL_FillImageBarrier(
+				&imageBarriers[i], texture->image, VK_IMAGE_ASPECT_COLOR_BIT,
+				0, texture->levelCount, texture->layerCount,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			texture->uploadPending = 0;
+		}
+
+		VkMemoryBarrier barrier = {0};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+		renderer->vkCmdPipelineBarrier(
+			frame->uploadCommandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			0, 1, &barrier, 0, NULL,
+			frame->uploadTextureCount, imageBarriers);
+		SDL_free(imageBarriers);
+
+		renderer->vkEndCommandBuffer(frame->uploadCommandBuffer);
+		commandBuffers[count++] = frame->uploadCommandBuffer;
+		frame->uploadTextureCount = 0;
+		frame->uploadActive = 0;
+	}
+
+	renderer->vkEndCommandBuffer(frame->commandBuffer);
+	commandBuffers[count++] = frame->commandBuffer;
+	return count;
+}
+
+/* Descriptors */
+
+static VkDescriptorPool VULKAN_INTERNAL_CreateDescriptorPool(VulkanRenderer *renderer)
+{
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	VkDescriptorPoolSize poolSizes[2];
+	VkResult result;
+
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[0].descriptorCount = VULKAN_DESCRIPTOR_POOL_SETS * VULKAN_MAX_TEXTURE_SAMPLERS;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	poolSizes[1].descriptorCount = 16;
+
+	VkDescriptorPoolCreateInfo poolInfo = {0};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = VULKAN_DESCRIPTOR_POOL_SETS;
+	poolInfo.poolSizeCount = 2;
+	poolInfo.pPoolSizes = poolSizes;
+
+	result = renderer->vkCreateDescriptorPool(renderer->device, &poolInfo, NULL, &pool);
+	VK_CHECK_RET(result, VK_NULL_HANDLE);
+	return pool;
+}
+
+/* Sets are never freed individually; the frame's pools are reset as a whole
+ * when the frame slot comes around again.
+ */
+static VkDescriptorSet VULKAN_INTERNAL_AllocateDescriptorSet(
+	VulkanRenderer *renderer,
+	VkDescriptorSetLayout layout
+) {
+	VulkanFrameData *frame = &renderer->frames[renderer->currentFrame];
+	VkDescriptorSet set = VK_NULL_HANDLE;
+	VkResult result;
+
+	VkDescriptorSetAllocateInfo allocInfo = {0};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &layout;
+
+	while (1) {
+		allocInfo.descriptorPool = frame->descriptorPool;
+		result = renderer->vkAllocateDescriptorSets(renderer->device, &allocInfo, &set);
+		if (result == VK_SUCCESS) {
+			return set;
+		}
+		if (	result != VK_ERROR_OUT_OF_POOL_MEMORY &&
+			result != VK_ERROR_FRAGMENTED_POOL	) {
+			VK_LOG_ERROR("vkAllocateDescriptorSets failed: %d", result);
+			return VK_NULL_HANDLE;
+		}
+
+		/* This pool is full, move on to the next one */
+		frame->descriptorPoolIndex++;
+		if (frame->descriptorPoolIndex == frame->descriptorPoolCount) {
+			VkDescriptorPool pool = VULKAN_INTERNAL_CreateDescriptorPool(renderer);
+			if (pool == VK_NULL_HANDLE) {
+				frame->descriptorPoolIndex--;
+				return VK_NULL_HANDLE;
+			}
+			frame->descriptorPools = (VkDescriptorPool*) SDL_realloc(
+				frame->descriptorPools,
+				sizeof(VkDescriptorPool) * (frame->descriptorPoolCount + 1));
+			frame->descriptorPools[frame->descriptorPoolCount++] = pool;
+		}
+		frame->descriptorPool = frame->descriptorPools[frame->descriptorPoolIndex];
+	}
+}
+
+static void VULKAN_INTERNAL_AllocateUniformSet(VulkanRenderer *renderer)
+{
+	VulkanFrameData *frame = &renderer->frames[renderer->currentFrame];
+
+	frame->uniformDescriptorSet = VULKAN_INTERNAL_AllocateDescriptorSet(
+		renderer, renderer->uniformLayout);
+	if (frame->uniformDescriptorSet == VK_NULL_HANDLE) {
+		return;
+	}
+
+	VkDescriptorBufferInfo bufferInfo;
+	bufferInfo.buffer = frame->uniformBuffer->buffer;
+	bufferInfo.offset = 0;
+	bufferInfo.range = VULKAN_UNIFORM_RANGE;
+
+	VkWriteDescriptorSet write = {0};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = frame->uniformDescriptorSet;
+	write.dstBinding = 0;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	write.pBufferInfo = &bufferInfo;
+	renderer->vkUpdateDescriptorSets(renderer->device, 1, &write, 0, NULL);
+}
+
+/* Frames */
+
+static void VULKAN_INTERNAL_BeginFrame(VulkanRenderer *renderer)
+{
+	VulkanFrameData *frame = &renderer->frames[renderer->currentFrame];
+	uint32_t i;
+
+	/* Wait for the last submission from this slot to finish */
+	renderer->vkWaitForFences(renderer->device, 1, &frame->fence, VK_TRUE, UINT64_MAX);
+	renderer->vkResetFences(renderer->device, 1, &frame->fence);
+	renderer->completedSubmit = SDL_max(renderer->completedSubmit, frame->submission);
+
+	VULKAN_INTERNAL_DestroyRetiredResources(renderer, frame);
+
+	/* Descriptor pools */
+	if (frame->descriptorPoolCount == 0) {
+		frame->descriptorPools = (VkDescriptorPool*) SDL_malloc(sizeof(VkDescriptorPool));
+		frame->descriptorPools[0] = VULKAN_INTERNAL_CreateDescriptorPool(renderer);
+		frame->descriptorPoolCount = 1;
+	} else {
+		for (i = 0; i < frame->descriptorPoolCount; i++) {
+			renderer->vkResetDescriptorPool(renderer->device, frame->descriptorPools[i], 0);
+		}
+	}
+	frame->descriptorPoolIndex = 0;
+	frame->descriptorPool = frame->descriptorPools[0];
+
+	/* Uniforms */
+	if (frame->uniformBuffer == NULL) {
+		frame->uniformBuffer = VULKAN_INTERNAL_CreateBuffer(
+			renderer, VULKAN_UNIFORM_BUFFER_SIZE,
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 1);
+	}
+	frame->uniformOffset = 0;
+	VULKAN_INTERNAL_AllocateUniformSet(renderer);
+	frame->stagingOffset = 0;
+
+	/* Command buffer */
+	renderer->vkResetCommandPool(renderer->device, frame->commandPool, 0);
+
+	VkCommandBufferBeginInfo beginInfo = {0};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	renderer->vkBeginCommandBuffer(frame->commandBuffer, &beginInfo);
+	renderer->currentCommandBuffer = frame->commandBuffer;
+
+	/* Nothing is bound on a fresh command buffer */
+	renderer->renderPassActive = 0;
+	renderer->currentPipeline = VK_NULL_HANDLE;
+	renderer->boundIndexBuffer = VK_NULL_HANDLE;
+	renderer->boundVertexBufferCount = 0;
+	renderer->pipelineDirty = 1;
+	renderer->viewportDirty = 1;
+	renderer->scissorDirty = 1;
+	renderer->blendFactorDirty = 1;
+	renderer->stencilReferenceDirty = 1;
+	renderer->uniformsDirty = 1;
+	renderer->vertexSamplersDirty = 1;
+	renderer->fragmentSamplersDirty = 1;
+	renderer->descriptorSetsDirty = 1;
+}
+
+/* Submits everything recorded so far and waits for it, then starts over on
+ * the same frame slot. Used when the CPU needs the GPU's results right away.
+ */
+static void VULKAN_INTERNAL_FlushAndWait(VulkanRenderer *renderer)
+{
+	VulkanFrameData *frame = &renderer->frames[renderer->currentFrame];
+	VkCommandBuffer commandBuffers[2];
+
+	VULKAN_INTERNAL_EndRenderPass(renderer);
+
+	VkSubmitInfo submitInfo = {0};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = VULKAN_INTERNAL_EndCommandBuffers(renderer, commandBuffers);
+	submitInfo.pCommandBuffers = commandBuffers;
+	renderer->vkQueueSubmit(renderer->graphicsQueue, 1, &submitInfo, frame->fence);
+
+	/* BeginFrame waits on the fence we just submitted */
+	VULKAN_INTERNAL_BeginFrame(renderer);
+}
+
+/* Whether the given submission from the given frame slot has finished. With
+ * wait set, this submits and blocks as needed instead of returning 0.
+ */
+static uint8_t VULKAN_INTERNAL_SubmissionComplete(
+	VulkanRenderer *renderer,
+	uint32_t frameIndex,
+	uint64_t submission,
+	uint8_t wait
+) {
+	VulkanFrameData *frame = &renderer->frames[frameIndex];
+
+	if (submission > renderer->submitCount) {
+		/* Still in the command buffer being recorded */
+		if (!wait) {
+			return 0;
+		}
+		VULKAN_INTERNAL_FlushAndWait(renderer);
+	}
+	if (submission <= renderer->completedSubmit) {
+		return 1;
+	}
+
+	/* The slot's fence is only reset by BeginFrame, which bumps completedSubmit first */
+	if (wait) {
+		renderer->vkWaitForFences(renderer->device, 1, &frame->fence, VK_TRUE, UINT64_MAX);
+	} else if (renderer->vkGetFenceStatus(renderer->device, frame->fence) != VK_SUCCESS) {
+		return 0;
+	}
+	renderer->completedSubmit = SDL_max(renderer->completedSubmit, frame->submission);
+	return 1;
+}
+
+/* Render Passes */
+
+static VkFormat VULKAN_INTERNAL_GetDepthFormat(VulkanRenderer *renderer, FNA3D_DepthFormat format)
+{
+	if (format == FNA3D_DEPTHFORMAT_D24 || format == FNA3D_DEPTHFORMAT_D24S8) {
+		return renderer->d24Format;
+	}
+	return VULKAN_INTERNAL_GetVkDepthFormat(format);
+}
+
+static VkSampleCountFlagBits VULKAN_INTERNAL_CurrentSampleCount(VulkanRenderer *renderer)
+{
+	if (renderer->colorMultisampleAttachments[0] != NULL) {
+		return (VkSampleCountFlagBits) renderer->colorMultisampleAttachments[0]->sampleCount;
+	}
+	return VK_SAMPLE_COUNT_1_BIT;
+}
+
+/* colorFormats must be VK_FORMAT_UNDEFINED past colorCount */
+static VulkanRenderPass* VULKAN_INTERNAL_FetchRenderPassForFormats(
+	VulkanRenderer *renderer,
+	const VkFormat colorFormats[VULKAN_MAX_RENDER_TARGETS],
+	uint32_t colorCount,
+	VkFormat depthFormat,
+	VkSampleCountFlagBits sampleCount,
+	uint8_t clearColor,
+	uint8_t clearDepth,
+	uint8_t clearStencil
+) {
+	VkAttachmentDescription attachments[VULKAN_MAX_FRAMEBUFFER_ATTACHMENTS];
+	VkAttachmentReference colorRefs[VULKAN_MAX_RENDER_TARGETS];
+	VkAttachmentReference resolveRefs[VULKAN_MAX_RENDER_TARGETS];
+	VkAttachmentReference depthRef;
+	VkSubpassDependency dependencies[2];
+	uint32_t attachmentCount = 0;
+	VulkanRenderPass *pass;
+	VkResult result;
+	uint32_t i;
+
+	if (depthFormat == VK_FORMAT_UNDEFINED) {
+		clearDepth = 0;
+		clearStencil = 0;
+	}
+
+	for (pass = renderer->renderPassList; pass != NULL; pass = pass->next) {
+		if (	pass->colorAttachmentCount == colorCount &&
+			SDL_memcmp(pass->colorFormats, colorFormats, sizeof(pass->colorFormats)) == 0 &&
+			pass->depthFormat == depthFormat &&
+			pass->sampleCount == sampleCount &&
+			pass->clearColor == clearColor &&
+			pass->clearDepth == clearDepth &&
+			pass->clearStencil == clearStencil	) {
+			return pass;
+		}
+	}
+
+	/* Color attachments, multisampled if MSAA is on */
+	for (i = 0; i < colorCount; i++) {
+		VkAttachmentDescription *desc = &attachments[attachmentCount];
+		SDL_zerop(desc);
+		desc->format = colorFormats[i];
+		desc->samples = sampleCount;
+		desc->loadOp = clearColor ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+		desc->storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		desc->stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		desc->stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		desc->initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		desc->finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		colorRefs[i].attachment = attachmentCount;
+		colorRefs[i].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		attachmentCount++;
+	}
+
+	/* Resolve targets, the textures themselves */
+	if (sampleCount > VK_SAMPLE_COUNT_1_BIT) {
+		for (i = 0; i < colorCount; i++) {
+			VkAttachmentDescription *desc = &attachments[attachmentCount];
+			SDL_zerop(desc);
+			desc->format = colorFormats[i];
+			desc->samples = VK_SAMPLE_COUNT_1_BIT;
+			desc->loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			desc->storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			desc->stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			desc->stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			desc->initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			desc->finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			resolveRefs[i].attachment = attachmentCount;
+			resolveRefs[i].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			attachmentCount++;
+		}
+	}
+
+	if (depthFormat != VK_FORMAT_UNDEFINED) {
+		VkAttachmentDescription *desc = &attachments[attachmentCount];
+		SDL_zerop(desc);
+		desc->format = depthFormat;
+		desc->samples = sampleCount;
+		desc->loadOp = clearDepth ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+		desc->storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		desc->stencilLoadOp = clearStencil ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+		desc->stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
+		desc->initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		desc->finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthRef.attachment = attachmentCount;
+		depthRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		attachmentCount++;
+	}
+
+	VkSubpassDescription subpass = {0};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = colorCount;
+	subpass.pColorAttachments = colorRefs;
+	subpass.pResolveAttachments = (sampleCount > VK_SAMPLE_COUNT_1_BIT) ? resolveRefs : NULL;
+	subpass.pDepthStencilAttachment = (depthFormat != VK_FORMAT_UNDEFINED) ? &depthRef : NULL;
+
+	/* Attachment writes from earlier passes must land before we load or
+	 * overwrite them, and ours must land before anything samples them.
+	 */
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].srcStageMask =
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+		VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[0].dstStageMask =
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+		VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+		VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[0].srcAccessMask =
+		VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+		VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[0].dstAccessMask =
+		VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+		VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+		VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+		VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[0].dependencyFlags = 0;
+
+	dependencies[1].srcSubpass = 0;
+	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].srcStageMask =
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+		VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[1].dstStageMask =
+		VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+		VK_PIPELINE_STAGE_TRANSFER_BIT;
+	dependencies[1].srcAccessMask =
+		VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+		VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[1].dstAccessMask =
+		VK_ACCESS_SHADER_READ_BIT |
+		VK_ACCESS_TRANSFER_READ_BIT;
+	dependencies[1].dependencyFlags = 0;
+
+	VkRenderPassCreateInfo passInfo = {0};
+	passInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	passInfo.attachmentCount = attachmentCount;
+	passInfo.pAttachments = attachments;
+	passInfo.subpassCount = 1;
+	passInfo.pSubpasses = &subpass;
+	passInfo.dependencyCount = 2;
+	passInfo.pDependencies = dependencies;
+
+	pass = (VulkanRenderPass*) SDL_malloc(sizeof(VulkanRenderPass));
+	SDL_memset(pass, 0, sizeof(VulkanRenderPass));
+	result = renderer->vkCreateRenderPass(renderer->device, &passInfo, NULL, &pass->renderPass);
+	if (result != VK_SUCCESS) {
+		VK_LOG_ERROR("vkCreateRenderPass failed: %d", result);
+		SDL_free(pass);
+		return NULL;
+	}
+
+	SDL_memcpy(pass->colorFormats, colorFormats, sizeof(pass->colorFormats));
+	pass->colorAttachmentCount = colorCount;
+	pass->depthFormat = depthFormat;
+	pass->sampleCount = sampleCount;
+	pass->hasDepthStencil = (depthFormat != VK_FORMAT_UNDEFINED);
+	pass->clearColor = clearColor;
+	pass->clearDepth = clearDepth;
+	pass->clearStencil = clearStencil;
+	pass->next = renderer->renderPassList;
+	renderer->renderPassList = pass;
+	return pass;
+}
+
+static VulkanRenderPass* VULKAN_INTERNAL_FetchRenderPass(
+	VulkanRenderer *renderer,
+	uint8_t clearColor,
+	uint8_t clearDepth,
+	uint8_t clearStencil
+) {
+	VkFormat colorFormats[VULKAN_MAX_RENDER_TARGETS];
+	VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+	uint32_t i;
+
+	for (i = 0; i < VULKAN_MAX_RENDER_TARGETS; i++) {
+		colorFormats[i] = (i < renderer->colorAttachmentCount) ?
+			renderer->colorAttachments[i]->format :
+			VK_FORMAT_UNDEFINED;
+	}
+	if (renderer->depthStencilAttachment != NULL) {
+		depthFormat = renderer->depthStencilAttachment->format;
+	}
+
+	return VULKAN_INTERNAL_FetchRenderPassForFormats(
+		renderer,
+		colorFormats,
+		renderer->colorAttachmentCount,
+		depthFormat,
+		VULKAN_INTERNAL_CurrentSampleCount(renderer),
+		clearColor,
+		clearDepth,
+		clearStencil);
+}
+
+/* Framebuffers are keyed on their views and always created against the
+ * load-only pass, which is compatible with every clear variant.
+ */
+static VulkanFramebuffer* VULKAN_INTERNAL_FetchFramebuffer(
+	VulkanRenderer *renderer,
+	VulkanRenderPass *renderPass
+) {
+	VkImageView views[VULKAN_MAX_FRAMEBUFFER_ATTACHMENTS];
+	uint32_t viewCount = 0;
+	uint32_t i;
+	VulkanFramebuffer *framebuffer;
+	VkResult result;
+
+	for (i = 0; i < renderer->colorAttachmentCount; i++) {
+		if (renderer->colorMultisampleAttachments[i] != NULL) {
+			views[viewCount++] = renderer->colorMultisampleAttachments[i]->view;
+		} else {
+			views[viewCount++] = renderer->colorAttachments[i]->rtViews[
+				renderer->colorAttachmentLayers[i]
+			];
+		}
+	}
+	if (renderPass->sampleCount > VK_SAMPLE_COUNT_1_BIT) {
+		for (i = 0; i < renderer->colorAttachmentCount; i++) {
+			views[viewCount++] = renderer->colorAttachments[i]->rtViews[
+				renderer->colorAttachmentLayers[i]
+			];
+		}
+	}
+	if (renderer->depthStencilAttachment != NULL) {
+		views[viewCount++] = renderer->depthStencilAttachment->view;
+	}
+
+	for (framebuffer = renderer->framebufferList; framebuffer != NULL; framebuffer = framebuffer->next) {
+		if (	framebuffer->renderPass == renderPass &&
+			framebuffer->attachmentCount == viewCount &&
+			framebuffer->width == renderer->renderTargetWidth &&
+			framebuffer->height == renderer->renderTargetHeight &&
+			SDL_memcmp(framebuffer->attachments, views, sizeof(VkImageView) * viewCount) == 0	) {
+			return framebuffer;
+		}
+	}
+
+	VkFramebufferCreateInfo fbInfo = {0};
+	fbInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	fbInfo.renderPass = renderPass->renderPass;
+	fbInfo.attachmentCount = viewCount;
+	fbInfo.pAttachments = views;
+	fbInfo.width = renderer->renderTargetWidth;
+	fbInfo.height = renderer->renderTargetHeight;
+	fbInfo.layers = 1;
+
+	framebuffer = (VulkanFramebuffer*) SDL_malloc(sizeof(VulkanFramebuffer));
+	SDL_memset(framebuffer, 0, sizeof(VulkanFramebuffer));
+	result = renderer->vkCreateFramebuffer(renderer->device, &fbInfo, NULL, &framebuffer->framebuffer);
+	if (result != VK_SUCCESS) {
+		VK_LOG_ERROR("vkCreateFramebuffer failed: %d", result);
+		SDL_free(framebuffer);
+		return NULL;
+	}
+
+	framebuffer->renderPass = renderPass;
+	SDL_memcpy(framebuffer->attachments, views, sizeof(VkImageView) * viewCount);
+	framebuffer->attachmentCount = viewCount;
+	framebuffer->width = renderer->renderTargetWidth;
+	framebuffer->height = renderer->renderTargetHeight;
+	framebuffer->next = renderer->framebufferList;
+	renderer->framebufferList = framebuffer;
+	return framebuffer;
+}
+
+/* Called before a view is destroyed. The caller has made sure the GPU is
+ * done with it.
+ */
+static void VULKAN_INTERNAL_DestroyFramebuffersWithView(VulkanRenderer *renderer, VkImageView view)
+{
+	VulkanFramebuffer **prev = &renderer->framebufferList;
+	VulkanFramebuffer *framebuffer;
+	uint32_t i;
+	uint8_t found;
+
+	while (*prev != NULL) {
+		framebuffer = *prev;
+		found = 0;
+		for (i = 0; i < framebuffer->attachmentCount; i++) {
+			if (framebuffer->attachments[i] == view) {
+				found = 1;
+				break;
+			}
+		}
+		if (found) {
+			*prev = framebuffer->next;
+			if (renderer->currentFramebuffer == framebuffer) {
+				renderer->currentFramebuffer = NULL;
+			}
+			renderer->vkDestroyFramebuffer(renderer->device, framebuffer->framebuffer, NULL);
+			SDL_free(framebuffer);
+		} else {
+			prev = &framebuffer->next;
+		}
+	}
+}
+
+static void VULKAN_INTERNAL_BeginRenderPass(VulkanRenderer *renderer)
+{
+	VkClearValue clearValues[VULKAN_MAX_FRAMEBUFFER_ATTACHMENTS];
+	VulkanRenderPass *loadPass, *beginPass;
+	VulkanFramebuffer *framebuffer;
+	uint32_t clearCount = 0;
+	uint32_t i;
+
+	if (renderer->renderPassActive || renderer->colorAttachmentCount == 0) {
+		return;
+	}
+
+	for (i = 0; i < renderer->colorAttachmentCount; i++) {
+		VULKAN_INTERNAL_TransitionTexture(
+			renderer, renderer->colorAttachments[i],
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+		if (renderer->colorMultisampleAttachments[i] != NULL) {
+			VULKAN_INTERNAL_TransitionRenderbuffer(
+				renderer, renderer->colorMultisampleAttachments[i],
+				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+		}
+	}
+	if (renderer->depthStencilAttachment != NULL) {
+		VULKAN_INTERNAL_TransitionRenderbuffer(
+			renderer, renderer->depthStencilAttachment,
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+	}
+
+	loadPass = VULKAN_INTERNAL_FetchRenderPass(renderer, 0, 0, 0);
+	beginPass = VULKAN_INTERNAL_FetchRenderPass(
+		renderer,
+		renderer->pendingClearColor,
+		renderer->pendingClearDepth,
+		renderer->pendingClearStencil);
+	if (loadPass == NULL || beginPass == NULL) {
+		return;
+	}
+	framebuffer = VULKAN_INTERNAL_FetchFramebuffer(renderer, loadPass);
+	if (framebuffer == NULL) {
+		return;
+	}
+
+	/* Clear values are indexed by attachment; resolves ignore theirs */
+	for (i = 0; i < framebuffer->attachmentCount; i++) {
+		clearValues[i].color = renderer->clearColorValue;
+	}
+	if (renderer->depthStencilAttachment != NULL) {
+		clearValues[framebuffer->attachmentCount - 1].depthStencil =
+			renderer->clearDepthStencilValue;
+	}
+	clearCount = framebuffer->attachmentCount;
+
+	VkRenderPassBeginInfo beginInfo = {0};
+	beginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	beginInfo.renderPass = beginPass->renderPass;
+	beginInfo.framebuffer = framebuffer->framebuffer;
+	beginInfo.renderArea.extent.width = renderer->renderTargetWidth;
+	beginInfo.renderArea.extent.height = renderer->renderTargetHeight;
+	beginInfo.clearValueCount = clearCount;
+	beginInfo.pClearValues = clearValues;
+	renderer->vkCmdBeginRenderPass(
+		renderer->currentCommandBuffer, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+	renderer->pendingClearColor = 0;
+	renderer->pendingClearDepth = 0;
+	renderer->pendingClearStencil = 0;
+	renderer->currentRenderPass = loadPass;
+	renderer->currentFramebuffer = framebuffer;
+	renderer->renderPassActive = 1;
+
+	/* Different pass means a different pipeline, even for the same state */
+	renderer->pipelineDirty = 1;
+	renderer->viewportDirty = 1;
+	renderer->scissorDirty = 1;
+}
+
+static void VULKAN_INTERNAL_EndRenderPass(VulkanRenderer *renderer)
+{
+	uint32_t i;
+
+	/* Clears with no draws still have to happen */
+	if (	!renderer->renderPassActive &&
+		(	renderer->pendingClearColor ||
+			renderer->pendingClearDepth ||
+			renderer->pendingClearStencil	)	) {
+		VULKAN_INTERNAL_BeginRenderPass(renderer);
+	}
+
+	if (!renderer->renderPassActive) {
+		return;
+	}
+
+	renderer->vkCmdEndRenderPass(renderer->currentCommandBuffer);
+	renderer->renderPassActive = 0;
+	renderer->currentPipeline = VK_NULL_HANDLE;
+
+	/* Targets are most likely sampled next */
+	for (i = 0; i < renderer->colorAttachmentCount; i++) {
+		VULKAN_INTERNAL_TransitionTexture(
+			renderer, renderer->colorAttachments[i],
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	}
+
+	renderer->vertexSamplersDirty = 1;
+	renderer->fragmentSamplersDirty = 1;
+}
+
+/* Textures */
+
+static VulkanTexture* VULKAN_INTERNAL_CreateTexture(
+	VulkanRenderer *renderer,
+	FNA3D_SurfaceFormat format,
+	uint32_t width,
+	uint32_t height,
+	uint32_t depth,
+	uint32_t levelCount,
+	uint8_t is3D,
+	uint8_t isCube,
+	uint8_t isRenderTarget
+) {
+	VulkanTexture *texture;
+	VkMemoryRequirements memReqs;
+	VkResult result;
+	uint32_t i;
+
+	texture = (VulkanTexture*) SDL_malloc(sizeof(VulkanTexture));
+	SDL_memset(texture, 0, sizeof(VulkanTexture));
+	texture->format = VULKAN_INTERNAL_GetVkFormat(format);
+	texture->surfaceFormat = format;
+	texture->width = width;
+	texture->height = height;
+	texture->depth = depth;
+	texture->levelCount = levelCount;
+	texture->layerCount = isCube ? 6 : 1;
+	texture->layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	texture->isRenderTarget = isRenderTarget;
+	texture->is3D = is3D;
+	texture->isCube = isCube;
+
+	VkImageCreateInfo imageInfo = {0};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.flags = isCube ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0;
+	imageInfo.imageType = is3D ? VK_IMAGE_TYPE_3D : VK_IMAGE_TYPE_2D;
+	imageInfo.format = texture->format;
+	imageInfo.extent.width = width;
+	imageInfo.extent.height = height;
+	imageInfo.extent.depth = depth;
+	imageInfo.mipLevels = levelCount;
+	imageInfo.arrayLayers = texture->layerCount;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage =
+		VK_IMAGE_USAGE_SAMPLED_BIT |
+		VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	if (isRenderTarget) {
+		imageInfo.usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	}
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	result = renderer->vkCreateImage(renderer->device, &imageInfo, NULL, &texture->image);
+	if (result != VK_SUCCESS) {
+		VK_LOG_ERROR("vkCreateImage failed: %d", result);
+		SDL_free(texture);
+		return NULL;
+	}
+
+	renderer->vkGetImageMemoryRequirements(renderer->device, texture->image, &memReqs);
+	if (!VULKAN_INTERNAL_AllocateMemory(
+		renderer, &memReqs, 0, 1, isRenderTarget, &texture->allocation
+	)) {
+		renderer->vkDestroyImage(renderer->device, texture->image, NULL);
+		SDL_free(texture);
+		return NULL;
+	}
+	renderer->vkBindImageMemory(
+		renderer->device, texture->image,
+		VULKAN_INTERNAL_AllocationMemory(&texture->allocation),
+		texture->allocation.offset);
+
+	VkImageViewCreateInfo viewInfo = {0};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = texture->image;
+	if (is3D) {
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_3D;
+	} else if (isCube) {
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_CUBE;
+	} else {
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	}
+	viewInfo.format = texture->format;
+	viewInfo.components = VULKAN_INTERNAL_GetSwizzle(format);
+	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewInfo.subresourceRange.baseMipLevel = 0;
+	viewInfo.subresourceRange.levelCount = levelCount;
+	viewInfo.subresourceRange.baseArrayLayer = 0;
+	viewInfo.subresourceRange.layerCount = texture->layerCount;
+	renderer->vkCreateImageView(renderer->device, &viewInfo, NULL, &texture->view);
+
+	/* Attachments want a single layer and level, and no swizzle */
+	if (isRenderTarget) {
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+		viewInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+		viewInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+		viewInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.layerCount = 1;
+		for (i = 0; i < texture->layerCount; i++) {
+			viewInfo.subresourceRange.baseArrayLayer = i;
+			renderer->vkCreateImageView(renderer->device, &viewInfo, NULL, &texture->rtViews[i]);
+		}
+	}
+
+	texture->next = renderer->textureList;
+	renderer->textureList = texture;
+	return texture;
+}
+
+/* The GPU must be done with the texture before this is called */
+static void VULKAN_INTERNAL_DestroyTexture(VulkanRenderer *renderer, VulkanTexture *texture)
+{
+	VulkanTexture **prev;
+	uint32_t i;
+
+	for (prev = &renderer->textureList; *prev != NULL; prev = &(*prev)->next) {
+		if (*prev == texture) {
+			*prev = texture->next;
+			break;
+		}
+	}
+
+	for (i = 0; i < texture->layerCount; i++) {
+		if (texture->rtViews[i] != VK_NULL_HANDLE) {
+			VULKAN_INTERNAL_DestroyFramebuffersWithView(renderer, texture->rtViews[i]);
+			renderer->vkDestroyImageView(renderer->device, texture->rtViews[i], NULL);
+		}
+	}
+	renderer->vkDestroyImageView(renderer->device, texture->view, NULL);
+	renderer->vkDestroyImage(renderer->device, texture->image, NULL);
+	VULKAN_INTERNAL_FreeMemory(renderer, &texture->allocation);
+	SDL_free(texture);
+}
+
+/* Copies through the staging ring. Textures this frame hasn't used yet go in
+ * the upload batch, anything else is copied in order, outside the render pass.
+ */
+static void VULKAN_INTERNAL_UploadTexture(
+	VulkanRenderer *renderer,
+	VulkanTexture *texture,
+	int32_t x,
+	int32_t y,
+	int32_t z,
+	int32_t w,
+	int32_t h,
+	int32_t d,
+	int32_t level,
+	int32_t layer,
+	void *data,
+	int32_t dataLength
+) {
+	VkCommandBuffer commandBuffer;
+	VkBuffer stagingBuffer;
+	VkDeviceSize stagingOffset;
+	uint8_t *staging;
+	uint8_t inOrder = (texture->usedFrame == renderer->frameCount);
+
+	if (dataLength <= 0) {
+		return;
+	}
+
+	staging = VULKAN_INTERNAL_AllocateStaging(
+		renderer, dataLength, &stagingBuffer, &stagingOffset);
+	if (staging == NULL) {
+		return;
+	}
+	SDL_memcpy(staging, data, dataLength);
+
+	if (inOrder) {
+		VULKAN_INTERNAL_EndRenderPass(renderer);
+		VULKAN_INTERNAL_TransitionTexture(
+			renderer, texture, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+		commandBuffer = renderer->currentCommandBuffer;
+	} else {
+		commandBuffer = VULKAN_INTERNAL_BeginUploads(renderer);
+		VULKAN_INTERNAL_BatchTextureUpload(renderer, commandBuffer, texture);
+	}
+
+	VkBufferImageCopy region = {0};
+	region.bufferOffset = stagingOffset;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = level;
+	region.imageSubresource.baseArrayLayer = layer;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset.x = x;
+	region.imageOffset.y = y;
+	region.imageOffset.z = z;
+	region.imageExtent.width = w;
+	region.imageExtent.height = h;
+	region.imageExtent.depth = d;
+	renderer->vkCmdCopyBufferToImage(
+		commandBuffer, stagingBuffer, texture->image,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+	if (inOrder) {
+		VULKAN_INTERNAL_TransitionTexture(
+			renderer, texture, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	}
+}
+
+/* Records a copy of the region into a new host-visible buffer. The data is
+ * there once the current command buffer has been submitted and finished.
+ */
+static VulkanBuffer* VULKAN_INTERNAL_RecordTextureRead(
+	VulkanRenderer *renderer,
+	VulkanTexture *texture,
+	int32_t x,
+	int32_t y,
+	int32_t z,
+	int32_t w,
+	int32_t h,
+	int32_t d,
+	int32_t level,
+	int32_t layer
+) {
+	VulkanBuffer *staging;
+	int32_t size = BytesPerImage(w, h, texture->surfaceFormat) * d;
+
+	VULKAN_INTERNAL_EndRenderPass(renderer);
+
+	staging = VULKAN_INTERNAL_CreateBuffer(
+		renderer, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, 1);
+	if (staging == NULL) {
+		return NULL;
+	}
+
+	VULKAN_INTERNAL_TransitionTexture(
+		renderer, texture, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+	VkBufferImageCopy region = {0};
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = level;
+	region.imageSubresource.baseArrayLayer = layer;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset.x = x;
+	region.imageOffset.y = y;
+	region.imageOffset.z = z;
+	region.imageExtent.width = w;
+	region.imageExtent.height = h;
+	region.imageExtent.depth = d;
+	renderer->vkCmdCopyImageToBuffer(
+		renderer->currentCommandBuffer, texture->image,
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, staging->buffer, 1, &region);
+
+	VULKAN_INTERNAL_TransitionTexture(
+		renderer, texture, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	VULKAN_INTERNAL_MemoryBarrier(
+		renderer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+	return staging;
+}
+
+/* Copies a region back to the CPU. This stalls until the GPU catches up. */
+static void VULKAN_INTERNAL_ReadTexture(
+	VulkanRenderer *renderer,
+	VulkanTexture *texture,
+	int32_t x,
+	int32_t y,
+	int32_t z,
+	int32_t w,
+	int32_t h,
+	int32_t d,
+	int32_t level,
+	int32_t layer,
+	void *data,
+	int32_t dataLength
+) {
+	VulkanBuffer *staging = VULKAN_INTERNAL_RecordTextureRead(
+		renderer, texture, x, y, z, w, h, d, level, layer);
+	if (staging == NULL) {
+		return;
+	}
+
+	VULKAN_INTERNAL_FlushAndWait(renderer);
+
+	SDL_memcpy(data, staging->mappedPointer, SDL_min(dataLength, (int32_t) staging->size));
+	VULKAN_INTERNAL_DestroyBuffer(renderer, staging);
+}
+
+/* Renderbuffers */
+
+static uint8_t VULKAN_INTERNAL_FormatHasStencil(VkFormat format)
+{
+	return (	format == VK_FORMAT_D24_UNORM_S8_UINT ||
+			format == VK_FORMAT_D32_SFLOAT_S8_UINT ||
+			format == VK_FORMAT_D16_UNORM_S8_UINT	);
+}
+
+static VkSampleCountFlagBits VULKAN_INTERNAL_GetSampleCount(
+	VulkanRenderer *renderer,
+	int32_t multiSampleCount
+) {
+	VkSampleCountFlags supported =
+		renderer->deviceProperties.limits.framebufferColorSampleCounts &
+		renderer->deviceProperties.limits.framebufferDepthSampleCounts;
+	uint32_t count = VK_SAMPLE_COUNT_64_BIT;
+
+	if (multiSampleCount <= 1) {
+		return VK_SAMPLE_COUNT_1_BIT;
+	}
+	while (count > VK_SAMPLE_COUNT_1_BIT) {
+		if (count <= (uint32_t) multiSampleCount && (supported & count)) {
+			break;
+		}
+		count >>= 1;
+	}
+	return (VkSampleCountFlagBits) count;
+}
+
+static VulkanRenderbuffer* VULKAN_INTERNAL_CreateRenderbuffer(
+	VulkanRenderer *renderer,
+	uint32_t width,
+	uint32_t height,
+	VkFormat format,
+	VkSampleCountFlagBits sampleCount,
+	uint8_t isDepth
+) {
+	VulkanRenderbuffer *renderbuffer;
+	VkMemoryRequirements memReqs;
+	VkResult result;
+
+	renderbuffer = (VulkanRenderbuffer*) SDL_malloc(sizeof(VulkanRenderbuffer));
+	SDL_memset(renderbuffer, 0, sizeof(VulkanRenderbuffer));
+	renderbuffer->format = format;
+	renderbuffer->layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	renderbuffer->width = width;
+	renderbuffer->height = height;
+	renderbuffer->sampleCount = sampleCount;
+	renderbuffer->isDepth = isDepth;
+	if (isDepth) {
+		renderbuffer->aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+		if (VULKAN_INTERNAL_FormatHasStencil(format)) {
+			renderbuffer->aspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+		}
+	} else {
+		renderbuffer->aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+	}
+
+	VkImageCreateInfo imageInfo = {0};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = format;
+	imageInfo.extent.width = width;
+	imageInfo.extent.height = height;
+	imageInfo.extent.depth = 1;
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = sampleCount;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = isDepth ?
+		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT :
+		VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	result = renderer->vkCreateImage(renderer->device, &imageInfo, NULL, &renderbuffer->image);
+	if (result != VK_SUCCESS) {
+		VK_LOG_ERROR("vkCreateImage failed: %d", result);
+		SDL_free(renderbuffer);
+		return NULL;
+	}
+
+	renderer->vkGetImageMemoryRequirements(renderer->device, renderbuffer->image, &memReqs);
+	if (!VULKAN_INTERNAL_AllocateMemory(
+		renderer, &memReqs, 0, 1, 1, &renderbuffer->allocation
+	)) {
+		renderer->vkDestroyImage(renderer->device, renderbuffer->image, NULL);
+		SDL_free(renderbuffer);
+		return NULL;
+	}
+	renderer->vkBindImageMemory(
+		renderer->device, renderbuffer->image,
+		VULKAN_INTERNAL_AllocationMemory(&renderbuffer->allocation),
+		renderbuffer->allocation.offset);
+
+	VkImageViewCreateInfo viewInfo = {0};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = renderbuffer->image;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = format;
+	viewInfo.subresourceRange.aspectMask = renderbuffer->aspect;
+	viewInfo.subresourceRange.levelCount = 1;
+	viewInfo.subresourceRange.layerCount = 1;
+	renderer->vkCreateImageView(renderer->device, &viewInfo, NULL, &renderbuffer->view);
+
+	renderbuffer->next = renderer->renderbufferList;
+	renderer->renderbufferList = renderbuffer;
+	return renderbuffer;
+}
+
+/* The GPU must be done with the renderbuffer before this is called */
+static void VULKAN_INTERNAL_DestroyRenderbuffer(
+	VulkanRenderer *renderer,
+	VulkanRenderbuffer *renderbuffer
+) {
+	VulkanRenderbuffer **prev;
+
+	for (prev = &renderer->renderbufferList; *prev != NULL; prev = &(*prev)->next) {
+		if (*prev == renderbuffer) {
+			*prev = renderbuffer->next;
+			break;
+		}
+	}
+
+	VULKAN_INTERNAL_DestroyFramebuffersWithView(renderer, renderbuffer->view);
+	renderer->vkDestroyImageView(renderer->device, renderbuffer->view, NULL);
+	renderer->vkDestroyImage(renderer->device, renderbuffer->image, NULL);
+	VULKAN_INTERNAL_FreeMemory(renderer, &renderbuffer->allocation);
+	SDL_free(renderbuffer);
+}
+
+/* Samplers */
+
+static VulkanSampler* VULKAN_INTERNAL_FetchSampler(
+	VulkanRenderer *renderer,
+	FNA3D_SamplerState *samplerState
+) {
+	PackedState hash = GetPackedSamplerState(*samplerState);
+	VulkanSampler *sampler;
+	VkResult result;
+
+	sampler = (VulkanSampler*) PackedStateHashTable_Fetch(&renderer->samplerTable, hash);
+	if (sampler != NULL) {
+		return sampler;
+	}
+
+	VkSamplerCreateInfo samplerInfo = {0};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = XNAToVK_MagFilter[samplerState->filter];
+	samplerInfo.minFilter = XNAToVK_MinFilter[samplerState->filter];
+	samplerInfo.mipmapMode = XNAToVK_MipFilter[samplerState->filter];
+	samplerInfo.addressModeU = XNAToVK_SamplerAddressMode[samplerState->addressU];
+	samplerInfo.addressModeV = XNAToVK_SamplerAddressMode[samplerState->addressV];
+	samplerInfo.addressModeW = XNAToVK_SamplerAddressMode[samplerState->addressW];
+	samplerInfo.mipLodBias = samplerState->mipMapLevelOfDetailBias;
+	if (	samplerState->filter == FNA3D_TEXTUREFILTER_ANISOTROPIC &&
+		renderer->deviceFeatures.samplerAnisotropy	) {
+		samplerInfo.anisotropyEnable = VK_TRUE;
+		samplerInfo.maxAnisotropy = SDL_min(
+			(float) SDL_max(1, samplerState->maxAnisotropy),
+			renderer->deviceProperties.limits.maxSamplerAnisotropy);
+	}
+	samplerInfo.compareEnable = VK_FALSE;
+	samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+	samplerInfo.minLod = (float) samplerState->maxMipLevel;
+	samplerInfo.maxLod = 1000.0f;
+	samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+
+	sampler = (VulkanSampler*) SDL_malloc(sizeof(VulkanSampler));
+	result = renderer->vkCreateSampler(renderer->device, &samplerInfo, NULL, &sampler->sampler);
+	if (result != VK_SUCCESS) {
+		VK_LOG_ERROR("vkCreateSampler failed: %d", result);
+		SDL_free(sampler);
+		return renderer->defaultSampler;
+	}
+
+	sampler->next = renderer->samplerList;
+	renderer->samplerList = sampler;
+	PackedStateHashTable_Insert(&renderer->samplerTable, hash, sampler);
+	return sampler;
+}
+
+/* Pipeline Cache */
+
+static inline uint64_t VULKAN_INTERNAL_PipelineHashTable_GetHashCode(VulkanPipelineHash hash)
+{
+	/* The algorithm for this hashing function
+	 * is taken from Josh Bloch's "Effective Java".
+	 * (https://stackoverflow.com/a/113600/12492383)
+	 */
+	const uint64_t HASH_FACTOR = 97;
+	uint64_t result = 1;
+	result = result * HASH_FACTOR + hash.blendState.a;
+	result = result * HASH_FACTOR + hash.blendState.b;
+	result = result * HASH_FACTOR + hash.rasterizerState.a;
+	result = result * HASH_FACTOR + hash.rasterizerState.b;
+	result = result * HASH_FACTOR + hash.depthStencilState.a;
+	result = result * HASH_FACTOR + hash.depthStencilState.b;
+	result = result * HASH_FACTOR + (uint64_t) (size_t) hash.vertexLayout;
+	result = result * HASH_FACTOR + (uint64_t) (size_t) hash.program;
+	result = result * HASH_FACTOR + (uint64_t) (size_t) hash.renderPass;
+	result = result * HASH_FACTOR + hash.primitiveType;
+	result = result * HASH_FACTOR + hash.sampleMask;
+	return result;
+}
+
+static inline VkPipeline VULKAN_INTERNAL_PipelineHashTable_Fetch(
+	VulkanPipelineHashTable *table,
+	VulkanPipelineHash key
+) {
+	int32_t i;
+	uint64_t hashcode = VULKAN_INTERNAL_PipelineHashTable_GetHashCode(key);
+	VulkanPipelineHashArray *arr = &table->buckets[hashcode % VULKAN_PIPELINE_HASH_BUCKETS];
+
+	for (i = 0; i < arr->count; i++) {
+		const VulkanPipelineHash *e = &arr->elements[i].key;
+		if (	key.blendState.a == e->blendState.a &&
+			key.blendState.b == e->blendState.b &&
+			key.rasterizerState.a == e->rasterizerState.a &&
+			key.rasterizerState.b == e->rasterizerState.b &&
+			key.depthStencilState.a == e->depthStencilState.a &&
+			key.depthStencilState.b == e->depthStencilState.b &&
+			key.vertexLayout == e->vertexLayout &&
+			key.program == e->program &&
+			key.renderPass == e->renderPass &&
+			key.primitiveType == e->primitiveType &&
+			key.sampleMask == e->sampleMask	) {
+			return arr->elements[i].value;
+		}
+	}
+
+	return VK_NULL_HANDLE;
+}
+
+static inline void VULKAN_INTERNAL_PipelineHashTable_Insert(
+	VulkanPipelineHashTable *table,
+	VulkanPipelineHash key,
+	VkPipeline value
+) {
+	uint64_t hashcode = VULKAN_INTERNAL_PipelineHashTable_GetHashCode(key);
+	VulkanPipelineHashArray *arr = &table->buckets[hashcode % VULKAN_PIPELINE_HASH_BUCKETS];
+	VulkanPipelineHashMap map;
+	map.key = key;
+	map.value = value;
+
+	EXPAND_ARRAY_IF_NEEDED(arr, 2, VulkanPipelineHashMap)
+
+	arr->elements[arr->count] = map;
+	arr->count += 1;
+}
+
+/* The GPU must be done with the pipelines before this is called */
+static void VULKAN_INTERNAL_RetirePipelinesWithProgram(
+	VulkanRenderer *renderer,
+	VulkanShaderProgram *program
+) {
+	VulkanPipelineHashArray *arr;
+	int32_t i, j;
+
+	for (i = 0; i < VULKAN_PIPELINE_HASH_BUCKETS; i++) {
+		arr = &renderer->pipelineTable.buckets[i];
+		for (j = arr->count - 1; j >= 0; j--) {
+			if (arr->elements[j].key.program == program) {
+				VULKAN_INTERNAL_RetirePipeline(renderer, arr->elements[j].value);
+				arr->elements[j] = arr->elements[arr->count - 1];
+				arr->count -= 1;
+			}
+		}
+	}
+}
+
+/* Shaders
+ *
+ * MojoShader's Vulkan glue isn't part of the build, so the effect framework
+ * talks to these callbacks directly. They mirror the SDL_GPU glue: shaders
+ * are parsed to SPIR-V when the effect is compiled, and modules are only
+ * created once a vertex/pixel pair is linked.
+ */
+
+static void* VULKAN_INTERNAL_CompileShader(
+	const void *ctx,
+	const char *mainfn,
+	const unsigned char *tokenbuf,
+	const unsigned int bufsize,
+	const MOJOSHADER_swizzle *swiz,
+	const unsigned int swizcount,
+	const MOJOSHADER_samplerMap *smap,
+	const unsigned int smapcount
+) {
+	VulkanRenderer *renderer = (VulkanRenderer*) ctx;
+	const MOJOSHADER_parseData *pd;
+	VulkanShader *shader;
+	int32_t i, size;
+
+	pd = MOJOSHADER_parse(
+		MOJOSHADER_PROFILE_SPIRV, mainfn,
+		tokenbuf, bufsize, swiz, swizcount, smap, smapcount,
+		NULL, NULL, NULL);
+	if (pd->error_count > 0) {
+		SDL_snprintf(
+			renderer->shaderError, sizeof(renderer->shaderError),
+			"%s", pd->errors[0].error);
+		VK_LOG_ERROR("Shader compile failed: %s", renderer->shaderError);
+		MOJOSHADER_freeParseData(pd);
+		return NULL;
+	}
+
+	shader = (VulkanShader*) SDL_malloc(sizeof(VulkanShader));
+	shader->parseData = pd;
+	shader->refcount = 1;
+	shader->samplerSlots = 0;
+	shader->uniformBlockSize = 0;
+
+	for (i = 0; i < pd->sampler_count; i++) {
+		shader->samplerSlots = SDL_max(
+			shader->samplerSlots,
+			(uint32_t) pd->samplers[i].index + 1);
+	}
+	for (i = 0; i < pd->uniform_count; i++) {
+		size = pd->uniforms[i].array_count ? pd->uniforms[i].array_count : 1;
+		shader->uniformBlockSize += size * 16;
+	}
+	if (shader->uniformBlockSize > VULKAN_UNIFORM_RANGE) {
+		VK_LOG_WARN("Uniform block of %u bytes truncated", shader->uniformBlockSize);
+		shader->uniformBlockSize = VULKAN_UNIFORM_RANGE;
+	}
+
+	return shader;
+}
+
+static void VULKAN_INTERNAL_ShaderAddRef(void *shader)
+{
+	((VulkanShader*) shader)->refcount++;
+}
+
+static const MOJOSHADER_parseData* VULKAN_INTERNAL_GetShaderParseData(void *shader)
+{
+	return ((VulkanShader*) shader)->parseData;
+}
+
+static void VULKAN_INTERNAL_DeleteShader(const void *ctx, void *shader)
+{
+	VulkanRenderer *renderer = (VulkanRenderer*) ctx;
+	VulkanShader *vkShader = (VulkanShader*) shader;
+	VulkanShaderProgram **prev, *program;
+	PackedVertexBufferBindingsArray *arr;
+	int32_t i;
+
+	vkShader->refcount--;
+	if (vkShader->refcount > 0) {
+		return;
+	}
+
+	/* Programs (and their pipelines) built from this shader go with it, once
+	 * the frames that may still use them are done
+	 */
+	prev = &renderer->programList;
+	while (*prev != NULL) {
+		program = *prev;
+		if (program->vertexShader == vkShader || program->pixelShader == vkShader) {
+			*prev = program->next;
+			VULKAN_INTERNAL_RetirePipelinesWithProgram(renderer, program);
+			if (renderer->currentProgram == program) {
+				renderer->currentProgram = NULL;
+				renderer->currentPipeline = VK_NULL_HANDLE;
+				renderer->pipelineDirty = 1;
+			}
+			VULKAN_INTERNAL_RetireProgram(renderer, program);
+		} else {
+			prev = &program->next;
+		}
+	}
+
+	/* Vertex layouts are keyed on the vertex shader */
+	arr = &renderer->vertexLayoutCache;
+	for (i = 0; i < arr->count; i++) {
+		if (arr->elements[i].key.vertexShader == vkShader) {
+			if (renderer->currentVertexLayout == arr->elements[i].value) {
+				renderer->currentVertexLayout = NULL;
+			}
+			SDL_free(arr->elements[i].value);
+		}
+	}
+	PackedVertexBufferBindingsArray_RemoveShader(arr, vkShader);
+
+	if (renderer->currentVertexShader == vkShader) {
+		renderer->currentVertexShader = NULL;
+	}
+	if (renderer->currentPixelShader == vkShader) {
+		renderer->currentPixelShader = NULL;
+	}
+
+	MOJOSHADER_freeParseData(vkShader->parseData);
+	SDL_free(vkShader);
+}
+
+static void VULKAN_INTERNAL_BindShaders(const void *ctx, void *vshader, void *pshader)
+{
+	VulkanRenderer *renderer = (VulkanRenderer*) ctx;
+
+	/* NULL means "keep what's bound", same as the other MojoShader glue */
+	if (vshader != NULL) {
+		renderer->currentVertexShader = (VulkanShader*) vshader;
+	}
+	if (pshader != NULL) {
+		renderer->currentPixelShader = (VulkanShader*) pshader;
+	}
+
+	renderer->currentProgram = NULL;
+	renderer->pipelineDirty = 1;
+	renderer->uniformsDirty = 1;
+	renderer->vertexSamplersDirty = 1;
+	renderer->fragmentSamplersDirty = 1;
+}
+
+static void VULKAN_INTERNAL_GetBoundShaders(const void *ctx, void **vshader, void **pshader)
+{
+	VulkanRenderer *renderer = (VulkanRenderer*) ctx;
+	*vshader = renderer->currentVertexShader;
+	*pshader = renderer->currentPixelShader;
+}
+
+static void VULKAN_INTERNAL_MapUniformBufferMemory(
+	const void *ctx,
+	float **vsf, int **vsi, unsigned char **vsb,
+	float **psf, int **psi, unsigned char **psb
+) {
+	VulkanRenderer *renderer = (VulkanRenderer*) ctx;
+	*vsf = renderer->vsRegFileF;
+	*vsi = renderer->vsRegFileI;
+	*vsb = renderer->vsRegFileB;
+	*psf = renderer->psRegFileF;
+	*psi = renderer->psRegFileI;
+	*psb = renderer->psRegFileB;
+}
+
+static void VULKAN_INTERNAL_UnmapUniformBufferMemory(const void *ctx)
+{
+	VulkanRenderer *renderer = (VulkanRenderer*) ctx;
+	renderer->uniformsDirty = 1;
+}
+
+static const char* VULKAN_INTERNAL_GetShaderError(const void *ctx)
+{
+	VulkanRenderer *renderer = (VulkanRenderer*) ctx;
+	return renderer->shaderError;
+}
+
+/* The parse output has MojoShader's link patch table appended to it. The
+ * module itself ends at the last OpFunctionEnd.
+ */
+static size_t VULKAN_INTERNAL_GetSpirvCodeSize(const MOJOSHADER_parseData *pd)
+{
+	const uint32_t *words = (const uint32_t*) pd->output;
+	size_t wordCount = pd->output_len / 4;
+	size_t i = 5; /* Skip the header */
+	uint32_t length, opcode;
+
+	while (i < wordCount) {
+		length = words[i] >> 16;
+		opcode = words[i] & 0xFFFF;
+		if (length == 0) {
+			break;
+		}
+		if (opcode == 56 /* OpFunctionEnd */) {
+			if (i + 1 >= wordCount || (words[i + 1] & 0xFFFF) != 54 /* OpFunction */) {
+				return (i + 1) * 4;
+			}
+		}
+		i += length;
+	}
+	return pd->output_len;
+}
+
+static VkShaderModule VULKAN_INTERNAL_CreateShaderModule(
+	VulkanRenderer *renderer,
+	const MOJOSHADER_parseData *pd
+) {
+	VkShaderModule module = VK_NULL_HANDLE;
+	VkResult result;
+
+	VkShaderModuleCreateInfo moduleInfo = {0};
+	moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	moduleInfo.codeSize = VULKAN_INTERNAL_GetSpirvCodeSize(pd);
+	moduleInfo.pCode = (const uint32_t*) pd->output;
+
+	result = renderer->vkCreateShaderModule(renderer->device, &moduleInfo, NULL, &module);
+	VK_CHECK_RET(result, VK_NULL_HANDLE);
+	return module;
+}
+
+static VulkanShaderProgram* VULKAN_INTERNAL_FetchProgram(VulkanRenderer *renderer)
+{
+	VulkanShader *vshader = renderer->currentVertexShader;
+	VulkanShader *pshader = renderer->currentPixelShader;
+	VulkanShaderProgram *program;
+
+	for (program = renderer->programList; program != NULL; program = program->next) {
+		if (program->vertexShader == vshader && program->pixelShader == pshader) {
+			return program;
+		}
+	}
+
+	/* Patches both parse outputs for this pair, so build the modules now */
+	MOJOSHADER_spirv_link_attributes(vshader->parseData, pshader->parseData, 0);
+
+	program = (VulkanShaderProgram*) SDL_malloc(sizeof(VulkanShaderProgram));
+	program->vertexShader = vshader;
+	program->pixelShader = pshader;
+	program->vertexModule = VULKAN_INTERNAL_CreateShaderModule(renderer, vshader->parseData);
+	program->fragmentModule = VULKAN_INTERNAL_CreateShaderModule(renderer, pshader->parseData);
+	if (program->vertexModule == VK_NULL_HANDLE || program->fragmentModule == VK_NULL_HANDLE) {
+		if (program->vertexModule != VK_NULL_HANDLE) {
+			renderer->vkDestroyShaderModule(renderer->device, program->vertexModule, NULL);
+		}
+		if (program->fragmentModule != VK_NULL_HANDLE) {
+			renderer->vkDestroyShaderModule(renderer->device, program->fragmentModule, NULL);
+		}
+		SDL_free(program);
+		return NULL;
+	}
+
+	program->next = renderer->programList;
+	renderer->programList = program;
+	return program;
+}
+
+/* Vertex Input */
+
+static int32_t VULKAN_INTERNAL_GetVertexAttribLocation(
+	VulkanShader *shader,
+	MOJOSHADER_usage usage,
+	int32_t index
+) {
+	int32_t i;
+	for (i = 0; i < shader->parseData->attribute_count; i++) {
+		if (	shader->parseData->attributes[i].usage == usage &&
+			shader->parseData->attributes[i].index == index	) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+static VulkanVertexLayout* VULKAN_INTERNAL_GenerateVertexLayout(
+	VulkanRenderer *renderer,
+	FNA3D_VertexBufferBinding *bindings,
+	int32_t numBindings
+) {
+	VulkanVertexLayout *layout;
+	uint8_t attrUse[MOJOSHADER_USAGE_TOTAL][16];
+	FNA3D_VertexDeclaration vertexDeclaration;
+	FNA3D_VertexElement element;
+	FNA3D_VertexElementUsage usage;
+	int32_t i, j, k, index, attribLoc;
+
+	layout = (VulkanVertexLayout*) SDL_malloc(sizeof(VulkanVertexLayout));
+	SDL_memset(layout, 0, sizeof(VulkanVertexLayout));
+	SDL_memset(attrUse, '\0', sizeof(attrUse));
+
+	for (i = 0; i < numBindings; i++) {
+		vertexDeclaration = bindings[i].vertexDeclaration;
+
+		for (j = 0; j < vertexDeclaration.elementCount; j++) {
+			element = vertexDeclaration.elements[j];
+			usage = element.vertexElementUsage;
+			index = element.usageIndex;
+
+			if (attrUse[usage][index]) {
+				index = -1;
+				for (k = 0; k < VULKAN_MAX_VERTEX_ATTRIBUTES; k++) {
+					if (!attrUse[usage][k]) {
+						index = k;
+						break;
+					}
+				}
+				if (index < 0) {
+					VK_LOG_ERROR("Vertex usage collision!");
+					continue;
+				}
+			}
+			attrUse[usage][index] = 1;
+
+			attribLoc = VULKAN_INTERNAL_GetVertexAttribLocation(
+				renderer->currentVertexShader,
+				VertexAttribUsage(usage),
+				index);
+			if (attribLoc == -1) {
+				/* Stream not in use! */
+				continue;
+			}
+
+			VkVertexInputAttributeDescription *attr =
+				&layout->attributes[layout->attributeCount++];
+			attr->location = attribLoc;
+			attr->binding = i;
+			attr->format = XNAToVK_VertexAttribType[element.vertexElementFormat];
+			attr->offset = element.offset;
+		}
+
+		layout->bindings[i].binding = i;
+		layout->bindings[i].stride = vertexDeclaration.vertexStride;
+		if (bindings[i].instanceFrequency > 0) {
+			if (bindings[i].instanceFrequency > 1) {
+				VK_LOG_ERROR("Vertex instanceFrequency must be either 0 or 1!");
+			}
+			layout->bindings[i].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+		} else {
+			layout->bindings[i].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		}
+	}
+	layout->bindingCount = numBindings;
+
+	return layout;
+}
+
+/* Pipelines */
+
+static void VULKAN_INTERNAL_HashPipeline(VulkanPipelineJob *job)
+{
+	FNA3D_BlendState blendState = job->blendState;
+	FNA3D_DepthStencilState depthStencilState = job->depthStencilState;
+
+	/* Blend factor and stencil reference are dynamic state */
+	SDL_zero(blendState.blendFactor);
+	depthStencilState.referenceStencil = 0;
+
+	job->hash.blendState = GetPackedBlendState(blendState);
+	job->hash.depthStencilState = GetPackedDepthStencilState(depthStencilState);
+	job->hash.rasterizerState = GetPackedRasterizerState(
+		job->rasterizerState,
+		job->rasterizerState.depthBias);
+	job->hash.vertexLayout = job->vertexLayout;
+	job->hash.program = job->program;
+	job->hash.renderPass = job->renderPass->renderPass;
+	job->hash.primitiveType = job->primitiveType;
+	job->hash.sampleMask = (uint32_t) job->multiSampleMask;
+}
+
+static void VULKAN_INTERNAL_FillPipelineCreateInfo(
+	VulkanRenderer *renderer,
+	VulkanPipelineJob *job
+) {
+	FNA3D_BlendState *bs = &job->blendState;
+	FNA3D_DepthStencilState *dss = &job->depthStencilState;
+	FNA3D_RasterizerState *rs = &job->rasterizerState;
+	VulkanRenderPass *renderPass = job->renderPass;
+	VulkanShaderProgram *program = job->program;
+	VulkanVertexLayout *layout = job->vertexLayout;
+	uint32_t i;
+	const int32_t writeMasks[VULKAN_MAX_RENDER_TARGETS] = {
+		bs->colorWriteEnable,
+		bs->colorWriteEnable1,
+		bs->colorWriteEnable2,
+		bs->colorWriteEnable3
+	};
+
+	/* Shaders */
+	SDL_zeroa(job->stages);
+	job->stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	job->stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	job->stages[0].module = program->vertexModule;
+	job->stages[0].pName = program->vertexShader->parseData->mainfn;
+	job->stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	job->stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	job->stages[1].module = program->fragmentModule;
+	job->stages[1].pName = program->pixelShader->parseData->mainfn;
+
+	/* Vertex Input */
+	SDL_zero(job->vertexInput);
+	job->vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	job->vertexInput.vertexBindingDescriptionCount = layout->bindingCount;
+	job->vertexInput.pVertexBindingDescriptions = layout->bindings;
+	job->vertexInput.vertexAttributeDescriptionCount = layout->attributeCount;
+	job->vertexInput.pVertexAttributeDescriptions = layout->attributes;
+
+	SDL_zero(job->inputAssembly);
+	job->inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	job->inputAssembly.topology = XNAToVK_Topology[job->primitiveType];
+
+	SDL_zero(job->viewportState);
+	job->viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	job->viewportState.viewportCount = 1;
+	job->viewportState.scissorCount = 1;
+
+	/* Rasterizer */
+	SDL_zero(job->rasterizer);
+	job->rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	job->rasterizer.polygonMode = renderer->deviceFeatures.fillModeNonSolid ?
+		XNAToVK_PolygonMode[rs->fillMode] :
+		VK_POLYGON_MODE_FILL;
+	job->rasterizer.cullMode = XNAToVK_CullMode[rs->cullMode];
+	job->rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+	job->rasterizer.lineWidth = 1.0f;
+	if (renderPass->hasDepthStencil) {
+		job->rasterizer.depthBiasConstantFactor = rs->depthBias * XNAToVK_DepthBiasScale(
+			renderPass->depthFormat);
+		job->rasterizer.depthBiasSlopeFactor = rs->slopeScaleDepthBias;
+		job->rasterizer.depthBiasEnable = (
+			rs->depthBias != 0.0f ||
+			rs->slopeScaleDepthBias != 0.0f
+		);
+	}
+
+	/* Multisample */
+	job->sampleMask = (VkSampleMask) job->multiSampleMask;
+	SDL_zero(job->multisample);
+	job->multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	job->multisample.rasterizationSamples = renderPass->sampleCount;
+	if (job->sampleMask != 0xFFFFFFFF) {
+		job->multisample.pSampleMask = &job->sampleMask;
+	}
+
+	/* Depth/Stencil */
+	SDL_zero(job->depthStencil);
+	job->depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	job->depthStencil.depthTestEnable = dss->depthBufferEnable;
+	job->depthStencil.depthWriteEnable = dss->depthBufferWriteEnable;
+	job->depthStencil.depthCompareOp = XNAToVK_CompareOp[dss->depthBufferFunction];
+	job->depthStencil.stencilTestEnable = dss->stencilEnable;
+	job->depthStencil.front.failOp = XNAToVK_StencilOp[dss->stencilFail];
+	job->depthStencil.front.passOp = XNAToVK_StencilOp[dss->stencilPass];
+	job->depthStencil.front.depthFailOp = XNAToVK_StencilOp[dss->stencilDepthBufferFail];
+	job->depthStencil.front.compareOp = XNAToVK_CompareOp[dss->stencilFunction];
+	job->depthStencil.front.compareMask = dss->stencilMask;
+	job->depthStencil.front.writeMask = dss->stencilWriteMask;
+	if (dss->twoSidedStencilMode) {
+		job->depthStencil.back.failOp = XNAToVK_StencilOp[dss->ccwStencilFail];
+		job->depthStencil.back.passOp = XNAToVK_StencilOp[dss->ccwStencilPass];
+		job->depthStencil.back.depthFailOp = XNAToVK_StencilOp[dss->ccwStencilDepthBufferFail];
+		job->depthStencil.back.compareOp = XNAToVK_CompareOp[dss->ccwStencilFunction];
+		job->depthStencil.back.compareMask = dss->stencilMask;
+		job->depthStencil.back.writeMask = dss->stencilWriteMask;
+	} else {
+		job->depthStencil.back = job->depthStencil.front;
+	}
+
+	/* Color Blend */
+	SDL_zeroa(job->blendAttachments);
+	for (i = 0; i < renderPass->colorAttachmentCount; i++) {
+		job->blendAttachments[i].blendEnable = !(
+			bs->colorSourceBlend == FNA3D_BLEND_ONE &&
+			bs->colorDestinationBlend == FNA3D_BLEND_ZERO &&
+			bs->alphaSourceBlend == FNA3D_BLEND_ONE &&
+			bs->alphaDestinationBlend == FNA3D_BLEND_ZERO
+		);
+		job->blendAttachments[i].srcColorBlendFactor = XNAToVK_BlendFactor[bs->colorSourceBlend];
+		job->blendAttachments[i].dstColorBlendFactor = XNAToVK_BlendFactor[bs->colorDestinationBlend];
+		job->blendAttachments[i].colorBlendOp = XNAToVK_BlendOp[bs->colorBlendFunction];
+		job->blendAttachments[i].srcAlphaBlendFactor = XNAToVK_BlendFactor[bs->alphaSourceBlend];
+		job->blendAttachments[i].dstAlphaBlendFactor = XNAToVK_BlendFactor[bs->alphaDestinationBlend];
+		job->blendAttachments[i].alphaBlendOp = XNAToVK_BlendOp[bs->alphaBlendFunction];
+
+		/* FNA3D_ColorWriteChannels matches VkColorComponentFlagBits */
+		job->blendAttachments[i].colorWriteMask = (VkColorComponentFlags) writeMasks[i];
+	}
+
+	SDL_zero(job->colorBlend);
+	job->colorBlend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	job->colorBlend.attachmentCount = renderPass->colorAttachmentCount;
+	job->colorBlend.pAttachments = job->blendAttachments;
+
+	/* Dynamic State */
+	job->dynamicStates[0] = VK_DYNAMIC_STATE_VIEWPORT;
+	job->dynamicStates[1] = VK_DYNAMIC_STATE_SCISSOR;
+	job->dynamicStates[2] = VK_DYNAMIC_STATE_BLEND_CONSTANTS;
+	job->dynamicStates[3] = VK_DYNAMIC_STATE_STENCIL_REFERENCE;
+
+	SDL_zero(job->dynamicState);
+	job->dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	job->dynamicState.dynamicStateCount = 4;
+	job->dynamicState.pDynamicStates = job->dynamicStates;
+
+	SDL_zero(job->pipelineInfo);
+	job->pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	job->pipelineInfo.stageCount = 2;
+	job->pipelineInfo.pStages = job->stages;
+	job->pipelineInfo.pVertexInputState = &job->vertexInput;
+	job->pipelineInfo.pInputAssemblyState = &job->inputAssembly;
+	job->pipelineInfo.pViewportState = &job->viewportState;
+	job->pipelineInfo.pRasterizationState = &job->rasterizer;
+	job->pipelineInfo.pMultisampleState = &job->multisample;
+	job->pipelineInfo.pDepthStencilState = renderPass->hasDepthStencil ? &job->depthStencil : NULL;
+	job->pipelineInfo.pColorBlendState = &job->colorBlend;
+	job->pipelineInfo.pDynamicState = &job->dynamicState;
+	job->pipelineInfo.layout = renderer->pipelineLayout;
+	job->pipelineInfo.renderPass = renderPass->renderPass;
+	job->pipelineInfo.subpass = 0;
+}
+
+/* Runs on the pipeline compiler thread, only touches the job and the cache */
+static void VULKAN_INTERNAL_CompilePipelineJob(
+	void *userdata,
+	FNA3D_PipelineCompileJob *compileJob
+) {
+	VulkanRenderer *renderer = (VulkanRenderer*) userdata;
+	VulkanPipelineJob *job = (VulkanPipelineJob*) compileJob;
+
+	job->result = renderer->vkCreateGraphicsPipelines(
+		renderer->device,
+		renderer->pipelineCache,
+		1,
+		&job->pipelineInfo,
+		NULL,
+		&job->pipeline);
+	if (job->result != VK_SUCCESS) {
+		job->pipeline = VK_NULL_HANDLE;
+	}
+}
+
+static void VULKAN_INTERNAL_PublishPipelineJobs(
+	VulkanRenderer *renderer,
+	FNA3D_PipelineCompileJob *list
+) {
+	VulkanPipelineJob *job;
+
+	while (list != NULL) {
+		job = (VulkanPipelineJob*) list;
+		list = list->next;
+
+		if (job->pipeline == VK_NULL_HANDLE) {
+			VK_LOG_WARN(
+				"Prewarmed pipeline failed to compile, VkResult=%d",
+				job->result);
+		} else if (VULKAN_INTERNAL_PipelineHashTable_Fetch(
+			&renderer->pipelineTable,
+			job->hash
+		) != VK_NULL_HANDLE) {
+			/* A draw beat us to it */
+			renderer->vkDestroyPipeline(renderer->device, job->pipeline, NULL);
+		} else {
+			VULKAN_INTERNAL_PipelineHashTable_Insert(
+				&renderer->pipelineTable,
+				job->hash,
+				job->pipeline);
+			renderer->pipelineCacheDirty = 1;
+		}
+
+		/* May retire the program and pipeline we just published */
+		VULKAN_INTERNAL_DeleteShader(renderer, job->vertexShader);
+		VULKAN_INTERNAL_DeleteShader(renderer, job->pixelShader);
+		SDL_free(job);
+		renderer->pipelineJobsInFlight -= 1;
+	}
+}
+
+static void VULKAN_INTERNAL_DrainPipelineJobs(VulkanRenderer *renderer)
+{
+	if (renderer->pipelineJobsInFlight > 0) {
+		VULKAN_INTERNAL_PublishPipelineJobs(
+			renderer,
+			FNA3D_PipelineCompiler_Drain(renderer->pipelineCompiler));
+	}
+}
+
+static inline uint64_t VULKAN_INTERNAL_TicksToNs(uint64_t ticks)
+{
+	return (ticks * 1000000000ULL) / SDL_GetPerformanceFrequency();
+}
+
+static VkPipeline VULKAN_INTERNAL_FetchPipeline(VulkanRenderer *renderer)
+{
+	VulkanPipelineJob job;
+	VkPipeline pipeline;
+	uint64_t stallStart = 0;
+
+	job.blendState = renderer->blendState;
+	job.depthStencilState = renderer->depthStencilState;
+	job.rasterizerState = renderer->rasterizerState;
+	job.program = renderer->currentProgram;
+	job.vertexLayout = renderer->currentVertexLayout;
+	job.renderPass = renderer->currentRenderPass;
+	job.primitiveType = renderer->currentPrimitiveType;
+	job.multiSampleMask = renderer->multiSampleMask;
+	VULKAN_INTERNAL_HashPipeline(&job);
+
+	pipeline = VULKAN_INTERNAL_PipelineHashTable_Fetch(&renderer->pipelineTable, job.hash);
+	if (pipeline != VK_NULL_HANDLE) {
+		return pipeline;
+	}
+
+	if (renderer->perf.enabled) {
+		FNA3D_PERF_ADD(renderer->perf, pipelineMisses, 1);
+		stallStart = SDL_GetPerformanceCounter();
+	}
+
+	/* The prewarm compiler may have just finished it */
+	if (renderer->pipelineJobsInFlight > 0) {
+		VULKAN_INTERNAL_DrainPipelineJobs(renderer);
+		pipeline = VULKAN_INTERNAL_PipelineHashTable_Fetch(&renderer->pipelineTable, job.hash);
+		if (pipeline != VK_NULL_HANDLE) {
+			if (renderer->perf.enabled) {
+				FNA3D_PERF_ADD(renderer->perf, pipelineAsyncHits, 1);
+				FNA3D_PERF_ADD(
+					renderer->perf, pipelineStallNs,
+					VULKAN_INTERNAL_TicksToNs(SDL_GetPerformanceCounter() - stallStart));
+			}
+			return pipeline;
+		}
+	}
+
+	VULKAN_INTERNAL_FillPipelineCreateInfo(renderer, &job);
+	job.result = renderer->vkCreateGraphicsPipelines(
+		renderer->device, renderer->pipelineCache, 1, &job.pipelineInfo, NULL, &pipeline);
+	VK_CHECK_RET(job.result, VK_NULL_HANDLE);
+	renderer->pipelineCacheDirty = 1;
+
+	VULKAN_INTERNAL_PipelineHashTable_Insert(&renderer->pipelineTable, job.hash, pipeline);
+	if (renderer->perf.enabled) {
+		FNA3D_PERF_ADD(
+			renderer->perf, pipelineStallNs,
+			VULKAN_INTERNAL_TicksToNs(SDL_GetPerformanceCounter() - stallStart));
+	}
+	return pipeline;
+}
+
+/* Uniforms */
+
+/* Packs the shader's uniforms the way MojoShader's SPIR-V expects them: every
+ * register is a vec4, bools are one per register.
+ */
+static void VULKAN_INTERNAL_PackUniforms(
+	VulkanShader *shader,
+	uint8_t *dst,
+	float *regF,
+	int32_t *regI,
+	uint8_t *regB
+) {
+	const MOJOSHADER_parseData *pd = shader->parseData;
+	uint32_t offset = 0;
+	int32_t i, j, index, size;
+
+	for (i = 0; i < pd->uniform_count; i++) {
+		index = pd->uniforms[i].index;
+		size = pd->uniforms[i].array_count ? pd->uniforms[i].array_count : 1;
+		if (offset + (size * 16) > shader->uniformBlockSize) {
+			break;
+		}
+
+		switch (pd->uniforms[i].type) {
+		case MOJOSHADER_UNIFORM_FLOAT:
+			SDL_memcpy(dst + offset, &regF[4 * index], size * 16);
+			break;
+		case MOJOSHADER_UNIFORM_INT:
+			SDL_memcpy(dst + offset, &regI[4 * index], size * 16);
+			break;
+		case MOJOSHADER_UNIFORM_BOOL:
+			for (j = 0; j < size; j++) {
+				dst[offset + (j * 16)] = regB[index + j];
+			}
+			break;
+		default:
+			break;
+		}
+		offset += size * 16;
+	}
+}
+
+static uint32_t VULKAN_INTERNAL_PushUniforms(
+	VulkanRenderer *renderer,
+	VulkanShader *shader,
+	float *regF,
+	int32_t *regI,
+	uint8_t *regB
+) {
+	VulkanFrameData *frame = &renderer->frames[renderer->currentFrame];
+	VkDeviceSize alignment = renderer->deviceProperties.limits.minUniformBufferOffsetAlignment;
+	VkDeviceSize offset;
+	VulkanBuffer *newBuffer;
+
+	if (shader->uniformBlockSize == 0) {
+		return 0;
+	}
+
+	offset = (frame->uniformOffset + alignment - 1) & ~(alignment - 1);
+	if (offset + VULKAN_UNIFORM_RANGE > frame->uniformBuffer->size) {
+		/* Out of room for this frame, move to a bigger buffer */
+		newBuffer = VULKAN_INTERNAL_CreateBuffer(
+			renderer, frame->uniformBuffer->size * 2,
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 1);
+		if (newBuffer == NULL) {
+			return 0;
+		}
+		VULKAN_INTERNAL_RetireBuffer(renderer, frame->uniformBuffer);
+		frame->uniformBuffer = newBuffer;
+		VULKAN_INTERNAL_AllocateUniformSet(renderer);
+		renderer->descriptorSetsDirty = 1;
+		offset = 0;
+	}
+
+	VULKAN_INTERNAL_PackUniforms(
+		shader, frame->uniformBuffer->mappedPointer + offset, regF, regI, regB);
+	frame->uniformOffset = offset + shader->uniformBlockSize;
+	return (uint32_t) offset;
+}
+
+/* Samplers */
+
+static uint8_t VULKAN_INTERNAL_IsBoundAsTarget(VulkanRenderer *renderer, VulkanTexture *texture)
+{
+	uint32_t i;
+	for (i = 0; i < renderer->colorAttachmentCount; i++) {
+		if (renderer->colorAttachments[i] == texture) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* Layout changes can't happen inside a render pass, so this runs before one
+ * is started for the draw.
+ */
+static void VULKAN_INTERNAL_PrepareSampledTextures(
+	VulkanRenderer *renderer,
+	VulkanShader *shader,
+	VulkanTexture **textures,
+	uint32_t maxSlots
+) {
+	const MOJOSHADER_parseData *pd = shader->parseData;
+	VulkanTexture *texture;
+	int32_t i;
+
+	for (i = 0; i < pd->sampler_count; i++) {
+		if ((uint32_t) pd->samplers[i].index >= maxSlots) {
+			continue;
+		}
+		texture = textures[pd->samplers[i].index];
+		if (	texture == NULL ||
+			texture->layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL ||
+			VULKAN_INTERNAL_IsBoundAsTarget(renderer, texture)	) {
+			continue;
+		}
+		VULKAN_INTERNAL_EndRenderPass(renderer);
+		VULKAN_INTERNAL_TransitionTexture(
+			renderer, texture, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	}
+}
+
+static VkDescriptorSet VULKAN_INTERNAL_WriteSamplerSet(
+	VulkanRenderer *renderer,
+	VulkanShader *shader,
+	VkDescriptorSetLayout layout,
+	VulkanTexture **textures,
+	VulkanSampler **samplers,
+	uint32_t maxSlots
+) {
+	const MOJOSHADER_parseData *pd = shader->parseData;
+	VkDescriptorImageInfo imageInfos[VULKAN_MAX_TEXTURE_SAMPLERS];
+	VkWriteDescriptorSet writes[VULKAN_MAX_TEXTURE_SAMPLERS];
+	VkDescriptorSet set;
+	VulkanTexture *texture, *dummy;
+	VulkanSampler *sampler;
+	uint32_t writeCount = 0;
+	uint32_t slot;
+	int32_t i;
+
+	set = VULKAN_INTERNAL_AllocateDescriptorSet(renderer, layout);
+	if (set == VK_NULL_HANDLE) {
+		return VK_NULL_HANDLE;
+	}
+
+	for (i = 0; i < pd->sampler_count; i++) {
+		slot = pd->samplers[i].index;
+		if (slot >= maxSlots) {
+			continue;
+		}
+
+		switch (pd->samplers[i].type) {
+		case MOJOSHADER_SAMPLER_CUBE:
+			dummy = renderer->dummyTextureCube;
+			break;
+		case MOJOSHADER_SAMPLER_VOLUME:
+			dummy = renderer->dummyTexture3D;
+			break;
+		default:
+			dummy = renderer->dummyTexture2D;
+			break;
+		}
+
+		/* Unbound, mismatched or currently rendered-to textures are
+		 * replaced, since any of those would be invalid to sample
+		 */
+		texture = textures[slot];
+		if (	texture == NULL ||
+			texture->layout != VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL ||
+			texture->isCube != dummy->isCube ||
+			texture->is3D != dummy->is3D	) {
+			texture = dummy;
+		}
+		texture->usedFrame = renderer->frameCount;
+		sampler = (samplers[slot] != NULL) ? samplers[slot] : renderer->defaultSampler;
+
+		imageInfos[writeCount].sampler = sampler->sampler;
+		imageInfos[writeCount].imageView = texture->view;
+		imageInfos[writeCount].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		SDL_zero(writes[writeCount]);
+		writes[writeCount].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[writeCount].dstSet = set;
+		writes[writeCount].dstBinding = slot;
+		writes[writeCount].descriptorCount = 1;
+		writes[writeCount].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		writes[writeCount].pImageInfo = &imageInfos[writeCount];
+		writeCount++;
+	}
+
+	if (writeCount > 0) {
+		renderer->vkUpdateDescriptorSets(renderer->device, writeCount, writes, 0, NULL);
+	}
+	return set;
+}
+
+/* Draw Preparation */
+
+static void VULKAN_INTERNAL_ApplyScissor(VulkanRenderer *renderer)
+{
+	VkRect2D scissor;
+	int32_t x0, y0, x1, y1;
+
+	if (renderer->rasterizerState.scissorTestEnable) {
+		x0 = SDL_max(renderer->scissorRect.x, 0);
+		y0 = SDL_max(renderer->scissorRect.y, 0);
+		x1 = SDL_min(
+			renderer->scissorRect.x + renderer->scissorRect.w,
+			(int32_t) renderer->renderTargetWidth);
+		y1 = SDL_min(
+			renderer->scissorRect.y + renderer->scissorRect.h,
+			(int32_t) renderer->renderTargetHeight);
+		scissor.offset.x = x0;
+		scissor.offset.y = y0;
+		scissor.extent.width = (x1 > x0) ? (x1 - x0) : 0;
+		scissor.extent.height = (y1 > y0) ? (y1 - y0) : 0;
+	} else {
+		scissor.offset.x = 0;
+		scissor.offset.y = 0;
+		scissor.extent.width = renderer->renderTargetWidth;
+		scissor.extent.height = renderer->renderTargetHeight;
+	}
+
+	renderer->vkCmdSetScissor(renderer->currentCommandBuffer, 0, 1, &scissor);
+}
+
+static uint8_t VULKAN_INTERNAL_PrepareDraw(VulkanRenderer *renderer)
 {
 	VulkanFrameData *frame = &renderer->frames[renderer->currentFrame];
-	VkResult result;
-	
-	/* Wait for frame to be available */
-	renderer->vkWaitForFences(renderer->device, 1, &frame->fence, VK_TRUE, UINT64_MAX);
-	renderer->vkResetFences(renderer->device, 1, &frame->fence);
-	
-	/* Acquire next image */
-	result = renderer->vkAcquireNextImageKHR(
-		renderer->device, renderer->swapchain.swapchain, UINT64_MAX,
-		frame->imageAvailable, VK_NULL_HANDLE,
-		&renderer->swapchain.currentImageIndex);
-	
-	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
-		VULKAN_CreateSwapchain(renderer, renderer->backbufferWidth, renderer->backbufferHeight);
+	VkCommandBuffer cb;
+	VkPipeline pipeline;
+	uint8_t rebind;
+	uint32_t i;
+
+	if (	renderer->currentVertexShader == NULL ||
+		renderer->currentPixelShader == NULL ||
+		renderer->currentVertexLayout == NULL	) {
+		return 0;
+	}
+
+	VULKAN_INTERNAL_PrepareSampledTextures(
+		renderer, renderer->currentVertexShader,
+		renderer->vertexTextures, VULKAN_MAX_VERTEX_TEXTURE_SAMPLERS);
+	VULKAN_INTERNAL_PrepareSampledTextures(
+		renderer, renderer->currentPixelShader,
+		renderer->textures, VULKAN_MAX_TEXTURE_SAMPLERS);
+
+	VULKAN_INTERNAL_BeginRenderPass(renderer);
+	if (!renderer->renderPassActive) {
+		return 0;
+	}
+	cb = renderer->currentCommandBuffer;
+
+	if (renderer->currentProgram == NULL) {
+		renderer->currentProgram = VULKAN_INTERNAL_FetchProgram(renderer);
+		if (renderer->currentProgram == NULL) {
+			return 0;
+		}
+		renderer->pipelineDirty = 1;
+	}
+
+	if (renderer->pipelineDirty) {
+		pipeline = VULKAN_INTERNAL_FetchPipeline(renderer);
+		if (pipeline == VK_NULL_HANDLE) {
+			return 0;
+		}
+		if (pipeline != renderer->currentPipeline) {
+			renderer->vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+			renderer->currentPipeline = pipeline;
+		}
+		renderer->pipelineDirty = 0;
+	}
+
+	/* Dynamic State */
+	if (renderer->viewportDirty) {
+		/* Flipped so that clip space matches the other backends */
+		VkViewport viewport;
+		viewport.x = (float) renderer->viewport.x;
+		viewport.y = (float) (renderer->viewport.y + renderer->viewport.h);
+		viewport.width = (float) renderer->viewport.w;
+		viewport.height = -((float) renderer->viewport.h);
+		viewport.minDepth = renderer->viewport.minDepth;
+		viewport.maxDepth = renderer->viewport.maxDepth;
+		renderer->vkCmdSetViewport(cb, 0, 1, &viewport);
+		renderer->viewportDirty = 0;
+	}
+	if (renderer->scissorDirty) {
+		VULKAN_INTERNAL_ApplyScissor(renderer);
+		renderer->scissorDirty = 0;
+	}
+	if (renderer->blendFactorDirty) {
+		float blendConstants[4];
+		blendConstants[0] = renderer->blendFactor.r / 255.0f;
+		blendConstants[1] = renderer->blendFactor.g / 255.0f;
+		blendConstants[2] = renderer->blendFactor.b / 255.0f;
+		blendConstants[3] = renderer->blendFactor.a / 255.0f;
+		renderer->vkCmdSetBlendConstants(cb, blendConstants);
+		renderer->blendFactorDirty = 0;
+	}
+	if (renderer->stencilReferenceDirty) {
+		renderer->vkCmdSetStencilReference(
+			cb, VK_STENCIL_FACE_FRONT_AND_BACK,
+			(uint32_t) renderer->referenceStencil);
+		renderer->stencilReferenceDirty = 0;
+	}
+
+	/* Descriptors */
+	if (renderer->uniformsDirty) {
+		renderer->vertexUniformOffset = VULKAN_INTERNAL_PushUniforms(
+			renderer, renderer->currentVertexShader,
+			renderer->vsRegFileF, renderer->vsRegFileI, renderer->vsRegFileB);
+		renderer->fragmentUniformOffset = VULKAN_INTERNAL_PushUniforms(
+			renderer, renderer->currentPixelShader,
+			renderer->psRegFileF, renderer->psRegFileI, renderer->psRegFileB);
+		renderer->uniformsDirty = 0;
+		renderer->descriptorSetsDirty = 1;
+	}
+	if (renderer->vertexSamplersDirty) {
+		renderer->descriptorSets[VULKAN_SET_VERTEX_SAMPLERS] = VULKAN_INTERNAL_WriteSamplerSet(
+			renderer, renderer->currentVertexShader, renderer->vertexSamplerLayout,
+			renderer->vertexTextures, renderer->vertexSamplers,
+			VULKAN_MAX_VERTEX_TEXTURE_SAMPLERS);
+		renderer->vertexSamplersDirty = 0;
+		renderer->descriptorSetsDirty = 1;
+	}
+	if (renderer->fragmentSamplersDirty) {
+		renderer->descriptorSets[VULKAN_SET_FRAGMENT_SAMPLERS] = VULKAN_INTERNAL_WriteSamplerSet(
+			renderer, renderer->currentPixelShader, renderer->fragmentSamplerLayout,
+			renderer->textures, renderer->samplers,
+			VULKAN_MAX_TEXTURE_SAMPLERS);
+		renderer->fragmentSamplersDirty = 0;
+		renderer->descriptorSetsDirty = 1;
+	}
+	if (renderer->descriptorSetsDirty) {
+		uint32_t dynamicOffsets[2];
+		renderer->descriptorSets[VULKAN_SET_VERTEX_UNIFORMS] = frame->uniformDescriptorSet;
+		renderer->descriptorSets[VULKAN_SET_FRAGMENT_UNIFORMS] = frame->uniformDescriptorSet;
+		dynamicOffsets[0] = renderer->vertexUniformOffset;
+		dynamicOffsets[1] = renderer->fragmentUniformOffset;
+		renderer->vkCmdBindDescriptorSets(
+			cb, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->pipelineLayout,
+			0, VULKAN_SET_COUNT, renderer->descriptorSets, 2, dynamicOffsets);
+		renderer->descriptorSetsDirty = 0;
+	}
+
+	/* Vertex Buffers, resolved here since a rename swaps the VkBuffer */
+	rebind = (renderer->boundVertexBufferCount != renderer->vertexBufferCount);
+	for (i = 0; i < renderer->vertexBufferCount; i++) {
+		VulkanBuffer *buffer = renderer->vertexBuffers[i];
+		buffer->usedFrame = renderer->frameCount;
+		if (	renderer->boundVertexBuffers[i] != buffer->buffer ||
+			renderer->boundVertexOffsets[i] != renderer->vertexBufferOffsets[i]	) {
+			renderer->boundVertexBuffers[i] = buffer->buffer;
+			renderer->boundVertexOffsets[i] = renderer->vertexBufferOffsets[i];
+			rebind = 1;
+		}
+	}
+	if (rebind && renderer->vertexBufferCount > 0) {
+		renderer->vkCmdBindVertexBuffers(
+			cb, 0, renderer->vertexBufferCount,
+			renderer->boundVertexBuffers, renderer->boundVertexOffsets);
+		renderer->boundVertexBufferCount = renderer->vertexBufferCount;
+	}
+
+	return 1;
+}
+
+/* Disposal
+ *
+ * Resources are unbound and retired to the frame being recorded right away,
+ * then destroyed once that frame's fence has signaled. AddDispose* calls from
+ * other threads (finalizers, usually) are queued and retired on the next
+ * present, like the OpenGL driver's DisposeResources.
+ */
+
+static void VULKAN_INTERNAL_DisposeBuffer(VulkanRenderer *renderer, VulkanBuffer *buffer)
+{
+	VulkanBuffer **prev;
+	uint32_t i;
+
+	for (prev = &renderer->bufferList; *prev != NULL; prev = &(*prev)->next) {
+		if (*prev == buffer) {
+			*prev = buffer->next;
+			break;
+		}
+	}
+	for (i = 0; i < renderer->vertexBufferCount; i++) {
+		if (renderer->vertexBuffers[i] == buffer) {
+			/* Rebound by the next ApplyVertexBufferBindings */
+			renderer->vertexBufferCount = 0;
+			break;
+		}
+	}
+	if (renderer->boundIndexBuffer == buffer->buffer) {
+		renderer->boundIndexBuffer = VK_NULL_HANDLE;
+	}
+
+	VULKAN_INTERNAL_RetireBuffer(renderer, buffer);
+}
+
+static void VULKAN_INTERNAL_DisposeTexture(VulkanRenderer *renderer, VulkanTexture *texture)
+{
+	VulkanTexture **prev;
+	int32_t i;
+
+	for (prev = &renderer->textureList; *prev != NULL; prev = &(*prev)->next) {
+		if (*prev == texture) {
+			*prev = texture->next;
+			break;
+		}
+	}
+	for (i = 0; i < VULKAN_MAX_TEXTURE_SAMPLERS; i++) {
+		if (renderer->textures[i] == texture) {
+			renderer->textures[i] = NULL;
+			renderer->fragmentSamplersDirty = 1;
+		}
+	}
+	for (i = 0; i < VULKAN_MAX_VERTEX_TEXTURE_SAMPLERS; i++) {
+		if (renderer->vertexTextures[i] == texture) {
+			renderer->vertexTextures[i] = NULL;
+			renderer->vertexSamplersDirty = 1;
+		}
+	}
+
+	VULKAN_INTERNAL_RetireTexture(renderer, texture);
+}
+
+static void VULKAN_INTERNAL_DisposeRenderbuffer(VulkanRenderer *renderer, VulkanRenderbuffer *renderbuffer)
+{
+	VulkanRenderbuffer **prev;
+
+	for (prev = &renderer->renderbufferList; *prev != NULL; prev = &(*prev)->next) {
+		if (*prev == renderbuffer) {
+			*prev = renderbuffer->next;
+			break;
+		}
+	}
+
+	VULKAN_INTERNAL_RetireRenderbuffer(renderer, renderbuffer);
+}
+
+static void VULKAN_INTERNAL_DisposeEffect(VulkanRenderer *renderer, VulkanEffect *effect)
+{
+	MOJOSHADER_effect *effectData = effect->effect;
+
+	if (effectData == renderer->currentEffect) {
+		MOJOSHADER_effectEndPass(renderer->currentEffect);
+		MOJOSHADER_effectEnd(renderer->currentEffect);
+		renderer->currentEffect = NULL;
+		renderer->currentTechnique = NULL;
+		renderer->currentPass = 0;
+	}
+
+	/* Retires the shaders' programs through DeleteShader */
+	MOJOSHADER_deleteEffect(effectData);
+	SDL_free(effect);
+}
+
+/* The slot can be handed out again right away, QueryBegin resets it in
+ * command order
+ */
+static void VULKAN_INTERNAL_DisposeQuery(VulkanRenderer *renderer, VulkanQuery *query)
+{
+	if (query == renderer->activeQuery) {
+		VULKAN_INTERNAL_EndRenderPass(renderer);
+		renderer->vkCmdEndQuery(
+			renderer->currentCommandBuffer, renderer->occlusionQueryPool, query->index);
+		renderer->activeQuery = NULL;
+	}
+
+	renderer->freeQueries[renderer->freeQueryCount] = query->index;
+	renderer->freeQueryCount += 1;
+	SDL_free(query);
+}
+
+static void VULKAN_INTERNAL_DisposeNow(
+	VulkanRenderer *renderer,
+	VulkanDisposeType type,
+	void *resource
+) {
+	switch (type)
+	{
+	case VULKAN_DISPOSE_BUFFER:
+		VULKAN_INTERNAL_DisposeBuffer(renderer, (VulkanBuffer*) resource);
+		break;
+	case VULKAN_DISPOSE_TEXTURE:
+		VULKAN_INTERNAL_DisposeTexture(renderer, (VulkanTexture*) resource);
+		break;
+	case VULKAN_DISPOSE_RENDERBUFFER:
+		VULKAN_INTERNAL_DisposeRenderbuffer(renderer, (VulkanRenderbuffer*) resource);
+		break;
+	case VULKAN_DISPOSE_EFFECT:
+		VULKAN_INTERNAL_DisposeEffect(renderer, (VulkanEffect*) resource);
+		break;
+	case VULKAN_DISPOSE_QUERY:
+		VULKAN_INTERNAL_DisposeQuery(renderer, (VulkanQuery*) resource);
+		break;
+	}
+}
+
+static void VULKAN_INTERNAL_AddDispose(
+	VulkanRenderer *renderer,
+	VulkanDisposeType type,
+	void *resource
+) {
+	if (renderer->threadID == SDL_ThreadID()) {
+		VULKAN_INTERNAL_DisposeNow(renderer, type, resource);
 		return;
 	}
-	
-	/* Reset command buffer */
-	renderer->vkResetCommandPool(renderer->device, frame->commandPool, 0);
-	
-	/* Begin command buffer */
-	VkCommandBufferBeginInfo beginInfo = {0};
-	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-	renderer->vkBeginCommandBuffer(frame->commandBuffer, &beginInfo);
-	
-	renderer->currentCommandBuffer = frame->commandBuffer;
+
+	SDL_LockMutex(renderer->disposeLock);
+	if (renderer->pendingDisposalCount == renderer->pendingDisposalCapacity) {
+		renderer->pendingDisposalCapacity = SDL_max(64, renderer->pendingDisposalCapacity * 2);
+		renderer->pendingDisposals = (VulkanPendingDispose*) SDL_realloc(
+			renderer->pendingDisposals,
+			sizeof(VulkanPendingDispose) * renderer->pendingDisposalCapacity);
+	}
+	renderer->pendingDisposals[renderer->pendingDisposalCount].type = type;
+	renderer->pendingDisposals[renderer->pendingDisposalCount].resource = resource;
+	renderer->pendingDisposalCount += 1;
+	SDL_UnlockMutex(renderer->disposeLock);
 }
 
-/* Helper: End Frame */
-static void VULKAN_EndFrame(VulkanRenderer *renderer)
+static void VULKAN_INTERNAL_DisposeResources(VulkanRenderer *renderer)
 {
-	VulkanFrameData *frame = &renderer->frames[renderer->currentFrame];
+	uint32_t i;
+
+	SDL_LockMutex(renderer->disposeLock);
+	for (i = 0; i < renderer->pendingDisposalCount; i++) {
+		VULKAN_INTERNAL_DisposeNow(
+			renderer,
+			renderer->pendingDisposals[i].type,
+			renderer->pendingDisposals[i].resource);
+	}
+	renderer->pendingDisposalCount = 0;
+	SDL_UnlockMutex(renderer->disposeLock);
+}
+
+/* Backbuffer */
+
+static void VULKAN_INTERNAL_CreateBackbuffer(
+	VulkanRenderer *renderer,
+	FNA3D_PresentationParameters *presentationParameters
+) {
+	VkSampleCountFlagBits sampleCount;
+
+	renderer->backbufferWidth = presentationParameters->backBufferWidth;
+	renderer->backbufferHeight = presentationParameters->backBufferHeight;
+	renderer->backbufferSurfaceFormat = presentationParameters->backBufferFormat;
+	renderer->backbufferDepthFormat = presentationParameters->depthStencilFormat;
+
+	sampleCount = VULKAN_INTERNAL_GetSampleCount(
+		renderer, presentationParameters->multiSampleCount);
+	renderer->backbufferMultiSampleCount =
+		(sampleCount > VK_SAMPLE_COUNT_1_BIT) ? (int32_t) sampleCount : 0;
+
+	renderer->backbufferColor = VULKAN_INTERNAL_CreateTexture(
+		renderer, renderer->backbufferSurfaceFormat,
+		renderer->backbufferWidth, renderer->backbufferHeight,
+		1, 1, 0, 0, 1);
+
+	renderer->backbufferMultisample = NULL;
+	if (sampleCount > VK_SAMPLE_COUNT_1_BIT) {
+		renderer->backbufferMultisample = VULKAN_INTERNAL_CreateRenderbuffer(
+			renderer, renderer->backbufferWidth, renderer->backbufferHeight,
+			renderer->backbufferColor->format, sampleCount, 0);
+	}
+
+	renderer->backbufferDepthStencil = NULL;
+	if (renderer->backbufferDepthFormat != FNA3D_DEPTHFORMAT_NONE) {
+		renderer->backbufferDepthStencil = VULKAN_INTERNAL_CreateRenderbuffer(
+			renderer, renderer->backbufferWidth, renderer->backbufferHeight,
+			VULKAN_INTERNAL_GetDepthFormat(renderer, renderer->backbufferDepthFormat),
+			sampleCount, 1);
+	}
+}
+
+/* The GPU must be done with the backbuffer before this is called */
+static void VULKAN_INTERNAL_DestroyBackbuffer(VulkanRenderer *renderer)
+{
+	if (renderer->backbufferColor != NULL) {
+		VULKAN_INTERNAL_DestroyTexture(renderer, renderer->backbufferColor);
+		renderer->backbufferColor = NULL;
+	}
+	if (renderer->backbufferMultisample != NULL) {
+		VULKAN_INTERNAL_DestroyRenderbuffer(renderer, renderer->backbufferMultisample);
+		renderer->backbufferMultisample = NULL;
+	}
+	if (renderer->backbufferDepthStencil != NULL) {
+		VULKAN_INTERNAL_DestroyRenderbuffer(renderer, renderer->backbufferDepthStencil);
+		renderer->backbufferDepthStencil = NULL;
+	}
+}
+
+static void VULKAN_INTERNAL_BindBackbuffer(VulkanRenderer *renderer)
+{
+	uint32_t i;
+
+	renderer->colorAttachments[0] = renderer->backbufferColor;
+	renderer->colorMultisampleAttachments[0] = renderer->backbufferMultisample;
+	renderer->colorAttachmentLayers[0] = 0;
+	for (i = 1; i < VULKAN_MAX_RENDER_TARGETS; i++) {
+		renderer->colorAttachments[i] = NULL;
+		renderer->colorMultisampleAttachments[i] = NULL;
+		renderer->colorAttachmentLayers[i] = 0;
+	}
+	renderer->colorAttachmentCount = 1;
+	renderer->depthStencilAttachment = renderer->backbufferDepthStencil;
+	renderer->depthStencilFormat = renderer->backbufferDepthFormat;
+	renderer->renderTargetWidth = renderer->backbufferWidth;
+	renderer->renderTargetHeight = renderer->backbufferHeight;
+	renderer->pipelineDirty = 1;
+	renderer->scissorDirty = 1;
+
+	/* Sampler sets may still point at a texture that is now a target */
+	renderer->vertexSamplersDirty = 1;
+	renderer->fragmentSamplersDirty = 1;
+}
+
+static void VULKAN_INTERNAL_RecreateSwapchain(VulkanRenderer *renderer)
+{
+	int w, h;
+
+	SDL_Vulkan_GetDrawableSize(renderer->window, &w, &h);
+	if (w <= 0 || h <= 0) {
+		/* Minimized, try again on the next present */
+		return;
+	}
+
+	renderer->vkDeviceWaitIdle(renderer->device);
+	VULKAN_CreateSwapchain(renderer, (uint32_t) w, (uint32_t) h);
+}
+
+/* Render State */
+
+static VkDescriptorSetLayout VULKAN_INTERNAL_CreateSetLayout(
+	VulkanRenderer *renderer,
+	VkDescriptorType type,
+	uint32_t bindingCount,
+	VkShaderStageFlags stages
+) {
+	VkDescriptorSetLayoutBinding bindings[VULKAN_MAX_TEXTURE_SAMPLERS];
+	VkDescriptorSetLayout layout = VK_NULL_HANDLE;
 	VkResult result;
-	
-	/* End render pass if active */
-	if (renderer->renderPassActive) {
-		renderer->vkCmdEndRenderPass(renderer->currentCommandBuffer);
-		renderer->renderPassActive = 0;
-	}
-	
-	/* End command buffer */
-	renderer->vkEndCommandBuffer(frame->commandBuffer);
-	
-	/* Submit */
-	VkSemaphore waitSemaphores[] = { frame->imageAvailable };
-	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-	VkSemaphore signalSemaphores[] = { frame->renderFinished };
-	
-	VkSubmitInfo submitInfo = {0};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = waitSemaphores;
-	submitInfo.pWaitDstStageMask = waitStages;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &frame->commandBuffer;
-	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = signalSemaphores;
-	
-	renderer->vkQueueSubmit(renderer->graphicsQueue, 1, &submitInfo, frame->fence);
-	
-	/* Present */
-	VkPresentInfoKHR presentInfo = {0};
-	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-	presentInfo.waitSemaphoreCount = 1;
-	presentInfo.pWaitSemaphores = signalSemaphores;
-	presentInfo.swapchainCount = 1;
-	presentInfo.pSwapchains = &renderer->swapchain.swapchain;
-	presentInfo.pImageIndices = &renderer->swapchain.currentImageIndex;
-	
-	result = renderer->vkQueuePresentKHR(renderer->presentQueue, &presentInfo);
-	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
-		VULKAN_CreateSwapchain(renderer, renderer->backbufferWidth, renderer->backbufferHeight);
-	}
-	
-	renderer->currentFrame = (renderer->currentFrame + 1) % VULKAN_MAX_FRAMES_IN_FLIGHT;
+	uint32_t i;
+
+	for (i = 0; i < bindingCount; i++) {
+		bindings[i].binding = i;
+		bindings[i].descriptorType = type;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = stages;
+		bindings[i].pImmutableSamplers = NULL;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {0};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = bindingCount;
+	layoutInfo.pBindings = bindings;
+
+	result = renderer->vkCreateDescriptorSetLayout(renderer->device, &layoutInfo, NULL, &layout);
+	VK_CHECK_RET(result, VK_NULL_HANDLE);
+	return layout;
+}
+
+static uint8_t VULKAN_INTERNAL_CreateRenderState(
+	VulkanRenderer *renderer,
+	FNA3D_PresentationParameters *presentationParameters
+) {
+	VkFormatProperties formatProps;
+	VkDescriptorSetLayout setLayouts[VULKAN_SET_COUNT];
+	FNA3D_SamplerState defaultSamplerState;
+	uint8_t zeroes[6 * 4];
+	VkResult result;
+	uint32_t i;
+
+	/* D24S8 isn't guaranteed, D32S8 is the usual fallback */
+	renderer->vkGetPhysicalDeviceFormatProperties(
+		renderer->physicalDevice, VK_FORMAT_D24_UNORM_S8_UINT, &formatProps);
+	if (formatProps.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+		renderer->d24Format = VK_FORMAT_D24_UNORM_S8_UINT;
+	} else {
+		renderer->d24Format = VK_FORMAT_D32_SFLOAT_S8_UINT;
+	}
+
+	/* Descriptor layouts, see VULKAN_SET_* */
+	renderer->vertexSamplerLayout = VULKAN_INTERNAL_CreateSetLayout(
+		renderer, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		VULKAN_MAX_VERTEX_TEXTURE_SAMPLERS, VK_SHADER_STAGE_VERTEX_BIT);
+	renderer->fragmentSamplerLayout = VULKAN_INTERNAL_CreateSetLayout(
+		renderer, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		VULKAN_MAX_TEXTURE_SAMPLERS, VK_SHADER_STAGE_FRAGMENT_BIT);
+	renderer->uniformLayout = VULKAN_INTERNAL_CreateSetLayout(
+		renderer, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+		1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
+	if (	renderer->vertexSamplerLayout == VK_NULL_HANDLE ||
+		renderer->fragmentSamplerLayout == VK_NULL_HANDLE ||
+		renderer->uniformLayout == VK_NULL_HANDLE	) {
+		return 0;
+	}
+
+	setLayouts[VULKAN_SET_VERTEX_SAMPLERS] = renderer->vertexSamplerLayout;
+	setLayouts[VULKAN_SET_VERTEX_UNIFORMS] = renderer->uniformLayout;
+	setLayouts[VULKAN_SET_FRAGMENT_SAMPLERS] = renderer->fragmentSamplerLayout;
+	setLayouts[VULKAN_SET_FRAGMENT_UNIFORMS] = renderer->uniformLayout;
+
+	VkPipelineLayoutCreateInfo layoutInfo = {0};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.setLayoutCount = VULKAN_SET_COUNT;
+	layoutInfo.pSetLayouts = setLayouts;
+	result = renderer->vkCreatePipelineLayout(
+		renderer->device, &layoutInfo, NULL, &renderer->pipelineLayout);
+	VK_CHECK(result);
+
+	/* Occlusion queries, slots are handed out by CreateQuery */
+	VkQueryPoolCreateInfo queryPoolInfo = {0};
+	queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolInfo.queryType = VK_QUERY_TYPE_OCCLUSION;
+	queryPoolInfo.queryCount = VULKAN_MAX_QUERIES;
+	result = renderer->vkCreateQueryPool(
+		renderer->device, &queryPoolInfo, NULL, &renderer->occlusionQueryPool);
+	VK_CHECK(result);
+	renderer->freeQueries = (uint32_t*) SDL_malloc(sizeof(uint32_t) * VULKAN_MAX_QUERIES);
+
+	/* First frame */
+	renderer->currentFrame = 0;
+	renderer->frameCount = 1;
+	VULKAN_INTERNAL_BeginFrame(renderer);
+
+	/* Backbuffer */
+	VULKAN_INTERNAL_CreateBackbuffer(renderer, presentationParameters);
+	if (renderer->backbufferColor == NULL) {
+		return 0;
+	}
+	VULKAN_INTERNAL_BindBackbuffer(renderer);
+
+	/* Defaults for unbound samplers */
+	SDL_zeroa(zeroes);
+	renderer->dummyTexture2D = VULKAN_INTERNAL_CreateTexture(
+		renderer, FNA3D_SURFACEFORMAT_COLOR, 1, 1, 1, 1, 0, 0, 0);
+	renderer->dummyTexture3D = VULKAN_INTERNAL_CreateTexture(
+		renderer, FNA3D_SURFACEFORMAT_COLOR, 1, 1, 1, 1, 1, 0, 0);
+	renderer->dummyTextureCube = VULKAN_INTERNAL_CreateTexture(
+		renderer, FNA3D_SURFACEFORMAT_COLOR, 1, 1, 1, 1, 0, 1, 0);
+	if (	renderer->dummyTexture2D == NULL ||
+		renderer->dummyTexture3D == NULL ||
+		renderer->dummyTextureCube == NULL	) {
+		return 0;
+	}
+	VULKAN_INTERNAL_UploadTexture(
+		renderer, renderer->dummyTexture2D,
+		0, 0, 0, 1, 1, 1, 0, 0, zeroes, 4);
+	VULKAN_INTERNAL_UploadTexture(
+		renderer, renderer->dummyTexture3D,
+		0, 0, 0, 1, 1, 1, 0, 0, zeroes, 4);
+	for (i = 0; i < 6; i++) {
+		VULKAN_INTERNAL_UploadTexture(
+			renderer, renderer->dummyTextureCube,
+			0, 0, 0, 1, 1, 1, 0, i, zeroes + (i * 4), 4);
+	}
+
+	SDL_zero(defaultSamplerState);
+	renderer->defaultSampler = VULKAN_INTERNAL_FetchSampler(renderer, &defaultSamplerState);
+	if (renderer->defaultSampler == NULL) {
+		return 0;
+	}
+
+	/* Initial state */
+	renderer->multiSampleMask = -1;
+	renderer->viewport.x = 0;
+	renderer->viewport.y = 0;
+	renderer->viewport.w = renderer->backbufferWidth;
+	renderer->viewport.h = renderer->backbufferHeight;
+	renderer->viewport.minDepth = 0.0f;
+	renderer->viewport.maxDepth = 1.0f;
+
+	return 1;
+}
+
+/* Pipeline Cache */
+
+static uint64_t VULKAN_INTERNAL_PipelineCacheChecksum(const uint8_t *data, size_t size)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		hash ^= data[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+/* One file per GPU model; the header check catches driver updates */
+static char* VULKAN_INTERNAL_GetPipelineCachePath(VulkanRenderer *renderer)
+{
+	const char *dir;
+	char *prefPath = NULL;
+	char *path;
+	size_t len;
+
+	if (!SDL_GetHintBoolean("FNA3D_VULKAN_PIPELINE_CACHE", SDL_TRUE)) {
+		return NULL;
+	}
+
+	dir = SDL_GetHint("FNA3D_VULKAN_PIPELINE_CACHE_PATH");
+	if (dir == NULL || dir[0] == '\0') {
+		prefPath = SDL_GetPrefPath("FNA3D", "VulkanPipelineCache");
+		if (prefPath == NULL) {
+			VK_LOG_WARN("No writable location for the pipeline cache: %s", SDL_GetError());
+			return NULL;
+		}
+		dir = prefPath;
+	}
+
+	len = SDL_strlen(dir) + 64;
+	path = (char*) SDL_malloc(len);
+	SDL_snprintf(
+		path, len, "%s%sFNA3D_Vulkan_%04x_%04x.cache",
+		dir,
+		(dir[SDL_strlen(dir) - 1] == '/' || dir[SDL_strlen(dir) - 1] == '\\') ? "" : "/",
+		renderer->deviceProperties.vendorID,
+		renderer->deviceProperties.deviceID);
+	SDL_free(prefPath);
+	return path;
+}
+
+/* Returns the cache blob inside a validated file, or NULL. Free with SDL_free. */
+static uint8_t* VULKAN_INTERNAL_LoadPipelineCacheFile(
+	VulkanRenderer *renderer,
+	size_t *dataSize
+) {
+	VulkanPipelineCacheHeader header;
+	SDL_RWops *file;
+	Sint64 fileSize;
+	uint8_t *data;
+
+	file = SDL_RWFromFile(renderer->pipelineCachePath, "rb");
+	if (file == NULL) {
+		return NULL; /* First run, nothing to load */
+	}
+
+	fileSize = SDL_RWsize(file);
+	if (	fileSize < (Sint64) sizeof(header) ||
+		SDL_RWread(file, &header, sizeof(header), 1) != 1	) {
+		SDL_RWclose(file);
+		VK_LOG_WARN("Pipeline cache %s is truncated, ignoring", renderer->pipelineCachePath);
+		return NULL;
+	}
+
+	if (	header.magic != VULKAN_PIPELINE_CACHE_MAGIC ||
+		header.version != VULKAN_PIPELINE_CACHE_VERSION ||
+		header.vendorID != renderer->deviceProperties.vendorID ||
+		header.deviceID != renderer->deviceProperties.deviceID ||
+		header.driverVersion != renderer->deviceProperties.driverVersion ||
+		SDL_memcmp(header.pipelineCacheUUID, renderer->deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) != 0	) {
+		SDL_RWclose(file);
+		VK_LOG_INFO("Pipeline cache %s is from another driver, ignoring", renderer->pipelineCachePath);
+		return NULL;
+	}
+
+	if (	header.dataSize == 0 ||
+		header.dataSize != (uint64_t) (fileSize - sizeof(header))	) {
+		SDL_RWclose(file);
+		VK_LOG_WARN("Pipeline cache %s is truncated, ignoring", renderer->pipelineCachePath);
+		return NULL;
+	}
+
+	data = (uint8_t*) SDL_malloc((size_t) header.dataSize);
+	if (	SDL_RWread(file, data, (size_t) header.dataSize, 1) != 1 ||
+		VULKAN_INTERNAL_PipelineCacheChecksum(data, (size_t) header.dataSize) != header.checksum	) {
+		SDL_RWclose(file);
+		SDL_free(data);
+		VK_LOG_WARN("Pipeline cache %s is corrupt, ignoring", renderer->pipelineCachePath);
+		return NULL;
+	}
+
+	SDL_RWclose(file);
+	*dataSize = (size_t) header.dataSize;
+	return data;
+}
+
+static void VULKAN_INTERNAL_CreatePipelineCache(VulkanRenderer *renderer)
+{
+	uint8_t *initialData = NULL;
+	size_t initialDataSize = 0;
+	VkResult result;
+
+	renderer->pipelineCachePath = VULKAN_INTERNAL_GetPipelineCachePath(renderer);
+	if (renderer->pipelineCachePath != NULL) {
+		initialData = VULKAN_INTERNAL_LoadPipelineCacheFile(renderer, &initialDataSize);
+	}
+
+	VkPipelineCacheCreateInfo cacheInfo = {0};
+	cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cacheInfo.initialDataSize = initialDataSize;
+	cacheInfo.pInitialData = initialData;
+	result = renderer->vkCreatePipelineCache(
+		renderer->device, &cacheInfo, NULL, &renderer->pipelineCache);
+
+	if (result != VK_SUCCESS && initialData != NULL) {
+		/* Drivers should reject a bad blob silently, but don't count on it */
+		VK_LOG_WARN("vkCreatePipelineCache rejected %s: %d", renderer->pipelineCachePath, result);
+		cacheInfo.initialDataSize = 0;
+		cacheInfo.pInitialData = NULL;
+		result = renderer->vkCreatePipelineCache(
+			renderer->device, &cacheInfo, NULL, &renderer->pipelineCache);
+	} else if (initialData != NULL) {
+		VK_LOG_INFO(
+			"Loaded %u byte pipeline cache from %s",
+			(uint32_t) initialDataSize, renderer->pipelineCachePath);
+	}
+	SDL_free(initialData);
+
+	if (result != VK_SUCCESS) {
+		/* Pipelines still work without a cache, they just always compile */
+		VK_LOG_WARN("vkCreatePipelineCache failed: %d", result);
+		renderer->pipelineCache = VK_NULL_HANDLE;
+	}
+	renderer->pipelineCacheDirty = 0;
+	renderer->pipelineCacheSaveFrame = renderer->frameCount;
+}
+
+/* Writes the cache out if any pipeline was created since the last save. This
+ * is synchronous; a torn write from a crash mid-save is caught by the checksum
+ * on the next load.
+ */
+static void VULKAN_INTERNAL_SavePipelineCache(VulkanRenderer *renderer)
+{
+	VulkanPipelineCacheHeader header;
+	SDL_RWops *file;
+	uint8_t *data;
+	size_t dataSize = 0;
+	VkResult result;
+
+	renderer->pipelineCacheSaveFrame = renderer->frameCount;
+	if (	renderer->pipelineCachePath == NULL ||
+		renderer->pipelineCache == VK_NULL_HANDLE ||
+		!renderer->pipelineCacheDirty	) {
+		return;
+	}
+	renderer->pipelineCacheDirty = 0;
+
+	result = renderer->vkGetPipelineCacheData(
+		renderer->device, renderer->pipelineCache, &dataSize, NULL);
+	if (result != VK_SUCCESS || dataSize == 0) {
+		return;
+	}
+	data = (uint8_t*) SDL_malloc(dataSize);
+	result = renderer->vkGetPipelineCacheData(
+		renderer->device, renderer->pipelineCache, &dataSize, data);
+	if (result != VK_SUCCESS) {
+		/* VK_INCOMPLETE can't happen unless the cache grew in between */
+		VK_LOG_WARN("vkGetPipelineCacheData failed: %d", result);
+		SDL_free(data);
+		return;
+	}
+
+	SDL_zero(header);
+	header.magic = VULKAN_PIPELINE_CACHE_MAGIC;
+	header.version = VULKAN_PIPELINE_CACHE_VERSION;
+	header.vendorID = renderer->deviceProperties.vendorID;
+	header.deviceID = renderer->deviceProperties.deviceID;
+	header.driverVersion = renderer->deviceProperties.driverVersion;
+	SDL_memcpy(header.pipelineCacheUUID, renderer->deviceProperties.pipelineCacheUUID, VK_UUID_SIZE);
+	header.dataSize = dataSize;
+	header.checksum = VULKAN_INTERNAL_PipelineCacheChecksum(data, dataSize);
+
+	file = SDL_RWFromFile(renderer->pipelineCachePath, "wb");
+	if (file == NULL) {
+		VK_LOG_WARN("Could not write pipeline cache %s: %s", renderer->pipelineCachePath, SDL_GetError());
+		SDL_free(data);
+		return;
+	}
+	if (	SDL_RWwrite(file, &header, sizeof(header), 1) != 1 ||
+		SDL_RWwrite(file, data, dataSize, 1) != 1	) {
+		VK_LOG_WARN("Could not write pipeline cache %s: %s", renderer->pipelineCachePath, SDL_GetError());
+	}
+	SDL_RWclose(file);
+	SDL_free(data);
 }
 
 /* DestroyDevice */
 static void VULKAN_DestroyDevice(FNA3D_Device *device)
 {
 	VulkanRenderer *renderer = (VulkanRenderer*)device->driverData;
-	uint32_t i;
-	
+	VulkanShaderProgram *program, *nextProgram;
+	VulkanSampler *sampler, *nextSampler;
+	VulkanFramebuffer *framebuffer, *nextFramebuffer;
+	VulkanRenderPass *renderPass, *nextRenderPass;
+	VulkanBuffer *buffer, *nextBuffer;
+	VulkanPipelineHashArray *arr;
+	int32_t i, j;
+
 	if (!renderer) return;
-	
+
 	if (renderer->device) {
 		renderer->vkDeviceWaitIdle(renderer->device);
-		
+
+		/* Anything disposed from other threads since the last present */
+		VULKAN_INTERNAL_DisposeResources(renderer);
+
+		/* Waits for the worker, which may still be using the pipeline cache */
+		if (renderer->pipelineCompiler != NULL) {
+			VULKAN_INTERNAL_PublishPipelineJobs(
+				renderer,
+				FNA3D_PipelineCompiler_Destroy(renderer->pipelineCompiler));
+		}
+
+		if (renderer->debugMode) {
+			VULKAN_INTERNAL_LogMemoryStats(renderer);
+		}
+
+		/* Programs and pipelines */
+		for (program = renderer->programList; program != NULL; program = nextProgram) {
+			nextProgram = program->next;
+			renderer->vkDestroyShaderModule(renderer->device, program->vertexModule, NULL);
+			renderer->vkDestroyShaderModule(renderer->device, program->fragmentModule, NULL);
+			SDL_free(program);
+		}
+		for (i = 0; i < VULKAN_PIPELINE_HASH_BUCKETS; i++) {
+			arr = &renderer->pipelineTable.buckets[i];
+			for (j = 0; j < arr->count; j++) {
+				renderer->vkDestroyPipeline(renderer->device, arr->elements[j].value, NULL);
+			}
+			SDL_free(arr->elements);
+		}
+		for (i = 0; i < renderer->vertexLayoutCache.count; i++) {
+			SDL_free(renderer->vertexLayoutCache.elements[i].value);
+		}
+		PackedVertexBufferBindingsArray_Destroy(&renderer->vertexLayoutCache);
+
+		/* Samplers */
+		for (sampler = renderer->samplerList; sampler != NULL; sampler = nextSampler) {
+			nextSampler = sampler->next;
+			renderer->vkDestroySampler(renderer->device, sampler->sampler, NULL);
+			SDL_free(sampler);
+		}
+		SDL_free(renderer->samplerTable.elements);
+
+		/* Framebuffers and render passes */
+		for (framebuffer = renderer->framebufferList; framebuffer != NULL; framebuffer = nextFramebuffer) {
+			nextFramebuffer = framebuffer->next;
+			renderer->vkDestroyFramebuffer(renderer->device, framebuffer->framebuffer, NULL);
+			SDL_free(framebuffer);
+		}
+		renderer->framebufferList = NULL;
+		for (renderPass = renderer->renderPassList; renderPass != NULL; renderPass = nextRenderPass) {
+			nextRenderPass = renderPass->next;
+			renderer->vkDestroyRenderPass(renderer->device, renderPass->renderPass, NULL);
+			SDL_free(renderPass);
+		}
+
+		/* Resources the application leaked, including the backbuffer */
+		while (renderer->textureList != NULL) {
+			VULKAN_INTERNAL_DestroyTexture(renderer, renderer->textureList);
+		}
+		while (renderer->renderbufferList != NULL) {
+			VULKAN_INTERNAL_DestroyRenderbuffer(renderer, renderer->renderbufferList);
+		}
+		for (buffer = renderer->bufferList; buffer != NULL; buffer = nextBuffer) {
+			nextBuffer = buffer->next;
+			VULKAN_INTERNAL_DestroyBuffer(renderer, buffer);
+		}
+
 		/* Destroy frame resources */
 		for (i = 0; i < VULKAN_MAX_FRAMES_IN_FLIGHT; i++) {
 			VulkanFrameData *frame = &renderer->frames[i];
+			VULKAN_INTERNAL_DestroyRetiredResources(renderer, frame);
+			SDL_free(frame->retiredPipelines);
+			if (frame->uniformBuffer) VULKAN_INTERNAL_DestroyBuffer(renderer, frame->uniformBuffer);
+			if (frame->stagingBuffer) VULKAN_INTERNAL_DestroyBuffer(renderer, frame->stagingBuffer);
+			SDL_free(frame->uploadTextures);
+			for (j = 0; j < (int32_t) frame->descriptorPoolCount; j++) {
+				renderer->vkDestroyDescriptorPool(renderer->device, frame->descriptorPools[j], NULL);
+			}
+			SDL_free(frame->descriptorPools);
 			if (frame->fence) renderer->vkDestroyFence(renderer->device, frame->fence, NULL);
 			if (frame->imageAvailable) renderer->vkDestroySemaphore(renderer->device, frame->imageAvailable, NULL);
 			if (frame->renderFinished) renderer->vkDestroySemaphore(renderer->device, frame->renderFinished, NULL);
 			if (frame->commandPool) renderer->vkDestroyCommandPool(renderer->device, frame->commandPool, NULL);
 		}
-		
+
+		/* Only the cached empty blocks should be left by now */
+		while (renderer->memoryPoolList != NULL) {
+			VULKAN_INTERNAL_DestroyMemoryPool(renderer, renderer->memoryPoolList);
+		}
+
+		if (renderer->occlusionQueryPool) renderer->vkDestroyQueryPool(renderer->device, renderer->occlusionQueryPool, NULL);
+
+		/* Descriptor layouts */
+		if (renderer->pipelineLayout) renderer->vkDestroyPipelineLayout(renderer->device, renderer->pipelineLayout, NULL);
+		if (renderer->vertexSamplerLayout) renderer->vkDestroyDescriptorSetLayout(renderer->device, renderer->vertexSamplerLayout, NULL);
+		if (renderer->fragmentSamplerLayout) renderer->vkDestroyDescriptorSetLayout(renderer->device, renderer->fragmentSamplerLayout, NULL);
+		if (renderer->uniformLayout) renderer->vkDestroyDescriptorSetLayout(renderer->device, renderer->uniformLayout, NULL);
+
 		/* Destroy swapchain image views */
 		if (renderer->swapchain.imageViews) {
-			for (i = 0; i < renderer->swapchain.imageCount; i++) {
+			for (i = 0; i < (int32_t) renderer->swapchain.imageCount; i++) {
 				if (renderer->swapchain.imageViews[i]) {
 					renderer->vkDestroyImageView(renderer->device, renderer->swapchain.imageViews[i], NULL);
 				}
 			}
 			SDL_free(renderer->swapchain.imageViews);
 		}
-		
+
 		if (renderer->swapchain.images) SDL_free(renderer->swapchain.images);
 		if (renderer->swapchain.swapchain) renderer->vkDestroySwapchainKHR(renderer->device, renderer->swapchain.swapchain, NULL);
-		if (renderer->pipelineCache) renderer->vkDestroyPipelineCache(renderer->device, renderer->pipelineCache, NULL);
-		
+		if (renderer->pipelineCache) {
+			VULKAN_INTERNAL_SavePipelineCache(renderer);
+			renderer->vkDestroyPipelineCache(renderer->device, renderer->pipelineCache, NULL);
+		}
+
 		renderer->vkDestroyDevice(renderer->device, NULL);
 	}
-	
+
 	if (renderer->surface) renderer->vkDestroySurfaceKHR(renderer->instance, renderer->surface, NULL);
 	if (renderer->instance) renderer->vkDestroyInstance(renderer->instance, NULL);
-	
+
+	SDL_DestroyMutex(renderer->disposeLock);
+	SDL_free(renderer->pendingDisposals);
+	SDL_free(renderer->freeQueries);
+	SDL_free(renderer->pipelineCachePath);
+	FNA3D_PipelineManifest_Destroy(renderer->pipelineManifest);
+
 	SDL_Vulkan_UnloadLibrary();
 	SDL_free(renderer);
 	SDL_free(device);
-	
+
 	VK_LOG_INFO("Vulkan device destroyed");
 }
 
@@ -140,12 +3861,160 @@ static void VULKAN_SwapBuffers(
 	void* overrideWindowHandle
 ) {
 	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
-	(void)sourceRectangle;
-	(void)destinationRectangle;
+	VulkanFrameData *frame = &renderer->frames[renderer->currentFrame];
+	VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	VkCommandBuffer commandBuffers[2];
+	uint32_t imageIndex = 0;
+	uint8_t acquired, recreate;
+	uint64_t swapStart = 0;
+	VkResult result;
 	(void)overrideWindowHandle;
-	
-	VULKAN_EndFrame(renderer);
-	VULKAN_BeginFrame(renderer);
+
+	VULKAN_INTERNAL_EndRenderPass(renderer);
+	VULKAN_INTERNAL_DisposeResources(renderer);
+
+	if (renderer->perf.enabled) {
+		swapStart = SDL_GetPerformanceCounter();
+	}
+	result = renderer->vkAcquireNextImageKHR(
+		renderer->device, renderer->swapchain.swapchain, UINT64_MAX,
+		frame->imageAvailable, VK_NULL_HANDLE, &imageIndex);
+	if (renderer->perf.enabled) {
+		FNA3D_PERF_ADD(
+			renderer->perf, swapWaitNs,
+			VULKAN_INTERNAL_TicksToNs(SDL_GetPerformanceCounter() - swapStart));
+	}
+	acquired = (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR);
+	recreate = (result != VK_SUCCESS);
+
+	if (acquired) {
+		VkImage swapImage = renderer->swapchain.images[imageIndex];
+		VkImageBlit blit;
+
+		VULKAN_INTERNAL_TransitionTexture(
+			renderer, renderer->backbufferColor,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+		/* Chained to the acquire semaphore wait, so not a plain ImageBarrier */
+		VkImageMemoryBarrier barrier = {0};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = swapImage;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.layerCount = 1;
+		renderer->vkCmdPipelineBarrier(
+			renderer->currentCommandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 0, NULL, 0, NULL, 1, &barrier);
+
+		SDL_zero(blit);
+		blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.srcSubresource.layerCount = 1;
+		blit.dstSubresource = blit.srcSubresource;
+		if (sourceRectangle != NULL) {
+			blit.srcOffsets[0].x = sourceRectangle->x;
+			blit.srcOffsets[0].y = sourceRectangle->y;
+			blit.srcOffsets[1].x = sourceRectangle->x + sourceRectangle->w;
+			blit.srcOffsets[1].y = sourceRectangle->y + sourceRectangle->h;
+		} else {
+			blit.srcOffsets[1].x = renderer->backbufferWidth;
+			blit.srcOffsets[1].y = renderer->backbufferHeight;
+		}
+		blit.srcOffsets[1].z = 1;
+		if (destinationRectangle != NULL) {
+			blit.dstOffsets[0].x = destinationRectangle->x;
+			blit.dstOffsets[0].y = destinationRectangle->y;
+			blit.dstOffsets[1].x = destinationRectangle->x + destinationRectangle->w;
+			blit.dstOffsets[1].y = destinationRectangle->y + destinationRectangle->h;
+		} else {
+			blit.dstOffsets[1].x = renderer->swapchain.extent.width;
+			blit.dstOffsets[1].y = renderer->swapchain.extent.height;
+		}
+		blit.dstOffsets[1].z = 1;
+
+		renderer->vkCmdBlitImage(
+			renderer->currentCommandBuffer,
+			renderer->backbufferColor->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			swapImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1, &blit,
+			(	(blit.srcOffsets[1].x - blit.srcOffsets[0].x) ==
+				(blit.dstOffsets[1].x - blit.dstOffsets[0].x) &&
+				(blit.srcOffsets[1].y - blit.srcOffsets[0].y) ==
+				(blit.dstOffsets[1].y - blit.dstOffsets[0].y)	) ?
+				VK_FILTER_NEAREST :
+				VK_FILTER_LINEAR);
+
+		VULKAN_INTERNAL_ImageBarrier(
+			renderer, swapImage, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 1,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+	}
+
+	VkSubmitInfo submitInfo = {0};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = VULKAN_INTERNAL_EndCommandBuffers(renderer, commandBuffers);
+	submitInfo.pCommandBuffers = commandBuffers;
+	if (acquired) {
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = &frame->imageAvailable;
+		submitInfo.pWaitDstStageMask = &waitStage;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &frame->renderFinished;
+	}
+	result = renderer->vkQueueSubmit(renderer->graphicsQueue, 1, &submitInfo, frame->fence);
+	if (result != VK_SUCCESS) {
+		VK_LOG_ERROR("vkQueueSubmit failed: %d", result);
+	}
+
+	if (acquired) {
+		VkPresentInfoKHR presentInfo = {0};
+		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+		presentInfo.waitSemaphoreCount = 1;
+		presentInfo.pWaitSemaphores = &frame->renderFinished;
+		presentInfo.swapchainCount = 1;
+		presentInfo.pSwapchains = &renderer->swapchain.swapchain;
+		presentInfo.pImageIndices = &imageIndex;
+		result = renderer->vkQueuePresentKHR(renderer->presentQueue, &presentInfo);
+		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+			recreate = 1;
+		}
+	}
+
+	if (recreate) {
+		VULKAN_INTERNAL_RecreateSwapchain(renderer);
+	}
+
+	/* Publish prewarmed pipelines once per frame even if nothing misses */
+	VULKAN_INTERNAL_DrainPipelineJobs(renderer);
+
+	if (	renderer->pipelineCacheDirty &&
+		renderer->frameCount - renderer->pipelineCacheSaveFrame >= VULKAN_PIPELINE_CACHE_SAVE_INTERVAL	) {
+		VULKAN_INTERNAL_SavePipelineCache(renderer);
+	}
+
+	renderer->currentFrame = (renderer->currentFrame + 1) % VULKAN_MAX_FRAMES_IN_FLIGHT;
+	renderer->frameCount++;
+	if (renderer->perf.enabled) {
+		swapStart = SDL_GetPerformanceCounter();
+	}
+	VULKAN_INTERNAL_BeginFrame(renderer);
+	if (renderer->perf.enabled) {
+		/* BeginFrame blocks on the fence when the GPU is behind */
+		FNA3D_PERF_ADD(
+			renderer->perf, swapWaitNs,
+			VULKAN_INTERNAL_TicksToNs(SDL_GetPerformanceCounter() - swapStart));
+	}
+
+	/* Frame rate limiting */
+	FNA3D_FramePacer_Wait(&renderer->pacer, NULL);
+	FNA3D_FramePacer_Record(&renderer->pacer, &renderer->perf);
+	FNA3D_PerfState_EndFrame(&renderer->perf);
 }
 
 /* Clear */
@@ -157,96 +4026,166 @@ static void VULKAN_Clear(
 	int32_t stencil
 ) {
 	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
-	VkClearAttachment clearAttachments[2];
+	VkClearAttachment clearAttachments[VULKAN_MAX_RENDER_TARGETS + 1];
 	uint32_t attachmentCount = 0;
-	VkClearRect clearRect = {0};
-	
+	uint32_t i;
+	uint8_t clearColor = (options & FNA3D_CLEAROPTIONS_TARGET) != 0;
+	uint8_t clearDepth = (options & FNA3D_CLEAROPTIONS_DEPTHBUFFER) != 0;
+	uint8_t clearStencil = (options & FNA3D_CLEAROPTIONS_STENCIL) != 0;
+
+	if (renderer->perf.enabled) {
+		FNA3D_PERF_ADD(renderer->perf, clearCalls, 1);
+	}
+
+	if (clearColor) {
+		renderer->clearColorValue.float32[0] = color->x;
+		renderer->clearColorValue.float32[1] = color->y;
+		renderer->clearColorValue.float32[2] = color->z;
+		renderer->clearColorValue.float32[3] = color->w;
+	}
+	if (clearDepth) {
+		renderer->clearDepthStencilValue.depth = depth;
+	}
+	if (clearStencil) {
+		renderer->clearDepthStencilValue.stencil = (uint32_t) stencil;
+	}
+
+	if (!renderer->renderPassActive) {
+		/* Folded into the load ops of the next render pass */
+		renderer->pendingClearColor |= clearColor;
+		renderer->pendingClearDepth |= clearDepth;
+		renderer->pendingClearStencil |= clearStencil;
+		return;
+	}
+
+	if (clearColor) {
+		for (i = 0; i < renderer->colorAttachmentCount; i++) {
+			clearAttachments[attachmentCount].aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			clearAttachments[attachmentCount].colorAttachment = i;
+			clearAttachments[attachmentCount].clearValue.color = renderer->clearColorValue;
+			attachmentCount++;
+		}
+	}
+	if (renderer->depthStencilAttachment != NULL && (clearDepth || clearStencil)) {
+		VkImageAspectFlags aspect = 0;
+		if (clearDepth) {
+			aspect |= VK_IMAGE_ASPECT_DEPTH_BIT;
+		}
+		if (clearStencil) {
+			aspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+		}
+		aspect &= renderer->depthStencilAttachment->aspect;
+		if (aspect != 0) {
+			clearAttachments[attachmentCount].aspectMask = aspect;
+			clearAttachments[attachmentCount].colorAttachment = 0;
+			clearAttachments[attachmentCount].clearValue.depthStencil = renderer->clearDepthStencilValue;
+			attachmentCount++;
+		}
+	}
+	if (attachmentCount == 0) {
+		return;
+	}
+
+	VkClearRect clearRect;
 	clearRect.rect.offset.x = 0;
 	clearRect.rect.offset.y = 0;
-	clearRect.rect.extent.width = renderer->backbufferWidth;
-	clearRect.rect.extent.height = renderer->backbufferHeight;
+	clearRect.rect.extent.width = renderer->renderTargetWidth;
+	clearRect.rect.extent.height = renderer->renderTargetHeight;
 	clearRect.baseArrayLayer = 0;
 	clearRect.layerCount = 1;
-	
-	if (options & FNA3D_CLEAROPTIONS_TARGET) {
-		clearAttachments[attachmentCount].aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		clearAttachments[attachmentCount].colorAttachment = 0;
-		clearAttachments[attachmentCount].clearValue.color.float32[0] = color->x;
-		clearAttachments[attachmentCount].clearValue.color.float32[1] = color->y;
-		clearAttachments[attachmentCount].clearValue.color.float32[2] = color->z;
-		clearAttachments[attachmentCount].clearValue.color.float32[3] = color->w;
-		attachmentCount++;
+	renderer->vkCmdClearAttachments(
+		renderer->currentCommandBuffer, attachmentCount, clearAttachments, 1, &clearRect);
+}
+
+/* Drawing */
+static void VULKAN_INTERNAL_DrawIndexed(VulkanRenderer *renderer, FNA3D_PrimitiveType primitiveType, int32_t baseVertex, int32_t startIndex, int32_t primitiveCount, int32_t instanceCount, VulkanBuffer *indexBuffer, FNA3D_IndexElementSize indexElementSize) {
+	VkIndexType indexType = XNAToVK_IndexType[indexElementSize];
+
+	if (primitiveType != renderer->currentPrimitiveType) {
+		renderer->currentPrimitiveType = primitiveType;
+		renderer->pipelineDirty = 1;
 	}
-	
-	if ((options & FNA3D_CLEAROPTIONS_DEPTHBUFFER) || (options & FNA3D_CLEAROPTIONS_STENCIL)) {
-		clearAttachments[attachmentCount].aspectMask = 0;
-		if (options & FNA3D_CLEAROPTIONS_DEPTHBUFFER) {
-			clearAttachments[attachmentCount].aspectMask |= VK_IMAGE_ASPECT_DEPTH_BIT;
-		}
-		if (options & FNA3D_CLEAROPTIONS_STENCIL) {
-			clearAttachments[attachmentCount].aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
-		}
-		clearAttachments[attachmentCount].colorAttachment = 0;
-		clearAttachments[attachmentCount].clearValue.depthStencil.depth = depth;
-		clearAttachments[attachmentCount].clearValue.depthStencil.stencil = stencil;
-		attachmentCount++;
+	if (!VULKAN_INTERNAL_PrepareDraw(renderer)) {
+		return;
 	}
-	
-	if (attachmentCount > 0 && renderer->currentCommandBuffer && renderer->renderPassActive) {
-		renderer->vkCmdClearAttachments(
-			renderer->currentCommandBuffer,
-			attachmentCount, clearAttachments,
-			1, &clearRect);
+
+	indexBuffer->usedFrame = renderer->frameCount;
+	if (indexBuffer->buffer != renderer->boundIndexBuffer || indexType != renderer->boundIndexType) {
+		renderer->vkCmdBindIndexBuffer(
+			renderer->currentCommandBuffer, indexBuffer->buffer, 0, indexType);
+		renderer->boundIndexBuffer = indexBuffer->buffer;
+		renderer->boundIndexType = indexType;
 	}
+
+	/* baseVertex goes to the draw rather than the vertex buffer offsets */
+	renderer->vkCmdDrawIndexed(
+		renderer->currentCommandBuffer,
+		PrimitiveVerts(primitiveType, primitiveCount),
+		instanceCount, startIndex, baseVertex, 0);
 }
 
-/* Draw Functions */
-static void VULKAN_DrawIndexedPrimitives(FNA3D_Renderer *driverData, FNA3D_PrimitiveType primitiveType, int32_t baseVertex, int32_t minVertexIndex, int32_t numVertices, int32_t startIndex, int32_t primitiveCount, FNA3D_Buffer *indices, FNA3D_IndexElementSize indexElementSize) {
+static void VULKAN_DrawInstancedPrimitives(FNA3D_Renderer *driverData, FNA3D_PrimitiveType primitiveType, int32_t baseVertex, int32_t minVertexIndex, int32_t numVertices, int32_t startIndex, int32_t primitiveCount, int32_t instanceCount, FNA3D_Buffer *indices, FNA3D_IndexElementSize indexElementSize) {
 	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
-	(void)primitiveType; (void)baseVertex; (void)minVertexIndex; (void)numVertices;
-	(void)startIndex; (void)primitiveCount; (void)indices; (void)indexElementSize;
-	/* TODO: Implement indexed draw */
-	(void)renderer;
+	(void)minVertexIndex; (void)numVertices;
+
+	if (renderer->perf.enabled) {
+		FNA3D_PERF_ADD(renderer->perf, drawCalls, 1);
+		FNA3D_PERF_ADD(renderer->perf, drawInstancedCalls, 1);
+	}
+	VULKAN_INTERNAL_DrawIndexed(
+		renderer, primitiveType, baseVertex, startIndex, primitiveCount,
+		instanceCount, (VulkanBuffer*)indices, indexElementSize);
 }
 
-static void VULKAN_DrawInstancedPrimitives(FNA3D_Renderer *driverData, FNA3D_PrimitiveType primitiveType, int32_t baseVertex, int32_t minVertexIndex, int32_t numVertices, int32_t startIndex, int32_t primitiveCount, int32_t instanceCount, FNA3D_Buffer *indices, FNA3D_IndexElementSize indexElementSize) {
-	(void)driverData; (void)primitiveType; (void)baseVertex; (void)minVertexIndex;
-	(void)numVertices; (void)startIndex; (void)primitiveCount; (void)instanceCount;
-	(void)indices; (void)indexElementSize;
+static void VULKAN_DrawIndexedPrimitives(FNA3D_Renderer *driverData, FNA3D_PrimitiveType primitiveType, int32_t baseVertex, int32_t minVertexIndex, int32_t numVertices, int32_t startIndex, int32_t primitiveCount, FNA3D_Buffer *indices, FNA3D_IndexElementSize indexElementSize) {
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+	(void)minVertexIndex; (void)numVertices;
+
+	if (renderer->perf.enabled) {
+		FNA3D_PERF_ADD(renderer->perf, drawCalls, 1);
+		FNA3D_PERF_ADD(renderer->perf, drawIndexedCalls, 1);
+	}
+	VULKAN_INTERNAL_DrawIndexed(
+		renderer, primitiveType, baseVertex, startIndex, primitiveCount,
+		1, (VulkanBuffer*)indices, indexElementSize);
 }
 
 static void VULKAN_DrawPrimitives(FNA3D_Renderer *driverData, FNA3D_PrimitiveType primitiveType, int32_t vertexStart, int32_t primitiveCount) {
-	(void)driverData; (void)primitiveType; (void)vertexStart; (void)primitiveCount;
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+
+	if (renderer->perf.enabled) {
+		FNA3D_PERF_ADD(renderer->perf, drawCalls, 1);
+		FNA3D_PERF_ADD(renderer->perf, drawPrimitiveCalls, 1);
+	}
+
+	if (primitiveType != renderer->currentPrimitiveType) {
+		renderer->currentPrimitiveType = primitiveType;
+		renderer->pipelineDirty = 1;
+	}
+	if (!VULKAN_INTERNAL_PrepareDraw(renderer)) {
+		return;
+	}
+
+	renderer->vkCmdDraw(
+		renderer->currentCommandBuffer,
+		PrimitiveVerts(primitiveType, primitiveCount),
+		1, vertexStart, 0);
 }
 
-/* State Functions */
+/* Pipeline State */
 static void VULKAN_SetViewport(FNA3D_Renderer *driverData, FNA3D_Viewport *viewport) {
 	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
-	renderer->viewport = *viewport;
-	
-	if (renderer->currentCommandBuffer) {
-		VkViewport vp;
-		vp.x = (float)viewport->x;
-		vp.y = (float)viewport->y;
-		vp.width = (float)viewport->w;
-		vp.height = (float)viewport->h;
-		vp.minDepth = viewport->minDepth;
-		vp.maxDepth = viewport->maxDepth;
-		renderer->vkCmdSetViewport(renderer->currentCommandBuffer, 0, 1, &vp);
+	if (SDL_memcmp(&renderer->viewport, viewport, sizeof(FNA3D_Viewport)) != 0) {
+		renderer->viewport = *viewport;
+		renderer->viewportDirty = 1;
 	}
 }
 
 static void VULKAN_SetScissorRect(FNA3D_Renderer *driverData, FNA3D_Rect *scissor) {
 	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
-	renderer->scissorRect = *scissor;
-	
-	if (renderer->currentCommandBuffer) {
-		VkRect2D sc;
-		sc.offset.x = scissor->x;
-		sc.offset.y = scissor->y;
-		sc.extent.width = scissor->w;
-		sc.extent.height = scissor->h;
-		renderer->vkCmdSetScissor(renderer->currentCommandBuffer, 0, 1, &sc);
+	if (SDL_memcmp(&renderer->scissorRect, scissor, sizeof(FNA3D_Rect)) != 0) {
+		renderer->scissorRect = *scissor;
+		renderer->scissorDirty = 1;
 	}
 }
 
@@ -257,16 +4196,9 @@ static void VULKAN_GetBlendFactor(FNA3D_Renderer *driverData, FNA3D_Color *blend
 
 static void VULKAN_SetBlendFactor(FNA3D_Renderer *driverData, FNA3D_Color *blendFactor) {
 	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
-	renderer->blendFactor = *blendFactor;
-	
-	if (renderer->currentCommandBuffer) {
-		float bc[4] = {
-			blendFactor->r / 255.0f,
-			blendFactor->g / 255.0f,
-			blendFactor->b / 255.0f,
-			blendFactor->a / 255.0f
-		};
-		renderer->vkCmdSetBlendConstants(renderer->currentCommandBuffer, bc);
+	if (SDL_memcmp(&renderer->blendFactor, blendFactor, sizeof(FNA3D_Color)) != 0) {
+		renderer->blendFactor = *blendFactor;
+		renderer->blendFactorDirty = 1;
 	}
 }
 
@@ -277,7 +4209,10 @@ static int32_t VULKAN_GetMultiSampleMask(FNA3D_Renderer *driverData) {
 
 static void VULKAN_SetMultiSampleMask(FNA3D_Renderer *driverData, int32_t mask) {
 	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
-	renderer->multiSampleMask = mask;
+	if (renderer->multiSampleMask != mask) {
+		renderer->multiSampleMask = mask;
+		renderer->pipelineDirty = 1;
+	}
 }
 
 static int32_t VULKAN_GetReferenceStencil(FNA3D_Renderer *driverData) {
@@ -287,477 +4222,1144 @@ static int32_t VULKAN_GetReferenceStencil(FNA3D_Renderer *driverData) {
 
 static void VULKAN_SetReferenceStencil(FNA3D_Renderer *driverData, int32_t ref) {
 	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
-	renderer->referenceStencil = ref;
-	
-	if (renderer->currentCommandBuffer) {
-		renderer->vkCmdSetStencilReference(
-			renderer->currentCommandBuffer,
-			VK_STENCIL_FACE_FRONT_AND_BACK, ref);
+	if (renderer->referenceStencil != ref) {
+		renderer->referenceStencil = ref;
+		renderer->stencilReferenceDirty = 1;
 	}
 }
 
 static void VULKAN_SetBlendState(FNA3D_Renderer *driverData, FNA3D_BlendState *blendState) {
 	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
-	renderer->blendState = *blendState;
-	renderer->pipelineDirty = 1;
+	if (SDL_memcmp(&renderer->blendState, blendState, sizeof(FNA3D_BlendState)) != 0) {
+		renderer->blendState = *blendState;
+		renderer->pipelineDirty = 1;
+	}
+	VULKAN_SetBlendFactor(driverData, &blendState->blendFactor);
+	VULKAN_SetMultiSampleMask(driverData, blendState->multiSampleMask);
 }
 
 static void VULKAN_SetDepthStencilState(FNA3D_Renderer *driverData, FNA3D_DepthStencilState *depthStencilState) {
 	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
-	renderer->depthStencilState = *depthStencilState;
-	renderer->pipelineDirty = 1;
+	if (SDL_memcmp(&renderer->depthStencilState, depthStencilState, sizeof(FNA3D_DepthStencilState)) != 0) {
+		renderer->depthStencilState = *depthStencilState;
+		renderer->pipelineDirty = 1;
+	}
+	VULKAN_SetReferenceStencil(driverData, depthStencilState->referenceStencil);
 }
 
 static void VULKAN_ApplyRasterizerState(FNA3D_Renderer *driverData, FNA3D_RasterizerState *rasterizerState) {
 	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
-	renderer->rasterizerState = *rasterizerState;
-	renderer->pipelineDirty = 1;
+	if (SDL_memcmp(&renderer->rasterizerState, rasterizerState, sizeof(FNA3D_RasterizerState)) != 0) {
+		if (renderer->rasterizerState.scissorTestEnable != rasterizerState->scissorTestEnable) {
+			renderer->scissorDirty = 1;
+		}
+		renderer->rasterizerState = *rasterizerState;
+		renderer->pipelineDirty = 1;
+	}
 }
 
 static void VULKAN_VerifySampler(FNA3D_Renderer *driverData, int32_t index, FNA3D_Texture *texture, FNA3D_SamplerState *sampler) {
-	(void)driverData; (void)index; (void)texture; (void)sampler;
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+	VulkanTexture *vkTexture = (VulkanTexture*)texture;
+	VulkanSampler *vkSampler;
+
+	if (vkTexture == NULL) {
+		vkSampler = renderer->defaultSampler;
+	} else {
+		vkSampler = VULKAN_INTERNAL_FetchSampler(renderer, sampler);
+	}
+	if (renderer->textures[index] != vkTexture || renderer->samplers[index] != vkSampler) {
+		renderer->textures[index] = vkTexture;
+		renderer->samplers[index] = vkSampler;
+		renderer->fragmentSamplersDirty = 1;
+	}
 }
 
 static void VULKAN_VerifyVertexSampler(FNA3D_Renderer *driverData, int32_t index, FNA3D_Texture *texture, FNA3D_SamplerState *sampler) {
-	(void)driverData; (void)index; (void)texture; (void)sampler;
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+	VulkanTexture *vkTexture = (VulkanTexture*)texture;
+	VulkanSampler *vkSampler;
+
+	if (vkTexture == NULL) {
+		vkSampler = renderer->defaultSampler;
+	} else {
+		vkSampler = VULKAN_INTERNAL_FetchSampler(renderer, sampler);
+	}
+	if (renderer->vertexTextures[index] != vkTexture || renderer->vertexSamplers[index] != vkSampler) {
+		renderer->vertexTextures[index] = vkTexture;
+		renderer->vertexSamplers[index] = vkSampler;
+		renderer->vertexSamplersDirty = 1;
+	}
 }
 
 static void VULKAN_ApplyVertexBufferBindings(FNA3D_Renderer *driverData, FNA3D_VertexBufferBinding *bindings, int32_t numBindings, uint8_t bindingsUpdated, int32_t baseVertex) {
-	(void)driverData; (void)bindings; (void)numBindings; (void)bindingsUpdated; (void)baseVertex;
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+	VulkanVertexLayout *layout;
+	int32_t i, layoutIndex;
+	uint32_t hash;
+	(void)bindingsUpdated; (void)baseVertex;
+
+	if (renderer->currentVertexShader == NULL) {
+		return;
+	}
+
+	/* The layout depends on the shader as well, so always look it up */
+	layout = (VulkanVertexLayout*) PackedVertexBufferBindingsArray_Fetch(
+		&renderer->vertexLayoutCache, bindings, numBindings,
+		renderer->currentVertexShader, &layoutIndex, &hash);
+	if (layout == NULL) {
+		layout = VULKAN_INTERNAL_GenerateVertexLayout(renderer, bindings, numBindings);
+		PackedVertexBufferBindingsArray_Insert(
+			&renderer->vertexLayoutCache, bindings, numBindings,
+			renderer->currentVertexShader, hash, layout);
+	}
+	if (layout != renderer->currentVertexLayout) {
+		renderer->currentVertexLayout = layout;
+		renderer->pipelineDirty = 1;
+	}
+
+	for (i = 0; i < numBindings; i++) {
+		renderer->vertexBuffers[i] = (VulkanBuffer*)bindings[i].vertexBuffer;
+		renderer->vertexBufferOffsets[i] =
+			(VkDeviceSize) bindings[i].vertexOffset *
+			bindings[i].vertexDeclaration.vertexStride;
+	}
+	renderer->vertexBufferCount = numBindings;
 }
 
 /* Render Targets */
 static void VULKAN_SetRenderTargets(FNA3D_Renderer *driverData, FNA3D_RenderTargetBinding *renderTargets, int32_t numRenderTargets, FNA3D_Renderbuffer *depthStencilBuffer, FNA3D_DepthFormat depthFormat, uint8_t preserveTargetContents) {
-	(void)driverData; (void)renderTargets; (void)numRenderTargets;
-	(void)depthStencilBuffer; (void)depthFormat; (void)preserveTargetContents;
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+	VulkanTexture *colors[VULKAN_MAX_RENDER_TARGETS];
+	VulkanRenderbuffer *multisamples[VULKAN_MAX_RENDER_TARGETS];
+	uint32_t layers[VULKAN_MAX_RENDER_TARGETS];
+	int32_t i;
+	(void)preserveTargetContents; /* Attachments are always loaded */
+
+	if (renderer->perf.enabled) {
+		FNA3D_PERF_ADD(renderer->perf, setRenderTargetCalls, 1);
+	}
+
+	if (renderTargets == NULL) {
+		if (	renderer->colorAttachmentCount == 1 &&
+			renderer->colorAttachments[0] == renderer->backbufferColor	) {
+			return;
+		}
+		VULKAN_INTERNAL_EndRenderPass(renderer);
+		VULKAN_INTERNAL_BindBackbuffer(renderer);
+		return;
+	}
+
+	SDL_zeroa(colors);
+	SDL_zeroa(multisamples);
+	SDL_zeroa(layers);
+	for (i = 0; i < numRenderTargets; i++) {
+		colors[i] = (VulkanTexture*)renderTargets[i].texture;
+		multisamples[i] = (renderTargets[i].multiSampleCount > 1) ?
+			(VulkanRenderbuffer*)renderTargets[i].colorBuffer :
+			NULL;
+		layers[i] = (renderTargets[i].type == FNA3D_RENDERTARGET_TYPE_CUBE) ?
+			(uint32_t) renderTargets[i].cube.face :
+			0;
+	}
+
+	/* Same targets, keep the pass going */
+	if (	renderer->colorAttachmentCount == (uint32_t) numRenderTargets &&
+		SDL_memcmp(renderer->colorAttachments, colors, sizeof(colors)) == 0 &&
+		SDL_memcmp(renderer->colorMultisampleAttachments, multisamples, sizeof(multisamples)) == 0 &&
+		SDL_memcmp(renderer->colorAttachmentLayers, layers, sizeof(layers)) == 0 &&
+		renderer->depthStencilAttachment == (VulkanRenderbuffer*)depthStencilBuffer	) {
+		return;
+	}
+
+	VULKAN_INTERNAL_EndRenderPass(renderer);
+
+	SDL_memcpy(renderer->colorAttachments, colors, sizeof(colors));
+	SDL_memcpy(renderer->colorMultisampleAttachments, multisamples, sizeof(multisamples));
+	SDL_memcpy(renderer->colorAttachmentLayers, layers, sizeof(layers));
+	renderer->colorAttachmentCount = numRenderTargets;
+	renderer->depthStencilAttachment = (VulkanRenderbuffer*)depthStencilBuffer;
+	renderer->depthStencilFormat = depthFormat;
+	renderer->renderTargetWidth = colors[0]->width;
+	renderer->renderTargetHeight = colors[0]->height;
+	renderer->pipelineDirty = 1;
+	renderer->scissorDirty = 1;
+
+	/* Sampler sets may still point at a texture that is now a target */
+	renderer->vertexSamplersDirty = 1;
+	renderer->fragmentSamplersDirty = 1;
 }
 
 static void VULKAN_ResolveTarget(FNA3D_Renderer *driverData, FNA3D_RenderTargetBinding *target) {
-	(void)driverData; (void)target;
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+	VulkanTexture *texture = (VulkanTexture*)target->texture;
+	uint32_t layer, level;
+	int32_t w, h;
+
+	/* Multisample resolves happen at the end of the render pass */
+	if (target->levelCount <= 1) {
+		return;
+	}
+
+	VULKAN_INTERNAL_EndRenderPass(renderer);
+	layer = (target->type == FNA3D_RENDERTARGET_TYPE_CUBE) ? (uint32_t) target->cube.face : 0;
+
+	VULKAN_INTERNAL_TransitionTexture(renderer, texture, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	for (level = 1; level < texture->levelCount; level++) {
+		VkImageBlit blit;
+
+		VULKAN_INTERNAL_ImageBarrier(
+			renderer, texture->image, VK_IMAGE_ASPECT_COLOR_BIT,
+			level - 1, 1, texture->layerCount,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+		SDL_zero(blit);
+		w = SDL_max((int32_t) texture->width >> (level - 1), 1);
+		h = SDL_max((int32_t) texture->height >> (level - 1), 1);
+		blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.srcSubresource.mipLevel = level - 1;
+		blit.srcSubresource.baseArrayLayer = layer;
+		blit.srcSubresource.layerCount = 1;
+		blit.srcOffsets[1].x = w;
+		blit.srcOffsets[1].y = h;
+		blit.srcOffsets[1].z = 1;
+		blit.dstSubresource = blit.srcSubresource;
+		blit.dstSubresource.mipLevel = level;
+		blit.dstOffsets[1].x = SDL_max(w >> 1, 1);
+		blit.dstOffsets[1].y = SDL_max(h >> 1, 1);
+		blit.dstOffsets[1].z = 1;
+		renderer->vkCmdBlitImage(
+			renderer->currentCommandBuffer,
+			texture->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1, &blit, VK_FILTER_LINEAR);
+	}
+	VULKAN_INTERNAL_ImageBarrier(
+		renderer, texture->image, VK_IMAGE_ASPECT_COLOR_BIT,
+		texture->levelCount - 1, 1, texture->layerCount,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+	/* Every level is TRANSFER_SRC now, so the whole-image tracking holds */
+	texture->layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	VULKAN_INTERNAL_TransitionTexture(renderer, texture, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 }
 
 /* Backbuffer */
 static void VULKAN_ResetBackbuffer(FNA3D_Renderer *driverData, FNA3D_PresentationParameters *presentationParameters) {
 	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
-	renderer->backbufferWidth = presentationParameters->backBufferWidth;
-	renderer->backbufferHeight = presentationParameters->backBufferHeight;
-	VULKAN_CreateSwapchain(renderer, renderer->backbufferWidth, renderer->backbufferHeight);
+	uint8_t isBound = (renderer->colorAttachments[0] == renderer->backbufferColor);
+
+	VULKAN_INTERNAL_FlushAndWait(renderer);
+	VULKAN_INTERNAL_DestroyBackbuffer(renderer);
+	VULKAN_INTERNAL_CreateBackbuffer(renderer, presentationParameters);
+	VULKAN_INTERNAL_RecreateSwapchain(renderer);
+
+	if (isBound) {
+		VULKAN_INTERNAL_BindBackbuffer(renderer);
+	}
 }
 
 static void VULKAN_ReadBackbuffer(FNA3D_Renderer *driverData, int32_t x, int32_t y, int32_t w, int32_t h, void* data, int32_t dataLength) {
-	(void)driverData; (void)x; (void)y; (void)w; (void)h; (void)data; (void)dataLength;
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+	VULKAN_INTERNAL_ReadTexture(
+		renderer, renderer->backbufferColor,
+		x, y, 0, w, h, 1, 0, 0, data, dataLength);
 }
 
 static void VULKAN_GetBackbufferSize(FNA3D_Renderer *driverData, int32_t *w, int32_t *h) {
 	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
-	*w = (int32_t)renderer->backbufferWidth;
-	*h = (int32_t)renderer->backbufferHeight;
+	*w = renderer->backbufferWidth;
+	*h = renderer->backbufferHeight;
 }
 
 static FNA3D_SurfaceFormat VULKAN_GetBackbufferSurfaceFormat(FNA3D_Renderer *driverData) {
-	(void)driverData;
-	return FNA3D_SURFACEFORMAT_COLOR;
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+	return renderer->backbufferSurfaceFormat;
 }
 
 static FNA3D_DepthFormat VULKAN_GetBackbufferDepthFormat(FNA3D_Renderer *driverData) {
-	(void)driverData;
-	return FNA3D_DEPTHFORMAT_D24S8;
-}
-
-static int32_t VULKAN_GetBackbufferMultiSampleCount(FNA3D_Renderer *driverData) {
-	(void)driverData;
-	return 0;
-}
-
-/* Texture Creation */
-static FNA3D_Texture* VULKAN_CreateTexture2D(FNA3D_Renderer *driverData, FNA3D_SurfaceFormat format, int32_t width, int32_t height, int32_t levelCount, uint8_t isRenderTarget) {
 	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
-	VulkanTexture *texture = (VulkanTexture*)SDL_malloc(sizeof(VulkanTexture));
-	VkResult result;
-	VkMemoryRequirements memReqs;
-	
-	SDL_memset(texture, 0, sizeof(VulkanTexture));
-	texture->width = width;
-	texture->height = height;
-	texture->depth = 1;
-	texture->levelCount = levelCount;
-	texture->layerCount = 1;
-	texture->format = VULKAN_INTERNAL_GetVkFormat(format);
-	texture->isRenderTarget = isRenderTarget;
-	
-	VkImageCreateInfo imageInfo = {0};
-	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-	imageInfo.imageType = VK_IMAGE_TYPE_2D;
-	imageInfo.format = texture->format;
-	imageInfo.extent.width = width;
-	imageInfo.extent.height = height;
-	imageInfo.extent.depth = 1;
-	imageInfo.mipLevels = levelCount;
-	imageInfo.arrayLayers = 1;
-	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-	imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-	if (isRenderTarget) {
-		imageInfo.usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-	}
-	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	
-	result = renderer->vkCreateImage(renderer->device, &imageInfo, NULL, &texture->image);
-	if (result != VK_SUCCESS) {
-		SDL_free(texture);
-		return NULL;
-	}
-	
-	renderer->vkGetImageMemoryRequirements(renderer->device, texture->image, &memReqs);
-	
-	VkMemoryAllocateInfo allocInfo = {0};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memReqs.size;
-	allocInfo.memoryTypeIndex = VULKAN_INTERNAL_FindMemoryType(
-		renderer, memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	
-	result = renderer->vkAllocateMemory(renderer->device, &allocInfo, NULL, &texture->memory);
-	if (result != VK_SUCCESS) {
-		renderer->vkDestroyImage(renderer->device, texture->image, NULL);
-		SDL_free(texture);
-		return NULL;
-	}
-	
-	renderer->vkBindImageMemory(renderer->device, texture->image, texture->memory, 0);
-	
-	/* Create image view */
-	VkImageViewCreateInfo viewInfo = {0};
-	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-	viewInfo.image = texture->image;
-	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-	viewInfo.format = texture->format;
-	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	viewInfo.subresourceRange.baseMipLevel = 0;
-	viewInfo.subresourceRange.levelCount = levelCount;
-	viewInfo.subresourceRange.baseArrayLayer = 0;
-	viewInfo.subresourceRange.layerCount = 1;
-	
-	result = renderer->vkCreateImageView(renderer->device, &viewInfo, NULL, &texture->view);
-	if (result != VK_SUCCESS) {
-		renderer->vkFreeMemory(renderer->device, texture->memory, NULL);
-		renderer->vkDestroyImage(renderer->device, texture->image, NULL);
-		SDL_free(texture);
-		return NULL;
-	}
-	
-	texture->layout = VK_IMAGE_LAYOUT_UNDEFINED;
-	texture->next = renderer->textureList;
-	renderer->textureList = texture;
-	
-	return (FNA3D_Texture*)texture;
+	return renderer->backbufferDepthFormat;
+}
+
+static int32_t VULKAN_GetBackbufferMultiSampleCount(FNA3D_Renderer *driverData) {
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+	return renderer->backbufferMultiSampleCount;
+}
+
+/* Textures */
+static FNA3D_Texture* VULKAN_CreateTexture2D(FNA3D_Renderer *driverData, FNA3D_SurfaceFormat format, int32_t width, int32_t height, int32_t levelCount, uint8_t isRenderTarget) {
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+	return (FNA3D_Texture*) VULKAN_INTERNAL_CreateTexture(
+		renderer, format, width, height, 1, levelCount, 0, 0, isRenderTarget);
 }
 
 static FNA3D_Texture* VULKAN_CreateTexture3D(FNA3D_Renderer *driverData, FNA3D_SurfaceFormat format, int32_t width, int32_t height, int32_t depth, int32_t levelCount) {
-	(void)driverData; (void)format; (void)width; (void)height; (void)depth; (void)levelCount;
-	return NULL;
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+	return (FNA3D_Texture*) VULKAN_INTERNAL_CreateTexture(
+		renderer, format, width, height, depth, levelCount, 1, 0, 0);
 }
 
 static FNA3D_Texture* VULKAN_CreateTextureCube(FNA3D_Renderer *driverData, FNA3D_SurfaceFormat format, int32_t size, int32_t levelCount, uint8_t isRenderTarget) {
-	(void)driverData; (void)format; (void)size; (void)levelCount; (void)isRenderTarget;
-	return NULL;
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+	return (FNA3D_Texture*) VULKAN_INTERNAL_CreateTexture(
+		renderer, format, size, size, 1, levelCount, 0, 1, isRenderTarget);
 }
 
 static void VULKAN_AddDisposeTexture(FNA3D_Renderer *driverData, FNA3D_Texture *texture) {
-	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
-	VulkanTexture *vkTexture = (VulkanTexture*)texture;
-	
-	if (!vkTexture) return;
-	
-	renderer->vkDeviceWaitIdle(renderer->device);
-	
-	if (vkTexture->view) renderer->vkDestroyImageView(renderer->device, vkTexture->view, NULL);
-	if (vkTexture->image) renderer->vkDestroyImage(renderer->device, vkTexture->image, NULL);
-	if (vkTexture->memory) renderer->vkFreeMemory(renderer->device, vkTexture->memory, NULL);
-	
-	/* Remove from list - simplified for now */
-	SDL_free(vkTexture);
+	VULKAN_INTERNAL_AddDispose((VulkanRenderer*)driverData, VULKAN_DISPOSE_TEXTURE, texture);
 }
 
 static void VULKAN_SetTextureData2D(FNA3D_Renderer *driverData, FNA3D_Texture *texture, int32_t x, int32_t y, int32_t w, int32_t h, int32_t level, void* data, int32_t dataLength) {
-	(void)driverData; (void)texture; (void)x; (void)y; (void)w; (void)h; (void)level; (void)data; (void)dataLength;
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+	VULKAN_INTERNAL_UploadTexture(
+		renderer, (VulkanTexture*)texture,
+		x, y, 0, w, h, 1, level, 0, data, dataLength);
 }
 
 static void VULKAN_SetTextureData3D(FNA3D_Renderer *driverData, FNA3D_Texture *texture, int32_t x, int32_t y, int32_t z, int32_t w, int32_t h, int32_t d, int32_t level, void* data, int32_t dataLength) {
-	(void)driverData; (void)texture; (void)x; (void)y; (void)z; (void)w; (void)h; (void)d; (void)level; (void)data; (void)dataLength;
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+	VULKAN_INTERNAL_UploadTexture(
+		renderer, (VulkanTexture*)texture,
+		x, y, z, w, h, d, level, 0, data, dataLength);
 }
 
 static void VULKAN_SetTextureDataCube(FNA3D_Renderer *driverData, FNA3D_Texture *texture, int32_t x, int32_t y, int32_t w, int32_t h, FNA3D_CubeMapFace cubeMapFace, int32_t level, void* data, int32_t dataLength) {
-	(void)driverData; (void)texture; (void)x; (void)y; (void)w; (void)h; (void)cubeMapFace; (void)level; (void)data; (void)dataLength;
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+	VULKAN_INTERNAL_UploadTexture(
+		renderer, (VulkanTexture*)texture,
+		x, y, 0, w, h, 1, level, cubeMapFace, data, dataLength);
 }
 
 static void VULKAN_SetTextureDataYUV(FNA3D_Renderer *driverData, FNA3D_Texture *y, FNA3D_Texture *u, FNA3D_Texture *v, int32_t yWidth, int32_t yHeight, int32_t uvWidth, int32_t uvHeight, void* data, int32_t dataLength) {
-	(void)driverData; (void)y; (void)u; (void)v; (void)yWidth; (void)yHeight; (void)uvWidth; (void)uvHeight; (void)data; (void)dataLength;
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+	uint8_t *dataPtr = (uint8_t*)data;
+	int32_t yDataLength = yWidth * yHeight;
+	int32_t uvDataLength = uvWidth * uvHeight;
+	(void)dataLength;
+
+	VULKAN_INTERNAL_UploadTexture(
+		renderer, (VulkanTexture*)y,
+		0, 0, 0, yWidth, yHeight, 1, 0, 0, dataPtr, yDataLength);
+	dataPtr += yDataLength;
+	VULKAN_INTERNAL_UploadTexture(
+		renderer, (VulkanTexture*)u,
+		0, 0, 0, uvWidth, uvHeight, 1, 0, 0, dataPtr, uvDataLength);
+	dataPtr += uvDataLength;
+	VULKAN_INTERNAL_UploadTexture(
+		renderer, (VulkanTexture*)v,
+		0, 0, 0, uvWidth, uvHeight, 1, 0, 0, dataPtr, uvDataLength);
 }
 
 static void VULKAN_GetTextureData2D(FNA3D_Renderer *driverData, FNA3D_Texture *texture, int32_t x, int32_t y, int32_t w, int32_t h, int32_t level, void* data, int32_t dataLength) {
-	(void)driverData; (void)texture; (void)x; (void)y; (void)w; (void)h; (void)level; (void)data; (void)dataLength;
+	VULKAN_INTERNAL_ReadTexture(
+		(VulkanRenderer*)driverData, (VulkanTexture*)texture,
+		x, y, 0, w, h, 1, level, 0, data, dataLength);
 }
 
 static void VULKAN_GetTextureData3D(FNA3D_Renderer *driverData, FNA3D_Texture *texture, int32_t x, int32_t y, int32_t z, int32_t w, int32_t h, int32_t d, int32_t level, void* data, int32_t dataLength) {
-	(void)driverData; (void)texture; (void)x; (void)y; (void)z; (void)w; (void)h; (void)d; (void)level; (void)data; (void)dataLength;
+	VULKAN_INTERNAL_ReadTexture(
+		(VulkanRenderer*)driverData, (VulkanTexture*)texture,
+		x, y, z, w, h, d, level, 0, data, dataLength);
 }
 
 static void VULKAN_GetTextureDataCube(FNA3D_Renderer *driverData, FNA3D_Texture *texture, int32_t x, int32_t y, int32_t w, int32_t h, FNA3D_CubeMapFace cubeMapFace, int32_t level, void* data, int32_t dataLength) {
-	(void)driverData; (void)texture; (void)x; (void)y; (void)w; (void)h; (void)cubeMapFace; (void)level; (void)data; (void)dataLength;
+	VULKAN_INTERNAL_ReadTexture(
+		(VulkanRenderer*)driverData, (VulkanTexture*)texture,
+		x, y, 0, w, h, 1, level, cubeMapFace, data, dataLength);
+}
+
+static FNA3D_Readback* VULKAN_RequestTextureDataAsync(FNA3D_Renderer *driverData, FNA3D_Texture *texture, int32_t x, int32_t y, int32_t w, int32_t h, int32_t level, int32_t dataLength) {
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+	VulkanTexture *vulkanTexture = (texture == NULL) ?
+		renderer->backbufferColor :
+		(VulkanTexture*)texture;
+	VulkanReadback *readback;
+	VulkanBuffer *staging;
+
+	staging = VULKAN_INTERNAL_RecordTextureRead(
+		renderer, vulkanTexture, x, y, 0, w, h, 1, level, 0);
+	if (staging == NULL) {
+		return NULL;
+	}
+
+	readback = (VulkanReadback*) SDL_malloc(sizeof(VulkanReadback));
+	readback->base.dataLength = dataLength;
+	readback->base.data = NULL;
+	readback->buffer = staging;
+	readback->frame = renderer->currentFrame;
+	readback->submission = renderer->submitCount + 1;
+	return &readback->base;
+}
+
+static uint8_t VULKAN_PollReadback(FNA3D_Renderer *driverData, FNA3D_Readback *readback, void* data, int32_t dataLength) {
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+	VulkanReadback *vulkanReadback = (VulkanReadback*)readback;
+	uint8_t complete = VULKAN_INTERNAL_SubmissionComplete(
+		renderer, vulkanReadback->frame, vulkanReadback->submission, 0);
+
+	if (data != NULL) {
+		if (!complete) {
+			return 0;
+		}
+		SDL_memcpy(
+			data, vulkanReadback->buffer->mappedPointer,
+			SDL_min(SDL_min(dataLength, readback->dataLength), (int32_t) vulkanReadback->buffer->size));
+	}
+
+	/* Canceled early, the copy may still be running */
+	if (complete) {
+		VULKAN_INTERNAL_DestroyBuffer(renderer, vulkanReadback->buffer);
+	} else {
+		VULKAN_INTERNAL_RetireBuffer(renderer, vulkanReadback->buffer);
+	}
+	SDL_free(vulkanReadback);
+	return 1;
 }
 
 /* Renderbuffers */
 static FNA3D_Renderbuffer* VULKAN_GenColorRenderbuffer(FNA3D_Renderer *driverData, int32_t width, int32_t height, FNA3D_SurfaceFormat format, int32_t multiSampleCount, FNA3D_Texture *texture) {
-	(void)driverData; (void)width; (void)height; (void)format; (void)multiSampleCount; (void)texture;
-	return NULL;
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+	(void)texture; /* Resolved into at the end of each render pass */
+	return (FNA3D_Renderbuffer*) VULKAN_INTERNAL_CreateRenderbuffer(
+		renderer, width, height, VULKAN_INTERNAL_GetVkFormat(format),
+		VULKAN_INTERNAL_GetSampleCount(renderer, multiSampleCount), 0);
 }
 
 static FNA3D_Renderbuffer* VULKAN_GenDepthStencilRenderbuffer(FNA3D_Renderer *driverData, int32_t width, int32_t height, FNA3D_DepthFormat format, int32_t multiSampleCount) {
-	(void)driverData; (void)width; (void)height; (void)format; (void)multiSampleCount;
-	return NULL;
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+	return (FNA3D_Renderbuffer*) VULKAN_INTERNAL_CreateRenderbuffer(
+		renderer, width, height, VULKAN_INTERNAL_GetDepthFormat(renderer, format),
+		VULKAN_INTERNAL_GetSampleCount(renderer, multiSampleCount), 1);
 }
 
 static void VULKAN_AddDisposeRenderbuffer(FNA3D_Renderer *driverData, FNA3D_Renderbuffer *renderbuffer) {
-	(void)driverData; (void)renderbuffer;
+	VULKAN_INTERNAL_AddDispose((VulkanRenderer*)driverData, VULKAN_DISPOSE_RENDERBUFFER, renderbuffer);
 }
 
-/* Vertex Buffers */
-static FNA3D_Buffer* VULKAN_GenVertexBuffer(FNA3D_Renderer *driverData, uint8_t dynamic, FNA3D_BufferUsage usage, int32_t sizeInBytes) {
-	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
-	VulkanBuffer *buffer = (VulkanBuffer*)SDL_malloc(sizeof(VulkanBuffer));
-	VkResult result;
-	VkMemoryRequirements memReqs;
-	VkMemoryPropertyFlags memProps;
-	
-	(void)usage;
-	
-	SDL_memset(buffer, 0, sizeof(VulkanBuffer));
-	buffer->size = sizeInBytes;
-	buffer->isDynamic = dynamic;
-	
-	VkBufferCreateInfo bufferInfo = {0};
-	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	bufferInfo.size = sizeInBytes;
-	bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	
-	result = renderer->vkCreateBuffer(renderer->device, &bufferInfo, NULL, &buffer->buffer);
-	if (result != VK_SUCCESS) {
-		SDL_free(buffer);
+/* Buffers */
+
+static VulkanBuffer* VULKAN_INTERNAL_GenBuffer(
+	VulkanRenderer *renderer,
+	uint8_t dynamic,
+	int32_t sizeInBytes,
+	VkBufferUsageFlags usage
+) {
+	VulkanBuffer *buffer = VULKAN_INTERNAL_CreateBuffer(
+		renderer, sizeInBytes,
+		usage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		dynamic);
+	if (buffer == NULL) {
 		return NULL;
 	}
-	
-	renderer->vkGetBufferMemoryRequirements(renderer->device, buffer->buffer, &memReqs);
-	
-	if (dynamic) {
-		memProps = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	buffer->next = renderer->bufferList;
+	renderer->bufferList = buffer;
+	return buffer;
+}
+
+/* Makes a dynamic buffer's mapping safe to write with these options, returns
+ * 0 if the buffer had to be renamed and could not be
+ */
+static uint8_t VULKAN_INTERNAL_PrepareDynamicWrite(
+	VulkanRenderer *renderer,
+	VulkanBuffer *buffer,
+	FNA3D_SetDataOptions options
+) {
+	VulkanBuffer *shell, *fresh;
+
+	if (	options == FNA3D_SETDATAOPTIONS_NOOVERWRITE ||
+		!VULKAN_INTERNAL_BufferInFlight(renderer, buffer)	) {
+		return 1;
+	}
+
+	/* Rename: the old memory moves to a shell that is retired,
+	 * and the FNA3D_Buffer handle keeps pointing at this struct
+	 */
+	fresh = VULKAN_INTERNAL_CreateBuffer(
+		renderer, buffer->size, buffer->usage, 1);
+	if (fresh == NULL) {
+		return 0;
+	}
+	if (options == FNA3D_SETDATAOPTIONS_NONE) {
+		SDL_memcpy(fresh->mappedPointer, buffer->mappedPointer, buffer->size);
+	}
+
+	shell = (VulkanBuffer*) SDL_malloc(sizeof(VulkanBuffer));
+	SDL_memcpy(shell, buffer, sizeof(VulkanBuffer));
+	VULKAN_INTERNAL_RetireBuffer(renderer, shell);
+
+	buffer->buffer = fresh->buffer;
+	buffer->allocation = fresh->allocation;
+	buffer->mappedPointer = fresh->mappedPointer;
+	buffer->usedFrame = 0;
+	SDL_free(fresh);
+	return 1;
+}
+
+/* Static buffers never rename. If this frame hasn't drawn with the buffer
+ * yet, the copy goes in the upload batch, otherwise it's done in order,
+ * outside the render pass.
+ */
+static void VULKAN_INTERNAL_CopyFromStaging(
+	VulkanRenderer *renderer,
+	VulkanBuffer *buffer,
+	int32_t offsetInBytes,
+	VkBuffer stagingBuffer,
+	VkDeviceSize stagingOffset,
+	int32_t dataLength
+) {
+	VkCommandBuffer commandBuffer;
+
+	if (buffer->usedFrame == renderer->frameCount) {
+		VULKAN_INTERNAL_EndRenderPass(renderer);
+		commandBuffer = renderer->currentCommandBuffer;
+		VULKAN_INTERNAL_MemoryBarrier(
+			renderer,
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_ACCESS_TRANSFER_WRITE_BIT);
 	} else {
-		memProps = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		commandBuffer = VULKAN_INTERNAL_BeginUploads(renderer);
+		if (buffer->uploadFrame == renderer->frameCount) {
+			/* Copies to the same buffer may overlap */
+			VkMemoryBarrier barrier = {0};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			renderer->vkCmdPipelineBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				0, 1, &barrier, 0, NULL, 0, NULL);
+		}
+		buffer->uploadFrame = renderer->frameCount;
 	}
-	
-	VkMemoryAllocateInfo allocInfo = {0};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memReqs.size;
-	allocInfo.memoryTypeIndex = VULKAN_INTERNAL_FindMemoryType(renderer, memReqs.memoryTypeBits, memProps);
-	
-	result = renderer->vkAllocateMemory(renderer->device, &allocInfo, NULL, &buffer->memory);
-	if (result != VK_SUCCESS) {
-		renderer->vkDestroyBuffer(renderer->device, buffer->buffer, NULL);
-		SDL_free(buffer);
-		return NULL;
+
+	VkBufferCopy region;
+	region.srcOffset = stagingOffset;
+	region.dstOffset = offsetInBytes;
+	region.size = dataLength;
+	renderer->vkCmdCopyBuffer(
+		commandBuffer, stagingBuffer, buffer->buffer, 1, &region);
+
+	if (commandBuffer == renderer->currentCommandBuffer) {
+		VULKAN_INTERNAL_MemoryBarrier(
+			renderer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+			VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT);
+	}
+}
+
+static void VULKAN_INTERNAL_SetBufferData(
+	VulkanRenderer *renderer,
+	VulkanBuffer *buffer,
+	int32_t offsetInBytes,
+	void *data,
+	int32_t dataLength,
+	FNA3D_SetDataOptions options
+) {
+	VkBuffer stagingBuffer;
+	VkDeviceSize stagingOffset;
+	uint8_t *staging;
+
+	if (buffer->isDynamic) {
+		if (renderer->perf.enabled) {
+			FNA3D_PERF_ADD(renderer->perf, mapWrites, 1);
+			FNA3D_PERF_ADD(renderer->perf, mapBytes, dataLength);
+		}
+		if (VULKAN_INTERNAL_PrepareDynamicWrite(renderer, buffer, options)) {
+			SDL_memcpy(buffer->mappedPointer + offsetInBytes, data, dataLength);
+		}
+		return;
 	}
-	
-	renderer->vkBindBufferMemory(renderer->device, buffer->buffer, buffer->memory, 0);
-	
-	if (dynamic) {
-		renderer->vkMapMemory(renderer->device, buffer->memory, 0, sizeInBytes, 0, (void**)&buffer->mappedPointer);
+
+	if (renderer->perf.enabled) {
+		FNA3D_PERF_ADD(renderer->perf, subDataWrites, 1);
+		FNA3D_PERF_ADD(renderer->perf, subDataBytes, dataLength);
 	}
-	
-	buffer->next = renderer->bufferList;
-	renderer->bufferList = buffer;
-	
-	return (FNA3D_Buffer*)buffer;
+
+	staging = VULKAN_INTERNAL_AllocateStaging(
+		renderer, dataLength, &stagingBuffer, &stagingOffset);
+	if (staging == NULL) {
+		return;
+	}
+	SDL_memcpy(staging, data, dataLength);
+	VULKAN_INTERNAL_CopyFromStaging(
+		renderer, buffer, offsetInBytes,
+		stagingBuffer, stagingOffset, dataLength);
+}
+
+/* Reads elementCount elements of elementSize bytes, stride bytes apart */
+static void VULKAN_INTERNAL_GetBufferData(
+	VulkanRenderer *renderer,
+	VulkanBuffer *buffer,
+	int32_t offsetInBytes,
+	void *data,
+	int32_t elementCount,
+	int32_t elementSize,
+	int32_t stride
+) {
+	VulkanBuffer *staging = NULL;
+	uint8_t *src, *dst = (uint8_t*)data;
+	int32_t dataLength = elementCount * stride;
+	int32_t i;
+
+	dataLength = SDL_min(dataLength, (int32_t) buffer->size - offsetInBytes);
+	if (dataLength <= 0) {
+		return;
+	}
+
+	if (buffer->isDynamic) {
+		src = buffer->mappedPointer + offsetInBytes;
+	} else {
+		VULKAN_INTERNAL_EndRenderPass(renderer);
+		staging = VULKAN_INTERNAL_CreateBuffer(
+			renderer, dataLength, VK_BUFFER_USAGE_TRANSFER_DST_BIT, 1);
+		if (staging == NULL) {
+			return;
+		}
+
+		VkBufferCopy region;
+		region.srcOffset = offsetInBytes;
+		region.dstOffset = 0;
+		region.size = dataLength;
+		renderer->vkCmdCopyBuffer(
+			renderer->currentCommandBuffer, buffer->buffer, staging->buffer, 1, &region);
+		VULKAN_INTERNAL_MemoryBarrier(
+			renderer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+
+		VULKAN_INTERNAL_FlushAndWait(renderer);
+		src = staging->mappedPointer;
+	}
+
+	if (elementSize < stride) {
+		for (i = 0; i < elementCount && (i * stride) + elementSize <= dataLength; i++) {
+			SDL_memcpy(dst + (i * elementSize), src + (i * stride), elementSize);
+		}
+	} else {
+		SDL_memcpy(dst, src, dataLength);
+	}
+
+	if (staging != NULL) {
+		VULKAN_INTERNAL_DestroyBuffer(renderer, staging);
+	}
+}
+
+static FNA3D_Buffer* VULKAN_GenVertexBuffer(FNA3D_Renderer *driverData, uint8_t dynamic, FNA3D_BufferUsage usage, int32_t sizeInBytes) {
+	(void)usage;
+	return (FNA3D_Buffer*) VULKAN_INTERNAL_GenBuffer(
+		(VulkanRenderer*)driverData, dynamic, sizeInBytes,
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
 }
 
 static void VULKAN_AddDisposeVertexBuffer(FNA3D_Renderer *driverData, FNA3D_Buffer *buffer) {
+	VULKAN_INTERNAL_AddDispose((VulkanRenderer*)driverData, VULKAN_DISPOSE_BUFFER, buffer);
+}
+
+static void VULKAN_SetVertexBufferData(FNA3D_Renderer *driverData, FNA3D_Buffer *buffer, int32_t offsetInBytes, void* data, int32_t elementCount, int32_t elementSizeInBytes, int32_t vertexStride, FNA3D_SetDataOptions options) {
 	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
-	VulkanBuffer *vkBuffer = (VulkanBuffer*)buffer;
-	
-	if (!vkBuffer) return;
-	
-	renderer->vkDeviceWaitIdle(renderer->device);
-	
-	if (vkBuffer->mappedPointer) {
-		renderer->vkUnmapMemory(renderer->device, vkBuffer->memory);
+	(void)vertexStride;
+
+	if (renderer->perf.enabled) {
+		FNA3D_PERF_ADD(renderer->perf, vertexUploadCalls, 1);
+		FNA3D_PERF_ADD(renderer->perf, vertexUploadBytes, elementCount * elementSizeInBytes);
 	}
-	if (vkBuffer->buffer) renderer->vkDestroyBuffer(renderer->device, vkBuffer->buffer, NULL);
-	if (vkBuffer->memory) renderer->vkFreeMemory(renderer->device, vkBuffer->memory, NULL);
-	
-	SDL_free(vkBuffer);
+	VULKAN_INTERNAL_SetBufferData(
+		renderer, (VulkanBuffer*)buffer,
+		offsetInBytes, data, elementCount * elementSizeInBytes, options);
 }
 
-static void VULKAN_SetVertexBufferData(FNA3D_Renderer *driverData, FNA3D_Buffer *buffer, int32_t offsetInBytes, void* data, int32_t elementCount, int32_t elementSizeInBytes, int32_t vertexStride, FNA3D_SetDataOptions options) {
-	VulkanBuffer *vkBuffer = (VulkanBuffer*)buffer;
-	(void)driverData; (void)options;
-	
-	if (vkBuffer && vkBuffer->mappedPointer) {
-		SDL_memcpy(vkBuffer->mappedPointer + offsetInBytes, data, elementCount * vertexStride);
+static void* VULKAN_MapVertexBufferRange(FNA3D_Renderer *driverData, FNA3D_Buffer *buffer, int32_t offsetInBytes, int32_t lengthInBytes, FNA3D_SetDataOptions options) {
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+	VulkanBuffer *vulkanBuffer = (VulkanBuffer*)buffer;
+	uint8_t *staging;
+
+	if (!FNA3D_MappedRange_Begin(
+		&renderer->mappedRange, buffer,
+		offsetInBytes, lengthInBytes, options)) {
+		return NULL;
+	}
+
+	if (renderer->perf.enabled) {
+		FNA3D_PERF_ADD(renderer->perf, mapWrites, 1);
+		FNA3D_PERF_ADD(renderer->perf, mapBytes, lengthInBytes);
+		FNA3D_PERF_ADD(renderer->perf, vertexUploadCalls, 1);
+		FNA3D_PERF_ADD(renderer->perf, vertexUploadBytes, lengthInBytes);
+	}
+
+	/* Dynamic buffers are host-visible, so they are written in place */
+	if (vulkanBuffer->isDynamic) {
+		if (!VULKAN_INTERNAL_PrepareDynamicWrite(renderer, vulkanBuffer, options)) {
+			renderer->mappedRange.buffer = NULL;
+			return NULL;
+		}
+		return vulkanBuffer->mappedPointer + offsetInBytes;
+	}
+
+	/* Static buffers get their copy recorded on unmap */
+	staging = VULKAN_INTERNAL_AllocateStaging(
+		renderer, lengthInBytes,
+		&renderer->mappedStagingBuffer, &renderer->mappedStagingOffset);
+	if (staging == NULL) {
+		renderer->mappedRange.buffer = NULL;
+	}
+	return staging;
+}
+
+static void VULKAN_UnmapVertexBufferRange(FNA3D_Renderer *driverData, FNA3D_Buffer *buffer) {
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+	VulkanBuffer *vulkanBuffer = (VulkanBuffer*)buffer;
+
+	if (!FNA3D_MappedRange_End(&renderer->mappedRange, buffer)) {
+		return;
+	}
+	if (!vulkanBuffer->isDynamic) {
+		VULKAN_INTERNAL_CopyFromStaging(
+			renderer, vulkanBuffer,
+			renderer->mappedRange.offsetInBytes,
+			renderer->mappedStagingBuffer,
+			renderer->mappedStagingOffset,
+			renderer->mappedRange.lengthInBytes);
 	}
 }
 
 static void VULKAN_GetVertexBufferData(FNA3D_Renderer *driverData, FNA3D_Buffer *buffer, int32_t offsetInBytes, void* data, int32_t elementCount, int32_t elementSizeInBytes, int32_t vertexStride) {
-	(void)driverData; (void)buffer; (void)offsetInBytes; (void)data; (void)elementCount; (void)elementSizeInBytes; (void)vertexStride;
+	VULKAN_INTERNAL_GetBufferData(
+		(VulkanRenderer*)driverData, (VulkanBuffer*)buffer,
+		offsetInBytes, data, elementCount, elementSizeInBytes, vertexStride);
 }
 
-/* Index Buffers */
 static FNA3D_Buffer* VULKAN_GenIndexBuffer(FNA3D_Renderer *driverData, uint8_t dynamic, FNA3D_BufferUsage usage, int32_t sizeInBytes) {
-	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
-	VulkanBuffer *buffer = (VulkanBuffer*)SDL_malloc(sizeof(VulkanBuffer));
-	VkResult result;
-	VkMemoryRequirements memReqs;
-	VkMemoryPropertyFlags memProps;
-	
 	(void)usage;
-	
-	SDL_memset(buffer, 0, sizeof(VulkanBuffer));
-	buffer->size = sizeInBytes;
-	buffer->isDynamic = dynamic;
-	
-	VkBufferCreateInfo bufferInfo = {0};
-	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	bufferInfo.size = sizeInBytes;
-	bufferInfo.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	
-	result = renderer->vkCreateBuffer(renderer->device, &bufferInfo, NULL, &buffer->buffer);
-	if (result != VK_SUCCESS) {
-		SDL_free(buffer);
-		return NULL;
-	}
-	
-	renderer->vkGetBufferMemoryRequirements(renderer->device, buffer->buffer, &memReqs);
-	
-	memProps = dynamic ? 
-		(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) :
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-	
-	VkMemoryAllocateInfo allocInfo = {0};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memReqs.size;
-	allocInfo.memoryTypeIndex = VULKAN_INTERNAL_FindMemoryType(renderer, memReqs.memoryTypeBits, memProps);
-	
-	result = renderer->vkAllocateMemory(renderer->device, &allocInfo, NULL, &buffer->memory);
-	if (result != VK_SUCCESS) {
-		renderer->vkDestroyBuffer(renderer->device, buffer->buffer, NULL);
-		SDL_free(buffer);
-		return NULL;
-	}
-	
-	renderer->vkBindBufferMemory(renderer->device, buffer->buffer, buffer->memory, 0);
-	
-	if (dynamic) {
-		renderer->vkMapMemory(renderer->device, buffer->memory, 0, sizeInBytes, 0, (void**)&buffer->mappedPointer);
-	}
-	
-	return (FNA3D_Buffer*)buffer;
+	return (FNA3D_Buffer*) VULKAN_INTERNAL_GenBuffer(
+		(VulkanRenderer*)driverData, dynamic, sizeInBytes,
+		VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
 }
 
 static void VULKAN_AddDisposeIndexBuffer(FNA3D_Renderer *driverData, FNA3D_Buffer *buffer) {
-	VULKAN_AddDisposeVertexBuffer(driverData, buffer);
+	VULKAN_INTERNAL_AddDispose((VulkanRenderer*)driverData, VULKAN_DISPOSE_BUFFER, buffer);
 }
 
 static void VULKAN_SetIndexBufferData(FNA3D_Renderer *driverData, FNA3D_Buffer *buffer, int32_t offsetInBytes, void* data, int32_t dataLength, FNA3D_SetDataOptions options) {
-	VulkanBuffer *vkBuffer = (VulkanBuffer*)buffer;
-	(void)driverData; (void)options;
-	
-	if (vkBuffer && vkBuffer->mappedPointer) {
-		SDL_memcpy(vkBuffer->mappedPointer + offsetInBytes, data, dataLength);
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+
+	if (renderer->perf.enabled) {
+		FNA3D_PERF_ADD(renderer->perf, indexUploadCalls, 1);
+		FNA3D_PERF_ADD(renderer->perf, indexUploadBytes, dataLength);
 	}
+	VULKAN_INTERNAL_SetBufferData(
+		renderer, (VulkanBuffer*)buffer,
+		offsetInBytes, data, dataLength, options);
 }
 
 static void VULKAN_GetIndexBufferData(FNA3D_Renderer *driverData, FNA3D_Buffer *buffer, int32_t offsetInBytes, void* data, int32_t dataLength) {
-	(void)driverData; (void)buffer; (void)offsetInBytes; (void)data; (void)dataLength;
+	VULKAN_INTERNAL_GetBufferData(
+		(VulkanRenderer*)driverData, (VulkanBuffer*)buffer,
+		offsetInBytes, data, dataLength, 1, 1);
 }
 
 /* Effects */
+
+static VulkanShader* VULKAN_INTERNAL_GetEffectShader(
+	MOJOSHADER_effect *effect,
+	uint16_t object,
+	MOJOSHADER_symbolType type
+) {
+	if (	object >= effect->object_count ||
+		effect->objects[object].type != type ||
+		effect->objects[object].shader.is_preshader	) {
+		return NULL;
+	}
+	return (VulkanShader*) effect->objects[object].shader.shader;
+}
+
+static void VULKAN_INTERNAL_PrewarmEffect(
+	VulkanRenderer *renderer,
+	uint8_t *effectCode,
+	uint32_t effectCodeLength,
+	MOJOSHADER_effect *effect
+) {
+	FNA3D_PipelineManifestEntry *entries, *entry;
+	VulkanShader *prevVertexShader = renderer->currentVertexShader;
+	VulkanShader *prevPixelShader = renderer->currentPixelShader;
+	VulkanShaderProgram *prevProgram = renderer->currentProgram;
+	VulkanVertexLayout *prevVertexLayout = renderer->currentVertexLayout;
+	VkFormat colorFormats[VULKAN_MAX_RENDER_TARGETS];
+	VulkanPipelineJob *job;
+	VulkanShaderProgram *program;
+	VulkanVertexLayout *layout;
+	VulkanRenderPass *renderPass;
+	int32_t count, i, j, layoutIndex;
+	uint32_t hash;
+
+	count = FNA3D_PipelineManifest_FindEffect(
+		renderer->pipelineManifest,
+		effectCode,
+		effectCodeLength,
+		&entries);
+	if (count == 0 || effect->error_count > 0) {
+		return;
+	}
+
+	if (renderer->pipelineCompiler == NULL) {
+		renderer->pipelineCompiler = FNA3D_PipelineCompiler_Create(
+			VULKAN_INTERNAL_CompilePipelineJob,
+			renderer);
+		if (renderer->pipelineCompiler == NULL) {
+			return;
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		entry = &entries[i];
+
+		/* Programs and layouts are looked up through the bound shaders */
+		renderer->currentVertexShader = VULKAN_INTERNAL_GetEffectShader(
+			effect, entry->vertexShaderObject, MOJOSHADER_SYMTYPE_VERTEXSHADER);
+		renderer->currentPixelShader = VULKAN_INTERNAL_GetEffectShader(
+			effect, entry->pixelShaderObject, MOJOSHADER_SYMTYPE_PIXELSHADER);
+		if (renderer->currentVertexShader == NULL || renderer->currentPixelShader == NULL) {
+			VK_LOG_WARN("Pipeline manifest does not match effect, skipping");
+			continue;
+		}
+
+		program = VULKAN_INTERNAL_FetchProgram(renderer);
+		if (program == NULL) {
+			continue;
+		}
+
+		/* Same as ApplyVertexBufferBindings, so the hash will match */
+		layout = (VulkanVertexLayout*) PackedVertexBufferBindingsArray_Fetch(
+			&renderer->vertexLayoutCache, entry->bindings, entry->numBindings,
+			renderer->currentVertexShader, &layoutIndex, &hash);
+		if (layout == NULL) {
+			layout = VULKAN_INTERNAL_GenerateVertexLayout(
+				renderer, entry->bindings, entry->numBindings);
+			PackedVertexBufferBindingsArray_Insert(
+				&renderer->vertexLayoutCache, entry->bindings, entry->numBindings,
+				renderer->currentVertexShader, hash, layout);
+		}
+
+		/* Pipelines are always built against the load-op pass */
+		for (j = 0; j < VULKAN_MAX_RENDER_TARGETS; j++) {
+			colorFormats[j] = (j < entry->colorFormatCount) ?
+				VULKAN_INTERNAL_GetVkFormat(entry->colorFormats[j]) :
+				VK_FORMAT_UNDEFINED;
+		}
+		renderPass = VULKAN_INTERNAL_FetchRenderPassForFormats(
+			renderer,
+			colorFormats,
+			entry->colorFormatCount,
+			(entry->depthFormat != FNA3D_DEPTHFORMAT_NONE) ?
+				VULKAN_INTERNAL_GetDepthFormat(renderer, entry->depthFormat) :
+				VK_FORMAT_UNDEFINED,
+			VULKAN_INTERNAL_GetSampleCount(renderer, entry->multiSampleCount),
+			0, 0, 0);
+		if (renderPass == NULL) {
+			continue;
+		}
+
+		job = (VulkanPipelineJob*) SDL_malloc(sizeof(VulkanPipelineJob));
+		job->blendState = entry->blendState;
+		job->depthStencilState = entry->depthStencilState;
+		job->rasterizerState = entry->rasterizerState;
+		job->program = program;
+		job->vertexLayout = layout;
+		job->renderPass = renderPass;
+		job->primitiveType = entry->primitiveType;
+		job->multiSampleMask = entry->multiSampleMask;
+		VULKAN_INTERNAL_HashPipeline(job);
+		if (VULKAN_INTERNAL_PipelineHashTable_Fetch(
+			&renderer->pipelineTable, job->hash) != VK_NULL_HANDLE) {
+			SDL_free(job);
+			continue;
+		}
+		VULKAN_INTERNAL_FillPipelineCreateInfo(renderer, job);
+
+		/* The program and layout go away with the shaders, keep them alive */
+		VULKAN_INTERNAL_ShaderAddRef(renderer->currentVertexShader);
+		VULKAN_INTERNAL_ShaderAddRef(renderer->currentPixelShader);
+		job->vertexShader = renderer->currentVertexShader;
+		job->pixelShader = renderer->currentPixelShader;
+		job->pipeline = VK_NULL_HANDLE;
+		job->result = VK_SUCCESS;
+
+		FNA3D_PipelineCompiler_Submit(renderer->pipelineCompiler, &job->job, 0);
+		renderer->pipelineJobsInFlight += 1;
+	}
+
+	renderer->currentVertexShader = prevVertexShader;
+	renderer->currentPixelShader = prevPixelShader;
+	renderer->currentProgram = prevProgram;
+	renderer->currentVertexLayout = prevVertexLayout;
+}
+
 static void VULKAN_CreateEffect(FNA3D_Renderer *driverData, uint8_t *effectCode, uint32_t effectCodeLength, FNA3D_Effect **effect, MOJOSHADER_effect **effectData) {
-	(void)driverData; (void)effectCode; (void)effectCodeLength;
-	*effect = NULL;
-	*effectData = NULL;
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+	MOJOSHADER_effectShaderContext shaderBackend;
+	VulkanEffect *result;
+	int32_t i;
+
+	shaderBackend.shaderContext = renderer;
+	shaderBackend.compileShader = (MOJOSHADER_compileShaderFunc) VULKAN_INTERNAL_CompileShader;
+	shaderBackend.shaderAddRef = (MOJOSHADER_shaderAddRefFunc) VULKAN_INTERNAL_ShaderAddRef;
+	shaderBackend.deleteShader = (MOJOSHADER_deleteShaderFunc) VULKAN_INTERNAL_DeleteShader;
+	shaderBackend.getParseData = (MOJOSHADER_getParseDataFunc) VULKAN_INTERNAL_GetShaderParseData;
+	shaderBackend.bindShaders = (MOJOSHADER_bindShadersFunc) VULKAN_INTERNAL_BindShaders;
+	shaderBackend.getBoundShaders = (MOJOSHADER_getBoundShadersFunc) VULKAN_INTERNAL_GetBoundShaders;
+	shaderBackend.mapUniformBufferMemory = (MOJOSHADER_mapUniformBufferMemoryFunc) VULKAN_INTERNAL_MapUniformBufferMemory;
+	shaderBackend.unmapUniformBufferMemory = (MOJOSHADER_unmapUniformBufferMemoryFunc) VULKAN_INTERNAL_UnmapUniformBufferMemory;
+	shaderBackend.getError = (MOJOSHADER_getErrorFunc) VULKAN_INTERNAL_GetShaderError;
+	shaderBackend.m = NULL;
+	shaderBackend.f = NULL;
+	shaderBackend.malloc_data = renderer;
+
+	*effectData = MOJOSHADER_compileEffect(
+		effectCode, effectCodeLength, NULL, 0, NULL, 0, &shaderBackend);
+
+	for (i = 0; i < (*effectData)->error_count; i++) {
+		VK_LOG_ERROR(
+			"MOJOSHADER_compileEffect Error: %s",
+			(*effectData)->errors[i].error);
+	}
+
+	result = (VulkanEffect*) SDL_malloc(sizeof(VulkanEffect));
+	result->effect = *effectData;
+	*effect = (FNA3D_Effect*) result;
+
+	if (renderer->pipelineManifest != NULL) {
+		VULKAN_INTERNAL_PrewarmEffect(
+			renderer, effectCode, effectCodeLength, *effectData);
+	}
 }
 
 static void VULKAN_CloneEffect(FNA3D_Renderer *driverData, FNA3D_Effect *cloneSource, FNA3D_Effect **effect, MOJOSHADER_effect **effectData) {
-	(void)driverData; (void)cloneSource;
-	*effect = NULL;
-	*effectData = NULL;
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+	VulkanEffect *vkCloneSource = (VulkanEffect*)cloneSource;
+	VulkanEffect *result;
+
+	*effectData = MOJOSHADER_cloneEffect(vkCloneSource->effect);
+	if (*effectData == NULL) {
+		VK_LOG_ERROR("%s", renderer->shaderError);
+	}
+
+	result = (VulkanEffect*) SDL_malloc(sizeof(VulkanEffect));
+	result->effect = *effectData;
+	*effect = (FNA3D_Effect*) result;
+}
+
+static void VULKAN_PrewarmPipelines(FNA3D_Renderer *driverData, FNA3D_PipelineManifest *manifest) {
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+
+	/* Only effects created from now on are prewarmed */
+	FNA3D_PipelineManifest_Destroy(renderer->pipelineManifest);
+	renderer->pipelineManifest = manifest;
 }
 
 static void VULKAN_AddDisposeEffect(FNA3D_Renderer *driverData, FNA3D_Effect *effect) {
-	(void)driverData; (void)effect;
+	VULKAN_INTERNAL_AddDispose((VulkanRenderer*)driverData, VULKAN_DISPOSE_EFFECT, effect);
 }
 
 static void VULKAN_SetEffectTechnique(FNA3D_Renderer *driverData, FNA3D_Effect *effect, MOJOSHADER_effectTechnique *technique) {
-	(void)driverData; (void)effect; (void)technique;
+	VulkanEffect *vkEffect = (VulkanEffect*)effect;
+	(void)driverData;
+	MOJOSHADER_effectSetTechnique(vkEffect->effect, technique);
 }
 
 static void VULKAN_ApplyEffect(FNA3D_Renderer *driverData, FNA3D_Effect *effect, uint32_t pass, MOJOSHADER_effectStateChanges *stateChanges) {
-	(void)driverData; (void)effect; (void)pass; (void)stateChanges;
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+	MOJOSHADER_effect *effectData = ((VulkanEffect*)effect)->effect;
+	const MOJOSHADER_effectTechnique *technique = effectData->current_technique;
+	uint32_t numPasses;
+
+	if (renderer->perf.enabled) {
+		FNA3D_PERF_ADD(renderer->perf, applyEffectCalls, 1);
+	}
+
+	if (effectData == renderer->currentEffect) {
+		if (technique == renderer->currentTechnique && pass == renderer->currentPass) {
+			MOJOSHADER_effectCommitChanges(renderer->currentEffect);
+			return;
+		}
+		MOJOSHADER_effectEndPass(renderer->currentEffect);
+		MOJOSHADER_effectBeginPass(renderer->currentEffect, pass);
+		renderer->currentTechnique = technique;
+		renderer->currentPass = pass;
+		return;
+	} else if (renderer->currentEffect != NULL) {
+		MOJOSHADER_effectEndPass(renderer->currentEffect);
+		MOJOSHADER_effectEnd(renderer->currentEffect);
+	}
+
+	MOJOSHADER_effectBegin(effectData, &numPasses, 0, stateChanges);
+	MOJOSHADER_effectBeginPass(effectData, pass);
+	renderer->currentEffect = effectData;
+	renderer->currentTechnique = technique;
+	renderer->currentPass = pass;
 }
 
 static void VULKAN_BeginPassRestore(FNA3D_Renderer *driverData, FNA3D_Effect *effect, MOJOSHADER_effectStateChanges *stateChanges) {
-	(void)driverData; (void)effect; (void)stateChanges;
+	MOJOSHADER_effect *effectData = ((VulkanEffect*)effect)->effect;
+	uint32_t whatever;
+	(void)driverData;
+
+	MOJOSHADER_effectBegin(effectData, &whatever, 1, stateChanges);
+	MOJOSHADER_effectBeginPass(effectData, 0);
 }
 
 static void VULKAN_EndPassRestore(FNA3D_Renderer *driverData, FNA3D_Effect *effect) {
-	(void)driverData; (void)effect;
+	MOJOSHADER_effect *effectData = ((VulkanEffect*)effect)->effect;
+	(void)driverData;
+
+	MOJOSHADER_effectEndPass(effectData);
+	MOJOSHADER_effectEnd(effectData);
 }
 
 /* Queries */
+
 static FNA3D_Query* VULKAN_CreateQuery(FNA3D_Renderer *driverData) {
-	(void)driverData;
-	return NULL;
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+	VulkanQuery *query;
+	uint32_t index;
+
+	if (renderer->freeQueryCount > 0) {
+		renderer->freeQueryCount -= 1;
+		index = renderer->freeQueries[renderer->freeQueryCount];
+	} else if (renderer->queryCount < VULKAN_MAX_QUERIES) {
+		index = renderer->queryCount;
+		renderer->queryCount += 1;
+	} else {
+		VK_LOG_ERROR("Out of occlusion queries, the limit is %d", VULKAN_MAX_QUERIES);
+		return NULL;
+	}
+
+	query = (VulkanQuery*) SDL_malloc(sizeof(VulkanQuery));
+	query->index = index;
+	query->active = 0;
+	query->frame = 0;
+	query->submission = 0;
+	return (FNA3D_Query*) query;
 }
 
 static void VULKAN_AddDisposeQuery(FNA3D_Renderer *driverData, FNA3D_Query *query) {
-	(void)driverData; (void)query;
+	VULKAN_INTERNAL_AddDispose((VulkanRenderer*)driverData, VULKAN_DISPOSE_QUERY, query);
 }
 
+/* Queries are recorded outside of render passes so they can span several,
+ * the way XNA's do across target changes
+ */
 static void VULKAN_QueryBegin(FNA3D_Renderer *driverData, FNA3D_Query *query) {
-	(void)driverData; (void)query;
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+	VulkanQuery *vulkanQuery = (VulkanQuery*)query;
+
+	if (renderer->activeQuery != NULL) {
+		VK_LOG_WARN("QueryBegin called while another query is active");
+		return;
+	}
+
+	VULKAN_INTERNAL_EndRenderPass(renderer);
+	renderer->vkCmdResetQueryPool(
+		renderer->currentCommandBuffer, renderer->occlusionQueryPool,
+		vulkanQuery->index, 1);
+	renderer->vkCmdBeginQuery(
+		renderer->currentCommandBuffer, renderer->occlusionQueryPool,
+		vulkanQuery->index,
+		renderer->deviceFeatures.occlusionQueryPrecise ? VK_QUERY_CONTROL_PRECISE_BIT : 0);
+
+	vulkanQuery->active = 1;
+	vulkanQuery->frame = renderer->currentFrame;
+	vulkanQuery->submission = renderer->submitCount + 1;
+	renderer->activeQuery = vulkanQuery;
 }
 
 static void VULKAN_QueryEnd(FNA3D_Renderer *driverData, FNA3D_Query *query) {
-	(void)driverData; (void)query;
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+	VulkanQuery *vulkanQuery = (VulkanQuery*)query;
+
+	/* Already ended if the frame was submitted in between */
+	if (!vulkanQuery->active) {
+		return;
+	}
+
+	VULKAN_INTERNAL_EndRenderPass(renderer);
+	renderer->vkCmdEndQuery(
+		renderer->currentCommandBuffer, renderer->occlusionQueryPool,
+		vulkanQuery->index);
+	vulkanQuery->active = 0;
+	renderer->activeQuery = NULL;
 }
 
 static uint8_t VULKAN_QueryComplete(FNA3D_Renderer *driverData, FNA3D_Query *query) {
-	(void)driverData; (void)query;
-	return 1;
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+	VulkanQuery *vulkanQuery = (VulkanQuery*)query;
+
+	if (vulkanQuery->submission == 0) {
+		return 1;
+	}
+	if (vulkanQuery->active) {
+		return 0;
+	}
+	return VULKAN_INTERNAL_SubmissionComplete(
+		renderer, vulkanQuery->frame, vulkanQuery->submission, 0);
 }
 
 static int32_t VULKAN_QueryPixelCount(FNA3D_Renderer *driverData, FNA3D_Query *query) {
-	(void)driverData; (void)query;
-	return 0;
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+	VulkanQuery *vulkanQuery = (VulkanQuery*)query;
+	uint32_t samples = 0;
+	VkResult result;
+
+	if (vulkanQuery->submission == 0) {
+		return 0;
+	}
+	if (vulkanQuery->active) {
+		VULKAN_QueryEnd(driverData, query);
+	}
+	VULKAN_INTERNAL_SubmissionComplete(
+		renderer, vulkanQuery->frame, vulkanQuery->submission, 1);
+
+	result = renderer->vkGetQueryPoolResults(
+		renderer->device, renderer->occlusionQueryPool,
+		vulkanQuery->index, 1, sizeof(samples), &samples, sizeof(samples),
+		VK_QUERY_RESULT_WAIT_BIT);
+	VK_CHECK_RET(result, 0);
+	return (int32_t) samples;
 }
 
 /* Feature Queries */
-static uint8_t VULKAN_SupportsDXT1(FNA3D_Renderer *driverData) { (void)driverData; return 1; }
-static uint8_t VULKAN_SupportsS3TC(FNA3D_Renderer *driverData) { (void)driverData; return 1; }
-static uint8_t VULKAN_SupportsBC7(FNA3D_Renderer *driverData) { (void)driverData; return 1; }
+static uint8_t VULKAN_SupportsDXT1(FNA3D_Renderer *driverData) { return ((VulkanRenderer*)driverData)->deviceFeatures.textureCompressionBC; }
+static uint8_t VULKAN_SupportsS3TC(FNA3D_Renderer *driverData) { return ((VulkanRenderer*)driverData)->deviceFeatures.textureCompressionBC; }
+static uint8_t VULKAN_SupportsBC7(FNA3D_Renderer *driverData) { return ((VulkanRenderer*)driverData)->deviceFeatures.textureCompressionBC; }
 static uint8_t VULKAN_SupportsHardwareInstancing(FNA3D_Renderer *driverData) { (void)driverData; return 1; }
 static uint8_t VULKAN_SupportsNoOverwrite(FNA3D_Renderer *driverData) { (void)driverData; return 1; }
 static uint8_t VULKAN_SupportsSRGBRenderTargets(FNA3D_Renderer *driverData) { (void)driverData; return 1; }
 
 static void VULKAN_GetMaxTextureSlots(FNA3D_Renderer *driverData, int32_t *textures, int32_t *vertexTextures) {
 	(void)driverData;
-	*textures = 16;
-	*vertexTextures = 4;
+	*textures = VULKAN_MAX_TEXTURE_SAMPLERS;
+	*vertexTextures = VULKAN_MAX_VERTEX_TEXTURE_SAMPLERS;
 }
 
 static int32_t VULKAN_GetMaxMultiSampleCount(FNA3D_Renderer *driverData, FNA3D_SurfaceFormat format, int32_t multiSampleCount) {
-	(void)driverData; (void)format; (void)multiSampleCount;
-	return 8;
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+	VkSampleCountFlagBits sampleCount;
+	(void)format;
+
+	sampleCount = VULKAN_INTERNAL_GetSampleCount(renderer, multiSampleCount);
+	return (sampleCount > VK_SAMPLE_COUNT_1_BIT) ? (int32_t) sampleCount : 0;
+}
+
+/* Performance Counters */
+static void VULKAN_GetPerfCounters(FNA3D_Renderer *driverData, FNA3D_PerfCounters *counters) {
+	VulkanRenderer *renderer = (VulkanRenderer*)driverData;
+	FNA3D_PerfState_Get(&renderer->perf, counters);
 }
 
 /* Debug */
@@ -811,12 +5413,16 @@ static void VULKAN_AssignDeviceFunctions(FNA3D_Device *device)
 	device->GetTextureData2D = VULKAN_GetTextureData2D;
 	device->GetTextureData3D = VULKAN_GetTextureData3D;
 	device->GetTextureDataCube = VULKAN_GetTextureDataCube;
+	device->RequestTextureDataAsync = VULKAN_RequestTextureDataAsync;
+	device->PollReadback = VULKAN_PollReadback;
 	device->GenColorRenderbuffer = VULKAN_GenColorRenderbuffer;
 	device->GenDepthStencilRenderbuffer = VULKAN_GenDepthStencilRenderbuffer;
 	device->AddDisposeRenderbuffer = VULKAN_AddDisposeRenderbuffer;
 	device->GenVertexBuffer = VULKAN_GenVertexBuffer;
 	device->AddDisposeVertexBuffer = VULKAN_AddDisposeVertexBuffer;
 	device->SetVertexBufferData = VULKAN_SetVertexBufferData;
+	device->MapVertexBufferRange = VULKAN_MapVertexBufferRange;
+	device->UnmapVertexBufferRange = VULKAN_UnmapVertexBufferRange;
 	device->GetVertexBufferData = VULKAN_GetVertexBufferData;
 	device->GenIndexBuffer = VULKAN_GenIndexBuffer;
 	device->AddDisposeIndexBuffer = VULKAN_AddDisposeIndexBuffer;
@@ -824,6 +5430,7 @@ static void VULKAN_AssignDeviceFunctions(FNA3D_Device *device)
 	device->GetIndexBufferData = VULKAN_GetIndexBufferData;
 	device->CreateEffect = VULKAN_CreateEffect;
 	device->CloneEffect = VULKAN_CloneEffect;
+	device->PrewarmPipelines = VULKAN_PrewarmPipelines;
 	device->AddDisposeEffect = VULKAN_AddDisposeEffect;
 	device->SetEffectTechnique = VULKAN_SetEffectTechnique;
 	device->ApplyEffect = VULKAN_ApplyEffect;
@@ -843,6 +5450,7 @@ static void VULKAN_AssignDeviceFunctions(FNA3D_Device *device)
 	device->SupportsSRGBRenderTargets = VULKAN_SupportsSRGBRenderTargets;
 	device->GetMaxTextureSlots = VULKAN_GetMaxTextureSlots;
 	device->GetMaxMultiSampleCount = VULKAN_GetMaxMultiSampleCount;
+	device->GetPerfCounters = VULKAN_GetPerfCounters;
 	device->SetStringMarker = VULKAN_SetStringMarker;
 	device->SetTextureName = VULKAN_SetTextureName;
 }
@@ -138,35 +138,116 @@ PackedState GetPackedSamplerState(FNA3D_SamplerState samplerState)
 
 #undef FLOAT_TO_UINT64
 
-void* PackedStateArray_Fetch(PackedStateArray arr, PackedState key)
+/* Hash tables are kept at most half full, so probe runs stay short */
+#define PACKEDSTATE_INITIAL_CAPACITY 16
+
+static inline uint32_t PackedState_Hash(PackedState key)
 {
-	int32_t i;
+	/* Fold both halves together, then run the 64-bit finalizer from
+	 * MurmurHash3 so that small field changes hit distinct slots.
+	 */
+	uint64_t h = key.a ^ (key.b * 0x9E3779B97F4A7C15ULL);
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ULL;
+	h ^= h >> 33;
+	return (uint32_t) h;
+}
+
+void* PackedStateHashTable_Fetch(
+	const PackedStateHashTable *table,
+	PackedState key
+) {
+	uint32_t mask, i;
+	const PackedStateMap *elem;
 
-	for (i = 0; i < arr.count; i += 1)
+	if (table->capacity == 0)
 	{
-		if (	key.a == arr.elements[i].key.a &&
-			key.b == arr.elements[i].key.b		)
+		return NULL;
+	}
+
+	mask = (uint32_t) table->capacity - 1;
+	i = PackedState_Hash(key) & mask;
+	while (1)
+	{
+		elem = &table->elements[i];
+		if (elem->value == NULL)
 		{
-			return arr.elements[i].value;
+			return NULL;
 		}
+		if (elem->key.a == key.a && elem->key.b == key.b)
+		{
+			return elem->value;
+		}
+		i = (i + 1) & mask;
 	}
+}
 
-	return NULL;
+static void PackedStateHashTable_INTERNAL_Place(
+	PackedStateMap *elements,
+	uint32_t mask,
+	PackedState key,
+	void* value
+) {
+	uint32_t i = PackedState_Hash(key) & mask;
+	while (elements[i].value != NULL)
+	{
+		i = (i + 1) & mask;
+	}
+	elements[i].key = key;
+	elements[i].value = value;
 }
 
-void PackedStateArray_Insert(PackedStateArray *arr, PackedState key, void* value)
-{
-	PackedStateMap map;
-	map.key.a = key.a;
-	map.key.b = key.b;
-	map.value = value;
+void PackedStateHashTable_Insert(
+	PackedStateHashTable *table,
+	PackedState key,
+	void* value
+) {
+	PackedStateMap *oldElements;
+	int32_t oldCapacity, i;
 
-	EXPAND_ARRAY_IF_NEEDED(arr, 4, PackedStateMap)
+	SDL_assert(value != NULL);
 
-	arr->elements[arr->count] = map;
-	arr->count += 1;
+	if ((table->count + 1) * 2 > table->capacity)
+	{
+		oldElements = table->elements;
+		oldCapacity = table->capacity;
+
+		table->capacity = (oldCapacity == 0) ?
+			PACKEDSTATE_INITIAL_CAPACITY :
+			oldCapacity * 2;
+		table->elements = (PackedStateMap*) SDL_calloc(
+			table->capacity,
+			sizeof(PackedStateMap)
+		);
+
+		for (i = 0; i < oldCapacity; i += 1)
+		{
+			if (oldElements[i].value != NULL)
+			{
+				PackedStateHashTable_INTERNAL_Place(
+					table->elements,
+					(uint32_t) table->capacity - 1,
+					oldElements[i].key,
+					oldElements[i].value
+				);
+			}
+		}
+		SDL_free(oldElements);
+	}
+
+	PackedStateHashTable_INTERNAL_Place(
+		table->elements,
+		(uint32_t) table->capacity - 1,
+		key,
+		value
+	);
+	table->count += 1;
 }
 
+#undef PACKEDSTATE_INITIAL_CAPACITY
+
 /* Vertex Buffer Bindings */
 
 static inline uint32_t GetPackedVertexElement(FNA3D_VertexElement element)
@@ -186,59 +267,245 @@ static inline uint32_t GetPackedVertexElement(FNA3D_VertexElement element)
 	);
 }
 
+/* The algorithm for these hashing functions
+ * is taken from Josh Bloch's "Effective Java".
+ * (https://stackoverflow.com/a/113600/12492383)
+ */
+#define HASH_FACTOR 37
+
+static uint32_t HashVertexDeclaration(FNA3D_VertexDeclaration *declaration)
+{
+	int32_t i;
+	uint32_t hash = declaration->elementCount;
+
+	for (i = 0; i < declaration->elementCount; i += 1)
+	{
+		hash = hash * HASH_FACTOR + GetPackedVertexElement(
+			declaration->elements[i]
+		);
+	}
+	hash = hash * HASH_FACTOR + declaration->vertexStride;
+
+	return hash;
+}
+
 static uint32_t HashVertexBufferBindings(
+	PackedVertexBufferBindingsArray *arr,
 	FNA3D_VertexBufferBinding *bindings,
-	int32_t numBindings
+	int32_t numBindings,
+	uint8_t useDeclarationHashes
 ) {
-	int32_t i, j;
+	int32_t i;
 	uint32_t hash = numBindings;
+	FNA3D_VertexDeclaration *declaration;
+	PackedVertexDeclarationHash *memo;
 
-	/* The algorithm for this hashing function
-	 * is taken from Josh Bloch's "Effective Java".
-	 * (https://stackoverflow.com/a/113600/12492383)
-	 */
-	const uint32_t HASH_FACTOR = 37;
 	for (i = 0; i < numBindings; i += 1)
 	{
-		for (j = 0; j < bindings[i].vertexDeclaration.elementCount; j += 1)
+		declaration = &bindings[i].vertexDeclaration;
+		memo = &arr->declarationHashes[
+			((size_t) declaration->elements >> 4) %
+			VERTEX_DECLARATION_HASH_CACHE_SIZE
+		];
+		if (	!useDeclarationHashes ||
+			memo->elements != declaration->elements ||
+			memo->elementCount != declaration->elementCount ||
+			memo->vertexStride != declaration->vertexStride	)
 		{
-			hash = hash * HASH_FACTOR + GetPackedVertexElement(
-				bindings[i].vertexDeclaration.elements[j]
-			);
+			memo->elements = declaration->elements;
+			memo->elementCount = declaration->elementCount;
+			memo->vertexStride = declaration->vertexStride;
+			memo->hash = HashVertexDeclaration(declaration);
 		}
-		hash = hash * HASH_FACTOR + bindings[i].vertexDeclaration.vertexStride;
+		hash = hash * HASH_FACTOR + memo->hash;
 		hash = hash * HASH_FACTOR + bindings[i].instanceFrequency;
 	}
 
 	return hash;
 }
 
+#undef HASH_FACTOR
+
+static inline uint32_t VertexBufferBindings_BucketHash(
+	uint32_t hash,
+	void* vertexShader
+) {
+	uint64_t h = ((uint64_t) (size_t) vertexShader) ^ hash;
+	h *= 0x9E3779B97F4A7C15ULL;
+	return (uint32_t) (h >> 32);
+}
+
+static uint8_t VertexBufferBindings_Equals(
+	const PackedVertexBufferBindings *key,
+	FNA3D_VertexBufferBinding *bindings,
+	int32_t numBindings
+) {
+	int32_t i, j;
+	const uint32_t *packed = key->packedElements;
+	FNA3D_VertexDeclaration *declaration;
+
+	if (key->numBindings != numBindings)
+	{
+		return 0;
+	}
+
+	for (i = 0; i < numBindings; i += 1)
+	{
+		declaration = &bindings[i].vertexDeclaration;
+		if (	packed[0] != (uint32_t) declaration->elementCount ||
+			packed[1] != (uint32_t) declaration->vertexStride ||
+			packed[2] != (uint32_t) bindings[i].instanceFrequency	)
+		{
+			return 0;
+		}
+		packed += 3;
+		for (j = 0; j < declaration->elementCount; j += 1)
+		{
+			if (packed[j] != GetPackedVertexElement(declaration->elements[j]))
+			{
+				return 0;
+			}
+		}
+		packed += declaration->elementCount;
+	}
+
+	return 1;
+}
+
+static int32_t PackedVertexBufferBindingsArray_INTERNAL_Lookup(
+	PackedVertexBufferBindingsArray *arr,
+	FNA3D_VertexBufferBinding *bindings,
+	int32_t numBindings,
+	void* vertexShader,
+	uint32_t hash
+) {
+	uint32_t mask, i;
+	int32_t index;
+	const PackedVertexBufferBindings *key;
+
+	if (arr->bucketCapacity == 0)
+	{
+		return -1;
+	}
+
+	mask = (uint32_t) arr->bucketCapacity - 1;
+	i = VertexBufferBindings_BucketHash(hash, vertexShader) & mask;
+	while ((index = arr->buckets[i]) >= 0)
+	{
+		key = &arr->elements[index].key;
+		if (	key->vertexShader == vertexShader &&
+			key->hash == hash &&
+			VertexBufferBindings_Equals(key, bindings, numBindings)	)
+		{
+			return index;
+		}
+		i = (i + 1) & mask;
+	}
+
+	return -1;
+}
+
+static void PackedVertexBufferBindingsArray_INTERNAL_Rebuild(
+	PackedVertexBufferBindingsArray *arr
+) {
+	int32_t index;
+	uint32_t mask, i;
+	const PackedVertexBufferBindings *key;
+
+	if (arr->count == 0 && arr->bucketCapacity == 0)
+	{
+		return;
+	}
+
+	/* Keep the index at most half full */
+	if (arr->bucketCapacity < arr->count * 2)
+	{
+		if (arr->bucketCapacity == 0)
+		{
+			arr->bucketCapacity = 16;
+		}
+		while (arr->bucketCapacity < arr->count * 2)
+		{
+			arr->bucketCapacity *= 2;
+		}
+		arr->buckets = (int32_t*) SDL_realloc(
+			arr->buckets,
+			arr->bucketCapacity * sizeof(int32_t)
+		);
+	}
+	SDL_memset(arr->buckets, 0xFF, arr->bucketCapacity * sizeof(int32_t));
+
+	mask = (uint32_t) arr->bucketCapacity - 1;
+	for (index = 0; index < arr->count; index += 1)
+	{
+		key = &arr->elements[index].key;
+		i = VertexBufferBindings_BucketHash(key->hash, key->vertexShader) & mask;
+		while (arr->buckets[i] >= 0)
+		{
+			i = (i + 1) & mask;
+		}
+		arr->buckets[i] = index;
+	}
+}
+
 void* PackedVertexBufferBindingsArray_Fetch(
-	PackedVertexBufferBindingsArray arr,
+	PackedVertexBufferBindingsArray *arr,
 	FNA3D_VertexBufferBinding *bindings,
 	int32_t numBindings,
 	void* vertexShader,
 	int32_t *outIndex,
 	uint32_t *outHash
 ) {
-	int32_t i;
-	PackedVertexBufferBindings other;
-	uint32_t hash = HashVertexBufferBindings(bindings, numBindings);
-	void* result = NULL;
+	int32_t index;
+	uint32_t trueHash;
+	uint32_t hash = HashVertexBufferBindings(
+		arr,
+		bindings,
+		numBindings,
+		1
+	);
+
+	index = PackedVertexBufferBindingsArray_INTERNAL_Lookup(
+		arr,
+		bindings,
+		numBindings,
+		vertexShader,
+		hash
+	);
 
-	for (i = 0; i < arr.count; i += 1)
+	if (index < 0)
 	{
-		other = arr.elements[i].key;
-		if (vertexShader == other.vertexShader && hash == other.hash)
+		/* A remembered declaration hash can only be stale if the
+		 * declaration's memory was reused, which at worst causes a
+		 * miss here. Rehash everything before we commit to one.
+		 */
+		trueHash = HashVertexBufferBindings(
+			arr,
+			bindings,
+			numBindings,
+			0
+		);
+		if (trueHash != hash)
 		{
-			result = arr.elements[i].value;
-			break;
+			hash = trueHash;
+			index = PackedVertexBufferBindingsArray_INTERNAL_Lookup(
+				arr,
+				bindings,
+				numBindings,
+				vertexShader,
+				hash
+			);
 		}
 	}
 
-	*outIndex = i;
 	*outHash = hash;
-	return result;
+	if (index < 0)
+	{
+		*outIndex = arr->count;
+		return NULL;
+	}
+	*outIndex = index;
+	return arr->elements[index].value;
 }
 
 void PackedVertexBufferBindingsArray_Insert(
@@ -246,18 +513,103 @@ void PackedVertexBufferBindingsArray_Insert(
 	FNA3D_VertexBufferBinding *bindings,
 	int32_t numBindings,
 	void* vertexShader,
+	uint32_t hash,
 	void* value
 ) {
 	PackedVertexBufferBindingsMap map;
+	FNA3D_VertexDeclaration *declaration;
+	uint32_t mask, slot;
+	int32_t i, j, k;
 
 	EXPAND_ARRAY_IF_NEEDED(arr, 4, PackedVertexBufferBindingsMap)
 
 	map.key.vertexShader = vertexShader;
-	map.key.hash = HashVertexBufferBindings(bindings, numBindings);
+	map.key.hash = hash;
+	map.key.numBindings = numBindings;
+	map.key.packedElementCount = 0;
+	for (i = 0; i < numBindings; i += 1)
+	{
+		map.key.packedElementCount += 3 + bindings[i].vertexDeclaration.elementCount;
+	}
+	map.key.packedElements = (uint32_t*) SDL_malloc(
+		SDL_max(1, map.key.packedElementCount) * sizeof(uint32_t)
+	);
+	k = 0;
+	for (i = 0; i < numBindings; i += 1)
+	{
+		declaration = &bindings[i].vertexDeclaration;
+		map.key.packedElements[k + 0] = (uint32_t) declaration->elementCount;
+		map.key.packedElements[k + 1] = (uint32_t) declaration->vertexStride;
+		map.key.packedElements[k + 2] = (uint32_t) bindings[i].instanceFrequency;
+		k += 3;
+		for (j = 0; j < declaration->elementCount; j += 1)
+		{
+			map.key.packedElements[k] = GetPackedVertexElement(
+				declaration->elements[j]
+			);
+			k += 1;
+		}
+	}
 	map.value = value;
 
 	arr->elements[arr->count] = map;
 	arr->count += 1;
+
+	if (arr->count * 2 > arr->bucketCapacity)
+	{
+		PackedVertexBufferBindingsArray_INTERNAL_Rebuild(arr);
+	}
+	else
+	{
+		mask = (uint32_t) arr->bucketCapacity - 1;
+		slot = VertexBufferBindings_BucketHash(hash, vertexShader) & mask;
+		while (arr->buckets[slot] >= 0)
+		{
+			slot = (slot + 1) & mask;
+		}
+		arr->buckets[slot] = arr->count - 1;
+	}
+}
+
+void PackedVertexBufferBindingsArray_RemoveShader(
+	PackedVertexBufferBindingsArray *arr,
+	void* vertexShader
+) {
+	int32_t i, kept = 0;
+
+	for (i = 0; i < arr->count; i += 1)
+	{
+		if (arr->elements[i].key.vertexShader == vertexShader)
+		{
+			SDL_free(arr->elements[i].key.packedElements);
+		}
+		else
+		{
+			arr->elements[kept++] = arr->elements[i];
+		}
+	}
+	if (kept == arr->count)
+	{
+		return;
+	}
+	arr->count = kept;
+
+	/* Surviving entries may have moved, so the whole index is stale */
+	PackedVertexBufferBindingsArray_INTERNAL_Rebuild(arr);
+}
+
+void PackedVertexBufferBindingsArray_Destroy(
+	PackedVertexBufferBindingsArray *arr
+) {
+	int32_t i;
+
+	for (i = 0; i < arr->count; i += 1)
+	{
+		SDL_free(arr->elements[i].key.packedElements);
+	}
+	SDL_free(arr->elements);
+	SDL_free(arr->buckets);
+	SDL_zerop(arr);
 }
 
 /* vim: set noexpandtab shiftwidth=8 tabstop=8: */
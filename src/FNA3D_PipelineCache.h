@@ -43,26 +43,48 @@ typedef struct PackedStateMap
 	void* value;
 } PackedStateMap;
 
-typedef struct PackedStateArray
+/* Open-addressing hash table with linear probing, keyed on PackedState.
+ * A slot with a NULL value is empty, so NULL values cannot be inserted.
+ * Entries are never removed; drivers release the values at device destroy
+ * by walking every slot and skipping the empty ones.
+ */
+typedef struct PackedStateHashTable
 {
 	PackedStateMap *elements;
 	int32_t count;
-	int32_t capacity;
-} PackedStateArray;
+	int32_t capacity; /* 0 or a power of two */
+} PackedStateHashTable;
 
 FNA3D_SHAREDINTERNAL PackedState GetPackedBlendState(FNA3D_BlendState blendState);
 FNA3D_SHAREDINTERNAL PackedState GetPackedDepthStencilState(FNA3D_DepthStencilState dsState);
 FNA3D_SHAREDINTERNAL PackedState GetPackedRasterizerState(FNA3D_RasterizerState rastState, float bias);
 FNA3D_SHAREDINTERNAL PackedState GetPackedSamplerState(FNA3D_SamplerState samplerState);
-FNA3D_SHAREDINTERNAL void* PackedStateArray_Fetch(PackedStateArray arr, PackedState key);
-FNA3D_SHAREDINTERNAL void PackedStateArray_Insert(PackedStateArray *arr, PackedState key, void* value);
+FNA3D_SHAREDINTERNAL void* PackedStateHashTable_Fetch(
+	const PackedStateHashTable *table,
+	PackedState key
+);
+FNA3D_SHAREDINTERNAL void PackedStateHashTable_Insert(
+	PackedStateHashTable *table,
+	PackedState key,
+	void* value
+);
 
 /* Vertex Buffer Bindings */
 
+/* The full binding layout is kept alongside the hash, so a hash collision
+ * can never hand back the wrong value. packedElements holds, for each
+ * binding, the element count, vertex stride and instance frequency followed
+ * by each element packed into 32 bits. Every hash hit compares all of them,
+ * since a remembered declaration hash may belong to a freed array whose
+ * address was reused (see PackedVertexDeclarationHash).
+ */
 typedef struct PackedVertexBufferBindings
 {
 	void* vertexShader;
 	uint32_t hash;
+	int32_t numBindings;
+	int32_t packedElementCount;
+	uint32_t *packedElements;
 } PackedVertexBufferBindings;
 
 typedef struct PackedVertexBufferBindingsMap
@@ -71,16 +93,39 @@ typedef struct PackedVertexBufferBindingsMap
 	void* value;
 } PackedVertexBufferBindingsMap;
 
+/* FNA keeps each VertexDeclaration's element array pinned for the lifetime of
+ * the declaration, so the array pointer identifies the declaration and we can
+ * remember its hash instead of rehashing every element on every draw.
+ */
+typedef struct PackedVertexDeclarationHash
+{
+	FNA3D_VertexElement *elements;
+	int32_t elementCount;
+	int32_t vertexStride;
+	uint32_t hash;
+} PackedVertexDeclarationHash;
+
+#define VERTEX_DECLARATION_HASH_CACHE_SIZE 64
+
+/* Entries live in a dense array so that their indices stay stable as the
+ * cache grows; `buckets` is an open-addressing index into that array.
+ */
 /* FIXME: Can we make this common to both packed and vertex structs? */
 typedef struct VertexBufferBindingsArray
 {
 	PackedVertexBufferBindingsMap *elements;
 	int32_t count;
 	int32_t capacity;
+	int32_t *buckets; /* -1 for empty slots */
+	int32_t bucketCapacity; /* 0 or a power of two */
+	PackedVertexDeclarationHash declarationHashes[VERTEX_DECLARATION_HASH_CACHE_SIZE];
 } PackedVertexBufferBindingsArray;
 
+/* On a miss, outIndex is the index the next Insert will use and outHash is
+ * the hash that should be passed to it.
+ */
 FNA3D_SHAREDINTERNAL void* PackedVertexBufferBindingsArray_Fetch(
-	PackedVertexBufferBindingsArray arr,
+	PackedVertexBufferBindingsArray *arr,
 	FNA3D_VertexBufferBinding *bindings,
 	int32_t numBindings,
 	void* vertexShader,
@@ -92,8 +137,18 @@ FNA3D_SHAREDINTERNAL void PackedVertexBufferBindingsArray_Insert(
 	FNA3D_VertexBufferBinding *bindings,
 	int32_t numBindings,
 	void* vertexShader,
+	uint32_t hash,
 	void* value
 );
+/* Drops every entry keyed on vertexShader. This does NOT release the values! */
+FNA3D_SHAREDINTERNAL void PackedVertexBufferBindingsArray_RemoveShader(
+	PackedVertexBufferBindingsArray *arr,
+	void* vertexShader
+);
+/* Values must be released by the caller beforehand */
+FNA3D_SHAREDINTERNAL void PackedVertexBufferBindingsArray_Destroy(
+	PackedVertexBufferBindingsArray *arr
+);
 
 /* Macros */
 
@@ -0,0 +1,710 @@
+/* FNA3D - 3D Graphics Library for FNA
+ *
+ * Copyright (c) 2020-2024 Ethan Lee
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from
+ * the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ * claim that you wrote the original software. If you use this software in a
+ * product, an acknowledgment in the product documentation would be
+ * appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ * misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ * Ethan "flibitijibibo" Lee <flibitijibibo@flibitijibibo.com>
+ *
+ */
+
+#include "FNA3D_PipelineManifest.h"
+
+#ifdef USE_SDL3
+#include <SDL3/SDL.h>
+#else
+#include <SDL.h>
+#define SDL_Mutex SDL_mutex
+#define SDL_Condition SDL_cond
+#define SDL_CreateCondition SDL_CreateCond
+#define SDL_DestroyCondition SDL_DestroyCond
+#define SDL_WaitCondition SDL_CondWait
+#define SDL_SignalCondition SDL_CondSignal
+#endif
+
+/* Reading */
+
+typedef struct ManifestReader
+{
+	const uint8_t *data;
+	uint32_t length;
+	uint32_t offset;
+	uint8_t failed;
+} ManifestReader;
+
+static void ReadBytes(ManifestReader *reader, void *dst, uint32_t size)
+{
+	if (reader->failed || reader->length - reader->offset < size)
+	{
+		reader->failed = 1;
+		SDL_memset(dst, '\0', size);
+		return;
+	}
+	SDL_memcpy(dst, reader->data + reader->offset, size);
+	reader->offset += size;
+}
+
+static inline uint8_t ReadU8(ManifestReader *reader)
+{
+	uint8_t result;
+	ReadBytes(reader, &result, sizeof(result));
+	return result;
+}
+
+static inline uint16_t ReadU16(ManifestReader *reader)
+{
+	uint16_t result;
+	ReadBytes(reader, &result, sizeof(result));
+	return result;
+}
+
+static inline uint32_t ReadU32(ManifestReader *reader)
+{
+	uint32_t result;
+	ReadBytes(reader, &result, sizeof(result));
+	return result;
+}
+
+static inline int32_t ReadS32(ManifestReader *reader)
+{
+	int32_t result;
+	ReadBytes(reader, &result, sizeof(result));
+	return result;
+}
+
+static inline float ReadF32(ManifestReader *reader)
+{
+	float result;
+	ReadBytes(reader, &result, sizeof(result));
+	return result;
+}
+
+/* Drivers index translation tables with these, so one bad value rejects the
+ * whole file rather than reading past the end of a table later
+ */
+static inline uint8_t ReadEnum(ManifestReader *reader, uint8_t max)
+{
+	uint8_t result = ReadU8(reader);
+	if (result > max)
+	{
+		reader->failed = 1;
+		return 0;
+	}
+	return result;
+}
+
+/* Fills everything but the bindings, returns the binding count */
+static int32_t ReadEntry(
+	ManifestReader *reader,
+	FNA3D_PipelineManifestEntry *entry
+) {
+	FNA3D_BlendState *blend = &entry->blendState;
+	FNA3D_DepthStencilState *ds = &entry->depthStencilState;
+	FNA3D_RasterizerState *rs = &entry->rasterizerState;
+	int32_t i;
+
+	SDL_zerop(entry);
+	entry->effectHash = ReadU32(reader);
+	entry->vertexShaderObject = ReadU16(reader);
+	entry->pixelShaderObject = ReadU16(reader);
+
+	blend->colorSourceBlend = (FNA3D_Blend) ReadEnum(reader, FNA3D_BLEND_SOURCEALPHASATURATION);
+	blend->colorDestinationBlend = (FNA3D_Blend) ReadEnum(reader, FNA3D_BLEND_SOURCEALPHASATURATION);
+	blend->colorBlendFunction = (FNA3D_BlendFunction) ReadEnum(reader, FNA3D_BLENDFUNCTION_MIN);
+	blend->alphaSourceBlend = (FNA3D_Blend) ReadEnum(reader, FNA3D_BLEND_SOURCEALPHASATURATION);
+	blend->alphaDestinationBlend = (FNA3D_Blend) ReadEnum(reader, FNA3D_BLEND_SOURCEALPHASATURATION);
+	blend->alphaBlendFunction = (FNA3D_BlendFunction) ReadEnum(reader, FNA3D_BLENDFUNCTION_MIN);
+	blend->colorWriteEnable = (FNA3D_ColorWriteChannels) ReadEnum(reader, FNA3D_COLORWRITECHANNELS_ALL);
+	blend->colorWriteEnable1 = (FNA3D_ColorWriteChannels) ReadEnum(reader, FNA3D_COLORWRITECHANNELS_ALL);
+	blend->colorWriteEnable2 = (FNA3D_ColorWriteChannels) ReadEnum(reader, FNA3D_COLORWRITECHANNELS_ALL);
+	blend->colorWriteEnable3 = (FNA3D_ColorWriteChannels) ReadEnum(reader, FNA3D_COLORWRITECHANNELS_ALL);
+	blend->blendFactor.r = ReadU8(reader);
+	blend->blendFactor.g = ReadU8(reader);
+	blend->blendFactor.b = ReadU8(reader);
+	blend->blendFactor.a = ReadU8(reader);
+	blend->multiSampleMask = ReadS32(reader);
+
+	ds->depthBufferEnable = ReadU8(reader);
+	ds->depthBufferWriteEnable = ReadU8(reader);
+	ds->depthBufferFunction = (FNA3D_CompareFunction) ReadEnum(reader, FNA3D_COMPAREFUNCTION_NOTEQUAL);
+	ds->stencilEnable = ReadU8(reader);
+	ds->stencilMask = ReadS32(reader);
+	ds->stencilWriteMask = ReadS32(reader);
+	ds->twoSidedStencilMode = ReadU8(reader);
+	ds->stencilFail = (FNA3D_StencilOperation) ReadEnum(reader, FNA3D_STENCILOPERATION_INVERT);
+	ds->stencilDepthBufferFail = (FNA3D_StencilOperation) ReadEnum(reader, FNA3D_STENCILOPERATION_INVERT);
+	ds->stencilPass = (FNA3D_StencilOperation) ReadEnum(reader, FNA3D_STENCILOPERATION_INVERT);
+	ds->stencilFunction = (FNA3D_CompareFunction) ReadEnum(reader, FNA3D_COMPAREFUNCTION_NOTEQUAL);
+	ds->ccwStencilFail = (FNA3D_StencilOperation) ReadEnum(reader, FNA3D_STENCILOPERATION_INVERT);
+	ds->ccwStencilDepthBufferFail = (FNA3D_StencilOperation) ReadEnum(reader, FNA3D_STENCILOPERATION_INVERT);
+	ds->ccwStencilPass = (FNA3D_StencilOperation) ReadEnum(reader, FNA3D_STENCILOPERATION_INVERT);
+	ds->ccwStencilFunction = (FNA3D_CompareFunction) ReadEnum(reader, FNA3D_COMPAREFUNCTION_NOTEQUAL);
+	ds->referenceStencil = ReadS32(reader);
+
+	rs->fillMode = (FNA3D_FillMode) ReadEnum(reader, FNA3D_FILLMODE_WIREFRAME);
+	rs->cullMode = (FNA3D_CullMode) ReadEnum(reader, FNA3D_CULLMODE_CULLCOUNTERCLOCKWISEFACE);
+	rs->depthBias = ReadF32(reader);
+	rs->slopeScaleDepthBias = ReadF32(reader);
+	rs->scissorTestEnable = ReadU8(reader);
+	rs->multiSampleAntiAlias = ReadU8(reader);
+
+	entry->multiSampleMask = ReadS32(reader);
+	entry->primitiveType = (FNA3D_PrimitiveType) ReadEnum(reader, FNA3D_PRIMITIVETYPE_POINTLIST_EXT);
+	entry->multiSampleCount = ReadU8(reader);
+	entry->depthFormat = (FNA3D_DepthFormat) ReadEnum(reader, FNA3D_DEPTHFORMAT_D24S8);
+	entry->colorFormatCount = ReadU8(reader);
+	if (entry->colorFormatCount > MAX_RENDERTARGET_BINDINGS)
+	{
+		reader->failed = 1;
+		return 0;
+	}
+	for (i = 0; i < entry->colorFormatCount; i += 1)
+	{
+		entry->colorFormats[i] = (FNA3D_SurfaceFormat) ReadEnum(reader, FNA3D_SURFACEFORMAT_BC7SRGB_EXT);
+	}
+
+	entry->numBindings = ReadU8(reader);
+	if (entry->numBindings > MAX_BOUND_VERTEX_BUFFERS)
+	{
+		reader->failed = 1;
+		return 0;
+	}
+	return entry->numBindings;
+}
+
+/* Fills one binding, elements may be NULL to only count them */
+static int32_t ReadBinding(
+	ManifestReader *reader,
+	FNA3D_VertexBufferBinding *binding,
+	FNA3D_VertexElement *elements
+) {
+	FNA3D_VertexElement element;
+	int32_t i, vertexStride, instanceFrequency, elementCount;
+
+	vertexStride = ReadS32(reader);
+	instanceFrequency = ReadU8(reader);
+	elementCount = ReadU8(reader);
+	if (elementCount > MAX_VERTEX_ATTRIBUTES)
+	{
+		reader->failed = 1;
+		return 0;
+	}
+
+	for (i = 0; i < elementCount; i += 1)
+	{
+		element.offset = ReadS32(reader);
+		element.vertexElementFormat = (FNA3D_VertexElementFormat) ReadEnum(reader, FNA3D_VERTEXELEMENTFORMAT_HALFVECTOR4);
+		element.vertexElementUsage = (FNA3D_VertexElementUsage) ReadEnum(reader, FNA3D_VERTEXELEMENTUSAGE_TESSELATEFACTOR);
+		element.usageIndex = ReadU8(reader);
+		if (elements != NULL)
+		{
+			elements[i] = element;
+		}
+	}
+
+	if (binding != NULL)
+	{
+		binding->vertexBuffer = NULL;
+		binding->vertexDeclaration.vertexStride = vertexStride;
+		binding->vertexDeclaration.elementCount = elementCount;
+		binding->vertexDeclaration.elements = elements;
+		binding->vertexOffset = 0;
+		binding->instanceFrequency = instanceFrequency;
+	}
+	return elementCount;
+}
+
+static int EntryCompare(const void *a, const void *b)
+{
+	const FNA3D_PipelineManifestEntry *ea = (const FNA3D_PipelineManifestEntry*) a;
+	const FNA3D_PipelineManifestEntry *eb = (const FNA3D_PipelineManifestEntry*) b;
+	if (ea->effectHash < eb->effectHash)
+	{
+		return -1;
+	}
+	return (ea->effectHash > eb->effectHash);
+}
+
+FNA3D_PipelineManifest* FNA3D_PipelineManifest_Parse(
+	const uint8_t *data,
+	uint32_t dataLength
+) {
+	ManifestReader reader;
+	FNA3D_PipelineManifest *manifest;
+	FNA3D_PipelineManifestEntry scratch, *entry;
+	uint32_t entryCount, entriesStart, i;
+	int32_t j, numBindings, totalBindings, totalElements;
+
+	reader.data = data;
+	reader.length = dataLength;
+	reader.offset = 0;
+	reader.failed = 0;
+
+	if (	data == NULL ||
+		ReadU32(&reader) != FNA3D_PIPELINEMANIFEST_MAGIC ||
+		ReadU32(&reader) != FNA3D_PIPELINEMANIFEST_VERSION	)
+	{
+		return NULL;
+	}
+	entryCount = ReadU32(&reader);
+	entriesStart = reader.offset;
+
+	/* First pass validates the whole file and sizes the arrays */
+	totalBindings = 0;
+	totalElements = 0;
+	for (i = 0; i < entryCount && !reader.failed; i += 1)
+	{
+		numBindings = ReadEntry(&reader, &scratch);
+		totalBindings += numBindings;
+		for (j = 0; j < numBindings; j += 1)
+		{
+			totalElements += ReadBinding(&reader, NULL, NULL);
+		}
+	}
+	if (reader.failed)
+	{
+		return NULL;
+	}
+
+	manifest = (FNA3D_PipelineManifest*) SDL_malloc(
+		sizeof(FNA3D_PipelineManifest)
+	);
+	manifest->entryCount = (int32_t) entryCount;
+	manifest->entries = (FNA3D_PipelineManifestEntry*) SDL_malloc(
+		sizeof(FNA3D_PipelineManifestEntry) * SDL_max(entryCount, 1)
+	);
+	manifest->bindings = (FNA3D_VertexBufferBinding*) SDL_malloc(
+		sizeof(FNA3D_VertexBufferBinding) * SDL_max(totalBindings, 1)
+	);
+	manifest->elements = (FNA3D_VertexElement*) SDL_malloc(
+		sizeof(FNA3D_VertexElement) * SDL_max(totalElements, 1)
+	);
+
+	/* Second pass can't fail, it reads exactly what the first one did */
+	reader.offset = entriesStart;
+	totalBindings = 0;
+	totalElements = 0;
+	for (i = 0; i < entryCount; i += 1)
+	{
+		entry = &manifest->entries[i];
+		numBindings = ReadEntry(&reader, entry);
+		entry->bindings = &manifest->bindings[totalBindings];
+		for (j = 0; j < numBindings; j += 1)
+		{
+			totalElements += ReadBinding(
+				&reader,
+				&manifest->bindings[totalBindings + j],
+				&manifest->elements[totalElements]
+			);
+		}
+		totalBindings += numBindings;
+	}
+
+	SDL_qsort(
+		manifest->entries,
+		entryCount,
+		sizeof(FNA3D_PipelineManifestEntry),
+		EntryCompare
+	);
+	return manifest;
+}
+
+void FNA3D_PipelineManifest_Destroy(FNA3D_PipelineManifest *manifest)
+{
+	if (manifest == NULL)
+	{
+		return;
+	}
+	SDL_free(manifest->entries);
+	SDL_free(manifest->bindings);
+	SDL_free(manifest->elements);
+	SDL_free(manifest);
+}
+
+int32_t FNA3D_PipelineManifest_FindEffect(
+	FNA3D_PipelineManifest *manifest,
+	const uint8_t *effectCode,
+	uint32_t effectCodeLength,
+	FNA3D_PipelineManifestEntry **first
+) {
+	uint32_t hash;
+	int32_t lo, hi, mid, count;
+
+	*first = NULL;
+	if (manifest == NULL || manifest->entryCount == 0)
+	{
+		return 0;
+	}
+
+	hash = SDL_crc32(0, effectCode, effectCodeLength);
+
+	/* Lower bound, then walk the run of matching entries */
+	lo = 0;
+	hi = manifest->entryCount;
+	while (lo < hi)
+	{
+		mid = lo + ((hi - lo) / 2);
+		if (manifest->entries[mid].effectHash < hash)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+
+	count = 0;
+	while (	lo + count < manifest->entryCount &&
+		manifest->entries[lo + count].effectHash == hash	)
+	{
+		count += 1;
+	}
+	if (count > 0)
+	{
+		*first = &manifest->entries[lo];
+	}
+	return count;
+}
+
+/* Writing */
+
+static void WriteBytes(
+	const void *src,
+	uint32_t size,
+	uint8_t **buffer,
+	uint32_t *length,
+	uint32_t *capacity
+) {
+	if (*length + size > *capacity)
+	{
+		*capacity = SDL_max(*capacity * 2, *length + size);
+		*buffer = (uint8_t*) SDL_realloc(*buffer, *capacity);
+	}
+	SDL_memcpy(*buffer + *length, src, size);
+	*length += size;
+}
+
+#define WRITE_U8(val) \
+	{ \
+		uint8_t v = (uint8_t) (val); \
+		WriteBytes(&v, sizeof(v), buffer, length, capacity); \
+	}
+#define WRITE_U16(val) \
+	{ \
+		uint16_t v = (uint16_t) (val); \
+		WriteBytes(&v, sizeof(v), buffer, length, capacity); \
+	}
+#define WRITE_32(val) \
+	WriteBytes(&(val), 4, buffer, length, capacity);
+
+void FNA3D_PipelineManifest_WriteEntry(
+	const FNA3D_PipelineManifestEntry *entry,
+	uint8_t **buffer,
+	uint32_t *length,
+	uint32_t *capacity
+) {
+	const FNA3D_BlendState *blend = &entry->blendState;
+	const FNA3D_DepthStencilState *ds = &entry->depthStencilState;
+	const FNA3D_RasterizerState *rs = &entry->rasterizerState;
+	const FNA3D_VertexDeclaration *decl;
+	int32_t i, j;
+
+	WRITE_32(entry->effectHash)
+	WRITE_U16(entry->vertexShaderObject)
+	WRITE_U16(entry->pixelShaderObject)
+
+	WRITE_U8(blend->colorSourceBlend)
+	WRITE_U8(blend->colorDestinationBlend)
+	WRITE_U8(blend->colorBlendFunction)
+	WRITE_U8(blend->alphaSourceBlend)
+	WRITE_U8(blend->alphaDestinationBlend)
+	WRITE_U8(blend->alphaBlendFunction)
+	WRITE_U8(blend->colorWriteEnable)
+	WRITE_U8(blend->colorWriteEnable1)
+	WRITE_U8(blend->colorWriteEnable2)
+	WRITE_U8(blend->colorWriteEnable3)
+	WRITE_U8(blend->blendFactor.r)
+	WRITE_U8(blend->blendFactor.g)
+	WRITE_U8(blend->blendFactor.b)
+	WRITE_U8(blend->blendFactor.a)
+	WRITE_32(blend->multiSampleMask)
+
+	WRITE_U8(ds->depthBufferEnable)
+	WRITE_U8(ds->depthBufferWriteEnable)
+	WRITE_U8(ds->depthBufferFunction)
+	WRITE_U8(ds->stencilEnable)
+	WRITE_32(ds->stencilMask)
+	WRITE_32(ds->stencilWriteMask)
+	WRITE_U8(ds->twoSidedStencilMode)
+	WRITE_U8(ds->stencilFail)
+	WRITE_U8(ds->stencilDepthBufferFail)
+	WRITE_U8(ds->stencilPass)
+	WRITE_U8(ds->stencilFunction)
+	WRITE_U8(ds->ccwStencilFail)
+	WRITE_U8(ds->ccwStencilDepthBufferFail)
+	WRITE_U8(ds->ccwStencilPass)
+	WRITE_U8(ds->ccwStencilFunction)
+	WRITE_32(ds->referenceStencil)
+
+	WRITE_U8(rs->fillMode)
+	WRITE_U8(rs->cullMode)
+	WRITE_32(rs->depthBias)
+	WRITE_32(rs->slopeScaleDepthBias)
+	WRITE_U8(rs->scissorTestEnable)
+	WRITE_U8(rs->multiSampleAntiAlias)
+
+	WRITE_32(entry->multiSampleMask)
+	WRITE_U8(entry->primitiveType)
+	WRITE_U8(entry->multiSampleCount)
+	WRITE_U8(entry->depthFormat)
+	WRITE_U8(entry->colorFormatCount)
+	for (i = 0; i < entry->colorFormatCount; i += 1)
+	{
+		WRITE_U8(entry->colorFormats[i])
+	}
+
+	WRITE_U8(entry->numBindings)
+	for (i = 0; i < entry->numBindings; i += 1)
+	{
+		decl = &entry->bindings[i].vertexDeclaration;
+		WRITE_32(decl->vertexStride)
+		WRITE_U8(entry->bindings[i].instanceFrequency)
+		WRITE_U8(decl->elementCount)
+		for (j = 0; j < decl->elementCount; j += 1)
+		{
+			WRITE_32(decl->elements[j].offset)
+			WRITE_U8(decl->elements[j].vertexElementFormat)
+			WRITE_U8(decl->elements[j].vertexElementUsage)
+			WRITE_U8(decl->elements[j].usageIndex)
+		}
+	}
+}
+
+#undef WRITE_U8
+#undef WRITE_U16
+#undef WRITE_32
+
+/* Background Pipeline Compiler */
+
+struct FNA3D_PipelineCompiler
+{
+	SDL_Thread *thread;
+	SDL_Mutex *lock;
+	SDL_Condition *wake;
+	SDL_Condition *finished;
+	FNA3D_PipelineCompileFunc compile;
+	void *userdata;
+
+	/* Protected by lock */
+	FNA3D_PipelineCompileJob *pending;
+	FNA3D_PipelineCompileJob *pendingTail;
+	FNA3D_PipelineCompileJob *done;
+	FNA3D_PipelineCompileJob *doneTail;
+	uint8_t quit;
+};
+
+static int PipelineCompilerThread(void *data)
+{
+	FNA3D_PipelineCompiler *compiler = (FNA3D_PipelineCompiler*) data;
+	FNA3D_PipelineCompileJob *job;
+
+	SDL_LockMutex(compiler->lock);
+	while (1)
+	{
+		while (compiler->pending == NULL && !compiler->quit)
+		{
+			SDL_WaitCondition(compiler->wake, compiler->lock);
+		}
+		if (compiler->pending == NULL)
+		{
+			break;
+		}
+
+		job = compiler->pending;
+		compiler->pending = job->next;
+		if (compiler->pending == NULL)
+		{
+			compiler->pendingTail = NULL;
+		}
+		SDL_UnlockMutex(compiler->lock);
+
+		compiler->compile(compiler->userdata, job);
+
+		SDL_LockMutex(compiler->lock);
+		job->next = NULL;
+		if (compiler->doneTail != NULL)
+		{
+			compiler->doneTail->next = job;
+		}
+		else
+		{
+			compiler->done = job;
+		}
+		compiler->doneTail = job;
+		SDL_SignalCondition(compiler->finished);
+	}
+	SDL_UnlockMutex(compiler->lock);
+	return 0;
+}
+
+FNA3D_PipelineCompiler* FNA3D_PipelineCompiler_Create(
+	FNA3D_PipelineCompileFunc compile,
+	void *userdata
+) {
+	FNA3D_PipelineCompiler *compiler = (FNA3D_PipelineCompiler*) SDL_malloc(
+		sizeof(FNA3D_PipelineCompiler)
+	);
+	SDL_zerop(compiler);
+	compiler->compile = compile;
+	compiler->userdata = userdata;
+	compiler->lock = SDL_CreateMutex();
+	compiler->wake = SDL_CreateCondition();
+	compiler->finished = SDL_CreateCondition();
+	compiler->thread = SDL_CreateThread(
+		PipelineCompilerThread,
+		"FNA3D Pipeline Compiler",
+		compiler
+	);
+	if (compiler->thread == NULL)
+	{
+		FNA3D_LogWarn("Could not start pipeline compiler: %s", SDL_GetError());
+		SDL_DestroyCondition(compiler->finished);
+		SDL_DestroyCondition(compiler->wake);
+		SDL_DestroyMutex(compiler->lock);
+		SDL_free(compiler);
+		return NULL;
+	}
+	return compiler;
+}
+
+FNA3D_PipelineCompileJob* FNA3D_PipelineCompiler_Destroy(
+	FNA3D_PipelineCompiler *compiler
+) {
+	FNA3D_PipelineCompileJob *result;
+
+	/* The thread drains the pending list before it honors quit */
+	SDL_LockMutex(compiler->lock);
+	compiler->quit = 1;
+	SDL_SignalCondition(compiler->wake);
+	SDL_UnlockMutex(compiler->lock);
+	SDL_WaitThread(compiler->thread, NULL);
+
+	result = compiler->done;
+	SDL_DestroyCondition(compiler->finished);
+	SDL_DestroyCondition(compiler->wake);
+	SDL_DestroyMutex(compiler->lock);
+	SDL_free(compiler);
+	return result;
+}
+
+void FNA3D_PipelineCompiler_Submit(
+	FNA3D_PipelineCompiler *compiler,
+	FNA3D_PipelineCompileJob *job,
+	uint8_t urgent
+) {
+	SDL_LockMutex(compiler->lock);
+	if (urgent)
+	{
+		job->next = compiler->pending;
+		compiler->pending = job;
+		if (compiler->pendingTail == NULL)
+		{
+			compiler->pendingTail = job;
+		}
+	}
+	else
+	{
+		job->next = NULL;
+		if (compiler->pendingTail != NULL)
+		{
+			compiler->pendingTail->next = job;
+		}
+		else
+		{
+			compiler->pending = job;
+		}
+		compiler->pendingTail = job;
+	}
+	SDL_SignalCondition(compiler->wake);
+	SDL_UnlockMutex(compiler->lock);
+}
+
+void FNA3D_PipelineCompiler_Prioritize(
+	FNA3D_PipelineCompiler *compiler,
+	FNA3D_PipelineCompileJob *job
+) {
+	FNA3D_PipelineCompileJob *prev = NULL;
+	FNA3D_PipelineCompileJob *curr;
+
+	SDL_LockMutex(compiler->lock);
+	for (curr = compiler->pending; curr != NULL; curr = curr->next)
+	{
+		if (curr == job)
+		{
+			break;
+		}
+		prev = curr;
+	}
+
+	/* Already at the front, running or finished otherwise */
+	if (curr != NULL && prev != NULL)
+	{
+		prev->next = job->next;
+		if (compiler->pendingTail == job)
+		{
+			compiler->pendingTail = prev;
+		}
+		job->next = compiler->pending;
+		compiler->pending = job;
+	}
+	SDL_UnlockMutex(compiler->lock);
+}
+
+FNA3D_PipelineCompileJob* FNA3D_PipelineCompiler_Drain(
+	FNA3D_PipelineCompiler *compiler
+) {
+	FNA3D_PipelineCompileJob *result;
+
+	SDL_LockMutex(compiler->lock);
+	result = compiler->done;
+	compiler->done = NULL;
+	compiler->doneTail = NULL;
+	SDL_UnlockMutex(compiler->lock);
+	return result;
+}
+
+FNA3D_PipelineCompileJob* FNA3D_PipelineCompiler_Wait(
+	FNA3D_PipelineCompiler *compiler
+) {
+	FNA3D_PipelineCompileJob *result;
+
+	SDL_LockMutex(compiler->lock);
+	while (compiler->done == NULL)
+	{
+		SDL_WaitCondition(compiler->finished, compiler->lock);
+	}
+	result = compiler->done;
+	compiler->done = NULL;
+	compiler->doneTail = NULL;
+	SDL_UnlockMutex(compiler->lock);
+	return result;
+}
+
+/* vim: set noexpandtab shiftwidth=8 tabstop=8: */
@@ -0,0 +1,185 @@
+/* FNA3D - 3D Graphics Library for FNA
+ *
+ * Copyright (c) 2020-2024 Ethan Lee
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from
+ * the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ * claim that you wrote the original software. If you use this software in a
+ * product, an acknowledgment in the product documentation would be
+ * appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ * misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ * Ethan "flibitijibibo" Lee <flibitijibibo@flibitijibibo.com>
+ *
+ */
+
+#ifndef FNA3D_PIPELINEMANIFEST_H
+#define FNA3D_PIPELINEMANIFEST_H
+
+#include "FNA3D_Driver.h"
+
+/* Pipeline Manifests, see FNA3D_PrewarmPipelines.
+ *
+ * A manifest lists every pipeline a trace actually drew with, as recorded by
+ * `fna3d_dumpspirv --pipelines`. Nothing in it is backend-specific: shaders
+ * are named by the CRC32 of the effect bytecode they came from plus their
+ * index in that effect's object table, and all state is kept as the FNA3D
+ * structs the game passed in. Drivers turn entries into real pipelines once
+ * the matching effect has been created.
+ *
+ * The file is a header followed by tightly packed entries, all in native
+ * byte order like the traces they come from:
+ *
+ *	uint32	magic, FNA3D_PIPELINEMANIFEST_MAGIC
+ *	uint32	version, FNA3D_PIPELINEMANIFEST_VERSION
+ *	uint32	entryCount
+ *
+ *	uint32	effectHash
+ *	uint16	vertexShaderObject, pixelShaderObject
+ *	blend state, depth/stencil state and rasterizer state, field by field in
+ *	declaration order: enums, booleans and channel masks as uint8, everything
+ *	else at its own size
+ *	int32	multiSampleMask
+ *	uint8	primitiveType, multiSampleCount, depthFormat, colorFormatCount
+ *	uint8	colorFormats[colorFormatCount]
+ *	uint8	numBindings, then for each binding:
+ *		int32	vertexStride
+ *		uint8	instanceFrequency, elementCount
+ *		then for each element:
+ *			int32	offset
+ *			uint8	vertexElementFormat, vertexElementUsage, usageIndex
+ */
+
+#define FNA3D_PIPELINEMANIFEST_MAGIC 0x4D503346 /* "F3PM" */
+#define FNA3D_PIPELINEMANIFEST_VERSION 0
+
+typedef struct FNA3D_PipelineManifestEntry
+{
+	uint32_t effectHash;
+	uint16_t vertexShaderObject;
+	uint16_t pixelShaderObject;
+
+	FNA3D_BlendState blendState;
+	FNA3D_DepthStencilState depthStencilState;
+	FNA3D_RasterizerState rasterizerState;
+	int32_t multiSampleMask;
+	FNA3D_PrimitiveType primitiveType;
+
+	/* Backbuffer draws are recorded with the backbuffer's formats */
+	int32_t colorFormatCount;
+	FNA3D_SurfaceFormat colorFormats[MAX_RENDERTARGET_BINDINGS];
+	FNA3D_DepthFormat depthFormat;
+	int32_t multiSampleCount;
+
+	/* Points into the owning manifest, vertexBuffer is always NULL */
+	FNA3D_VertexBufferBinding *bindings;
+	int32_t numBindings;
+} FNA3D_PipelineManifestEntry;
+
+/* Entries are sorted by effectHash so each effect's pipelines are adjacent.
+ * FNA3D_Driver.h refers to this as struct FNA3D_PipelineManifest.
+ */
+typedef struct FNA3D_PipelineManifest
+{
+	FNA3D_PipelineManifestEntry *entries;
+	int32_t entryCount;
+	FNA3D_VertexBufferBinding *bindings;
+	FNA3D_VertexElement *elements;
+} FNA3D_PipelineManifest;
+
+/* Returns NULL if the data is not a valid manifest */
+FNA3D_SHAREDINTERNAL FNA3D_PipelineManifest* FNA3D_PipelineManifest_Parse(
+	const uint8_t *data,
+	uint32_t dataLength
+);
+FNA3D_SHAREDINTERNAL void FNA3D_PipelineManifest_Destroy(
+	FNA3D_PipelineManifest *manifest
+);
+
+/* Finds the entries recorded for an effect, returns the number found */
+FNA3D_SHAREDINTERNAL int32_t FNA3D_PipelineManifest_FindEffect(
+	FNA3D_PipelineManifest *manifest,
+	const uint8_t *effectCode,
+	uint32_t effectCodeLength,
+	FNA3D_PipelineManifestEntry **first
+);
+
+/* Appends one serialized entry to a growable buffer, for the tools */
+FNA3D_SHAREDINTERNAL void FNA3D_PipelineManifest_WriteEntry(
+	const FNA3D_PipelineManifestEntry *entry,
+	uint8_t **buffer,
+	uint32_t *length,
+	uint32_t *capacity
+);
+
+/* Background Pipeline Compiler
+ *
+ * One worker thread, shared by every pipeline a driver wants built off the
+ * render thread. Drivers embed FNA3D_PipelineCompileJob as the first member
+ * of their own job struct, Submit it, and Drain finished jobs on the render
+ * thread where the results can be published into their pipeline tables.
+ */
+
+typedef struct FNA3D_PipelineCompileJob
+{
+	struct FNA3D_PipelineCompileJob *next;
+} FNA3D_PipelineCompileJob;
+
+/* Runs on the worker thread */
+typedef void (*FNA3D_PipelineCompileFunc)(
+	void *userdata,
+	FNA3D_PipelineCompileJob *job
+);
+
+typedef struct FNA3D_PipelineCompiler FNA3D_PipelineCompiler;
+
+/* Returns NULL if the thread could not be started */
+FNA3D_SHAREDINTERNAL FNA3D_PipelineCompiler* FNA3D_PipelineCompiler_Create(
+	FNA3D_PipelineCompileFunc compile,
+	void *userdata
+);
+
+/* Finishes every submitted job first, then returns the ones never drained */
+FNA3D_SHAREDINTERNAL FNA3D_PipelineCompileJob* FNA3D_PipelineCompiler_Destroy(
+	FNA3D_PipelineCompiler *compiler
+);
+
+/* Urgent jobs go to the front of the queue, for draws that need them now */
+FNA3D_SHAREDINTERNAL void FNA3D_PipelineCompiler_Submit(
+	FNA3D_PipelineCompiler *compiler,
+	FNA3D_PipelineCompileJob *job,
+	uint8_t urgent
+);
+
+/* Moves a job to the front of the queue if it has not been started yet */
+FNA3D_SHAREDINTERNAL void FNA3D_PipelineCompiler_Prioritize(
+	FNA3D_PipelineCompiler *compiler,
+	FNA3D_PipelineCompileJob *job
+);
+
+/* Returns the finished jobs in completion order, NULL if there are none */
+FNA3D_SHAREDINTERNAL FNA3D_PipelineCompileJob* FNA3D_PipelineCompiler_Drain(
+	FNA3D_PipelineCompiler *compiler
+);
+
+/* Same as Drain, but blocks until at least one job has finished. Only call
+ * this while a submitted job is known to be undrained!
+ */
+FNA3D_SHAREDINTERNAL FNA3D_PipelineCompileJob* FNA3D_PipelineCompiler_Wait(
+	FNA3D_PipelineCompiler *compiler
+);
+
+#endif /* FNA3D_PIPELINEMANIFEST_H */
+
+/* vim: set noexpandtab shiftwidth=8 tabstop=8: */
@@ -0,0 +1,349 @@
+/* FNA3D - 3D Graphics Library for FNA
+ *
+ * Copyright (c) 2020-2024 Ethan Lee
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from
+ * the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ * claim that you wrote the original software. If you use this software in a
+ * product, an acknowledgment in the product documentation would be
+ * appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ * misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ * Ethan "flibitijibibo" Lee <flibitijibibo@flibitijibibo.com>
+ *
+ */
+
+#include "FNA3D_Timeline.h"
+
+#ifdef USE_SDL3
+#include <SDL3/SDL.h>
+#else
+#include <SDL.h>
+#define SDL_AtomicInt SDL_atomic_t
+#define SDL_AddAtomicInt SDL_AtomicAdd
+#define SDL_GetAtomicInt SDL_AtomicGet
+#define SDL_SetAtomicInt SDL_AtomicSet
+#define SDL_GetCurrentThreadID SDL_ThreadID
+#define SDL_LockSpinlock SDL_AtomicLock
+#define SDL_UnlockSpinlock SDL_AtomicUnlock
+#define SDL_IOStream SDL_RWops
+#define SDL_IOFromFile SDL_RWFromFile
+#define SDL_WriteIO(a, b, c) SDL_RWwrite(a, b, c, 1)
+#define SDL_CloseIO SDL_RWclose
+#endif
+
+#define DEFAULT_TIMELINE_EVENTS 65536
+#define DEFAULT_TIMELINE_FRAMES 8
+#define MAX_TIMELINE_FRAMES 256
+#define DEFAULT_TIMELINE_AUTO_DUMPS 8
+
+typedef struct TimelineEvent
+{
+	uint64_t ticks;
+	uint64_t thread;
+	const char *name;
+	uint8_t begin;
+} TimelineEvent;
+
+uint8_t FNA3D_TimelineActive = 0;
+
+static TimelineEvent *timelineEvents = NULL;
+static uint32_t timelineEventMask = 0;
+static SDL_AtomicInt timelineCursor;
+
+/* Every device shares the ring, the last one to be destroyed frees it.
+ * Writers register themselves first so Quit can wait them out.
+ */
+static SDL_SpinLock timelineLock;
+static int32_t timelineRefcount = 0;
+static SDL_AtomicInt timelineLive;
+static SDL_AtomicInt timelineWriters;
+
+/* Main thread only, written by EndFrame */
+static uint32_t timelineFrameStarts[MAX_TIMELINE_FRAMES];
+static uint32_t timelineFrameCapacity = 0;
+static uint64_t timelineFrameCount = 0;
+static uint64_t timelineFrameStartTicks = 0;
+static uint64_t timelineBaseTicks = 0;
+static uint64_t timelineBudgetTicks = 0;
+static uint32_t timelineAutoDumps = 0;
+static const char *timelinePath = NULL;
+
+static inline uint8_t FNA3D_Timeline_Acquire(void)
+{
+	SDL_AddAtomicInt(&timelineWriters, 1);
+	if (SDL_GetAtomicInt(&timelineLive))
+	{
+		return 1;
+	}
+	SDL_AddAtomicInt(&timelineWriters, -1);
+	return 0;
+}
+
+static inline void FNA3D_Timeline_Release(void)
+{
+	SDL_AddAtomicInt(&timelineWriters, -1);
+}
+
+void FNA3D_Timeline_Init(void)
+{
+	const char *hint;
+	uint32_t capacity;
+
+	SDL_LockSpinlock(&timelineLock);
+	timelineRefcount += 1;
+	if (timelineRefcount > 1)
+	{
+		SDL_UnlockSpinlock(&timelineLock);
+		return;
+	}
+	SDL_UnlockSpinlock(&timelineLock);
+
+	hint = SDL_getenv("FNA3D_TIMELINE");
+	if (hint == NULL || SDL_strcmp(hint, "1") != 0)
+	{
+		return;
+	}
+
+	/* Ring size has to be a power of two for the index mask */
+	capacity = 1;
+	hint = SDL_getenv("FNA3D_TIMELINE_EVENTS");
+	while (capacity < (hint != NULL ?
+		(uint32_t) SDL_max(SDL_atoi(hint), 1024) :
+		DEFAULT_TIMELINE_EVENTS)
+	) {
+		capacity <<= 1;
+	}
+	timelineEvents = (TimelineEvent*) SDL_calloc(
+		capacity,
+		sizeof(TimelineEvent)
+	);
+	if (timelineEvents == NULL)
+	{
+		FNA3D_LogWarn("Could not allocate timeline, capture disabled");
+		return;
+	}
+	timelineEventMask = capacity - 1;
+	SDL_SetAtomicInt(&timelineCursor, 0);
+
+	hint = SDL_getenv("FNA3D_TIMELINE_FRAMES");
+	timelineFrameCapacity = (hint != NULL) ?
+		SDL_max(1, SDL_min(SDL_atoi(hint), MAX_TIMELINE_FRAMES)) :
+		DEFAULT_TIMELINE_FRAMES;
+
+	/* Frames slower than this get dumped automatically, 0 = never */
+	hint = SDL_getenv("FNA3D_TIMELINE_BUDGET_MS");
+	timelineBudgetTicks = (hint != NULL) ? (uint64_t) (
+		SDL_atof(hint) *
+		(double) SDL_GetPerformanceFrequency() /
+		1000.0
+	) : 0;
+	timelineAutoDumps = 0;
+
+	timelinePath = SDL_getenv("FNA3D_TIMELINE_PATH");
+	if (timelinePath == NULL)
+	{
+		timelinePath = "fna3d_timeline";
+	}
+
+	timelineBaseTicks = SDL_GetPerformanceCounter();
+	timelineFrameStartTicks = timelineBaseTicks;
+	timelineFrameCount = 0;
+	timelineFrameStarts[0] = 0;
+	SDL_SetAtomicInt(&timelineLive, 1);
+	FNA3D_TimelineActive = 1;
+	FNA3D_Timeline_Event("Frame", 1);
+
+	FNA3D_LogInfo(
+		"Timeline capture enabled: %u events, %u frames",
+		capacity,
+		timelineFrameCapacity
+	);
+}
+
+void FNA3D_Timeline_Quit(void)
+{
+	SDL_LockSpinlock(&timelineLock);
+	if (timelineRefcount == 0 || --timelineRefcount > 0)
+	{
+		SDL_UnlockSpinlock(&timelineLock);
+		return;
+	}
+	SDL_UnlockSpinlock(&timelineLock);
+
+	/* Turn new writers away, then let the ones in flight finish */
+	FNA3D_TimelineActive = 0;
+	SDL_SetAtomicInt(&timelineLive, 0);
+	while (SDL_GetAtomicInt(&timelineWriters) > 0)
+	{
+		SDL_Delay(0);
+	}
+
+	SDL_free(timelineEvents);
+	timelineEvents = NULL;
+}
+
+void FNA3D_Timeline_Event(const char *name, uint8_t begin)
+{
+	TimelineEvent *evt;
+	uint32_t index;
+
+	if (!FNA3D_Timeline_Acquire())
+	{
+		return;
+	}
+
+	/* Each writer claims its own slot, the ring just overwrites the
+	 * oldest events once it's full.
+	 */
+	index = (uint32_t) SDL_AddAtomicInt(&timelineCursor, 1);
+	evt = &timelineEvents[index & timelineEventMask];
+	evt->ticks = SDL_GetPerformanceCounter();
+	evt->thread = (uint64_t) SDL_GetCurrentThreadID();
+	evt->name = name;
+	evt->begin = begin;
+
+	FNA3D_Timeline_Release();
+}
+
+static uint8_t FNA3D_Timeline_Write(const char *filename)
+{
+	SDL_IOStream *ops;
+	TimelineEvent *evt;
+	uint32_t start, end, i;
+	uint64_t oldest;
+	double frequency;
+	char line[256];
+	int len;
+
+	ops = SDL_IOFromFile(filename, "wb");
+	if (ops == NULL)
+	{
+		FNA3D_LogWarn("Could not open %s: %s", filename, SDL_GetError());
+		return 0;
+	}
+
+	/* Cut at the oldest retained frame, unless the ring already lapped it */
+	end = (uint32_t) SDL_GetAtomicInt(&timelineCursor);
+	oldest = (timelineFrameCount >= timelineFrameCapacity) ?
+		(timelineFrameCount - timelineFrameCapacity + 1) :
+		0;
+	start = timelineFrameStarts[oldest % MAX_TIMELINE_FRAMES];
+	if ((end - start) > timelineEventMask)
+	{
+		start = end - timelineEventMask;
+	}
+
+	frequency = (double) SDL_GetPerformanceFrequency() / 1000000.0;
+
+	#define WRITE_STRING(str) \
+		SDL_WriteIO(ops, str, SDL_strlen(str));
+	WRITE_STRING("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n")
+	for (i = start; i != end; i += 1)
+	{
+		evt = &timelineEvents[i & timelineEventMask];
+		len = SDL_snprintf(
+			line,
+			sizeof(line),
+			"%s{\"name\":\"%s\",\"cat\":\"FNA3D\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%llu}",
+			(i == start) ? "" : ",\n",
+			evt->name,
+			evt->begin ? 'B' : 'E',
+			(double) (evt->ticks - timelineBaseTicks) / frequency,
+			(unsigned long long) evt->thread
+		);
+		SDL_WriteIO(ops, line, SDL_min(len, (int) sizeof(line) - 1));
+	}
+	WRITE_STRING("\n]}\n")
+	#undef WRITE_STRING
+
+	SDL_CloseIO(ops);
+	return 1;
+}
+
+void FNA3D_Timeline_EndFrame(void)
+{
+	uint64_t now;
+	char filename[1024];
+
+	if (!FNA3D_Timeline_Acquire())
+	{
+		return;
+	}
+
+	FNA3D_Timeline_Event("Frame", 0);
+	now = SDL_GetPerformanceCounter();
+	timelineFrameCount += 1;
+
+	if (	timelineBudgetTicks > 0 &&
+		(now - timelineFrameStartTicks) > timelineBudgetTicks &&
+		timelineAutoDumps < DEFAULT_TIMELINE_AUTO_DUMPS	)
+	{
+		SDL_snprintf(
+			filename,
+			sizeof(filename),
+			"%s_%llu.json",
+			timelinePath,
+			(unsigned long long) timelineFrameCount
+		);
+		if (FNA3D_Timeline_Write(filename))
+		{
+			timelineAutoDumps += 1;
+			FNA3D_LogInfo(
+				"Frame %llu took %.2fms, timeline written to %s",
+				(unsigned long long) timelineFrameCount,
+				(double) (now - timelineFrameStartTicks) * 1000.0 /
+					(double) SDL_GetPerformanceFrequency(),
+				filename
+			);
+		}
+	}
+
+	/* Start the next frame */
+	timelineFrameStarts[timelineFrameCount % MAX_TIMELINE_FRAMES] =
+		(uint32_t) SDL_GetAtomicInt(&timelineCursor);
+	timelineFrameStartTicks = SDL_GetPerformanceCounter();
+	FNA3D_Timeline_Event("Frame", 1);
+
+	FNA3D_Timeline_Release();
+}
+
+/* Public API */
+
+uint8_t FNA3D_DumpTimeline(const char *filename)
+{
+	char defaultName[1024];
+	uint8_t result;
+
+	if (!FNA3D_Timeline_Acquire())
+	{
+		return 0;
+	}
+	if (filename == NULL)
+	{
+		SDL_snprintf(
+			defaultName,
+			sizeof(defaultName),
+			"%s.json",
+			timelinePath
+		);
+		filename = defaultName;
+	}
+	result = FNA3D_Timeline_Write(filename);
+
+	FNA3D_Timeline_Release();
+	return result;
+}
+
+/* vim: set noexpandtab shiftwidth=8 tabstop=8: */
@@ -0,0 +1,60 @@
+/* FNA3D - 3D Graphics Library for FNA
+ *
+ * Copyright (c) 2020-2024 Ethan Lee
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from
+ * the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ * claim that you wrote the original software. If you use this software in a
+ * product, an acknowledgment in the product documentation would be
+ * appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ * misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ * Ethan "flibitijibibo" Lee <flibitijibibo@flibitijibibo.com>
+ *
+ */
+
+#ifndef FNA3D_TIMELINE_H
+#define FNA3D_TIMELINE_H
+
+#include "FNA3D_Driver.h"
+
+/* CPU timeline capture, see FNA3D_DumpTimeline.
+ *
+ * Events are begin/end pairs with static string names, pushed into a ring
+ * shared by every thread. SwapBuffers closes each frame, so the ring can be
+ * cut at frame boundaries when it is exported. Init/Quit are counted per
+ * device, the ring lives until the last device is destroyed.
+ */
+
+FNA3D_SHAREDINTERNAL uint8_t FNA3D_TimelineActive;
+
+FNA3D_SHAREDINTERNAL void FNA3D_Timeline_Init(void);
+FNA3D_SHAREDINTERNAL void FNA3D_Timeline_Quit(void);
+FNA3D_SHAREDINTERNAL void FNA3D_Timeline_Event(const char *name, uint8_t begin);
+FNA3D_SHAREDINTERNAL void FNA3D_Timeline_EndFrame(void);
+
+#define TIMELINE_BEGIN(name) \
+	if (FNA3D_TimelineActive) \
+	{ \
+		FNA3D_Timeline_Event(name, 1); \
+	}
+#define TIMELINE_END(name) \
+	if (FNA3D_TimelineActive) \
+	{ \
+		FNA3D_Timeline_Event(name, 0); \
+	}
+
+#endif /* FNA3D_TIMELINE_H */
+
+/* vim: set noexpandtab shiftwidth=8 tabstop=8: */
@@ -0,0 +1,537 @@
+/* FNA3D - 3D Graphics Library for FNA
+ *
+ * Copyright (c) 2020-2024 Ethan Lee
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from
+ * the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ * claim that you wrote the original software. If you use this software in a
+ * product, an acknowledgment in the product documentation would be
+ * appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ * misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ * Ethan "flibitijibibo" Lee <flibitijibibo@flibitijibibo.com>
+ *
+ */
+
+#ifdef FNA3D_TRACING
+
+#include "FNA3D_TraceStream.h"
+
+#ifdef USE_SDL3
+#include <SDL3/SDL.h>
+#else
+#include <SDL.h>
+#endif
+
+#ifdef FNA3D_TRACING_ZSTD
+#include <zstd.h>
+#endif
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-but-set-variable"
+#pragma GCC diagnostic ignored "-Wunused-function"
+#ifndef __clang__
+#pragma GCC diagnostic ignored "-Wmisleading-indentation"
+#endif
+
+#ifdef memcmp
+#undef memcmp
+#endif
+#define memcmp SDL_memcmp
+#ifdef memcpy
+#undef memcpy
+#endif
+#define memcpy SDL_memcpy
+#ifdef memmove
+#undef memmove
+#endif
+#define memmove SDL_memmove
+#ifdef memset
+#undef memset
+#endif
+#define memset SDL_memset
+
+#define MINIZ_NO_STDIO
+#define MINIZ_NO_TIME
+#define MINIZ_SDL_MALLOC
+#define MZ_ASSERT(x) SDL_assert(x)
+#include "miniz.h"
+
+#pragma GCC diagnostic pop
+
+/* Writing */
+
+#define ROTL64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+uint64_t FNA3D_TraceStream_Hash(const void *data, size_t length)
+{
+	const uint8_t *bytes = (const uint8_t*) data;
+	uint64_t hash = 0x27D4EB2F165667C5ULL ^ (length * 0x9E3779B97F4A7C15ULL);
+	uint64_t k;
+	size_t i;
+
+	for (i = 0; i + 8 <= length; i += 8)
+	{
+		SDL_memcpy(&k, bytes + i, sizeof(k));
+		k *= 0xC2B2AE3D27D4EB4FULL;
+		k = ROTL64(k, 31);
+		k *= 0x9E3779B185EBCA87ULL;
+		hash ^= k;
+		hash = ROTL64(hash, 27) * 0x9E3779B185EBCA87ULL + 0x85EBCA77C2B2AE63ULL;
+	}
+	for (; i < length; i += 1)
+	{
+		hash ^= bytes[i] * 0x27D4EB2F165667C5ULL;
+		hash = ROTL64(hash, 11) * 0x9E3779B185EBCA87ULL;
+	}
+
+	hash ^= hash >> 33;
+	hash *= 0xC2B2AE3D27D4EB4FULL;
+	hash ^= hash >> 29;
+	hash *= 0x165667B19E3779F9ULL;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+#undef ROTL64
+
+static void EnsureCapacity(uint8_t **buffer, uint32_t *capacity, size_t size)
+{
+	if (size > *capacity)
+	{
+		*buffer = (uint8_t*) SDL_realloc(*buffer, size);
+		*capacity = (uint32_t) size;
+	}
+}
+
+uint32_t FNA3D_TraceStream_CompressBlock(
+	uint32_t compression,
+	const uint8_t *data,
+	uint32_t length,
+	uint8_t **scratch,
+	uint32_t *scratchCapacity
+) {
+	size_t result;
+
+	if (compression == FNA3D_TRACE_COMPRESSION_DEFLATE)
+	{
+		mz_ulong compressedLength = mz_compressBound(length);
+		EnsureCapacity(scratch, scratchCapacity, compressedLength);
+		if (mz_compress2(
+			*scratch,
+			&compressedLength,
+			data,
+			length,
+			MZ_BEST_SPEED
+		) != MZ_OK) {
+			return 0;
+		}
+		result = compressedLength;
+	}
+#ifdef FNA3D_TRACING_ZSTD
+	else if (compression == FNA3D_TRACE_COMPRESSION_ZSTD)
+	{
+		EnsureCapacity(scratch, scratchCapacity, ZSTD_compressBound(length));
+		result = ZSTD_compress(
+			*scratch,
+			*scratchCapacity,
+			data,
+			length,
+			1
+		);
+		if (ZSTD_isError(result))
+		{
+			return 0;
+		}
+	}
+#endif /* FNA3D_TRACING_ZSTD */
+	else
+	{
+		return 0;
+	}
+
+	/* Incompressible data is cheaper to store as-is */
+	if (result >= length)
+	{
+		return 0;
+	}
+	return (uint32_t) result;
+}
+
+/* Blob Window */
+
+uint8_t FNA3D_TraceBlobWindow_MustEvict(
+	const FNA3D_TraceBlobWindow *window,
+	uint32_t length
+) {
+	if (window->first == window->next)
+	{
+		return 0;
+	}
+	return (	window->next - window->first == FNA3D_TRACE_BLOB_WINDOW ||
+			window->bytes + length > FNA3D_TRACE_BLOB_WINDOW_BYTES	);
+}
+
+void FNA3D_TraceBlobWindow_EvictOldest(FNA3D_TraceBlobWindow *window)
+{
+	uint32_t slot = window->first % FNA3D_TRACE_BLOB_WINDOW;
+	SDL_free(window->data[slot]);
+	window->data[slot] = NULL;
+	window->bytes -= window->lengths[slot];
+	window->first += 1;
+}
+
+/* Allocates the next blob, leaving the contents to the caller */
+static uint8_t* ReserveBlob(
+	FNA3D_TraceBlobWindow *window,
+	uint32_t length,
+	uint64_t hash
+) {
+	uint32_t slot = window->next % FNA3D_TRACE_BLOB_WINDOW;
+	SDL_assert(!FNA3D_TraceBlobWindow_MustEvict(window, length));
+	window->data[slot] = (uint8_t*) SDL_malloc(SDL_max(length, 1));
+	window->lengths[slot] = length;
+	window->hashes[slot] = hash;
+	window->bytes += length;
+	window->next += 1;
+	return window->data[slot];
+}
+
+uint32_t FNA3D_TraceBlobWindow_Add(
+	FNA3D_TraceBlobWindow *window,
+	const void *data,
+	uint32_t length,
+	uint64_t hash
+) {
+	SDL_memcpy(ReserveBlob(window, length, hash), data, length);
+	return window->next - 1;
+}
+
+const uint8_t* FNA3D_TraceBlobWindow_Get(
+	const FNA3D_TraceBlobWindow *window,
+	uint32_t index,
+	uint32_t length
+) {
+	uint32_t slot = index % FNA3D_TRACE_BLOB_WINDOW;
+
+	/* Unsigned wraparound also rejects indices older than first */
+	if (	index - window->first >= window->next - window->first ||
+		window->lengths[slot] != length	)
+	{
+		return NULL;
+	}
+	return window->data[slot];
+}
+
+void FNA3D_TraceBlobWindow_Destroy(FNA3D_TraceBlobWindow *window)
+{
+	while (window->first != window->next)
+	{
+		FNA3D_TraceBlobWindow_EvictOldest(window);
+	}
+}
+
+/* Reading */
+
+static uint8_t NextBlock(FNA3D_TraceReader *reader)
+{
+	uint32_t header[2];
+	uint32_t uncompressedLength, storedLength;
+
+	if (reader->read(reader->io, header, sizeof(header)) < sizeof(header))
+	{
+		return 0;
+	}
+	uncompressedLength = header[0];
+	storedLength = header[1];
+	EnsureCapacity(
+		&reader->block,
+		&reader->blockCapacity,
+		uncompressedLength
+	);
+	reader->blockLength = 0;
+	reader->blockOffset = 0;
+
+	if (storedLength == uncompressedLength)
+	{
+		if (reader->read(
+			reader->io,
+			reader->block,
+			storedLength
+		) < storedLength) {
+			reader->failed = 1;
+			return 0;
+		}
+		reader->blockLength = uncompressedLength;
+		return 1;
+	}
+
+	EnsureCapacity(&reader->stored, &reader->storedCapacity, storedLength);
+	if (reader->read(reader->io, reader->stored, storedLength) < storedLength)
+	{
+		reader->failed = 1;
+		return 0;
+	}
+
+	if (reader->compression == FNA3D_TRACE_COMPRESSION_DEFLATE)
+	{
+		mz_ulong length = uncompressedLength;
+		if (	mz_uncompress(
+				reader->block,
+				&length,
+				reader->stored,
+				storedLength
+			) != MZ_OK ||
+			length != uncompressedLength	)
+		{
+			reader->failed = 1;
+			return 0;
+		}
+	}
+#ifdef FNA3D_TRACING_ZSTD
+	else if (reader->compression == FNA3D_TRACE_COMPRESSION_ZSTD)
+	{
+		if (ZSTD_decompress(
+			reader->block,
+			uncompressedLength,
+			reader->stored,
+			storedLength
+		) != uncompressedLength) {
+			reader->failed = 1;
+			return 0;
+		}
+	}
+#endif /* FNA3D_TRACING_ZSTD */
+	else
+	{
+		reader->failed = 1;
+		return 0;
+	}
+
+	reader->blockLength = uncompressedLength;
+	return 1;
+}
+
+/* dst may be NULL, in which case the bytes are skipped */
+static size_t ReadBytes(FNA3D_TraceReader *reader, uint8_t *dst, size_t length)
+{
+	uint8_t skip[4096];
+	size_t total = 0, chunk, got;
+
+	if (reader->failed)
+	{
+		return 0;
+	}
+
+	if (reader->version == 1)
+	{
+		chunk = SDL_min(length, reader->pendingLength - reader->pendingOffset);
+		if (chunk > 0)
+		{
+			if (dst != NULL)
+			{
+				SDL_memcpy(dst, reader->pending + reader->pendingOffset, chunk);
+			}
+			reader->pendingOffset += (uint32_t) chunk;
+			total += chunk;
+		}
+		while (total < length)
+		{
+			chunk = length - total;
+			if (dst == NULL)
+			{
+				chunk = SDL_min(chunk, sizeof(skip));
+			}
+			got = reader->read(
+				reader->io,
+				(dst != NULL) ? dst + total : skip,
+				chunk
+			);
+			total += got;
+			if (got < chunk)
+			{
+				break;
+			}
+		}
+		return total;
+	}
+
+	while (total < length)
+	{
+		if (reader->blockOffset == reader->blockLength && !NextBlock(reader))
+		{
+			break;
+		}
+		chunk = SDL_min(length - total, reader->blockLength - reader->blockOffset);
+		if (dst != NULL)
+		{
+			SDL_memcpy(
+				dst + total,
+				reader->block + reader->blockOffset,
+				chunk
+			);
+		}
+		reader->blockOffset += (uint32_t) chunk;
+		total += chunk;
+	}
+	return total;
+}
+
+uint8_t FNA3D_TraceReader_Init(
+	FNA3D_TraceReader *reader,
+	FNA3D_TraceReadFunc read,
+	void *io
+) {
+	uint32_t header[3];
+
+	SDL_zerop(reader);
+	reader->read = read;
+	reader->io = io;
+
+	reader->pendingLength = (uint32_t) read(io, header, sizeof(uint32_t));
+	if (	reader->pendingLength < sizeof(uint32_t) ||
+		header[0] != FNA3D_TRACE_MAGIC	)
+	{
+		/* Not a container, hand the bytes back to the call stream */
+		reader->version = 1;
+		SDL_memcpy(reader->pending, header, reader->pendingLength);
+		return 1;
+	}
+	reader->pendingLength = 0;
+
+	if (read(io, &header[1], sizeof(uint32_t) * 2) < sizeof(uint32_t) * 2)
+	{
+		return 0;
+	}
+	reader->version = header[1];
+	reader->compression = header[2];
+	if (reader->version != FNA3D_TRACE_VERSION)
+	{
+		SDL_Log("Unsupported trace version %u", reader->version);
+		return 0;
+	}
+	reader->window = (FNA3D_TraceBlobWindow*) SDL_calloc(
+		1,
+		sizeof(FNA3D_TraceBlobWindow)
+	);
+	if (	reader->compression != FNA3D_TRACE_COMPRESSION_NONE &&
+		reader->compression != FNA3D_TRACE_COMPRESSION_DEFLATE
+#ifdef FNA3D_TRACING_ZSTD
+		&& reader->compression != FNA3D_TRACE_COMPRESSION_ZSTD
+#endif
+	) {
+		SDL_Log(
+			"Unsupported trace compression %u, was this built with zstd?",
+			reader->compression
+		);
+		return 0;
+	}
+	return 1;
+}
+
+void FNA3D_TraceReader_Destroy(FNA3D_TraceReader *reader)
+{
+	if (reader->window != NULL)
+	{
+		FNA3D_TraceBlobWindow_Destroy(reader->window);
+		SDL_free(reader->window);
+	}
+	SDL_free(reader->block);
+	SDL_free(reader->stored);
+	SDL_zerop(reader);
+}
+
+size_t FNA3D_TraceReader_Read(
+	FNA3D_TraceReader *reader,
+	void *dst,
+	size_t length
+) {
+	size_t result = ReadBytes(reader, (uint8_t*) dst, length);
+	if (result < length)
+	{
+		SDL_memset((uint8_t*) dst + result, '\0', length - result);
+	}
+	return result;
+}
+
+void FNA3D_TraceReader_ReadBlob(
+	FNA3D_TraceReader *reader,
+	void *dst,
+	size_t length
+) {
+	uint8_t tag;
+	uint32_t index;
+	const uint8_t *blob;
+
+	if (reader->version == 1)
+	{
+		ReadBytes(reader, (uint8_t*) dst, length);
+		return;
+	}
+
+	FNA3D_TraceReader_Read(reader, &tag, sizeof(tag));
+	if (tag == FNA3D_TRACE_BLOB_INLINE)
+	{
+		ReadBytes(reader, (uint8_t*) dst, length);
+	}
+	else if (tag == FNA3D_TRACE_BLOB_NEW)
+	{
+		if (length > FNA3D_TRACE_BLOB_WINDOW_BYTES)
+		{
+			SDL_Log("Trace payload is too large for the blob window!");
+			reader->failed = 1;
+			return;
+		}
+
+		/* Kept even when skipped, later references may need it */
+		while (FNA3D_TraceBlobWindow_MustEvict(reader->window, length))
+		{
+			FNA3D_TraceBlobWindow_EvictOldest(reader->window);
+		}
+		blob = ReserveBlob(reader->window, (uint32_t) length, 0);
+		ReadBytes(reader, (uint8_t*) blob, length);
+		if (dst != NULL)
+		{
+			SDL_memcpy(dst, blob, length);
+		}
+	}
+	else if (tag == FNA3D_TRACE_BLOB_REFERENCE)
+	{
+		FNA3D_TraceReader_Read(reader, &index, sizeof(index));
+		blob = FNA3D_TraceBlobWindow_Get(reader->window, index, length);
+		if (blob == NULL)
+		{
+			SDL_Log("Trace references a missing payload!");
+			reader->failed = 1;
+			return;
+		}
+		if (dst != NULL)
+		{
+			SDL_memcpy(dst, blob, length);
+		}
+	}
+	else
+	{
+		SDL_Log("Unrecognized trace payload tag %u", tag);
+		reader->failed = 1;
+	}
+}
+
+#else
+
+extern int this_tu_is_empty;
+
+#endif /* FNA3D_TRACING */
+
+/* vim: set noexpandtab shiftwidth=8 tabstop=8: */
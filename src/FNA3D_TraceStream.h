@@ -0,0 +1,201 @@
+/* FNA3D - 3D Graphics Library for FNA
+ *
+ * Copyright (c) 2020-2024 Ethan Lee
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from
+ * the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ * claim that you wrote the original software. If you use this software in a
+ * product, an acknowledgment in the product documentation would be
+ * appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ * misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source distribution.
+ *
+ * Ethan "flibitijibibo" Lee <flibitijibibo@flibitijibibo.com>
+ *
+ */
+
+#ifndef FNA3D_TRACESTREAM_H
+#define FNA3D_TRACESTREAM_H
+
+#include "FNA3D.h"
+
+#include <stddef.h>
+
+/* Trace Container
+ *
+ * Version 1 traces are the raw call stream: a MARK_CREATEDEVICE byte followed
+ * by every call's arguments, with texture/buffer/effect data written inline.
+ *
+ * Version 2 wraps the same call stream in a container, in native byte order:
+ *
+ *	uint32	magic, FNA3D_TRACE_MAGIC
+ *	uint32	version, FNA3D_TRACE_VERSION
+ *	uint32	compression, FNA3D_TRACE_COMPRESSION_*
+ *
+ * followed by blocks until the end of the file:
+ *
+ *	uint32	uncompressedLength
+ *	uint32	storedLength, equal to uncompressedLength if stored raw
+ *	uint8	data[storedLength]
+ *
+ * Decompressing and concatenating every block yields the call stream. Since
+ * v1 traces always start with a zero byte, the two can't be mistaken for one
+ * another.
+ *
+ * Inside a v2 stream, every variable-length payload (everything v1 wrote with
+ * WRITEMEM) is prefixed with a uint8 tag. The length is not repeated, since
+ * the call's own arguments already provide it:
+ *
+ *	FNA3D_TRACE_BLOB_INLINE:	uint8	data[length]
+ *	FNA3D_TRACE_BLOB_NEW:		uint8	data[length]
+ *	FNA3D_TRACE_BLOB_REFERENCE:	uint32	blobIndex
+ *
+ * NEW blobs are numbered in the order they appear, starting at 0, and a
+ * REFERENCE repeats an earlier NEW blob that is still in the blob window.
+ * Payloads smaller than FNA3D_TRACE_DEDUP_MINIMUM or larger than
+ * FNA3D_TRACE_BLOB_WINDOW_BYTES are always written INLINE, as is everything
+ * other than texture data and effect code.
+ *
+ * The blob window holds the most recent NEW blobs. Before a NEW blob is
+ * added, the oldest blobs are evicted until there are fewer than
+ * FNA3D_TRACE_BLOB_WINDOW of them and the new blob fits within
+ * FNA3D_TRACE_BLOB_WINDOW_BYTES. Writer and reader apply the same rule, so
+ * both always agree on which blobs can be referenced.
+ */
+
+#define FNA3D_TRACE_MAGIC 0x52543346 /* "F3TR" */
+#define FNA3D_TRACE_VERSION 2
+
+#define FNA3D_TRACE_COMPRESSION_NONE	0
+#define FNA3D_TRACE_COMPRESSION_DEFLATE	1
+#define FNA3D_TRACE_COMPRESSION_ZSTD	2
+
+#define FNA3D_TRACE_BLOB_INLINE		0
+#define FNA3D_TRACE_BLOB_NEW		1
+#define FNA3D_TRACE_BLOB_REFERENCE	2
+
+#define FNA3D_TRACE_DEDUP_MINIMUM 256
+#define FNA3D_TRACE_BLOB_WINDOW 4096
+#define FNA3D_TRACE_BLOB_WINDOW_BYTES (256 * 1024 * 1024)
+
+/* Blob Window, shared by the writer and reader */
+
+typedef struct FNA3D_TraceBlobWindow
+{
+	uint8_t *data[FNA3D_TRACE_BLOB_WINDOW];
+	uint32_t lengths[FNA3D_TRACE_BLOB_WINDOW];
+	uint64_t hashes[FNA3D_TRACE_BLOB_WINDOW]; /* Writer only */
+	uint32_t first; /* Index of the oldest blob */
+	uint32_t next; /* Index the next NEW blob will get */
+	uint64_t bytes;
+} FNA3D_TraceBlobWindow;
+
+/* Returns 1 if the oldest blob must go before a blob of this length fits */
+uint8_t FNA3D_TraceBlobWindow_MustEvict(
+	const FNA3D_TraceBlobWindow *window,
+	uint32_t length
+);
+void FNA3D_TraceBlobWindow_EvictOldest(FNA3D_TraceBlobWindow *window);
+
+/* Copies the data, call only once MustEvict returns 0. Returns the index. */
+uint32_t FNA3D_TraceBlobWindow_Add(
+	FNA3D_TraceBlobWindow *window,
+	const void *data,
+	uint32_t length,
+	uint64_t hash
+);
+
+/* Returns NULL if the blob was evicted or its length doesn't match */
+const uint8_t* FNA3D_TraceBlobWindow_Get(
+	const FNA3D_TraceBlobWindow *window,
+	uint32_t index,
+	uint32_t length
+);
+
+void FNA3D_TraceBlobWindow_Destroy(FNA3D_TraceBlobWindow *window);
+
+/* Writing */
+
+/* Identifies payloads for deduplication; not stored in the trace */
+uint64_t FNA3D_TraceStream_Hash(
+	const void *data,
+	size_t length
+);
+
+/* Compresses one block into a growable scratch buffer. Returns the
+ * compressed length, or 0 if the block should be stored raw instead.
+ */
+uint32_t FNA3D_TraceStream_CompressBlock(
+	uint32_t compression,
+	const uint8_t *data,
+	uint32_t length,
+	uint8_t **scratch,
+	uint32_t *scratchCapacity
+);
+
+/* Reading, for the tools */
+
+typedef size_t (*FNA3D_TraceReadFunc)(void *io, void *dst, size_t length);
+
+typedef struct FNA3D_TraceReader
+{
+	FNA3D_TraceReadFunc read;
+	void *io;
+	uint32_t version;
+	uint32_t compression;
+	uint8_t failed;
+
+	/* v1 only: the bytes consumed while checking for the magic */
+	uint8_t pending[4];
+	uint32_t pendingLength;
+	uint32_t pendingOffset;
+
+	/* v2 only: the current decompressed block */
+	uint8_t *block;
+	uint32_t blockLength;
+	uint32_t blockOffset;
+	uint32_t blockCapacity;
+	uint8_t *stored;
+	uint32_t storedCapacity;
+
+	/* v2 only: the NEW blobs that can still be referenced */
+	FNA3D_TraceBlobWindow *window;
+} FNA3D_TraceReader;
+
+/* Reads the container header, if any. Returns 0 for unsupported traces. */
+uint8_t FNA3D_TraceReader_Init(
+	FNA3D_TraceReader *reader,
+	FNA3D_TraceReadFunc read,
+	void *io
+);
+void FNA3D_TraceReader_Destroy(FNA3D_TraceReader *reader);
+
+/* Fixed-size call arguments. Returns the number of bytes read; the rest of
+ * dst is zeroed at the end of the trace.
+ */
+size_t FNA3D_TraceReader_Read(
+	FNA3D_TraceReader *reader,
+	void *dst,
+	size_t length
+);
+
+/* Payloads written with WRITEMEM; dst may be NULL to skip the payload */
+void FNA3D_TraceReader_ReadBlob(
+	FNA3D_TraceReader *reader,
+	void *dst,
+	size_t length
+);
+
+#endif /* FNA3D_TRACESTREAM_H */
+
+/* vim: set noexpandtab shiftwidth=8 tabstop=8: */
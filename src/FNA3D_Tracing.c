@@ -28,6 +28,7 @@
 
 #include "mojoshader.h"
 #include "FNA3D_Tracing.h"
+#include "FNA3D_TraceStream.h"
 
 #ifdef USE_SDL3
 #include <SDL3/SDL.h>
@@ -41,6 +42,11 @@
 #else
 #include <SDL.h>
 #define SDL_Mutex SDL_mutex
+#define SDL_Condition SDL_cond
+#define SDL_CreateCondition SDL_CreateCond
+#define SDL_DestroyCondition SDL_DestroyCond
+#define SDL_WaitCondition SDL_CondWait
+#define SDL_SignalCondition SDL_CondSignal
 #define SDL_IOStream SDL_RWops
 #define SDL_IOFromFile SDL_RWFromFile
 #define SDL_WriteIO(a, b, c) SDL_RWwrite(a, b, c, 1)
@@ -187,56 +193,387 @@ void FNA3D_Trace_RegisterEffect(FNA3D_Effect *effect, MOJOSHADER_effect *effectD
 #undef TRACE_OBJECT
 
 #define CHECK_AND_FLUSH_BUFFER(len) \
-	if (len > traceBufferSize) \
+	if (traceBuffer->size + len > traceBuffer->capacity) \
 	{ \
-		traceBuffer = SDL_realloc(traceBuffer, len); \
-		traceBufferSize = len; \
-	} \
-	if (traceBufferCurrentSize + len > traceBufferSize) \
-	{ \
-		FNA3D_Trace_FlushMemory(); \
+		FNA3D_Trace_FlushMemory(len); \
 	}
 #define WRITE(val) \
 	CHECK_AND_FLUSH_BUFFER(sizeof(val)) \
-	SDL_memcpy((uint8_t*) traceBuffer + traceBufferCurrentSize, &val, sizeof(val)); \
-	traceBufferCurrentSize += sizeof(val);
-#define WRITEMEM(ptr, len) \
+	SDL_memcpy(traceBuffer->data + traceBuffer->size, &val, sizeof(val)); \
+	traceBuffer->size += sizeof(val);
+#define WRITERAW(ptr, len) \
 	CHECK_AND_FLUSH_BUFFER(len) \
-	SDL_memcpy((uint8_t*) traceBuffer + traceBufferCurrentSize, ptr, len); \
-	traceBufferCurrentSize += len;
+	SDL_memcpy(traceBuffer->data + traceBuffer->size, ptr, len); \
+	traceBuffer->size += len;
+#define WRITEMEM(ptr, len) \
+	FNA3D_Trace_WriteBlob(ptr, len, SDL_FALSE);
+#define WRITEBLOB(ptr, len) \
+	FNA3D_Trace_WriteBlob(ptr, len, SDL_TRUE);
 
 static SDL_bool traceEnabled = SDL_FALSE;
 static void* windowHandle = NULL;
 static SDL_Mutex *traceLock = NULL;
 
-static void* traceBuffer = NULL;
-static uint32_t traceBufferCurrentSize = 0;
-static uint32_t traceBufferSize = 64000000; /* 64MB */
+/* The calling thread only ever copies into traceBuffer. Full buffers (and
+ * every frame's worth of calls, at SwapBuffers) are handed to a writer thread
+ * through a bounded queue, and the caller only blocks when every buffer is
+ * still waiting to hit the disk.
+ */
+
+#define TRACE_BUFFER_COUNT 4
 
-static void FNA3D_Trace_FlushMemory()
+typedef struct TraceBuffer
 {
-	SDL_IOStream* traceFile = SDL_IOFromFile("FNA3D_Trace.bin", "ab");
-	SDL_WriteIO(traceFile, traceBuffer, traceBufferCurrentSize);
-	SDL_CloseIO(traceFile);
-	traceBufferCurrentSize = 0;
+	uint8_t *data;
+	uint32_t size;
+	uint32_t capacity;
+} TraceBuffer;
+
+static TraceBuffer traceBuffers[TRACE_BUFFER_COUNT];
+static TraceBuffer *traceBuffer = NULL;
+static uint32_t traceBufferSize = 16000000; /* 16MB, per buffer */
+
+static SDL_IOStream *traceFile = NULL;
+static SDL_Thread *traceThread = NULL;
+static SDL_Mutex *traceQueueLock = NULL;
+static SDL_Condition *traceQueueFilled = NULL;
+static SDL_Condition *traceQueueDrained = NULL;
+static TraceBuffer *traceQueue[TRACE_BUFFER_COUNT];
+static uint32_t traceQueueHead = 0;
+static uint32_t traceQueueCount = 0;
+static TraceBuffer *traceFreeBuffers[TRACE_BUFFER_COUNT];
+static uint32_t traceFreeCount = 0;
+static SDL_bool traceThreadQuit = SDL_FALSE;
+
+#ifdef FNA3D_TRACING_ZSTD
+static const uint32_t traceCompression = FNA3D_TRACE_COMPRESSION_ZSTD;
+#else
+static const uint32_t traceCompression = FNA3D_TRACE_COMPRESSION_DEFLATE;
+#endif
+
+/* The blobs a REFERENCE may point to, plus a hash table over them. The table
+ * is twice the window's size and entries leave it when their blob is
+ * evicted, so it never needs to grow.
+ */
+#define TRACE_BLOB_TABLE_SIZE (FNA3D_TRACE_BLOB_WINDOW * 2)
+
+typedef struct TraceBlobEntry
+{
+	uint64_t hash;
+	uint32_t index;
+	uint8_t used;
+} TraceBlobEntry;
+
+static FNA3D_TraceBlobWindow traceBlobWindow;
+static TraceBlobEntry traceBlobTable[TRACE_BLOB_TABLE_SIZE];
+
+/* Size and backpressure statistics, reported when the device is destroyed */
+static uint64_t traceBytesTraced = 0;
+static uint64_t traceBytesDeduplicated = 0;
+static uint64_t traceBytesWritten = 0;
+static uint64_t traceBuffersSubmitted = 0;
+static uint64_t traceStallCount = 0;
+static uint64_t traceStallTicks = 0;
+static uint32_t traceMaxQueueDepth = 0;
+
+/* Used instead of the writer's scratch when the thread failed to start */
+static uint8_t *traceSyncScratch = NULL;
+static uint32_t traceSyncScratchCapacity = 0;
+
+/* Compresses and writes one buffer, returns the number of bytes written */
+static uint32_t FNA3D_Trace_WriteBlock(
+	TraceBuffer *buffer,
+	uint8_t **scratch,
+	uint32_t *scratchCapacity
+) {
+	uint32_t blockHeader[2];
+
+	blockHeader[0] = buffer->size;
+	blockHeader[1] = FNA3D_TraceStream_CompressBlock(
+		traceCompression,
+		buffer->data,
+		buffer->size,
+		scratch,
+		scratchCapacity
+	);
+	SDL_WriteIO(traceFile, blockHeader, sizeof(blockHeader));
+	if (blockHeader[1] > 0)
+	{
+		SDL_WriteIO(traceFile, *scratch, blockHeader[1]);
+	}
+	else
+	{
+		blockHeader[1] = buffer->size;
+		SDL_WriteIO(traceFile, buffer->data, buffer->size);
+	}
+	return sizeof(blockHeader) + blockHeader[1];
+}
+
+static int FNA3D_Trace_WriterThread(void *data)
+{
+	TraceBuffer *buffer;
+	uint8_t *scratch = NULL;
+	uint32_t scratchCapacity = 0;
+	uint32_t written;
+
+	SDL_LockMutex(traceQueueLock);
+	while (1)
+	{
+		while (traceQueueCount == 0 && !traceThreadQuit)
+		{
+			SDL_WaitCondition(traceQueueFilled, traceQueueLock);
+		}
+		if (traceQueueCount == 0)
+		{
+			/* Quit was requested and everything has been written */
+			break;
+		}
+		buffer = traceQueue[traceQueueHead];
+		traceQueueHead = (traceQueueHead + 1) % TRACE_BUFFER_COUNT;
+		traceQueueCount -= 1;
+		SDL_UnlockMutex(traceQueueLock);
+
+		written = FNA3D_Trace_WriteBlock(buffer, &scratch, &scratchCapacity);
+
+		SDL_LockMutex(traceQueueLock);
+		traceBytesTraced += buffer->size;
+		traceBytesWritten += written;
+		buffer->size = 0;
+		traceFreeBuffers[traceFreeCount] = buffer;
+		traceFreeCount += 1;
+		SDL_SignalCondition(traceQueueDrained);
+	}
+	SDL_UnlockMutex(traceQueueLock);
+	SDL_free(scratch);
+	return 0;
+}
+
+/* Call with traceQueueLock held */
+static void FNA3D_Trace_SubmitBuffer()
+{
+	if (traceBuffer->size == 0)
+	{
+		return;
+	}
+	if (traceThread == NULL)
+	{
+		/* No writer, so write on the calling thread and keep the buffer */
+		traceBytesTraced += traceBuffer->size;
+		traceBytesWritten += FNA3D_Trace_WriteBlock(
+			traceBuffer,
+			&traceSyncScratch,
+			&traceSyncScratchCapacity
+		);
+		traceBuffersSubmitted += 1;
+		traceBuffer->size = 0;
+		return;
+	}
+	traceQueue[
+		(traceQueueHead + traceQueueCount) % TRACE_BUFFER_COUNT
+	] = traceBuffer;
+	traceQueueCount += 1;
+	traceBuffersSubmitted += 1;
+	traceMaxQueueDepth = SDL_max(traceMaxQueueDepth, traceQueueCount);
+	traceBuffer = NULL;
+	SDL_SignalCondition(traceQueueFilled);
+}
+
+static void FNA3D_Trace_FlushMemory(uint32_t reserve)
+{
+	uint64_t stallStart;
+
+	SDL_LockMutex(traceQueueLock);
+	FNA3D_Trace_SubmitBuffer();
+	if (traceBuffer == NULL)
+	{
+		if (traceFreeCount == 0)
+		{
+			stallStart = SDL_GetPerformanceCounter();
+			while (traceFreeCount == 0)
+			{
+				SDL_WaitCondition(traceQueueDrained, traceQueueLock);
+			}
+			traceStallCount += 1;
+			traceStallTicks += SDL_GetPerformanceCounter() - stallStart;
+		}
+		traceFreeCount -= 1;
+		traceBuffer = traceFreeBuffers[traceFreeCount];
+	}
+	SDL_UnlockMutex(traceQueueLock);
+
+	/* A single write may be larger than an entire buffer */
+	if (reserve > traceBuffer->capacity)
+	{
+		traceBuffer->data = SDL_realloc(traceBuffer->data, reserve);
+		traceBuffer->capacity = reserve;
+	}
+}
+
+/* Removes an evicted blob from the table, shifting its probe chain back */
+static void FNA3D_Trace_ForgetBlob(uint32_t index)
+{
+	uint64_t hash = traceBlobWindow.hashes[index % FNA3D_TRACE_BLOB_WINDOW];
+	uint32_t slot = (uint32_t) hash & (TRACE_BLOB_TABLE_SIZE - 1);
+	uint32_t next, home;
+
+	while (traceBlobTable[slot].index != index || !traceBlobTable[slot].used)
+	{
+		slot = (slot + 1) & (TRACE_BLOB_TABLE_SIZE - 1);
+	}
+	traceBlobTable[slot].used = 0;
+
+	next = slot;
+	while (1)
+	{
+		next = (next + 1) & (TRACE_BLOB_TABLE_SIZE - 1);
+		if (!traceBlobTable[next].used)
+		{
+			break;
+		}
+		home = (uint32_t) traceBlobTable[next].hash & (TRACE_BLOB_TABLE_SIZE - 1);
+
+		/* Entries whose home lies in (slot, next] are still reachable */
+		if (	(slot <= next) ?
+				(slot < home && home <= next) :
+				(slot < home || home <= next)	)
+		{
+			continue;
+		}
+		traceBlobTable[slot] = traceBlobTable[next];
+		traceBlobTable[next].used = 0;
+		slot = next;
+	}
+}
+
+static void FNA3D_Trace_WriteBlob(
+	const void *data,
+	uint32_t length,
+	SDL_bool deduplicate
+) {
+	uint8_t tag;
+	uint64_t hash;
+	uint32_t slot;
+	const uint8_t *blob;
+
+	if (	!deduplicate ||
+		length < FNA3D_TRACE_DEDUP_MINIMUM ||
+		length > FNA3D_TRACE_BLOB_WINDOW_BYTES	)
+	{
+		tag = FNA3D_TRACE_BLOB_INLINE;
+		WRITE(tag);
+		WRITERAW(data, length);
+		return;
+	}
+
+	hash = FNA3D_TraceStream_Hash(data, length);
+	slot = (uint32_t) hash & (TRACE_BLOB_TABLE_SIZE - 1);
+	while (traceBlobTable[slot].used)
+	{
+		if (traceBlobTable[slot].hash == hash)
+		{
+			blob = FNA3D_TraceBlobWindow_Get(
+				&traceBlobWindow,
+				traceBlobTable[slot].index,
+				length
+			);
+			if (blob != NULL && SDL_memcmp(blob, data, length) == 0)
+			{
+				tag = FNA3D_TRACE_BLOB_REFERENCE;
+				WRITE(tag);
+				WRITE(traceBlobTable[slot].index);
+				traceBytesDeduplicated += length;
+				return;
+			}
+		}
+		slot = (slot + 1) & (TRACE_BLOB_TABLE_SIZE - 1);
+	}
+
+	/* Evict exactly as the reader will, then remember the new blob */
+	while (FNA3D_TraceBlobWindow_MustEvict(&traceBlobWindow, length))
+	{
+		FNA3D_Trace_ForgetBlob(traceBlobWindow.first);
+		FNA3D_TraceBlobWindow_EvictOldest(&traceBlobWindow);
+	}
+	slot = (uint32_t) hash & (TRACE_BLOB_TABLE_SIZE - 1);
+	while (traceBlobTable[slot].used)
+	{
+		slot = (slot + 1) & (TRACE_BLOB_TABLE_SIZE - 1);
+	}
+	traceBlobTable[slot].hash = hash;
+	traceBlobTable[slot].index = FNA3D_TraceBlobWindow_Add(
+		&traceBlobWindow,
+		data,
+		length,
+		hash
+	);
+	traceBlobTable[slot].used = 1;
+
+	tag = FNA3D_TRACE_BLOB_NEW;
+	WRITE(tag);
+	WRITERAW(data, length);
 }
 
 void FNA3D_Trace_CreateDevice(
 	FNA3D_PresentationParameters *presentationParameters,
 	uint8_t debugMode
 ) {
-	SDL_IOStream* traceFile;
+	uint32_t i;
+	uint32_t header[3];
 	traceEnabled = !SDL_GetHintBoolean("FNA3D_DISABLE_TRACING", SDL_FALSE);
 	if (!traceEnabled)
 	{
 		SDL_Log("FNA3D tracing disabled!");
 		return;
 	}
-	SDL_Log("FNA3D tracing started!");
 	traceFile = SDL_IOFromFile("FNA3D_Trace.bin", "wb");
-	SDL_CloseIO(traceFile);
-	traceBuffer = SDL_malloc(traceBufferSize);
+	if (traceFile == NULL)
+	{
+		SDL_Log("FNA3D_Trace.bin could not be opened, tracing disabled!");
+		traceEnabled = SDL_FALSE;
+		return;
+	}
+	SDL_Log("FNA3D tracing started!");
+	header[0] = FNA3D_TRACE_MAGIC;
+	header[1] = FNA3D_TRACE_VERSION;
+	header[2] = traceCompression;
+	SDL_WriteIO(traceFile, header, sizeof(header));
+	for (i = 0; i < TRACE_BUFFER_COUNT; i += 1)
+	{
+		traceBuffers[i].data = SDL_malloc(traceBufferSize);
+		traceBuffers[i].size = 0;
+		traceBuffers[i].capacity = traceBufferSize;
+		traceFreeBuffers[i] = &traceBuffers[i];
+	}
+	traceFreeCount = TRACE_BUFFER_COUNT - 1;
+	traceBuffer = traceFreeBuffers[traceFreeCount];
+	traceQueueHead = 0;
+	traceQueueCount = 0;
+	SDL_zero(traceBlobWindow);
+	SDL_zero(traceBlobTable);
+	traceBytesTraced = 0;
+	traceBytesDeduplicated = 0;
+	traceBytesWritten = 0;
+	traceBuffersSubmitted = 0;
+	traceStallCount = 0;
+	traceStallTicks = 0;
+	traceMaxQueueDepth = 0;
+	traceThreadQuit = SDL_FALSE;
 	traceLock = SDL_CreateMutex();
+	traceQueueLock = SDL_CreateMutex();
+	traceQueueFilled = SDL_CreateCondition();
+	traceQueueDrained = SDL_CreateCondition();
+	traceThread = SDL_CreateThread(
+		FNA3D_Trace_WriterThread,
+		"FNA3D Trace Writer",
+		NULL
+	);
+	if (traceThread == NULL)
+	{
+		SDL_Log(
+			"Trace writer thread failed to start, writing synchronously: %s",
+			SDL_GetError()
+		);
+	}
 	WRITE(MARK_CREATEDEVICE);
 	WRITE(presentationParameters->backBufferWidth);
 	WRITE(presentationParameters->backBufferHeight);
@@ -253,6 +590,7 @@ void FNA3D_Trace_CreateDevice(
 
 void FNA3D_Trace_DestroyDevice(void)
 {
+	uint32_t i;
 	if (!traceEnabled)
 	{
 		return;
@@ -284,8 +622,56 @@ void FNA3D_Trace_DestroyDevice(void)
 	}
 	traceEffectCount = 0;
 	#undef FREE_TRACES
-	FNA3D_Trace_FlushMemory();
-	SDL_free(traceBuffer);
+
+	/* Drain the queue and shut down the writer */
+	SDL_LockMutex(traceQueueLock);
+	FNA3D_Trace_SubmitBuffer();
+	traceThreadQuit = SDL_TRUE;
+	SDL_SignalCondition(traceQueueFilled);
+	SDL_UnlockMutex(traceQueueLock);
+	if (traceThread != NULL)
+	{
+		SDL_WaitThread(traceThread, NULL);
+		traceThread = NULL;
+	}
+	SDL_CloseIO(traceFile);
+	traceFile = NULL;
+	SDL_free(traceSyncScratch);
+	traceSyncScratch = NULL;
+	traceSyncScratchCapacity = 0;
+
+	for (i = 0; i < TRACE_BUFFER_COUNT; i += 1)
+	{
+		SDL_free(traceBuffers[i].data);
+		traceBuffers[i].data = NULL;
+	}
+	traceBuffer = NULL;
+	FNA3D_TraceBlobWindow_Destroy(&traceBlobWindow);
+	SDL_free(traceMappedScratch);
+	traceMappedScratch = NULL;
+	traceMappedScratchSize = 0;
+	traceMappedBuffer = NULL;
+	SDL_DestroyCondition(traceQueueFilled);
+	SDL_DestroyCondition(traceQueueDrained);
+	SDL_DestroyMutex(traceQueueLock);
+	traceQueueFilled = NULL;
+	traceQueueDrained = NULL;
+	traceQueueLock = NULL;
+
+	SDL_Log(
+		"FNA3D tracing finished: %llu bytes traced, %llu more "
+		"deduplicated, %llu written in %llu buffers, "
+		"max queue depth %u/%d, %llu stalls totaling %.3f ms",
+		(unsigned long long) traceBytesTraced,
+		(unsigned long long) traceBytesDeduplicated,
+		(unsigned long long) traceBytesWritten,
+		(unsigned long long) traceBuffersSubmitted,
+		traceMaxQueueDepth,
+		TRACE_BUFFER_COUNT,
+		(unsigned long long) traceStallCount,
+		(double) traceStallTicks * 1000.0 /
+			(double) SDL_GetPerformanceFrequency()
+	);
 	SDL_UnlockMutex(traceLock);
 }
 
@@ -325,7 +711,8 @@ void FNA3D_Trace_SwapBuffers(
 		WRITE(destinationRectangle->h);
 	}
 
-	FNA3D_Trace_FlushMemory();
+	/* Hand off each frame so the file stays current if the game dies */
+	FNA3D_Trace_FlushMemory(0);
 	SDL_UnlockMutex(traceLock);
 }
 
@@ -926,7 +1313,7 @@ void FNA3D_Trace_SetTextureData2D(
 	WRITE(h);
 	WRITE(level);
 	WRITE(dataLength);
-	WRITEMEM(data, dataLength);
+	WRITEBLOB(data, dataLength);
 	SDL_UnlockMutex(traceLock);
 }
 
@@ -959,7 +1346,7 @@ void FNA3D_Trace_SetTextureData3D(
 	WRITE(d);
 	WRITE(level);
 	WRITE(dataLength);
-	WRITEMEM(data, dataLength);
+	WRITEBLOB(data, dataLength);
 	SDL_UnlockMutex(traceLock);
 }
 
@@ -990,7 +1377,7 @@ void FNA3D_Trace_SetTextureDataCube(
 	WRITE(cubeMapFace);
 	WRITE(level);
 	WRITE(dataLength);
-	WRITEMEM(data, dataLength);
+	WRITEBLOB(data, dataLength);
 	SDL_UnlockMutex(traceLock);
 }
 
@@ -1023,7 +1410,7 @@ void FNA3D_Trace_SetTextureDataYUV(
 	WRITE(uvWidth);
 	WRITE(uvHeight);
 	WRITE(dataLength);
-	WRITEMEM(data, dataLength);
+	WRITEBLOB(data, dataLength);
 	SDL_UnlockMutex(traceLock);
 }
 
@@ -1244,6 +1631,72 @@ void FNA3D_Trace_SetVertexBufferData(
 	SDL_UnlockMutex(traceLock);
 }
 
+/* There is no mark for mapped ranges, the unmap is written as SetData.
+ * Driver mappings are write-only (often write-combined), so the caller gets
+ * traceMappedScratch instead, which is copied into the real mapping on unmap.
+ */
+static FNA3D_Buffer *traceMappedBuffer = NULL;
+static int32_t traceMappedOffset = 0;
+static int32_t traceMappedLength = 0;
+static FNA3D_SetDataOptions traceMappedOptions;
+static void *traceMappedData = NULL;
+static uint8_t *traceMappedScratch = NULL;
+static int32_t traceMappedScratchSize = 0;
+
+void* FNA3D_Trace_MapVertexBufferRange(
+	FNA3D_Buffer *buffer,
+	int32_t offsetInBytes,
+	int32_t lengthInBytes,
+	FNA3D_SetDataOptions options,
+	void *retval
+) {
+	if (!traceEnabled || retval == NULL)
+	{
+		return retval;
+	}
+	SDL_LockMutex(traceLock);
+	traceMappedBuffer = buffer;
+	traceMappedOffset = offsetInBytes;
+	traceMappedLength = lengthInBytes;
+	traceMappedOptions = options;
+	traceMappedData = retval;
+	if (lengthInBytes > traceMappedScratchSize)
+	{
+		traceMappedScratch = SDL_realloc(traceMappedScratch, lengthInBytes);
+		traceMappedScratchSize = lengthInBytes;
+	}
+	SDL_UnlockMutex(traceLock);
+	return traceMappedScratch;
+}
+
+void FNA3D_Trace_UnmapVertexBufferRange(
+	FNA3D_Buffer *buffer
+) {
+	if (!traceEnabled)
+	{
+		return;
+	}
+	SDL_LockMutex(traceLock);
+	if (buffer == traceMappedBuffer)
+	{
+		traceMappedBuffer = NULL;
+		SDL_memcpy(traceMappedData, traceMappedScratch, traceMappedLength);
+		traceMappedData = NULL;
+
+		/* traceLock is recursive */
+		FNA3D_Trace_SetVertexBufferData(
+			buffer,
+			traceMappedOffset,
+			traceMappedScratch,
+			traceMappedLength,
+			1,
+			1,
+			traceMappedOptions
+		);
+	}
+	SDL_UnlockMutex(traceLock);
+}
+
 void FNA3D_Trace_GetVertexBufferData(
 	FNA3D_Buffer *buffer,
 	int32_t offsetInBytes,
@@ -1358,7 +1811,7 @@ void FNA3D_Trace_CreateEffect(
 	FNA3D_Trace_RegisterEffect(retval, retvalData);
 	WRITE(MARK_CREATEEFFECT);
 	WRITE(effectCodeLength);
-	WRITEMEM(effectCode, effectCodeLength);
+	WRITEBLOB(effectCode, effectCodeLength);
 	SDL_UnlockMutex(traceLock);
 }
 
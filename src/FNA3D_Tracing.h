@@ -297,6 +297,18 @@ void FNA3D_Trace_SetVertexBufferData(
 	FNA3D_SetDataOptions options
 );
 
+void* FNA3D_Trace_MapVertexBufferRange(
+	FNA3D_Buffer *buffer,
+	int32_t offsetInBytes,
+	int32_t lengthInBytes,
+	FNA3D_SetDataOptions options,
+	void *retval
+);
+
+void FNA3D_Trace_UnmapVertexBufferRange(
+	FNA3D_Buffer *buffer
+);
+
 void FNA3D_Trace_GetVertexBufferData(
 	FNA3D_Buffer *buffer,
 	int32_t offsetInBytes,
@@ -420,6 +432,8 @@ void FNA3D_Trace_SetTextureName(void *texture, const char *text);
 #define TRACE_GENVERTEXBUFFER FNA3D_Trace_GenVertexBuffer(dynamic, usage, sizeInBytes, result);
 #define TRACE_ADDDISPOSEVERTEXBUFFER FNA3D_Trace_AddDisposeVertexBuffer(buffer);
 #define TRACE_SETVERTEXBUFFERDATA FNA3D_Trace_SetVertexBufferData(buffer, offsetInBytes, data, elementCount, elementSizeInBytes, vertexStride, options);
+#define TRACE_MAPVERTEXBUFFERRANGE result = FNA3D_Trace_MapVertexBufferRange(buffer, offsetInBytes, lengthInBytes, options, result);
+#define TRACE_UNMAPVERTEXBUFFERRANGE FNA3D_Trace_UnmapVertexBufferRange(buffer);
 #define TRACE_GETVERTEXBUFFERDATA FNA3D_Trace_GetVertexBufferData(buffer, offsetInBytes, elementCount, elementSizeInBytes, vertexStride);
 #define TRACE_GENINDEXBUFFER FNA3D_Trace_GenIndexBuffer(dynamic, usage, sizeInBytes, result);
 #define TRACE_ADDDISPOSEINDEXBUFFER FNA3D_Trace_AddDisposeIndexBuffer(buffer);
@@ -481,6 +495,8 @@ void FNA3D_Trace_SetTextureName(void *texture, const char *text);
 #define TRACE_GENVERTEXBUFFER
 #define TRACE_ADDDISPOSEVERTEXBUFFER
 #define TRACE_SETVERTEXBUFFERDATA
+#define TRACE_MAPVERTEXBUFFERRANGE
+#define TRACE_UNMAPVERTEXBUFFERRANGE
 #define TRACE_GETVERTEXBUFFERDATA
 #define TRACE_GENINDEXBUFFER
 #define TRACE_ADDDISPOSEINDEXBUFFER